@@ -0,0 +1,274 @@
+/***************************************************************************/ /**
+  * \file       BoomerangBench.cpp
+  * \brief   Implementation of the BoomerangBench class
+  ******************************************************************************/
+#include "BoomerangBench.h"
+
+#include "BinaryFile.h"
+#include "IBinaryImage.h"
+#include "IBinarySection.h"
+#include "boomerang.h"
+#include "basicblock.h"
+#include "cfg.h"
+#include "chllcode.h"
+#include "dataflow.h"
+#include "decoder.h"
+#include "exphelp.h"
+#include "frontend.h"
+#include "log.h"
+#include "managed.h"
+#include "proc.h"
+#include "prog.h"
+#include "rtl.h"
+#include "statement.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QProcessEnvironment>
+#include <QDebug>
+
+#include <algorithm>
+
+//! Rounds of the kernels that are timed on a fresh copy of the program each time
+static const int ROUNDS = 5;
+
+static QDir baseDir;
+static BinaryFileFactory bff;
+
+void BoomerangBench::initTestCase() {
+    QProcessEnvironment env(QProcessEnvironment::systemEnvironment());
+    QString base = env.value("BOOMERANG_TEST_BASE", BENCH_SOURCE_DIR);
+    baseDir = QDir(base);
+    Boomerang::get()->setProgPath(base);
+    Boomerang::get()->setPluginPath(base + "/out");
+    Boomerang::get()->setLogger(new NullLogger());
+    input = env.value("BOOMERANG_BENCH_INPUT", baseDir.absoluteFilePath("tests/inputs/pentium/encrypt"));
+
+    decoded = load();
+    QVERIFY(decoded != nullptr);
+
+    early = load();
+    QVERIFY(early != nullptr);
+    std::vector<UserProc *> procs(userProcs(early));
+    initialise(procs);
+    for (UserProc *p : procs)
+        p->earlyDecompile();
+    for (UserProc *p : procs) {
+        StatementList stmts;
+        p->getStatements(stmts);
+        LocationSet used;
+        for (Instruction *s : stmts) {
+            if (s->isAssign())
+                exps.push_back(((Assign *)s)->getRight());
+            s->addUsedLocs(used);
+        }
+        locs.insert(locs.end(), used.begin(), used.end());
+    }
+    QVERIFY(!exps.empty());
+
+    // Last, so that the image is the one of this program (they are all the same file anyway)
+    decompiled = load();
+    QVERIFY(decompiled != nullptr);
+    decompiled->decompile();
+}
+
+//! Load and decode a fresh copy of the program; its front end goes to \a fe if given
+Prog *BoomerangBench::load(FrontEnd **fe) {
+    QObject *pBF = bff.Load(input);
+    if (pBF == nullptr)
+        return nullptr;
+    Prog *prog = new Prog;
+    FrontEnd *pFE = FrontEnd::instantiate(pBF, prog, &bff); // The front end of its machine, e.g. to time its decoder
+    if (pFE == nullptr) {
+        delete prog;
+        return nullptr;
+    }
+    Type::clearNamedTypes();
+    prog->setFrontEnd(pFE);
+    pFE->decode(prog);
+    if (fe)
+        *fe = pFE;
+    return prog;
+}
+
+std::vector<UserProc *> BoomerangBench::userProcs(Prog *prog) {
+    std::vector<UserProc *> procs;
+    for (Module *m : *prog)
+        for (Function *f : *m)
+            if (!f->isLib())
+                procs.push_back((UserProc *)f);
+    return procs;
+}
+
+//! What the decompilation of each of \a procs starts with: statements initialised and numbered, and the dominators
+void BoomerangBench::initialise(const std::vector<UserProc *> &procs) {
+    for (UserProc *p : procs)
+        p->initialiseDecompile();
+}
+
+//! Report the mean wall time of a round, for the benchmarks that time their rounds themselves
+void BoomerangBench::report(qint64 nanos, int rounds) {
+    QTest::setBenchmarkResult(nanos / 1e6 / rounds, QTest::WalltimeMilliseconds);
+}
+
+void BoomerangBench::benchSimplify() {
+    // The clone is timed too: simplify() works in place
+    QBENCHMARK {
+        for (Exp *e : exps)
+            delete e->clone()->simplify();
+    }
+}
+
+void BoomerangBench::benchLessExpStar() {
+    QBENCHMARK {
+        std::vector<Exp *> sorted(exps);
+        std::sort(sorted.begin(), sorted.end(), lessExpStar());
+    }
+}
+
+void BoomerangBench::benchLocationSet() {
+    QBENCHMARK {
+        LocationSet even, odd;
+        for (size_t i = 0; i < locs.size(); ++i)
+            (i % 2 ? odd : even).insert(locs[i]);
+        LocationSet all(even);
+        all.makeUnion(odd);
+        size_t found = 0;
+        for (Exp *l : locs)
+            found += all.exists(l);
+        all.makeDiff(odd);
+        QCOMPARE(found, locs.size());
+    }
+}
+
+void BoomerangBench::benchDominators() {
+    std::vector<UserProc *> procs(userProcs(decoded));
+    QBENCHMARK {
+        for (UserProc *p : procs)
+            p->getDataFlow()->dominators(p->getCFG());
+    }
+}
+
+void BoomerangBench::benchPlacePhiFunctions() {
+    qint64 nanos = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        std::vector<UserProc *> procs(userProcs(load()));
+        initialise(procs);
+        QElapsedTimer timer;
+        timer.start();
+        for (UserProc *p : procs)
+            p->getDataFlow()->placePhiFunctions(p);
+        nanos += timer.nsecsElapsed();
+    }
+    report(nanos, ROUNDS);
+}
+
+void BoomerangBench::benchRenameBlockVars() {
+    qint64 nanos = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        std::vector<UserProc *> procs(userProcs(load()));
+        initialise(procs);
+        for (UserProc *p : procs) {
+            p->getDataFlow()->placePhiFunctions(p);
+            p->numberStatements();
+        }
+        QElapsedTimer timer;
+        timer.start();
+        for (UserProc *p : procs)
+            p->getDataFlow()->renameBlockVars(p, 0, true);
+        nanos += timer.nsecsElapsed();
+    }
+    report(nanos, ROUNDS);
+}
+
+void BoomerangBench::benchInstantiateRTL() {
+    FrontEnd *fe = decoded->getFrontEnd();
+    RTLInstDict &dict(fe->getDecoder()->getRTLDict());
+    // Common instructions with a register and a memory operand, as the decoder gives them
+    static const char *names[] = {"MOVrmod", "ADDrmod", "SUBrmod", "CMPrmod", "ANDrmod", "XORrmod"};
+    std::vector<TableEntry *> entries;
+    for (const char *name : names) {
+        TableEntry *entry = dict.lookupOpcode(name);
+        if (entry == nullptr)
+            QSKIP("The instructions timed are pentium ones");
+        entries.push_back(entry);
+    }
+    Exp *mem = Location::memOf(new Binary(opPlus, Location::regOf(29), Const::get(8)));
+    std::vector<Exp *> actuals = {Location::regOf(24), mem};
+    QBENCHMARK {
+        for (TableEntry *entry : entries) {
+            std::list<Instruction *> *stmts = dict.instantiateRTL(*entry, ADDRESS::g(0x8048000), actuals);
+            for (Instruction *s : *stmts)
+                delete s;
+            delete stmts;
+        }
+    }
+}
+
+void BoomerangBench::benchDecodeInstruction() {
+    // The instructions of every procedure, decoded again one by one (straight from the decoder, not from the front
+    // end's cache)
+    IBinaryImage *image = Boomerang::get()->getImage();
+    std::vector<std::pair<ADDRESS, ptrdiff_t>> insns;
+    for (UserProc *p : userProcs(decoded)) {
+        BB_IT it;
+        for (BasicBlock *bb = p->getCFG()->getFirstBB(it); bb; bb = p->getCFG()->getNextBB(it)) {
+            if (bb->getRTLs() == nullptr)
+                continue;
+            for (RTL *rtl : *bb->getRTLs()) {
+                const IBinarySection *sect = image->getSectionInfoByAddr(rtl->getAddress());
+                if (sect == nullptr)
+                    continue;
+                ptrdiff_t delta = (sect->hostAddr() - sect->sourceAddr()).m_value;
+                insns.push_back(std::make_pair(rtl->getAddress(), delta));
+            }
+        }
+    }
+    QVERIFY(!insns.empty());
+    NJMCDecoder *decoder = decoded->getFrontEnd()->getDecoder();
+    QBENCHMARK {
+        for (const auto &insn : insns) {
+            DecodeResult &res(decoder->decodeInstruction(insn.first, insn.second));
+            delete res.rtl;
+            res.rtl = nullptr;
+        }
+    }
+}
+
+void BoomerangBench::benchDfaTypeAnalysis() {
+    qint64 nanos = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        std::vector<UserProc *> procs(userProcs(load()));
+        initialise(procs);
+        for (UserProc *p : procs)
+            p->earlyDecompile();
+        QElapsedTimer timer;
+        timer.start();
+        for (UserProc *p : procs)
+            p->dfaTypeAnalysis();
+        nanos += timer.nsecsElapsed();
+    }
+    report(nanos, ROUNDS);
+}
+
+void BoomerangBench::benchAppendExp() {
+    // appendExp() is private to CHLLCode; the assignments are the bulk of what it is called for
+    std::vector<std::pair<UserProc *, std::vector<Assign *>>> assigns;
+    for (UserProc *p : userProcs(decompiled)) {
+        StatementList stmts;
+        p->getStatements(stmts);
+        assigns.push_back(std::make_pair(p, std::vector<Assign *>()));
+        for (Instruction *s : stmts)
+            if (s->isAssign())
+                assigns.back().second.push_back((Assign *)s);
+    }
+    QBENCHMARK {
+        for (const auto &pa : assigns) {
+            CHLLCode code(pa.first);
+            for (Assign *a : pa.second)
+                code.AddAssignmentStatement(1, a);
+        }
+    }
+}
+
+QTEST_MAIN(BoomerangBench)
@@ -0,0 +1,51 @@
+/***************************************************************************/ /**
+  * \file       BoomerangBench.h
+  * \brief   Microbenchmarks of the IR and analysis kernels, on a program from tests/inputs
+  ******************************************************************************/
+#include "exp.h"
+
+#include <QtTest/QTest>
+#include <vector>
+
+class Prog;
+class FrontEnd;
+class UserProc;
+class Assign;
+
+/**
+ * \class BoomerangBench
+ * QtTest benchmarks (QBENCHMARK) of the kernels the decompiler spends its time in. They all run on the same program,
+ * tests/inputs/pentium/encrypt unless BOOMERANG_BENCH_INPUT names another: the expressions, locations and procedures
+ * measured are the ones decoding and decompiling it gives, not made up ones. The program may be of any machine with a
+ * front end; benchDecodeInstruction then times the decoder of that machine (e.g. tests/inputs/ppc/fib for PPC).
+ *
+ * Kernels that change what they work on (placing phi functions, renaming, type analysis) can't be repeated on the same
+ * procedures; those time a fresh copy of the program each round, and report the mean time of a round.
+ */
+class BoomerangBench : public QObject {
+    Q_OBJECT
+    QString input;
+    Prog *decoded = nullptr;    //!< Just decoded
+    Prog *early = nullptr;      //!< After the early decompilation (SSA form) of each procedure
+    Prog *decompiled = nullptr; //!< Decompiled completely
+    std::vector<Exp *> exps;    //!< The right hand sides of the assignments of early
+    std::vector<Exp *> locs;    //!< The locations used by the statements of early
+
+    Prog *load(FrontEnd **fe = nullptr);
+    static std::vector<UserProc *> userProcs(Prog *prog);
+    static void initialise(const std::vector<UserProc *> &procs);
+    void report(qint64 nanos, int rounds);
+
+  private slots:
+    void initTestCase();
+    void benchSimplify();
+    void benchLessExpStar();
+    void benchLocationSet();
+    void benchDominators();
+    void benchPlacePhiFunctions();
+    void benchRenameBlockVars();
+    void benchInstantiateRTL();
+    void benchDecodeInstruction();
+    void benchDfaTypeAnalysis();
+    void benchAppendExp();
+};
@@ -0,0 +1,235 @@
+#!/usr/bin/env python
+# Determinism and speedup check of parallel decompilation: decompile every input of tests/inputs serially, then again
+# as n shards (--shard i/n) running at once and sharing a --cache, for each n of --jobs, and check that the C made from
+# the shards' results is the same, byte for byte, as the serial C
+#
+# usage: determinism.py BOOMERANG_EXE [options]
+#   --jobs=N,N,...      numbers of shards to run at once (default 1,2,4 and the number of cores); 1 is the serial run
+#   --inputs=DIR        the inputs (default tests/inputs)
+#   --out=DIR           where the decompilations go (default ./determinism)
+#   --options=SWITCHES  more switches for every run, e.g. "-ia -is"
+#   --max-rounds=R      give up on shards still waiting for the summaries of others after R rounds (default 10)
+#
+# A shard waits for the summaries of the procs of other shards that its procs call, so the shards are run in rounds,
+# again while any of them says it waits; then one more run, without --shard, writes the C. The cache only lends the
+# shards each other's summaries, so that run decompiles every proc again, and its C must be the serial C whatever the
+# cache holds. The wall time of the rounds and that run is compared with the serial one. For each input whose C differs, the first proc that does
+# (by the "// address:" comment codegen puts before each) is printed. The times are written to DIR/determinism.json,
+# in the format of tests/baseline/perf.json with the runs of each n under "jobs". Exits with 1 if any run failed or
+# any C differs.
+
+import json
+import multiprocessing
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+WAITING = "wait for the summaries of other shards"
+ADDRESS = re.compile(r"^// address: (0x[0-9a-fA-F]+)")
+
+
+def options():
+    opts = {"jobs": None, "inputs": None, "out": "determinism", "options": "", "max-rounds": 10}
+    exe = None
+    for arg in sys.argv[1:]:
+        if arg.startswith("--") and "=" in arg:
+            name, value = arg[2:].split("=", 1)
+            if name not in opts:
+                sys.exit("unknown option " + arg)
+            if name == "jobs":
+                value = [int(v) for v in value.split(",")]
+            elif name == "max-rounds":
+                value = int(value)
+            opts[name] = value
+        else:
+            exe = arg
+    if exe is None:
+        sys.exit("usage: " + sys.argv[0] + " BOOMERANG_EXE [--jobs=...] [--inputs=DIR] [--out=DIR] [--options=...]")
+    if opts["jobs"] is None:
+        opts["jobs"] = [1, 2, 4, multiprocessing.cpu_count()]
+    opts["jobs"] = sorted(set(opts["jobs"]))
+    return os.path.abspath(exe), opts
+
+
+def wait_measured(proc):
+    """Wait for proc, returning its exit status and peak RSS in KiB (None where unknown)"""
+    if not hasattr(os, "wait4"):
+        return proc.wait(), None
+    _, status, usage = os.wait4(proc.pid, 0)
+    result = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -os.WTERMSIG(status)
+    proc.returncode = result
+    rss = usage.ru_maxrss
+    if sys.platform == "darwin":
+        rss = rss / 1024
+    return result, rss
+
+
+def run_all(cmds, logs):
+    """Run the commands at once, returning their exit statuses and the largest peak RSS of any"""
+    procs = []
+    for cmd, log in zip(cmds, logs):
+        with open(log, "w") as f:
+            procs.append(subprocess.Popen(cmd, stdout=f, stderr=subprocess.STDOUT))
+    results = []
+    peak = None
+    for proc in procs:
+        result, rss = wait_measured(proc)
+        results.append(result)
+        if rss is not None:
+            peak = max(peak or 0, rss)
+    return results, peak
+
+
+def stage_times(output_dir):
+    try:
+        with open(os.path.join(output_dir, "stats.json")) as f:
+            stages = json.load(f).get("stages", {})
+    except (IOError, ValueError):
+        return {}
+    return dict((name, st.get("seconds", 0.0)) for name, st in stages.items())
+
+
+def read_c(output_dir):
+    """The generated C files under output_dir, by their path relative to it"""
+    files = {}
+    for dirpath, _, names in os.walk(output_dir):
+        for name in names:
+            if name.endswith(".c") or name.endswith(".h"):
+                path = os.path.join(dirpath, name)
+                with open(path) as f:
+                    files[os.path.relpath(path, output_dir)] = f.read()
+    return files
+
+
+def procs_of(text):
+    """Split C into the text before the first proc and the procs, each (address, lines) in the order written"""
+    procs = [("", [])]
+    for line in text.split("\n"):
+        m = ADDRESS.match(line)
+        if m:
+            procs.append((m.group(1), []))
+        procs[-1][1].append(line)
+    return procs
+
+
+def first_difference(serial, parallel):
+    """Where the C of the parallel run first differs from the serial one, or None if it does not"""
+    for name in sorted(set(serial) | set(parallel)):
+        if name not in parallel:
+            return "%s is missing" % name
+        if name not in serial:
+            return "%s is extra" % name
+        if serial[name] == parallel[name]:
+            continue
+        a, b = procs_of(serial[name]), procs_of(parallel[name])
+        for (addr_a, lines_a), (addr_b, lines_b) in zip(a, b):
+            if addr_a != addr_b:
+                return "%s: proc at %s instead of the proc at %s" % (name, addr_b or "start", addr_a or "start")
+            if lines_a != lines_b:
+                where = "proc at " + addr_a if addr_a else "the declarations before the first proc"
+                header = lines_a[1].strip() if addr_a and len(lines_a) > 1 else ""
+                return "%s: %s %s" % (name, where, header)
+        return "%s: %d procs instead of %d" % (name, len(b) - 1, len(a) - 1)
+    return None
+
+
+def sharded(exe, root, extra, source, out, n, max_rounds):
+    """Decompile source as n shards at once, then write the C with the cache they fill.
+    Returns (error or None, wall seconds, peak RSS, output directory of the C)"""
+    if os.path.isdir(out):
+        shutil.rmtree(out)
+    os.makedirs(out)
+    cache = os.path.join(out, "cache")
+    start = time.time()
+    peak = None
+    pending = list(range(n))
+    rounds = 0
+    while pending:
+        rounds += 1
+        if rounds > max_rounds:
+            return "shards %s still waiting after %d rounds" % (pending, max_rounds), None, peak, None
+        logs = [os.path.join(out, "shard%d-%d.log" % (i, rounds)) for i in pending]
+        cmds = [[exe, "-P", root, "-o", os.path.join(out, "shard%d" % i), "--cache", cache, "--shard",
+                 "%d/%d" % (i, n)] + extra + [source] for i in pending]
+        results, rss = run_all(cmds, logs)
+        if rss is not None:
+            peak = max(peak or 0, rss)
+        for i, result, log in zip(pending, results, logs):
+            if result != 0:
+                return "shard %d/%d failed (%d), see %s" % (i, n, result, log), None, peak, None
+        still = []
+        for i, log in zip(pending, logs):
+            with open(log) as f:
+                if WAITING in f.read():
+                    still.append(i)
+        pending = still
+    final = os.path.join(out, "final")
+    log = os.path.join(out, "final.log")
+    results, rss = run_all([[exe, "-P", root, "-o", final, "--cache", cache] + extra + [source]], [log])
+    seconds = time.time() - start
+    if rss is not None:
+        peak = max(peak or 0, rss)
+    if results[0] != 0:
+        return "writing the C with the cache failed (%d), see %s" % (results[0], log), seconds, peak, None
+    return None, seconds, peak, final
+
+
+def main():
+    exe, opts = options()
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    inputs = os.path.abspath(opts["inputs"] or os.path.join(root, "tests", "inputs"))
+    out = os.path.abspath(opts["out"])
+    extra = opts["options"].split()
+    report = {}
+    failed = []
+    print("%-40s %6s %10s %12s %8s  %s" % ("input", "jobs", "seconds", "peak KiB", "speedup", "result"))
+    for dirpath, _, names in sorted(os.walk(inputs)):
+        for name in sorted(names):
+            source = os.path.join(dirpath, name)
+            rel = os.path.relpath(source, inputs)
+            key = os.path.relpath(source, root).replace(os.sep, "/")
+            serial_out = os.path.join(out, "1", rel)
+            if os.path.isdir(serial_out):
+                shutil.rmtree(serial_out)
+            os.makedirs(serial_out)
+            log = os.path.join(serial_out + ".log")
+            start = time.time()
+            results, rss = run_all([[exe, "-P", root, "-o", serial_out, "--stats"] + extra + [source]], [log])
+            serial_seconds = time.time() - start
+            if results[0] != 0:
+                print("%-40s %6d %10s %12s %8s  failed (%d), see %s" % (rel, 1, "", "", "", results[0], log))
+                failed.append(rel)
+                continue
+            print("%-40s %6d %10.2f %12s %8s  reference" % (rel, 1, serial_seconds, rss, ""))
+            serial_c = read_c(serial_out)
+            entry = {"seconds": serial_seconds, "max_rss_kb": rss, "stages": stage_times(serial_out), "jobs": {}}
+            for n in opts["jobs"]:
+                if n < 2:
+                    continue
+                error, seconds, peak, final = sharded(exe, root, extra, source, os.path.join(out, str(n), rel), n,
+                                                      opts["max-rounds"])
+                if error is None:
+                    diff = first_difference(serial_c, read_c(final))
+                    if diff is not None:
+                        error = "NONDETERMINISTIC, first difference in " + diff
+                if error is not None:
+                    failed.append("%s (%d jobs)" % (rel, n))
+                speedup = serial_seconds / seconds if seconds else None
+                print("%-40s %6d %10s %12s %8s  %s" % (rel, n, "%.2f" % seconds if seconds else "", peak,
+                                                       "%.2f" % speedup if speedup else "", error or "identical"))
+                entry["jobs"][str(n)] = {"seconds": seconds, "max_rss_kb": peak, "speedup": speedup,
+                                         "identical": error is None}
+            report[key] = entry
+
+    with open(os.path.join(out, "determinism.json"), "w") as f:
+        json.dump(report, f, indent=1, sort_keys=True)
+    if failed:
+        print("Failed: " + ", ".join(failed))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,116 @@
+#!/usr/bin/env python
+# Generate C sources of tunable size, for stress testing the decompiler on big procedures
+#
+# Each shape grows one thing that makes a procedure hard, with size as the knob:
+#   blocks     one procedure of `size` if/else diamonds in a row (about 3 basic blocks each)
+#   loops      loops nested `size` deep, each with a little work of its own
+#   switch     switches nested 3 deep, with `size` arms at each level
+#   calls      one procedure calling `size` different procedures, each from two call sites
+#   recursion  a recursion group of `size` procedures calling each other in a ring
+#
+# usage: gen_corpus.py SHAPE SIZE [OUTPUT.c]     (writes to stdout without OUTPUT.c)
+
+import sys
+
+SHAPES = ["blocks", "loops", "switch", "calls", "recursion"]
+
+HEADER = """/* Generated by benchmarks/gen_corpus.py: %s, size %d */
+#include <stdio.h>
+
+volatile int input = 7; /* volatile, so that nothing is folded away */
+int acc;
+
+"""
+
+MAIN = """
+int main(int argc, char *argv[]) {
+    acc = argc;
+    printf("%%d\\n", %s(input));
+    return 0;
+}
+"""
+
+
+def gen_blocks(size):
+    lines = ["int work(int x) {", "    int y = x;"]
+    for i in range(size):
+        lines.append("    if (y %% %d == %d)" % (i % 7 + 2, i % 3))
+        lines.append("        y += %d;" % (i + 1))
+        lines.append("    else")
+        lines.append("        y ^= acc + %d;" % i)
+    lines += ["    return y;", "}"]
+    return "\n".join(lines) + "\n" + MAIN % "work"
+
+
+def gen_loops(size):
+    lines = ["int work(int x) {", "    int y = x;"]
+    for i in range(size):
+        ind = "    " * (i + 1)
+        lines.append("%sint i%d;" % (ind, i))
+        lines.append("%sfor (i%d = 0; i%d < (x & 1) + 1; i%d++) {" % (ind, i, i, i))
+        lines.append("%s    y += i%d * %d;" % (ind, i, i + 1))
+    for i in reversed(range(size)):
+        lines.append("%s}" % ("    " * (i + 1)))
+    lines += ["    return y;", "}"]
+    return "\n".join(lines) + "\n" + MAIN % "work"
+
+
+def gen_switch(size, depth=3):
+    def level(d, ind, var):
+        out = ["%sswitch ((%s + %d) %% %d) {" % (ind, var, d, size + 1)]
+        for arm in range(size):
+            out.append("%scase %d:" % (ind, arm))
+            if d + 1 < depth and arm == 0:
+                out += level(d + 1, ind + "    ", "y")
+            else:
+                out.append("%s    y = y * %d + %d;" % (ind, arm % 5 + 2, arm))
+            out.append("%s    break;" % ind)
+        out.append("%sdefault:" % ind)
+        out.append("%s    y--;" % ind)
+        out.append("%s}" % ind)
+        return out
+    lines = ["int work(int x) {", "    int y = x;"] + level(0, "    ", "x") + ["    return y;", "}"]
+    return "\n".join(lines) + "\n" + MAIN % "work"
+
+
+def gen_calls(size):
+    lines = []
+    for i in range(size):
+        lines.append("int callee%d(int x) { return x * %d + acc; }" % (i, i + 1))
+    lines += ["", "int work(int x) {", "    int y = x;"]
+    for i in range(size):
+        lines.append("    y = callee%d(y) - callee%d(%d);" % (i, i, i))
+    lines += ["    return y;", "}"]
+    return "\n".join(lines) + "\n" + MAIN % "work"
+
+
+def gen_recursion(size):
+    lines = ["int ring%d(int x);" % i for i in range(size)]
+    for i in range(size):
+        lines.append("int ring%d(int x) {" % i)
+        lines.append("    if (x <= 0)")
+        lines.append("        return acc + %d;" % i)
+        lines.append("    return ring%d(x - %d) + %d;" % ((i + 1) % size, i % 2 + 1, i))
+        lines.append("}")
+    return "\n".join(lines) + "\n" + MAIN % "ring0"
+
+
+GENERATORS = {"blocks": gen_blocks, "loops": gen_loops, "switch": gen_switch, "calls": gen_calls,
+              "recursion": gen_recursion}
+
+
+def generate(shape, size):
+    """The C source of the given shape and size"""
+    return HEADER % (shape, size) + GENERATORS[shape](size)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 3 or sys.argv[1] not in GENERATORS:
+        sys.stderr.write("usage: " + sys.argv[0] + " " + "|".join(SHAPES) + " SIZE [OUTPUT.c]\n")
+        sys.exit(1)
+    source = generate(sys.argv[1], int(sys.argv[2]))
+    if len(sys.argv) > 3:
+        with open(sys.argv[3], "w") as f:
+            f.write(source)
+    else:
+        sys.stdout.write(source)
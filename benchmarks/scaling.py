@@ -0,0 +1,164 @@
+#!/usr/bin/env python
+# Scaling benchmark: decompile the generated corpus (see gen_corpus.py) at growing sizes, and check that the time and
+# the memory needed grow no faster than they should
+#
+# usage: scaling.py BOOMERANG_EXE [options]
+#   --shapes=blocks,calls,...   shapes to run (default: all of them)
+#   --sizes=N,N,...             sizes to run every shape at (default: a range suited to each shape)
+#   --max-exponent=X            fail if time or peak RSS grows faster than size**X (default 1.5)
+#   --out=DIR                   where the sources, binaries and decompilations go (default ./scaling)
+#   --cc=CC --cflags=FLAGS      how to make pentium binaries (default: gcc -m32 -O0 -fno-pie -no-pie)
+#
+# For each shape, prints size, wall time, peak RSS and the slowest stages from stats.json, writes it all to
+# DIR/scaling.csv (and DIR/scaling.png, if matplotlib is there) and fits the exponent k of time ~ size**k on a log-log
+# scale. Exits with 1 if an exponent is above the maximum.
+
+import gen_corpus
+import json
+import math
+import os
+import subprocess
+import sys
+import time
+
+DEFAULT_SIZES = {
+    "blocks": [250, 500, 1000, 2000, 4000],
+    "loops": [4, 8, 16, 32, 64],
+    "switch": [16, 32, 64, 128, 256],
+    "calls": [125, 250, 500, 1000, 2000],
+    "recursion": [4, 8, 16, 32, 64],
+}
+MIN_SECONDS = 0.2 # Runs quicker than this are mostly start up, and say nothing about the growth
+
+
+def options():
+    opts = {"shapes": gen_corpus.SHAPES, "sizes": None, "max-exponent": 1.5, "out": "scaling", "cc": "gcc",
+            "cflags": "-m32 -O0 -fno-pie -no-pie"}
+    exe = None
+    for arg in sys.argv[1:]:
+        if arg.startswith("--") and "=" in arg:
+            name, value = arg[2:].split("=", 1)
+            if name not in opts:
+                sys.exit("unknown option " + arg)
+            if name == "shapes":
+                value = value.split(",")
+            elif name == "sizes":
+                value = [int(v) for v in value.split(",")]
+            elif name == "max-exponent":
+                value = float(value)
+            opts[name] = value
+        else:
+            exe = arg
+    if exe is None:
+        sys.exit("usage: " + sys.argv[0] + " BOOMERANG_EXE [--shapes=...] [--sizes=...] [--max-exponent=X] [--out=DIR]")
+    return os.path.abspath(exe), opts
+
+
+def run_measured(cmd, log):
+    """Run cmd, returning its exit status, wall time in seconds and peak RSS in KiB (None where unknown)"""
+    start = time.time()
+    proc = subprocess.Popen(cmd, stdout=log, stderr=subprocess.STDOUT)
+    if not hasattr(os, "wait4"):
+        return proc.wait(), time.time() - start, None
+    _, status, usage = os.wait4(proc.pid, 0)
+    seconds = time.time() - start
+    result = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -os.WTERMSIG(status)
+    rss = usage.ru_maxrss
+    if sys.platform == "darwin":
+        rss = rss / 1024
+    return result, seconds, rss
+
+
+def slowest_stages(output_dir, n=3):
+    try:
+        with open(os.path.join(output_dir, "stats.json")) as f:
+            stages = json.load(f).get("stages", {})
+    except (IOError, ValueError):
+        return []
+    times = sorted(((st.get("seconds", 0.0), name) for name, st in stages.items()), reverse=True)
+    return ["%s %.2fs" % (name, seconds) for seconds, name in times[:n]]
+
+
+def exponent(points, floor):
+    """Least squares slope of log(y) against log(x), over the points with y at least floor"""
+    points = [(x, y) for x, y in points if y and y >= floor]
+    if len(points) < 3:
+        return None
+    lx = [math.log(x) for x, _ in points]
+    ly = [math.log(y) for _, y in points]
+    mx = sum(lx) / len(lx)
+    my = sum(ly) / len(ly)
+    var = sum((a - mx) ** 2 for a in lx)
+    return sum((a - mx) * (b - my) for a, b in zip(lx, ly)) / var if var else None
+
+
+def main():
+    exe, opts = options()
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    out = os.path.abspath(opts["out"])
+    if not os.path.isdir(out):
+        os.makedirs(out)
+    rows = []
+    failed = []
+    for shape in opts["shapes"]:
+        print("%s:" % shape)
+        print("%10s %10s %12s  %s" % ("size", "seconds", "peak KiB", "slowest stages"))
+        series = []
+        for size in opts["sizes"] or DEFAULT_SIZES[shape]:
+            name = "%s-%d" % (shape, size)
+            src = os.path.join(out, name + ".c")
+            binary = os.path.join(out, name)
+            with open(src, "w") as f:
+                f.write(gen_corpus.generate(shape, size))
+            if subprocess.call([opts["cc"]] + opts["cflags"].split() + ["-o", binary, src]) != 0:
+                sys.exit("could not compile " + src)
+            output_dir = os.path.join(out, name + "-out")
+            with open(os.path.join(out, name + ".log"), "w") as log:
+                result, seconds, rss = run_measured([exe, "-P", root, "-o", output_dir, "--stats", binary], log)
+            if result != 0:
+                print("%10d failed (%d), see %s.log" % (size, result, name))
+                failed.append(name)
+                continue
+            print("%10d %10.2f %12s  %s" % (size, seconds, rss, ", ".join(slowest_stages(output_dir))))
+            series.append((size, seconds, rss))
+            rows.append((shape, size, seconds, rss))
+        # The peak RSS includes what boomerang needs to start with, so its exponent errs on the low side
+        for what, column, floor in (("time", 1, MIN_SECONDS), ("peak RSS", 2, 1)):
+            k = exponent([(s[0], s[column]) for s in series], floor)
+            if k is None:
+                continue
+            verdict = "ok" if k <= opts["max-exponent"] else "SUPERLINEAR"
+            print("    %s grows as size^%.2f: %s" % (what, k, verdict))
+            if k > opts["max-exponent"]:
+                failed.append("%s (%s)" % (shape, what))
+        print("")
+
+    with open(os.path.join(out, "scaling.csv"), "w") as f:
+        f.write("shape,size,seconds,peak_rss_kib\n")
+        for row in rows:
+            f.write("%s,%d,%.3f,%s\n" % row)
+    try:
+        import matplotlib
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as plt
+        fig, (tax, rax) = plt.subplots(1, 2, figsize=(12, 5))
+        for shape in opts["shapes"]:
+            pts = [r for r in rows if r[0] == shape]
+            tax.loglog([r[1] for r in pts], [r[2] for r in pts], "o-", label=shape)
+            rax.loglog([r[1] for r in pts if r[3]], [r[3] for r in pts if r[3]], "o-", label=shape)
+        tax.set_xlabel("size")
+        tax.set_ylabel("seconds")
+        rax.set_xlabel("size")
+        rax.set_ylabel("peak RSS (KiB)")
+        tax.legend()
+        fig.savefig(os.path.join(out, "scaling.png"))
+    except ImportError:
+        pass
+
+    if failed:
+        print("Failed: " + ", ".join(failed))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,191 @@
+/***************************************************************************/ /**
+  * \file       throughput.cpp
+  * \brief   End to end throughput of decoding, decompilation and code generation, by architecture
+  *
+  * Runs the whole pipeline in process on each sample of tests/inputs/<arch>, with the code generated into memory and
+  * thrown away, and reports for each architecture the instructions decoded per second, the statements decompiled per
+  * second and the bytes of code generated per second.
+  *
+  * usage: boomerang_throughput [-P boomerang-dir] [--json=file] [arch ...]
+  * (default architectures: pentium sparc ppc mips hppa m68k)
+  ******************************************************************************/
+#include "boomerang.h"
+#include "basicblock.h"
+#include "cfg.h"
+#include "log.h"
+#include "proc.h"
+#include "prog.h"
+#include "rtl.h"
+#include "type.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+void init_dfa();
+void init_sslparser();
+void init_basicblock();
+
+namespace {
+//! Adds up the instructions decoded, as the front end reports its progress
+class DecodeCounter : public Watcher {
+  public:
+    qint64 insns = 0;
+    void alertDecodeProgress(int numInsns, int) override { insns += numInsns; }
+};
+
+struct Totals {
+    int samples = 0;
+    int failed = 0;
+    qint64 insns = 0;
+    qint64 stmts = 0;
+    qint64 bytes = 0;
+    qint64 decodeNanos = 0;
+    qint64 decompileNanos = 0;
+    qint64 codegenNanos = 0;
+
+    void add(const Totals &o) {
+        samples += o.samples;
+        failed += o.failed;
+        insns += o.insns;
+        stmts += o.stmts;
+        bytes += o.bytes;
+        decodeNanos += o.decodeNanos;
+        decompileNanos += o.decompileNanos;
+        codegenNanos += o.codegenNanos;
+    }
+};
+
+double perSecond(qint64 n, qint64 nanos) { return nanos ? n * 1e9 / nanos : 0; }
+
+//! The statements decoded, which are what decompilation starts from
+qint64 countStatements(Prog *prog) {
+    qint64 n = 0;
+    for (Module *module : *prog)
+        for (Function *func : *module) {
+            if (func->isLib() || ((UserProc *)func)->getCFG() == nullptr)
+                continue;
+            BB_IT it;
+            Cfg *cfg = ((UserProc *)func)->getCFG();
+            for (BasicBlock *bb = cfg->getFirstBB(it); bb; bb = cfg->getNextBB(it))
+                if (bb->getRTLs())
+                    for (RTL *rtl : *bb->getRTLs())
+                        n += rtl->size();
+        }
+    return n;
+}
+
+//! Load, decode, decompile and generate code for \a path, adding what it took to \a totals
+void runSample(const QString &path, DecodeCounter &counter, Totals &totals) {
+    Boomerang &boom(*Boomerang::get());
+    Type::clearNamedTypes();
+    counter.insns = 0;
+    QElapsedTimer timer;
+    timer.start();
+    Prog *prog = boom.loadAndDecode(path);
+    if (prog == nullptr) {
+        totals.failed++;
+        return;
+    }
+    qint64 decoded = timer.nsecsElapsed();
+    qint64 stmts = countStatements(prog);
+    timer.restart();
+    prog->decompile();
+    qint64 decompiled = timer.nsecsElapsed();
+    QString code;
+    QTextStream os(&code);
+    timer.restart();
+    prog->generateCode(os);
+    os.flush();
+    totals.codegenNanos += timer.nsecsElapsed();
+    totals.decodeNanos += decoded;
+    totals.decompileNanos += decompiled;
+    totals.samples++;
+    totals.insns += counter.insns;
+    totals.stmts += stmts;
+    totals.bytes += code.toUtf8().size();
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    init_dfa();
+    init_sslparser();
+    init_basicblock();
+
+    QCoreApplication app(argc, argv);
+    QStringList args(app.arguments());
+    QString progPath(BENCH_SOURCE_DIR), jsonPath;
+    QStringList archs;
+    for (int i = 1; i < args.size(); ++i) {
+        if (args[i] == "-P" && i + 1 < args.size())
+            progPath = args[++i];
+        else if (args[i].startsWith("--json="))
+            jsonPath = args[i].mid(7);
+        else
+            archs << args[i];
+    }
+    if (archs.isEmpty())
+        archs << "pentium" << "sparc" << "ppc" << "mips" << "hppa" << "m68k";
+
+    Boomerang &boom(*Boomerang::get());
+    boom.setProgPath(progPath);
+    boom.setPluginPath(QCoreApplication::applicationDirPath());
+    boom.setLogger(new NullLogger());
+    QTemporaryDir outDir; // For what the pipeline writes anyway
+    boom.setOutputDirectory(outDir.path() + "/");
+    DecodeCounter counter;
+    boom.addWatcher(&counter);
+
+    QTextStream out(stdout);
+    QString report;
+    QTextStream json(&report);
+    json << "{\n";
+    Totals all;
+    QMap<QString, Totals> byArch;
+    for (const QString &arch : archs) {
+        QDir dir(QDir(progPath).absoluteFilePath("tests/inputs/" + arch));
+        Totals totals;
+        for (const QString &name : dir.entryList(QDir::Files, QDir::Name))
+            runSample(dir.absoluteFilePath(name), counter, totals);
+        byArch[arch] = totals;
+        all.add(totals);
+    }
+
+    out << QString("%1 %2 %3 %4 %5 %6\n")
+               .arg("", -10)
+               .arg("samples", 8)
+               .arg("failed", 7)
+               .arg("insns/s", 12)
+               .arg("stmts/s", 12)
+               .arg("bytes/s", 12);
+    byArch["all"] = all;
+    archs << "all";
+    for (const QString &arch : archs) {
+        const Totals &t(byArch[arch]);
+        out << QString("%1 %2 %3 %4 %5 %6\n")
+                   .arg(arch, -10)
+                   .arg(t.samples, 8)
+                   .arg(t.failed, 7)
+                   .arg(perSecond(t.insns, t.decodeNanos), 12, 'f', 0)
+                   .arg(perSecond(t.stmts, t.decompileNanos), 12, 'f', 0)
+                   .arg(perSecond(t.bytes, t.codegenNanos), 12, 'f', 0);
+        json << (arch == archs.front() ? "" : ",\n") << "  \"" << arch << "\": {\"samples\": " << t.samples
+             << ", \"failed\": " << t.failed << ", \"instructions\": " << t.insns << ", \"statements\": " << t.stmts
+             << ", \"bytes\": " << t.bytes << ", \"decode_seconds\": " << t.decodeNanos / 1e9
+             << ", \"decompile_seconds\": " << t.decompileNanos / 1e9
+             << ", \"codegen_seconds\": " << t.codegenNanos / 1e9 << "}";
+    }
+    json << "\n}\n";
+    json.flush();
+    if (!jsonPath.isEmpty()) {
+        QFile f(jsonPath);
+        if (!f.open(QFile::WriteOnly | QFile::Text) || f.write(report.toUtf8()) < 0) {
+            out << "cannot write " << jsonPath << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
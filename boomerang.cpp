@@ -18,6 +18,12 @@
 #include "signature.h"
 //#include "transformer.h"
 #include "log.h"
+#include "simplifycache.h"
+#include "stats.h"
+#include "tracewatcher.h"
+#include "proccache.h"
+#include "decodecache.h"
+#include "procprofile.h"
 #include "xmlprogparser.h"
 #include "codegen/chllcode.h"
 
@@ -48,22 +54,7 @@ Boomerang::~Boomerang() {
     delete Image;
 }
 
-/**
- * \returns the Log object associated with the object.
- */
-Log &Boomerang::log() { return *logger; }
-
 SeparateLogger Boomerang::separate_log(const QString &v) { return SeparateLogger(v); }
-Log &Boomerang::if_verbose_log(int verbosity_level) {
-    static NullLogger null_log;
-    if (verbosity_level == 2)
-        return *logger;
-    if ((verbosity_level == 1) && VERBOSE)
-        return *logger;
-    else
-        return null_log;
-}
-
 void Boomerang::setLogger(Log *l) {
     delete logger;
     logger = l;
@@ -72,7 +63,9 @@ void Boomerang::setLogger(Log *l) {
 /**
  * Sets the outputfile to be the file "log" in the default output directory.
  */
-FileLogger::FileLogger() : out((Boomerang::get()->getOutputPath() + "log").toStdString()) {}
+FileLogger::FileLogger() : out((Boomerang::get()->getOutputPath() + "log").toStdString()), written(0), stopping(false) {
+    start();
+}
 
 SeparateLogger::SeparateLogger(const QString &v) {
     static QMap<QString, int> versions;
@@ -629,7 +622,8 @@ bool Boomerang::setOutputDirectory(const QString &path) {
 }
 
 /**
- * Adds information about functions and classes from Objective-C modules to the Prog object.
+ * Adds information about functions and classes from Objective-C modules to the Prog object. The modules are made now;
+ * the classes are only noted, and made with the procs of their methods when first needed (see Prog::addObjcClass).
  *
  * \param modules A map from name to the Objective-C modules.
  * \param prog The Prog object to add the information to.
@@ -642,56 +636,33 @@ void Boomerang::objcDecode(const std::map<QString, ObjcModule> &modules, Prog *p
         Module *module = prog->getOrInsertModule(mod.name);
         root->addChild(module);
         LOG_VERBOSE(1) << "\tModule: " << mod.name << "\n";
-        ClassModFactory class_fact;
         for (auto &elem : mod.classes) {
             const ObjcClass &c = (elem).second;
-            Module *cl = prog->getOrInsertModule(mod.name,class_fact);
-            root->addChild(cl);
             LOG_VERBOSE(1) << "\t\tClass: " << c.name << "\n";
+            std::vector<std::pair<QString, ADDRESS>> methods;
             for (auto &_it2 : c.methods) {
                 const ObjcMethod &m = (_it2).second;
                 // TODO: parse :'s in names
-                QString method_name = m.name+"_"+m.types;
-                Function *existing = prog->findProc(method_name);
-                if(existing) {
-                    assert(!"Name clash in objc processor ?");
-                    continue;
-                }
-                Function *p = cl->getOrInsertFunction(method_name, m.addr);
-                p->setSignature(Signature::instantiate(prog->getFrontEndId(),CONV_C,method_name));
-                // TODO: decode types in m.types
+                methods.push_back(std::make_pair(m.name + "_" + m.types, m.addr));
                 LOG_VERBOSE(1) << "\t\t\tMethod: " << m.name << "\n";
             }
+            prog->addObjcClass(mod.name, c.name, methods);
         }
     }
     LOG_VERBOSE(1) << "\n";
 }
 
 /**
- * Loads the executable file and decodes it.
+ * Decodes the program just loaded, from the entry points of the binary or those given, and saves it in the decode
+ * cache if there is one.
  *
- * \param fname The name of the file to load.
+ * \param prog The program, with its front end.
+ * \param fname The name of the file it was loaded from.
  * \param pname How the Prog will be named.
- *
- * \returns A Prog object.
  */
-Prog *Boomerang::loadAndDecode(const QString &fname, const char *pname) {
+void Boomerang::decode(Prog *prog, const QString &fname, const char *pname) {
     QTextStream q_cout(stdout);
-    q_cout << "loading...\n";
-    Prog *prog = new Prog();
-    FrontEnd *fe = FrontEnd::Load(fname, prog);
-    if (fe == nullptr) {
-        LOG_STREAM(LL_Default) << "failed.\n";
-        return nullptr;
-    }
-    prog->setFrontEnd(fe);
-
-    // Add symbols from -s switch(es)
-    for (const std::pair<ADDRESS,QString > &elem : symbols) {
-        fe->AddSymbol(elem.first, elem.second);
-    }
-    fe->readLibraryCatalog(); // Needed before readSymbolFile()
-
+    FrontEnd *fe = prog->getFrontEnd();
     for (auto &elem : symbolFiles) {
         q_cout << "reading symbol file " << elem << "\n";
         prog->readSymbolFile(elem);
@@ -713,7 +684,7 @@ Prog *Boomerang::loadAndDecode(const QString &fname, const char *pname) {
             q_cout << "decoding entry point...\n";
         fe->decode(prog, decodeMain, pname);
 
-        if (!noDecodeChildren) {
+        if (!noDecodeChildren && !lazyDecode) {
             // this causes any undecoded userprocs to be decoded
             q_cout << "decoding anything undecoded...\n";
             fe->decode(prog, NO_ADDRESS);
@@ -723,8 +694,48 @@ Prog *Boomerang::loadAndDecode(const QString &fname, const char *pname) {
     q_cout << "finishing decode...\n";
     prog->finishDecode();
 
+    if (DecodeCache::get().isEnabled())
+        DecodeCache::get().store(prog, fname, pname);
+}
+
+/**
+ * Loads the executable file and decodes it.
+ *
+ * \param fname The name of the file to load.
+ * \param pname How the Prog will be named.
+ *
+ * \returns A Prog object.
+ */
+Prog *Boomerang::loadAndDecode(const QString &fname, const char *pname) {
+    QTextStream q_cout(stdout);
+    q_cout << "loading...\n";
+    Prog *prog = DecodeCache::get().isEnabled() ? DecodeCache::get().restore(fname, pname) : nullptr;
+    bool restored = prog != nullptr;
+    FrontEnd *fe;
+    if (restored) {
+        q_cout << "read the decoded program from the decode cache\n";
+        fe = prog->getFrontEnd();
+    } else {
+        prog = new Prog();
+        fe = FrontEnd::Load(fname, prog);
+        if (fe == nullptr) {
+            LOG_STREAM(LL_Default) << "failed.\n";
+            return nullptr;
+        }
+        prog->setFrontEnd(fe);
+    }
+
+    // Add symbols from -s switch(es)
+    for (const std::pair<ADDRESS,QString > &elem : symbols) {
+        fe->AddSymbol(elem.first, elem.second);
+    }
+    fe->readLibraryCatalog(); // Needed before readSymbolFile()
+    if (!restored)
+        decode(prog, fname, pname);
+
     Boomerang::get()->alertEndDecode();
 
+
     q_cout << "found " << prog->getNumProcs() << " procs\n";
 
     // GK: The analysis which was performed was not exactly very "analysing", and so it has been moved to
@@ -785,7 +796,7 @@ int Boomerang::decompile(const QString &fname, const char *pname) {
     LOG_STREAM() << "decompiling...\n";
     prog->decompile();
 
-    if (!dotFile.isEmpty())
+    if (DEBUG_HOOKS && !dotFile.isEmpty())
         prog->generateDotFile();
 
     if (printAST) {
@@ -794,6 +805,8 @@ int Boomerang::decompile(const QString &fname, const char *pname) {
             for(Function *func : *module) {
                 if (!func->isLib()) {
                     UserProc *u = (UserProc *)func;
+                    if (u->getCFG() == nullptr)
+                        continue; // Released by the ProcStreamer after its code was generated
                     u->getCFG()->compressCfg();
                     u->printAST();
                 }
@@ -816,6 +829,39 @@ int Boomerang::decompile(const QString &fname, const char *pname) {
     if (hours || mins)
         q_cout << mins << " mins ";
     q_cout << secs << " sec" << (secs == 1 ? "" : "s") << ".\n";
+    if (SimplifyCache::get().isEnabled())
+        q_cout << "simplify cache: " << SimplifyCache::get().getHits() << " hits, "
+               << SimplifyCache::get().getMisses() << " misses\n";
+    if (ProcCache::get().isEnabled())
+        q_cout << "procedure cache: " << ProcCache::get().getHits() << " hits, " << ProcCache::get().getMisses()
+               << " misses, " << ProcCache::get().getStores() << " stored\n";
+    if (DecodeCache::get().isEnabled())
+        q_cout << "decode cache: " << DecodeCache::get().getHits() << " hits, " << DecodeCache::get().getMisses()
+               << " misses, " << DecodeCache::get().getStores() << " stored\n";
+    if (DecompileStats::get().isEnabled()) {
+        if (DecompileStats::get().writeJSON(outputPath + "stats.json"))
+            q_cout << "statistics written to " << outputPath << "stats.json\n";
+        else
+            LOG_STREAM() << "cannot write " << outputPath << "stats.json\n";
+    }
+    if (DecompileStats::get().isMemoryEnabled()) {
+        if (DecompileStats::get().writeMemoryReport(outputPath + "memstats.txt", 20))
+            q_cout << "memory report written to " << outputPath << "memstats.txt\n";
+        else
+            LOG_STREAM() << "cannot write " << outputPath << "memstats.txt\n";
+    }
+    if (ProcProfile::get().isEnabled()) {
+        if (ProcProfile::get().write())
+            q_cout << "profile written to " << ProcProfile::get().getPath() << "\n";
+        else
+            LOG_STREAM() << "cannot write " << ProcProfile::get().getPath() << "\n";
+    }
+    if (TraceWatcher::get().isEnabled()) {
+        if (TraceWatcher::get().writeJSON(outputPath + "trace.json"))
+            q_cout << "trace written to " << outputPath << "trace.json\n";
+        else
+            LOG_STREAM() << "cannot write " << outputPath << "trace.json\n";
+    }
 
     return 0;
 }
@@ -859,37 +905,47 @@ void Boomerang::miniDebugger(UserProc *p, const char *description)
             q_cout << "\n";
         }
         q_cout << " <press enter to continue> \n";
-        QString line;
         while (1) {
-            line.clear();
-            q_cin >> line;
-            if (line.startsWith("print"))
+            q_cout.flush();
+            // A command, and the argument of those that take one
+            QStringList parts = q_cin.readLine().split(" ", QString::SkipEmptyParts);
+            QString command = parts.value(0);
+            QString arg = parts.value(1);
+            if (command == "print")
                 p->print(q_cout);
-            else if (line.startsWith("fprint")) {
+            else if (command == "history") {
+                const ProcHistory &history(p->getHistory());
+                for (size_t i = 0; i < history.size(); i++)
+                    q_cout << i << ": " << history.getDescription(i) << "\n";
+            } else if (command == "back") {
+                // The proc as it was at an earlier debug point, numbered as by "history"
+                bool ok;
+                size_t n = arg.toUInt(&ok);
+                if (ok && n < p->getHistory().size())
+                    q_cout << p->getHistory().getText(n) << "\n";
+            }
+            else if (command == "fprint") {
                 QFile tgt("out.proc");
                 if(tgt.open(QFile::WriteOnly)) {
                     QTextStream of(&tgt);
                     p->print(of);
                 }
-            } else if (line.startsWith("run ")) {
-                QStringList parts = line.trimmed().split(" ",QString::SkipEmptyParts);
-                if(parts.size()>1)
-                    stopAt = parts[1];
+            } else if (command == "run") {
+                if(!arg.isEmpty())
+                    stopAt = arg;
                 break;
-            } else if (line.startsWith("watch ")) {
-                QStringList parts = line.trimmed().split(" ",QString::SkipEmptyParts);
-                if(parts.size()>1) {
-                    int n = parts[1].toInt();
-                    StatementList stmts;
+            } else if (command == "watch") {
+                bool ok;
+                int n = arg.toInt(&ok);
+                StatementList stmts;
+                if (ok)
                     p->getStatements(stmts);
-                    StatementList::iterator it;
-                    for (it = stmts.begin(); it != stmts.end(); it++)
-                        if ((*it)->getNumber() == n) {
-                            watches.insert(*it);
-                            q_cout << "watching " << *it << "\n";
-                        }
-
-                }
+                StatementList::iterator it;
+                for (it = stmts.begin(); it != stmts.end(); it++)
+                    if ((*it)->getNumber() == n) {
+                        watches.insert(*it);
+                        q_cout << "watching " << *it << "\n";
+                    }
             } else
                 break;
         }
@@ -917,10 +973,10 @@ IBinarySymbolTable *Boomerang::getSymbols()
 
 void Boomerang::alertDecompileDebugPoint(UserProc *p, const char *description) {
     if (stopAtDebugPoints) {
+        p->takeSnapshot(description);
         miniDebugger(p,description);
     }
-    for (Watcher *elem : watchers)
-        elem->alertDecompileDebugPoint(p, description);
+    DecompilerContext::alertDecompileDebugPoint(p, description);
 }
 //! Return TextStream to which given \a level of messages shoudl be directed
 //! \param level - describes the message level TODO: describe message levels
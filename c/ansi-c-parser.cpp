@@ -586,9 +586,10 @@ int AnsiCParser::yyparse(platform plat, callconv cc) {
         break;
     }
     case 27: {
-        if (yyvsp[-1].type_ident->ty->isArray() ||
-            (yyvsp[-1].type_ident->ty->isNamed() && std::static_pointer_cast<NamedType>(yyvsp[-1].type_ident->ty)->resolvesTo() &&
-             std::static_pointer_cast<NamedType>(yyvsp[-1].type_ident->ty)->resolvesTo()->isArray())) {
+        SharedType resolved;
+        if (yyvsp[-1].type_ident->ty->isNamed())
+            resolved = resolveNamedType(std::static_pointer_cast<NamedType>(yyvsp[-1].type_ident->ty)->getName());
+        if (yyvsp[-1].type_ident->ty->isArray() || (resolved && resolved->isArray())) {
             /* C has complex semantics for passing arrays.. seeing as
                      * we're supposedly parsing C, then we should deal with this.
                      * When you pass an array in C it is understood that you are
@@ -628,7 +629,7 @@ int AnsiCParser::yyparse(platform plat, callconv cc) {
         break;
     }
     case 30: {
-        Type::addNamedType(yyvsp[-1].type_ident->nam, yyvsp[-1].type_ident->ty);
+        defineType(yyvsp[-1].type_ident->nam, yyvsp[-1].type_ident->ty);
         break;
     }
     case 31: {
@@ -642,7 +643,7 @@ int AnsiCParser::yyparse(platform plat, callconv cc) {
                 delete elem;
             }
         delete yyvsp[-2].param_list;
-        Type::addNamedType(yyvsp[-5].str, PointerType::get(FuncType::get(sig)));
+        defineType(yyvsp[-5].str, PointerType::get(FuncType::get(sig)));
 
         break;
     }
@@ -657,7 +658,7 @@ int AnsiCParser::yyparse(platform plat, callconv cc) {
                 delete elem;
             }
         delete yyvsp[-2].param_list;
-        Type::addNamedType(yyvsp[-4].type_ident->nam, FuncType::get(sig));
+        defineType(yyvsp[-4].type_ident->nam, FuncType::get(sig));
 
         break;
     }
@@ -666,7 +667,7 @@ int AnsiCParser::yyparse(platform plat, callconv cc) {
         for (auto &elem : *yyvsp[-2].type_ident_list) {
             t->addType(elem->ty, elem->nam);
         }
-        Type::addNamedType(QString("struct %1").arg(yyvsp[-4].str), t);
+        defineType(QString("struct %1").arg(yyvsp[-4].str), t);
         break;
     }
     case 34: {
@@ -1099,6 +1100,27 @@ void AnsiCParser::yyerror(const char *s) {
     printf("\n%*s\n%*s on line %i\n", theScanner->column, "^", theScanner->column, s, theScanner->theLine);
 }
 
+//! Note the named type \a name, defined by the file, in namedTypes
+void AnsiCParser::defineType(const QString &name, SharedType ty) {
+    namedTypes.emplace_back(name, ty);
+    lastDefinitions[name] = ty;
+}
+
+//! What the named type \a name stands for: as the file last defined it, else as the decompiler knows it
+SharedType AnsiCParser::resolveNamedType(const QString &name) const {
+    auto it = lastDefinitions.find(name);
+    SharedType ty = it != lastDefinitions.end() ? it->second : Type::getNamedType(name);
+    if (ty && ty->isNamed())
+        return resolveNamedType(std::static_pointer_cast<NamedType>(ty)->getName());
+    return ty;
+}
+
+//! Add the named types the file defined (in namedTypes) to those of the decompiler, in the order they were defined
+void AnsiCParser::defineNamedTypes() {
+    for (const std::pair<QString, SharedType> &t : namedTypes)
+        Type::addNamedType(t.first, t.second);
+}
+
 AnsiCParser::~AnsiCParser() {
     // Suppress warnings from gcc about lack of virtual destructor
 }
@@ -5,6 +5,7 @@
 #define YY_AnsiCParser_DEBUG 1
 
 #include <list>
+#include <map>
 #include <memory>
 #include <string>
 #include "exp.h"
@@ -190,10 +191,17 @@ class AnsiCParser {
   public:
   private:
     AnsiCScanner *theScanner;
+    std::map<QString, SharedType> lastDefinitions; //!< The last definition of each name in namedTypes
+    void defineType(const QString &name, SharedType ty);
+    SharedType resolveNamedType(const QString &name) const;
 
   public:
     std::list<Signature *> signatures;
     std::list<Symbol *> symbols;
     std::list<SymbolRef *> refs;
+    //! The typedefs and structs of the file. They are only kept here, so that files can be parsed on several threads;
+    //! defineNamedTypes() makes them known to the decompiler
+    std::list<std::pair<QString, SharedType>> namedTypes;
+    void defineNamedTypes();
     virtual ~AnsiCParser();
 };
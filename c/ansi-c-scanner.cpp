@@ -336,8 +336,7 @@ static const short int yy_chk[546] = {
     345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345,
     345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345, 345};
 
-static yy_state_type yy_last_accepting_state;
-static YY_CHAR *yy_last_accepting_cpos;
+// yy_last_accepting_state and yy_last_accepting_cpos are members of the scanner (see ansi-c.l)
 
 #if YY_AnsiCScanner_DEBUG != 0
 static const short int yy_rule_linenum[111] = {
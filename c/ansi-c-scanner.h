@@ -71,6 +71,9 @@
     int column;                                                                                                        \
                                                                                                                        \
   private:                                                                                                             \
+    /* The matcher's state, which flex keeps in statics: here, each scanner can run on its own thread */               \
+    int yy_last_accepting_state;                                                                                       \
+    char *yy_last_accepting_cpos;                                                                                      \
     void count();                                                                                                      \
     void comment();                                                                                                    \
     void commentEOL();                                                                                                 \
@@ -27,10 +27,16 @@
 %define MEMBERS \
 private:		\
 	AnsiCScanner *theScanner; \
+	std::map<QString, SharedType> lastDefinitions; /* The last definition of each name in namedTypes */ \
+	void defineType(const QString &name, SharedType ty); \
+	SharedType resolveNamedType(const QString &name) const; \
 public: \
 	std::list<Signature*> signatures; \
 	std::list<Symbol*> symbols; \
 	std::list<SymbolRef*> refs;\
+	/* The typedefs and structs of the file, kept here so that files can be parsed on several threads */ \
+	std::list<std::pair<QString, SharedType> > namedTypes; \
+	void defineNamedTypes(); \
 	virtual ~AnsiCParser();
 
 
@@ -256,8 +262,8 @@ optional_bound: MAXBOUND IDENTIFIER ')'
 param: type_ident optional_bound
 	 {	if ($1->ty->isArray() || 
 			($1->ty->isNamed() && 
-			 ((NamedType*)$1->ty)->resolvesTo() &&
-			 ((NamedType*)$1->ty)->resolvesTo()->isArray())) {
+			 resolveNamedType(((NamedType*)$1->ty)->getName()) &&
+			 resolveNamedType(((NamedType*)$1->ty)->getName())->isArray())) {
 			/* C has complex semantics for passing arrays.. seeing as 
 			 * we're supposedly parsing C, then we should deal with this.
 			 * When you pass an array in C it is understood that you are
@@ -293,7 +299,7 @@ param: type_ident optional_bound
 	 ;
 
 type_decl: TYPEDEF type_ident ';'
-		 { Type::addNamedType($2->nam.c_str(), $2->ty); }
+		 { defineType($2->nam.c_str(), $2->ty); }
 		 | TYPEDEF type '(' '*' IDENTIFIER ')' '(' param_list ')' ';'
 		 { Signature *sig = Signature::instantiate(plat, cc, NULL);
 		   sig->addReturn($2);
@@ -306,7 +312,7 @@ type_decl: TYPEDEF type_ident ';'
 				   delete *it;
 			   }
 		   delete $8;
-		   Type::addNamedType($5, new PointerType(new FuncType(sig))); 
+		   defineType($5, new PointerType(new FuncType(sig))); 
 		 }
 		 | TYPEDEF type_ident '(' param_list ')' ';'
 		 { Signature *sig = Signature::instantiate(plat, cc, $2->nam.c_str());
@@ -320,7 +326,7 @@ type_decl: TYPEDEF type_ident ';'
 				   delete *it;
 			   }
 		   delete $4;
-		   Type::addNamedType($2->nam.c_str(), new FuncType(sig)); 
+		   defineType($2->nam.c_str(), new FuncType(sig)); 
 		 } 
 		 | STRUCT IDENTIFIER '{' type_ident_list '}' ';'
 		 { CompoundType *t = new CompoundType(); 
@@ -330,7 +336,7 @@ type_decl: TYPEDEF type_ident ';'
 		   }
 		   char tmp[1024];
 		   sprintf(tmp, "struct %s", $2);
-		   Type::addNamedType(tmp, t); 
+		   defineType(tmp, t); 
 		 }
 		 ;
 
@@ -561,6 +567,27 @@ void AnsiCParser::yyerror(char *s)
 	printf("\n%*s\n%*s on line %i\n", theScanner->column, "^", theScanner->column, s, theScanner->theLine);
 }
 
+void AnsiCParser::defineType(const QString &name, SharedType ty)
+{
+	namedTypes.push_back(std::make_pair(name, ty));
+	lastDefinitions[name] = ty;
+}
+
+SharedType AnsiCParser::resolveNamedType(const QString &name) const
+{
+	std::map<QString, SharedType>::const_iterator it = lastDefinitions.find(name);
+	SharedType ty = it != lastDefinitions.end() ? it->second : Type::getNamedType(name);
+	if (ty && ty->isNamed())
+		return resolveNamedType(std::static_pointer_cast<NamedType>(ty)->getName());
+	return ty;
+}
+
+void AnsiCParser::defineNamedTypes()
+{
+	for (std::list<std::pair<QString, SharedType> >::iterator it = namedTypes.begin(); it != namedTypes.end(); it++)
+		Type::addNamedType(it->first, it->second);
+}
+
 AnsiCParser::~AnsiCParser()
 {
 	// Suppress warnings from gcc about lack of virtual destructor
@@ -9,6 +9,7 @@
 #include "ansi-c-parser.h"
 
 #include <sstream>
+#include <thread>
 /***************************************************************************/ /**
   * FUNCTION:        CTest::testSignature
   * OVERVIEW:        Test
@@ -30,4 +31,47 @@ void CTest::testSignature() {
     QVERIFY(sig->hasEllipsis());
     delete p;
 }
+/***************************************************************************/ /**
+  * FUNCTION:        CTest::testNamedTypes
+  * OVERVIEW:        Test that typedefs stay with the parser until defineNamedTypes(), and are still seen by the
+  *                  rest of the file
+  *============================================================================*/
+void CTest::testNamedTypes() {
+    std::istringstream os("typedef char ctest_buf[16];\nint ctest_fill(ctest_buf b);");
+    AnsiCParser *p = new AnsiCParser(os, false);
+    p->yyparse(PLAT_PENTIUM, CONV_C);
+    QCOMPARE(p->namedTypes.size(), size_t(1));
+    QCOMPARE(p->namedTypes.front().first, QString("ctest_buf"));
+    QVERIFY(Type::getNamedType("ctest_buf") == nullptr);
+    // An array parameter is passed by reference, even through a typedef of this file
+    QCOMPARE(p->signatures.size(), size_t(1));
+    QVERIFY(p->signatures.front()->getParamType(0)->isPointer());
+    p->defineNamedTypes();
+    QVERIFY(Type::getNamedType("ctest_buf") != nullptr);
+    delete p;
+}
+
+/***************************************************************************/ /**
+  * FUNCTION:        CTest::testConcurrentParse
+  * OVERVIEW:        Test that two parsers can run on two threads at once
+  *============================================================================*/
+void CTest::testConcurrentParse() {
+    QString text;
+    for (int i = 0; i < 500; i++)
+        text += QString("typedef int ctest_t%1;\nint ctest_f%1(char *fmt, ctest_t%1 n, ...);\n").arg(i);
+    std::istringstream is1(text.toStdString()), is2(text.toStdString());
+    AnsiCParser *p1 = new AnsiCParser(is1, false);
+    AnsiCParser *p2 = new AnsiCParser(is2, false);
+    std::thread other([p2]() { p2->yyparse(PLAT_SPARC, CONV_C); });
+    p1->yyparse(PLAT_PENTIUM, CONV_C);
+    other.join();
+    QCOMPARE(p1->signatures.size(), size_t(500));
+    QCOMPARE(p2->signatures.size(), size_t(500));
+    QCOMPARE(p1->namedTypes.size(), size_t(500));
+    QCOMPARE(p2->namedTypes.size(), size_t(500));
+    QCOMPARE(p2->signatures.back()->getName(), QString("ctest_f499"));
+    QCOMPARE(p2->signatures.back()->getNumParams(), p1->signatures.back()->getNumParams());
+    delete p1;
+    delete p2;
+}
 QTEST_MAIN(CTest)
@@ -3,4 +3,6 @@ class CTest : public QObject {
     Q_OBJECT
 private slots:
     void testSignature();
+    void testNamedTypes();
+    void testConcurrentParse();
 };
@@ -39,10 +39,10 @@ static bool isBareMemof(const Exp &e, UserProc *proc);
 // extern char *operStrings[];
 
 /// Empty constructor, calls HLLCode()
-CHLLCode::CHLLCode() : HLLCode() {}
+CHLLCode::CHLLCode() : HLLCode(), out(&code) {}
 
 /// Empty constructor, calls HLLCode(p)
-CHLLCode::CHLLCode(UserProc *p) : HLLCode(p) {}
+CHLLCode::CHLLCode(UserProc *p) : HLLCode(p), out(&code) {}
 
 /// Empty destructor
 CHLLCode::~CHLLCode() {}
@@ -921,13 +921,23 @@ void CHLLCode::appendType(QTextStream &str, SharedType typ) {
         str << "int"; // Default type for C
         return;
     }
+    str << getCtype(typ);
+}
+
+/// The C spelling of \a typ, made by Type::getCtype the first time it is asked for and kept (see \a ctypes): the
+/// locals, casts and members of a proc repeat the same few types, some of them large structs from the signatures
+const QString &CHLLCode::getCtype(const SharedType &typ) {
+    auto it = ctypes.find(typ.get());
+    if (it != ctypes.end())
+        return it->second.second;
+    SharedType spelt = typ;
     if (typ->resolvesToPointer() && typ->asPointer()->getPointsTo()->resolvesToArray()) {
         // C programmers prefer to see pointers to arrays as pointers
         // to the first element of the array.  They then use syntactic
         // sugar to access a pointer as if it were an array.
-        typ = PointerType::get(typ->asPointer()->getPointsTo()->asArray()->getBaseType());
+        spelt = PointerType::get(typ->asPointer()->getPointsTo()->asArray()->getBaseType());
     }
-    str << typ->getCtype(true);
+    return ctypes.emplace(typ.get(), std::make_pair(typ, spelt->getCtype(true))).first->second.second;
 }
 
 /**
@@ -965,173 +975,160 @@ void CHLLCode::appendTypeIdent(QTextStream &str, SharedType typ, QString ident)
 }
 
 /// Remove all generated code.
-void CHLLCode::reset() { lines.clear(); }
+void CHLLCode::reset() {
+    out.flush();
+    code.clear();
+    labels.clear();
+    stmtRanges.clear();
+    ctypes.clear();
+}
 
 /// Adds: while( \a cond) {
 void CHLLCode::AddPretestedLoopHeader(int indLevel, Exp *cond) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "while (";
     appendExp(s, *cond, PREC_NONE);
     s << ") {";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: }
 void CHLLCode::AddPretestedLoopEnd(int indLevel) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "}";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: for(;;) {
 void CHLLCode::AddEndlessLoopHeader(int indLevel) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "for(;;) {";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: }
 void CHLLCode::AddEndlessLoopEnd(int indLevel) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "}";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: do {
 void CHLLCode::AddPosttestedLoopHeader(int indLevel) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "do {";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: } while (\a cond);
 void CHLLCode::AddPosttestedLoopEnd(int indLevel, Exp *cond) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "} while (";
     appendExp(s, *cond, PREC_NONE);
     s << ");";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: switch(\a cond) {
 void CHLLCode::AddCaseCondHeader(int indLevel, Exp *cond) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "switch(";
     appendExp(s, *cond, PREC_NONE);
     s << ") {";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: case \a opt :
 void CHLLCode::AddCaseCondOption(int indLevel, Exp &opt) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "case ";
     appendExp(s, opt, PREC_NONE);
     s << ":";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: break;
 void CHLLCode::AddCaseCondOptionEnd(int indLevel) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "break;";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: default:
 void CHLLCode::AddCaseCondElse(int indLevel) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "default:";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: }
 void CHLLCode::AddCaseCondEnd(int indLevel) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "}";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: if(\a cond) {
 void CHLLCode::AddIfCondHeader(int indLevel, Exp *cond) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "if (";
     appendExp(s, *cond, PREC_NONE);
     s << ") {";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: }
 void CHLLCode::AddIfCondEnd(int indLevel) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "}";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: if(\a cond) {
 void CHLLCode::AddIfElseCondHeader(int indLevel, Exp *cond) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "if (";
     appendExp(s, *cond, PREC_NONE);
     s << ") {";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: } else {
 void CHLLCode::AddIfElseCondOption(int indLevel) {
-    QString tgt;
-
-    QTextStream s(&tgt);
-
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "} else {";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: }
 void CHLLCode::AddIfElseCondEnd(int indLevel) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "}";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: goto L \em ord
 void CHLLCode::AddGoto(int indLevel, int ord) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "goto L" << ord << ";";
-    appendLine(tgt);
+    endLine();
     usedLabels.insert(ord);
 }
 
@@ -1140,51 +1137,43 @@ void CHLLCode::AddGoto(int indLevel, int ord) {
  * maxOrd UNUSED
  */
 void CHLLCode::RemoveUnusedLabels(int /*maxOrd*/) {
-    for (QStringList::iterator it = lines.begin(); it != lines.end();) {
-        if (it->startsWith('L') && it->contains(':')) {
-            QStringRef sxr = it->midRef(1,it->indexOf(':')-1);
-            int n = sxr.toInt();
-            if (usedLabels.find(n) == usedLabels.end()) {
-                it = lines.erase(it);
-                continue;
-            }
-        }
-        it++;
-    }
+    for (Label &lab : labels)
+        if (usedLabels.find(lab.ord) == usedLabels.end())
+            lab.removed = true;
 }
 
 /// Adds: continue;
 void CHLLCode::AddContinue(int indLevel) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "continue;";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: break;
 void CHLLCode::AddBreak(int indLevel) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "break;";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: L \a ord :
 void CHLLCode::AddLabel(int /*indLevel*/, int ord) {
-    QString tgt;
-    QTextStream s(&tgt);
-    s << "L" << ord << ":";
-    appendLine(tgt);
+    out.flush();
+    Label lab{ord, code.size(), 0, false};
+    out << "L" << ord << ":";
+    endLine();
+    out.flush();
+    lab.end = code.size();
+    labels.push_back(lab);
 }
 
 /// Search for the label L \a ord and remove it from the generated code.
 void CHLLCode::RemoveLabel(int ord) {
-    QString tgt;
-    QTextStream s(&tgt);
-    s << "L" << ord << ":";
-    lines.removeAll(tgt);
+    for (Label &lab : labels)
+        if (lab.ord == ord)
+            lab.removed = true;
 }
 
 bool isBareMemof(const Exp &e, UserProc * /*proc*/) {
@@ -1213,9 +1202,6 @@ void CHLLCode::AddAssignmentStatement(int indLevel, Assign *asgn) {
     // if (asgn->getLeft()->isFlags())
     //    return;
 
-    QString tgt;
-    QTextStream s(&tgt);
-    indent(s, indLevel);
     SharedType asgnType = asgn->getType();
     Exp *lhs = asgn->getLeft();
     Exp *rhs = asgn->getRight();
@@ -1224,6 +1210,9 @@ void CHLLCode::AddAssignmentStatement(int indLevel, Assign *asgn) {
     if (*lhs == *rhs)
         return; // never want to see a = a;
 
+    QTextStream &s(out);
+    indent(s, indLevel);
+
     if (Boomerang::get()->noDecompile && isBareMemof(*rhs, proc) && lhs->getOper() == opRegOf &&
         m_proc->getProg()->getFrontEndId() == PLAT_SPARC) {
         // add some fsize hints to rhs
@@ -1257,7 +1246,7 @@ void CHLLCode::AddAssignmentStatement(int indLevel, Assign *asgn) {
         s << ", ";
         appendExp(s, *rhs, PREC_UNARY);
         s << ");";
-        appendLine(tgt);
+        endLine();
         return;
     }
 
@@ -1279,7 +1268,7 @@ void CHLLCode::AddAssignmentStatement(int indLevel, Assign *asgn) {
         rhs = rhs->simplify();
         appendExp(s, *rhs, PREC_ASSIGN);
         s << ";";
-        appendLine(tgt);
+        endLine();
         return;
     } else
         appendExp(s, *lhs, PREC_ASSIGN); // Ordinary LHS
@@ -1300,7 +1289,7 @@ void CHLLCode::AddAssignmentStatement(int indLevel, Assign *asgn) {
         appendExp(s, *rhs, PREC_ASSIGN);
     }
     s << ";";
-    appendLine(tgt);
+    endLine();
 }
 
 /**
@@ -1317,8 +1306,7 @@ void CHLLCode::AddAssignmentStatement(int indLevel, Assign *asgn) {
  */
 void CHLLCode::AddCallStatement(int indLevel, Function *proc, const QString &name, StatementList &args,
                                 StatementList *results) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     if (not results->empty()) {
         // FIXME: Needs changing if more than one real result (return a struct)
@@ -1371,7 +1359,7 @@ void CHLLCode::AddCallStatement(int indLevel, Function *proc, const QString &nam
         s << " */";
     }
 
-    appendLine(tgt);
+    endLine();
 }
 
 /**
@@ -1387,23 +1375,22 @@ void CHLLCode::AddCallStatement(int indLevel, Function *proc, const QString &nam
 void CHLLCode::AddIndCallStatement(int indLevel, Exp *exp, StatementList &args, StatementList * results) {
     Q_UNUSED(results);
     //    FIXME: Need to use 'results', since we can infer some defines...
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "(*";
     appendExp(s, *exp, PREC_NONE);
     s << ")(";
-    QStringList arg_strings;
-    QString arg_tgt;
+    bool first = true;
     for (Instruction * ss : args) {
-        QTextStream arg_str(&arg_tgt);
+        if (first)
+            first = false;
+        else
+            s << ", ";
         Exp *arg = ((Assign *)ss)->getRight();
-        appendExp(arg_str, *arg, PREC_COMMA);
-        arg_strings<<arg_tgt;
-        arg_tgt.clear();
+        appendExp(s, *arg, PREC_COMMA);
     }
-    s << arg_strings.join(", ") << ");";
-    appendLine(tgt);
+    s << ");";
+    endLine();
 }
 
 /**
@@ -1414,8 +1401,7 @@ void CHLLCode::AddReturnStatement(int indLevel, StatementList *rets) {
     // FIXME: should be returning a struct of more than one real return */
     // The stack pointer is wanted as a define in calls, and so appears in returns, but needs to be removed here
     StatementList::iterator rr;
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, indLevel);
     s << "return";
     size_t n = rets->size();
@@ -1445,17 +1431,16 @@ void CHLLCode::AddReturnStatement(int indLevel, StatementList *rets) {
         if (n > 1)
             s << " */";
     }
-    appendLine(tgt);
+    endLine();
 }
 
 /**
  * Print the start of a function, and also as a comment its address.
  */
 void CHLLCode::AddProcStart(UserProc *proc) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     s << "// address: 0x" << proc->getNativeAddress();
-    appendLine(tgt);
+    endLine();
     AddProcDec(proc, true);
 }
 
@@ -1468,8 +1453,7 @@ void CHLLCode::AddPrototype(UserProc *proc) { AddProcDec(proc, false); }
  * \param open False if this is just a prototype and ";" should be printed instead of "{"
  */
 void CHLLCode::AddProcDec(UserProc *proc, bool open) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     ReturnStatement *returns = proc->getTheReturnStatement();
     SharedType retType;
     if (proc->getSignature()->isForced()) {
@@ -1545,7 +1529,7 @@ void CHLLCode::AddProcDec(UserProc *proc, bool open) {
         s << " {";
     else
         s << ";\n";
-    appendLine(tgt);
+    endLine();
 }
 
 /// Adds: }
@@ -1561,8 +1545,7 @@ void CHLLCode::AddProcEnd() {
  * \param last true if an empty line should be added.
  */
 void CHLLCode::AddLocal(const QString &name, SharedType type, bool last) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
     indent(s, 1);
     appendTypeIdent(s, type, name);
     const Exp *e = m_proc->expFromSymbol(name);
@@ -1579,7 +1562,7 @@ void CHLLCode::AddLocal(const QString &name, SharedType type, bool last) {
         }
     } else
         s << ";";
-    appendLine(tgt);
+    endLine();
     locals[name] = type->clone();
     if (last)
         appendLine("");
@@ -1592,8 +1575,49 @@ void CHLLCode::AddLocal(const QString &name, SharedType type, bool last) {
  * \param init The initial value of the global.
  */
 void CHLLCode::AddGlobal(const QString &name, SharedType type, Exp *init) {
-    QString tgt;
-    QTextStream s(&tgt);
+    QTextStream &s(out);
+    appendGlobalDecl(s, name, type);
+    if (init && !init->isNil()) {
+        s << " = ";
+        SharedType base_type = type->isArray() ? type->asArray()->getBaseType() : type;
+        appendExp(s, *init, PREC_ASSIGN, base_type->isInteger() ? !base_type->asInteger()->isSigned() : false);
+    }
+    endGlobal(s, type);
+}
+
+/**
+ * Add the declaration for an array global, with its elements as \a init produces them. They are laid out as an opList
+ * of them would be.
+ */
+void CHLLCode::AddGlobal(const QString &name, SharedType type, ArrayInitializer &init) {
+    QTextStream &s(out);
+    appendGlobalDecl(s, name, type);
+    const Exp *elem = init.next();
+    if (elem) {
+        SharedType base_type = type->isArray() ? type->asArray()->getBaseType() : type;
+        bool uns = base_type->isInteger() ? !base_type->asInteger()->isSigned() : false;
+        int elems_on_line = 0;
+        s << " = { ";
+        if (elem->getOper() == opList)
+            s << "\n ";
+        for (;;) {
+            bool list = elem->getOper() == opList;
+            appendExp(s, *elem, PREC_NONE, uns);
+            elem = init.next();
+            if (elem == nullptr)
+                break;
+            if (list || ++elems_on_line >= 16) {
+                s << ",\n ";
+                elems_on_line = 0;
+            } else
+                s << ", ";
+        }
+        s << " }";
+    }
+    endGlobal(s, type);
+}
+
+void CHLLCode::appendGlobalDecl(QTextStream &s, const QString &name, SharedType type) {
     // Check for array types. These are declared differently in C than
     // they are printed
     if (type->isArray()) {
@@ -1614,20 +1638,34 @@ void CHLLCode::AddGlobal(const QString &name, SharedType type, Exp *init) {
         appendType(s, type);
         s << " " << name;
     }
-    if (init && !init->isNil()) {
-        s << " = ";
-        SharedType base_type = type->isArray() ? type->asArray()->getBaseType() : type;
-        appendExp(s, *init, PREC_ASSIGN, base_type->isInteger() ? !base_type->asInteger()->isSigned() : false);
-    }
+}
+
+void CHLLCode::endGlobal(QTextStream &s, SharedType type) {
     s << ";";
     if (type->isSize())
         s << "// " << type->getSize() / 8 << " bytes";
-    appendLine(tgt);
+    endLine();
 }
 
-/// Dump all generated code to \a os.
+/// Dump all generated code to \a os, leaving out the labels that have been removed. The lines are separated, not
+/// terminated, by newlines.
 void CHLLCode::print(QTextStream &os) {
-    os << lines.join('\n');
+    out.flush();
+    std::vector<QStringRef> pieces;
+    int pos = 0;
+    for (const Label &lab : labels) {
+        if (!lab.removed)
+            continue;
+        pieces.push_back(code.midRef(pos, lab.start - pos));
+        pos = lab.end;
+    }
+    pieces.push_back(code.midRef(pos));
+    while (!pieces.empty() && pieces.back().isEmpty())
+        pieces.pop_back();
+    if (!pieces.empty())
+        pieces.back() = pieces.back().left(pieces.back().size() - 1); // The newline ending the last line
+    for (const QStringRef &piece : pieces)
+        os << piece;
     if (m_proc == nullptr)
         os << '\n';
 }
@@ -1637,6 +1675,37 @@ void CHLLCode::AddLineComment(const QString &cmt) {
     appendLine(QString("/* %1*/").arg(cmt));
 }
 
+void CHLLCode::StartStatement(Instruction *s) {
+    out.flush();
+    current.begin = code.size();
+    current.stmt = s;
+}
+
+void CHLLCode::EndStatement() {
+    out.flush();
+    current.end = code.size();
+    if (current.end > current.begin && code[current.end - 1] == '\n')
+        current.end--;
+    if (current.end > current.begin) // Most statements other than assignments, calls and returns generate nothing
+        stmtRanges.push_back(current);
+}
+
+/// Append where the code of each statement is in what print() writes, taking out the labels it leaves out
+void CHLLCode::getStmtRanges(std::vector<StmtRange> &ranges) const {
+    unsigned removed = 0; // Length of the removed labels before the current range
+    auto lab = labels.begin();
+    for (const StmtRange &r : stmtRanges) {
+        for (; lab != labels.end() && (unsigned)lab->start < r.begin; ++lab)
+            if (lab->removed)
+                removed += lab->end - lab->start;
+        ranges.push_back(StmtRange{r.begin - removed, r.end - removed, r.stmt});
+    }
+}
+
 // Private helper functions, to reduce redundant code, and
 // have a single place to put a breakpoint on.
-void CHLLCode::appendLine(const QString &s) { lines.push_back(s); }
+void CHLLCode::appendLine(const QString &s) {
+    out << s;
+    endLine();
+}
+void CHLLCode::endLine() { out << '\n'; }
@@ -17,8 +17,14 @@
 #ifndef _CHLLCODE_H_
 #define _CHLLCODE_H_
 #include "hllcode.h"
+
+#include <QtCore/QString>
+#include <QtCore/QTextStream>
 #include <string>
 #include <sstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 class BasicBlock;
 class Exp;
@@ -76,12 +82,29 @@ enum PREC {
 /// Outputs C code.
 class CHLLCode : public HLLCode {
   private:
-    /// The generated code.
-    QStringList lines;
+    /// The generated code, one line after the other, each ending with a newline. The statements are written straight
+    /// into it through \a out rather than line by line.
+    QString code;
+    QTextStream out;
+    /// A label line of \a code, from \a start up to \a end. Removed labels are only left out by print()
+    struct Label {
+        int ord;
+        int start;
+        int end;
+        bool removed;
+    };
+    std::vector<Label> labels;
+    /// Where the code of each statement is in \a code, without the newline ending it
+    std::vector<StmtRange> stmtRanges;
+    StmtRange current; ///< The statement being generated, between StartStatement() and EndStatement()
+    /// The C spelling of each type written so far, by the type object. The types are held so that their addresses are
+    /// not reused by other types; they do not change while code is generated
+    std::unordered_map<const Type *, std::pair<SharedType, QString>> ctypes;
 
     void indent(QTextStream &str, int indLevel);
     void appendExp(QTextStream &str, const Exp &exp, PREC curPrec, bool uns = false);
     void appendType(QTextStream &str, SharedType typ);
+    const QString &getCtype(const SharedType &typ);
     void appendTypeIdent(QTextStream &str, SharedType typ, QString ident);
     /// Adds: (
     void openParen(QTextStream &str, PREC outer, PREC inner) {
@@ -95,6 +118,7 @@ class CHLLCode : public HLLCode {
     }
 
     void appendLine(const QString &s);
+    void endLine();
 
     /// All locals in a Proc
     std::map<QString, SharedType > locals;
@@ -167,14 +191,21 @@ class CHLLCode : public HLLCode {
     virtual void AddProcEnd();
     virtual void AddLocal(const QString &name, SharedType type, bool last = false);
     virtual void AddGlobal(const QString &name, SharedType type, Exp *init = nullptr);
+    virtual void AddGlobal(const QString &name, SharedType type, ArrayInitializer &init);
     virtual void AddPrototype(UserProc *proc);
 
   private:
     void AddProcDec(UserProc *proc, bool open); // Implement AddProcStart and AddPrototype
+    void appendGlobalDecl(QTextStream &s, const QString &name, SharedType type); // Implement AddGlobal
+    void endGlobal(QTextStream &s, SharedType type);
   public:
     // comments
     virtual void AddLineComment(const QString &cmt);
 
+    virtual void StartStatement(Instruction *s);
+    virtual void EndStatement();
+    virtual void getStmtRanges(std::vector<StmtRange> &ranges) const;
+
     /*
                  * output functions
                  */
@@ -35,6 +35,8 @@ void PRINT_BEFORE_AFTER(SyntaxNode *root,SyntaxNode *n) {
 
 SyntaxNode::SyntaxNode() : pbb(nullptr), score(-1), correspond(nullptr), notGoto(false) { nodenum = nodecount++; }
 
+// The nodes of a tree, and their conditions, are all in the arena of UserProc::getAST(), which destroys each of them
+// when it is released; so a node does not delete its children, which would destroy them twice
 SyntaxNode::~SyntaxNode() {}
 
 int SyntaxNode::getScore() {
@@ -49,10 +51,7 @@ bool SyntaxNode::isBranch() { return pbb && pbb->getType() == BBTYPE::TWOWAY; }
 
 BlockSyntaxNode::BlockSyntaxNode() {}
 
-BlockSyntaxNode::~BlockSyntaxNode() {
-    for (auto &elem : statements)
-        delete elem;
-}
+BlockSyntaxNode::~BlockSyntaxNode() {}
 
 size_t BlockSyntaxNode::getNumOutEdges() {
     if (pbb)
@@ -401,7 +400,7 @@ SyntaxNode *BlockSyntaxNode::replace(SyntaxNode *from, SyntaxNode *to) {
 
 IfThenSyntaxNode::IfThenSyntaxNode() : pThen(nullptr), cond(nullptr) {}
 
-IfThenSyntaxNode::~IfThenSyntaxNode() { delete pThen; }
+IfThenSyntaxNode::~IfThenSyntaxNode() {}
 
 SyntaxNode *IfThenSyntaxNode::getOutEdge(SyntaxNode *root, size_t /*n*/) {
     SyntaxNode *n1 = root->findNodeFor(pbb->getOutEdge(0));
@@ -457,12 +456,7 @@ void IfThenSyntaxNode::printAST(SyntaxNode *root, QTextStream &os) {
 
 IfThenElseSyntaxNode::IfThenElseSyntaxNode() : pThen(nullptr), pElse(nullptr), cond(nullptr) {}
 
-IfThenElseSyntaxNode::~IfThenElseSyntaxNode() {
-    if (pThen)
-        delete pThen;
-    if (pElse)
-        delete pElse;
-}
+IfThenElseSyntaxNode::~IfThenElseSyntaxNode() {}
 
 int IfThenElseSyntaxNode::evaluate(SyntaxNode *root) {
     int n = 1;
@@ -546,12 +540,7 @@ void IfThenElseSyntaxNode::printAST(SyntaxNode *root, QTextStream &os) {
 
 PretestedLoopSyntaxNode::PretestedLoopSyntaxNode() : pBody(nullptr), cond(nullptr) {}
 
-PretestedLoopSyntaxNode::~PretestedLoopSyntaxNode() {
-    if (pBody)
-        delete pBody;
-    if (cond)
-        delete cond;
-}
+PretestedLoopSyntaxNode::~PretestedLoopSyntaxNode() {}
 
 SyntaxNode *PretestedLoopSyntaxNode::getOutEdge(SyntaxNode *root, size_t /*n*/) {
     return root->findNodeFor(pbb->getOutEdge(1));
@@ -618,12 +607,7 @@ void PretestedLoopSyntaxNode::printAST(SyntaxNode *root, QTextStream &os) {
 
 PostTestedLoopSyntaxNode::PostTestedLoopSyntaxNode() : pBody(nullptr), cond(nullptr) {}
 
-PostTestedLoopSyntaxNode::~PostTestedLoopSyntaxNode() {
-    if (pBody)
-        delete pBody;
-    if (cond)
-        delete cond;
-}
+PostTestedLoopSyntaxNode::~PostTestedLoopSyntaxNode() {}
 
 SyntaxNode *PostTestedLoopSyntaxNode::getOutEdge(SyntaxNode *root, size_t /*n*/) {
     return root->findNodeFor(pbb->getOutEdge(1));
@@ -693,10 +677,7 @@ void PostTestedLoopSyntaxNode::printAST(SyntaxNode *root, QTextStream &os) {
 
 InfiniteLoopSyntaxNode::InfiniteLoopSyntaxNode() : pBody(nullptr) {}
 
-InfiniteLoopSyntaxNode::~InfiniteLoopSyntaxNode() {
-    if (pBody)
-        delete pBody;
-}
+InfiniteLoopSyntaxNode::~InfiniteLoopSyntaxNode() {}
 
 int InfiniteLoopSyntaxNode::evaluate(SyntaxNode *root) {
     int n = 1;
@@ -4,6 +4,7 @@
 
 #include <QDebug>
 #include <algorithm>
+#include <cstring>
 
 using namespace boost::icl;
 namespace {
@@ -31,6 +32,45 @@ int Read4(const int *pi,bool bigEndian)  {
     } else
         return (int)(Read2(p,bigEndian) + (Read2(p + 1,bigEndian) << 16));
 }
+
+#ifdef WORDS_BIGENDIAN
+const bool HOST_BIG_ENDIAN = true;
+#else
+const bool HOST_BIG_ENDIAN = false;
+#endif
+
+inline uint16_t swapBytes(uint16_t v) { return (uint16_t)((v >> 8) | (v << 8)); }
+inline uint32_t swapBytes(uint32_t v) {
+    return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+/***************************************************************************/ /**
+  * \brief    Convert the \a count words at host address \a p, of a source machine that is big endian when
+  * \a SourceBigEndian, into host words in \a out
+  *
+  * The words are copied in one go, then swapped in a loop with no dependence between the words, which the compiler
+  * turns into vector byte shuffles; when source and host agree there is nothing more than the copy.
+  ******************************************************************************/
+template <bool SourceBigEndian, typename T> void readWords(const char *p, T *out, size_t count) {
+    std::memcpy(out, p, count * sizeof(T));
+    if (SourceBigEndian != HOST_BIG_ENDIAN) {
+        for (size_t i = 0; i < count; i++)
+            out[i] = swapBytes(out[i]);
+    }
+}
+
+//! The span of \a count words of type T at \a nat read into \a out (see IBinaryImage::readNative4Span)
+template <typename T> bool readSpan(BinaryImage &image, ADDRESS nat, T *out, size_t count) {
+    const IBinarySection *si = image.getSectionInfoByAddr(nat);
+    const char *p = image.getSpan(nat, count * sizeof(T));
+    if (si == nullptr || p == nullptr)
+        return false;
+    if (si->getEndian())
+        readWords<true>(p, out, count);
+    else
+        readWords<false>(p, out, count);
+    return true;
+}
 }
 
 void Write4(int *pi, int val,bool bigEndian) {
@@ -63,6 +103,8 @@ void BinaryImage::reset()
         delete si;
     }
     Sections.clear();
+    LastSection = nullptr;
+    WriteCount++;
 }
 
 char BinaryImage::readNative1(ADDRESS nat) {
@@ -148,6 +190,7 @@ void BinaryImage::writeNative4(ADDRESS nat, uint32_t n) {
         qDebug() << "Write outside section";
         return;
     }
+    WriteCount++;
     ADDRESS host = si->hostAddr() - si->sourceAddr() + nat;
     uint8_t *host_ptr = (unsigned char *)host.m_value;
     if (si->getEndian()==1) {
@@ -194,12 +237,34 @@ void BinaryImage::calculateTextLimits() {
 const IBinarySection *BinaryImage::getSectionInfoByAddr(ADDRESS uEntry) const {
     if(!uEntry.isSourceAddr())
         qDebug()<<"getSectionInfoByAddr with non-Source ADDRESS";
+    if (LastSection && uEntry >= LastLow && uEntry < LastHigh)
+        return LastSection;
     auto iter = SectionMap.find(uEntry);
     if(iter==SectionMap.end()) {
         return nullptr;
     }
-    return iter->second;
+    LastSection = iter->second;
+    LastLow = iter->first.lower();
+    LastHigh = iter->first.upper();
+    return LastSection;
+}
+
+const char *BinaryImage::getSpan(ADDRESS nat, size_t size) {
+    const IBinarySection *si = getSectionInfoByAddr(nat);
+    if (si == nullptr || si->hostAddr().isZero() || si->isAddressBss(nat))
+        return nullptr;
+    if ((si->sourceAddr() + si->size() - nat).m_value < size)
+        return nullptr;
+    return (const char *)(si->hostAddr() - si->sourceAddr() + nat).m_value;
+}
+bool BinaryImage::readNative2Span(ADDRESS nat, uint16_t *out, size_t count) {
+    return readSpan(*this, nat, out, count);
 }
+
+bool BinaryImage::readNative4Span(ADDRESS nat, uint32_t *out, size_t count) {
+    return readSpan(*this, nat, out, count);
+}
+
 //! Find section index given name, or -1 if not found
 int BinaryImage::GetSectionIndexByName(const QString &sName) {
     for (int32_t i = Sections.size()-1; i >= 0; --i) {
@@ -254,6 +319,7 @@ SectionInfo *BinaryImage::createSection(const QString &name, ADDRESS from, ADDRE
     Sections.push_back(sect);
 
     SectionMap.add(std::make_pair(interval<ADDRESS>::right_open(from,to),sect));
+    LastSection = nullptr;
     return sect;
 }
 
@@ -43,6 +43,10 @@ public:
     float readNativeFloat4(ADDRESS nat) override;
     double readNativeFloat8(ADDRESS nat) override;
     void writeNative4(ADDRESS nat, uint32_t n) override;
+    unsigned getWriteCount() const override { return WriteCount; }
+    const char *getSpan(ADDRESS nat, size_t size) override;
+    bool readNative2Span(ADDRESS nat, uint16_t *out, size_t count) override;
+    bool readNative4Span(ADDRESS nat, uint32_t *out, size_t count) override;
     void calculateTextLimits();
     //! Find the section, given an address in the section
     const IBinarySection *getSectionInfoByAddr(ADDRESS uEntry) const;
@@ -68,8 +72,12 @@ private:
     ADDRESS limitTextLow;
     ADDRESS limitTextHigh;
     ptrdiff_t TextDelta;
+    unsigned WriteCount = 0;
     MapAddressRangeToSection SectionMap;
     SectionListType Sections; //!< The section info
+    //! The last section found by getSectionInfoByAddr, and the range it was found for: reads tend to be sequential
+    mutable const IBinarySection *LastSection = nullptr;
+    mutable ADDRESS LastLow, LastHigh;
 
 
 };
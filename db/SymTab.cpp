@@ -16,6 +16,7 @@
 #include "boomerang.h"
 
 #include <QDebug>
+#include <algorithm>
 #include <cassert>
 SymTab::SymTab() {}
 
@@ -26,61 +27,140 @@ void SymTab::clear() {
     for(IBinarySymbol *s : SymbolList)
         delete s;
     SymbolList.clear();
-    amap.clear();
-    smap.clear();
+    for (BinarySymbol *s : byAddress)
+        delete s;
+    byAddress.clear();
+    sortedCount = 0;
+    recent.clear();
+    byName.clear();
+    imports.clear();
+    importsStale = true;
+}
+void SymTab::reserve(size_t n) {
+    byAddress.reserve(byAddress.size() + n);
+    byName.reserve(byName.size() + int(n));
 }
 IBinarySymbol &SymTab::create(ADDRESS a, const QString &s, bool local) {
-    assert(amap.find(a)==amap.end());
-    assert(smap.find(s)==smap.end());
     BinarySymbol * sym = new BinarySymbol;
     sym->Location = a;
     sym->Name = s;
-    amap[a] = sym;
+    return add(sym, local);
+}
+IBinarySymbol &SymTab::createLazy(ADDRESS a, const char *name, int len, bool local) {
+    BinarySymbol * sym = new BinarySymbol;
+    sym->Location = a;
+    sym->RawName = name;
+    sym->RawLength = len;
+    return add(sym, local);
+}
+BinarySymbol &SymTab::add(BinarySymbol *sym, bool local) {
+    ADDRESS a = sym->Location;
+    QByteArray key = sym->getKey();
+    assert(find(a)==nullptr);
+    assert(byName.find(key)==byName.end());
+    byAddress.push_back(sym);
+    recent[a.m_value] = sym;
     if(!local)
-        smap[s] = sym;
+        byName.insert(key, sym);
+    // Merge once the recent ones are a fair fraction of the rest: each symbol is then moved a bounded number of
+    // times on average, and a table loaded in one go is effectively sorted once
+    if (recent.size() > std::max<size_t>(256, sortedCount / 4))
+        mergeRecent();
     return *sym;
 }
 
+//! Sort the symbols created since the last merge, and merge them into the sorted part of byAddress
+void SymTab::mergeRecent() {
+    auto byLocation = [](const BinarySymbol *x, const BinarySymbol *y) { return x->Location < y->Location; };
+    auto mid = byAddress.begin() + sortedCount;
+    std::sort(mid, byAddress.end(), byLocation);
+    std::inplace_merge(byAddress.begin(), mid, byAddress.end(), byLocation);
+    sortedCount = byAddress.size();
+    recent.clear();
+}
+
 const IBinarySymbol *SymTab::find(ADDRESS a) const {
-    auto ff = amap.find(a);
-    if (ff == amap.end())
+    auto ff = recent.find(a.m_value);
+    if (ff != recent.end())
+        return ff->second;
+    auto end = byAddress.begin() + sortedCount;
+    auto it = std::lower_bound(byAddress.begin(), end, a,
+                               [](const BinarySymbol *x, ADDRESS y) { return x->Location < y; });
+    if (it == end || (*it)->Location != a)
         return nullptr;
-    return ff->second;
+    return *it;
 }
 
 const IBinarySymbol *SymTab::find(const QString &s) const {
-    auto ff = smap.find(s);
-    if (ff == smap.end())
+    auto ff = byName.find(s.toUtf8());
+    if (ff == byName.end())
         return nullptr;
-    return ff->second;
+    return ff.value();
 }
 
+const IBinarySymbol *SymTab::findImportedFunction(ADDRESS a) const {
+    if (importsStale) {
+        imports.clear();
+        for (const BinarySymbol *s : byAddress)
+            if (s->isImportedFunction())
+                imports[s->Location.m_value] = s;
+        importsStale = false;
+    }
+    auto ff = imports.find(a.m_value);
+    return ff == imports.end() ? nullptr : ff->second;
+}
 
 bool BinarySymbol::rename(const QString &s)
 {
     //TODO: this code assumes only one BinarySymbolTable instance exists
     SymTab *sym_tab = (SymTab *)Boomerang::get()->getSymbols();
-    if(sym_tab->smap.find(s)!=sym_tab->smap.end()) {
-        qDebug()<<"Renaming symbol " << Name << " to " << s << " failed - new name clashes with another symbol";
+    QByteArray key = s.toUtf8();
+    if(sym_tab->byName.contains(key)) {
+        qDebug()<<"Renaming symbol " << getName() << " to " << s << " failed - new name clashes with another symbol";
         return false; // symbol name clash
     }
-    sym_tab->smap.erase(Name);
+    sym_tab->byName.remove(getKey());
+    RawName = nullptr;
     Name = s;
-    sym_tab->smap[Name] = this;
+    sym_tab->byName.insert(key, this);
     return true;
 }
+const IBinarySymbol &BinarySymbol::setFlag(Flag f, bool on) const {
+    unsigned char was = flags;
+    flags = on ? (flags | f) : (flags & ~f);
+    //TODO: this code assumes only one BinarySymbolTable instance exists
+    if ((was ^ flags) & (IMPORTED | FUNCTION))
+        ((SymTab *)Boomerang::get()->getSymbols())->importsStale = true;
+    return *this;
+}
+//! Set the attribute \a name to \a v: the flag or field of that name if there is one, else an entry of attributes
+const IBinarySymbol &BinarySymbol::setAttr(const QString &name, const QVariant &v) const {
+    static const std::pair<const char *, Flag> flagNames[] = {
+        {"Imported", IMPORTED}, {"Function", FUNCTION}, {"StaticFunction", STATIC_FUNCTION},
+        {"Export", EXPORT},     {"EntryPoint", ENTRY_POINT},
+    };
+    for (const auto &f : flagNames)
+        if (name == QLatin1String(f.first))
+            return setFlag(f.second, v.toBool());
+    if (name == QLatin1String("SourceFile")) {
+        sourceFile = v.toString();
+        return *this;
+    }
+    if (!attributes)
+        attributes.reset(new QVariantMap);
+    (*attributes)[name] = v;
+    return *this;
+}
 bool BinarySymbol::isImported() const {
-    return attributes.contains("Imported") and attributes["Imported"].toBool();
+    return flags & IMPORTED;
 }
 
 QString BinarySymbol::belongsToSourceFile() const
 {
-    if(!attributes.contains("SourceFile"))
-        return "";
-    return attributes["SourceFile"].toString();
+    return sourceFile;
 }
 bool BinarySymbol::isFunction() const {
-    return attributes.contains("Function") and attributes["Function"].toBool();
+    return flags & FUNCTION;
 }
 bool BinarySymbol::isImportedFunction() const
 {
@@ -89,5 +169,5 @@ bool BinarySymbol::isImportedFunction() const
 
 bool BinarySymbol::isStaticFunction() const
 {
-    return attributes.contains("StaticFunction") and attributes["StaticFunction"].toBool();
+    return flags & STATIC_FUNCTION;
 }
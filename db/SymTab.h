@@ -23,28 +23,42 @@
 #include "IBinarySymbols.h"
 
 #include "types.h"
+#include <QHash>
 #include <QVariantMap>
 #include <memory>
-#include <map>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 typedef std::shared_ptr<class Type> SharedType;
 struct BinarySymbol : public IBinarySymbol {
-    QString Name;
+    mutable QString Name;
+    //! While not null, the name is still only these bytes, and Name is empty (see SymTab::createLazy)
+    mutable const char *RawName = nullptr;
+    mutable int RawLength = 0;
     ADDRESS Location;
     SharedType type;
     size_t Size;
-    //! it's mutable since no changes in attribute map will influence the layout of symbols in SymTable
-    mutable QVariantMap attributes;
+    // The attributes are mutable since they do not change where the symbol is in SymTab
+    mutable unsigned char flags = 0; //!< IBinarySymbol::Flag bits
+    mutable QString sourceFile;      //!< The "SourceFile" attribute; shared with the other symbols of the file
+    //! Any other attribute, by name; only allocated once one is set, as few symbols have any
+    mutable std::unique_ptr<QVariantMap> attributes;
 
-    const QString &getName() const override { return Name; }
+    const QString &getName() const override {
+        if (RawName) {
+            Name = QString::fromUtf8(RawName, RawLength);
+            RawName = nullptr;
+        }
+        return Name;
+    }
+    //! The bytes the symbol is found by in SymTab's name index
+    QByteArray getKey() const { return RawName ? QByteArray::fromRawData(RawName, RawLength) : Name.toUtf8(); }
     size_t getSize() const override { return Size; }
     void setSize(size_t v) override { Size=v; }
     ADDRESS getLocation() const override { return Location; }
-    const IBinarySymbol &setAttr(const QString &name,const QVariant &v) const override {
-        attributes[name] = v;
-        return *this;
-    }
+    const IBinarySymbol &setAttr(const QString &name,const QVariant &v) const override;
+    const IBinarySymbol &setFlag(Flag f, bool on = true) const override;
     bool rename(const QString &s);
 
     bool isImportedFunction() const override;
@@ -56,20 +70,33 @@ struct BinarySymbol : public IBinarySymbol {
 class SymTab : public IBinarySymbolTable {
     friend class BinarySymbol;
 private:
-    // The map indexed by address.
-    std::map<ADDRESS, BinarySymbol *> amap;
-    // The map indexed by string. Note that the strings are stored twice.
-    std::map<QString, BinarySymbol *> smap;
+    //! Every symbol, local or not. The first sortedCount are sorted by address and searched by bisection; the
+    //! ones created since are found through recent, until there are enough of them to be worth merging in
+    std::vector<BinarySymbol *> byAddress;
+    size_t sortedCount = 0;
+    std::unordered_map<ADDRESS::value_type, BinarySymbol *> recent;
+    //! The non-local symbols, by the UTF-8 of their name. Keys of lazily named symbols refer to the raw name
+    QHash<QByteArray, BinarySymbol *> byName;
+    //! The imported functions by address: the decoder asks about the destination of every call and jump. Made again
+    //! when first asked for after a symbol became or stopped being one (see BinarySymbol::setFlag)
+    mutable std::unordered_map<ADDRESS::value_type, const BinarySymbol *> imports;
+    mutable bool importsStale = true;
     std::vector<IBinarySymbol *>     SymbolList;
 
+    void mergeRecent();
+    BinarySymbol &add(BinarySymbol *sym, bool local);
+
 public:
     SymTab();                     // Constructor
     ~SymTab();                    // Destructor
     BinarySymbol *getOrCreateSymbol();
+    void reserve(size_t n) override;
 
     IBinarySymbol &create(ADDRESS a, const QString &s,bool local=false) override;
+    IBinarySymbol &createLazy(ADDRESS a, const char *name, int len, bool local=false) override;
     const IBinarySymbol *find(ADDRESS a) const;  //!< Find an entry by address; nullptr if none
     const IBinarySymbol *find(const QString &s) const;  //!< Find an entry by name; NO_ADDRESS if none
+    const IBinarySymbol *findImportedFunction(ADDRESS a) const override;
     SymbolListType &        getSymbolList() { return SymbolList; }
     iterator                begin()       { return SymbolList.begin(); }
     const_iterator          begin() const { return SymbolList.begin(); }
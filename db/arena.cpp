@@ -0,0 +1,223 @@
+/***************************************************************************/ /**
+  * \file       arena.cpp
+  * \brief   Implementation of the Arena region allocator
+  ******************************************************************************/
+#include "arena.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+// Per thread: the threads parsing SSL and signature files (see FrontEnd::preloadSignatures) allocate on the heap while
+// the thread decompiling may be in the arena of a proc. Arenas themselves are only made and released by that thread.
+thread_local Arena *currentArena = nullptr;
+bool arenasEnabled = false;
+bool hugePages = false;
+Arena::Totals totals;
+std::atomic<size_t> numAllocations(0);
+std::atomic<size_t> allocatedBytes(0);
+const size_t ALIGN = alignof(std::max_align_t);
+inline size_t alignUp(size_t n, size_t to = ALIGN) { return (n + to - 1) & ~(to - 1); }
+
+//! What precedes each allocation in a block
+struct Header {
+    Arena::Destroyer destroy; //!< nullptr once deleted (or destroyed), and for raw memory
+    size_t size;
+};
+const size_t HEADER_SIZE = alignUp(sizeof(Header));
+inline Header *headerOf(void *object) { return (Header *)((char *)object - HEADER_SIZE); }
+
+// Whether each chunk of Arena::BLOCK_SIZE bytes of the address space is in a block of a live arena, as a two-level
+// table (of 48 bit addresses) whose leaves are made as blocks land in their range and never freed. Read without a
+// lock by every delete of an IR object, on any thread
+const unsigned CHUNK_BITS = 16;
+const unsigned LEAF_BITS = 16;
+const size_t LEAF_SIZE = size_t(1) << LEAF_BITS;
+const size_t ROOT_SIZE = size_t(1) << (48 - CHUNK_BITS - LEAF_BITS);
+std::atomic<std::atomic<bool> *> chunkTable[ROOT_SIZE];
+
+//! Mark the chunks of the block at \a b, of \a size bytes (both multiples of the chunk size), as \a live
+void markChunks(const char *b, size_t size, bool live) {
+    for (uintptr_t c = (uintptr_t)b >> CHUNK_BITS; c < ((uintptr_t)b + size) >> CHUNK_BITS; c++) {
+        assert((c >> LEAF_BITS) < ROOT_SIZE);
+        std::atomic<std::atomic<bool> *> &root(chunkTable[c >> LEAF_BITS]);
+        std::atomic<bool> *leaf = root.load(std::memory_order_acquire);
+        if (leaf == nullptr) {
+            std::atomic<bool> *made = new std::atomic<bool>[LEAF_SIZE]();
+            if (root.compare_exchange_strong(leaf, made, std::memory_order_acq_rel))
+                leaf = made;
+            else
+                delete[] made; // Another arena's thread made it first; leaf is now that one
+        }
+        leaf[c & (LEAF_SIZE - 1)].store(live, std::memory_order_release);
+    }
+}
+
+void *alignedAlloc(size_t size, size_t alignment) {
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void *p;
+    return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+#endif
+}
+
+void alignedFree(void *p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+}
+
+/***************************************************************************/ /**
+  * \brief A new block of at least \a size bytes, in whole chunks and aligned to them; a \a huge one is aligned to its
+  * size and marked for transparent huge pages
+  ******************************************************************************/
+char *Arena::newBlock(size_t size, bool huge) {
+    static_assert(BLOCK_SIZE == size_t(1) << CHUNK_BITS, "the blocks are in whole chunks of the table of owners");
+    size = alignUp(size, BLOCK_SIZE);
+    char *b = nullptr;
+    if (huge) {
+        b = (char *)alignedAlloc(size, HUGE_BLOCK_SIZE);
+#ifdef __linux__
+        if (b != nullptr)
+            madvise(b, size, MADV_HUGEPAGE); // Only advice: the block is fine without
+#endif
+    }
+    if (b == nullptr) {
+        huge = false;
+        b = (char *)alignedAlloc(size, BLOCK_SIZE);
+    }
+    if (b == nullptr)
+        throw std::bad_alloc();
+    if (blocks.empty())
+        totals.arenas++;
+    blocks.push_back({b, b, size});
+    markChunks(b, size, true);
+    reserved += size;
+    totals.blocks++;
+    hugeBlocks += huge;
+    totals.hugeBlocks += huge;
+    totals.reserved += size;
+    if (totals.reserved > totals.peakReserved)
+        totals.peakReserved = totals.reserved;
+    return b;
+}
+
+/***************************************************************************/ /**
+  * \brief Return size bytes, suitably aligned for any IR object, which release() destroys with \a destroy unless
+  * forgotten before. Large requests get a block of their own so that they don't waste the tail of the current one.
+  ******************************************************************************/
+void *Arena::allocate(size_t size, Destroyer destroy) {
+    size_t total = HEADER_SIZE + alignUp(size == 0 ? 1 : size);
+    used += total;
+    char *res;
+    if ((size_t)(limit - next) >= total) {
+        res = next;
+        next += total;
+    } else if (total > BLOCK_SIZE / 4) {
+        res = newBlock(total);
+        blocks.back().end = res + total;
+    } else {
+        size_t blockSize = BLOCK_SIZE;
+        bool huge = hugePages && reserved >= HUGE_BLOCK_SIZE;
+        if (huge)
+            blockSize = HUGE_BLOCK_SIZE;
+        if (next != nullptr)
+            blocks[currentBlock].end = next;
+        res = next = newBlock(blockSize, huge);
+        currentBlock = blocks.size() - 1;
+        limit = next + blockSize;
+        next += total;
+    }
+    Header *h = (Header *)res;
+    h->destroy = destroy;
+    h->size = total;
+    return res + HEADER_SIZE;
+}
+
+//! Destroy the objects not deleted, and free every block at once. Pointers into this arena are invalid after this.
+void Arena::release() {
+    assert(currentArena != this);
+    if (next != nullptr)
+        blocks[currentBlock].end = next;
+    for (const Block &b : blocks) {
+        for (char *p = b.start; p < b.end; p += ((Header *)p)->size) {
+            Header *h = (Header *)p;
+            Destroyer destroy = h->destroy;
+            h->destroy = nullptr;
+            if (destroy)
+                destroy(p + HEADER_SIZE);
+        }
+    }
+    for (const Block &b : blocks) {
+        markChunks(b.start, b.size, false);
+        alignedFree(b.start);
+    }
+    if (!blocks.empty())
+        totals.arenas--;
+    totals.blocks -= blocks.size();
+    totals.hugeBlocks -= hugeBlocks;
+    totals.reserved -= reserved;
+    blocks.clear();
+    next = limit = nullptr;
+    used = 0;
+    reserved = 0;
+    hugeBlocks = 0;
+}
+
+//! The arena new IR objects are allocated from, or nullptr for the heap
+Arena *Arena::current() { return currentArena; }
+
+//! Return true if p points into a block of any live arena
+bool Arena::owns(const void *p) {
+    uintptr_t c = (uintptr_t)p >> CHUNK_BITS;
+    if ((c >> LEAF_BITS) >= ROOT_SIZE)
+        return false;
+    std::atomic<bool> *leaf = chunkTable[c >> LEAF_BITS].load(std::memory_order_acquire);
+    return leaf != nullptr && leaf[c & (LEAF_SIZE - 1)].load(std::memory_order_acquire);
+}
+
+//! The object at \a object, allocated from an arena, has been destroyed; release() is not to destroy it again
+void Arena::forget(void *object) { headerOf(object)->destroy = nullptr; }
+
+void Arena::setEnabled(bool b) { arenasEnabled = b; }
+bool Arena::isEnabled() { return arenasEnabled; }
+void Arena::setHugePages(bool b) { hugePages = b; }
+const Arena::Totals &Arena::getTotals() { return totals; }
+
+ArenaScope::ArenaScope(Arena *a, bool force) : saved(currentArena) { currentArena = arenasEnabled || force ? a : nullptr; }
+ArenaScope::~ArenaScope() { currentArena = saved; }
+
+void *ArenaAllocated::allocate(size_t size, MemStats::Kind kind, Arena::Destroyer destroy) {
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    void *res = currentArena ? currentArena->allocate(size, destroy) : ::operator new(size);
+    MemStats::allocated(kind, size);
+    return res;
+}
+
+void ArenaAllocated::deallocate(void *p, size_t size, MemStats::Kind kind) {
+    if (p == nullptr)
+        return;
+    MemStats::freed(kind, size);
+    if (Arena::owns(p)) {
+        Arena::forget(p); // Its destructor has run
+        return;
+    }
+    ::operator delete(p);
+}
+
+size_t ArenaAllocated::getNumAllocations() { return numAllocations; }
+size_t ArenaAllocated::getAllocatedBytes() { return allocatedBytes; }
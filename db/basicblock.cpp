@@ -45,6 +45,8 @@
 #include <algorithm>
 #include <cstring>
 #include <inttypes.h>
+#include <set>
+#include <vector>
 using namespace std;
 /**********************************
  * BasicBlock methods
@@ -195,7 +197,8 @@ void BasicBlock::setJumpReqd() { JumpReqd = true; }
   ******************************************************************************/
 bool BasicBlock::isJumpReqd() { return JumpReqd; }
 
-char debug_buffer[DEBUG_BUFSIZE];
+//! What the prints() functions return, one for each thread
+thread_local char debug_buffer[DEBUG_BUFSIZE];
 /***************************************************************************/ /**
   *
   * \brief       Print to a static string (for debugging)
@@ -203,12 +206,10 @@ char debug_buffer[DEBUG_BUFSIZE];
   *
   ******************************************************************************/
 const char *BasicBlock::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     print(ost);
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 void BasicBlock::dump() {
@@ -371,14 +372,14 @@ RTL *BasicBlock::getRTLWithStatement(Instruction *stmt) {
   * \brief Get a constant reference to the vector of in edges.
   * \returns a constant reference to the vector of in edges
   ******************************************************************************/
-std::vector<BasicBlock *> &BasicBlock::getInEdges() { return InEdges; }
+BBEdgeList &BasicBlock::getInEdges() { return InEdges; }
 
 /***************************************************************************/ /**
   *
   * \brief        Get a constant reference to the vector of out edges.
   * \returns            a constant reference to the vector of out edges
   ******************************************************************************/
-const std::vector<BasicBlock *> &BasicBlock::getOutEdges() { return OutEdges; }
+const BBEdgeList &BasicBlock::getOutEdges() { return OutEdges; }
 
 /***************************************************************************/ /**
   *
@@ -461,7 +462,7 @@ void BasicBlock::addInEdge(BasicBlock *pNewInEdge) {
   *     if (pred) deleteInEdge(it) else it++;
   * \endcode
   ******************************************************************************/
-void BasicBlock::deleteInEdge(std::vector<BasicBlock *>::iterator &it) {
+void BasicBlock::deleteInEdge(BBEdgeList::iterator &it) {
     it = InEdges.erase(it);
     // m_iNumInEdges--;
 }
@@ -790,12 +791,14 @@ bool BasicBlock::isAncestorOf(BasicBlock *other) {
         (m_DFTrevlast < other->m_DFTrevlast &&
          m_DFTrevfirst > other->m_DFTrevfirst);*/
 }
-/*! Simplify all the expressions in this BB
+/*! Simplify all the expressions in this BB, and its out edges if a branch became a goto or went away
+ * \returns true if a statement was removed or replaced, or the out edges changed
  */
-void BasicBlock::simplify() {
+bool BasicBlock::simplify() {
+    bool changed = false;
     if (ListOfRTLs)
         for (auto &elem : *ListOfRTLs)
-            (elem)->simplify();
+            changed |= (elem)->simplify();
     if (NodeType == BBTYPE::TWOWAY) {
         assert(OutEdges.size()>1);
         if (ListOfRTLs == nullptr || ListOfRTLs->empty()) {
@@ -821,7 +824,7 @@ void BasicBlock::simplify() {
             OutEdges.resize(1);
             TargetOutEdges = 1;
             LOG_VERBOSE(1) << "redundant edge to " << redundant->getLowAddr() << " inedges: ";
-            std::vector<BasicBlock *> rinedges = redundant->InEdges;
+            BBEdgeList rinedges = redundant->InEdges;
             redundant->InEdges.clear();
             for (BasicBlock *redundant_edge : rinedges) {
                 LOG_VERBOSE(1) << redundant_edge->getLowAddr() << " ";
@@ -843,7 +846,7 @@ void BasicBlock::simplify() {
             OutEdges.resize(1);
             TargetOutEdges = 1;
             LOG_VERBOSE(1) << "redundant edge to " << redundant->getLowAddr() << " inedges: ";
-            std::vector<BasicBlock *> rinedges = redundant->InEdges;
+            BBEdgeList rinedges = redundant->InEdges;
             redundant->InEdges.clear();
             for (BasicBlock *redundant_edge : rinedges) {
                 if (VERBOSE)
@@ -858,7 +861,9 @@ void BasicBlock::simplify() {
             // redundant->m_iNumInEdges = redundant->m_InEdges.size();
             LOG_VERBOSE(1) << "   after: " << OutEdges[0]->getLowAddr() << "\n";
         }
+        changed |= NodeType != BBTYPE::TWOWAY;
     }
+    return changed;
 }
 //! establish if this bb has a back edge to the given destination
 bool BasicBlock::hasBackEdgeTo(BasicBlock *dest) {
@@ -907,7 +912,9 @@ void BasicBlock::WriteBB(HLLCode *hll, int indLevel) {
             if (DEBUG_GEN)
                 LOG << rtl->getAddress() << "\t";
             for (Instruction *st : *rtl) {
+                hll->StartStatement(st);
                 st->generateCode(hll, this, indLevel);
+                hll->EndStatement();
             }
         }
         if (DEBUG_GEN)
@@ -1505,142 +1512,51 @@ void BasicBlock::prependStmt(Instruction *s, UserProc *proc) {
 
 ////////////////////////////////////////////////////
 
-// Check for overlap of liveness between the currently live locations (liveLocs) and the set of locations in ls
-// Also check for type conflicts if DFA_TYPE_ANALYSIS
-// This is a helper function that is not directly declated in the BasicBlock class
-void checkForOverlap(LocationSet &liveLocs, LocationSet &ls, ConnectionGraph &ig, UserProc * /*proc*/) {
-    // For each location to be considered
-    for (Exp *u : ls) {
-        if (!u->isSubscript())
-            continue; // Only interested in subscripted vars
-        RefExp *r = (RefExp *)u;
-        // Interference if we can find a live variable which differs only in the reference
-        Exp *dr;
-        if (liveLocs.findDifferentRef(r, dr)) {
-            // We have an interference between r and dr. Record it
-            ig.connect(r, dr);
-            if (VERBOSE || DEBUG_LIVENESS)
-                LOG << "interference of " << dr << " with " << r << "\n";
-        }
-        // Add the uses one at a time. Note: don't use makeUnion, because then we don't discover interferences
-        // from the same statement, e.g.  blah := r24{2} + r24{3}
-        liveLocs.insert(u);
-    }
-}
-
-bool BasicBlock::calcLiveness(ConnectionGraph &ig, UserProc *myProc) {
-    // Start with the liveness at the bottom of the BB
-    LocationSet liveLocs, phiLocs;
-    getLiveOut(liveLocs, phiLocs);
-    // Do the livensses that result from phi statements at successors first.
-    // FIXME: document why this is necessary
-    checkForOverlap(liveLocs, phiLocs, ig, myProc);
-    // For each RTL in this BB
-    std::list<RTL *>::reverse_iterator rit;
-    if (ListOfRTLs) // this can be nullptr
-        for (rit = ListOfRTLs->rbegin(); rit != ListOfRTLs->rend(); ++rit) {
-            std::list<Instruction *>::reverse_iterator sit;
-            // For each statement this RTL
-            for (sit = (*rit)->rbegin(); sit != (*rit)->rend(); ++sit) {
-                Instruction *s = *sit;
-                LocationSet defs;
-                s->getDefinitions(defs);
-                // The definitions don't have refs yet
-                defs.addSubscript(s /* , myProc->getCFG() */);
-#if 0 // I used to think it necessary to consider definitions as a special case. However, I now believe that
-                // this was either an error of implementation (e.g. it didn't seem to correctly consider the livenesses
-                // causesd by phis) or something to do with renaming but not propagating certain memory locations.
-                // The idea is now to clearly divide locations into those that can be renamed and propagated, and those
-                // which are not renamed or propagated. (Check this.)
-
-                // Also consider it an interference if we define a location that is the same base variable. This can happen
-                // when there is a definition that is unused but for whatever reason not eliminated
-                // This check is done at the "bottom" of the statement, i.e. before we add s's uses and remove s's
-                // definitions to liveLocs
-                // Note that phi assignments don't count
-                if (!s->isPhi())
-                    checkForOverlap(liveLocs, defs, ig, myProc, false);
-#endif
-                // Definitions kill uses. Now we are moving to the "top" of statement s
-                liveLocs.makeDiff(defs);
-                // Phi functions are a special case. The operands of phi functions are uses, but they don't interfere
-                // with each other (since they come via different BBs). However, we don't want to put these uses into
-                // liveLocs, because then the livenesses will flow to all predecessors. Only the appropriate livenesses
-                // from the appropriate phi parameter should flow to the predecessor. This is done in getLiveOut()
-                if (s->isPhi())
-                    continue;
-                // Check for livenesses that overlap
-                LocationSet uses;
-                s->addUsedLocs(uses);
-                checkForOverlap(liveLocs, uses, ig, myProc);
-                if (DEBUG_LIVENESS)
-                    LOG << " ## liveness: at top of " << s << ", liveLocs is " << liveLocs.prints() << "\n";
-            }
-        }
-    // liveIn is what we calculated last time
-    if (!(liveLocs == LiveIn)) {
-        LiveIn = liveLocs;
-        return true; // A change
-    }
-    // No change
-    return false;
-}
-
-// Locations that are live at the end of this BB are the union of the locations that are live at the start of its
-// successors
-// liveout gets all the livenesses, and phiLocs gets a subset of these, which are due to phi statements at the top of
-// successors
-void BasicBlock::getLiveOut(LocationSet &liveout, LocationSet &phiLocs) {
-    liveout.clear();
-    for (BasicBlock *currBB : OutEdges) {
-        // First add the non-phi liveness
-        liveout.makeUnion(currBB->LiveIn); // add successor liveIn to this liveout set.
-        // The first RTL will have the phi functions, if any
-        if (currBB->ListOfRTLs == nullptr || currBB->ListOfRTLs->size() == 0)
+//! The operands of the phi functions at the top of successor \a succ that come from this BB, into \a uses
+void BasicBlock::getPhiUses(BasicBlock *succ, LocationSet &uses) {
+    // The first RTL will have the phi functions, if any
+    if (succ->ListOfRTLs == nullptr || succ->ListOfRTLs->size() == 0)
+        return;
+    RTL *phiRtl = succ->ListOfRTLs->front();
+    for (Instruction *st : *phiRtl) {
+        // Only interested in phi assignments. Note that it is possible that some phi assignments have been
+        // converted to ordinary assignments. So the below is a continue, not a break.
+        if (!st->isPhi())
             continue;
-        RTL *phiRtl = currBB->ListOfRTLs->front();
-        for (Instruction *st : *phiRtl) {
-            // Only interested in phi assignments. Note that it is possible that some phi assignments have been
-            // converted to ordinary assignments. So the below is a continue, not a break.
-            if (!st->isPhi())
-                continue;
-            PhiAssign *pa = (PhiAssign *)st;
-            // Get the jth operand to the phi function; it has a use from BB *this
-            // assert(j>=0);
-            Instruction *def = pa->getStmtAt(this);
-            if (!def) {
-                std::deque<BasicBlock *> to_visit(InEdges.begin(), InEdges.end());
-                std::set<BasicBlock *> tried{this};
-                // TODO: this looks like a hack ?  but sometimes PhiAssign has value which is defined in parent of
-                // 'this'
-                //  BB1 1  - defines r20
-                //  BB2 33 - transfers control to BB3
-                //  BB3 40 - r10 = phi { 1 }
-                while (!to_visit.empty()) {
-                    BasicBlock *pbb = to_visit.back();
-                    if (tried.find(pbb) != tried.end()) {
-                        to_visit.pop_back();
-                        continue;
-                    }
-                    def = pa->getStmtAt(pbb);
-                    if (def)
-                        break;
-                    tried.insert(pbb);
+        PhiAssign *pa = (PhiAssign *)st;
+        // Get the jth operand to the phi function; it has a use from BB *this
+        // assert(j>=0);
+        Instruction *def = pa->getStmtAt(this);
+        if (!def) {
+            std::deque<BasicBlock *> to_visit(InEdges.begin(), InEdges.end());
+            std::set<BasicBlock *> tried{this};
+            // TODO: this looks like a hack ?  but sometimes PhiAssign has value which is defined in parent of
+            // 'this'
+            //  BB1 1  - defines r20
+            //  BB2 33 - transfers control to BB3
+            //  BB3 40 - r10 = phi { 1 }
+            while (!to_visit.empty()) {
+                BasicBlock *pbb = to_visit.back();
+                if (tried.find(pbb) != tried.end()) {
                     to_visit.pop_back();
-                    for (BasicBlock *bb : pbb->InEdges) {
-                        if (tried.find(bb) != tried.end()) // already tried
-                            continue;
-                        to_visit.push_back(bb);
-                    }
+                    continue;
+                }
+                def = pa->getStmtAt(pbb);
+                if (def)
+                    break;
+                tried.insert(pbb);
+                to_visit.pop_back();
+                for (BasicBlock *bb : pbb->InEdges) {
+                    if (tried.find(bb) != tried.end()) // already tried
+                        continue;
+                    to_visit.push_back(bb);
                 }
             }
-            Exp *r = RefExp::get(pa->getLeft()->clone(), def);
-            liveout.insert(r);
-            phiLocs.insert(r);
-            if (DEBUG_LIVENESS)
-                LOG << " ## Liveness: adding " << r << " due to ref to phi " << st << " in BB at " << getLowAddr()
-                    << "\n";
         }
+        Exp *r = RefExp::get(pa->getLeft()->clone(), def);
+        uses.insert(r);
+        if (DEBUG_LIVENESS)
+            LOG << " ## Liveness: adding " << r << " due to ref to phi " << st << " in BB at " << getLowAddr() << "\n";
     }
 }
 
@@ -1958,8 +1874,11 @@ bool BasicBlock::decodeIndirectJmp(UserProc *proc) {
                 // thinks is the number of cases, when finding the first array element not pointing to code.
                 if (form == 'A') {
                     Prog *prog = proc->getProg();
+                    std::vector<int> table;
+                    bool bulk = prog->readNative4Table(swi->uTable, std::max(swi->iNumTable, 0), table);
                     for (int iPtr = 0; iPtr < swi->iNumTable; ++iPtr) {
-                        ADDRESS uSwitch = ADDRESS::g(prog->readNative4(swi->uTable + iPtr * 4));
+                        ADDRESS uSwitch =
+                            ADDRESS::g(bulk ? table[iPtr] : prog->readNative4(swi->uTable + iPtr * 4));
                         if (uSwitch >= prog->getLimitTextHigh() || uSwitch < prog->getLimitTextLow()) {
                             if (DEBUG_SWITCH)
                                 LOG << "Truncating type A indirect jump array to " << iPtr
@@ -2224,32 +2143,26 @@ void BasicBlock::processSwitch(UserProc *proc) {
     // The switch statement is emitted assuming one out-edge for each switch value, which is assumed to be iLower+i
     // for the ith zero-based case. It may be that the code for case 5 above will be a goto to the code for case 3,
     // but a smarter back end could group them
+    // The table is read in one go, and only the first time the switch is processed (see Prog::getSwitchTargets)
+    const std::vector<ADDRESS> *table = si->chForm == 'F' ? nullptr : &prog->getSwitchTargets(si);
     std::list<ADDRESS> dests;
+    std::set<ADDRESS> seen;
     for (int i = 0; i < iNum; i++) {
         // Get the destination address from the switch table.
-        if (si->chForm == 'H') {
-            int iValue = prog->readNative4(si->uTable + i * 2);
-            if (iValue == -1)
-                continue;
-            uSwitch = ADDRESS::g(prog->readNative4(si->uTable + i * 8 + 4));
-        } else if (si->chForm == 'F')
+        if (si->chForm == 'F')
             uSwitch = ADDRESS::g(((int *)si->uTable.m_value)[i]);
         else
-            uSwitch = ADDRESS::g(prog->readNative4(si->uTable + i * 4));
-        if ((si->chForm == 'O') || (si->chForm == 'R') || (si->chForm == 'r')) {
-            // Offset: add table address to make a real pointer to code.  For type R, the table is relative to the
-            // branch, so take iOffset. For others, iOffset is 0, so no harm
-            if (si->chForm != 'R')
-                assert(si->iOffset == 0);
-            uSwitch += si->uTable - si->iOffset;
-        }
+            uSwitch = (*table)[i];
+        if (table && uSwitch == NO_ADDRESS)
+            continue; // Unused entry of form H
         if (uSwitch < prog->getLimitTextHigh()) {
             // tq.visit(cfg, uSwitch, this);
             cfg->addOutEdge(this, uSwitch, true);
             // Remember to decode the newly discovered switch code arms, if necessary
             // Don't do it right now, in case there are recursive switch statements (e.g. app7win.exe from
-            // hackthissite.org)
-            dests.push_back(uSwitch);
+            // hackthissite.org). Repeated cases share their code, which need only be decoded once
+            if (seen.insert(uSwitch).second)
+                dests.push_back(uSwitch);
         } else {
             LOG << "switch table entry branches to past end of text section " << uSwitch << "\n";
 #if 1 // TMN: If we reached an array entry pointing outside the program text, we can be quite confident the array
@@ -2306,7 +2219,7 @@ bool BasicBlock::undoComputedBB(Instruction *stmt) {
   *                 appended to it
   * \returns true if there were any matches
   ******************************************************************************/
-bool BasicBlock::searchAll(const Exp &search_for, std::list<Exp *> &results) {
+bool BasicBlock::searchAll(const Exp &search_for, ExpMatchList &results) {
     bool ch = false;
     for (RTL *rtl_it : *ListOfRTLs) {
         for (Instruction *e : *rtl_it) {
@@ -2335,3 +2248,18 @@ bool BasicBlock::searchAndReplace(const Exp &search, Exp *replace) {
     }
     return ch;
 }
+
+/***************************************************************************/ /**
+  * \brief As above, for all the searches in \a replacements at once
+  * \param replacements - each expression to search for, and the expression with which to replace it
+  * \returns true if replacement took place
+  ******************************************************************************/
+bool BasicBlock::searchAndReplaceAll(const ExpReplaceMap &replacements) {
+    bool ch = false;
+
+    for (RTL *rtl_it : *ListOfRTLs) {
+        for (auto &elem : *rtl_it)
+            ch |= (elem)->searchAndReplaceAll(replacements);
+    }
+    return ch;
+}
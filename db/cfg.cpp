@@ -64,10 +64,13 @@
 #include "hllcode.h"
 #include "boomerang.h"
 #include "log.h"
+#include "liveness.h"
+#include "stats.h"
 
 #include <QtCore/QDebug>
 #include <cassert>
 #include <algorithm> // For find()
+#include <iterator>
 #include <cstring>
 
 void delete_lrtls(std::list<RTL *> &pLrtl);
@@ -75,6 +78,38 @@ void erase_lrtls(std::list<RTL *> &pLrtl, std::list<RTL *>::iterator begin, std:
 
 namespace {
 static int progress = 0;
+
+/***************************************************************************/ /**
+  * \brief   The first RTL of \a rtls at \a addr, or rtls.end(). This can fail (e.g. a label in the middle of an
+  * instruction, or some weird delay slot effects).
+  *
+  * The addresses ascend along a BB, so the search starts from the end nearer to \a addr: the jumps that split a long
+  * block during decoding mostly land near one of its ends, so most splits look at a few RTLs rather than at the whole
+  * block. The search from the back goes on past a match to the first of several RTLs at the address.
+  ******************************************************************************/
+std::list<RTL *>::iterator findRTL(std::list<RTL *> &rtls, ADDRESS addr) {
+    if (rtls.empty())
+        return rtls.end();
+    ADDRESS lo = rtls.front()->getAddress();
+    ADDRESS hi = rtls.back()->getAddress();
+    if (addr < lo || hi < addr || (addr - lo).m_value <= (hi - addr).m_value) {
+        for (auto ri = rtls.begin(); ri != rtls.end(); ++ri) {
+            if ((*ri)->getAddress() == addr)
+                return ri;
+        }
+        return rtls.end();
+    }
+    auto ri = rtls.end();
+    while (ri != rtls.begin()) {
+        --ri;
+        if ((*ri)->getAddress() != addr)
+            continue;
+        while (ri != rtls.begin() && (*std::prev(ri))->getAddress() == addr)
+            --ri;
+        return ri;
+    }
+    return rtls.end();
+}
 }
 
 /**********************************
@@ -118,8 +153,12 @@ void Cfg::clear() {
     entryBB = nullptr;
     exitBB = nullptr;
     WellFormed = false;
+    setStructureChanged();
+    CompressWork.clear();
+    OrphanWork.clear();
     CallSites.clear();
     lastLabel = 0;
+    nextBBIndex = 0;
 }
 
 /***************************************************************************/ /**
@@ -131,7 +170,13 @@ void Cfg::clear() {
 Cfg &Cfg::operator=(const Cfg &other) {
     m_listBB = other.m_listBB;
     m_mapBB = other.m_mapBB;
+    nextBBIndex = other.nextBBIndex;
     WellFormed = other.WellFormed;
+    LiveInValid = false;
+    CompressWork.clear();
+    OrphanWork.clear();
+    for (BasicBlock *bb : m_listBB)
+        touchBB(bb);
     return *this;
 }
 
@@ -240,6 +285,7 @@ BasicBlock *Cfg::newBB(std::list<RTL *> *pRtls, BBTYPE bbType, uint32_t iNumOutE
     if (!bDone) {
         // Else add a new BB to the back of the current list.
         pBB = new BasicBlock(myProc, pRtls, bbType, iNumOutEdges);
+        pBB->Index = nextBBIndex++;
         m_listBB.push_back(pBB);
 
         // Also add the address to the map from native (source) address to
@@ -249,6 +295,8 @@ BasicBlock *Cfg::newBB(std::list<RTL *> *pRtls, BBTYPE bbType, uint32_t iNumOutE
             mi = m_mapBB.find(addr);
         }
     }
+    setStructureChanged();
+    touchBB(pBB);
 
     if (!addr.isZero() && (mi != m_mapBB.end())) {
         // Existing New            +---+ Top of new
@@ -307,9 +355,12 @@ BasicBlock *Cfg::newBB(std::list<RTL *> *pRtls, BBTYPE bbType, uint32_t iNumOutE
 BasicBlock *Cfg::newIncompleteBB(ADDRESS addr) {
     // Create a new (basically empty) BB
     BasicBlock *pBB = new BasicBlock(myProc);
+    pBB->Index = nextBBIndex++;
     // Add it to the list
     m_listBB.push_back(pBB);
     m_mapBB[addr] = pBB; // Insert the mapping
+    setStructureChanged();
+    touchBB(pBB);
     return pBB;
 }
 
@@ -330,6 +381,9 @@ BasicBlock *Cfg::newIncompleteBB(ADDRESS addr) {
 void Cfg::addOutEdge(BasicBlock *pBB, BasicBlock *pDestBB, bool bSetLabel /* = false */) {
     // Add the given BB pointer to the list of out edges
     pBB->OutEdges.push_back(pDestBB);
+    setStructureChanged();
+    touchBB(pBB);
+    touchBB(pDestBB);
     // Add the in edge to the destination BB
     pDestBB->InEdges.push_back(pBB);
     if (bSetLabel)
@@ -399,15 +453,11 @@ bool Cfg::existsBB(ADDRESS uNativeAddr) const {
   ******************************************************************************/
 BasicBlock *Cfg::splitBB(BasicBlock *pBB, ADDRESS uNativeAddr, BasicBlock *pNewBB /* = 0 */,
                          bool bDelRtls /* = false */) {
-    std::list<RTL *>::iterator ri;
+    std::list<RTL *> &rtls(*pBB->ListOfRTLs);
+    std::list<RTL *>::iterator ri = findRTL(rtls, uNativeAddr);
+    setStructureChanged();
 
-    // First find which RTL has the split address; note that this could fail (e.g. label in the middle of an
-    // instruction, or some weird delay slot effects)
-    for (ri = pBB->ListOfRTLs->begin(); ri != pBB->ListOfRTLs->end(); ri++) {
-        if ((*ri)->getAddress() == uNativeAddr)
-            break;
-    }
-    if (ri == pBB->ListOfRTLs->end()) {
+    if (ri == rtls.end()) {
         LOG_STREAM() << "could not split BB at " << pBB->getLowAddr() << " at split address " << uNativeAddr;
         return pBB;
     }
@@ -415,13 +465,13 @@ BasicBlock *Cfg::splitBB(BasicBlock *pBB, ADDRESS uNativeAddr, BasicBlock *pNewB
     // If necessary, set up a new basic block with information from the original bb
     if (pNewBB == nullptr) {
         pNewBB = new BasicBlock(*pBB);
+        pNewBB->Index = nextBBIndex++;
         // But we don't want the top BB's in edges; our only in-edge should be the out edge from the top BB
         pNewBB->InEdges.clear();
-        // The "bottom" BB now starts at the implicit label, so we create a new list
-        // that starts at ri. We need a new list, since it is different from the
-        // original BB's list. We don't have to "deep copy" the RTLs themselves,
-        // since they will never overlap
-        pNewBB->setRTLs(new std::list<RTL *>(ri, pBB->ListOfRTLs->end()));
+        // The "bottom" BB now starts at the implicit label, so we move to a new list the RTLs from ri on. We don't
+        // have to "deep copy" the RTLs themselves, since they will never overlap
+        pNewBB->setRTLs(new std::list<RTL *>);
+        pNewBB->ListOfRTLs->splice(pNewBB->ListOfRTLs->end(), rtls, ri, rtls.end());
         m_listBB.push_back(pNewBB); // Put it in the graph
         // Put the implicit label into the map. Need to do this before the addOutEdge() below
         m_mapBB[uNativeAddr] = pNewBB;
@@ -431,19 +481,31 @@ BasicBlock *Cfg::splitBB(BasicBlock *pBB, ADDRESS uNativeAddr, BasicBlock *pNewB
         // We have an existing BB and a map entry, but no details except for
         // in-edges and m_bHasLabel.
         // First save the in-edges and m_iLabelNum
-        std::vector<BasicBlock *> ins(pNewBB->InEdges);
+        BBEdgeList ins(pNewBB->InEdges);
         int label = pNewBB->LabelNum;
+        int index = pNewBB->Index;
         // Copy over the details now, completing the bottom BB
         *pNewBB = *pBB; // Assign the BB, copying fields. This will set m_bIncomplete false
                         // Replace the in edges (likely only one)
         pNewBB->InEdges = ins;
+        pNewBB->Index = index;
         pNewBB->LabelNum = label; // Replace the label (must be one, since we are splitting this BB!)
                                      // The "bottom" BB now starts at the implicit label
-                                     // We need to create a new list of RTLs, as per above
-        pNewBB->setRTLs(new std::list<RTL *>(ri, pBB->ListOfRTLs->end()));
+                                     // We need to move the RTLs to a new list, as per above
+        pNewBB->setRTLs(new std::list<RTL *>);
+        pNewBB->ListOfRTLs->splice(pNewBB->ListOfRTLs->end(), rtls, ri, rtls.end());
+    } else {
+        // pNewBB exists and is complete, with its own RTLs for these instructions. The old BB needs to have part of
+        // its list of RTLs erased, since the instructions overlap
+        if (bDelRtls) {
+            // Delete the list of pointers, and also the RTLs they point to
+            erase_lrtls(rtls, ri, rtls.end());
+        } else {
+            // Delete the list of pointers, but not the RTLs they point to
+            rtls.erase(ri, rtls.end());
+        }
     }
-    // else pNewBB exists and is complete. We don't want to change the complete
-    // BB in any way, except to later add one in-edge
+    // A complete pNewBB is not changed in any way, except to later add one in-edge
     pBB->NodeType = BBTYPE::FALL; // Update original ("top") basic block's info and make it a fall-through
                             // Fix the in-edges of pBB's descendants. They are now pNewBB
                             // Note: you can't believe m_iNumOutEdges at the time that this function may
@@ -461,19 +523,12 @@ BasicBlock *Cfg::splitBB(BasicBlock *pBB, ADDRESS uNativeAddr, BasicBlock *pNewB
         // That pointer should have been found!
         assert(k < pDescendant->InEdges.size());
     }
-    // The old BB needs to have part of its list of RTLs erased, since the
-    // instructions overlap
-    if (bDelRtls) {
-        // Delete the list of pointers, and also the RTLs they point to
-        erase_lrtls(*pBB->ListOfRTLs, ri, pBB->ListOfRTLs->end());
-    } else {
-        // Delete the list of pointers, but not the RTLs they point to
-        pBB->ListOfRTLs->erase(ri, pBB->ListOfRTLs->end());
-    }
     // Erase any existing out edges
     pBB->OutEdges.erase(pBB->OutEdges.begin(), pBB->OutEdges.end());
     addOutEdge(pBB, uNativeAddr);
     pBB->TargetOutEdges = 1;
+    touchBB(pBB);
+    touchBB(pNewBB);
     return pNewBB;
 }
 
@@ -520,6 +575,38 @@ const BasicBlock *Cfg::getNextBB(BBC_IT &it) const {
         return nullptr;
     return *it;
 }
+
+//! Hand out the next statement, stepping past it first; statements not yet placed in their BB and proc are placed, as
+//! UserProc::getStatements() would
+void StatementRange::iterator::fetch() {
+    cur = nullptr;
+    while (bb != last) {
+        if (rtls == nullptr) {
+            rtls = (*bb)->getRTLs();
+            if (rtls == nullptr || rtls->empty()) {
+                rtls = nullptr;
+                ++bb;
+                continue;
+            }
+            rtl = rtls->begin();
+            st = (*rtl)->begin();
+        }
+        if (st != (*rtl)->end()) {
+            cur = *st++;
+            if (cur->getBB() == nullptr)
+                cur->setBB(*bb);
+            if (cur->getProc() == nullptr)
+                cur->setProc(proc);
+            return;
+        }
+        if (++rtl != rtls->end()) {
+            st = (*rtl)->begin();
+            continue;
+        }
+        rtls = nullptr;
+        ++bb;
+    }
+}
 /*
  * Checks whether the given native address is a label (explicit or non explicit) or not.  Explicit labels are
  * addresses that have already been tagged as being labels due to transfers of control to that address.
@@ -645,7 +732,11 @@ bool Cfg::isIncomplete(ADDRESS uAddr) const {
   * if they used iterators to traverse the list of BBs.
   *
   ******************************************************************************/
-void Cfg::sortByAddress() { m_listBB.sort(BasicBlock::lessAddress); }
+void Cfg::sortByAddress() {
+    // Usually they still are, from the last time
+    if (!std::is_sorted(m_listBB.begin(), m_listBB.end(), BasicBlock::lessAddress))
+        m_listBB.sort(BasicBlock::lessAddress);
+}
 
 /***************************************************************************/ /**
   *
@@ -769,9 +860,12 @@ bool Cfg::mergeBBs(BasicBlock *pb1, BasicBlock *pb2) {
   *
   ******************************************************************************/
 void Cfg::completeMerge(BasicBlock *pb1, BasicBlock *pb2, bool bDelete) {
+    setStructureChanged();
+    touchBB(pb2);
     // First we replace all of pb1's predecessors' out edges that used to point to pb1 (usually only one of these) with
     // pb2
     for (BasicBlock *pPred : pb1->InEdges) {
+        touchBB(pPred);
         assert(pPred->TargetOutEdges == pPred->OutEdges.size());
         for (BasicBlock *&pred_out : pPred->OutEdges) {
             if (pred_out == pb1)
@@ -794,6 +888,7 @@ void Cfg::completeMerge(BasicBlock *pb1, BasicBlock *pb2, bool bDelete) {
             m_mapBB.erase((*it)->getLowAddr());
         }
         m_listBB.erase(it);
+        forgetBB(pb1);
         break;
     }
 }
@@ -814,9 +909,10 @@ void Cfg::completeMerge(BasicBlock *pb1, BasicBlock *pb2, bool bDelete) {
   ******************************************************************************/
 bool Cfg::joinBB(BasicBlock *pb1, BasicBlock *pb2) {
     // Ensure that the fallthrough case for pb1 is pb2
-    const std::vector<BasicBlock *> &v = pb1->getOutEdges();
+    const BBEdgeList &v = pb1->getOutEdges();
     if (v.size() != 2 || v[1] != pb2)
         return false;
+    setStructureChanged();
     // Prepend the RTLs for pb1 to those of pb2. Since they will be pushed to the front of pb2, push them in reverse
     // order
     std::list<RTL *>::reverse_iterator it;
@@ -831,6 +927,7 @@ bool Cfg::joinBB(BasicBlock *pb1, BasicBlock *pb2) {
         m_mapBB.erase((*bbit)->getLowAddr());
     }
     m_listBB.erase(bbit);
+    forgetBB(pb1);
     return true;
 }
 /***************************************************************************/ /**
@@ -844,6 +941,75 @@ void Cfg::removeBB(BasicBlock *bb) {
         m_mapBB.erase((*bbit)->getLowAddr());
     }
     m_listBB.erase(bbit);
+    setStructureChanged();
+    if (myProc) {
+        StatementList stmts;
+        bb->getStatements(stmts);
+        for (Instruction *s : stmts)
+            myProc->getStatementTable().remove(s);
+    }
+    // Its successors lose an in edge, and may be left orphans or become jumps to compress
+    for (BasicBlock *succ : bb->OutEdges)
+        touchBB(succ);
+    forgetBB(bb);
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief Note that the edges or statements of \a bb have changed, so that the next compressCfg() and
+  * removeOrphanBBs() look at it and its neighbours. Those look at nothing else, which keeps them proportional to the
+  * changes made since they last ran
+  *
+  ******************************************************************************/
+void Cfg::touchBB(BasicBlock *bb) {
+    CompressWork.add(bb);
+    OrphanWork.add(bb);
+}
+
+//! Add \a bb, made elsewhere (e.g. when loading), to this Cfg
+void Cfg::addBB(BasicBlock *bb) {
+    if (bb->getIndex() < 0)
+        bb->Index = nextBBIndex++;
+    m_listBB.push_back(bb);
+    touchBB(bb);
+}
+
+//! Drop \a bb, which has been removed from this Cfg, from the clean-up work lists
+void Cfg::forgetBB(BasicBlock *bb) {
+    CompressWork.remove(bb);
+    OrphanWork.remove(bb);
+}
+
+void Cfg::BBWorklist::add(BasicBlock *bb) {
+    size_t idx = bb->getIndex();
+    if (idx >= queued.size())
+        queued.resize(idx + 1, false);
+    if (queued[idx])
+        return;
+    queued[idx] = true;
+    bbs.push_back(bb);
+}
+
+void Cfg::BBWorklist::remove(BasicBlock *bb) {
+    size_t idx = bb->getIndex();
+    if (idx >= queued.size() || !queued[idx])
+        return;
+    queued[idx] = false;
+    bbs.erase(std::find(bbs.begin(), bbs.end(), bb));
+}
+
+void Cfg::BBWorklist::clear() {
+    bbs.clear();
+    queued.clear();
+}
+
+//! Empty the work list, returning what was on it in the order it was added
+std::vector<BasicBlock *> Cfg::BBWorklist::take() {
+    std::vector<BasicBlock *> ret;
+    ret.swap(bbs);
+    for (BasicBlock *bb : ret)
+        queued[bb->getIndex()] = false;
+    return ret;
 }
 
 /***************************************************************************/ /**
@@ -870,17 +1036,32 @@ bool Cfg::compressCfg() {
 
     // Find A -> J -> B     where J is a BB that is only a jump
     // Then A -> B
-    for (BB_IT it = m_listBB.begin(); it != m_listBB.end(); it++) {
-        for (auto it1 = (*it)->OutEdges.begin(); it1 != (*it)->OutEdges.end(); it1++) {
+    // Only a BB touched since the last time (see touchBB()), or a predecessor of one, can be a new A. The indexes are
+    // kept with the BBs, since a J that is deleted may also be a later A
+    std::vector<std::pair<int, BasicBlock *>> candidates;
+    std::vector<bool> seen(nextBBIndex, false), deleted(nextBBIndex, false);
+    auto addCandidate = [&](BasicBlock *bb) {
+        if (seen[bb->getIndex()])
+            return;
+        seen[bb->getIndex()] = true;
+        candidates.emplace_back(bb->getIndex(), bb);
+    };
+    for (BasicBlock *touched : CompressWork.take()) {
+        addCandidate(touched);
+        for (BasicBlock *pred : touched->InEdges)
+            addCandidate(pred);
+    }
+    bool changed = false;
+    for (const std::pair<int, BasicBlock *> &cand : candidates) {
+        if (deleted[cand.first])
+            continue;
+        BasicBlock *bb = cand.second; // Pointer to A
+        for (auto it1 = bb->OutEdges.begin(); it1 != bb->OutEdges.end(); it1++) {
             BasicBlock *pSucc = (*it1); // Pointer to J
-            BasicBlock *bb = (*it);     // Pointer to A
             if (pSucc->InEdges.size() == 1 && pSucc->OutEdges.size() == 1 && pSucc->ListOfRTLs->size() == 1 &&
                 pSucc->ListOfRTLs->front()->size() == 1 && pSucc->ListOfRTLs->front()->front()->isGoto()) {
                 // Found an out-edge to an only-jump BB
-                /* std::cout << "outedge to jump detected at " << std::hex << bb->getLowAddr() << " to ";
-                                        std::cout << pSucc->getLowAddr() << " to " <<
-                   pSucc->m_OutEdges.front()->getLowAddr() << std::dec <<
-                                        '\n'; */
+                changed = true;
                 // Point this outedge of A to the dest of the jump (B)
                 *it1 = pSucc->OutEdges.front();
                 // Now pSucc still points to J; *it1 points to B.  Almost certainly, we will need a jump in the low
@@ -888,7 +1069,7 @@ bool Cfg::compressCfg() {
                 bb->JumpReqd = true;
                 setLabel(*it1);
                 // Find the in-edge from B to J; replace this with an in-edge to A
-                std::vector<BasicBlock *>::iterator it2;
+                BBEdgeList::iterator it2;
                 for (it2 = (*it1)->InEdges.begin(); it2 != (*it1)->InEdges.end(); it2++) {
                     if (*it2 == pSucc)
                         *it2 = bb; // Point to A
@@ -900,6 +1081,9 @@ bool Cfg::compressCfg() {
                 }
                 assert(it2 != pSucc->InEdges.end());
                 pSucc->deleteInEdge(it2);
+                // A now jumps to B, which may itself be a jump; the next run looks at them again
+                touchBB(bb);
+                touchBB(*it1);
                 // If nothing else uses this BB (J), remove it from the CFG
                 if (pSucc->InEdges.empty()) {
                     for (BB_IT it3 = m_listBB.begin(); it3 != m_listBB.end(); it3++) {
@@ -908,23 +1092,28 @@ bool Cfg::compressCfg() {
                                 m_mapBB.erase((*it3)->getLowAddr());
                             }
                             m_listBB.erase(it3);
+                            forgetBB(pSucc);
+                            deleted[pSucc->getIndex()] = true;
                             // And delete the BB
                             delete pSucc;
                             break;
                         }
                     }
-                }
+                } else
+                    touchBB(pSucc);
             }
         }
     }
+    if (changed)
+        setStructureChanged();
     return true;
 }
 bool Cfg::removeOrphanBBs() {
+    // A BB can only have become an orphan by losing in edges, or by being made without any, and either touches it
     std::deque<BasicBlock *> orphans;
-    for (BB_IT it = m_listBB.begin(); it != m_listBB.end(); it++) {
-        if(*it==this->entryBB) // don't remove entry BasicBlock
+    for (BasicBlock *b : OrphanWork.take()) {
+        if(b==this->entryBB) // don't remove entry BasicBlock
             continue;
-        BasicBlock *b = *it;
         if(b->InEdges.empty())
             orphans.push_back(b);
     }
@@ -972,6 +1161,8 @@ bool Cfg::establishDFTOrder() {
     // Must be well formed.
     if (!WellFormed)
         return false;
+    if (isDFTOrderValid())
+        return true; // The BBs still have the numbers from last time
 
     // Reset all the traversed flags
     unTraverse();
@@ -985,7 +1176,9 @@ bool Cfg::establishDFTOrder() {
 
     numTraversed = entryBB->DFTOrder(first, last);
 
-    return numTraversed == m_listBB.size();
+    DFTValid = numTraversed == m_listBB.size();
+    DFTVersion = Version;
+    return DFTValid;
 }
 
 BasicBlock *Cfg::findRetNode() {
@@ -1019,6 +1212,9 @@ bool Cfg::establishRevDFTOrder() {
     // If the CFG has more than one ret node then it needs to be fixed.
     // sortByLastDFT();
 
+    if (RevDFTValid && RevDFTVersion == Version)
+        return true;
+
     BasicBlock *retNode = findRetNode();
 
     if (retNode == nullptr)
@@ -1031,7 +1227,9 @@ bool Cfg::establishRevDFTOrder() {
     int last = 0;
     unsigned numTraversed = retNode->RevDFTOrder(first, last);
 
-    return numTraversed == m_listBB.size();
+    RevDFTValid = numTraversed == m_listBB.size();
+    RevDFTVersion = Version;
+    return RevDFTValid;
 }
 
 /***************************************************************************/ /**
@@ -1108,7 +1306,14 @@ void Cfg::searchAndReplace(const Exp &search, Exp *replace) {
     }
 }
 
-bool Cfg::searchAll(const Exp &search, std::list<Exp *> &result) {
+//! As above, for all the searches in \a replacements at once
+void Cfg::searchAndReplaceAll(const ExpReplaceMap &replacements) {
+    for (BasicBlock *bb : m_listBB) {
+        bb->searchAndReplaceAll(replacements);
+    }
+}
+
+bool Cfg::searchAll(const Exp &search, ExpMatchList &result) {
     bool ch = false;
     for (BasicBlock *bb : m_listBB) {
         ch |= bb->searchAll(search, result);
@@ -1186,7 +1391,28 @@ void Cfg::addNewOutEdge(BasicBlock *pFromBB, BasicBlock *pNewOutEdge) {
 void Cfg::simplify() {
     LOG_VERBOSE(1) << "simplifying...\n";
     for (BasicBlock *it : m_listBB)
-        it->simplify();
+        simplifyBB(it);
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief Simplify the expressions in \a bb, noting any branch that became a goto or went away for the next
+  * compressCfg() and removeOrphanBBs()
+  * \returns true if a statement of \a bb was removed or replaced
+  *
+  ******************************************************************************/
+bool Cfg::simplifyBB(BasicBlock *bb) {
+    BBEdgeList oldOutEdges(bb->OutEdges);
+    BBTYPE oldType = bb->getType();
+    if (!bb->simplify())
+        return false;
+    touchBB(bb);
+    // A successor that lost its edge from bb may now be an orphan
+    for (BasicBlock *succ : oldOutEdges)
+        touchBB(succ);
+    if (bb->getType() != oldType)
+        setStructureChanged();
+    return true;
 }
 
 // print this cfg, mainly for debugging
@@ -1216,6 +1442,8 @@ void Cfg::printToLog() {
 }
 
 void Cfg::setTimeStamps() {
+    if (StampsValid && StampsVersion == Version)
+        return; // The loop stamps and orderings are those of the current BBs and edges
     // set DFS tag
     for (BasicBlock *it : m_listBB)
         it->Traversed = DFS_TAG;
@@ -1233,6 +1461,8 @@ void Cfg::setTimeStamps() {
     assert(retNode);
     revOrdering.clear();
     retNode->setRevOrder(revOrdering);
+    StampsValid = true;
+    StampsVersion = Version;
 }
 
 // Finds the common post dominator of the current immediate post dominator and its successor's immediate post dominator
@@ -1276,7 +1506,7 @@ void Cfg::findImmedPDom() {
     // traverse the nodes in order (i.e from the bottom up)
     for (int i = revOrdering.size() - 1; i >= 0; i--) {
         curNode = revOrdering[i];
-        const std::vector<BasicBlock *> &oEdges = curNode->getOutEdges();
+        const BBEdgeList &oEdges = curNode->getOutEdges();
         for (auto &oEdge : oEdges) {
             succNode = oEdge;
             if (succNode->RevOrd > curNode->RevOrd)
@@ -1288,7 +1518,7 @@ void Cfg::findImmedPDom() {
     unsigned u;
     for (u = 0; u < Ordering.size(); u++) {
         curNode = Ordering[u];
-        const std::vector<BasicBlock *> &oEdges = curNode->getOutEdges();
+        const BBEdgeList &oEdges = curNode->getOutEdges();
         if (oEdges.size() <= 1)
             continue;
         for (auto &oEdge : oEdges) {
@@ -1300,7 +1530,7 @@ void Cfg::findImmedPDom() {
     // one final pass to fix up nodes involved in a loop
     for (u = 0; u < Ordering.size(); u++) {
         curNode = Ordering[u];
-        const std::vector<BasicBlock *> &oEdges = curNode->getOutEdges();
+        const BBEdgeList &oEdges = curNode->getOutEdges();
         if (oEdges.size() > 1)
             for (auto &oEdge : oEdges) {
                 succNode = oEdge;
@@ -1341,7 +1571,7 @@ void Cfg::structConds() {
 
 // Pre: The loop induced by (head,latch) has already had all its member nodes tagged
 // Post: The type of loop has been deduced
-void Cfg::determineLoopType(BasicBlock *header, bool *&loopNodes) {
+void Cfg::determineLoopType(BasicBlock *header, std::vector<bool> &loopNodes) {
     assert(header->getLatchNode());
 
     // if the latch node is a two way node then this must be a post tested loop
@@ -1373,7 +1603,7 @@ void Cfg::determineLoopType(BasicBlock *header, bool *&loopNodes) {
 
 // Pre: The loop headed by header has been induced and all it's member nodes have been tagged
 // Post: The follow of the loop has been determined.
-void Cfg::findLoopFollow(BasicBlock *header, bool *&loopNodes) {
+void Cfg::findLoopFollow(BasicBlock *header, std::vector<bool> &loopNodes) {
     assert(header->getStructType() == Loop || header->getStructType() == LoopCond);
     LoopType lType = header->getLoopType();
     BasicBlock *latch = header->getLatchNode();
@@ -1438,7 +1668,7 @@ void Cfg::findLoopFollow(BasicBlock *header, bool *&loopNodes) {
 // Pre: header has been detected as a loop header and has the details of the
 //        latching node
 // Post: the nodes within the loop have been tagged
-void Cfg::tagNodesInLoop(BasicBlock *header, bool *&loopNodes) {
+void Cfg::tagNodesInLoop(BasicBlock *header, std::vector<bool> &loopNodes) {
     assert(header->getLatchNode());
 
     // traverse the ordering structure from the header to the latch node tagging the nodes determined to be within the
@@ -1463,6 +1693,9 @@ void Cfg::tagNodesInLoop(BasicBlock *header, bool *&loopNodes) {
 // Post: Each node is tagged with the header of the most nested loop of which it is a member (possibly none).
 // The header of each loop stores information on the latching node as well as the type of loop it heads.
 void Cfg::structLoops() {
+    // Maps each node (by its ordering) to whether it is within the loop being structured. Only the nodes between the
+    // header and the latch can be members, so this is allocated once and only that range is cleared after each loop
+    std::vector<bool> loopNodes(Ordering.size(), false);
     for (int i = Ordering.size() - 1; i >= 0; i--) {
         BasicBlock *curNode = Ordering[i]; // the current node under investigation
         BasicBlock *latch = nullptr;       // the latching node of the loop
@@ -1478,7 +1711,7 @@ void Cfg::structLoops() {
         //    vi) has a lower ordering than all other suitable candiates
         // If no nodes meet the above criteria, then the current node is not a loop header
 
-        std::vector<BasicBlock *> &iEdges = curNode->getInEdges();
+        BBEdgeList &iEdges = curNode->getInEdges();
         for (auto &iEdge : iEdges) {
             BasicBlock *pred = iEdge;
             if (pred->getCaseHead() == curNode->getCaseHead() &&                         // ii)
@@ -1491,11 +1724,6 @@ void Cfg::structLoops() {
 
         // if a latching node was found for the current node then it is a loop header.
         if (latch) {
-            // define the map that maps each node to whether or not it is within the current loop
-            bool *loopNodes = new bool[Ordering.size()];
-            for (unsigned int j = 0; j < Ordering.size(); j++)
-                loopNodes[j] = false;
-
             curNode->setLatchNode(latch);
 
             // the latching node may already have been structured as a conditional header. If it is not also the loop
@@ -1516,8 +1744,8 @@ void Cfg::structLoops() {
             // calculate the follow node of this loop
             findLoopFollow(curNode, loopNodes);
 
-            // delete the space taken by the loopnodes map
-            // delete[] loopNodes;
+            int from = std::min(latch->Ord, curNode->Ord), to = std::max(latch->Ord, curNode->Ord);
+            std::fill(loopNodes.begin() + from, loopNodes.begin() + to + 1, false);
         }
     }
 }
@@ -1528,7 +1756,7 @@ void Cfg::structLoops() {
 void Cfg::checkConds() {
     for (auto &elem : Ordering) {
         BasicBlock *curNode = elem;
-        const std::vector<BasicBlock *> &oEdges = curNode->getOutEdges();
+        const BBEdgeList &oEdges = curNode->getOutEdges();
 
         // consider only conditional headers that have a follow and aren't case headers
         if ((curNode->getStructType() == Cond || curNode->getStructType() == LoopCond) && curNode->getCondFollow() &&
@@ -1639,6 +1867,7 @@ void Cfg::removeJunctionStatements() {
         if (pbb->getFirstStmt() && pbb->getFirstStmt()->isJunction()) {
             assert(pbb->getRTLs());
             pbb->getRTLs()->front()->pop_front();
+            touchBB(pbb); // May have left only a goto
         }
     }
 }
@@ -1724,7 +1953,7 @@ void Cfg::generateDotFile(QTextStream &of) {
 
     // Now the edges
     for (BasicBlock *pbb : m_listBB) {
-        const std::vector<BasicBlock *> &outEdges = pbb->getOutEdges();
+        const BBEdgeList &outEdges = pbb->getOutEdges();
         for (unsigned int j = 0; j < outEdges.size(); j++) {
             of << "       bb" << pbb->getLowAddr() << " -> ";
             of << "bb" << outEdges[j]->getLowAddr();
@@ -1739,7 +1968,7 @@ void Cfg::generateDotFile(QTextStream &of) {
     }
 #if BACK_EDGES
     for (it = m_listBB.begin(); it != m_listBB.end(); it++) {
-        std::vector<PBB> &inEdges = (*it)->getInEdges();
+        BBEdgeList &inEdges = (*it)->getInEdges();
         for (unsigned int j = 0; j < inEdges.size(); j++) {
             of << "       "
                << "bb" << std::hex << (*it)->getLowAddr() << " -> ";
@@ -1754,68 +1983,270 @@ void Cfg::generateDotFile(QTextStream &of) {
 //            Liveness             //
 ////////////////////////////////////
 
-void updateWorkListRev(BasicBlock *currBB, std::list<BasicBlock *> &workList, std::set<BasicBlock *> &workSet) {
-    // Insert inedges of currBB into the worklist, unless already there
-    for (BasicBlock *currIn : currBB->getInEdges()) {
-        if (workSet.find(currIn) == workSet.end()) {
-            workList.push_front(currIn);
-            workSet.insert(currIn);
+//! The numbering of the locations and the solved liveness equations, as worked out by Cfg::solveLiveness()
+struct Cfg::LiveSolution {
+    std::vector<BasicBlock *> bbs;  //!< The BB of each node of the solver
+    std::vector<int> nodes;         //!< The node of each BB, by BB index
+    ExpHashMap<int> ids;            //!< The number of each location
+    std::vector<Exp *> locs;        //!< The location with each number
+    std::vector<std::vector<std::pair<int, int>>> edgeUses; //!< (successor node, location) used by phis of each node
+    LivenessSolver solver;
+};
+
+/***************************************************************************/ /**
+  * \brief   Find the locations (subscripted, so in SSA form) live at the start of each BB, into its LiveIn set
+  *
+  * The locations are numbered densely as they are met, and the liveness equations are solved over bit vectors by a
+  * LivenessSolver. The operands of phi functions are live only along the edge from the BB they come from. The result
+  * stays on the BBs until invalidateLiveness() is called, and is not worked out again before then.
+  ******************************************************************************/
+void Cfg::calcLiveIn() {
+    if (LiveInValid)
+        return;
+    LiveSolution sol;
+    solveLiveness(sol);
+}
+
+//! Solve the liveness equations into \a sol, and set the LiveIn sets of the BBs from the solution
+void Cfg::solveLiveness(LiveSolution &sol) {
+    std::vector<BasicBlock *> &bbs(sol.bbs);
+    std::vector<int> &nodes(sol.nodes);
+    nodes.assign(nextBBIndex, -1);
+    if (entryBB) {
+        nodes[entryBB->getIndex()] = 0;
+        bbs.push_back(entryBB); // So the solver's search starts from the entry
+    }
+    for (BasicBlock *bb : m_listBB) {
+        if (nodes[bb->getIndex()] == -1) {
+            nodes[bb->getIndex()] = bbs.size();
+            bbs.push_back(bb);
+        }
+    }
+    ExpHashMap<int> &ids(sol.ids);
+    std::vector<Exp *> &locs(sol.locs);
+    auto idOf = [&](Exp *e) {
+        auto it = ids.find(e);
+        if (it != ids.end())
+            return it->second;
+        Exp *key = e->clone();
+        locs.push_back(key);
+        return ids[key] = locs.size() - 1;
+    };
+    // Number the locations first, since the solver's sets are sized to fit them; gen and kill follow in a backward
+    // scan of each BB
+    std::vector<std::vector<std::pair<int, bool>>> events(bbs.size()); // (id, true for a use), last statement first
+    std::vector<std::vector<std::pair<int, int>>> &edgeUses(sol.edgeUses);
+    edgeUses.assign(bbs.size(), std::vector<std::pair<int, int>>());
+    for (size_t n = 0; n < bbs.size(); n++) {
+        BasicBlock *bb = bbs[n];
+        for (BasicBlock *succ : bb->OutEdges) {
+            LocationSet phiUses;
+            bb->getPhiUses(succ, phiUses);
+            for (Exp *u : phiUses)
+                edgeUses[n].emplace_back(nodes[succ->getIndex()], idOf(u));
+        }
+        if (bb->ListOfRTLs == nullptr)
+            continue;
+        for (auto rit = bb->ListOfRTLs->rbegin(); rit != bb->ListOfRTLs->rend(); ++rit) {
+            for (auto sit = (*rit)->rbegin(); sit != (*rit)->rend(); ++sit) {
+                Instruction *s = *sit;
+                LocationSet defs;
+                s->getDefinitions(defs);
+                defs.addSubscript(s);
+                for (Exp *d : defs)
+                    events[n].emplace_back(idOf(d), false);
+                if (s->isPhi())
+                    continue; // The operands are uses along the edges from the predecessors only
+                LocationSet uses;
+                s->addUsedLocs(uses);
+                for (Exp *u : uses) {
+                    if (u->isSubscript())
+                        events[n].emplace_back(idOf(u), true);
+                }
+            }
+        }
+    }
+    LivenessSolver &solver(sol.solver);
+    solver.init(bbs.size(), locs.size());
+    for (size_t n = 0; n < bbs.size(); n++) {
+        for (BasicBlock *succ : bbs[n]->OutEdges)
+            solver.addSuccessor(n, nodes[succ->getIndex()]);
+        for (const std::pair<int, int> &eu : edgeUses[n])
+            solver.addEdgeUse(n, eu.first, eu.second);
+        DenseBitSet &use(solver.uses(n)), &def(solver.defs(n));
+        for (const std::pair<int, bool> &ev : events[n]) {
+            if (ev.second)
+                use.set(ev.first);
+            else {
+                use.reset(ev.first);
+                def.set(ev.first);
+            }
         }
     }
+    solver.solve();
+    // Keep the result on the BBs, as LocationSets
+    for (size_t n = 0; n < bbs.size(); n++) {
+        LocationSet &liveIn(bbs[n]->LiveIn);
+        liveIn.clear();
+        for (size_t id = 0; id < locs.size(); id++) {
+            if (solver.isLiveIn(n, id))
+                liveIn.insert(locs[id]->clone());
+        }
+    }
+    LiveInValid = true;
 }
+
+/***************************************************************************/ /**
+  * \brief   Find the interferences between the versions of each location that are live at the same program point
+  *
+  * With the livenesses solved, one backward pass over each BB finds them all. The pass works on the bit vectors of
+  * the solution: each use (or phi operand along an out edge) interferes with the first other version of its location
+  * that is live there, first in the order of a LocationSet, as the LocationSet based scan this replaces found.
+  ******************************************************************************/
 void Cfg::findInterferences(ConnectionGraph &cg) {
     if (m_listBB.empty())
         return;
-
-    std::list<BasicBlock *> workList; // List of BBs still to be processed
-    // Set of the same; used for quick membership test
-    std::set<BasicBlock *> workSet;
-    appendBBs(workList, workSet);
-
-    int count = 0;
-    while (workList.size() && count < 100000) {
-        count++; // prevent infinite loop
+    LiveSolution sol;
+    solveLiveness(sol);
+    const std::vector<Exp *> &locs(sol.locs);
+    // The versions of each location (its RefExps with the same base), sorted as in a LocationSet
+    ExpHashMap<int> groupIds;
+    std::vector<int> groupOf(locs.size());
+    std::vector<std::vector<int>> groups;
+    for (size_t id = 0; id < locs.size(); id++) {
+        auto ins = groupIds.insert(std::make_pair(locs[id]->getSubExp1(), (int)groups.size()));
+        if (ins.second)
+            groups.emplace_back();
+        groupOf[id] = ins.first->second;
+        groups[ins.first->second].push_back(id);
+    }
+    lessExpStar less;
+    auto byExp = [&](int a, int b) { return less(locs[a], locs[b]); };
+    for (std::vector<int> &g : groups)
+        std::sort(g.begin(), g.end(), byExp);
+
+    DenseBitSet live;
+    std::vector<Exp *> liveExp(locs.size()); // The expression that made each live location live, for the graph
+    auto firstOther = [&](int id) {
+        for (int v : groups[groupOf[id]])
+            if (v != id && live.test(v))
+                return v;
+        return -1;
+    };
+    auto interfere = [&](Exp *r, int id) {
+        int v = firstOther(id);
+        if (v == -1)
+            return;
+        cg.connect(r, liveExp[v]);
+        if (VERBOSE || DEBUG_LIVENESS)
+            LOG << "interference of " << liveExp[v] << " with " << r << "\n";
+    };
+    for (BasicBlock *currBB : m_listBB) {
         if (++progress > 20) {
             LOG_STREAM() << "i";
             LOG_STREAM().flush();
             progress = 0;
         }
-        BasicBlock *currBB = workList.back();
-        workList.erase(--workList.end());
-        workSet.erase(currBB);
-        // Calculate live locations and interferences
-        bool change = currBB->calcLiveness(cg, myProc);
-        if (!change)
+        int n = sol.nodes[currBB->getIndex()];
+        sol.solver.getLiveOut(n, live);
+        live.forEach([&](size_t id) { liveExp[id] = locs[id]; });
+        // The operands of the phis of the successors that come from this BB first; they are live at its end
+        std::vector<int> phiUses;
+        for (const std::pair<int, int> &eu : sol.edgeUses[n])
+            phiUses.push_back(eu.second);
+        std::sort(phiUses.begin(), phiUses.end(), byExp);
+        phiUses.erase(std::unique(phiUses.begin(), phiUses.end()), phiUses.end());
+        for (int id : phiUses)
+            interfere(locs[id], id);
+        if (currBB->ListOfRTLs == nullptr)
             continue;
-        if (DEBUG_LIVENESS) {
-            LOG << "Revisiting BB ending with stmt ";
-            Instruction *last = nullptr;
-            if (!currBB->ListOfRTLs->empty()) {
-                RTL *lastRtl = currBB->ListOfRTLs->back();
-                if (lastRtl->size())
-                    last = lastRtl->back();
+        for (auto rit = currBB->ListOfRTLs->rbegin(); rit != currBB->ListOfRTLs->rend(); ++rit) {
+            for (auto sit = (*rit)->rbegin(); sit != (*rit)->rend(); ++sit) {
+                Instruction *s = *sit;
+                // Definitions kill uses; they are all numbered, as solveLiveness() numbered them
+                LocationSet defs;
+                s->getDefinitions(defs);
+                defs.addSubscript(s);
+                for (Exp *d : defs)
+                    live.reset(sol.ids[d]);
+                // The operands of phis are live only along the edges they come from, done above
+                if (s->isPhi())
+                    continue;
+                // Add the uses one at a time, so that two versions used by the same statement interfere, e.g.
+                // blah := r24{2} + r24{3}
+                LocationSet uses;
+                s->addUsedLocs(uses);
+                for (Exp *u : uses) {
+                    if (!u->isSubscript())
+                        continue;
+                    int id = sol.ids[u];
+                    interfere(u, id);
+                    if (!live.test(id)) {
+                        live.set(id);
+                        liveExp[id] = u;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/***************************************************************************/ /**
+  * \brief   Find the locations live just below the implicit assignments at the top of the entry BB, into \a live
+  *
+  * Those are the values the proc reads before it defines them, i.e. the uses of the implicit definitions. The entry
+  * BB is walked backwards from its live out set, skipping the implicit assignments, whose own uses (e.g. of r28{0} in
+  * m[r28{0} + 4]) are not real ones.
+  ******************************************************************************/
+void Cfg::findLiveAtEntry(LocationSet &live) {
+    live.clear();
+    if (entryBB == nullptr)
+        return;
+    LiveSolution sol;
+    solveLiveness(sol);
+    DenseBitSet bits;
+    sol.solver.getLiveOut(sol.nodes[entryBB->getIndex()], bits);
+    if (entryBB->ListOfRTLs) {
+        for (auto rit = entryBB->ListOfRTLs->rbegin(); rit != entryBB->ListOfRTLs->rend(); ++rit) {
+            for (auto sit = (*rit)->rbegin(); sit != (*rit)->rend(); ++sit) {
+                Instruction *s = *sit;
+                if (s->isImplicit())
+                    continue;
+                LocationSet defs;
+                s->getDefinitions(defs);
+                defs.addSubscript(s);
+                for (Exp *d : defs)
+                    bits.reset(sol.ids[d]);
+                if (s->isPhi())
+                    continue;
+                LocationSet uses;
+                s->addUsedLocs(uses);
+                for (Exp *u : uses) {
+                    if (u->isSubscript())
+                        bits.set(sol.ids[u]);
+                }
             }
-            if (last)
-                LOG << last->getNumber();
-            else
-                LOG << "<none>";
-            LOG << " due to change\n";
         }
-        updateWorkListRev(currBB, workList, workSet);
+    }
+    for (size_t id = 0; id < sol.locs.size(); id++) {
+        if (bits.test(id))
+            live.insert(sol.locs[id]);
     }
 }
 
-void Cfg::appendBBs(std::list<BasicBlock *> &worklist, std::set<BasicBlock *> &workset) {
+void Cfg::appendBBs(std::list<BasicBlock *> &worklist, std::vector<bool> &inWork) {
     // Append my list of BBs to the worklist
     worklist.insert(worklist.end(), m_listBB.begin(), m_listBB.end());
-    // Do the same for the workset
-    std::copy(m_listBB.begin(), m_listBB.end(), std::inserter(workset, workset.end()));
+    // And mark them all as in it
+    inWork.resize(nextBBIndex, false);
+    for (BasicBlock *bb : m_listBB)
+        inWork[bb->getIndex()] = true;
 }
 
 void dumpBB(BasicBlock *bb) {
     LOG_STREAM() << "For BB at " << bb << ":\nIn edges: ";
-    std::vector<BasicBlock *> ins = bb->getInEdges();
-    std::vector<BasicBlock *> outs = bb->getOutEdges();
+    BBEdgeList ins = bb->getInEdges();
+    BBEdgeList outs = bb->getOutEdges();
     size_t i, n = ins.size();
     for (i = 0; i < n; i++)
         LOG_STREAM() << ins[i] << " ";
@@ -1952,6 +2383,7 @@ BasicBlock *Cfg::splitForBranch(BasicBlock *pBB, RTL *rtl, BranchStatement *br1,
                     break;
                 }
             }
+            touchBB(succ);
         }
     } else {
         // There is no "B" bb (newBb is just the successor of pBB) Fix that one out-edge to point to rptBB
@@ -1985,6 +2417,7 @@ BasicBlock *Cfg::splitForBranch(BasicBlock *pBB, RTL *rtl, BranchStatement *br1,
 
         // Must delete pBB. Note that this effectively "increments" iterator it
         it = m_listBB.erase(it);
+        forgetBB(pBB);
         pBB = nullptr;
     } else
         it++;
@@ -2001,13 +2434,19 @@ BasicBlock *Cfg::splitForBranch(BasicBlock *pBB, RTL *rtl, BranchStatement *br1,
 
 /**
  * \brief Check for indirect jumps and calls. If any found, decode the extra code and return true
+ *
+ * Every one of them is analysed in the same pass, so that a proc with many switches is decoded again (and its
+ * decompilation restarted) once for all of them rather than once for each.
  */
 bool Cfg::decodeIndirectJmp(UserProc *proc) {
-    bool res = false;
+    size_t found = 0;
     for (BasicBlock *bb : m_listBB) {
-        res |= bb->decodeIndirectJmp(proc);
+        if (bb->decodeIndirectJmp(proc))
+            found++;
     }
-    return res;
+    if (found)
+        DecompileStats::get().count(proc, "switch", "resolved together", found);
+    return found != 0;
 }
 /**
  * \brief Change the BB enclosing stmt to be CALL, not COMPCALL
@@ -23,12 +23,14 @@
 #include "log.h"
 #include "basicblock.h"
 #include "frontend.h"
+#include "liveness.h"
+#include "util.h"
 
 #include <QtCore/QDebug>
 #include <sstream>
 #include <cstring>
 
-extern char debug_buffer[]; // For prints functions
+extern thread_local char debug_buffer[]; // For prints functions
 
 /*
  * Dominator frontier code largely as per Appel 2002 ("Modern Compiler Implementation in Java")
@@ -47,9 +49,9 @@ void DataFlow::DFS(int p, size_t n) {
         N++;
         // For each successor w of n
         BasicBlock *bb = BBs[n];
-        const std::vector<BasicBlock *> &outEdges = bb->getOutEdges();
+        const BBEdgeList &outEdges = bb->getOutEdges();
         for (BasicBlock * bb : outEdges) {
-            DFS(n, indices[bb]);
+            DFS(n, indices[bb->getIndex()]);
         }
     }
 }
@@ -58,22 +60,27 @@ void DataFlow::DFS(int p, size_t n) {
 void DataFlow::dominators(Cfg *cfg) {
     BasicBlock *r = cfg->getEntryBB();
     size_t numBB = cfg->getNumBBs();
-    BBs.resize(numBB, (BasicBlock *)-1);
+    // Everything is (re)initialised with assign(), which keeps the vectors' storage from earlier calls, and also
+    // clears what those calls left behind (e.g. when decompilation restarts because of switch statements)
+    BBs.assign(numBB, (BasicBlock *)-1);
     N = 0;
     BBs[0] = r;
-    indices.clear(); // In case restart decompilation due to switch statements
-    indices[r] = 0;
+    indices.assign(cfg->getNumBBIndices(), -1);
+    indices[r->getIndex()] = 0;
     // Initialise to "none"
-    dfnum.resize(numBB, 0);
-    semi.resize(numBB, -1);
-    ancestor.resize(numBB, -1);
-    idom.resize(numBB, -1);
-    samedom.resize(numBB, -1);
-    vertex.resize(numBB, -1);
-    parent.resize(numBB, -1);
-    best.resize(numBB, -1);
-    bucket.resize(numBB);
+    dfnum.assign(numBB, 0);
+    semi.assign(numBB, -1);
+    ancestor.assign(numBB, -1);
+    idom.assign(numBB, -1);
+    samedom.assign(numBB, -1);
+    vertex.assign(numBB, -1);
+    parent.assign(numBB, -1);
+    best.assign(numBB, -1);
+    bucketHead.assign(numBB, -1);
+    bucketNext.assign(numBB, -1);
     DF.resize(numBB);
+    for (std::set<int> &s : DF)
+        s.clear();
     // Set up the BBs and indices vectors. Do this here because sometimes a BB can be unreachable (so relying on
     // in-edges doesn't work)
     std::list<BasicBlock *>::iterator ii;
@@ -81,7 +88,7 @@ void DataFlow::dominators(Cfg *cfg) {
     for (ii = cfg->begin(); ii != cfg->end(); ii++) {
         BasicBlock *bb = *ii;
         if (bb != r) { // Entry BB r already done
-            indices[bb] = idx;
+            indices[bb->getIndex()] = idx;
             BBs[idx++] = bb;
         }
     }
@@ -94,17 +101,17 @@ void DataFlow::dominators(Cfg *cfg) {
         /* These lines calculate the semi-dominator of n, based on the Semidominator Theorem */
         // for each predecessor v of n
         BasicBlock *bb = BBs[n];
-        std::vector<BasicBlock *> &inEdges = bb->getInEdges();
-        std::vector<BasicBlock *>::iterator it;
+        BBEdgeList &inEdges = bb->getInEdges();
+        BBEdgeList::iterator it;
         for (it = inEdges.begin(); it != inEdges.end(); it++) {
-            if (indices.find(*it) == indices.end()) {
+            int v = (*it)->getIndex() < 0 ? -1 : indices[(*it)->getIndex()];
+            if (v == -1) {
                 QTextStream q_cerr(stderr);
 
                 q_cerr << "BB not in indices: ";
                 (*it)->print(q_cerr);
                 assert(false);
             }
-            int v = indices[*it];
             int sdash = v;
             if (dfnum[v] > dfnum[n])
                 sdash = semi[ancestorWithLowestSemi(v)];
@@ -113,12 +120,11 @@ void DataFlow::dominators(Cfg *cfg) {
         }
         semi[n] = s;
         /* Calculation of n's dominator is deferred until the path from s to n has been linked into the forest */
-        bucket[s].insert(n);
+        bucketNext[n] = bucketHead[s];
+        bucketHead[s] = n;
         Link(p, n);
-        // for each v in bucket[p]
-        std::set<int>::iterator jj;
-        for (jj = bucket[p].begin(); jj != bucket[p].end(); jj++) {
-            int v = *jj;
+        // for each v in bucket[p]. The order doesn't matter: each v is decided on its own
+        for (int v = bucketHead[p]; v != -1; v = bucketNext[v]) {
             /* Now that the path from p to v has been linked into the spanning forest, these lines calculate the
                                 dominator of v, based on the first clause of the Dominator Theorem, or else defer the
                calculation until
@@ -129,7 +135,7 @@ void DataFlow::dominators(Cfg *cfg) {
             else
                 samedom[v] = y; // Defer
         }
-        bucket[p].clear();
+        bucketHead[p] = -1;
     }
     for (int i = 1; i < N - 1; i++) {
         /* Now all the deferred dominator calculations, based on the second clause of the Dominator Theorem, are
@@ -139,9 +145,16 @@ void DataFlow::dominators(Cfg *cfg) {
             idom[n] = idom[samedom[n]]; // Deferred success!
         }
     }
-    computeDF(0); // Finally, compute the dominance frontiers
+    computeDF(); // Finally, compute the dominance frontiers
+    domCfg = cfg;
+    domVersion = cfg->getVersion();
 }
 
+//! True if the dominator tree and frontiers are those of \a cfg as it is now
+bool DataFlow::dominatorsValid(const Cfg *cfg) const { return domCfg == cfg && domVersion == cfg->getVersion(); }
+
+int DataFlow::pbbToNode(BasicBlock *bb) { return indices[bb->getIndex()]; }
+
 // Basically algorithm 19.10b of Appel 2002 (uses path compression for O(log N) amortised time per operation
 // (overall O(N log N))
 int DataFlow::ancestorWithLowestSemi(int v) {
@@ -170,38 +183,39 @@ bool DataFlow::doesDominate(int n, int w) {
     return false;
 }
 
-void DataFlow::computeDF(int n) {
-    std::set<int> S;
-    /* THis loop computes DF_local[n] */
-    // for each node y in succ(n)
-    BasicBlock *bb = BBs[n];
-    const std::vector<BasicBlock *> &outEdges = bb->getOutEdges();
-    std::vector<BasicBlock *>::iterator it;
-    for (BasicBlock *b : outEdges) {
-        int y = indices[b];
-        if (idom[y] != n)
-            S.insert(y);
-    }
-    // for each child c of n in the dominator tree
-    // Note: this is a linear search!
-    int sz = idom.size(); // ? Was ancestor.size()
-    for (int c = 0; c < sz; ++c) {
-        if (idom[c] != n)
+// Compute the dominance frontiers from idom, with the method of Cooper, Harvey and Kennedy ("A Simple, Fast Dominance
+// Algorithm", 2001): for each edge p -> b, b is in the frontier of p and of each of p's dominators up to but not
+// including idom(b). This visits each frontier entry once, rather than searching for the children of every node in
+// the dominator tree and testing dominance for every member of their frontiers, as Appel's recursive version does.
+// As with that version, only nodes in the dominator tree rooted at the entry (node 0) get frontiers.
+void DataFlow::computeDF() {
+    size_t numBB = BBs.size();
+    for (std::set<int> &s : DF)
+        s.clear();
+    // inTree[x]: 0 = not known yet, 1 = x's chain of idoms leads to the entry, 2 = it doesn't
+    std::vector<char> inTree(numBB, 0);
+    std::vector<int> chain;
+    inTree[0] = 1;
+    for (size_t x = 1; x < numBB; ++x) {
+        int y = x;
+        while (y != -1 && inTree[y] == 0) {
+            chain.push_back(y);
+            y = idom[y];
+        }
+        char res = (y == -1) ? 2 : inTree[y];
+        for (int c : chain)
+            inTree[c] = res;
+        chain.clear();
+    }
+    for (size_t n = 0; n < numBB; ++n) {
+        if (inTree[n] != 1)
             continue;
-        computeDF(c);
-        /* This loop computes DF_up[c] */
-        // for each element w of DF[c]
-        std::set<int> &s = DF[c];
-        std::set<int>::iterator ww;
-        for (ww = s.begin(); ww != s.end(); ww++) {
-            int w = *ww;
-            // if n does not dominate w, or if n = w
-            if (n == w || !doesDominate(n, w)) {
-                S.insert(w);
-            }
+        for (BasicBlock *bb : BBs[n]->getOutEdges()) {
+            int y = pbbToNode(bb);
+            for (int runner = n; runner != -1 && runner != idom[y]; runner = idom[runner])
+                DF[runner].insert(y);
         }
     }
-    DF[n] = S;
 } // end computeDF
 
 bool DataFlow::canRename(Exp *e, UserProc *proc) {
@@ -247,6 +261,79 @@ void DataFlow::dumpA_phi() {
     LOG_STREAM() << "end A_phi\n";
 }
 
+/***************************************************************************/ /**
+  * \brief   Find which of the locations in varNums are live on entry to each node, for pruned SSA
+  *
+  * A location is used where renameBlockVars() will subscript it: at an unsubscripted use, and at every call and return
+  * statement for every location, since their DefCollectors record the reaching definitions of all locations. Phi
+  * functions are ignored, apart from the uses in the addresses of their left hand sides, so a block whose phi for \a a
+  * is needed has \a a live on entry anyway.
+  * \param   proc the procedure being decompiled
+  * \param   varNums maps each location of interest to its bit number
+  * \param   live the solver, which is left holding the locations live on entry to each node
+  ******************************************************************************/
+void DataFlow::findLiveIn(UserProc *proc, const std::map<Exp *, int, lessExpStar> &varNums, LivenessSolver &live) {
+    size_t numBB = BBs.size();
+    live.init(numBB, varNums.size());
+    for (size_t n = 0; n < numBB; n++) {
+        DenseBitSet &ue(live.uses(n)), &kill(live.defs(n));
+        for (BasicBlock *succ : BBs[n]->getOutEdges()) {
+            int y = pbbToNode(succ);
+            if (y != -1)
+                live.addSuccessor(n, y);
+        }
+        BasicBlock::rtlit rit;
+        StatementList::iterator sit;
+        BasicBlock *bb = BBs[n];
+        for (Instruction *s = bb->getFirstStmt(rit, sit); s; s = bb->getNextStmt(rit, sit)) {
+            LocationSet locs;
+            if (s->isPhi()) {
+                Exp *phiLeft = ((PhiAssign *)s)->getLeft();
+                if (phiLeft->isMemOf() || phiLeft->isRegOf())
+                    phiLeft->getSubExp1()->addUsedLocs(locs);
+            } else
+                s->addUsedLocs(locs);
+            for (Exp *x : locs) {
+                if (x->isSubscript())
+                    continue; // Already renamed, so not a use of the current definition
+                auto it = varNums.find(x);
+                if (it == varNums.end())
+                    continue;
+                if (!kill.test(it->second))
+                    ue.set(it->second);
+            }
+            if (s->isCall() || s->isReturn())
+                ue.uniteComplement(kill);
+            if (s->isPhi())
+                continue;
+            LocationSet defs;
+            s->getDefinitions(defs);
+            for (Exp *a : defs) {
+                auto it = varNums.find(a);
+                if (it != varNums.end() && canRename(a, proc))
+                    kill.set(it->second);
+            }
+        }
+    }
+    live.solve();
+}
+
+/// Redo the dominators and dominance frontiers after edges or blocks have been removed from \a cfg in SSA form. The
+/// node numbers change, so the blocks recorded in A_phi are renumbered, and those no longer in the cfg are dropped.
+void DataFlow::updateDominators(Cfg *cfg) {
+    std::vector<BasicBlock *> oldBBs = BBs;
+    dominators(cfg);
+    for (auto &ap : A_phi) {
+        std::set<int> renumbered;
+        for (int n : ap.second) {
+            size_t index = oldBBs[n]->getIndex();
+            if (index < indices.size() && indices[index] != -1)
+                renumbered.insert(indices[index]);
+        }
+        ap.second.swap(renumbered);
+    }
+}
+
 bool DataFlow::placePhiFunctions(UserProc *proc) {
     // First free some memory no longer needed
     dfnum.resize(0);
@@ -256,7 +343,8 @@ bool DataFlow::placePhiFunctions(UserProc *proc) {
     vertex.resize(0);
     parent.resize(0);
     best.resize(0);
-    bucket.resize(0);
+    bucketHead.resize(0);
+    bucketNext.resize(0);
     defsites.clear(); // Clear defsites map,
     defallsites.clear();
     for(std::set<Exp *, lessExpStar> &se : A_orig) {
@@ -271,7 +359,7 @@ bool DataFlow::placePhiFunctions(UserProc *proc) {
     bool change = false;
 
     // Set the sizes of needed vectors
-    size_t numBB = indices.size();
+    size_t numBB = BBs.size();
     assert(numBB == proc->getCFG()->getNumBBs());
     A_orig.resize(numBB);
 
@@ -308,32 +396,52 @@ bool DataFlow::placePhiFunctions(UserProc *proc) {
         }
     }
 
+    // The sets for the variable being placed are kept as arrays indexed by node, each entry holding the number of
+    // the variable it was last set for, so that they never need clearing. hasPhi mirrors A_phi[a], definesA is
+    // "a is an element of A_orig[y]", and queued records the nodes that have been put on the work list W.
+    std::vector<int> hasPhi(numBB, -1), definesA(numBB, -1), queued(numBB, -1);
+    std::vector<int> W;
+    // With pruned SSA, a phi is placed only where its location is live on entry
+    bool pruned = Boomerang::get()->prunedSSA;
+    LivenessSolver liveIn;
+    if (pruned) {
+        std::map<Exp *, int, lessExpStar> varNums;
+        int num = 0;
+        for (auto &ds : defsites)
+            varNums[ds.first] = num++;
+        findLiveIn(proc, varNums, liveIn);
+    }
+    int varNum = 0;
     // For each variable a (in defsites, i.e. defined anywhere)
     std::map<Exp *, std::set<int>, lessExpStar>::iterator mm;
-    for (mm = defsites.begin(); mm != defsites.end(); mm++) {
+    for (mm = defsites.begin(); mm != defsites.end(); mm++, varNum++) {
         Exp *a = (*mm).first; // *mm is pair<Exp*, set<int>>
+        std::set<int> &sites = (*mm).second;
+        for (int d : sites)
+            definesA[d] = varNum;
+        std::set<int> &phis = A_phi[a];
+        for (int y : phis)
+            hasPhi[y] = varNum;
 
         // Special processing for define-alls
         // for each n in defallsites
-        std::set<int>::iterator da;
-        for (da = defallsites.begin(); da != defallsites.end(); ++da)
-            defsites[a].insert(*da);
+        sites.insert(defallsites.begin(), defallsites.end());
 
         // W <- defsites[a];
-        std::set<int> W = defsites[a]; // set copy
+        W.assign(sites.begin(), sites.end());
+        for (int d : sites)
+            queued[d] = varNum;
         // While W not empty
-        while (W.size()) {
+        while (!W.empty()) {
             // Remove some node n from W
-            int n = *W.begin(); // Copy first element
-            W.erase(W.begin()); // Remove first element
+            int n = W.back();
+            W.pop_back();
             // for each y in DF[n]
-            std::set<int>::iterator yy;
-            std::set<int> &DFn = DF[n];
-            for (yy = DFn.begin(); yy != DFn.end(); yy++) {
-                int y = *yy;
+            for (int y : DF[n]) {
                 // if y not element of A_phi[a]
-                std::set<int> &s = A_phi[a];
-                if (s.find(y) != s.end())
+                if (hasPhi[y] == varNum)
+                    continue;
+                if (pruned && !liveIn.isLiveIn(y, varNum))
                     continue;
                 // Insert trivial phi function for a at top of block y: a := phi()
                 change = true;
@@ -341,11 +449,13 @@ bool DataFlow::placePhiFunctions(UserProc *proc) {
                 BasicBlock *Ybb = BBs[y];
                 Ybb->prependStmt(as, proc);
                 // A_phi[a] <- A_phi[a] U {y}
-                s.insert(y);
+                phis.insert(y);
+                hasPhi[y] = varNum;
                 // if a !elementof A_orig[y]
-                if (A_orig[y].find(a) == A_orig[y].end()) {
+                if (definesA[y] != varNum && queued[y] != varNum) {
                     // W <- W U {y}
-                    W.insert(y);
+                    W.push_back(y);
+                    queued[y] = varNum;
                 }
             }
         }
@@ -360,13 +470,92 @@ static Exp *defineAll = new Terminal(opDefineAll); // An expression representing
 // x appears, stacks[defineAll] does not apply for variable x. This is needed to get correct operation of the use
 // collectors in calls.
 
-// Care with the Stacks object (a map from expression to stack); using Stacks[q].empty() can needlessly insert an empty
-// stack
-#define STACKS_EMPTY(q) (Stacks.find(q) == Stacks.end() || Stacks[q].empty())
+//! Id of the location e, giving it a new (empty) stack if it hasn't got one yet
+int RenameStacks::idOf(const Exp *e) {
+    int found = find(e);
+    if (found != -1)
+        return found;
+    // Clone e, because otherwise it could be an expression that gets deleted through various modifications. This is
+    // necessary because we do several passes of the renaming algorithm to sort out the memory expressions
+    Exp *loc = e->clone();
+    int id = (int)locs.size();
+    ids[loc] = id;
+    locs.push_back(loc);
+    defs.emplace_back();
+    return id;
+}
+
+//! Push def onto every stack (for a statement that defines everything)
+void RenameStacks::pushAll(Instruction *def) {
+    for (std::vector<Instruction *> &stack : defs)
+        stack.push_back(def);
+}
+
+//! Pop def from each stack that it is on top of
+void RenameStacks::popAll(Instruction *def) {
+    for (std::vector<Instruction *> &stack : defs) {
+        if (!stack.empty() && stack.back() == def)
+            stack.pop_back();
+    }
+}
+
+void RenameStacks::clear() {
+    ids.clear();
+    locs.clear();
+    defs.clear();
+}
+
+/***************************************************************************/ /**
+  * \brief   Subscript the uses of the variables in block n and the blocks it dominates
+  *
+  * The dominator tree is walked with an explicit stack rather than by recursion, since the trees of large generated
+  * procedures can be deep enough to overflow the native stack.
+  * \param   proc the procedure being renamed
+  * \param   n the root of the dominator subtree to rename
+  * \param   clearStacks true to forget all the definitions pushed by previous renamings
+  * \returns true if any change was made
+  ******************************************************************************/
+bool DataFlow::renameBlockVars(UserProc *proc, int n, bool clearStacks /* = false */) {
+    // Need to clear the Stacks of old, renamed locations like m[esp-4] (these will be deleted, and will cause compare
+    // failures in the Stacks, so it can't be correctly ordered and hence balanced etc, and will lead to segfaults)
+    if (clearStacks)
+        Stacks.clear();
+
+    // Set up the children of each node, in increasing order as the recursive version visited them
+    int numBB = (int)proc->getCFG()->getNumBBs();
+    domChild.assign(numBB, -1);
+    domNext.assign(numBB, -1);
+    for (int X = numBB - 1; X >= 0; X--) {
+        int p = idom[X];
+        if (p >= 0 && p != X) {
+            domNext[X] = domChild[p];
+            domChild[p] = X;
+        }
+    }
+
+    bool changed = false;
+    // Each entry is a node whose block has been renamed, and the next of its children to visit
+    std::vector<std::pair<int, int>> work;
+    changed |= renameBlock(proc, n);
+    work.emplace_back(n, domChild[n]);
+    while (!work.empty()) {
+        int child = work.back().second;
+        if (child == -1) {
+            popBlockDefs(proc, work.back().first);
+            work.pop_back();
+            continue;
+        }
+        work.back().second = domNext[child];
+        changed |= renameBlock(proc, child);
+        work.emplace_back(child, domChild[child]);
+    }
+    return changed;
+}
 
 // Subscript dataflow variables
 static int dataflow_progress = 0;
-bool DataFlow::renameBlockVars(UserProc *proc, int n, bool clearStacks /* = false */) {
+//! Rename the uses in block n (and the phi operands in its successors), pushing its definitions onto the Stacks
+bool DataFlow::renameBlock(UserProc *proc, int n) {
     if (++dataflow_progress > 200) {
         LOG_STREAM() << 'r';
         LOG_STREAM().flush();
@@ -375,11 +564,6 @@ bool DataFlow::renameBlockVars(UserProc *proc, int n, bool clearStacks /* = fals
     }
     bool changed = false;
 
-    // Need to clear the Stacks of old, renamed locations like m[esp-4] (these will be deleted, and will cause compare
-    // failures in the Stacks, so it can't be correctly ordered and hence balanced etc, and will lead to segfaults)
-    if (clearStacks)
-        Stacks.clear();
-
     // For each statement S in block n
     BasicBlock::rtlit rit;
     StatementList::iterator sit;
@@ -429,10 +613,10 @@ bool DataFlow::renameBlockVars(UserProc *proc, int n, bool clearStacks /* = fals
                     continue; // Don't re-rename the renamed variable
                 }
                 // Else x is not subscripted yet
-                if (STACKS_EMPTY(x)) {
-                    if (!Stacks[defineAll].empty())
-                        def = Stacks[defineAll].back();
-                    else {
+                def = Stacks.top(x);
+                if (def == nullptr) {
+                    def = Stacks.top(defineAll);
+                    if (def == nullptr) {
                         // If the both stacks are empty, use a nullptr definition. This will be changed into a pointer
                         // to an implicit definition at the start of type analysis, but not until all the m[...]
                         // have stopped changing their expressions (complicates implicit assignments considerably).
@@ -440,8 +624,7 @@ bool DataFlow::renameBlockVars(UserProc *proc, int n, bool clearStacks /* = fals
                         // Update the collector at the start of the UserProc
                         proc->useBeforeDefine(x->clone());
                     }
-                } else
-                    def = Stacks[x].back();
+                }
                 if (def && def->isCall())
                     // Calls have UseCollectors for locations that are used before definition at the call
                     ((CallStatement *)def)->useBeforeDefine(x->clone());
@@ -477,13 +660,7 @@ bool DataFlow::renameBlockVars(UserProc *proc, int n, bool clearStacks /* = fals
             bool suitable = canRename(a, proc);
             if (suitable) {
                 // Push i onto Stacks[a]
-                // Note: we clone a because otherwise it could be an expression that gets deleted through various
-                // modifications. This is necessary because we do several passes of this algorithm to sort out the
-                // memory expressions
-                if(Stacks.find(a)!=Stacks.end()) // expression exists, no need for clone ?
-                    Stacks[a].push_back(S);
-                else
-                    Stacks[a->clone()].push_back(S);
+                Stacks.push(a, S);
                 // Replace definition of 'a' with definition of a_i in S (we don't do this)
             }
             // FIXME: MVE: do we need this awful hack?
@@ -492,7 +669,7 @@ bool DataFlow::renameBlockVars(UserProc *proc, int n, bool clearStacks /* = fals
                 assert(a1);
                 // Stacks already has a definition for a (as just the bare local)
                 if (suitable) {
-                    Stacks[a1->clone()].push_back(S);
+                    Stacks.push(a1, S);
                 }
             }
         }
@@ -500,16 +677,13 @@ bool DataFlow::renameBlockVars(UserProc *proc, int n, bool clearStacks /* = fals
         // But note that only everythings at the current memory level are defined!
         if (S->isCall() && ((CallStatement *)S)->isChildless() && !Boomerang::get()->assumeABI) {
             // S is a childless call (and we're not assuming ABI compliance)
-            Stacks[defineAll]; // Ensure that there is an entry for defineAll
-            for (auto &elem : Stacks) {
-                // if (dd->first->isMemDepth(memDepth))
-                elem.second.push_back(S); // Add a definition for all vars
-            }
+            Stacks.idOf(defineAll); // Ensure that there is an entry for defineAll
+            Stacks.pushAll(S);      // Add a definition for all vars
         }
     }
 
     // For each successor Y of block n
-    const std::vector<BasicBlock *> &outEdges = bb->getOutEdges();
+    const BBEdgeList &outEdges = bb->getOutEdges();
     size_t numSucc = outEdges.size();
     for (unsigned succ = 0; succ < numSucc; succ++) {
         BasicBlock *Ybb = outEdges[succ];
@@ -528,23 +702,20 @@ bool DataFlow::renameBlockVars(UserProc *proc, int n, bool clearStacks /* = fals
             // Only consider variables that can be renamed
             if (!canRename(a, proc))
                 continue;
-            Instruction *def = nullptr; // assume No reaching definition
-            if (!STACKS_EMPTY(a))
-                def = Stacks[a].back();
+            Instruction *def = Stacks.top(a); // nullptr if no reaching definition
 
             // "Replace jth operand with a_i"
             pa->putAt(bb, def, a);
         }
     }
 
-    // For each child X of n
-    // Note: linear search!
-    size_t numBB = proc->getCFG()->getNumBBs();
-    for (size_t X = 0; X < numBB; X++) {
-        if (idom[X] == n)
-            renameBlockVars(proc, X);
-    }
+    return changed;
+}
 
+//! Pop the definitions that renameBlock() pushed for block n, when done with the blocks it dominates
+void DataFlow::popBlockDefs(UserProc *proc, int n) {
+    BasicBlock *bb = BBs[n];
+    Instruction *S;
     // For each statement S in block n
     // NOTE: Because of the need to pop childless calls from the Stacks, it is important in my algorithm to process the
     // statments in the BB *backwards*. (It is not important in Appel's algorithm, since he always pushes a definition
@@ -560,34 +731,26 @@ bool DataFlow::renameBlockVars(UserProc *proc, int n, bool clearStacks /* = fals
             if (!canRename(*dd, proc))
                 continue;
             // if ((*dd)->getMemDepth() == memDepth)
-            auto ss = Stacks.find(*dd);
-            if (ss == Stacks.end()) {
+            int id = Stacks.find(*dd);
+            if (id == -1) {
                 LOG_STREAM() << "Tried to pop " << *dd << " from Stacks; does not exist\n";
                 assert(0);
             }
-            ss->second.pop_back();
+            Stacks.pop(id);
         }
         // Pop all defs due to childless calls
-        if (S->isCall() && ((CallStatement *)S)->isChildless()) {
-            for (auto sss = Stacks.begin(); sss != Stacks.end(); ++sss) {
-                if (!sss->second.empty() && sss->second.back() == S) {
-                    sss->second.pop_back();
-                }
-            }
-        }
+        if (S->isCall() && ((CallStatement *)S)->isChildless())
+            Stacks.popAll(S);
     }
-    return changed;
 }
 
 void DataFlow::dumpStacks() {
     LOG_STREAM() << "Stacks: " << Stacks.size() << " entries\n";
-    for (auto zz = Stacks.begin(); zz != Stacks.end(); zz++) {
-        LOG_STREAM() << "Var " << zz->first << " [ ";
-        std::deque<Instruction *> tt = zz->second; // Copy the stack!
-        while (!tt.empty()) {
-            LOG_STREAM() << tt.back()->getNumber() << " ";
-            tt.pop_back();
-        }
+    for (size_t i = 0; i < Stacks.size(); i++) {
+        LOG_STREAM() << "Var " << Stacks.location(i) << " [ ";
+        const std::vector<Instruction *> &tt = Stacks.stack(i);
+        for (auto it = tt.rbegin(); it != tt.rend(); ++it)
+            LOG_STREAM() << (*it)->getNumber() << " ";
         LOG_STREAM() << "]\n";
     }
 }
@@ -614,13 +777,17 @@ void DataFlow::dumpA_orig() {
     }
 }
 
-void DefCollector::updateDefs(std::map<Exp *, std::deque<Instruction *>, lessExpStar> &Stacks, UserProc *proc) {
-    for (auto it = Stacks.begin(); it != Stacks.end(); it++) {
-        if (it->second.empty())
+void DefCollector::updateDefs(RenameStacks &Stacks, UserProc *proc) {
+    for (size_t i = 0; i < Stacks.size(); i++) {
+        Instruction *def = Stacks.top(i);
+        if (def == nullptr)
             continue; // This variable's definition doesn't reach here
+        Exp *loc = Stacks.location(i);
+        if (defs.definesLoc(loc))
+            continue; // Already collected; insert() would keep the existing definition anyway
         // Create an assignment of the form loc := loc{def}
-        RefExp *re = new RefExp(it->first->clone(), it->second.back());
-        Assign *as = new Assign(it->first->clone(), re);
+        RefExp *re = new RefExp(loc->clone(), def);
+        Assign *as = new Assign(loc->clone(), re);
         as->setProc(proc); // Simplify sometimes needs this
         insert(as);
     }
@@ -685,21 +852,17 @@ void DefCollector::print(QTextStream &os, bool html) const {
  * Print to string or stderr (for debugging)
  */
 char *UseCollector::prints() const {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     print(ost);
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 //!Print to string or stdout (for debugging)
 char *DefCollector::prints() const {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     print(ost);
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 void UseCollector::dump() {
@@ -714,24 +877,32 @@ void DefCollector::dump() {
 
 void UseCollector::makeCloneOf(UseCollector &other) {
     initialised = other.initialised;
-    locs.clear();
-    for (auto const &elem : other)
-        locs.insert((elem)->clone());
+    if (&other == this)
+        return;
+    locs = other.locs; // Deep copy, made in order
 }
 /**
  * makeCloneOf(): clone the given Collector into this one
  */
 void DefCollector::makeCloneOf(const DefCollector &other) {
     initialised = other.initialised;
+    if (&other == this)
+        return;
     defs.clear();
+    generation++;
+    // The clones sort the same as the originals, so each one goes at the end
     for (auto const &elem : other)
-        defs.insert((Assign *)(elem)->clone());
+        defs.insert(defs.end(), (Assign *)(elem)->clone());
 }
 
 void DefCollector::searchReplaceAll(const Exp &from, Exp *to, bool &change) {
     iterator it;
+    bool replaced = false;
     for (it = defs.begin(); it != defs.end(); ++it)
-        change |= (*it)->searchAndReplace(from, to);
+        replaced |= (*it)->searchAndReplace(from, to);
+    if (replaced)
+        generation++;
+    change |= replaced;
 }
 
 // Called from CallStatement::fromSSAform. The UserProc is needed for the symbol map
@@ -758,20 +929,21 @@ void UseCollector::fromSSAform(UserProc *proc, Instruction *def) {
 bool UseCollector::operator==(UseCollector &other) {
     if (other.initialised != initialised)
         return false;
+    if (&other == this)
+        return true;
     iterator it1, it2;
     if (other.locs.size() != locs.size())
         return false;
     for (it1 = locs.begin(), it2 = other.locs.begin(); it1 != locs.end(); ++it1, ++it2)
-        if (!(**it1 == **it2))
+        if (*it1 != *it2 && !(**it1 == **it2)) // Shared locations needn't be compared
             return false;
     return true;
 }
 
 void DefCollector::insert(Assign *a) {
-    Exp *l = a->getLeft();
-    if (existsOnLeft(l))
-        return;
-    defs.insert(a);
+    // AssignSet is ordered by LHS, so this does nothing if a's LHS is already defined here
+    if (defs.insert(a).second)
+        generation++;
 }
 
 void DataFlow::convertImplicits(Cfg *cfg) {
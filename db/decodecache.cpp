@@ -0,0 +1,129 @@
+/***************************************************************************/ /**
+  * \file       decodecache.cpp
+  * \brief   Implementation of the DecodeCache class
+  *
+  * An entry is the directory the program was saved to as the output directory of persistToXML, with a file "root"
+  * naming, relative to it, the file of the root module. That file is written last, so an entry without it (from a run
+  * that stopped while saving) is a miss and is saved again.
+  ******************************************************************************/
+#include "decodecache.h"
+
+#include "boomerang.h"
+#include "BinaryFile.h"
+#include "frontend.h"
+#include "log.h"
+#include "module.h"
+#include "prog.h"
+#include "xmlprogparser.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+const char *MAGIC = "boomerang-decode-cache 1";
+
+//! Add the contents of the file at \a path to \a h; a missing file adds nothing but the separator
+void addFile(QCryptographicHash &h, const QString &path) {
+    QFile f(path);
+    if (f.open(QFile::ReadOnly))
+        h.addData(&f);
+    h.addData(QByteArray(1, '\0'));
+}
+}
+
+DecodeCache &DecodeCache::get() {
+    static DecodeCache cache;
+    return cache;
+}
+
+//! Use the cache in \a dir, creating it if needed; an empty name disables the cache
+void DecodeCache::setDirectory(const QString &dir) {
+    directory = dir;
+    if (directory.isEmpty())
+        return;
+    if (!directory.endsWith('/'))
+        directory += '/';
+    QDir().mkpath(directory);
+}
+
+//! The directory of the entry for decoding \a binary with the current options, naming the entry point \a pname
+QString DecodeCache::getEntry(const QString &binary, const char *pname) const {
+    Boomerang &boom(*Boomerang::get());
+    QCryptographicHash h(QCryptographicHash::Sha1);
+    h.addData(QByteArray(MAGIC));
+    h.addData(QByteArray(Boomerang::getVersionStr()));
+    addFile(h, binary);
+    h.addData(QFileInfo(binary).fileName().toUtf8());
+    LOAD_FMT format = LOADFMT_ELF;
+    QString ssl = FrontEnd::getSSLFileName(BinaryFileFactory::probeMachine(binary, format));
+    if (!ssl.isEmpty())
+        addFile(h, ssl);
+    QString opts = QString("%1,%2,%3,%4,%5,%6;")
+                       .arg(boom.decodeMain)
+                       .arg(boom.noDecodeChildren)
+                       .arg(boom.decodeThruIndCall)
+                       .arg(boom.lazyDecode)
+                       .arg(boom.scanPrologues)
+                       .arg(pname ? pname : "");
+    for (ADDRESS a : boom.entrypoints)
+        opts += QString::number(a.m_value, 16) + ",";
+    opts += ";";
+    for (const std::pair<ADDRESS, QString> &sym : boom.symbols)
+        opts += QString::number(sym.first.m_value, 16) + "=" + sym.second + ",";
+    h.addData(opts.toUtf8());
+    for (const QString &file : boom.symbolFiles)
+        addFile(h, file);
+    return directory + QString(h.result().toHex()) + "/";
+}
+
+/***************************************************************************/ /**
+  * \brief   Read the decoded program of \a binary from the cache, loading the binary for it
+  * \returns the program, or null on a miss
+  ******************************************************************************/
+Prog *DecodeCache::restore(const QString &binary, const char *pname) {
+    QString entry = getEntry(binary, pname);
+    QFile root(entry + "root");
+    if (!root.open(QFile::ReadOnly | QFile::Text)) {
+        misses++;
+        return nullptr;
+    }
+    QString rootFile = entry + QString::fromUtf8(root.readAll()).trimmed();
+    // The files of the modules are found through the output path, as they were when saved
+    Boomerang &boom(*Boomerang::get());
+    QString outputPath = boom.getOutputPath();
+    boom.setOutputPath(entry);
+    Prog *prog = XMLProgParser().parse(rootFile, binary);
+    boom.setOutputPath(outputPath);
+    if (prog == nullptr) {
+        LOG_STREAM(LL_Warn) << "the decode cache entry " << entry << " could not be read; decoding again\n";
+        misses++;
+        return nullptr;
+    }
+    hits++;
+    return prog;
+}
+
+//! Save \a prog, just decoded from \a binary, in the cache
+bool DecodeCache::store(Prog *prog, const QString &binary, const char *pname) {
+    QString entry = getEntry(binary, pname);
+    if (!QDir().mkpath(entry))
+        return false;
+    Boomerang &boom(*Boomerang::get());
+    QString outputPath = boom.getOutputPath();
+    boom.setOutputPath(entry);
+    XMLProgParser().persistToXML(prog);
+    QString rootFile = prog->getRootCluster()->getOutPath("xml");
+    boom.setOutputPath(outputPath);
+    QSaveFile root(entry + "root");
+    if (!root.open(QFile::WriteOnly | QFile::Text))
+        return false;
+    root.write(QDir(entry).relativeFilePath(rootFile).toUtf8());
+    if (!root.commit())
+        return false;
+    stores++;
+    LOG_VERBOSE(1) << "saved the decoded program in " << entry << "\n";
+    return true;
+}
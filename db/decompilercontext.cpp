@@ -0,0 +1,42 @@
+/***************************************************************************/ /**
+  * \file       decompilercontext.cpp
+  * \brief   Implementation of the DecompilerContext class
+  ******************************************************************************/
+#include "decompilercontext.h"
+
+#include "boomerang.h"
+#include "log.h"
+
+thread_local DecompilerContext *DecompilerContext::currentContext = nullptr;
+const int DecompilerContext::PROGRESS_INSNS;
+const int DecompilerContext::PROGRESS_MS;
+
+//! The context made current on this thread by the innermost ContextScope, else that of the command line session
+DecompilerContext *DecompilerContext::current() { return currentContext ? currentContext : Boomerang::get(); }
+
+//! The log for messages of \a verbosity_level: 2 always goes to the log, 1 only with the -v switch
+Log &DecompilerContext::if_verbose_log(int verbosity_level) {
+    static NullLogger null_log;
+    if (verbosity_level == 2)
+        return *logger;
+    if ((verbosity_level == 1) && vFlag)
+        return *logger;
+    else
+        return null_log;
+}
+
+//! Pass on the decoding progress made since the last time, if any
+void DecompilerContext::flushDecodeProgress() {
+    decodeProgress.lastFlush = std::chrono::steady_clock::now();
+    if (decodeProgress.insns == 0)
+        return;
+    for (Watcher *elem : watchers)
+        elem->alertDecodeProgress(decodeProgress.insns, decodeProgress.bytes);
+    decodeProgress.insns = 0;
+    decodeProgress.bytes = 0;
+}
+
+void DecompilerContext::alertDecompileDebugPoint(UserProc *p, const char *description) {
+    for (Watcher *elem : watchers)
+        elem->alertDecompileDebugPoint(p, description);
+}
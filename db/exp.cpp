@@ -16,6 +16,9 @@
 #include "statement.h"
 #include "cfg.h"
 #include "exp.h"
+#include "exptable.h"
+#include "simplifycache.h"
+#include "stats.h"
 #include "register.h"
 #include "rtl.h" // E.g. class ParamEntry in decideType()
 #include "proc.h"
@@ -27,87 +30,175 @@
 //#include "transformer.h"
 #include "visitor.h"
 #include "log.h"
-#include <QRegularExpression>
+#include "nametable.h"
+#include "exppattern.h"
+#include <QtCore/QHash>
 #include <iomanip> // For std::setw etc
 
-extern char debug_buffer[]; ///< For prints functions
-static int tlstrchr(const QString &str, char ch);
+extern thread_local char debug_buffer[]; ///< For prints functions
+
+// Starts at 1, so that a fresh Exp (hashStamp 0) has no valid hash
+std::atomic<size_t> Exp::changeStamp(1);
+
+namespace {
+/**
+ * For the member functions that assign op or subExp1..3 of an Exp directly: marks all Exps as changed on the way out
+ * if they did change it. Changes to other Exps go through their setters, or through such a function of their own.
+ */
+class ExpChangeGuard {
+    const Exp *e;
+    OPER op;
+    const Exp *subs[3];
+
+  public:
+    explicit ExpChangeGuard(const Exp *_e) : e(_e), op(_e->getOper()) {
+        subs[0] = e->getSubExp1();
+        subs[1] = e->getSubExp2();
+        subs[2] = e->getSubExp3();
+    }
+    ~ExpChangeGuard() {
+        if (e != nullptr && (e->getOper() != op || e->getSubExp1() != subs[0] || e->getSubExp2() != subs[1] ||
+                             e->getSubExp3() != subs[2]))
+            Exp::changed();
+    }
+    //! The Exp is about to be deleted: nothing to compare it with any more
+    void dismiss() { e = nullptr; }
+};
+}
 
 // Derived class constructors
 
-Const::Const(uint32_t i) : Exp(opIntConst), conscript(0), type(VoidType::get()) { u.i = i; }
-Const::Const(int i) : Exp(opIntConst), conscript(0), type(VoidType::get()) { u.i = i; }
-Const::Const(QWord ll) : Exp(opLongConst), conscript(0), type(VoidType::get()) { u.ll = ll; }
-Const::Const(double d) : Exp(opFltConst), conscript(0), type(VoidType::get()) { u.d = d; }
-//Const::Const(const char *p) : Exp(opStrConst), conscript(0), type(VoidType::get()) { u.p = p; }
-Const::Const(const QString &p) : Exp(opStrConst), conscript(0), type(VoidType::get()) {
-    strin = p;
+//! The string of the constants that have none, and of those of the empty string: the pooled empty string, so that it
+//! compares like any other. It keeps the one reference it took, so the constants don't count theirs.
+static const QString *noString() {
+    static const QString *empty = NameTable::pool(QString());
+    return empty;
+}
+
+//! \returns the pooled copy of \a p, with a reference for a constant to give back with releaseString()
+static const QString *poolString(const QString &p) { return p.isEmpty() ? noString() : NameTable::pool(p); }
+
+static void releaseString(const QString *p) {
+    if (p != noString())
+        NameTable::release(p);
+}
+
+Const::Const(uint32_t i)
+    : Exp(opIntConst, ExpKind::Const), strin(noString()), conscript(0), type(VoidType::get()) {
+    u.i = i;
+}
+Const::Const(int i) : Exp(opIntConst, ExpKind::Const), strin(noString()), conscript(0), type(VoidType::get()) {
+    u.i = i;
+}
+Const::Const(QWord ll)
+    : Exp(opLongConst, ExpKind::Const), strin(noString()), conscript(0), type(VoidType::get()) {
+    u.ll = ll;
+}
+Const::Const(double d) : Exp(opFltConst, ExpKind::Const), strin(noString()), conscript(0), type(VoidType::get()) {
+    u.d = d;
+}
+//Const::Const(const char *p) : Exp(opStrConst, ExpKind::Const), conscript(0), type(VoidType::get()) { u.p = p; }
+Const::Const(const QString &p)
+    : Exp(opStrConst, ExpKind::Const), strin(poolString(p)), conscript(0), type(VoidType::get()) {}
+Const::Const(Function *p)
+    : Exp(opFuncConst, ExpKind::Const), strin(noString()), conscript(0), type(VoidType::get()) {
+    u.pp = p;
 }
-Const::Const(Function *p) : Exp(opFuncConst), conscript(0), type(VoidType::get()) { u.pp = p; }
 /// \remark This is bad. We need a way of constructing true unsigned constants
-Const::Const(ADDRESS a) : Exp(opIntConst), conscript(0), type(VoidType::get()) {
+Const::Const(ADDRESS a) : Exp(opIntConst, ExpKind::Const), strin(noString()), conscript(0), type(VoidType::get()) {
     assert(a.isSourceAddr());
     u.a = a;
 }
 
 // Copy constructor
-Const::Const(const Const &o) : Exp(o.op) {
+Const::Const(const Const &o) : Exp(o.op, ExpKind::Const) {
     u = o.u;
     conscript = o.conscript;
     type = o.type;
     strin = o.strin;
+    if (strin != noString())
+        NameTable::retain(strin);
 }
 
-Terminal::Terminal(OPER op) : Exp(op) {}
-Terminal::Terminal(const Terminal &o) : Exp(o.op) {} // Copy constructor
+Const::~Const() { releaseString(strin); }
+
+void Const::setStr(const QString &p) {
+    const QString *old = strin;
+    strin = poolString(p);
+    releaseString(old);
+    changed();
+}
+
+Terminal::Terminal(OPER op) : Exp(op, ExpKind::Terminal) {}
+Terminal::Terminal(const Terminal &o) : Exp(o.op, ExpKind::Terminal) {} // Copy constructor
+//! Terminals are never changed in place, so when interning is enabled (-ie) they are shared
+Exp *Terminal::get(OPER op) {
+    if (ExpTable::get().isEnabled())
+        return ExpTable::get().terminal(op);
+    return new Terminal(op);
+}
 
-Unary::Unary(OPER op) : Exp(op) /*,subExp1(nullptr)*/ {
+Unary::Unary(OPER op) : Exp(op, ExpKind::Unary) /*,subExp1(nullptr)*/ {
     // pointer uninitialized to help out finding usages of null pointers ?
     assert(op != opRegOf);
 }
 
-Unary::Unary(OPER op, Exp *e) : Exp(op), subExp1(e) { assert(subExp1); }
-Unary::Unary(const Unary &o) : Exp(o.op) {
+Unary::Unary(OPER op, Exp *e) : Exp(op, ExpKind::Unary), subExp1(e) { assert(subExp1); }
+Unary::Unary(const Unary &o) : Exp(o.op, ExpKind::Unary) {
     subExp1 = o.subExp1->clone();
     assert(subExp1);
 }
 
 Binary::Binary(OPER op) : Unary(op) {
+    kind = ExpKind::Binary;
     // Initialise the 2nd pointer. The first pointer is initialised in the Unary constructor
     // subExp2 = 0;
 }
-Binary::Binary(OPER op, Exp *e1, Exp *e2) : Unary(op, e1), subExp2(e2) { assert(subExp1 && subExp2); }
+Binary::Binary(OPER op, Exp *e1, Exp *e2) : Unary(op, e1), subExp2(e2) {
+    kind = ExpKind::Binary;
+    assert(subExp1 && subExp2);
+}
 Binary::Binary(const Binary &o) : Unary(op) {
+    kind = ExpKind::Binary;
     setSubExp1(subExp1->clone());
     subExp2 = o.subExp2->clone();
     assert(subExp1 && subExp2);
 }
 
-Ternary::Ternary(OPER op) : Binary(op) { subExp3 = nullptr; }
+Ternary::Ternary(OPER op) : Binary(op) {
+    kind = ExpKind::Ternary;
+    subExp3 = nullptr;
+}
 Ternary::Ternary(OPER op, Exp *e1, Exp *e2, Exp *e3) : Binary(op, e1, e2) {
+    kind = ExpKind::Ternary;
     subExp3 = e3;
     assert(subExp1 && subExp2 && subExp3);
 }
 Ternary::Ternary(const Ternary &o) : Binary(o.op) {
+    kind = ExpKind::Ternary;
     subExp1 = o.subExp1->clone();
     subExp2 = o.subExp2->clone();
     subExp3 = o.subExp3->clone();
     assert(subExp1 && subExp2 && subExp3);
 }
 
-TypedExp::TypedExp() : Unary(opTypedExp), type(nullptr) {}
-TypedExp::TypedExp(Exp *e1) : Unary(opTypedExp, e1), type(nullptr) {}
-TypedExp::TypedExp(SharedType ty, Exp *e1) : Unary(opTypedExp, e1), type(ty) {}
+TypedExp::TypedExp() : Unary(opTypedExp), type(nullptr) { kind = ExpKind::TypedExp; }
+TypedExp::TypedExp(Exp *e1) : Unary(opTypedExp, e1), type(nullptr) { kind = ExpKind::TypedExp; }
+TypedExp::TypedExp(SharedType ty, Exp *e1) : Unary(opTypedExp, e1), type(ty) { kind = ExpKind::TypedExp; }
 TypedExp::TypedExp(TypedExp &o) : Unary(opTypedExp) {
+    kind = ExpKind::TypedExp;
     subExp1 = o.subExp1->clone();
     type = o.type->clone();
 }
 
-FlagDef::FlagDef(Exp *params, RTL *rtl) : Unary(opFlagDef, params), rtl(rtl) {}
+FlagDef::FlagDef(Exp *params, RTL *rtl) : Unary(opFlagDef, params), rtl(rtl) { kind = ExpKind::FlagDef; }
 
-RefExp::RefExp(Exp *e, Instruction *d) : Unary(opSubscript, e), def(d) { assert(e); }
+RefExp::RefExp(Exp *e, Instruction *d) : Unary(opSubscript, e), def(d) {
+    kind = ExpKind::RefExp;
+    assert(e);
+}
 
-TypeVal::TypeVal(SharedType ty) : Terminal(opTypeVal), val(ty) {}
+TypeVal::TypeVal(SharedType ty) : Terminal(opTypeVal), val(ty) { kind = ExpKind::TypeVal; }
 
 /**
  * Create a new Location expression.
@@ -116,6 +207,7 @@ TypeVal::TypeVal(SharedType ty) : Terminal(opTypeVal), val(ty) {}
  * \param p - enclosing procedure, if null this constructor will try to find it.
  */
 Location::Location(OPER op, Exp *exp, UserProc *p) : Unary(op, exp), proc(p) {
+    kind = ExpKind::Location;
     assert(op == opRegOf || op == opMemOf || op == opLocal || op == opGlobal || op == opParam || op == opTemp);
     if (p == nullptr) {
         // eep.. this almost always causes problems
@@ -145,7 +237,7 @@ Location::Location(OPER op, Exp *exp, UserProc *p) : Unary(op, exp), proc(p) {
     }
 }
 
-Location::Location(Location &o) : Unary(o.op, o.subExp1->clone()), proc(o.proc) {}
+Location::Location(Location &o) : Unary(o.op, o.subExp1->clone()), proc(o.proc) { kind = ExpKind::Location; }
 
 Unary::~Unary() {
     // Remember to ;//delete all children
@@ -182,6 +274,7 @@ void Unary::setSubExp1(Exp *e) {
         ; // delete subExp1;
     }
     subExp1 = e;
+    changed();
     assert(subExp1);
 }
 void Binary::setSubExp2(Exp *e) {
@@ -189,6 +282,7 @@ void Binary::setSubExp2(Exp *e) {
         ; // delete subExp2;
     }
     subExp2 = e;
+    changed();
     assert(subExp1 && subExp2);
 }
 void Ternary::setSubExp3(Exp *e) {
@@ -196,6 +290,7 @@ void Ternary::setSubExp3(Exp *e) {
         ; // delete subExp3;
     }
     subExp3 = e;
+    changed();
     assert(subExp1 && subExp2 && subExp3);
 }
 /***************************************************************************/ /**
@@ -211,6 +306,7 @@ const Exp *Unary::getSubExp1() const {
     assert(subExp1);
     return subExp1;
 }
+// The caller may change the subexpression through the reference
 Exp *&Unary::refSubExp1() {
     assert(subExp1);
     return subExp1;
@@ -254,6 +350,7 @@ Exp *&Exp::refSubExp3() { return dummy; }
 /// Swap the two subexpressions.
 void Binary::commute() {
     std::swap(subExp1,subExp2);
+    changed();
     assert(subExp1 && subExp2);
 }
 
@@ -336,7 +433,7 @@ bool Const::operator==(const Exp &o) const {
     case opFltConst:
         return u.d == ((Const &)o).u.d;
     case opStrConst:
-        return strin == ((Const &)o).strin;
+        return strin == ((Const &)o).strin; // Pooled: equal strings are the same string
     default:
         LOG << "Operator== invalid operator " << operStrings[op] << "\n";
         assert(0);
@@ -457,7 +554,7 @@ bool Const::operator<(const Exp &o) const {
     case opFltConst:
         return u.d < ((Const &)o).u.d;
     case opStrConst:
-        return strin < ((Const &)o).strin;
+        return strin != ((Const &)o).strin && *strin < *((Const &)o).strin;
     default:
         LOG << "Operator< invalid operator " << operStrings[op] << "\n";
         assert(0);
@@ -548,6 +645,96 @@ bool TypeVal::operator<(const Exp &o) const {
     return *val < *((TypeVal &)o).val;
 }
 
+/***************************************************************************/ /**
+  *
+  * \brief        Compute the hash of this node for hash()
+  * \note         Must agree with operator<: whatever operator< ignores (the type of TypedExps and Consts, the proc of
+  *               Locations, the type of TypeVals) is left out here too
+  * \returns      The hash value
+  ******************************************************************************/
+size_t Exp::computeHash() const { return std::hash<int>()(op); }
+
+size_t Const::computeHash() const {
+    size_t h = hashCombine(std::hash<int>()(op), std::hash<int>()(conscript));
+    switch (op) {
+    case opIntConst:
+        return hashCombine(h, std::hash<int>()(u.i));
+    case opLongConst:
+        return hashCombine(h, std::hash<QWord>()(u.ll));
+    case opFltConst:
+        // 0.0 and -0.0 compare equal, so they must hash the same
+        return hashCombine(h, u.d == 0.0 ? 0 : std::hash<double>()(u.d));
+    case opStrConst:
+        return hashCombine(h, qHash(*strin));
+    default:
+        return h;
+    }
+}
+
+size_t Unary::computeHash() const { return hashCombine(std::hash<int>()(op), subExp1->hash()); }
+
+size_t Binary::computeHash() const { return hashCombine(Unary::computeHash(), subExp2->hash()); }
+
+size_t Ternary::computeHash() const { return hashCombine(Binary::computeHash(), subExp3->hash()); }
+
+// Note: a wildcard definition would have to hash like every other definition, so hashed containers can't be searched
+// with one (use the ordered lessExpStar containers for that)
+size_t RefExp::computeHash() const { return hashCombine(Unary::computeHash(), std::hash<Instruction *>()(def)); }
+
+/***************************************************************************/ /**
+  * \brief        Compute the props of this node for props()
+  * \note         Must agree with the visitors that getComplexityDepth() (ComplexityFinder), containsFlags()
+  *               (FlagsFinder) and containsBadMemof() (BadMemofFinder) used to run on every call
+  * \param        p - where to add the props of this node to; cleared on entry
+  ******************************************************************************/
+static void addProps(Exp::Props &p, const Exp *child) {
+    const Exp::Props &c(child->props());
+    p.memofs += c.memofs;
+    p.complexity += c.complexity;
+    p.nodes += c.nodes;
+    p.flags |= c.flags;
+    p.badMemof |= c.badMemof;
+}
+
+void Unary::computeProps(Props &p) const {
+    addProps(p, subExp1);
+    p.complexity++;
+}
+
+void Binary::computeProps(Props &p) const {
+    addProps(p, subExp1);
+    addProps(p, subExp2);
+    p.complexity++;
+    p.flags |= op == opFlagCall;
+}
+
+void Ternary::computeProps(Props &p) const {
+    addProps(p, subExp1);
+    addProps(p, subExp2);
+    addProps(p, subExp3);
+    p.complexity++;
+}
+
+// Unlike plain Unaries, these don't add to the complexity
+void TypedExp::computeProps(Props &p) const { addProps(p, subExp1); }
+void FlagDef::computeProps(Props &p) const { addProps(p, subExp1); }
+
+void RefExp::computeProps(Props &p) const {
+    addProps(p, subExp1);
+    // A subscripted memof is not bad in itself, but there could be a bad one in its address
+    p.badMemof = subExp1->isMemOf() && subExp1->getSubExp1()->props().badMemof;
+}
+
+void Location::computeProps(Props &p) const {
+    addProps(p, subExp1);
+    if (op == opMemOf) {
+        p.memofs++;
+        p.badMemof = true; // Bare, since it isn't reached through a RefExp
+    }
+    if (op == opMemOf || op == opArrayIndex)
+        p.complexity++;
+}
+
 /***************************************************************************/ /**
   *
   * \brief        Virtual function to compare myself for equality with another Exp, *ignoring subscripts*
@@ -668,7 +855,7 @@ void Const::print(QTextStream &os, bool /*html*/) const {
         os << buf;
         break;
     case opStrConst:
-        os << "\"" << strin << "\"";
+        os << "\"" << *strin << "\"";
         break;
     default:
         LOG << "Const::print invalid operator " << operStrings[op] << "\n";
@@ -685,7 +872,7 @@ void Const::print(QTextStream &os, bool /*html*/) const {
 
 void Const::printNoQuotes(QTextStream &os) {
     if (op == opStrConst)
-        os << strin;
+        os << *strin;
     else
         print(os);
 }
@@ -1396,12 +1583,10 @@ void TypeVal::print(QTextStream &os, bool /*html*/) const {
   * \returns            Address of the static buffer
   ******************************************************************************/
 char *Exp::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     print(ost);
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 void Exp::dump() {
@@ -1443,7 +1628,7 @@ void Const::appendDotFile(QTextStream &of) {
         of << u.d;
         break;
     case opStrConst:
-        of << "\\\"" << strin << "\\\"";
+        of << "\\\"" << *strin << "\\\"";
         break;
     // Might want to distinguish this better, e.g. "(func*)myProc"
     case opFuncConst:
@@ -1617,6 +1802,39 @@ Exp *Exp::getGuard() {
     return nullptr;
 }
 
+//! True if any node of \a e is in an arena
+static bool isInArena(const Exp *e) {
+    if (e == nullptr)
+        return false;
+    if (Arena::owns(e))
+        return true;
+    switch (e->getArity()) {
+    case 3:
+        if (isInArena(e->getSubExp3()))
+            return true;
+    // fallthrough
+    case 2:
+        if (isInArena(e->getSubExp2()))
+            return true;
+    // fallthrough
+    case 1:
+        return isInArena(e->getSubExp1());
+    default:
+        return false;
+    }
+}
+
+/***************************************************************************/ /**
+  * \brief   Return \a e, or if any of it is in an arena, a copy of it made on the heap. For what outlives the proc
+  * being decompiled, such as the Exps of signatures: its arena takes its own with it when released (see deleteCFG())
+  ******************************************************************************/
+Exp *Exp::outsideArena(Exp *e) {
+    if (!isInArena(e))
+        return e;
+    ArenaScope onHeap(nullptr);
+    return e->clone();
+}
+
 /***************************************************************************/ /**
   *
   * \brief        Matches this expression to the given patten
@@ -1696,173 +1914,21 @@ Exp* TypeVal::match(Exp *pattern) {
     return Exp::match(pattern);
 }
 #endif
-static QRegularExpression variableRegexp("[a-zA-Z0-9]+");
-
-// TODO use regexp ?
-#define ISVARIABLE_S(x)                                                                                                \
-    (strspn((x.c_str()), "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789") == (x).length())
-//#define DEBUG_MATCH
-
-int tlstrchr(const QString &str, char ch) {
-    static QMap<QChar,QChar> braces { {'[',']'},{'{','}'},{'(',')'} };
-    int i=0,e=str.length();
-    for(; i<e; ++i) {
-        if(str[i].toLatin1()==ch)
-            return i;
-        if(braces.contains(str[i])) {
-            QChar end_brace = braces[str[i]];
-            ++i; //from next char
-            for(; i<e; ++i)
-                if(str[i]==end_brace)
-                    break;
-        }
-    }
-    if(i==e)
-        return -1;
-    return i;
-}
-
 /***************************************************************************/ /**
   *
-  * \brief        Matches this expression to the given patten
+  * \brief        Matches this expression to the given patten, which is compiled on first use (see CompiledPattern)
   * \param pattern to match
-  * \param bindings a map
+  * \param bindings a map, which gets the subexpression bound to each variable of the pattern
   * \returns            true if match, false otherwise
   ******************************************************************************/
 bool Exp::match(const QString &pattern, std::map<QString, Exp *> &bindings) {
-    // most obvious
-    QString tgt;
-    QTextStream ostr(&tgt);
-    print(ostr);
-    if (tgt == pattern)
-        return true;
-
-    assert((pattern.lastIndexOf(variableRegexp)==0) == ISVARIABLE_S(pattern.toStdString()));
-    // alright, is pattern an acceptable variable?
-    if (pattern.lastIndexOf(variableRegexp)==0) {
-        bindings[pattern] = this;
-        return true;
-    }
-    // no, fail
-    return false;
-}
-bool Unary::match(const QString &pattern, std::map<QString, Exp *> &bindings) {
-    if (Exp::match(pattern, bindings))
-        return true;
-#ifdef DEBUG_MATCH
-    LOG << "unary::match " << this << " to " << pattern << ".\n";
-#endif
-    if (op == opAddrOf && pattern.startsWith("a[") && pattern.endsWith(']')) {
-        return subExp1->match(pattern.mid(2,pattern.size() - 1), bindings); // eliminate 'a[' and ']'
-    }
-    return false;
-}
-bool Binary::match(const QString &pattern, std::map<QString, Exp *> &bindings) {
-    if (Exp::match(pattern, bindings))
-        return true;
-#ifdef DEBUG_MATCH
-    LOG << "binary::match " << this << " to " << pattern << ".\n";
-#endif
-    if (op == opMemberAccess && -1!=tlstrchr(pattern, '.')) {
-        QString sub1 = pattern;
-        int split_point = tlstrchr(sub1, '.');
-        QString follow = sub1.right(sub1.length()-split_point);
-        sub1 = sub1.left(split_point);
-        if (subExp1->match(sub1, bindings)) {
-            assert(subExp2->isStrConst());
-            if (follow == ((Const *)subExp2)->getStr())
-                return true;
-            if ((follow.lastIndexOf(variableRegexp)==0)) {
-                bindings[follow] = subExp2;
-                return true;
-            }
-        }
-    }
-    if (op == opArrayIndex) {
-        if (!pattern.endsWith(']'))
-            return false;
-        QString sub1 = pattern;
-        QString sub2 = sub1.mid(sub1.lastIndexOf('[')+1);
-        if (subExp1->match(sub1, bindings) && subExp2->match(sub2, bindings))
-            return true;
-    }
-    if (op == opPlus && -1!=tlstrchr(pattern, '+')) {
-        int splitpoint = tlstrchr(pattern, '+');
-        QString sub1 = pattern.left(splitpoint);
-        QString sub2 = pattern.mid(splitpoint+1).trimmed();
-        if (subExp1->match(sub1, bindings) && subExp2->match(sub2, bindings))
-            return true;
-    }
-    if (op == opMinus && -1!=tlstrchr(pattern, '-')) {
-        int splitpoint = tlstrchr(pattern, '-');
-        QString sub1 = pattern.left(splitpoint);
-        QString sub2 = pattern.mid(splitpoint+1).trimmed();
-        if (subExp1->match(sub1, bindings) && subExp2->match(sub2, bindings))
-            return true;
-    }
-    return false;
-}
-bool Ternary::match(const QString &pattern, std::map<QString, Exp *> &bindings) {
-    if (Exp::match(pattern, bindings))
-        return true;
-#ifdef DEBUG_MATCH
-    LOG << "ternary::match " << this << " to " << pattern << ".\n";
-#endif
-    return false;
-}
-bool RefExp::match(const QString &pattern, std::map<QString, Exp *> &bindings) {
-    if (Exp::match(pattern, bindings))
-        return true;
-#ifdef DEBUG_MATCH
-    LOG << "refexp::match " << this << " to " << pattern << ".\n";
-#endif
-    if (pattern.endsWith('}')) {
-        if (pattern[pattern.size()-2] == '-' && def == nullptr) {
-            return subExp1->match(pattern.left(pattern.size()-3), bindings); // remove {-}
-        }
-        int end = pattern.lastIndexOf('{');
-        if (end!=-1) {
-            // "prefix {number ...}" -> number matches first def ?
-            if(pattern.midRef(end+1).toInt()==def->getNumber()) {
-                // match "prefix"
-                return subExp1->match(pattern.left(end-1),bindings);
-            }
-        }
-    }
-    return false;
-}
-bool Const::match(const QString &pattern, std::map<QString, Exp *> &bindings) {
-    if (Exp::match(pattern, bindings))
-        return true;
-#ifdef DEBUG_MATCH
-    LOG << "const::match " << this << " to " << pattern << ".\n";
-#endif
-    return false;
-}
-bool Terminal::match(const QString &pattern, std::map<QString, Exp *> &bindings) {
-    if (Exp::match(pattern, bindings))
-        return true;
-#ifdef DEBUG_MATCH
-    LOG << "terminal::match " << this << " to " << pattern << ".\n";
-#endif
-    return false;
-}
-bool Location::match(const QString &pattern, std::map<QString, Exp *> &bindings) {
-    if (Exp::match(pattern, bindings))
-        return true;
-#ifdef DEBUG_MATCH
-    LOG << "location::match " << this << " to " << pattern << ".\n";
-#endif
-    if (op == opMemOf || op == opRegOf) {
-        if (op == opRegOf && !pattern.startsWith("r["))
-            return false;
-        if (op == opMemOf && !pattern.startsWith("m["))
-            return false;
-        if (!pattern.endsWith(']'))
-            return false;
-        return subExp1->match(pattern.mid(2), bindings); // shouldn't this cut the last ']' ??
-    }
-    return false;
+    const CompiledPattern &compiled(CompiledPattern::get(pattern));
+    CompiledPattern::Bindings b;
+    if (!compiled.match(this, b))
+        return false;
+    for (int i = 0; i < compiled.numVars(); i++)
+        bindings[compiled.varName(i)] = b[i];
+    return true;
 }
 
 /***************************************************************************/ /**
@@ -1879,7 +1945,7 @@ bool Location::match(const QString &pattern, std::map<QString, Exp *> &bindings)
   * \param   once if set to true only the first possible replacement will be made
   *
   ******************************************************************************/
-void Exp::doSearch(const Exp &search, Exp *&pSrc, std::list<Exp **> &li, bool once) {
+void Exp::doSearch(const Exp &search, Exp *&pSrc, ExpSlotList &li, bool once) {
     bool compare;
     compare = (search == *pSrc);
     if (compare) {
@@ -1903,29 +1969,29 @@ void Exp::doSearch(const Exp &search, Exp *&pSrc, std::list<Exp **> &li, bool on
   * \param       once - true if not all occurrences to be found, false for all
   *
   ******************************************************************************/
-void Exp::doSearchChildren(const Exp & search, std::list<Exp **> & li, bool once) {
+void Exp::doSearchChildren(const Exp & search, ExpSlotList & li, bool once) {
     Q_UNUSED(search);
     Q_UNUSED(li);
     Q_UNUSED(once);
     return; // Const and Terminal do not override this
 }
-void Unary::doSearchChildren(const Exp &search, std::list<Exp **> &li, bool once) {
+void Unary::doSearchChildren(const Exp &search, ExpSlotList &li, bool once) {
     if (op != opInitValueOf) // don't search child
         doSearch(search, subExp1, li, once);
 }
-void Binary::doSearchChildren(const Exp &search, std::list<Exp **> &li, bool once) {
+void Binary::doSearchChildren(const Exp &search, ExpSlotList &li, bool once) {
     assert(subExp1 && subExp2);
     doSearch(search, subExp1, li, once);
-    if (once && li.size())
+    if (once && !li.empty())
         return;
     doSearch(search, subExp2, li, once);
 }
-void Ternary::doSearchChildren(const Exp &search, std::list<Exp **> &li, bool once) {
+void Ternary::doSearchChildren(const Exp &search, ExpSlotList &li, bool once) {
     doSearch(search, subExp1, li, once);
-    if (once && li.size())
+    if (once && !li.empty())
         return;
     doSearch(search, subExp2, li, once);
-    if (once && li.size())
+    if (once && !li.empty())
         return;
     doSearch(search, subExp3, li, once);
 }
@@ -1966,20 +2032,34 @@ Exp *Exp::searchReplaceAll(const Exp &search, Exp *replace, bool &change, bool o
         return replace->clone();
     }
     assert(this != &search);
-    std::list<Exp **> li;
+    ExpSlotList li;
     Exp *top = this; // top may change; that's why we have to return it
-    doSearch(search, top, li, false);
-    std::list<Exp **>::iterator it;
-    for (it = li.begin(); it != li.end(); it++) {
-        Exp **pp = *it;
+    doSearch(search, top, li, once);
+    for (Exp **pp : li) {
         // if (*pp) //delete *pp;         // Delete any existing
         *pp = replace->clone(); // Do the replacement
-        if (once) {
-            change = true;
-            return top;
-        }
     }
-    change = (li.size() != 0);
+    change = !li.empty();
+    if (change)
+        changed(); // The slots are inside the parents, whose cached hashes and props are now stale
+    return top;
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief   Search for all the searches in \a replacements at once, and replace wherever found, in one walk of this
+  *          expression instead of one per search
+  * \note    Where a match is inside another, only the outer one is replaced, as when searching for each in turn. The
+  *          searches must not contain wildcards; they are looked up by their hashes.
+  * \note    Replacements are cloned
+  * \param   replacements each search, and the Exp to replace it with
+  * \param   change set true if a change made; cleared otherwise
+  * \returns the result (often this, but possibly changed)
+  ******************************************************************************/
+Exp *Exp::searchReplaceAll(const ExpReplaceMap &replacements, bool &change) {
+    ExpReplacer er(replacements);
+    Exp *top = ExpWalker<ExpReplacer>::modify(this, er);
+    change = er.isChanged();
     return top;
 }
 
@@ -1994,13 +2074,13 @@ Exp *Exp::searchReplaceAll(const Exp &search, Exp *replace, bool &change, bool o
   * \returns            True if a match was found
   ******************************************************************************/
 bool Exp::search(const Exp &search, Exp *&result) {
-    std::list<Exp **> li;
+    ExpSlotList li;
     result = nullptr; // In case it fails; don't leave it unassigned
     // The search requires a reference to a pointer to this object.
     // This isn't needed for searches, only for replacements, but we want to re-use the same search routine
     Exp *top = this;
-    doSearch(search, top, li, false);
-    if (li.size()) {
+    doSearch(search, top, li, true); // The first match in preorder is all we need
+    if (!li.empty()) {
         result = *li.front();
         return true;
     }
@@ -2016,19 +2096,28 @@ bool Exp::search(const Exp &search, Exp *&result) {
   * \returns            True if a match was found
   ******************************************************************************/
 bool Exp::searchAll(const Exp &search, std::list<Exp *> &result) {
-    std::list<Exp **> li;
+    ExpSlotList li;
     // result.clear();    // No! Useful when searching for more than one thing
     // (add to the same list)
     // The search requires a reference to a pointer to this object.
     // This isn't needed for searches, only for replacements, but we want to re-use the same search routine
     Exp *pSrc = this;
     doSearch(search, pSrc, li, false);
-    std::list<Exp **>::iterator it;
-    for (it = li.begin(); it != li.end(); it++) {
+    for (Exp **pp : li) {
         // li is list of Exp**; result is list of Exp*
-        result.push_back(**it);
+        result.push_back(*pp);
     }
-    return li.size() != 0;
+    return !li.empty();
+}
+
+//! As above, but appending to a list that only goes to the heap when there are more than a few matches
+bool Exp::searchAll(const Exp &search, ExpMatchList &result) {
+    ExpSlotList li;
+    Exp *pSrc = this;
+    doSearch(search, pSrc, li, false);
+    for (Exp **pp : li)
+        result.push_back(*pp);
+    return !li.empty();
 }
 
 // These simplifying functions don't really belong in class Exp, but they know too much about how Exps work
@@ -2096,6 +2185,7 @@ void Exp::partitionTerms(std::list<Exp *> &positives, std::list<Exp *> &negative
   * \returns            Ptr to the simplified expression
   ******************************************************************************/
 Exp *Unary::simplifyArith() {
+    ExpChangeGuard changing(this);
     if (op == opMemOf || op == opRegOf || op == opAddrOf || op == opSubscript) {
         // assume we want to simplify the subexpression
         subExp1 = subExp1->simplifyArith();
@@ -2104,6 +2194,7 @@ Exp *Unary::simplifyArith() {
 }
 
 Exp *Ternary::simplifyArith() {
+    ExpChangeGuard changing(this);
     subExp1 = subExp1->simplifyArith();
     subExp2 = subExp2->simplifyArith();
     subExp3 = subExp3->simplifyArith();
@@ -2111,6 +2202,7 @@ Exp *Ternary::simplifyArith() {
 }
 
 Exp *Binary::simplifyArith() {
+    ExpChangeGuard changing(this);
     assert(subExp1 && subExp2);
     subExp1 = subExp1->simplifyArith(); // FIXME: does this make sense?
     subExp2 = subExp2->simplifyArith(); // FIXME: ditto
@@ -2135,6 +2227,7 @@ Exp *Binary::simplifyArith() {
         while (nn != negatives.end()) {
             if (**pp == **nn) {
                 // A positive and a negative that are equal; therefore they cancel
+                SIMPLIFY_RULE("Arith: x - x cancelled");
                 pp = positives.erase(pp); // Erase the pointers, not the Exps
                 nn = negatives.erase(nn);
                 inc = false; // Don't increment pp now
@@ -2150,6 +2243,8 @@ Exp *Binary::simplifyArith() {
 
     // Summarise the set of integers to a single number.
     int sum = std::accumulate(integers.begin(), integers.end(), 0);
+    if (integers.size() > 1)
+        SIMPLIFY_RULE("Arith: constants summed");
 
     // Now put all these elements back together and return the result
     if (positives.size() == 0) {
@@ -2229,15 +2324,29 @@ Exp *Exp::Accumulate(std::list<Exp *> exprs) {
       ******************************************************************************/
 #define DEBUG_SIMP 0                                                              // Set to 1 to print every change
 Exp *Exp::simplify() {
+    SimplifyCache &memo(SimplifyCache::get());
+    if (memo.isEnabled())
+        return memo.simplify(this);
+    return simplifyUncached();
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief        Simplify this expression (running polySimplify to a fixed point), without the SimplifyCache
+  * \returns      Ptr to the simplified expression
+  ******************************************************************************/
+Exp *Exp::simplifyUncached() {
 #if DEBUG_SIMP
     Exp *save = clone();
 #endif
     bool bMod = false; // True if simplified at this or lower level
     Exp *res = this;
+    size_t rounds = 0;
     // res = ExpTransformer::applyAllTo(res, bMod);
     // return res;
     do {
         bMod = false;
+        rounds++;
         // Exp *before = res->clone();
         res = res->polySimplify(bMod); // Call the polymorphic simplify
                                        /*      if (bMod) {
@@ -2247,6 +2356,8 @@ Exp *Exp::simplify() {
                                                        // transformations directory to include a rule for the reported transform.
                                                } */
     } while (bMod);                    // If modified at this (or a lower) level, redo
+    if (SimplifyStats::enabled)
+        SimplifyStats::get().countRounds(rounds);
 // The below is still important. E.g. want to canonicalise sums, so we know that a + K + b is the same as a + b + K
 // No! This slows everything down, and it's slow enough as it is. Call only where needed:
 // res = res->simplifyArith();
@@ -2266,6 +2377,7 @@ Exp *Exp::simplify() {
   * \returns            Ptr to the simplified expression
   ******************************************************************************/
 Exp *Unary::polySimplify(bool &bMod) {
+    ExpChangeGuard changing(this);
     Exp *res = this;
     subExp1 = subExp1->polySimplify(bMod);
 
@@ -2274,51 +2386,61 @@ Exp *Unary::polySimplify(bool &bMod) {
         case opEquals:
             res = ((Unary *)res)->getSubExp1();
             res->setOper(opNotEqual);
+            SIMPLIFY_RULE("Unary: !(a == b) => a != b");
             bMod = true;
             return res;
         case opNotEqual:
             res = ((Unary *)res)->getSubExp1();
             res->setOper(opEquals);
+            SIMPLIFY_RULE("Unary: !(a != b) => a == b");
             bMod = true;
             return res;
         case opLess:
             res = ((Unary *)res)->getSubExp1();
             res->setOper(opGtrEq);
+            SIMPLIFY_RULE("Unary: !(a < b) => a >= b");
             bMod = true;
             return res;
         case opLessEq:
             res = ((Unary *)res)->getSubExp1();
             res->setOper(opGtr);
+            SIMPLIFY_RULE("Unary: !(a <= b) => a > b");
             bMod = true;
             return res;
         case opGtr:
             res = ((Unary *)res)->getSubExp1();
             res->setOper(opLessEq);
+            SIMPLIFY_RULE("Unary: !(a > b) => a <= b");
             bMod = true;
             return res;
         case opGtrEq:
             res = ((Unary *)res)->getSubExp1();
             res->setOper(opLess);
+            SIMPLIFY_RULE("Unary: !(a >= b) => a < b");
             bMod = true;
             return res;
         case opLessUns:
             res = ((Unary *)res)->getSubExp1();
             res->setOper(opGtrEqUns);
+            SIMPLIFY_RULE("Unary: !(a <u b) => a >=u b");
             bMod = true;
             return res;
         case opLessEqUns:
             res = ((Unary *)res)->getSubExp1();
             res->setOper(opGtrUns);
+            SIMPLIFY_RULE("Unary: !(a <=u b) => a >u b");
             bMod = true;
             return res;
         case opGtrUns:
             res = ((Unary *)res)->getSubExp1();
             res->setOper(opLessEqUns);
+            SIMPLIFY_RULE("Unary: !(a >u b) => a <=u b");
             bMod = true;
             return res;
         case opGtrEqUns:
             res = ((Unary *)res)->getSubExp1();
             res->setOper(opLessUns);
+            SIMPLIFY_RULE("Unary: !(a >=u b) => a <u b");
             bMod = true;
             return res;
         default:
@@ -2353,10 +2475,12 @@ Exp *Unary::polySimplify(bool &bMod) {
                 break;
             }
             ((Const *)res)->setInt(k);
+            SIMPLIFY_RULE("Unary: -k, ~k, !k => constant");
             bMod = true;
         } else if (op == subOP) {
             res = ((Unary *)res)->getSubExp1();
             res = ((Unary *)res)->getSubExp1();
+            SIMPLIFY_RULE("Unary: --x, ~~x, !!x => x");
             bMod = true;
             break;
         }
@@ -2366,6 +2490,7 @@ Exp *Unary::polySimplify(bool &bMod) {
         if (subExp1->getOper() == opMemOf) {
             res = ((Unary *)res)->getSubExp1();
             res = ((Unary *)res)->getSubExp1();
+            SIMPLIFY_RULE("Unary: a[m[x]] => x");
             bMod = true;
             return res;
         }
@@ -2386,6 +2511,7 @@ Exp *Unary::polySimplify(bool &bMod) {
 }
 
 Exp *Binary::polySimplify(bool &bMod) {
+    ExpChangeGuard changing(this);
     assert(subExp1 && subExp2);
 
     Exp *res = this;
@@ -2483,6 +2609,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         if (change) {
             ; // delete res;
             res = new Const(k1);
+            SIMPLIFY_RULE("Binary: k1 op k2 => constant");
             bMod = true;
             return res;
         }
@@ -2491,6 +2618,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     if (((op == opBitXor) || (op == opMinus)) && (*subExp1 == *subExp2)) {
         // x ^ x or x - x: result is zero
         res = new Const(0);
+        SIMPLIFY_RULE("Binary: x ^ x, x - x => 0");
         bMod = true;
         return res;
     }
@@ -2498,6 +2626,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     if (((op == opBitOr) || (op == opBitAnd)) && (*subExp1 == *subExp2)) {
         // x | x or x & x: result is x
         res = subExp1;
+        SIMPLIFY_RULE("Binary: x | x, x & x => x");
         bMod = true;
         return res;
     }
@@ -2506,6 +2635,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         // x == x: result is true
         ; // delete this;
         res = new Terminal(opTrue);
+        SIMPLIFY_RULE("Binary: x == x => true");
         bMod = true;
         return res;
     }
@@ -2547,6 +2677,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         int n = ((Const *)subExp2)->getInt();
         res = ((Binary *)res)->getSubExp1();
         ((Const *)res->getSubExp2())->setInt(((Const *)res->getSubExp2())->getInt() + n);
+        SIMPLIFY_RULE("Binary: (x + a) + b => x + (a+b)");
         bMod = true;
         return res;
     }
@@ -2557,6 +2688,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         res = ((Binary *)res)->getSubExp1();
         res->setOper(opPlus);
         ((Const *)res->getSubExp2())->setInt((-((Const *)res->getSubExp2())->getInt()) + n);
+        SIMPLIFY_RULE("Binary: (x - a) + b => x + (b-a)");
         bMod = true;
         return res;
     }
@@ -2567,6 +2699,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         *subExp2 == *subExp1->getSubExp1()) {
         res = ((Binary *)res)->getSubExp1();
         res->setSubExp2(Binary::get(op, res->getSubExp2(), new Const(1)));
+        SIMPLIFY_RULE("Binary: (x * k) +- x => x * (k +- 1)");
         bMod = true;
         return res;
     }
@@ -2575,6 +2708,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     if (op == opPlus && (opSub2 == opMults || opSub2 == opMult) && *subExp1 == *subExp2->getSubExp1()) {
         res = ((Binary *)res)->getSubExp2();
         res->setSubExp2(Binary::get(opPlus, res->getSubExp2(), new Const(1)));
+        SIMPLIFY_RULE("Binary: x + (x * k) => x * (k+1)");
         bMod = true;
         return res;
     }
@@ -2590,6 +2724,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     // Check for exp + 0  or  exp - 0  or  exp | 0
     if ((op == opPlus || op == opMinus || op == opBitOr) && opSub2 == opIntConst && ((Const *)subExp2)->getInt() == 0) {
         res = ((Binary *)res)->getSubExp1();
+        SIMPLIFY_RULE("Binary: x + 0, x - 0, x | 0 => x");
         bMod = true;
         return res;
     }
@@ -2597,6 +2732,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     // Check for exp or false
     if (op == opOr && subExp2->isFalse()) {
         res = ((Binary *)res)->getSubExp1();
+        SIMPLIFY_RULE("Binary: x or false => x");
         bMod = true;
         return res;
     }
@@ -2606,6 +2742,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         ((Const *)subExp2)->getInt() == 0) {
         ; // delete res;
         res = new Const(0);
+        SIMPLIFY_RULE("Binary: x * 0, x & 0 => 0");
         bMod = true;
         return res;
     }
@@ -2614,6 +2751,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     if (op == opAnd && subExp2->isFalse()) {
         ; // delete res;
         res = new Terminal(opFalse);
+        SIMPLIFY_RULE("Binary: x and false => false");
         bMod = true;
         return res;
     }
@@ -2621,6 +2759,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     // Check for exp * 1
     if ((op == opMult || op == opMults) && opSub2 == opIntConst && ((Const *)subExp2)->getInt() == 1) {
         res = ((Unary *)res)->getSubExp1();
+        SIMPLIFY_RULE("Binary: x * 1 => x");
         bMod = true;
         return res;
     }
@@ -2630,6 +2769,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         *subExp2 == *subExp1->getSubExp2()) {
         res = ((Unary *)res)->getSubExp1();
         res = ((Unary *)res)->getSubExp1();
+        SIMPLIFY_RULE("Binary: x * y / y => x");
         bMod = true;
         return res;
     }
@@ -2637,6 +2777,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     // Check for exp / 1, becomes exp
     if ((op == opDiv || op == opDivs) && opSub2 == opIntConst && ((Const *)subExp2)->getInt() == 1) {
         res = ((Binary *)res)->getSubExp1();
+        SIMPLIFY_RULE("Binary: x / 1 => x");
         bMod = true;
         return res;
     }
@@ -2644,6 +2785,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     // Check for exp % 1, becomes 0
     if ((op == opMod || op == opMods) && opSub2 == opIntConst && ((Const *)subExp2)->getInt() == 1) {
         res = new Const(0);
+        SIMPLIFY_RULE("Binary: x % 1 => 0");
         bMod = true;
         return res;
     }
@@ -2652,6 +2794,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     if ((op == opMod || op == opMods) && (opSub1 == opMult || opSub1 == opMults) &&
         *subExp2 == *subExp1->getSubExp2()) {
         res = new Const(0);
+        SIMPLIFY_RULE("Binary: x * y % y => 0");
         bMod = true;
         return res;
     }
@@ -2659,6 +2802,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     // Check for exp AND -1 (bitwise AND)
     if ((op == opBitAnd) && opSub2 == opIntConst && ((Const *)subExp2)->getInt() == -1) {
         res = ((Unary *)res)->getSubExp1();
+        SIMPLIFY_RULE("Binary: x & -1 => x");
         bMod = true;
         return res;
     }
@@ -2668,6 +2812,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         // Is the below really needed?
         (((opSub2 == opIntConst && ((Const *)subExp2)->getInt() != 0)) || subExp2->isTrue())) {
         res = ((Unary *)res)->getSubExp1();
+        SIMPLIFY_RULE("Binary: x and true => x");
         bMod = true;
         return res;
     }
@@ -2676,6 +2821,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     if ((op == opOr) && (((opSub2 == opIntConst && ((Const *)subExp2)->getInt() != 0)) || subExp2->isTrue())) {
         // delete res;
         res = new Terminal(opTrue);
+        SIMPLIFY_RULE("Binary: x or true => true");
         bMod = true;
         return res;
     }
@@ -2685,6 +2831,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     if (op == opShiftL && opSub2 == opIntConst && ((k = ((Const *)subExp2)->getInt(), (k >= 0 && k < 32)))) {
         res->setOper(opMult);
         ((Const *)subExp2)->setInt(1 << k);
+        SIMPLIFY_RULE("Binary: x << k => x * 2^k");
         bMod = true;
         return res;
     }
@@ -2692,6 +2839,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     if (op == opShiftR && opSub2 == opIntConst && ((k = ((Const *)subExp2)->getInt(), (k >= 0 && k < 32)))) {
         res->setOper(opDiv);
         ((Const *)subExp2)->setInt(1 << k);
+        SIMPLIFY_RULE("Binary: x >> k => x / 2^k");
         bMod = true;
         return res;
     }
@@ -2732,6 +2880,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         subExp1 = b->subExp1;
         b->subExp1 = nullptr;
         ; // delete b;
+        SIMPLIFY_RULE("Binary: (x == y) == 1 => x == y");
         bMod = true;
         return res;
     }
@@ -2749,6 +2898,7 @@ Exp *Binary::polySimplify(bool &bMod) {
             subExp1 = b->subExp1;
             b->subExp1 = nullptr;
             ; // delete b;
+            SIMPLIFY_RULE("Binary: x + -k == 0 => x == k");
             bMod = true;
             return res;
         }
@@ -2763,6 +2913,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         subExp1 = b->subExp1;
         b->subExp1 = nullptr;
         ; // delete b;
+        SIMPLIFY_RULE("Binary: (x == y) == 0 => x != y");
         bMod = true;
         res->setOper(opNotEqual);
         return res;
@@ -2777,6 +2928,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         subExp1 = b->subExp1;
         b->subExp1 = nullptr;
         ; // delete b;
+        SIMPLIFY_RULE("Binary: (x == y) != 1 => x != y");
         bMod = true;
         res->setOper(opNotEqual);
         return res;
@@ -2785,6 +2937,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     // Check for (x == y) != 0, becomes x == y
     if (op == opNotEqual && opSub2 == opIntConst && ((Const *)subExp2)->getInt() == 0 && opSub1 == opEquals) {
         res = ((Binary *)res)->getSubExp1();
+        SIMPLIFY_RULE("Binary: (x == y) != 0 => x == y");
         bMod = true;
         return res;
     }
@@ -2793,6 +2946,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     if (op == opNotEqual && opSub2 == opIntConst && ((Const *)subExp2)->getInt() == 0 && opSub1 == opMinus &&
         subExp1->getSubExp1()->isIntConst() && ((Const *)subExp1->getSubExp1())->getInt() == 0) {
         res = Binary::get(opNotEqual, subExp1->getSubExp2()->clone(), subExp2->clone());
+        SIMPLIFY_RULE("Binary: (0 - x) != 0 => x != 0");
         bMod = true;
         return res;
     }
@@ -2806,6 +2960,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         subExp1 = b->subExp1;
         b->subExp1 = nullptr;
         ; // delete b;
+        SIMPLIFY_RULE("Binary: (x > y) == 0 => x <= y");
         bMod = true;
         res->setOper(opLessEq);
         return res;
@@ -2820,6 +2975,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         subExp1 = b->subExp1;
         b->subExp1 = nullptr;
         ; // delete b;
+        SIMPLIFY_RULE("Binary: (x >u y) == 0 => x <=u y");
         bMod = true;
         res->setOper(opLessEqUns);
         return res;
@@ -2833,6 +2989,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         ((*b1->subExp1 == *b2->subExp1 && *b1->subExp2 == *b2->subExp2) ||
          (*b1->subExp1 == *b2->subExp2 && *b1->subExp2 == *b2->subExp1))) {
         res = ((Binary *)res)->getSubExp1();
+        SIMPLIFY_RULE("Binary: (x <= y) or (x == y) => x <= y");
         bMod = true;
         return res;
     }
@@ -2847,6 +3004,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     // check for (x & x), becomes x
     if (op == opBitAnd && *subExp1 == *subExp2) {
         res = ((Binary *)res)->getSubExp1();
+        SIMPLIFY_RULE("Binary: x & x => x");
         bMod = true;
         return res;
     }
@@ -2856,6 +3014,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         subExp2->getSubExp2()->getOper() == opIntConst) {
         res = ((Binary *)res)->getSubExp2();
         ((Const *)res->getSubExp2())->setInt(((Const *)res->getSubExp2())->getInt() + 1);
+        SIMPLIFY_RULE("Binary: a + a*n => a*(n+1)");
         bMod = true;
         return res;
     }
@@ -2865,6 +3024,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         int m = ((Const *)subExp2)->getInt();
         res = ((Binary *)res)->getSubExp1();
         ((Const *)res->getSubExp2())->setInt(((Const *)res->getSubExp2())->getInt() * m);
+        SIMPLIFY_RULE("Binary: a*n*m => a*(n*m)");
         bMod = true;
         return res;
     }
@@ -2873,6 +3033,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     if (op == opLNot && opSub1 == opEquals) {
         res = ((Unary *)res)->getSubExp1();
         res->setOper(opNotEqual);
+        SIMPLIFY_RULE("Binary: !(a == b) => a != b");
         bMod = true;
         return res;
     }
@@ -2881,6 +3042,7 @@ Exp *Binary::polySimplify(bool &bMod) {
     if (op == opLNot && opSub1 == opNotEqual) {
         res = ((Unary *)res)->getSubExp1();
         res->setOper(opEquals);
+        SIMPLIFY_RULE("Binary: !(a != b) => a == b");
         bMod = true;
         return res;
     }
@@ -2925,6 +3087,7 @@ Exp *Binary::polySimplify(bool &bMod) {
                 res = Binary::get(opPlus, new Unary(opAddrOf, Binary::get(opMemberAccess, l, Const::get(nam))),
                                   new Const((int)r / 8));
                 LOG_VERBOSE(1) << "(trans1) replacing " << this << " with " << res << "\n";
+                SIMPLIFY_RULE("Binary: pointer to compound + n => &m[x].member + r");
                 bMod = true;
                 return res;
             }
@@ -2970,6 +3133,7 @@ Exp *Binary::polySimplify(bool &bMod) {
 
     if (op == opFMinus && subExp1->getOper() == opFltConst && ((Const *)subExp1)->getFlt() == 0.0) {
         res = new Unary(opFNeg, subExp2);
+        SIMPLIFY_RULE("Binary: 0.0 -f x => -f x");
         bMod = true;
         return res;
     }
@@ -2981,6 +3145,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         if (n1 == n2) {
             res = Binary::get(subExp1->getOper(), Binary::get(op, subExp1->getSubExp1()->clone(), new Const(1)),
                               new Const(n1));
+            SIMPLIFY_RULE("Binary: (x * n) +- n => (x +- 1) * n");
             bMod = true;
             return res;
         }
@@ -2996,6 +3161,7 @@ Exp *Binary::polySimplify(bool &bMod) {
                               Binary::get(subExp1->getSubExp2()->getOper(),
                                           Binary::get(op, subExp1->getSubExp2()->getSubExp1()->clone(), new Const(1)),
                                           new Const(n1)));
+            SIMPLIFY_RULE("Binary: (y + x * n) +- n => y + (x +- 1) * n");
             bMod = true;
             return res;
         }
@@ -3013,6 +3179,7 @@ Exp *Binary::polySimplify(bool &bMod) {
         if ((a % c) == 0 && (b % c) == 0) {
             res = Binary::get(opPlus, Binary::get(opMult, subExp1->getSubExp1()->getSubExp1(), new Const(a / c)),
                               Binary::get(opMult, subExp1->getSubExp2()->getSubExp1(), new Const(b / c)));
+            SIMPLIFY_RULE("Binary: (x*a + y*b) / c => x*(a/c) + y*(b/c)");
             bMod = true;
             return res;
         }
@@ -3031,16 +3198,19 @@ Exp *Binary::polySimplify(bool &bMod) {
         int c = ((Const *)subExp2)->getInt();
         if ((a % c) == 0 && (b % c) == 0) {
             res = new Const(0);
+            SIMPLIFY_RULE("Binary: (x*a + y*b) % c => 0");
             bMod = true;
             return res;
         }
         if ((a % c) == 0) {
             res = Binary::get(opMod, subExp1->getSubExp2()->clone(), new Const(c));
+            SIMPLIFY_RULE("Binary: (x*a + y*b) % c => (y*b) % c");
             bMod = true;
             return res;
         }
         if ((b % c) == 0) {
             res = Binary::get(opMod, subExp1->getSubExp1()->clone(), new Const(c));
+            SIMPLIFY_RULE("Binary: (x*a + y*b) % c => (x*a) % c");
             bMod = true;
             return res;
         }
@@ -3055,6 +3225,7 @@ Exp *Binary::polySimplify(bool &bMod) {
                 Exp *leftOfLess = ((Binary *)rightOfMinus)->getSubExp1();
                 if (leftOfLess->isIntConst() && ((Const *)leftOfLess)->getInt() == 0) {
                     res = getSubExp2();
+                    SIMPLIFY_RULE("Binary: (0 - (0 <u x)) & y => y");
                     bMod = true;
                     return res;
                 }
@@ -3074,6 +3245,7 @@ Exp *Binary::polySimplify(bool &bMod) {
             ty->setSize(n);
 #endif
         res = ((Binary *)res)->getSubExp2();
+        SIMPLIFY_RULE("Binary: size(n, loc) => loc");
         bMod = true;
         return res;
     }
@@ -3082,6 +3254,7 @@ Exp *Binary::polySimplify(bool &bMod) {
 }
 
 Exp *Ternary::polySimplify(bool &bMod) {
+    ExpChangeGuard changing(this);
     Exp *res = this;
 
     subExp1 = subExp1->polySimplify(bMod);
@@ -3095,6 +3268,7 @@ Exp *Ternary::polySimplify(bool &bMod) {
 
         if (s2->getInt() == 1 && s3->getInt() == 0) {
             res = this->getSubExp1();
+            SIMPLIFY_RULE("Ternary: p ? 1 : 0 => p");
             bMod = true;
             return res;
         }
@@ -3103,6 +3277,7 @@ Exp *Ternary::polySimplify(bool &bMod) {
     // 1 ? x : y -> x
     if (op == opTern && subExp1->getOper() == opIntConst && ((Const *)subExp1)->getInt() == 1) {
         res = this->getSubExp2();
+        SIMPLIFY_RULE("Ternary: 1 ? x : y => x");
         bMod = true;
         return res;
     }
@@ -3110,12 +3285,14 @@ Exp *Ternary::polySimplify(bool &bMod) {
     // 0 ? x : y -> y
     if (op == opTern && subExp1->getOper() == opIntConst && ((Const *)subExp1)->getInt() == 0) {
         res = this->getSubExp3();
+        SIMPLIFY_RULE("Ternary: 0 ? x : y => y");
         bMod = true;
         return res;
     }
 
     if ((op == opSgnEx || op == opZfill) && subExp3->getOper() == opIntConst) {
         res = this->getSubExp3();
+        SIMPLIFY_RULE("Ternary: sgnex/zfill(k) => k");
         bMod = true;
         return res;
     }
@@ -3123,12 +3300,14 @@ Exp *Ternary::polySimplify(bool &bMod) {
     if (op == opFsize && subExp3->getOper() == opItof && *subExp1 == *subExp3->getSubExp2() &&
         *subExp2 == *subExp3->getSubExp1()) {
         res = this->getSubExp3();
+        SIMPLIFY_RULE("Ternary: fsize(itof(x)) => itof(x)");
         bMod = true;
         return res;
     }
 
     if (op == opFsize && subExp3->getOper() == opFltConst) {
         res = this->getSubExp3();
+        SIMPLIFY_RULE("Ternary: fsize(float) => float");
         bMod = true;
         return res;
     }
@@ -3137,6 +3316,7 @@ Exp *Ternary::polySimplify(bool &bMod) {
         ((Const *)subExp2)->getInt() == 32) {
         unsigned n = ((Const *)subExp3)->getInt();
         res = new Const(*(float *)&n);
+        SIMPLIFY_RULE("Ternary: itof(32, k) => float");
         bMod = true;
         return res;
     }
@@ -3153,6 +3333,7 @@ Exp *Ternary::polySimplify(bool &bMod) {
                 if (VERBOSE)
                     LOG << "replacing " << subExp3 << " with " << d << " in " << this << "\n";
                 subExp3 = new Const(d);
+                SIMPLIFY_RULE("Ternary: fsize(m[k]) => float constant");
                 bMod = true;
                 return res;
             }
@@ -3166,11 +3347,13 @@ Exp *Ternary::polySimplify(bool &bMod) {
         if (from == 32) {
             if (to == 16) {
                 res = new Const(ADDRESS::g(val & 0xffff));
+                SIMPLIFY_RULE("Ternary: truncu(32, 16, k) => constant");
                 bMod = true;
                 return res;
             }
             if (to == 8) {
                 res = new Const(ADDRESS::g(val & 0xff));
+                SIMPLIFY_RULE("Ternary: truncu(32, 8, k) => constant");
                 bMod = true;
                 return res;
             }
@@ -3184,11 +3367,13 @@ Exp *Ternary::polySimplify(bool &bMod) {
         if (from == 32) {
             if (to == 16) {
                 res = new Const(val & 0xffff);
+                SIMPLIFY_RULE("Ternary: truncs(32, 16, k) => constant");
                 bMod = true;
                 return res;
             }
             if (to == 8) {
                 res = new Const(val & 0xff);
+                SIMPLIFY_RULE("Ternary: truncs(32, 8, k) => constant");
                 bMod = true;
                 return res;
             }
@@ -3199,11 +3384,13 @@ Exp *Ternary::polySimplify(bool &bMod) {
 }
 
 Exp *TypedExp::polySimplify(bool &bMod) {
+    ExpChangeGuard changing(this);
     Exp *res = this;
 
     if (subExp1->getOper() == opRegOf) {
         // type cast on a reg of.. hmm.. let's remove this
         res = ((Unary *)res)->getSubExp1();
+        SIMPLIFY_RULE("TypedExp: cast of r[x] => r[x]");
         bMod = true;
         return res;
     }
@@ -3213,6 +3400,7 @@ Exp *TypedExp::polySimplify(bool &bMod) {
 }
 
 Exp *RefExp::polySimplify(bool &bMod) {
+    ExpChangeGuard changing(this);
     Exp *res = this;
 
     Exp *tmp = subExp1->polySimplify(bMod);
@@ -3227,6 +3415,7 @@ Exp *RefExp::polySimplify(bool &bMod) {
          */
     if (subExp1->getOper() == opDF && def == nullptr) {
         res = new Const(0);
+        SIMPLIFY_RULE("RefExp: %DF{-} => 0");
         bMod = true;
         return res;
     }
@@ -3236,6 +3425,7 @@ Exp *RefExp::polySimplify(bool &bMod) {
     if (subExp1->isRegN(0) &&                                               // r0 (ax)
         def && def->isAssign() && ((Assign *)def)->getLeft()->isRegN(24)) { // r24 (eax)
         res = new TypedExp(IntegerType::get(16), new RefExp(Location::regOf(24), def));
+        SIMPLIFY_RULE("RefExp: r0 defined by r24 => (16) r24");
         bMod = true;
         return res;
     }
@@ -3253,8 +3443,10 @@ Exp *RefExp::polySimplify(bool &bMod) {
   * \returns            Ptr to the simplified expression
   ******************************************************************************/
 Exp *Unary::simplifyAddr() {
+    ExpChangeGuard changing(this);
     Exp *sub;
     if (op == opMemOf && subExp1->isAddrOf()) {
+        SIMPLIFY_RULE("Addr: m[a[x]] => x");
         Unary *s = (Unary *)getSubExp1();
         return s->getSubExp1();
     }
@@ -3264,12 +3456,14 @@ Exp *Unary::simplifyAddr() {
         return this;
     }
     if (subExp1->getOper() == opMemOf) {
+        SIMPLIFY_RULE("Addr: a[m[x]] => x");
         Unary *s = (Unary *)getSubExp1();
         return s->getSubExp1();
     }
     if (subExp1->getOper() == opSize) {
         sub = subExp1->getSubExp2();
         if (sub->getOper() == opMemOf) {
+            SIMPLIFY_RULE("Addr: a[size m[x]] => x");
             // Remove the a[
             Binary *b = (Binary *)getSubExp1();
             // Remove the size[
@@ -3285,6 +3479,7 @@ Exp *Unary::simplifyAddr() {
 }
 
 Exp *Binary::simplifyAddr() {
+    ExpChangeGuard changing(this);
     assert(subExp1 && subExp2);
 
     subExp1 = subExp1->simplifyAddr();
@@ -3293,6 +3488,7 @@ Exp *Binary::simplifyAddr() {
 }
 
 Exp *Ternary::simplifyAddr() {
+    ExpChangeGuard changing(this);
     subExp1 = subExp1->simplifyAddr();
     subExp2 = subExp2->simplifyAddr();
     subExp3 = subExp3->simplifyAddr();
@@ -3404,6 +3600,10 @@ Exp *Exp::fixSuccessor() {
     return this;
 }
 
+// Search patterns for killFill. At file scope, so that they are never allocated in a procedure's arena
+static Ternary srchZfill(opZfill, new Terminal(opWild), new Terminal(opWild), new Terminal(opWild));
+static Ternary srchSgnEx(opSgnEx, new Terminal(opWild), new Terminal(opWild), new Terminal(opWild));
+
 /***************************************************************************/ /**
   *
   * \brief        Remove size operations such as zero fill, sign extend
@@ -3412,17 +3612,16 @@ Exp *Exp::fixSuccessor() {
   * \returns            Fixed expression
   ******************************************************************************/
 Exp *Exp::killFill() {
-    static Ternary srch1(opZfill, new Terminal(opWild), new Terminal(opWild), new Terminal(opWild));
-    static Ternary srch2(opSgnEx, new Terminal(opWild), new Terminal(opWild), new Terminal(opWild));
     Exp *res = this;
-    std::list<Exp **> result;
-    doSearch(srch1, res, result, false);
-    doSearch(srch2, res, result, false);
-    std::list<Exp **>::iterator it;
-    for (it = result.begin(); it != result.end(); it++) {
+    ExpSlotList result;
+    doSearch(srchZfill, res, result, false);
+    doSearch(srchSgnEx, res, result, false);
+    for (Exp **pp : result) {
         // Kill the sign extend bits
-        **it = ((Ternary *)(**it))->getSubExp3();
+        *pp = ((Ternary *)(*pp))->getSubExp3();
     }
+    if (!result.empty())
+        changed();
     return res;
 }
 
@@ -3467,8 +3666,17 @@ Exp *Exp::fromSSAleft(UserProc *proc, Instruction *d) {
 
 // A helper class for comparing Exp*'s sensibly
 bool lessExpStar::operator()(const Exp *x, const Exp *y) const {
+    if (x == y)
+        return false; // Same node: no need to walk it
     return (*x < *y); // Compare the actual Exps
 }
+size_t hashExpStar::operator()(const Exp *e) const { return e->hash(); }
+//! Equal according to lessExpStar, i.e. neither is less than the other
+bool equalExpStar::operator()(const Exp *x, const Exp *y) const {
+    if (x == y)
+        return true;
+    return x->getOper() == y->getOper() && !(*x < *y) && !(*y < *x);
+}
 bool lessExpShared::operator()(const std::shared_ptr<Exp> &x, const std::shared_ptr<Exp> &y) const {
     return (*x < *y); // Compare the actual Exps
 }
@@ -3816,6 +4024,7 @@ Exp *Location::polySimplify(bool &bMod) {
         if (VERBOSE)
             LOG << "polySimplify " << res << "\n";
         res = res->getSubExp1()->getSubExp1();
+        SIMPLIFY_RULE("Location: m[a[x]] => x");
         bMod = true;
         return res;
     }
@@ -3824,6 +4033,7 @@ Exp *Location::polySimplify(bool &bMod) {
     if (res->getOper() == opMemOf && res->getSubExp1()->getOper() == opAddrOf &&
         res->getSubExp1()->getSubExp1()->getOper() == opMemberAccess) {
         res = subExp1->getSubExp1();
+        SIMPLIFY_RULE("Location: m[a[x.m]] => x.m");
         bMod = true;
         return res;
     }
@@ -3842,11 +4052,13 @@ void Location::getDefinitions(LocationSet &defs) {
 QString Const::getFuncName() const { return u.pp->getName(); }
 
 Exp *Unary::simplifyConstraint() {
+    ExpChangeGuard changing(this);
     subExp1 = subExp1->simplifyConstraint();
     return this;
 }
 
 Exp *Binary::simplifyConstraint() {
+    ExpChangeGuard changing(this);
     assert(subExp1 && subExp2);
 
     subExp1 = subExp1->simplifyConstraint();
@@ -3858,6 +4070,7 @@ Exp *Binary::simplifyConstraint() {
             SharedType t1 = ((TypeVal *)subExp1)->getType();
             SharedType t2 = ((TypeVal *)subExp2)->getType();
             if (!t1->isPointerToAlpha() && !t2->isPointerToAlpha()) {
+                changing.dismiss();
                 delete this;
                 if (*t1 == *t2)
                     return new Terminal(opTrue);
@@ -3994,8 +4207,10 @@ Exp *Unary::accept(ExpModifier *v) {
     // postVisit doesn't care about the type of ret. So let's call it a Unary, and the type system is happy
     bool recur;
     Unary *ret = (Unary *)v->preVisit(this, recur);
-    if (recur)
+    if (recur) {
         subExp1 = subExp1->accept(v);
+        changed();
+    }
     return v->postVisit(ret);
 }
 Exp *Binary::accept(ExpModifier *v) {
@@ -4003,21 +4218,22 @@ Exp *Binary::accept(ExpModifier *v) {
 
     bool recur;
     Binary *ret = (Binary *)v->preVisit(this, recur);
-    if (recur)
+    if (recur) {
         subExp1 = subExp1->accept(v);
-    if (recur)
         subExp2 = subExp2->accept(v);
+        changed();
+    }
     return v->postVisit(ret);
 }
 Exp *Ternary::accept(ExpModifier *v) {
     bool recur;
     Ternary *ret = (Ternary *)v->preVisit(this, recur);
-    if (recur)
+    if (recur) {
         subExp1 = subExp1->accept(v);
-    if (recur)
         subExp2 = subExp2->accept(v);
-    if (recur)
         subExp3 = subExp3->accept(v);
+        changed();
+    }
     return v->postVisit(ret);
 }
 
@@ -4026,32 +4242,40 @@ Exp *Location::accept(ExpModifier *v) {
     // important here!  (it makes a call to a different visitor member function).
     bool recur;
     Location *ret = (Location *)v->preVisit(this, recur);
-    if (recur)
+    if (recur) {
         subExp1 = subExp1->accept(v);
+        changed();
+    }
     return v->postVisit(ret);
 }
 
 Exp *RefExp::accept(ExpModifier *v) {
     bool recur;
     RefExp *ret = (RefExp *)v->preVisit(this, recur);
-    if (recur)
+    if (recur) {
         subExp1 = subExp1->accept(v);
+        changed();
+    }
     return v->postVisit(ret);
 }
 
 Exp *FlagDef::accept(ExpModifier *v) {
     bool recur;
     FlagDef *ret = (FlagDef *)v->preVisit(this, recur);
-    if (recur)
+    if (recur) {
         subExp1 = subExp1->accept(v);
+        changed();
+    }
     return v->postVisit(ret);
 }
 
 Exp *TypedExp::accept(ExpModifier *v) {
     bool recur;
     TypedExp *ret = (TypedExp *)v->preVisit(this, recur);
-    if (recur)
+    if (recur) {
         subExp1 = subExp1->accept(v);
+        changed();
+    }
     return v->postVisit(ret);
 }
 
@@ -4110,7 +4334,7 @@ void Const::printx(int ind) const {
         LOG_STREAM() << u.i;
         break;
     case opStrConst:
-        LOG_STREAM() << "\"" << strin << "\"";
+        LOG_STREAM() << "\"" << *strin << "\"";
         break;
     case opFltConst:
         LOG_STREAM() << u.d;
@@ -4175,13 +4399,13 @@ QString Exp::getAnyStrConst() {
 // If memOnly is true, only look inside m[...]
 void Exp::addUsedLocs(LocationSet &used, bool memOnly) {
     UsedLocsFinder ulf(used, memOnly);
-    accept(&ulf);
+    ExpWalker<UsedLocsFinder>::visit(this, ulf);
 }
 
 // Subscript any occurrences of e with e{def} in this expression
 Exp *Exp::expSubscriptVar(Exp *e, Instruction *def) {
     ExpSubscripter es(e, def);
-    return accept(&es);
+    return ExpWalker<ExpSubscripter>::modify(this, es);
 }
 
 // Subscript any occurrences of e with e{-} in this expression Note: subscript with nullptr, not implicit assignments as
@@ -4200,7 +4424,7 @@ bool RefExp::isImplicitDef() { return def == nullptr || def->getKind() == STMT_I
 
 Exp *Exp::bypass() {
     CallBypasser cb(nullptr);
-    return accept(&cb);
+    return ExpWalker<CallBypasser>::modify(this, cb);
 }
 
 void Exp::bypassComp() {
@@ -4210,21 +4434,17 @@ void Exp::bypassComp() {
 }
 
 int Exp::getComplexityDepth(UserProc *proc) {
+    if (proc == nullptr)
+        return getComplexityBound(); // No symbols to look up
     ComplexityFinder cf(proc);
     accept(&cf);
     return cf.getDepth();
 }
 
-int Exp::getMemDepth() {
-    MemDepthFinder mdf;
-    accept(&mdf);
-    return mdf.getDepth();
-}
-
 // Propagate all possible statements to this expression
 Exp *Exp::propagateAll() {
     ExpPropagator ep;
-    return accept(&ep);
+    return ExpWalker<ExpPropagator>::modify(this, ep);
 }
 
 // Propagate all possible statements to this expression, and repeat until there is no further change
@@ -4234,7 +4454,7 @@ Exp *Exp::propagateAllRpt(bool &changed) {
     Exp *ret = this;
     while (true) {
         ep.clearChanged(); // Want to know if changed this *last* accept()
-        ret = ret->accept(&ep);
+        ret = ExpWalker<ExpPropagator>::modify(ret, ep);
         if (ep.isChanged())
             changed = true;
         else
@@ -4243,24 +4463,4 @@ Exp *Exp::propagateAllRpt(bool &changed) {
     return ret;
 }
 
-bool Exp::containsFlags() {
-    FlagsFinder ff;
-    accept(&ff);
-    return ff.isFound();
-}
-
-// Check if this expression contains a bare memof (no subscripts) or one that has no symbol (i.e. is not a local
-// variable or a parameter)
-bool Exp::containsBadMemof(UserProc *proc) {
-    BadMemofFinder bmf(proc);
-    accept(&bmf);
-    return bmf.isFound();
-}
-
-// No longer used
-bool Exp::containsMemof(UserProc *proc) {
-    ExpHasMemofTester ehmt(proc);
-    accept(&ehmt);
-    return ehmt.getResult();
-}
 
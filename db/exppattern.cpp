@@ -0,0 +1,234 @@
+/***************************************************************************/ /**
+  * \file       exppattern.cpp
+  * \brief   Implementation of the CompiledPattern class
+  ******************************************************************************/
+#include "exppattern.h"
+
+#include "exp.h"
+#include "statement.h"
+
+#include <QtCore/QHash>
+#include <cassert>
+#include <mutex>
+
+namespace {
+//! Whether \a s is the name of a variable
+bool isName(const QString &s) {
+    if (s.isEmpty() || !s[0].isLetter())
+        return false;
+    for (QChar c : s)
+        if (c.unicode() > 127 || !c.isLetterOrNumber())
+            return false;
+    return true;
+}
+
+bool isOpen(QChar c) { return c == '(' || c == '[' || c == '{'; }
+bool isClose(QChar c) { return c == ')' || c == ']' || c == '}'; }
+
+//! Index of the bracket that opens the one that closes s, or -1
+int openingOfLast(const QString &s) {
+    int depth = 0;
+    for (int i = s.length() - 1; i >= 0; --i) {
+        if (isClose(s[i]))
+            depth++;
+        else if (isOpen(s[i]) && --depth == 0)
+            return i;
+    }
+    return -1;
+}
+}
+
+CompiledPattern::CompiledPattern(const QString &pattern) {
+    int split = -1, depth = 0;
+    for (int i = 0; i + 1 < pattern.length(); ++i) {
+        if (isOpen(pattern[i]))
+            depth++;
+        else if (isClose(pattern[i]))
+            depth--;
+        else if (depth == 0 && pattern[i] == ':' && pattern[i + 1] == '=') {
+            split = i;
+            break;
+        }
+    }
+    if (split == -1) {
+        root = parse(pattern);
+        return;
+    }
+    root = parse(pattern.left(split));
+    assignRhs = parse(pattern.mid(split + 2));
+}
+
+//! The compiled form of pattern, made on first use and kept for the rest of the run
+const CompiledPattern &CompiledPattern::get(const QString &pattern) {
+    static QHash<QString, CompiledPattern *> known;
+    static std::mutex lock; // The patterns, once made, are only read
+    std::lock_guard<std::mutex> guard(lock);
+    CompiledPattern *&res(known[pattern]);
+    if (res == nullptr)
+        res = new CompiledPattern(pattern);
+    return *res;
+}
+
+int CompiledPattern::add(Kind k, int sub1, int sub2, int num, const QString &text) {
+    Node n;
+    n.kind = k;
+    n.sub1 = sub1;
+    n.sub2 = sub2;
+    n.num = num;
+    n.text = text;
+    nodes.push_back(n);
+    return (int)nodes.size() - 1;
+}
+
+int CompiledPattern::var(const QString &name) {
+    int res = varIndex(name);
+    if (res != -1)
+        return res;
+    assert(varNames.size() < (size_t)MAX_VARS && "too many variables in pattern");
+    varNames.push_back(name);
+    return (int)varNames.size() - 1;
+}
+
+//! Index of the named variable in the bindings, or -1 if the pattern has no such variable
+int CompiledPattern::varIndex(const QString &name) const {
+    for (size_t i = 0; i < varNames.size(); ++i)
+        if (varNames[i] == name)
+            return (int)i;
+    return -1;
+}
+
+//! Parse one expression of the pattern, returning the index of its node
+int CompiledPattern::parse(const QString &pat) {
+    QString s = pat.trimmed();
+    // Last + or - at the top level, which isn't a sign (i.e. has an operand on its left)
+    int split = -1, depth = 0;
+    bool afterOperand = false;
+    for (int i = 0; i < s.length(); ++i) {
+        QChar c = s[i];
+        if (isOpen(c))
+            depth++;
+        else if (isClose(c))
+            depth--;
+        if (c == '+' || c == '-') {
+            if (depth == 0 && afterOperand)
+                split = i;
+            afterOperand = false;
+        } else if (!c.isSpace())
+            afterOperand = true;
+    }
+    if (split != -1) {
+        int lhs = parse(s.left(split));
+        return add(s[split] == '+' ? Plus : Minus, lhs, parse(s.mid(split + 1)));
+    }
+    depth = 0;
+    for (int i = s.length() - 1; i > 0; --i) {
+        if (isClose(s[i]))
+            depth++;
+        else if (isOpen(s[i]))
+            depth--;
+        else if (depth == 0 && s[i] == '.') {
+            QString member = s.mid(i + 1).trimmed();
+            if (!isName(member))
+                break; // e.g. a floating point constant
+            return add(Member, parse(s.left(i)), -1, var(member));
+        }
+    }
+    if (s.endsWith(']') || s.endsWith('}') || s.endsWith(')')) {
+        int open = openingOfLast(s);
+        if (open != -1) {
+            QString prefix = s.left(open).trimmed();
+            QString inner = s.mid(open + 1, s.length() - open - 2).trimmed();
+            if (s.endsWith(')')) {
+                if (open == 0)
+                    return parse(inner);
+            } else if (s.endsWith(']')) {
+                if (prefix == "a")
+                    return add(AddrOf, parse(inner));
+                if (prefix == "m")
+                    return add(MemOf, parse(inner));
+                if (prefix == "r")
+                    return add(RegOf, parse(inner));
+                if (!prefix.isEmpty())
+                    return add(ArrayIndex, parse(prefix), parse(inner));
+            } else if (!prefix.isEmpty()) {
+                if (inner == "-")
+                    return add(RefNull, parse(prefix));
+                bool ok;
+                int num = inner.toInt(&ok);
+                if (ok)
+                    return add(RefNum, parse(prefix), -1, num);
+            }
+        }
+    }
+    if (isName(s))
+        return add(Var, -1, -1, var(s));
+    bool ok;
+    int value = s.toInt(&ok, 0);
+    if (ok)
+        return add(IntLiteral, -1, -1, value);
+    return add(Literal, -1, -1, 0, s);
+}
+
+bool CompiledPattern::bind(int v, Exp *e, Bindings &b) const {
+    if (b[v] == nullptr) {
+        b[v] = e;
+        return true;
+    }
+    return *b[v] == *e;
+}
+
+bool CompiledPattern::matchNode(int n, Exp *e, Bindings &b) const {
+    const Node &nd(nodes[n]);
+    switch (nd.kind) {
+    case Var:
+        return bind(nd.num, e, b);
+    case IntLiteral:
+        return e->isIntConst() && ((Const *)e)->getInt() == nd.num;
+    case Literal:
+        return e->toString() == nd.text;
+    case AddrOf:
+        return e->getOper() == opAddrOf && matchNode(nd.sub1, e->getSubExp1(), b);
+    case MemOf:
+        return e->isMemOf() && matchNode(nd.sub1, e->getSubExp1(), b);
+    case RegOf:
+        return e->isRegOf() && matchNode(nd.sub1, e->getSubExp1(), b);
+    case Plus:
+        return e->getOper() == opPlus && matchNode(nd.sub1, e->getSubExp1(), b) &&
+               matchNode(nd.sub2, e->getSubExp2(), b);
+    case Minus:
+        return e->getOper() == opMinus && matchNode(nd.sub1, e->getSubExp1(), b) &&
+               matchNode(nd.sub2, e->getSubExp2(), b);
+    case ArrayIndex:
+        return e->getOper() == opArrayIndex && matchNode(nd.sub1, e->getSubExp1(), b) &&
+               matchNode(nd.sub2, e->getSubExp2(), b);
+    case Member:
+        return e->getOper() == opMemberAccess && e->getSubExp2()->isStrConst() &&
+               matchNode(nd.sub1, e->getSubExp1(), b) && bind(nd.num, e->getSubExp2(), b);
+    case RefNull:
+        return e->isSubscript() && ((RefExp *)e)->getDef() == nullptr && matchNode(nd.sub1, e->getSubExp1(), b);
+    case RefNum: {
+        if (!e->isSubscript())
+            return false;
+        Instruction *def = ((RefExp *)e)->getDef();
+        return def && def->getNumber() == nd.num && matchNode(nd.sub1, e->getSubExp1(), b);
+    }
+    }
+    return false;
+}
+
+/***************************************************************************/ /**
+  * \brief   Match e against this pattern
+  * \param   e expression to match
+  * \param   b receives the subexpression bound to each variable, indexed as in varIndex(); unused entries are nullptr
+  * \returns true if e matches
+  ******************************************************************************/
+bool CompiledPattern::match(Exp *e, Bindings &b) const {
+    b.fill(nullptr);
+    return assignRhs == -1 && matchNode(root, e, b);
+}
+
+//! Match both sides of an assignment against a "lhs := rhs" pattern
+bool CompiledPattern::matchAssign(Assign *a, Bindings &b) const {
+    b.fill(nullptr);
+    return assignRhs != -1 && matchNode(root, a->getLeft(), b) && matchNode(assignRhs, a->getRight(), b);
+}
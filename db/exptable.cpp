@@ -0,0 +1,223 @@
+/***************************************************************************/ /**
+  * \file       exptable.cpp
+  * \brief   Implementation of the ExpTable class, which hash-conses expressions
+  ******************************************************************************/
+#include "exptable.h"
+
+#include "exp.h"
+
+#include <QtCore/QHash>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <typeinfo>
+
+ExpTable &ExpTable::get() {
+    static ExpTable theTable;
+    return theTable;
+}
+
+//! Only the plain, value-like node classes are shared; TypedExp, FlagDef and TypeVal carry extra mutable state
+bool ExpTable::isInternable(const Exp *e) {
+    const std::type_info &ti(typeid(*e));
+    if (ti == typeid(Const)) {
+        OPER op = e->getOper();
+        return op == opIntConst || op == opLongConst || op == opFltConst || op == opStrConst;
+    }
+    return ti == typeid(Terminal) || ti == typeid(Unary) || ti == typeid(Binary) || ti == typeid(Ternary) ||
+           ti == typeid(Location) || ti == typeid(RefExp);
+}
+
+/***************************************************************************/ /**
+  * \brief Hash one node, assuming its children are already interned (so children hash by identity)
+  ******************************************************************************/
+size_t ExpTable::nodeHash(const Exp *e) {
+    size_t h = hashCombine(typeid(*e).hash_code(), (size_t)e->getOper());
+    if (typeid(*e) == typeid(Const)) {
+        const Const *c = static_cast<const Const *>(e);
+        h = hashCombine(h, (size_t)c->getConscript());
+        switch (c->getOper()) {
+        case opIntConst:
+            return hashCombine(h, (size_t)c->getInt());
+        case opLongConst:
+            return hashCombine(h, std::hash<QWord>()(c->getLong()));
+        case opFltConst:
+            return hashCombine(h, std::hash<double>()(c->getFlt()));
+        case opStrConst:
+            return hashCombine(h, qHash(c->getStr()));
+        default:
+            assert(false);
+        }
+    }
+    switch (e->getArity()) {
+    case 3:
+        h = hashCombine(h, std::hash<const Exp *>()(e->getSubExp3()));
+    // fallthrough
+    case 2:
+        h = hashCombine(h, std::hash<const Exp *>()(e->getSubExp2()));
+    // fallthrough
+    case 1:
+        h = hashCombine(h, std::hash<const Exp *>()(e->getSubExp1()));
+        break;
+    default:
+        break;
+    }
+    if (e->isSubscript())
+        h = hashCombine(h, std::hash<const void *>()(const_cast<RefExp *>(static_cast<const RefExp *>(e))->getDef()));
+    else if (typeid(*e) == typeid(Location))
+        h = hashCombine(h, std::hash<const void *>()(const_cast<Location *>(static_cast<const Location *>(e))->getProc()));
+    return h;
+}
+
+/***************************************************************************/ /**
+  * \brief Strict structural equality of two nodes with interned children. Unlike Exp::operator==, this knows nothing
+  * about wildcards, and compares the defining statement of RefExps and the UserProc of Locations exactly.
+  ******************************************************************************/
+bool ExpTable::sameNode(const Exp *a, const Exp *b) {
+    if (a->getOper() != b->getOper() || typeid(*a) != typeid(*b))
+        return false;
+    if (typeid(*a) == typeid(Const)) {
+        const Const *ca = static_cast<const Const *>(a);
+        const Const *cb = static_cast<const Const *>(b);
+        if (ca->getConscript() != cb->getConscript() || ca->getType() != cb->getType())
+            return false;
+        switch (ca->getOper()) {
+        case opIntConst:
+            return ca->getInt() == cb->getInt();
+        case opLongConst:
+            return ca->getLong() == cb->getLong();
+        case opFltConst: {
+            // Compare bit patterns, so that 0.0 and -0.0 stay distinct
+            double da = ca->getFlt(), db = cb->getFlt();
+            return memcmp(&da, &db, sizeof(double)) == 0;
+        }
+        case opStrConst:
+            return ca->getStr() == cb->getStr();
+        default:
+            return false;
+        }
+    }
+    switch (a->getArity()) {
+    case 3:
+        if (a->getSubExp3() != b->getSubExp3())
+            return false;
+    // fallthrough
+    case 2:
+        if (a->getSubExp2() != b->getSubExp2())
+            return false;
+    // fallthrough
+    case 1:
+        if (a->getSubExp1() != b->getSubExp1())
+            return false;
+        break;
+    default:
+        break;
+    }
+    if (a->isSubscript())
+        return const_cast<RefExp *>(static_cast<const RefExp *>(a))->getDef() ==
+               const_cast<RefExp *>(static_cast<const RefExp *>(b))->getDef();
+    if (typeid(*a) == typeid(Location))
+        return const_cast<Location *>(static_cast<const Location *>(a))->getProc() ==
+               const_cast<Location *>(static_cast<const Location *>(b))->getProc();
+    return true;
+}
+
+/***************************************************************************/ /**
+  * \brief Return the shared Terminal for operator op, creating it on first use
+  ******************************************************************************/
+Exp *ExpTable::terminal(OPER op) {
+    if ((size_t)op >= terminals.size())
+        terminals.resize(op + 1, nullptr);
+    if (terminals[op] != nullptr) {
+        ++hits;
+        return terminals[op];
+    }
+    ++misses;
+    ArenaScope onHeap(nullptr); // Shared by all procs, so it must not live in any one proc's arena
+    terminals[op] = new Terminal(op);
+    return terminals[op];
+}
+
+/***************************************************************************/ /**
+  * \brief  Return the canonical node that is structurally identical to e.
+  * The children of e are interned first, which replaces them in e. After this call e must not be used by the caller
+  * except through the returned pointer, which may or may not be e itself.
+  * Expressions of classes that can't be shared (e.g. TypedExp) are returned unchanged.
+  * \param  e expression to intern
+  * \returns the shared representative of e
+  ******************************************************************************/
+Exp *ExpTable::intern(Exp *e) {
+    if (e == nullptr || !isInternable(e))
+        return e;
+    if (typeid(*e) == typeid(Terminal)) {
+        OPER op = e->getOper();
+        if ((size_t)op < terminals.size() && terminals[op] != nullptr) {
+            ++hits;
+            return terminals[op];
+        }
+        if ((size_t)op >= terminals.size())
+            terminals.resize(op + 1, nullptr);
+        ++misses;
+        terminals[op] = e;
+        return e;
+    }
+    if (isInterned(e))
+        return e;
+    switch (e->getArity()) {
+    case 3:
+        e->setSubExp3(intern(e->getSubExp3()));
+    // fallthrough
+    case 2:
+        e->setSubExp2(intern(e->getSubExp2()));
+    // fallthrough
+    case 1:
+        e->setSubExp1(intern(e->getSubExp1()));
+        break;
+    default:
+        break;
+    }
+    size_t h = nodeHash(e);
+    auto range = table.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (sameNode(it->second, e)) {
+            ++hits;
+            return it->second;
+        }
+    }
+    ++misses;
+    table.insert(std::make_pair(h, e));
+    return e;
+}
+
+//! Return true if e is the representative node held by this table
+bool ExpTable::isInterned(const Exp *e) const {
+    if (e == nullptr)
+        return false;
+    if (typeid(*e) == typeid(Terminal))
+        return (size_t)e->getOper() < terminals.size() && terminals[e->getOper()] == e;
+    if (!isInternable(e))
+        return false;
+    auto range = table.equal_range(nodeHash(e));
+    for (auto it = range.first; it != range.second; ++it)
+        if (it->second == e)
+            return true;
+    return false;
+}
+
+size_t ExpTable::size() const {
+    size_t res = table.size();
+    for (const Exp *t : terminals)
+        if (t != nullptr)
+            ++res;
+    return res;
+}
+
+/***************************************************************************/ /**
+  * \brief Forget all interned nodes. The nodes themselves stay alive (they may still be referenced), they will just
+  * not be shared with expressions interned from now on.
+  ******************************************************************************/
+void ExpTable::clear() {
+    table.clear();
+    terminals.clear();
+    hits = misses = 0;
+}
@@ -0,0 +1,168 @@
+/***************************************************************************/ /**
+  * \file       fingerprint.cpp
+  * \brief   Implementation of the LibraryFingerprints class
+  *
+  * The pattern files are those of FLIRT (the .pat files its tools make from libraries), one function per line:
+  *
+  *     5589E583EC..8B45..........C9C3 0A 3C4E 0040 :0000 _strlen ^0012 _other 8B45...
+  *
+  * that is the leading bytes in hex, ".." for a masked byte, the number of bytes the CRC covers after them, the CRC,
+  * the length of the function and its public names with their offsets. Only the name at offset 0 is used; the names
+  * it references and the bytes after the CRC are not checked. A line of "---" ends the file.
+  ******************************************************************************/
+#include "fingerprint.h"
+
+#include "BinaryFile.h"
+#include "IBinaryImage.h"
+#include "log.h"
+
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+//! Patterns with fewer bytes than this to check (fixed leading bytes and CRC'd bytes together) match too much code
+static const unsigned MIN_CHECKED_BYTES = 16;
+
+//! The CRC16 of FLIRT patterns (CCITT, reflected, with the result inverted and byte swapped)
+unsigned short LibraryFingerprints::crc16(const unsigned char *data, size_t len) {
+    unsigned crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        unsigned b = data[i];
+        for (int bit = 0; bit < 8; bit++, b >>= 1) {
+            if ((crc ^ b) & 1)
+                crc = (crc >> 1) ^ 0x8408;
+            else
+                crc >>= 1;
+        }
+    }
+    crc = ~crc & 0xFFFF;
+    return (unsigned short)(((crc << 8) | (crc >> 8)) & 0xFFFF);
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief Add the patterns of the file at \a path to those read before
+  * \returns false if it could not be read; lines that cannot be parsed are skipped
+  *
+  ******************************************************************************/
+bool LibraryFingerprints::read(const QString &path) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+    QTextStream in(&f);
+    size_t skipped = 0;
+    while (!in.atEnd()) {
+        QStringList fields = in.readLine().split(' ', QString::SkipEmptyParts);
+        if (fields.isEmpty() || fields[0] == "---")
+            continue;
+        Pattern p;
+        bool ok = fields.size() >= 6 && fields[0].size() % 2 == 0;
+        if (ok) {
+            p.crcLength = fields[1].toUInt(&ok, 16);
+            if (ok)
+                p.crc = (unsigned short)fields[2].toUInt(&ok, 16);
+        }
+        for (int i = 4; ok && i + 1 < fields.size(); i++) {
+            if (fields[i] == ":0000") {
+                p.name = fields[i + 1];
+                break;
+            }
+        }
+        unsigned checked = p.crcLength;
+        const QString &lead(fields[0]);
+        for (int i = 0; ok && i < lead.size(); i += 2) {
+            if (lead.midRef(i, 2) == "..") {
+                p.bytes.append('\0');
+                p.mask.append('\0');
+                continue;
+            }
+            p.bytes.append((char)lead.midRef(i, 2).toString().toUInt(&ok, 16));
+            p.mask.append('\1');
+            checked++;
+        }
+        if (!ok || p.name.isEmpty() || checked < MIN_CHECKED_BYTES) {
+            skipped++;
+            continue;
+        }
+        int idx = (int)patterns.size();
+        if (p.mask.size() >= 2 && p.mask[0] && p.mask[1]) {
+            unsigned prefix = ((unsigned char)p.bytes[0] << 8) | (unsigned char)p.bytes[1];
+            nextWithPrefix.push_back(byPrefix.value(prefix, -1));
+            byPrefix[prefix] = idx;
+        } else {
+            nextWithPrefix.push_back(-1);
+            maskedPrefix.push_back(idx);
+        }
+        patterns.push_back(p);
+    }
+    LOG_VERBOSE(1) << "read " << (int)patterns.size() << " library fingerprints from " << path << " (" << (int)skipped
+                   << " lines skipped)\n";
+    return true;
+}
+
+void LibraryFingerprints::clear() {
+    patterns.clear();
+    byPrefix.clear();
+    nextWithPrefix.clear();
+    maskedPrefix.clear();
+}
+
+bool LibraryFingerprints::matches(const Pattern &p, IBinaryImage *image, LoaderInterface *loader,
+                                  ADDRESS addr) const {
+    size_t lead = p.bytes.size();
+    const unsigned char *code = (const unsigned char *)image->getSpan(addr, lead + p.crcLength);
+    if (code == nullptr)
+        return false;
+    for (size_t i = 0; i < lead; i++) {
+        if (p.mask[(int)i] && code[i] != (unsigned char)p.bytes[(int)i])
+            return false;
+    }
+    if (crc16(code + lead, p.crcLength) != p.crc)
+        return false;
+    // The bytes checked were fixed in the library, so none of them may be relocated here
+    size_t end = lead + p.crcLength;
+    for (size_t at = 0; at < end; at++) {
+        if (!loader->IsRelocationAt(addr + (int)at))
+            continue;
+        for (size_t i = at; i < at + 4 && i < end; i++) {
+            if (i >= lead || p.mask[(int)i])
+                return false;
+        }
+    }
+    return true;
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief Look for a library function at \a addr of \a image
+  * \returns its name, or an empty string if no pattern matches, or patterns of functions with different names do
+  *
+  ******************************************************************************/
+QString LibraryFingerprints::match(IBinaryImage *image, LoaderInterface *loader, ADDRESS addr) const {
+    if (patterns.empty())
+        return QString();
+    QString res;
+    auto check = [&](int idx) {
+        const Pattern &p(patterns[idx]);
+        if (p.name == res || !matches(p, image, loader, addr))
+            return true;
+        if (!res.isEmpty()) {
+            res.clear();
+            return false; // Ambiguous
+        }
+        res = p.name;
+        return true;
+    };
+    const unsigned char *start = (const unsigned char *)image->getSpan(addr, 2);
+    if (start != nullptr) {
+        for (int idx = byPrefix.value((start[0] << 8) | start[1], -1); idx != -1; idx = nextWithPrefix[idx]) {
+            if (!check(idx))
+                return QString();
+        }
+    }
+    for (int idx : maskedPrefix) {
+        if (!check(idx))
+            return QString();
+    }
+    return res;
+}
@@ -0,0 +1,74 @@
+/***************************************************************************/ /**
+  * \file       liveness.cpp
+  * \brief   Implementation of the LivenessSolver class
+  ******************************************************************************/
+#include "liveness.h"
+
+#include <algorithm>
+
+//! Start again with numNodes nodes, no edges, and empty sets of numLocations bits
+void LivenessSolver::init(size_t numNodes, size_t numLocations) {
+    this->numLocations = numLocations;
+    succs.assign(numNodes, std::vector<int>());
+    useSets.assign(numNodes, DenseBitSet(numLocations));
+    defSets.assign(numNodes, DenseBitSet(numLocations));
+    liveInSets.assign(numNodes, DenseBitSet(numLocations));
+    edgeUseSets.clear();
+}
+
+void LivenessSolver::addEdgeUse(int n, int succ, int loc) {
+    DenseBitSet &v(edgeUseSets[std::make_pair(n, succ)]);
+    if (v.size() == 0)
+        v.assign(numLocations);
+    v.set(loc);
+}
+
+//! The locations live at the end of node n, into res
+void LivenessSolver::getLiveOut(int n, DenseBitSet &res) const {
+    res.assign(numLocations);
+    for (int s : succs[n]) {
+        res.unite(liveInSets[s]);
+        auto eu = edgeUseSets.find(std::make_pair(n, s));
+        if (eu != edgeUseSets.end())
+            res.unite(eu->second);
+    }
+}
+
+//! Iterate the equations to a fixed point
+void LivenessSolver::solve() {
+    size_t numNodes = succs.size();
+    // Postorder of a depth first search from each node not yet reached, without recursion
+    std::vector<int> order;
+    std::vector<bool> seen(numNodes, false);
+    std::vector<std::pair<int, size_t>> stack;
+    for (size_t root = 0; root < numNodes; root++) {
+        if (seen[root])
+            continue;
+        seen[root] = true;
+        stack.emplace_back(root, 0);
+        while (!stack.empty()) {
+            int n = stack.back().first;
+            size_t &next(stack.back().second);
+            if (next < succs[n].size()) {
+                int s = succs[n][next++];
+                if (!seen[s]) {
+                    seen[s] = true;
+                    stack.emplace_back(s, 0);
+                }
+                continue;
+            }
+            order.push_back(n);
+            stack.pop_back();
+        }
+    }
+
+    DenseBitSet out;
+    bool change = true;
+    while (change) {
+        change = false;
+        for (int n : order) {
+            getLiveOut(n, out);
+            change |= liveInSets[n].assignTransfer(useSets[n], out, defSets[n]);
+        }
+    }
+}
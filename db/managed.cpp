@@ -14,6 +14,8 @@
 
 #include <sstream>
 #include <cstring>
+#include <algorithm>
+#include <cassert>
 
 #include "types.h"
 #include "managed.h"
@@ -22,8 +24,9 @@
 #include "log.h"
 #include "boomerang.h"
 #include "proc.h"
+#include "util.h"
 
-extern char debug_buffer[]; // For prints functions
+extern thread_local char debug_buffer[]; // For prints functions
 
 QTextStream &operator<<(QTextStream &os, const InstructionSet *ss) {
     ss->print(os);
@@ -109,8 +112,8 @@ bool InstructionSet::definesLoc(Exp *loc) {
 
 // Print to a string, for debugging
 const char *InstructionSet::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     std::set<Instruction *>::iterator it;
     for (it = begin(); it != end(); it++) {
         if (it != begin())
@@ -118,9 +121,7 @@ const char *InstructionSet::prints() {
         ost << *it;
     }
     ost << "\n";
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 void InstructionSet::dump() {
@@ -165,6 +166,234 @@ bool InstructionSet::operator<(const InstructionSet &o) const {
     return false;
 }
 
+//
+// StatementTable methods
+//
+
+//! Record s as the statement its number belongs to
+void StatementTable::add(Instruction *s) {
+    uint32_t n = (uint32_t)s->getNumber();
+    if (n >= byNumber.size()) {
+        byNumber.resize(n + 1, nullptr);
+        kinds.resize(n + 1, STMT_ASSIGN);
+        bbs.resize(n + 1, nullptr);
+        lexBegins.resize(n + 1, 0);
+        lexEnds.resize(n + 1, 0);
+    } else if (byNumber[n] != nullptr && byNumber[n] != s) {
+        // Another statement with this number (e.g. a clone); the owner keeps it unless it has gone from the proc
+        pending.push_back(s);
+        return;
+    }
+    set(n, s);
+}
+
+void StatementTable::set(uint32_t n, Instruction *s) {
+    byNumber[n] = s;
+    kinds[n] = s->getKind();
+    bbs[n] = s->getBB();
+    lexBegins[n] = s->getLexBegin();
+    lexEnds[n] = s->getLexEnd();
+}
+
+bool StatementTable::owns(Instruction *s) const {
+    int n = s ? s->getNumber() : 0;
+    return n > 0 && at((uint32_t)n) == s;
+}
+
+void StatementTable::clear() {
+    byNumber.clear();
+    kinds.clear();
+    bbs.clear();
+    lexBegins.clear();
+    lexEnds.clear();
+    pending.clear();
+}
+
+//! Start adding all the statements of the proc again; those not added before endRebuild() are marked as removed
+void StatementTable::beginRebuild() { std::fill(bbs.begin(), bbs.end(), nullptr); }
+
+void StatementTable::endRebuild() {
+    for (Instruction *s : pending)
+        if (bbs[s->getNumber()] == nullptr)
+            set(s->getNumber(), s);
+    pending.clear();
+}
+
+//! Copy the fields of s into the arrays again, if it owns its number
+void StatementTable::update(Instruction *s) {
+    if (owns(s))
+        set(s->getNumber(), s);
+}
+
+//! s is no longer part of the proc
+void StatementTable::remove(Instruction *s) {
+    if (owns(s))
+        bbs[s->getNumber()] = nullptr;
+}
+
+//! Append the statements of kind k to res, in number order
+void StatementTable::getOfKind(STMT_KIND k, StatementList &res) const {
+    for (size_t n = 1; n < kinds.size(); ++n)
+        if (kinds[n] == k && bbs[n] != nullptr)
+            res.append(byNumber[n]);
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief   The statement with the lowest lexical begin that contains position \a begin and (unless \a end is -1)
+  *          ends after \a end, or nullptr if there is none (see UserProc::getStmtAtLex)
+  *
+  ******************************************************************************/
+Instruction *StatementTable::findAtLex(unsigned begin, unsigned end) const {
+    unsigned lowest = begin;
+    Instruction *res = nullptr;
+    for (size_t n = 1; n < lexBegins.size(); ++n) {
+        if (bbs[n] != nullptr && begin >= lexBegins[n] && begin <= lowest && begin <= lexEnds[n] &&
+            (end == (unsigned)-1 || end < lexEnds[n])) {
+            res = byNumber[n];
+            lowest = lexBegins[n];
+        }
+    }
+    return res;
+}
+
+//
+// InstructionBitSet methods
+//
+
+InstructionBitSet::InstructionBitSet(const StatementTable &t, const InstructionSet &o) : table(&t) {
+    for (Instruction *s : o)
+        insert(s);
+}
+
+//! A statement that was put with the others before it had a number stays there, so it is never in the set twice
+bool InstructionBitSet::isKeyed(Instruction *s) const {
+    return table->owns(s) && (others.empty() || others.find(s) == others.end());
+}
+
+void InstructionBitSet::insert(Instruction *s) {
+    if (!isKeyed(s)) {
+        others.insert(s);
+        return;
+    }
+    int n = s->getNumber();
+    if (n >= limit())
+        bits.resize((n / DenseBitSet::WORD_BITS + 1) * DenseBitSet::WORD_BITS);
+    bits.set(n);
+}
+
+bool InstructionBitSet::remove(Instruction *s) {
+    if (table->owns(s) && has(s->getNumber())) {
+        bits.reset(s->getNumber());
+        return true;
+    }
+    return others.erase(s) != 0;
+}
+
+bool InstructionBitSet::exists(Instruction *s) const {
+    if (table->owns(s) && has(s->getNumber()))
+        return true;
+    return !others.empty() && others.find(s) != others.end();
+}
+
+size_t InstructionBitSet::size() const { return others.size() + bits.count(); }
+
+bool InstructionBitSet::empty() const { return others.empty() && bits.none(); }
+
+void InstructionBitSet::clear() {
+    bits.clear();
+    others.clear();
+}
+
+//! Make this set the union of itself and other
+void InstructionBitSet::makeUnion(const InstructionBitSet &other) {
+    assert(table == other.table);
+    if (&other == this)
+        return;
+    if (others.empty())
+        bits.unite(other.bits);
+    else {
+        // Leave out the statements already here among the unnumbered ones
+        DenseBitSet theirs(other.bits);
+        for (Instruction *s : others) {
+            if (table->owns(s))
+                theirs.reset(s->getNumber());
+        }
+        bits.unite(theirs);
+    }
+    for (Instruction *s : other.others)
+        insert(s);
+}
+
+//! Make this set the difference of itself and other
+void InstructionBitSet::makeDiff(const InstructionBitSet &other) {
+    assert(table == other.table);
+    if (&other == this) {
+        clear();
+        return;
+    }
+    bits.subtract(other.bits);
+    for (Instruction *s : other.others)
+        remove(s);
+    for (InstructionSet::iterator it = others.begin(); it != others.end();) {
+        if (other.exists(*it))
+            others.erase(it++);
+        else
+            ++it;
+    }
+}
+
+//! Make this set the intersection of itself and other
+void InstructionBitSet::makeIsect(const InstructionBitSet &other) {
+    assert(table == other.table);
+    if (&other == this)
+        return;
+    if (other.others.empty())
+        bits.intersect(other.bits);
+    else {
+        // Also keep the statements other only has among its unnumbered ones
+        DenseBitSet keep(other.bits);
+        if (keep.size() < bits.size())
+            keep.resize(bits.size());
+        for (Instruction *s : other.others) {
+            if (table->owns(s) && has(s->getNumber()))
+                keep.set(s->getNumber());
+        }
+        bits.intersect(keep);
+    }
+    for (InstructionSet::iterator it = others.begin(); it != others.end();) {
+        if (other.exists(*it))
+            ++it;
+        else
+            others.erase(it++);
+    }
+}
+
+//! Check for the subset relation, i.e. are all my elements also in the set other
+bool InstructionBitSet::isSubSetOf(const InstructionBitSet &other) const {
+    for (const_iterator it = begin(); it != end(); ++it)
+        if (!other.exists(*it))
+            return false;
+    return true;
+}
+
+void InstructionBitSet::toSet(InstructionSet &res) const {
+    for (const_iterator it = begin(); it != end(); ++it)
+        res.insert(*it);
+}
+
+InstructionBitSet::const_iterator::const_iterator(const InstructionBitSet *s, bool atEnd)
+    : set(s), num(atEnd ? s->limit() : (int)s->bits.findFirst()),
+      it(atEnd ? s->others.end() : s->others.begin()) {}
+
+InstructionBitSet::const_iterator &InstructionBitSet::const_iterator::operator++() {
+    if (num < set->limit())
+        num = (int)set->bits.findNext(num + 1);
+    else
+        ++it;
+    return *this;
+}
+
 //
 // AssignSet methods
 //
@@ -225,15 +454,16 @@ bool AssignSet::exists(Assign *a) {
 
 // Find a definition for loc in this Assign set. Return true if found
 bool AssignSet::definesLoc(Exp *loc) {
-    Assign *as = new Assign(loc, Terminal::get(opWild));
-    iterator ff = find(as);
-    return ff != end();
+    // The set is ordered on the LHS alone, so a temporary Assign with loc on the left finds it. No type is given so
+    // that making the probe allocates nothing
+    Assign probe(SharedType(), loc, nullptr);
+    return find(&probe) != end();
 }
 
 // Find a definition for loc on the LHS in this Assign set. If found, return pointer to the Assign with that LHS
 Assign *AssignSet::lookupLoc(Exp *loc) {
-    Assign *as = new Assign(loc, Terminal::get(opWild));
-    iterator ff = find(as);
+    Assign probe(SharedType(), loc, nullptr);
+    iterator ff = find(&probe);
     if (ff == end())
         return nullptr;
     return *ff;
@@ -241,8 +471,8 @@ Assign *AssignSet::lookupLoc(Exp *loc) {
 
 // Print to a string, for debugging
 char *AssignSet::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     iterator it;
     for (it = begin(); it != end(); it++) {
         if (it != begin())
@@ -250,9 +480,7 @@ char *AssignSet::prints() {
         ost << *it;
     }
     ost << "\n";
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 void AssignSet::dump() {
@@ -303,10 +531,13 @@ bool AssignSet::operator<(const AssignSet &o) const {
 
 // Assignment operator
 LocationSet &LocationSet::operator=(const LocationSet &o) {
+    if (this == &o)
+        return *this;
     lset.clear();
+    // The clones sort the same as the originals, so each one goes at the end
     std::set<Exp *, lessExpStar>::const_iterator it;
     for (it = o.lset.begin(); it != o.lset.end(); it++) {
-        lset.insert((*it)->clone());
+        lset.insert(lset.end(), (*it)->clone());
     }
     return *this;
 }
@@ -315,21 +546,19 @@ LocationSet &LocationSet::operator=(const LocationSet &o) {
 LocationSet::LocationSet(const LocationSet &o) {
     std::set<Exp *, lessExpStar>::const_iterator it;
     for (it = o.lset.begin(); it != o.lset.end(); it++)
-        lset.insert((*it)->clone());
+        lset.insert(lset.end(), (*it)->clone());
 }
 
 char *LocationSet::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     std::set<Exp *, lessExpStar>::iterator it;
     for (it = lset.begin(); it != lset.end(); it++) {
         if (it != lset.begin())
             ost << ",\t";
         ost << *it;
     }
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 void LocationSet::dump() {
@@ -374,18 +603,39 @@ void LocationSet::removeIfDefines(InstructionSet &given) {
 }
 
 // Make this set the union of itself and other
+// Both sets are in lessExpStar order, so this is a single merge: each location of other is inserted with a hint at
+// the position it belongs, and locations already present are skipped without a tree search.
 void LocationSet::makeUnion(LocationSet &other) {
-    iterator it;
-    for (it = other.lset.begin(); it != other.lset.end(); it++) {
-        lset.insert(*it);
+    lessExpStar less;
+    iterator mine = lset.begin();
+    for (iterator it = other.lset.begin(); it != other.lset.end(); ++it) {
+        while (mine != lset.end() && less(*mine, *it))
+            ++mine;
+        if (mine != lset.end() && !less(*it, *mine))
+            continue; // Already here
+        lset.insert(mine, *it);
     }
 }
 
 // Make this set the set difference of itself and other
+// As for makeUnion(), the two sets are walked side by side rather than searching this set for each location of other.
 void LocationSet::makeDiff(LocationSet &other) {
-    std::set<Exp *, lessExpStar>::iterator it;
-    for (it = other.lset.begin(); it != other.lset.end(); it++) {
-        lset.erase(*it);
+    if (&other == this) {
+        lset.clear();
+        return;
+    }
+    lessExpStar less;
+    iterator mine = lset.begin();
+    iterator it = other.lset.begin();
+    while (mine != lset.end() && it != other.lset.end()) {
+        if (less(*mine, *it))
+            ++mine;
+        else if (less(*it, *mine))
+            ++it;
+        else {
+            mine = lset.erase(mine);
+            ++it;
+        }
     }
 }
 
@@ -548,14 +798,12 @@ void StatementList::append(StatementList &sl) { insert(end(), sl.begin(), sl.end
 void StatementList::append(InstructionSet &ss) { insert(end(), ss.begin(), ss.end()); }
 
 char *StatementList::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     for (auto &elem : *this) {
         ost << elem << ",\t";
     }
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 //
@@ -582,14 +830,12 @@ StatementVec::iterator StatementVec::remove(iterator it) {
 
 char *StatementVec::prints() {
 
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     for (Instruction *it : svec) {
         ost << it << ",\t";
     }
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 // Print just the numbers to stream os
@@ -692,81 +938,137 @@ void LocationSet::diff(LocationSet *o) {
 
 //    class ConnectionGraph
 
-void ConnectionGraph::add(Exp *a, Exp *b) {
-    iterator ff = emap.find(a);
-    while (ff != emap.end() && *ff->first == *a) {
-        if (*ff->second == *b)
-            return; // Don't add a second entry
-        ++ff;
+//! Number of location e, giving it one if it hasn't been connected before
+int ConnectionGraph::idOf(Exp *e) {
+    std::pair<NodeMap::iterator, bool> ins = ids.insert(NodeMap::value_type(e, (int)nodes.size()));
+    if (!ins.second)
+        return ins.first->second;
+    nodes.push_back(e);
+    adj.emplace_back();
+    size_t n = nodes.size();
+    if (useMatrix && n > MAX_MATRIX_NODES) {
+        useMatrix = false;
+        DenseBitSet().swap(matrix);
     }
-    std::pair<Exp *, Exp *> pr;
-    pr.first = a;
-    pr.second = b;
-    emap.insert(pr);
+    if (useMatrix)
+        matrix.resize(n * (n + 1) / 2);
+    return ins.first->second;
+}
+
+//! Number of location e, or -1 if it isn't in the graph
+int ConnectionGraph::findId(const Exp *e) const {
+    NodeMap::const_iterator ff = ids.find(const_cast<Exp *>(e));
+    return ff == ids.end() ? -1 : ff->second;
+}
+
+bool ConnectionGraph::connected(int i, int j) const {
+    if (!useMatrix) {
+        const std::vector<int> &shorter(adj[i].size() <= adj[j].size() ? adj[i] : adj[j]);
+        int other = &shorter == &adj[i] ? j : i;
+        return std::find(shorter.begin(), shorter.end(), other) != shorter.end();
+    }
+    if (i < j)
+        std::swap(i, j);
+    size_t bit = (size_t)i * (i + 1) / 2 + j;
+    return matrix.test(bit);
+}
+
+void ConnectionGraph::setBit(int i, int j, bool on) {
+    if (!useMatrix)
+        return;
+    if (i < j)
+        std::swap(i, j);
+    size_t bit = (size_t)i * (i + 1) / 2 + j;
+    if (on)
+        matrix.set(bit);
+    else
+        matrix.reset(bit);
+}
+
+void ConnectionGraph::addEdge(int i, int j) {
+    if (connected(i, j))
+        return; // Don't add a second entry
+    setBit(i, j, true);
+    adj[i].push_back(j);
+    if (i != j)
+        adj[j].push_back(i);
+}
+
+void ConnectionGraph::removeEdge(int i, int j) {
+    setBit(i, j, false);
+    adj[i].erase(std::find(adj[i].begin(), adj[i].end(), j));
+    if (i != j)
+        adj[j].erase(std::find(adj[j].begin(), adj[j].end(), i));
 }
 
 void ConnectionGraph::connect(Exp *a, Exp *b) {
-    add(a, b);
-    add(b, a);
+    int i = idOf(a);
+    addEdge(i, idOf(b));
 }
 //! Return a count of locations connected to \a e
 int ConnectionGraph::count(Exp *e) const {
-    const_iterator ff = emap.find(e);
-    int n = 0;
-    while (ff != emap.end() && *ff->first == *e) {
-        ++n;
-        ++ff;
-    }
-    return n;
+    int i = findId(e);
+    return i == -1 ? 0 : (int)adj[i].size();
 }
 //! Return true if a is connected to b
 bool ConnectionGraph::isConnected(Exp *a, const Exp &b) const {
-    const_iterator ff = emap.find(a);
-    while (ff != emap.end() && *ff->first == *a) {
-        if (*ff->second == b)
-            return true; // Found the connection
-        ++ff;
-    }
-    return false;
+    int i = findId(a);
+    if (i == -1)
+        return false;
+    int j = findId(&b);
+    return j != -1 && connected(i, j);
 }
 
 // Modify the map so that a <-> b becomes a <-> c
 //! Update the map that used to be a <-> b, now it is a <-> c
 void ConnectionGraph::update(Exp *a, Exp *b, Exp *c) {
-    // find a->b
-    iterator ff = emap.find(a);
-    while (ff != emap.end() && *ff->first == *a) {
-        if (*ff->second == *b) {
-            ff->second = c; // Now a->c
-            break;
-        }
-        ++ff;
-    }
-    // find b -> a
-    ff = emap.find(b);
-    while (ff != emap.end() && *ff->first == *b) {
-        if (*ff->second == *a) {
-            emap.erase(ff);
-            add(c, a); // Now c->a
-            break;
-        }
-        ++ff;
+    int i = findId(a), j = findId(b);
+    if (i == -1 || j == -1 || !connected(i, j))
+        return;
+    int k = idOf(c);
+    if (connected(i, k)) {
+        removeEdge(i, j);
+        return;
     }
+    // Keep c in the place of b among the neighbours of a
+    *std::find(adj[i].begin(), adj[i].end(), j) = k;
+    if (i != j)
+        adj[j].erase(std::find(adj[j].begin(), adj[j].end(), i));
+    if (i != k)
+        adj[k].push_back(i);
+    setBit(i, j, false);
+    setBit(i, k, true);
 }
 
-// Remove the mapping at *aa, and return a valid iterator for looping
+// Remove the connection at *aa (in both directions), and return a valid iterator for looping
 ConnectionGraph::iterator ConnectionGraph::remove(iterator aa) {
-    assert(aa != emap.end());
-    Exp *b = aa->second;
-    emap.erase(aa++);
-    iterator bb = emap.find(b);
-    assert(bb != emap.end());
-    if (bb == aa)
-        ++aa;
-    emap.erase(bb);
+    assert(aa != end());
+    int i = aa.node->second;
+    removeEdge(i, adj[i][aa.idx]);
+    aa.settle();
     return aa;
 }
 
+ConnectionGraph::iterator::iterator(const ConnectionGraph *g, NodeMap::const_iterator n) : graph(g), node(n), idx(0) {
+    settle();
+}
+
+//! Move on to the next location if the current one has no neighbours left, and set cur
+void ConnectionGraph::iterator::settle() {
+    while (node != graph->ids.end() && idx >= graph->adj[node->second].size()) {
+        ++node;
+        idx = 0;
+    }
+    if (node != graph->ids.end())
+        cur = std::make_pair(node->first, graph->nodes[graph->adj[node->second][idx]]);
+}
+
+ConnectionGraph::iterator &ConnectionGraph::iterator::operator++() {
+    ++idx;
+    settle();
+    return *this;
+}
+
 // For debugging
 void dumpConnectionGraph(const ConnectionGraph *cg) {
     ConnectionGraph::const_iterator cc;
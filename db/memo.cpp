@@ -0,0 +1,40 @@
+/***************************************************************************/ /**
+  * \file       memo.cpp
+  * \brief   Implementation of the ProcHistory class
+  ******************************************************************************/
+#include "memo.h"
+
+#include <QStringList>
+
+//! Add a snapshot of the proc, printed as \a text, at the debug point \a description
+void ProcHistory::take(const QString &description, const QString &text) {
+    Snapshot snap;
+    snap.description = description;
+    for (const QString &line : text.split('\n')) {
+        auto it = lineIds.find(line);
+        if (it == lineIds.end()) {
+            it = lineIds.insert(line, lines.size());
+            lines.push_back(line);
+        }
+        snap.text.push_back(it.value());
+    }
+    snapshots.push_back(snap);
+}
+
+//! \returns the text of snapshot \a i, as it was printed
+QString ProcHistory::getText(size_t i) const {
+    QString res;
+    const std::vector<unsigned> &text(snapshots[i].text);
+    for (size_t n = 0; n < text.size(); n++) {
+        if (n)
+            res += '\n';
+        res += lines[text[n]];
+    }
+    return res;
+}
+
+void ProcHistory::clear() {
+    lineIds.clear();
+    lines.clear();
+    snapshots.clear();
+}
@@ -0,0 +1,40 @@
+/***************************************************************************/ /**
+  * \file       memstats.cpp
+  * \brief   Implementation of the MemStats class
+  ******************************************************************************/
+#include "memstats.h"
+
+#include <cstdio>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+std::atomic<size_t> MemStats::liveObjects[MemStats::NUM_KINDS];
+std::atomic<size_t> MemStats::liveBytes[MemStats::NUM_KINDS];
+std::atomic<size_t> MemStats::peakBytes[MemStats::NUM_KINDS];
+std::atomic<size_t> MemStats::totalLive(0);
+std::atomic<size_t> MemStats::totalPeak(0);
+
+const char *MemStats::getName(Kind k) {
+    static const char *names[NUM_KINDS] = {
+        "Const", "Terminal", "Unary", "Binary", "Ternary", "TypedExp", "FlagDef", "RefExp", "TypeVal", "Location",
+        "Assign", "PhiAssign", "ImplicitAssign", "BoolAssign", "ImpRefStatement", "GotoStatement",
+        "JunctionStatement", "BranchStatement", "CaseStatement", "CallStatement", "ReturnStatement",
+        "RTL", "SyntaxNode", "BasicBlock", "Type", "other"};
+    return names[k];
+}
+
+//! The resident set size of the process, or the bytes of live IR where the system does not tell it
+size_t MemStats::getResidentBytes() {
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        unsigned long size = 0, resident = 0;
+        int n = fscanf(f, "%lu %lu", &size, &resident);
+        fclose(f);
+        if (n == 2)
+            return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return totalLive;
+}
@@ -1,8 +1,10 @@
 #include "module.h"
 
 #include "boomerang.h"
+#include "outputwriter.h"
 #include "proc.h"
 #include "prog.h"
+#include "signature.h"
 
 #include <QDir>
 #include <QString>
@@ -12,7 +14,13 @@ void Module::onLibrarySignaturesChanged()
     CurrentFrontend->readLibraryCatalog();
     for (Function *pProc : FunctionList) {
         if (pProc->isLib()) {
-            pProc->setSignature(getLibSignature(pProc->getName()));
+            // Only a signature that changed moves the summary generation, so that only its callers need decompiling
+            // again (see Prog::redecompileStale())
+            Signature *sig = getLibSignature(pProc->getName());
+            if (sig && pProc->getSignature() && *sig == *pProc->getSignature() &&
+                sig->hasEllipsis() == pProc->getSignature()->hasEllipsis())
+                continue;
+            pProc->setSignature(sig);
             for (CallStatement *call_stmt : pProc->getCallers())
                 call_stmt->setSigArguments();
             Boomerang::get()->alertUpdateSignature(pProc);
@@ -58,8 +66,14 @@ Module *Module::getUpstream() { return Upstream; }
 bool Module::hasChildren() { return Children.size() > 0; }
 
 void Module::openStream(const char *ext) {
-    if (out.isOpen())
+    if (out.isOpen() || !bufferedPath.isEmpty())
         return;
+    if (writer) {
+        bufferedPath = getOutPath(ext);
+        strm.setString(&buffered);
+        stream_ext = ext;
+        return;
+    }
     out.setFileName(getOutPath(ext));
     out.open(QFile::WriteOnly | QFile::Text);
     stream_ext = ext;
@@ -71,11 +85,22 @@ void Module::openStreams(const char *ext) {
         child->openStreams(ext);
 }
 
-void Module::closeStreams() {
-    if (out.isOpen()) {
+//! Close the stream of this module only; with a writer, this is when the file is handed to it
+void Module::closeStream() {
+    if (!bufferedPath.isEmpty()) {
+        strm.flush();
+        writer->write(bufferedPath, buffered.toLocal8Bit()); // As a QTextStream on the file would have encoded it
+        buffered.clear();
+        bufferedPath.clear();
+        strm.setDevice(&out);
+    } else if (out.isOpen()) {
         strm.flush();
         out.close();
     }
+}
+
+void Module::closeStreams() {
+    closeStream();
     for (Module *child : Children)
         child->closeStreams();
 }
@@ -120,18 +145,26 @@ void Module::printTree(QTextStream &ostr) {
 }
 /// Record the \a fnc location in the ADDRESS->Function map
 /// If \a fnc is nullptr - remove given function from the map.
+/// The registry of the parent Prog is kept in step.
 void Module::setLocationMap(ADDRESS loc, Function *fnc)
 {
     if(fnc==nullptr) {
         size_t count = LabelsToProcs.erase(loc);
         assert(count==1);
+        if (Parent)
+            Parent->getProcRegistry().erase(loc);
     }
-    else
+    else {
         LabelsToProcs[loc] = fnc;
+        if (Parent)
+            Parent->getProcRegistry().set(loc, fnc);
+    }
 }
 
 void Module::eraseFromParent()
 {
+    for (Function *proc : FunctionList)
+        proc->unregisterName();
     Parent->getModuleList().remove(this);
     delete this;
 }
@@ -146,16 +179,34 @@ void Module::eraseFromParent()
   ******************************************************************************/
 Function *Module::getOrInsertFunction(const QString &name, ADDRESS uNative, bool bLib)
 {
-    Function *pProc;
+    Function *pProc = createFunction(name, uNative, bLib);
+    addFunction(pProc);
+    return pProc;
+}
+
+//! Make a Function object for this Module, without adding it to the Module (see addFunction)
+Function *Module::createFunction(const QString &name, ADDRESS uNative, bool bLib)
+{
     if (bLib)
-        pProc = new LibProc(this, name, uNative);
-    else
-        pProc = new UserProc(this, name, uNative);
+        return new LibProc(this, name, uNative);
+    return new UserProc(this, name, uNative);
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief    Add \a pProc, made by createFunction, to the list of procs in this Module and its address to the map,
+  *           and alert the watchers
+  *
+  ******************************************************************************/
+void Module::addFunction(Function *pProc)
+{
+    ADDRESS uNative = pProc->getNativeAddress();
     if(NO_ADDRESS!=uNative) {
         assert(LabelsToProcs.find(uNative)==LabelsToProcs.end());
-        LabelsToProcs[uNative] = pProc;
+        setLocationMap(uNative, pProc);
     }
     FunctionList.push_back(pProc); // Append this to list of procs
+    pProc->registerName();
     // alert the watchers of a new proc
     emit newFunction(pProc);
     Boomerang::get()->alertNew(pProc);
@@ -204,12 +255,18 @@ Function *Module::getOrInsertFunction(const QString &name, ADDRESS uNative, bool
         }
     }
 #endif
-
-    return pProc;
 }
 
 Function *Module::getFunction(const QString &name)
 {
+    // The procs in a Module are in the name index of the program (see ProcRegistry): a name it does not have is in no
+    // Module, and the first proc of the name is most often ours. Only a name shared with another Module needs the scan
+    if (Parent) {
+        NameTable::Handle h = NameTable::find(name);
+        Function *f = h ? Parent->getProcRegistry().findByName(h) : nullptr;
+        if (f == nullptr || f->getParent() == this)
+            return f;
+    }
     for(Function *f : FunctionList) {
         if ( f->getName()==name)
             return f;
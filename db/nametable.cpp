@@ -0,0 +1,108 @@
+/***************************************************************************/ /**
+  * \file       nametable.cpp
+  * \brief   Implementation of the NameTable class
+  ******************************************************************************/
+#include "nametable.h"
+
+#include "taskscheduler.h"
+
+#include <QHash>
+
+#include <cassert>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+struct StringHash {
+    size_t operator()(const QString &s) const { return qHash(s); }
+};
+
+struct Table {
+    std::mutex lock;
+    QHash<QString, NameTable::Handle> handles;
+    std::deque<QString> names; //!< The name of handle h at h - 1; a deque, so that they stay where they are
+    //! The pooled strings and their reference counts; the keys of an unordered_map stay where they are
+    std::unordered_map<QString, size_t, StringHash> strings;
+};
+Table &table() {
+    static Table t;
+    return t;
+}
+
+//! Holds the lock of the table while tasks may be running on other threads
+class Guard {
+    std::unique_lock<std::mutex> guard;
+
+  public:
+    explicit Guard(Table &t) : guard(t.lock, std::defer_lock) {
+        if (TaskScheduler::isParallel())
+            guard.lock();
+    }
+};
+}
+
+static NameTable::Handle internLocked(Table &t, const QString &name) {
+    auto it = t.handles.find(name);
+    if (it != t.handles.end())
+        return it.value();
+    t.names.push_back(name);
+    NameTable::Handle h = (NameTable::Handle)t.names.size();
+    t.handles.insert(name, h);
+    return h;
+}
+
+//! \returns the handle of \a name, giving it one if it has none yet
+NameTable::Handle NameTable::intern(const QString &name) {
+    Table &t(table());
+    Guard guard(t);
+    return internLocked(t, name);
+}
+
+//! \returns the handle of \a name, or 0 if it was never interned (so that nothing is known by it)
+NameTable::Handle NameTable::find(const QString &name) {
+    Table &t(table());
+    Guard guard(t);
+    return t.handles.value(name, 0);
+}
+
+QString NameTable::getName(Handle h) {
+    Table &t(table());
+    Guard guard(t);
+    return h == 0 ? QString() : t.names[h - 1];
+}
+
+//! \returns the pool's copy of \a str, with a reference to it that release() gives back
+const QString *NameTable::pool(const QString &str) {
+    Table &t(table());
+    Guard guard(t);
+    auto it = t.strings.emplace(str, 0).first;
+    it->second++;
+    return &it->first;
+}
+
+//! Take another reference to \a str, which pool() returned
+void NameTable::retain(const QString *str) {
+    Table &t(table());
+    Guard guard(t);
+    auto it = t.strings.find(*str);
+    assert(it != t.strings.end() && &it->first == str);
+    it->second++;
+}
+
+//! Give back a reference to \a str, which pool() returned; the last frees it
+void NameTable::release(const QString *str) {
+    Table &t(table());
+    Guard guard(t);
+    auto it = t.strings.find(*str);
+    assert(it != t.strings.end() && &it->first == str);
+    if (--it->second == 0)
+        t.strings.erase(it);
+}
+
+//! \returns the number of strings in the pool
+size_t NameTable::poolSize() {
+    Table &t(table());
+    Guard guard(t);
+    return t.strings.size();
+}
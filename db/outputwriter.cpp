@@ -0,0 +1,51 @@
+/***************************************************************************/ /**
+  * \file       outputwriter.cpp
+  * \brief   Implementation of the OutputWriter class
+  ******************************************************************************/
+#include "outputwriter.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QMutexLocker>
+
+//! Queue \a contents to be written to the file \a path, replacing it
+void OutputWriter::write(const QString &path, const QByteArray &contents) {
+    {
+        QMutexLocker locker(&lock);
+        pending.push_back(std::make_pair(path, contents));
+        changed.wakeOne();
+    }
+    if (!isRunning())
+        start();
+}
+
+//! Wait until every file queued has been written
+void OutputWriter::finish() {
+    {
+        QMutexLocker locker(&lock);
+        finishing = true;
+        changed.wakeAll();
+    }
+    wait();
+    // Files queued after this start the thread again
+    finishing = false;
+}
+
+void OutputWriter::run() {
+    for (;;) {
+        std::pair<QString, QByteArray> file;
+        {
+            QMutexLocker locker(&lock);
+            while (pending.empty() && !finishing)
+                changed.wait(&lock);
+            if (pending.empty())
+                return;
+            file = pending.front();
+            pending.pop_front();
+        }
+        QFile f(file.first);
+        if (!f.open(QFile::WriteOnly | QFile::Truncate | QFile::Text) || f.write(file.second) != file.second.size()) {
+            QMutexLocker locker(&lock);
+            failures << file.first;
+        }
+    }
+}
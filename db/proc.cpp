@@ -22,7 +22,7 @@
   * \class Proc
   *
   * \var Function::Visited
-  * \brief For printCallGraphXML
+  * \brief For the walks of the call graph by Prog::printCallGraph() and printCallGraphXML()
   * \var Function::prog
   * \brief Program containing this procedure.
   * \var Function::signature
@@ -74,13 +74,20 @@
 #include "visitor.h"
 #include "log.h"
 #include "basicblock.h"
+#include "stats.h"
+#include "proccache.h"
+#include "passes/ConstantPropagation.h"
+#include "passes/RangeAnalysis.h"
+#include "passes/PassManager.h"
 
+#include <QtCore/QCryptographicHash>
 #include <QtCore/QDebug>
 #include <QtCore/QFile>
 #include <QtCore/QTextStream>
 #include <sstream>
 #include <algorithm> // For find()
 #include <cstring>
+#include <deque>
 
 #ifdef _WIN32
 #undef NO_ADDRESS
@@ -94,9 +101,7 @@ namespace dbghelp {
 #define NO_ADDRESS ADDRESS::g(-1)
 #endif
 
-typedef std::map<Instruction *, int> RefCounter;
-
-extern char debug_buffer[]; // Defined in basicblock.cpp, size DEBUG_BUFSIZE
+extern thread_local char debug_buffer[]; // Defined in basicblock.cpp, size DEBUG_BUFSIZE
 extern QTextStream &alignStream(QTextStream &str,int align);
 
 /************************
@@ -111,6 +116,7 @@ void Function::eraseFromParent()
     Parent->setLocationMap(getNativeAddress(),(Function *)-1);
     // Delete the cfg etc.
     Parent->getFunctionList().remove(this);
+    unregisterName();
     this->deleteCFG();
     delete this;  //Delete ourselves
 }
@@ -129,6 +135,9 @@ Function::Function(ADDRESS uNative, Signature *sig, Module *mod)
     prog = mod->getParent();
 }
 
+//! The session of the program this procedure belongs to; the command line session if it has no program
+DecompilerContext *Function::getContext() const { return prog ? prog->getContext() : Boomerang::get(); }
+
 /***************************************************************************/ /**
   *
   * \brief        Returns the name of this procedure
@@ -147,7 +156,37 @@ QString Function::getName() const {
   ******************************************************************************/
 void Function::setName(const QString &nam) {
     assert(signature);
+    bool registered = nameHandle != 0;
+    unregisterName();
     signature->setName(nam);
+    if (registered)
+        registerName();
+}
+
+//! Replace the signature, which has the name too
+void Function::setSignature(Signature *sig) {
+    bool registered = nameHandle != 0;
+    unregisterName();
+    signature = sig;
+    if (registered)
+        registerName();
+    summaryChanged();
+}
+
+//! Add this proc to the names of the ProcRegistry of its program, as it joins a Module
+void Function::registerName() {
+    if (prog == nullptr || signature == nullptr || nameHandle != 0)
+        return;
+    nameHandle = NameTable::intern(getName());
+    prog->getProcRegistry().addName(nameHandle, this);
+}
+
+//! Remove this proc from the names of the ProcRegistry of its program, as it leaves its Module
+void Function::unregisterName() {
+    if (prog == nullptr || nameHandle == 0)
+        return;
+    prog->getProcRegistry().removeName(nameHandle, this);
+    nameHandle = 0;
 }
 
 /***************************************************************************/ /**
@@ -175,6 +214,8 @@ bool LibProc::isNoReturn() { return FrontEnd::noReturnCallDest(getName()); }
  * has c, d, and e at the point where the f-g cycle is found).
  * \var UserProc::stmtNumber
  * Current statement number. Makes it easier to split decompile() into smaller pieces.
+ * \var UserProc::stmtTable
+ * The statement each number was given to, for the side tables keyed by statement number.
  * \var UserProc::theReturnStatement
  * We ensure that there is only one return statement now. See code in frontend/frontend.cpp handling case
  * STMT_RET. If no return statement, this will be nullptr.
@@ -310,48 +351,17 @@ void UserProc::renameLocal(const char *oldName, const char *newName) {
     Exp *oldLoc = getSymbolFor(oldExp, ty);
     Exp *newLoc = Location::local(newName, this);
     mapSymbolToRepl(oldExp, oldLoc, newLoc);
-    locals[newName] = ty;
+    setLocal(newName, ty);
     cfg->searchAndReplace(*oldLoc, newLoc);
 }
 
-bool UserProc::searchAll(const Exp &search, std::list<Exp *> &result) { return cfg->searchAll(search, result); }
-
-void Function::printCallGraphXML(QTextStream &os, int depth, bool /*recurse*/) {
-    if (!DUMP_XML)
-        return;
-    Visited = true;
-    for (int i = 0; i < depth; i++)
-        os << "      ";
-    os << "<proc name=\"" << getName() << "\"/>\n";
-}
-
-void UserProc::printCallGraphXML(QTextStream &os, int depth, bool recurse) {
-    if (!DUMP_XML)
-        return;
-    bool wasVisited = Visited;
-    Visited = true;
-    int i;
-    for (i = 0; i < depth; i++)
-        os << "      ";
-    os << "<proc name=\"" << getName() << "\">\n";
-    if (recurse) {
-        for (auto &elem : calleeList)
-            (elem)->printCallGraphXML(os, depth + 1, !wasVisited && !(elem)->isVisited());
-    }
-    for (i = 0; i < depth; i++)
-        os << "      ";
-    os << "</proc>\n";
-}
+bool UserProc::searchAll(const Exp &search, ExpMatchList &result) { return cfg->searchAll(search, result); }
 
 void Function::printDetailsXML() {
     if (!DUMP_XML)
         return;
-    QFile file(Boomerang::get()->getOutputPath() + getName() + "-details.xml");
-    if(!file.open(QFile::WriteOnly)) {
-        qDebug() << "Can't write to file:" << file.fileName();
-        return;
-    }
-    QTextStream out(&file);
+    QString xml;
+    QTextStream out(&xml);
     out << "<proc name=\"" << getName() << "\">\n";
     unsigned i;
     for (i = 0; i < signature->getNumParams(); i++)
@@ -362,11 +372,14 @@ void Function::printDetailsXML() {
         out << "   <return exp=\"" << signature->getReturnExp(i) << "\" "
             << "type=\"" << signature->getReturnType(i)->getCtype() << "\"/>\n";
     out << "</proc>\n";
+    out.flush();
+    prog->writeDump(getName() + "-details.xml", xml);
 }
 void Function::removeFromParent() {
     assert(Parent);
     Parent->getFunctionList().remove(this);
     Parent->setLocationMap(address,nullptr);
+    unregisterName();
 }
 
 Function::Function()
@@ -381,81 +394,50 @@ void Function::setParent(Module *c) {
     Parent = c;
     c->getFunctionList().push_back(this);
     c->setLocationMap(address,this);
+    registerName();
 }
 
-void UserProc::printDecodedXML() {
+//! Write the statements of \a proc, as they are at \a stage of decompilation, to \<name\>-\<stage\>.xml
+static void printStageXML(UserProc *proc, const char *stage) {
     if (!DUMP_XML)
         return;
-    QFile file(Boomerang::get()->getOutputPath() + getName() + "-decoded.xml");
-    if(!file.open(QFile::WriteOnly)) {
-        qDebug() << "Can't write to file:" << file.fileName();
-        return;
-    }
-    QTextStream out(&file);
-    out << "<proc name=\"" << getName() << "\">\n";
-    out << "    <decoded>\n";
+    QString xml;
+    QTextStream out(&xml);
+    out << "<proc name=\"" << proc->getName() << "\">\n";
+    out << "    <" << stage << ">\n";
     QString enc;
     QTextStream os(&enc);
-    print(os);
+    proc->print(os);
     out << enc.toHtmlEscaped();
-    out << "    </decoded>\n";
+    out << "    </" << stage << ">\n";
     out << "</proc>\n";
+    out.flush();
+    proc->getProg()->writeDump(proc->getName() + "-" + stage + ".xml", xml);
 }
 
-void UserProc::printAnalysedXML() {
-    if (!DUMP_XML)
-        return;
-    QFile file(Boomerang::get()->getOutputPath() + getName() + "-analysed.xml");
-    if(!file.open(QFile::WriteOnly)) {
-        qDebug() << "Can't write to file:" << file.fileName();
-        return;
-    }
-    QTextStream out(&file);
-    out << "<proc name=\"" << getName() << "\">\n";
-    out << "    <analysed>\n";
-    QString enc;
-    QTextStream os(&enc);
-    print(os);
-    out << enc.toHtmlEscaped();
-    out << "    </analysed>\n";
-    out << "</proc>\n";
-}
+void UserProc::printDecodedXML() { printStageXML(this, "decoded"); }
 
-void UserProc::printSSAXML() {
-    if (!DUMP_XML)
-        return;
-    QFile file(Boomerang::get()->getOutputPath() + getName() + "-ssa.xml");
-    if(!file.open(QFile::WriteOnly)) {
-        qDebug() << "Can't write to file:" << file.fileName();
-        return;
-    }
-    QTextStream out(&file);
-    out << "<proc name=\"" << getName() << "\">\n";
-    out << "    <ssa>\n";
-    QString enc;
-    QTextStream os(&enc);
-    print(os);
-    out << enc.toHtmlEscaped();
-    out << "    </ssa>\n";
-    out << "</proc>\n";
-}
+void UserProc::printAnalysedXML() { printStageXML(this, "analysed"); }
 
-void UserProc::printXML() {
+void UserProc::printSSAXML() { printStageXML(this, "ssa"); }
+
+//! Dump the details, the statements and the use graph of this proc, and unless \a callGraph is false the call graph
+//! of the whole program. Only with -x
+void UserProc::printXML(bool callGraph) {
     if (!DUMP_XML)
         return;
     printDetailsXML();
     printSSAXML();
-    prog->printCallGraphXML();
+    if (callGraph)
+        prog->printCallGraphXML();
     printUseGraph();
 }
 
 void UserProc::printUseGraph() {
-    QFile file(Boomerang::get()->getOutputPath() + getName() + "-usegraph.dot");
-    if(!file.open(QFile::WriteOnly)) {
-        qDebug() << "Can't write to file:" << file.fileName();
+    if (!DUMP_XML)
         return;
-    }
-    QTextStream out(&file);
+    QString dot;
+    QTextStream out(&dot);
     out << "digraph " << getName() << " {\n";
     StatementList stmts;
     getStatements(stmts);
@@ -476,6 +458,8 @@ void UserProc::printUseGraph() {
         }
     }
     out << "}\n";
+    out.flush();
+    prog->writeDump(getName() + "-usegraph.dot", dot);
 }
 
 //! Get the first procedure that calls this procedure (or null for main/start).
@@ -541,17 +525,43 @@ UserProc::UserProc(Module *mod, const QString &name, ADDRESS uNative)
     localTable.setProc(this);
 }
 
-UserProc::~UserProc() { deleteCFG(); }
+// Only when the whole program goes (see Module::~Module), so the other procs, which may be gone already, are not told
+UserProc::~UserProc() { releaseIR(); }
 
 /***************************************************************************/ /**
   *
   * \brief        Deletes the whole Cfg for this proc object. Also clears the
   * cfg pointer, to prevent strange errors after this is called
+  * \note         This also releases the arena, so any Exp or Instruction allocated while this proc was current is gone.
+  * So first the calls of this proc leave the callers of its callees, and the calls to this proc forget its return
+  * statement (as for a callee not yet decompiled), so that no other proc refers to them.
   *
   ******************************************************************************/
 void UserProc::deleteCFG() {
+    for (Function *callee : calleeList) {
+        std::set<CallStatement *> &callers(callee->getCallers());
+        for (auto it = callers.begin(); it != callers.end();) {
+            if ((*it)->getProc() == this)
+                it = callers.erase(it);
+            else
+                ++it;
+        }
+    }
+    if (theReturnStatement) {
+        for (CallStatement *call : callerSet)
+            if (call->getCalleeReturn() == theReturnStatement)
+                call->setCalleeReturn(nullptr);
+    }
+    releaseIR();
+}
+
+//! Delete the Cfg and release the arena, with what is in them
+void UserProc::releaseIR() {
+    RangeAnalysis::forgetRanges(this); // They refer to the statements
     delete cfg;
     cfg = nullptr;
+    theReturnStatement = nullptr;
+    arena.release();
 }
 
 class lessEvaluate : public std::binary_function<SyntaxNode *, SyntaxNode *, bool> {
@@ -565,6 +575,10 @@ class lessEvaluate : public std::binary_function<SyntaxNode *, SyntaxNode *, boo
  * _calculates_ * this value and is expected to do so expensively.
  */
 SyntaxNode *UserProc::getAST() {
+    // Every candidate is a clone of the tree it came from, so they are all made in one arena and go together, at the
+    // next call; the Exps cloned for them (conditions) go there too
+    astArena.release();
+    ArenaScope inArena(&astArena, true);
     int numBBs = 0;
     BlockSyntaxNode *init = new BlockSyntaxNode();
     BB_IT it;
@@ -595,8 +609,6 @@ SyntaxNode *UserProc::getAST() {
         printAST(top); // debug
 
         if (score < best_score) {
-            if (best && top != best)
-                delete best;
             best = top;
             best_score = score;
         }
@@ -613,19 +625,7 @@ SyntaxNode *UserProc::getAST() {
             successor->addToScore(successor->getDepth()); // or this
             ASTs.push(successor);
         }
-
-        if (top != best)
-            delete top;
     }
-
-    // clean up memory
-    while (!ASTs.empty()) {
-        SyntaxNode *top = ASTs.top();
-        ASTs.pop();
-        if (top != best)
-            delete top;
-    }
-
     return best;
 }
 
@@ -665,9 +665,109 @@ void UserProc::setDecoded() {
   ******************************************************************************/
 void UserProc::unDecode() {
     cfg->clear();
+    decodedInsns.clear();
     setStatus(PROC_UNDECODED);
 }
 
+/***************************************************************************/ /**
+  *
+  * \brief Throw away the decode and decompilation of this proc, so that decompile() starts it again from the binary
+  *
+  * Unlike unDecode(), this forgets everything decompiling found out about the proc: its statements and symbols, its
+  * parameters and returns, what it proved, and the calls it makes, which leave the callers of its callees (see
+  * deleteCFG(), which releases the arena they were in). Its callers keep referring to this proc, but not to its return
+  * statement, which goes with the arena: until Prog::redecompileStale() gives them the new one, their calls to it are
+  * as to a proc not yet decompiled. The signature is kept, as it may have been given by the user; its Exps are on the
+  * heap (see Parameter), so they survive the arena.
+  *
+  ******************************************************************************/
+void UserProc::forgetDecompilation() {
+    deleteCFG();
+    calleeList.clear();
+    for (const auto &pr : globalRefs)
+        pr.first->addRefs(-pr.second);
+    globalRefs.clear();
+
+    cfg = new Cfg();
+    cfg->setProc(this);
+    decodedInsns.clear();
+    clearSymbolMap();
+    locals.clear();
+    nextLocal = nextParam = 0;
+    maxLocalSize = 0;
+    localTable = DataIntervalMap();
+    localTable.setProc(this);
+    col.clear();
+    parameters.clear();
+    addressEscapedVars.clear();
+    df = DataFlow();
+    stmtTable.clear();
+    stmtNumber = 0;
+    theReturnStatement = nullptr;
+    cycleGrp = nullptr;
+    provenTrue.clear();
+    recurPremises.clear();
+    proofResults.clear();
+    proofFingerprint.clear();
+    budgetSteps = 0;
+    budgetExhausted = false;
+    propGrowthLeft = -1;
+    useLists = false;
+    fromCache = false;
+    unusedLocalsRemoved = false;
+    consumedSummaries.clear();
+    consumedGlobals.clear();
+    status = PROC_UNDECODED;
+    summaryChanged();
+}
+
+//! Remember the generations of the summaries of the callees, and of the types of the globals, that the decompilation
+//! of this proc has just used, so that consumesStaleSummaries() can tell when one of them changes
+void UserProc::recordConsumedSummaries() {
+    consumedSummaries.clear();
+    for (Function *callee : calleeList)
+        consumedSummaries[callee] = callee->getSummaryGeneration();
+    consumedGlobals.clear();
+    for (const auto &pr : globalRefs)
+        consumedGlobals[pr.first] = pr.first->getTypeGeneration();
+}
+
+//! True if the summary of a callee, or the type of a global, has changed since recordConsumedSummaries()
+bool UserProc::consumesStaleSummaries() const {
+    for (const auto &pr : consumedSummaries) {
+        if (pr.first->getSummaryGeneration() != pr.second)
+            return true;
+    }
+    for (const auto &pr : consumedGlobals) {
+        if (pr.first->getTypeGeneration() != pr.second)
+            return true;
+    }
+    return false;
+}
+
+//! Take the summary of \a callee as it is now as the one this proc used, when it has changed in nothing the callers see
+void UserProc::refreshConsumedSummary(Function *callee) {
+    auto it = consumedSummaries.find(callee);
+    if (it != consumedSummaries.end())
+        it->second = callee->getSummaryGeneration();
+}
+
+//! Print what the callers of this proc take from it: its signature, what it modifies and returns, and what it preserves
+void UserProc::printCallerSummary(QTextStream &out) const {
+    signature->print(out);
+    if (theReturnStatement) {
+        out << "modifieds:";
+        for (Instruction *s : theReturnStatement->getModifieds())
+            out << " " << ((Assignment *)s)->getLeft();
+        out << "\nreturns:";
+        for (Instruction *s : *theReturnStatement)
+            out << " " << ((Assignment *)s)->getLeft();
+        out << "\n";
+    }
+    for (const auto &pr : provenTrue)
+        out << pr.first << " = " << pr.second << "\n";
+}
+
 /***************************************************************************/ /**
   *
   * \brief    Get the BB with the entry point address for this procedure
@@ -711,14 +811,24 @@ void UserProc::addCallee(Function *callee) {
 void UserProc::generateCode(HLLCode *hll) {
     assert(cfg);
     assert(getEntryBB());
+    ArenaScope inArena(&arena);
+    StatScope stats(this, "codegen");
+    getContext()->alertStartCodeGen(this);
+    if (fromCache) {
+        // Restored for the callers from the summary of another shard (see Prog::takeShardGroup), which writes it
+        hll->AddPrototype(this);
+        getContext()->alertEndCodeGen(this);
+        return;
+    }
 
     cfg->structure();
-    removeUnusedLocals();
+    if (!unusedLocalsRemoved)
+        removeUnusedLocals();
 
     // Note: don't try to remove unused statements here; that requires the
     // RefExps, which are all gone now (transformed out of SSA form)!
 
-    if (VERBOSE || Boomerang::get()->printRtl)
+    if (VERBOSE || getContext()->printRtl)
         LOG << *this;
 
     hll->AddProcStart(this);
@@ -734,7 +844,7 @@ void UserProc::generateCode(HLLCode *hll) {
         hll->AddLocal(it->first, locType, it == last);
     }
 
-    if (Boomerang::get()->noDecompile && getName() == "main") {
+    if (getContext()->noDecompile && getName() == "main") {
         StatementList args, results;
         if (prog->getFrontEndId() == PLAT_PENTIUM)
             hll->AddCallStatement(1, nullptr, "PENTIUMSETUP", args, &results);
@@ -747,24 +857,32 @@ void UserProc::generateCode(HLLCode *hll) {
 
     hll->AddProcEnd();
 
-    if (!Boomerang::get()->noRemoveLabels)
+    if (!getContext()->noRemoveLabels)
         cfg->removeUnneededLabels(hll);
 
     setStatus(PROC_CODE_GENERATED);
+    getContext()->alertEndCodeGen(this);
 }
 
 /// print this proc, mainly for debugging
 void UserProc::print(QTextStream &out, bool html) const {
+    QString tgt3;
+    QTextStream ost3(&tgt3);
+    cfg->print(ost3, html);
+
+    printSummary(out, html);
+    out << tgt3 << "\n";
+}
+
+//! Print what print() does before the BBs: the signature, parameters, locals, symbols and live variables
+void UserProc::printSummary(QTextStream &out, bool html) const {
     QString tgt1;
     QString tgt2;
-    QString tgt3;
     QTextStream ost1(&tgt1);
     QTextStream ost2(&tgt2);
-    QTextStream ost3(&tgt3);
     printParams(ost1, html);
     dumpLocals(ost1, html);
     col.print(ost2);
-    cfg->print(ost3, html);
 
     signature->print(out, html);
     if (html)
@@ -779,12 +897,12 @@ void UserProc::print(QTextStream &out, bool html) const {
     out << "live variables: " << tgt2 << "\n";
     if (html)
         out << "<br>";
-    out << "end live variables\n" << tgt3 << "\n";
+    out << "end live variables\n";
 }
 
 void UserProc::setStatus(ProcStatus s) {
     status = s;
-    Boomerang::get()->alertProcStatusChange(this);
+    getContext()->alertProcStatusChange(this);
 }
 
 void UserProc::printParams(QTextStream &out, bool html /*= false*/) const {
@@ -806,12 +924,10 @@ void UserProc::printParams(QTextStream &out, bool html /*= false*/) const {
 }
 
 char *UserProc::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     print(ost);
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 void UserProc::dump() {
@@ -883,6 +999,8 @@ void UserProc::initStatements() {
                     if (out != cfg->getExitBB() || cfg->getExitBB()->getNumInEdges() != 1) {
                         out->deleteInEdge(bb);
                         bb->clearOutEdges();
+                        cfg->touchBB(bb);
+                        cfg->touchBB(out); // May be left an orphan
                     }
                 }
             }
@@ -890,16 +1008,22 @@ void UserProc::initStatements() {
     }
 }
 
+//! Number the new statements, and rebuild the statement table from all of them in the same walk
 void UserProc::numberStatements() {
     BB_IT it;
     BasicBlock::rtlit rit;
     StatementList::iterator sit;
+    stmtTable.beginRebuild();
     for (BasicBlock *bb = cfg->getFirstBB(it); bb; bb = cfg->getNextBB(it)) {
-        for (Instruction *s = bb->getFirstStmt(rit, sit); s; s = bb->getNextStmt(rit, sit))
+        for (Instruction *s = bb->getFirstStmt(rit, sit); s; s = bb->getNextStmt(rit, sit)) {
             if (!s->isImplicit() &&  // Don't renumber implicits (remain number 0)
                 s->getNumber() == 0) // Don't renumber existing (or waste numbers)
                 s->setNumber(++stmtNumber);
+            if (s->getNumber() > 0)
+                stmtTable.add(s);
+        }
     }
+    stmtTable.endRebuild();
 }
 
 // get all statements
@@ -922,6 +1046,9 @@ void UserProc::getStatements(StatementList &stmts) const {
   * Remove a statement. This is somewhat inefficient - we have to search the whole BB for the statement.
   * Should use iterators or other context to find out how to erase "in place" (without having to linearly search)
   *
+  * In SSA form this needs no renaming afterwards, as long as nothing still refers to \a stmt: every caller removes
+  * only unused definitions or trivial phis, so no use has to be relinked to another definition.
+  *
   ******************************************************************************/
 void UserProc::removeStatement(Instruction *stmt) {
     // remove anything proven about this statement
@@ -943,12 +1070,16 @@ void UserProc::removeStatement(Instruction *stmt) {
                 LOG << "removing proven true exp " << it->first << " = " << it->second
                     << " that uses statement being removed.\n";
             provenTrue.erase(it++);
+            summaryChanged();
             // it = provenTrue.begin();
             continue;
         }
         ++it; // it is incremented with the erase, or here
     }
 
+    stmtTable.remove(stmt);
+    if (useLists)
+        stmt->dropUses();
     // remove from BB/RTL
     BasicBlock *bb = stmt->getBB(); // Get our enclosing BB
     std::list<RTL *> *rtls = bb->getRTLs();
@@ -956,12 +1087,16 @@ void UserProc::removeStatement(Instruction *stmt) {
         for (RTL::iterator it = rit->begin(); it != rit->end(); it++) {
             if (*it == stmt) {
                 rit->erase(it);
+                cfg->touchBB(bb); // May have left only a goto
                 return;
             }
         }
     }
 }
 
+/// Insert the assignment \a left := \a right at the end of the block of \a s (or at the start of the procedure if
+/// \a s is nullptr).
+/// \note Used only when translating out of SSA form, so the new definition is not renamed and no phis are placed for it
 void UserProc::insertAssignAfter(Instruction *s, Exp *left, Exp *right) {
     std::list<Instruction *>::iterator it;
     std::list<Instruction *> *stmts;
@@ -989,7 +1124,7 @@ void UserProc::insertAssignAfter(Instruction *s, Exp *left, Exp *right) {
 
 /// Insert statement \a a after statement \a s.
 /// \note this procedure is designed for the front end, where enclosing BBs are not set up yet.
-/// So this is an inefficient linear search!
+/// So this is an inefficient linear search! It is also before SSA form, so there is nothing to rename.
 void UserProc::insertStatementAfter(Instruction *s, Instruction *a) {
     BB_IT bb;
     for (bb = cfg->begin(); bb != cfg->end(); bb++) {
@@ -1068,7 +1203,8 @@ void UserProc::insertStatementAfter(Instruction *s, Instruction *a) {
   *
   ******************************************************************************/
 std::shared_ptr<ProcSet> UserProc::decompile(ProcList *path, int &indent) {
-    Boomerang::get()->alertConsidering(path->empty() ? nullptr : path->back(), this);
+    ArenaScope inArena(&arena);
+    getContext()->alertConsidering(path->empty() ? nullptr : path->back(), this);
     alignStream(LOG_STREAM(),++indent) << (status >= PROC_VISITED ? "re" : "") << "considering "
               << getName() << "\n";
     LOG_VERBOSE(1) << "begin decompile(" << getName() << ")\n";
@@ -1079,8 +1215,11 @@ std::shared_ptr<ProcSet> UserProc::decompile(ProcList *path, int &indent) {
         return nullptr; // Already decompiled
     }
     if (status < PROC_DECODED)
-        // Can happen e.g. if a callee is visible only after analysing a switch statement
-        prog->reDecode(this); // Actually decoding for the first time, not REdecoding
+        // With --lazy-decode, or e.g. if a callee is visible only after analysing a switch statement
+        prog->decodeOnDemand(this);
+
+    if (status < PROC_VISITED && ProcCache::get().isEnabled())
+        ProcCache::get().keepKey(this); // The key it is looked up by, made of what is decoded of it now
 
     if (status < PROC_VISITED)
         setStatus(PROC_VISITED); // We have at least visited this proc "on the way down"
@@ -1093,7 +1232,7 @@ std::shared_ptr<ProcSet> UserProc::decompile(ProcList *path, int &indent) {
          *                                            *
          *    *    *    *    *    *    *    *    *    *    *    */
 
-    if (!Boomerang::get()->noDecodeChildren) {
+    if (!getContext()->noDecodeChildren) {
         // Recurse to children first, to perform a depth first search
         BB_IT it;
         // Look at each call, to do the DFS
@@ -1180,7 +1319,7 @@ std::shared_ptr<ProcSet> UserProc::decompile(ProcList *path, int &indent) {
 
     // if child is empty, i.e. no child involved in recursion
     if (child->empty()) {
-        Boomerang::get()->alertDecompiling(this);
+        getContext()->alertDecompiling(this);
         alignStream(LOG_STREAM(1),indent) << "decompiling " << getName() << "\n";
         initialiseDecompile(); // Sort the CFG, number statements, etc
         earlyDecompile();
@@ -1194,7 +1333,7 @@ std::shared_ptr<ProcSet> UserProc::decompile(ProcList *path, int &indent) {
     if (child->empty()) {
         remUnusedStmtEtc(); // Do the whole works
         setStatus(PROC_FINAL);
-        Boomerang::get()->alertEndDecompile(this);
+        getContext()->alertEndDecompile(this);
     } else {
         // this proc's children, and hence this proc, is/are involved in recursion
         // find first element f in path that is also in cycleGrp
@@ -1207,7 +1346,7 @@ std::shared_ptr<ProcSet> UserProc::decompile(ProcList *path, int &indent) {
             // Yes, process these procs as a group
             recursionGroupAnalysis(path, indent); // Includes remUnusedStmtEtc on all procs in cycleGrp
             setStatus(PROC_FINAL);
-            Boomerang::get()->alertEndDecompile(this);
+            getContext()->alertEndDecompile(this);
             child->clear(); //delete child;
             child = std::make_shared<ProcSet>();
         }
@@ -1229,11 +1368,12 @@ std::shared_ptr<ProcSet> UserProc::decompile(ProcList *path, int &indent) {
     return child;
 }
 
-void UserProc::debugPrintAll(const char *step_name) {
-    if (VERBOSE) {
-        LOG_SEPARATE(getName()) << "--- debug print " << step_name << " for " << getName() << " ---\n" << *this
-                                << "=== end debug print " << step_name << " for " << getName() << " ===\n\n";
-    }
+//! True if debugging output is wanted for this proc: with -v, and --debug-proc naming it if given at all
+bool UserProc::wantsDebugOutput() const { return getContext()->vFlag && getContext()->isDebugProc(getName()); }
+
+void UserProc::printForDebug(const char *step_name) {
+    LOG_SEPARATE(getName()) << "--- debug print " << step_name << " for " << getName() << " ---\n" << *this
+                            << "=== end debug print " << step_name << " for " << getName() << " ===\n\n";
 }
 /*    *    *    *    *    *    *    *    *    *    *    *
  *                                            *
@@ -1249,14 +1389,17 @@ void UserProc::debugPrintAll(const char *step_name) {
   ******************************************************************************/
 
 void UserProc::initialiseDecompile() {
+    StatScope stats(this, "initialiseDecompile");
 
-    Boomerang::get()->alertStartDecompile(this);
+    getContext()->alertStartDecompile(this);
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "before initialise");
+    getContext()->alertDecompileDebugPoint(this, "before initialise");
 
     if (VERBOSE)
         LOG << "initialise decompile for " << getName() << "\n";
 
+    startBudget();
+
     // Sort by address, so printouts make sense
     cfg->sortByAddress();
 
@@ -1270,17 +1413,82 @@ void UserProc::initialiseDecompile() {
 
     // Number the statements
     stmtNumber = 0;
+    stmtTable.clear();
     numberStatements();
 
     printXML();
 
-    if (Boomerang::get()->noDecompile) {
+    if (getContext()->noDecompile) {
         LOG_STREAM() << "not decompiling.\n";
         setStatus(PROC_FINAL); // ??!
         return;
     }
     debugPrintAll("after decoding");
-    Boomerang::get()->alertDecompileDebugPoint(this, "after initialise");
+    getContext()->alertDecompileDebugPoint(this, "after initialise");
+}
+
+//! Start the clock and the step count of this proc's decompilation budget
+void UserProc::startBudget() {
+    budgetStart = std::chrono::steady_clock::now();
+    budgetSteps = 0;
+    propGrowthLeft = -1;
+    budgetExhausted = degraded;
+    if (degraded) {
+        LOG_STREAM(LL_Warn) << "decompilation budget of " << getName()
+                            << " exhausted in a previous run; finishing it without propagation\n";
+        DecompileStats::get().count(this, "budget", "profiled");
+    }
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief Check whether this proc has used up the time or the steps it is allowed (--proc-time and --proc-steps), or
+  * a watcher has cancelled it. The first time it has, say so in the log; from then on the proc is finished at the
+  * stage it has reached.
+  * \returns true if the budget is exhausted
+  *
+  ******************************************************************************/
+bool UserProc::isOverBudget() {
+    if (budgetExhausted)
+        return true;
+    int seconds = getContext()->procTimeBudget;
+    int steps = getContext()->procStepBudget;
+    if (getContext()->isCancelled(this)) {
+        budgetExhausted = true;
+        LOG_STREAM(LL_Warn) << "decompilation of " << getName() << " cancelled after " << budgetSteps
+                            << " steps; finishing it without further propagation\n";
+        DecompileStats::get().count(this, "budget", "cancelled");
+        return true;
+    }
+    if (seconds > 0 && std::chrono::steady_clock::now() - budgetStart >= std::chrono::seconds(seconds))
+        budgetExhausted = true;
+    else if (steps > 0 && budgetSteps >= (unsigned)steps)
+        budgetExhausted = true;
+    else
+        return false;
+    LOG_STREAM(LL_Warn) << "decompilation budget of " << getName() << " exhausted after " << budgetSteps
+                        << " steps; finishing it without further propagation\n";
+    DecompileStats::get().count(this, "budget", "exhausted");
+    return true;
+}
+
+//! Charge one SSA pass or propagation to the budget of this proc. \returns false if there is no budget left for it
+bool UserProc::takeBudgetStep() {
+    if (isOverBudget())
+        return false;
+    budgetSteps++;
+    return true;
+}
+
+//! Allow a propagation that adds \a nodes to the expressions of this proc if what is left of its propagation growth
+//! budget covers them (see DecompilerContext::propGrowthBudget), and take them from it
+bool UserProc::takePropagationGrowth(long nodes) {
+    if (nodes > propGrowthLeft) {
+        DecompileStats::get().count(this, "propagation", "over growth budget");
+        return false;
+    }
+    propGrowthLeft -= nodes;
+    return true;
 }
 /***************************************************************************/ /**
   *
@@ -1292,8 +1500,9 @@ void UserProc::earlyDecompile() {
 
     if (status >= PROC_EARLYDONE)
         return;
+    StatScope stats(this, "earlyDecompile");
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "before early");
+    getContext()->alertDecompileDebugPoint(this, "before early");
     LOG_VERBOSE(1) << "early decompile for " << getName() << "\n";
 
     // Update the defines in the calls. Will redo if involved in recursion
@@ -1304,8 +1513,8 @@ void UserProc::earlyDecompile() {
 
     // First placement of phi functions, renaming, and initial propagation. This is mostly for the stack pointer
     // maxDepth = findMaxDepth() + 1;
-    // if (Boomerang::get()->maxMemDepth < maxDepth)
-    //    maxDepth = Boomerang::get()->maxMemDepth;
+    // if (getContext()->maxMemDepth < maxDepth)
+    //    maxDepth = getContext()->maxMemDepth;
     // TODO: Check if this makes sense. It seems to me that we only want to do one pass of propagation here, since
     // the status == check had been knobbled below. Hopefully, one call to placing phi functions etc will be
     // equivalent to depth 0 in the old scheme
@@ -1326,7 +1535,14 @@ void UserProc::earlyDecompile() {
 
     debugPrintAll("after propagation (1)");
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after early");
+    if (getContext()->foldConstants) {
+        PassManager passes;
+        passes.add(new ConstantPropagation);
+        if (passes.run(*this))
+            debugPrintAll("after constant propagation (1)");
+    }
+
+    getContext()->alertDecompileDebugPoint(this, "after early");
 }
 /***************************************************************************/ /**
   *
@@ -1337,7 +1553,8 @@ void UserProc::earlyDecompile() {
   ******************************************************************************/
 std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "before middle");
+    StatScope middleStats(this, "middleDecompile");
+    getContext()->alertDecompileDebugPoint(this, "before middle");
 
     // The call bypass logic should be staged as well. For example, consider m[r1{11}]{11} where 11 is a call.
     // The first stage bypass yields m[r1{2}]{11}, which needs another round of propagation to yield m[r1{-}-32]{11}
@@ -1364,7 +1581,7 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
     // Oh, no, we keep doing preservations till almost the end...
     // setStatus(PROC_PRESERVEDS);        // Preservation done
 
-    if (!Boomerang::get()->noPromote)
+    if (!getContext()->noPromote)
         // We want functions other than main to be promoted. Needed before mapExpressionsToLocals
         promoteSignature();
     // The problem with doing locals too early is that the symbol map ends up with some {-} and some {0}
@@ -1393,9 +1610,15 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
     reverseStrengthReduction();
     // processTypes();
 
-    // Repeat until no change
+    // Repeat until no change. The change flags below are conservative (renaming, for one, reports changes that leave
+    // the statements as they were), so also stop when a pass leaves the statements and proofs exactly as they were
+    QByteArray lastFingerprint = getFingerprint(true);
+    int lastPass = getContext()->draft ? 3 : 12; // A draft stops at the first SSA depth
     int pass;
-    for (pass = 3; pass <= 12; ++pass) {
+    for (pass = 3; pass <= lastPass; ++pass) {
+        if (!takeBudgetStep())
+            break; // Finish with the passes done so far
+        StatScope stats(this, "ssa depth", pass);
         // Redo the renaming process to take into account the arguments
         if (VERBOSE)
             LOG << "renaming block variables (2) pass " << pass << "\n";
@@ -1415,22 +1638,24 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
         printXML();
 
         // Print if requested
-        if (VERBOSE) { // was if debugPrintSSA
+        if (DEBUG_HOOKS && wantsDebugOutput()) { // was if debugPrintSSA
             LOG_SEPARATE(getName()) << "--- debug print SSA for " << getName() << " pass " << pass
                                     << " (no propagations) ---\n" << *this << "=== end debug print SSA for "
                                     << getName() << " pass " << pass << " (no propagations) ===\n\n";
         }
 
-        if (!Boomerang::get()->dotFile.isEmpty()) // Require -gd now (though doesn't listen to file name)
+        // Require -gd now (though doesn't listen to file name)
+        if (DEBUG_HOOKS && !getContext()->dotFile.isEmpty() && getContext()->isDebugProc(getName()))
             printDFG();
-        Boomerang::get()->alertDecompileSSADepth(this, pass); // FIXME: need depth -> pass in GUI code
+        getContext()->alertDecompileSSADepth(this, pass); // FIXME: need depth -> pass in GUI code
 
 // (* Was: mapping expressions to Parameters as we go *)
 
 #if 1 // FIXME: Check if this is needed any more. At least fib seems to need it at present.
-        if (!Boomerang::get()->noChangeSignatures) {
+        if (!getContext()->noChangeSignatures) {
             // addNewReturns(depth);
-            for (int i = 0; i < 3; i++) { // FIXME: should be iterate until no change
+            int rounds = getContext()->draft ? 1 : 3;
+            for (int i = 0; i < rounds; i++) { // FIXME: should be iterate until no change
                 if (VERBOSE)
                     LOG << "### update returns loop iteration " << i << " ###\n";
                 if (status != PROC_INCYCLE)
@@ -1451,14 +1676,14 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
 
         printXML();
         // Print if requested
-        if (VERBOSE) { // was if debugPrintSSA
+        if (DEBUG_HOOKS && wantsDebugOutput()) { // was if debugPrintSSA
             LOG_SEPARATE(getName()) << "--- debug print SSA for " << getName() << " at pass " << pass
                                     << " (after trimming return set) ---\n" << *this << "=== end debug print SSA for "
                                     << getName() << " at pass " << pass << " ===\n\n";
         }
 
-        Boomerang::get()->alertDecompileBeforePropagate(this, pass);
-        Boomerang::get()->alertDecompileDebugPoint(this, "before propagating statements");
+        getContext()->alertDecompileBeforePropagate(this, pass);
+        getContext()->alertDecompileDebugPoint(this, "before propagating statements");
 
         // Propagate
         bool convert; // True when indirect call converted to direct
@@ -1489,8 +1714,8 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
                                     << " ===\n\n";
         }
 
-        Boomerang::get()->alertDecompileAfterPropagate(this, pass);
-        Boomerang::get()->alertDecompileDebugPoint(this, "after propagating statements");
+        getContext()->alertDecompileAfterPropagate(this, pass);
+        getContext()->alertDecompileDebugPoint(this, "after propagating statements");
 
         // this is just to make it readable, do NOT rely on these statements being removed
         removeSpAssignsIfPossible();
@@ -1502,8 +1727,12 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
 
         // processTypes();
 
-        if (!change)
+        QByteArray fingerprint = getFingerprint(true);
+        if (!change || fingerprint == lastFingerprint) {
+            DecompileStats::get().count(this, "ssa depth", "passes skipped", lastPass - pass);
             break; // Until no change
+        }
+        lastFingerprint = fingerprint;
     }
 
     // At this point, there will be some memofs that have still not been renamed. They have been prevented from
@@ -1541,7 +1770,7 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
     processTypes();
 #endif
 
-    if (!Boomerang::get()->noParameterNames) {
+    if (!getContext()->noParameterNames) {
         // ? Crazy time to do this... haven't even done "final" parameters as yet
         // mapExpressionsToParameters();
     }
@@ -1553,7 +1782,7 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
         // Code pointed to by the switch table entries has merely had FrontEnd::processFragment() called on it
         LOG << "=== about to restart decompilation of " << getName()
             << " because indirect jumps or calls have been analysed\n\n";
-        Boomerang::get()->alertDecompileDebugPoint(
+        getContext()->alertDecompileDebugPoint(
             this, "before restarting decompilation because indirect jumps or calls have been analysed");
 
         // First copy any new indirect jumps or calls that were decoded this time around. Just copy them all, the map
@@ -1577,7 +1806,7 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
     findPreserveds();
 
     // Used to be later...
-    if (!Boomerang::get()->noParameterNames) {
+    if (!getContext()->noParameterNames) {
         // findPreserveds();        // FIXME: is this necessary here?
         // fixCallBypass();    // FIXME: surely this is not necessary now?
         // trimParameters();    // FIXME: surely there aren't any parameters to trim yet?
@@ -1590,7 +1819,7 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
         LOG << "===== end early decompile for " << getName() << " =====\n\n";
     setStatus(PROC_EARLYDONE);
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after middle");
+    getContext()->alertDecompileDebugPoint(this, "after middle");
 
     return std::make_shared<ProcSet>();
 }
@@ -1610,8 +1839,8 @@ void UserProc::remUnusedStmtEtc() {
     // if (status >= PROC_FINAL)
     //    return;
 
-    Boomerang::get()->alertDecompiling(this);
-    Boomerang::get()->alertDecompileDebugPoint(this, "before final");
+    getContext()->alertDecompiling(this);
+    getContext()->alertDecompileDebugPoint(this, "before final");
 
     LOG_VERBOSE(1) << "--- remove unused statements for " << getName() << " ---\n";
     // A temporary hack to remove %CF = %CF{7} when 7 isn't a SUBFLAGS
@@ -1644,25 +1873,21 @@ void UserProc::remUnusedStmtEtc() {
 
     // Only remove unused statements after decompiling as much as possible of the proc
     // Remove unused statements
-    RefCounter refCounts; // The map
-    // Count the references first
-    countRefs(refCounts);
-    // Now remove any that have no used
-    if (!Boomerang::get()->noRemoveNull)
-        remUnusedStmtEtc(refCounts);
+    if (!getContext()->noRemoveNull)
+        remUnusedStatements();
 
     // Remove null statements
-    if (!Boomerang::get()->noRemoveNull)
+    if (!getContext()->noRemoveNull)
         removeNullStatements();
 
     printXML();
-    if (!Boomerang::get()->noRemoveNull) {
+    if (!getContext()->noRemoveNull) {
         debugPrintAll("after removing unused and null statements pass 1");
     }
-    Boomerang::get()->alertDecompileAfterRemoveStmts(this, 1);
+    getContext()->alertDecompileAfterRemoveStmts(this, 1);
 
     findFinalParameters();
-    if (!Boomerang::get()->noParameterNames) {
+    if (!getContext()->noParameterNames) {
         // Replace the existing temporary parameters with the final ones:
         // mapExpressionsToParameters();
         addParameterSymbols();
@@ -1686,88 +1911,67 @@ void UserProc::remUnusedStmtEtc() {
 
     debugPrintAll("after remove unused statements etc");
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after final");
+    getContext()->alertDecompileDebugPoint(this, "after final");
+}
+
+//! True if s is an assignment that may be removed when nothing uses it
+static bool isRemovableIfUnused(UserProc *proc, Instruction *s) {
+    if (!s->isAssignment())
+        return false; // Never delete a statement other than an assignment (e.g. nothing "uses" a Jcond)
+    Exp *asLeft = ((Assignment *)s)->getLeft();
+    // If depth < 0, consider all depths
+    // if (asLeft && depth >= 0 && asLeft->getMemDepth() > depth)
+    //    return false;
+    if (asLeft && asLeft->getOper() == opGlobal)
+        return false; // assignments to globals must always be kept
+    // If it's a memof and renameable it can still be deleted
+    if (asLeft->getOper() == opMemOf && !proc->canRename(asLeft))
+        return false; // Assignments to memof-anything-but-local must always be kept.
+    if (asLeft->getOper() == opMemberAccess || asLeft->getOper() == opArrayIndex)
+        return false; // can't say with these; conservatively never remove them
+    return true;
 }
 
-void UserProc::remUnusedStmtEtc(RefCounter &refCounts) {
+void UserProc::remUnusedStatements() {
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "before remUnusedStmtEtc");
+    getContext()->alertDecompileDebugPoint(this, "before remUnusedStmtEtc");
 
+    // Start with the statements nothing uses; removing one of them can leave the statements it used unused in turn,
+    // and those go on the end of the work list. A statement runs out of users at most once, so this is linear.
+    // The use lists count statements, not refs: two refs to the same def from one statement are one use
+    buildUseLists();
     StatementList stmts;
     getStatements(stmts);
-    bool change;
-    do { // FIXME: check if this is ever needed
-        change = false;
-        StatementList::iterator ll = stmts.begin();
-        while (ll != stmts.end()) {
-            Instruction *s = *ll;
-            if (!s->isAssignment()) {
-                // Never delete a statement other than an assignment (e.g. nothing "uses" a Jcond)
-                ll++;
-                continue;
-            }
-            Assignment *as = (Assignment *)s;
-            Exp *asLeft = as->getLeft();
-            // If depth < 0, consider all depths
-            // if (asLeft && depth >= 0 && asLeft->getMemDepth() > depth) {
-            //    ll++;
-            //    continue;
-            //}
-            if (asLeft && asLeft->getOper() == opGlobal) {
-                // assignments to globals must always be kept
-                ll++;
-                continue;
-            }
-            // If it's a memof and renameable it can still be deleted
-            if (asLeft->getOper() == opMemOf && !canRename(asLeft)) {
-                // Assignments to memof-anything-but-local must always be kept.
-                ll++;
-                continue;
-            }
-            if (asLeft->getOper() == opMemberAccess || asLeft->getOper() == opArrayIndex) {
-                // can't say with these; conservatively never remove them
-                ll++;
+    std::deque<Instruction *> work;
+    for (Instruction *s : stmts) {
+        if (s->getUsers().empty())
+            work.push_back(s);
+    }
+    while (!work.empty()) {
+        Instruction *s = work.front();
+        work.pop_front();
+        if (!isRemovableIfUnused(this, s))
+            continue;
+        std::vector<Instruction *> used(s->getUsedDefs());
+        if (DEBUG_UNUSED)
+            LOG << "removing unused statement " << s->getNumber() << " " << s << "\n";
+        removeStatement(s); // Takes s off the users of what it used
+        for (Instruction *d : used) {
+            if (!d->getUsers().empty())
                 continue;
-            }
-            if (refCounts.find(s) == refCounts.end() || refCounts[s] == 0) { // Care not to insert unnecessarily
-                // First adjust the counts, due to statements only referenced by statements that are themselves unused.
-                // Need to be careful not to count two refs to the same def as two; refCounts is a count of the number
-                // of statements that use a definition, not the total number of refs
-                InstructionSet stmtsRefdByUnused;
-                LocationSet components;
-                s->addUsedLocs(components, false); // Second parameter false to ignore uses in collectors
-                LocationSet::iterator cc;
-                for (cc = components.begin(); cc != components.end(); cc++) {
-                    if ((*cc)->isSubscript()) {
-                        stmtsRefdByUnused.insert(((RefExp *)*cc)->getDef());
-                    }
-                }
-                InstructionSet::iterator dd;
-                for (dd = stmtsRefdByUnused.begin(); dd != stmtsRefdByUnused.end(); dd++) {
-                    if (*dd == nullptr)
-                        continue;
-                    if (DEBUG_UNUSED)
-                        LOG << "decrementing ref count of " << (*dd)->getNumber() << " because " << s->getNumber()
-                            << " is unused\n";
-                    refCounts[*dd]--;
-                }
-                if (DEBUG_UNUSED)
-                    LOG << "removing unused statement " << s->getNumber() << " " << s << "\n";
-                removeStatement(s);
-                ll = stmts.erase(ll); // So we don't try to re-remove it
-                change = true;
-                continue; // Don't call getNext this time
-            }
-            ll++;
+            if (DEBUG_UNUSED)
+                LOG << "statement " << d->getNumber() << " is unused now that " << s->getNumber() << " is removed\n";
+            work.push_back(d);
         }
-    } while (change);
+    }
+    clearUseLists();
     // Recaluclate at least the livenesses. Example: first call to printf in test/pentium/fromssa2, eax used only in a
     // removed statement, so liveness in the call needs to be removed
     removeCallLiveness();  // Kill all existing livenesses
     doRenameBlockVars(-2); // Recalculate new livenesses
     setStatus(PROC_FINAL); // Now fully decompiled (apart from one final pass, and transforming out of SSA form)
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after remUnusedStmtEtc");
+    getContext()->alertDecompileDebugPoint(this, "after remUnusedStmtEtc");
 }
 /// Analyse the whole group of procedures for conditional preserveds, and update till no change.
 /// Also finalise the whole group.
@@ -1805,7 +2009,7 @@ void UserProc::recursionGroupAnalysis(ProcList *path, int indent) {
     ProcSet::iterator curp;
     for (curp = cycleGrp->begin(); curp != cycleGrp->end(); ++curp) {
         (*curp)->setStatus(PROC_INCYCLE); // So the calls are treated as childless
-        Boomerang::get()->alertDecompiling(*curp);
+        getContext()->alertDecompiling(*curp);
         (*curp)->initialiseDecompile(); // Sort the CFG, number statements, etc
         (*curp)->earlyDecompile();
     }
@@ -1841,7 +2045,7 @@ void UserProc::recursionGroupAnalysis(ProcList *path, int indent) {
         }
     }
     LOG_VERBOSE(1) << "=== end recursion group analysis ===\n";
-    Boomerang::get()->alertEndDecompile(this);
+    getContext()->alertEndDecompile(this);
 }
 
 /***************************************************************************/ /**
@@ -1861,65 +2065,108 @@ void UserProc::updateCalls() {
   *
   * \brief Look for short circuit branching
   *
+  * Driven by a work list of the BBs ending in a branch: when a branch takes over the one it falls to, its BB is
+  * looked at again (it may now fall to another such branch), and so are its predecessors, whose patterns depend on
+  * its out edges. So chains of conditions merge in one pass, and the work stays proportional to the branches and the
+  * merges. The BBs changed are left for the next Cfg::compressCfg() (see Cfg::touchBB()).
+  *
   ******************************************************************************/
 void UserProc::branchAnalysis() {
-    Boomerang::get()->alertDecompileDebugPoint(this, "before branch analysis.");
-
-    StatementList stmts;
-    getStatements(stmts);
-    for (auto stmt : stmts) {
-
-        if (stmt->isBranch()) {
-            BranchStatement *branch = (BranchStatement *)stmt;
-            if (branch->getFallBB() && branch->getTakenBB()) {
-                StatementList fallstmts;
-                branch->getFallBB()->getStatements(fallstmts);
-                if (fallstmts.size() == 1 && (*fallstmts.begin())->isBranch()) {
-                    BranchStatement *fallto = (BranchStatement *)*fallstmts.begin();
-                    //   branch to A if cond1
-                    //   branch to B if cond2
-                    // A: something
-                    // B:
-                    // ->
-                    //   branch to B if !cond1 && cond2
-                    // A: something
-                    // B:
-                    if (fallto->getFallBB() == branch->getTakenBB() && fallto->getBB()->getNumInEdges() == 1) {
-                        branch->setFallBB(fallto->getFallBB());
-                        branch->setTakenBB(fallto->getTakenBB());
-                        branch->setDest(fallto->getFixedDest());
-                        Exp *cond =
-                            Binary::get(opAnd, new Unary(opNot, branch->getCondExpr()), fallto->getCondExpr()->clone());
-                        branch->setCondExpr(cond->simplify());
-                        assert(fallto->getBB()->getNumInEdges() == 0);
-                        fallto->getBB()->deleteEdge(fallto->getBB()->getOutEdge(0));
-                        fallto->getBB()->deleteEdge(fallto->getBB()->getOutEdge(0));
-                        assert(fallto->getBB()->getNumOutEdges() == 0);
-                        cfg->removeBB(fallto->getBB());
-                    }
-                    //   branch to B if cond1
-                    //   branch to B if cond2
-                    // A: something
-                    // B:
-                    // ->
-                    //   branch to B if cond1 || cond2
-                    // A: something
-                    // B:
-                    if (fallto->getTakenBB() == branch->getTakenBB() && fallto->getBB()->getNumInEdges() == 1) {
-                        branch->setFallBB(fallto->getFallBB());
-                        branch->setCondExpr(Binary::get(opOr, branch->getCondExpr(), fallto->getCondExpr()->clone()));
-                        assert(fallto->getBB()->getNumInEdges() == 0);
-                        fallto->getBB()->deleteEdge(fallto->getBB()->getOutEdge(0));
-                        fallto->getBB()->deleteEdge(fallto->getBB()->getOutEdge(0));
-                        assert(fallto->getBB()->getNumOutEdges() == 0);
-                        cfg->removeBB(fallto->getBB());
-                    }
-                }
-            }
+    getContext()->alertDecompileDebugPoint(this, "before branch analysis.");
+
+    std::vector<BasicBlock *> work;
+    std::vector<bool> queued, removed; // By BasicBlock::getIndex()
+    auto mark = [](std::vector<bool> &v, BasicBlock *bb) {
+        size_t idx = bb->getIndex();
+        if (idx >= v.size())
+            v.resize(idx + 1, false);
+        bool was = v[idx];
+        v[idx] = true;
+        return was;
+    };
+    auto isMarked = [](const std::vector<bool> &v, BasicBlock *bb) {
+        size_t idx = bb->getIndex();
+        return idx < v.size() && v[idx];
+    };
+    auto enqueue = [&](BasicBlock *bb) {
+        if (!isMarked(removed, bb) && !mark(queued, bb))
+            work.push_back(bb);
+    };
+    StatementList branches;
+    stmtTable.getOfKind(STMT_BRANCH, branches);
+    // Taken from the back, so the first branches are looked at first
+    for (auto it = branches.rbegin(); it != branches.rend(); ++it) {
+        if ((*it)->getBB())
+            enqueue((*it)->getBB());
+    }
+    // Merge the branch that fallto's BB holds into branch, whose BB it is the only successor of
+    auto absorb = [&](BranchStatement *branch, BranchStatement *fallto) {
+        BasicBlock *gone = fallto->getBB();
+        assert(gone->getNumInEdges() == 0);
+        gone->deleteEdge(gone->getOutEdge(0));
+        gone->deleteEdge(gone->getOutEdge(0));
+        assert(gone->getNumOutEdges() == 0);
+        mark(removed, gone);
+        cfg->removeBB(gone);
+        BasicBlock *bb = branch->getBB();
+        cfg->touchBB(bb);
+        for (BasicBlock *succ : bb->getOutEdges())
+            cfg->touchBB(succ);
+        enqueue(bb);
+        for (BasicBlock *pred : bb->getInEdges())
+            enqueue(pred);
+    };
+    while (!work.empty()) {
+        BasicBlock *bb = work.back();
+        work.pop_back();
+        queued[bb->getIndex()] = false;
+        if (bb->getRTLs() == nullptr || bb->getRTLs()->empty())
+            continue;
+        Instruction *last = bb->getRTLs()->back()->getHlStmt();
+        if (last == nullptr || !last->isBranch())
+            continue;
+        BranchStatement *branch = (BranchStatement *)last;
+        if (!branch->getFallBB() || !branch->getTakenBB())
+            continue;
+        StatementList fallstmts;
+        branch->getFallBB()->getStatements(fallstmts);
+        if (fallstmts.size() != 1 || !(*fallstmts.begin())->isBranch())
+            continue;
+        BranchStatement *fallto = (BranchStatement *)*fallstmts.begin();
+        if (fallto->getBB()->getNumInEdges() != 1)
+            continue;
+        //   branch to A if cond1
+        //   branch to B if cond2
+        // A: something
+        // B:
+        // ->
+        //   branch to B if !cond1 && cond2
+        // A: something
+        // B:
+        if (fallto->getFallBB() == branch->getTakenBB()) {
+            branch->setFallBB(fallto->getFallBB());
+            branch->setTakenBB(fallto->getTakenBB());
+            branch->setDest(fallto->getFixedDest());
+            Exp *cond = Binary::get(opAnd, new Unary(opNot, branch->getCondExpr()), fallto->getCondExpr()->clone());
+            branch->setCondExpr(cond->simplify());
+            absorb(branch, fallto);
+        }
+        //   branch to B if cond1
+        //   branch to B if cond2
+        // A: something
+        // B:
+        // ->
+        //   branch to B if cond1 || cond2
+        // A: something
+        // B:
+        else if (fallto->getTakenBB() == branch->getTakenBB()) {
+            branch->setFallBB(fallto->getFallBB());
+            branch->setCondExpr(Binary::get(opOr, branch->getCondExpr(), fallto->getCondExpr()->clone()));
+            absorb(branch, fallto);
         }
     }
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after branch analysis.");
+    getContext()->alertDecompileDebugPoint(this, "after branch analysis.");
 }
 
 /***************************************************************************/ /**
@@ -1932,11 +2179,8 @@ void UserProc::fixUglyBranches() {
         LOG << "### fixUglyBranches for " << getName() << " ###\n";
 
     StatementList stmts;
-    getStatements(stmts);
+    stmtTable.getOfKind(STMT_BRANCH, stmts);
     for (auto stmt : stmts) {
-
-        if (!stmt->isBranch())
-            continue;
         Exp *hl = ((BranchStatement *)stmt)->getCondExpr();
         // of the form: x{n} - 1 >= 0
         if (hl && hl->getOper() == opGtrEq && hl->getSubExp2()->isIntConst() &&
@@ -1975,12 +2219,32 @@ bool UserProc::doRenameBlockVars(int pass, bool clearStacks) {
     return b;
 }
 
+namespace {
+/**
+ * Statements don't change while proofs are being done, so the proof caches only need checking when the outermost
+ * proof (or series of proofs, e.g. in findPreserveds()) starts. Queries to other procs of the recursion group are nested
+ * in it, and the group is validated along with the proc.
+ */
+class ProofSession {
+    static int depth;
+
+  public:
+    explicit ProofSession(UserProc *proc) {
+        if (depth++ == 0)
+            proc->validateProofs();
+    }
+    ~ProofSession() { --depth; }
+};
+int ProofSession::depth = 0;
+}
+
 /***************************************************************************/ /**
   *
   * \brief Preservations only for the stack pointer
   *
   ******************************************************************************/
 void UserProc::findSpPreservation() {
+    ProofSession session(this);
     if (VERBOSE)
         LOG << "finding stack pointer preservation for " << getName() << "\n";
 
@@ -1988,6 +2252,7 @@ void UserProc::findSpPreservation() {
     // Note: need this non-virtual version most of the time, since nothing proved yet
     int sp = signature->getStackRegister(prog);
 
+    std::map<PhiAssign *, Exp *> phiCache; // Shared by the attempts, as in proveAll()
     for (int n = 0; n < 2; n++) {
         // may need to do multiple times due to dependencies FIXME: efficiency! Needed any more?
 
@@ -1997,7 +2262,8 @@ void UserProc::findSpPreservation() {
             if (DEBUG_PROOF)
                 LOG << "attempting to prove sp = sp + " << p * 4 << " for " << getName() << "\n";
             stdsp = prove(
-                Binary::get(opEquals, Location::regOf(sp), Binary::get(opPlus, Location::regOf(sp), new Const(p * 4))));
+                Binary::get(opEquals, Location::regOf(sp), Binary::get(opPlus, Location::regOf(sp), new Const(p * 4))),
+                false, &phiCache);
         }
     }
 
@@ -2014,31 +2280,39 @@ void UserProc::findSpPreservation() {
   *
   ******************************************************************************/
 void UserProc::findPreserveds() {
+    StatScope stats(this, "findPreserveds");
     std::set<Exp *> removes;
+    ProofSession session(this);
 
     if (VERBOSE)
         LOG << "finding preserveds for " << getName() << "\n";
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "before finding preserveds");
+    getContext()->alertDecompileDebugPoint(this, "before finding preserveds");
 
     if (theReturnStatement == nullptr) {
         if (DEBUG_PROOF)
             LOG << "can't find preservations as there is no return statement!\n";
-        Boomerang::get()->alertDecompileDebugPoint(this, "after finding preserveds (no return)");
+        getContext()->alertDecompileDebugPoint(this, "after finding preserveds (no return)");
         return;
     }
 
-    // prove preservation for all modifieds in the return statement
+    // prove preservation for all modifieds in the return statement, as one series; a draft only tries the stack
+    // pointer, leaving the other registers as returns
     ReturnStatement::iterator mm;
     StatementList &modifieds = theReturnStatement->getModifieds();
+    std::vector<Exp *> equations;
+    int sp = signature->getStackRegister(prog);
     for (mm = modifieds.begin(); mm != modifieds.end(); ++mm) {
         Exp *lhs = ((Assignment *)*mm)->getLeft();
-        Exp *equation = Binary::get(opEquals, lhs, lhs);
-        if (DEBUG_PROOF)
-            LOG << "attempting to prove " << equation << " is preserved by " << getName() << "\n";
-        if (prove(equation)) {
-            removes.insert(equation);
-        }
+        if (getContext()->draft && !lhs->isRegN(sp))
+            continue;
+        equations.push_back(Binary::get(opEquals, lhs, lhs));
+    }
+    std::vector<bool> preserved;
+    proveAll(equations, preserved);
+    for (size_t i = 0; i < equations.size(); i++) {
+        if (preserved[i])
+            removes.insert(equations[i]);
     }
 
     if (DEBUG_PROOF) {
@@ -2065,7 +2339,7 @@ void UserProc::findPreserveds() {
         theReturnStatement->removeModified(lhs);
     }
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after finding preserveds");
+    getContext()->alertDecompileDebugPoint(this, "after finding preserveds");
 }
 
 void UserProc::removeSpAssignsIfPossible() {
@@ -2096,7 +2370,7 @@ void UserProc::removeSpAssignsIfPossible() {
     if (!foundone)
         return;
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "before removing stack pointer assigns.");
+    getContext()->alertDecompileDebugPoint(this, "before removing stack pointer assigns.");
 
     for (auto &stmt : stmts)
         if ((stmt)->isAssign()) {
@@ -2106,7 +2380,7 @@ void UserProc::removeSpAssignsIfPossible() {
             }
         }
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after removing stack pointer assigns.");
+    getContext()->alertDecompileDebugPoint(this, "after removing stack pointer assigns.");
 }
 
 void UserProc::removeMatchingAssignsIfPossible(Exp *e) {
@@ -2143,7 +2417,7 @@ void UserProc::removeMatchingAssignsIfPossible(Exp *e) {
     QString res_str;
     QTextStream str(&res_str);
     str << "before removing matching assigns (" << e << ").";
-    Boomerang::get()->alertDecompileDebugPoint(this, qPrintable(res_str));
+    getContext()->alertDecompileDebugPoint(this, qPrintable(res_str));
     LOG_VERBOSE(1) << res_str << "\n";
 
     for (auto &stmt : stmts)
@@ -2158,7 +2432,7 @@ void UserProc::removeMatchingAssignsIfPossible(Exp *e) {
         }
     res_str.clear();
     str << "after removing matching assigns (" << e << ").";
-    Boomerang::get()->alertDecompileDebugPoint(this, qPrintable(res_str));
+    getContext()->alertDecompileDebugPoint(this, qPrintable(res_str));
     LOG << res_str << "\n";
 }
 
@@ -2235,9 +2509,10 @@ static Exp *regOfWild = RefExp::get(Location::regOf(new Terminal(opWildIntConst)
 #define DEBUG_PARAMS 1
 void UserProc::findFinalParameters() {
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "before find final parameters.");
+    getContext()->alertDecompileDebugPoint(this, "before find final parameters.");
 
     parameters.clear();
+    summaryChanged();
 
     if (signature->isForced()) {
         // Copy from signature
@@ -2268,8 +2543,12 @@ void UserProc::findFinalParameters() {
 
     //    int sp = signature->getStackRegister();
     signature->setNumParams(0); // Clear any old ideas
+    // The parameters are what the proc reads before defining it: the locations live below the implicit assignments
+    LocationSet live;
+    cfg->findLiveAtEntry(live);
     StatementList stmts;
-    getStatements(stmts);
+    if (cfg->getEntryBB())
+        cfg->getEntryBB()->getStatements(stmts);
 
     StatementList::iterator it;
     for (it = stmts.begin(); it != stmts.end(); ++it) {
@@ -2280,6 +2559,11 @@ void UserProc::findFinalParameters() {
             // Note: phis can get converted to assignments, but I hope that this is only later on: check this!
             break; // Stop after reading all implicit assignments
         Exp *e = ((ImplicitAssign *)s)->getLeft();
+        if (!live.exists(RefExp::get(e, s))) {
+            if (VERBOSE || DEBUG_PARAMS)
+                LOG << "ignoring unused " << e << "\n";
+            continue;
+        }
         if (signature->findParam(e) == -1) {
             if (VERBOSE || DEBUG_PARAMS)
                 LOG << "potential param " << e << "\n";
@@ -2348,7 +2632,7 @@ void UserProc::findFinalParameters() {
         }
     }
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after find final parameters.");
+    getContext()->alertDecompileDebugPoint(this, "after find final parameters.");
 }
 
 #if 0 // FIXME: not currently used; do we want this any more?
@@ -2442,6 +2726,7 @@ void Function::removeParameter(Exp *e) {
     int n = signature->findParam(e);
     if (n != -1) {
         signature->removeParameter(n);
+        summaryChanged();
         for (auto const &elem : callerSet) {
             if (DEBUG_UNUSED)
                 LOG << "removing argument " << e << " in pos " << n << " from " << elem << "\n";
@@ -2450,7 +2735,10 @@ void Function::removeParameter(Exp *e) {
     }
 }
 
-void Function::removeReturn(Exp *e) { signature->removeReturn(e); }
+void Function::removeReturn(Exp *e) {
+    signature->removeReturn(e);
+    summaryChanged();
+}
 
 //! Add the parameter to the signature
 void UserProc::addParameter(Exp *e, SharedType ty) {
@@ -2458,20 +2746,18 @@ void UserProc::addParameter(Exp *e, SharedType ty) {
     removeParameter(e);
 
     signature->addParameter(e, ty);
+    summaryChanged();
 }
 
-void UserProc::processFloatConstants() {
-    StatementList stmts;
-    getStatements(stmts);
-
-    static Ternary match(opFsize, Terminal::get(opWild), Terminal::get(opWild), Location::memOf(Terminal::get(opWild)));
-
-    StatementList::iterator it;
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
+// Search pattern for processFloatConstants(). The patterns in this file are at file scope rather than function local
+// statics, so that they are never allocated in the arena of the proc that happens to use them first
+static Ternary fsizeOfMemWild(opFsize, Terminal::get(opWild), Terminal::get(opWild),
+                              Location::memOf(Terminal::get(opWild)));
 
+void UserProc::processFloatConstants() {
+    for (Instruction *s : statements()) {
         std::list<Exp *> results;
-        s->searchAll(match, results);
+        s->searchAll(fsizeOfMemWild, results);
         for (auto &result : results) {
             Ternary *fsize = (Ternary *)result;
             if (fsize->getSubExp3()->getOper() == opMemOf &&
@@ -2503,6 +2789,17 @@ void UserProc::addParameterSymbols() {
     }
 }
 
+//! If \a e is a stack slot m[reg{..} - K], set \a n to -K and return true. The register isn't checked
+static bool stackSlotOffset(const Exp *e, int &n) {
+    if (!e->isMemOf())
+        return false;
+    const Exp *addr = e->getSubExp1();
+    if (addr->getOper() != opMinus || !addr->getSubExp1()->isSubscript() || !addr->getSubExp2()->isIntConst())
+        return false;
+    n = -((const Const *)addr->getSubExp2())->getInt();
+    return true;
+}
+
 // Return an expression that is equivilent to e in terms of symbols. Creates new symbols as needed.
 /**
  * Return an expression that is equivilent to e in terms of local variables.  Creates new locals as needed.
@@ -2511,29 +2808,29 @@ Exp *UserProc::getSymbolExp(Exp *le, SharedType ty, bool lastPass) {
     Exp *e = nullptr;
 
     // check for references to the middle of a local
-    if (le->isMemOf() && le->getSubExp1()->getOper() == opMinus && le->getSubExp1()->getSubExp1()->isSubscript() &&
-        le->getSubExp1()->getSubExp1()->getSubExp1()->isRegN(signature->getStackRegister()) &&
-        le->getSubExp1()->getSubExp2()->isIntConst()) {
-        for (auto &elem : symbolMap) {
-            if (!(elem).second->isLocal())
+    int m, sp;
+    if (stackSlotOffset(le, m) &&
+        le->getSubExp1()->getSubExp1()->getSubExp1()->isRegN(sp = signature->getStackRegister())) {
+        // The candidates are the stack slots below le, nearest first, until they are too far away to contain it
+        auto ss = symbolsByStackOffset.lower_bound(m);
+        while (ss != symbolsByStackOffset.begin()) {
+            --ss;
+            int n = ss->first;
+            if ((size_t)(m - n) * 8 >= maxLocalSize)
+                break;
+            SymbolMap::iterator elem = ss->second;
+            const Exp *loc = elem->first;
+            if (!elem->second->isLocal() || !loc->getSubExp1()->getSubExp1()->getSubExp1()->isRegN(sp))
                 continue;
-            QString nam = ((Const *)(elem).second->getSubExp1())->getStr();
-            if (locals.find(nam) == locals.end())
+            QString nam = ((Const *)elem->second->getSubExp1())->getStr();
+            auto lt = locals.find(nam);
+            if (lt == locals.end())
                 continue;
-            SharedType lty = locals[nam];
-            const Exp *loc = (elem).first;
-            if (loc->isMemOf() && loc->getSubExp1()->getOper() == opMinus &&
-                    loc->getSubExp1()->getSubExp1()->isSubscript() &&
-                    loc->getSubExp1()->getSubExp1()->getSubExp1()->isRegN(signature->getStackRegister()) &&
-                    loc->getSubExp1()->getSubExp2()->isIntConst()) {
-                int n = -((const Const *)loc->getSubExp1()->getSubExp2())->getInt();
-                int m = -((Const *)le->getSubExp1()->getSubExp2())->getInt();
-                if (m > n && m < n + (int)(lty->getSize() / 8)) {
-                    e = Location::memOf(
-                                Binary::get(opPlus, new Unary(opAddrOf, (elem).second->clone()), new Const(m - n)));
-                    LOG_VERBOSE(1) << "seems " << le << " is in the middle of " << loc << " returning " << e << "\n";
-                    return e;
-                }
+            SharedType lty = lt->second;
+            if (m < n + (int)(lty->getSize() / 8)) {
+                e = Location::memOf(Binary::get(opPlus, new Unary(opAddrOf, elem->second->clone()), new Const(m - n)));
+                LOG_VERBOSE(1) << "seems " << le << " is in the middle of " << loc << " returning " << e << "\n";
+                return e;
             }
         }
     }
@@ -2590,15 +2887,24 @@ Exp *UserProc::getSymbolExp(Exp *le, SharedType ty, bool lastPass) {
     return e;
 }
 
+// Search patterns for mapExpressionsToLocals()
+static Exp *sp_location = Location::regOf(0);
+// parse("[*] + sp{0}")
+static Binary wildPlusSp(opPlus, Terminal::get(opWild), RefExp::get(sp_location, nullptr));
+// l = m[(sp{0} + WILD1) - K2]
+static Const sp_const(0);
+static Location sp_loc(opRegOf, &sp_const, nullptr);
+static Location query_f(opMemOf,
+                        Binary::get(opMinus, Binary::get(opPlus, RefExp::get(&sp_loc, nullptr), Terminal::get(opWild)),
+                                    Terminal::get(opWildIntConst)),
+                        nullptr);
+
 // Not used with DFA Type Analysis; the equivalent thing happens in mapLocalsAndParams() now
 void UserProc::mapExpressionsToLocals(bool lastPass) {
-    static Exp *sp_location = Location::regOf(0);
-    // parse("[*] + sp{0}")
-    static Binary nn(opPlus, Terminal::get(opWild), RefExp::get(sp_location, nullptr));
     StatementList stmts;
     getStatements(stmts);
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "before mapping expressions to locals");
+    getContext()->alertDecompileDebugPoint(this, "before mapping expressions to locals");
 
     if (VERBOSE) {
         LOG << "mapping expressions to locals for " << getName();
@@ -2652,14 +2958,14 @@ void UserProc::mapExpressionsToLocals(bool lastPass) {
         }
     }
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after processing locals in calls");
+    getContext()->alertDecompileDebugPoint(this, "after processing locals in calls");
 
     // normalise sp usage (turn WILD + sp{0} into sp{0} + WILD)
     static_cast<Const *>(sp_location->getSubExp1())->setInt(sp); // set to search sp value
     for (it = stmts.begin(); it != stmts.end(); it++) {
         Instruction *s = *it;
         std::list<Exp *> results;
-        s->searchAll(nn, results);
+        s->searchAll(wildPlusSp, results);
         for (auto &result : results) {
             Exp *wild = (result)->getSubExp1();
             (result)->setSubExp1((result)->getSubExp2());
@@ -2670,17 +2976,12 @@ void UserProc::mapExpressionsToLocals(bool lastPass) {
     // FIXME: this is probably part of the ADHOC TA
     // look for array locals
     // l = m[(sp{0} + WILD1) - K2]
-    static Const sp_const(0);
-    static Location sp_loc(opRegOf, &sp_const, nullptr);
-    static Location query_f(
-        opMemOf, Binary::get(opMinus, Binary::get(opPlus, RefExp::get(&sp_loc, nullptr), Terminal::get(opWild)),
-                             Terminal::get(opWildIntConst)),
-        nullptr);
     for (it = stmts.begin(); it != stmts.end(); it++) {
         Instruction *s = *it;
         std::list<Exp *> results;
         sp_const.setInt(sp);
         s->searchAll(query_f, results);
+        ExpReplaceMap arrays;
         for (Exp *result : results) {
             // arr = m[sp{0} - K2]
             Exp *arr = Location::memOf(Binary::get(opMinus, RefExp::get(Location::regOf(sp), nullptr),
@@ -2703,11 +3004,13 @@ void UserProc::mapExpressionsToLocals(bool lastPass) {
             TypedExp *actual_replacer = new TypedExp(ArrayType::get(base, n / (base->getSize() / 8)), replace);
             if (VERBOSE)
                 LOG << "replacing " << result << " with " << actual_replacer << " in " << s << "\n";
-            s->searchAndReplace(*result, actual_replacer);
+            arrays.emplace(result, actual_replacer);
         }
+        if (!arrays.empty())
+            s->searchAndReplaceAll(arrays);
     }
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after processing array locals");
+    getContext()->alertDecompileDebugPoint(this, "after processing array locals");
 
     // Stack offsets for local variables could be negative (most machines), positive (PA/RISC), or both (SPARC)
     if (signature->isLocalOffsetNegative())
@@ -2718,7 +3021,7 @@ void UserProc::mapExpressionsToLocals(bool lastPass) {
     if (signature->isLocalOffsetPositive() && signature->isLocalOffsetNegative())
         searchRegularLocals(opWild, lastPass, sp, stmts);
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after mapping expressions to locals");
+    getContext()->alertDecompileDebugPoint(this, "after mapping expressions to locals");
 }
 
 void UserProc::searchRegularLocals(OPER minusOrPlus, bool lastPass, int sp, StatementList &stmts) {
@@ -2771,49 +3074,109 @@ bool UserProc::removeNullStatements() {
     return change;
 }
 
+//! Record s as a user of each definition that it refers to
+static void addToUsers(Instruction *s, std::map<Instruction *, std::vector<Instruction *>> &users) {
+    LocationSet refs;
+    s->addUsedLocs(refs, true); // Including the uses in collectors, as propagateTo() does
+    for (Exp *r : refs) {
+        if (!r->isSubscript())
+            continue;
+        Instruction *def = ((RefExp *)r)->getDef();
+        if (def)
+            users[def].push_back(s);
+    }
+}
+
+//! After s has changed, queue its users that have been propagated into already, and note what s refers to now
+static void queueUsers(Instruction *s, std::map<Instruction *, std::vector<Instruction *>> &users,
+                       const InstructionBitSet &visited, InstructionBitSet &queued, std::deque<Instruction *> &work) {
+    addToUsers(s, users);
+    auto uu = users.find(s);
+    if (uu == users.end())
+        return;
+    for (Instruction *u : uu->second) {
+        if (visited.exists(u) && !queued.exists(u)) {
+            queued.insert(u);
+            work.push_back(u);
+        }
+    }
+}
+
 // Propagate statements, but don't remove
 // Return true if change; set convert if an indirect call is converted to direct (else clear)
 /// Propagate statemtents; return true if change; set convert if an indirect call is converted to direct
 /// (else clear)
 bool UserProc::propagateStatements(bool &convert, int pass) {
+    StatScope stats(this, "propagation");
     if (VERBOSE)
         LOG << "--- begin propagating statements pass " << pass << " ---\n";
-    StatementList stmts;
-    getStatements(stmts);
+    StatementRange stmts = statements();
+    size_t numStmts = 0;
     // propagate any statements that can be
-    StatementList::iterator it;
     // Find the locations that are used by a live, dominating phi-function
     LocationSet usedByDomPhi;
     findLiveAtDomPhi(usedByDomPhi);
     // Next pass: count the number of times each assignment LHS would be propagated somewhere
     std::map<Exp *, int, lessExpStar> destCounts;
     // Also maintain a set of locations which are used by phi statements
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
+    for (Instruction *s : stmts) {
+        numStmts++;
         ExpDestCounter edc(destCounts);
         StmtDestCounter sdc(&edc);
         s->accept(&sdc);
     }
+    if (propGrowthLeft < 0)
+        propGrowthLeft = (long)numStmts * getContext()->propGrowthBudget;
 #if USE_DOMINANCE_NUMS
     // A third pass for dominance numbers
     setDominanceNumbers();
 #endif
     // A fourth pass to propagate only the flags (these must be propagated even if it results in extra locals)
     bool change = false;
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
+    for (Instruction *s : stmts) {
         if (s->isPhi())
             continue;
         change |= s->propagateFlagsTo();
     }
-    // Finally the actual propagation
+    // Out of budget: the flags are all that must be propagated
+    if (!takeBudgetStep()) {
+        convert = false;
+        propagateToCollector();
+        return change;
+    }
+    // Finally the actual propagation: one sweep over all the statements, then a work list. When a statement changes,
+    // the users of it that were passed already may now accept more from it, so they are propagated into again, and so
+    // on for their users if they change. Only statements whose definitions changed are revisited.
+    std::map<Instruction *, std::vector<Instruction *>> users;
+    for (Instruction *s : stmts) {
+        if (!s->isPhi())
+            addToUsers(s, users);
+    }
+    InstructionBitSet visited(stmtTable), queued(stmtTable);
+    std::deque<Instruction *> work;
     convert = false;
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
+    for (Instruction *s : stmts) {
         if (s->isPhi())
             continue;
-        change |= s->propagateTo(convert, &destCounts, &usedByDomPhi);
-    }
+        visited.insert(s);
+        if (!s->propagateTo(convert, &destCounts, &usedByDomPhi))
+            continue;
+        change = true;
+        queueUsers(s, users, visited, queued, work);
+    }
+    // Every statement that changes passes the work on to its users, so make sure that this stops
+    size_t maxRevisits = 10 * numStmts;
+    size_t revisits = 0;
+    while (!work.empty() && maxRevisits-- > 0 && !isOverBudget()) {
+        Instruction *s = work.front();
+        work.pop_front();
+        queued.remove(s);
+        revisits++;
+        if (s->propagateTo(convert, &destCounts, &usedByDomPhi))
+            queueUsers(s, users, visited, queued, work);
+    }
+    DecompileStats::get().count(this, "propagation", "statements", numStmts);
+    DecompileStats::get().count(this, "propagation", "revisits", revisits);
     simplify();
     propagateToCollector();
     LOG_VERBOSE(1) << "=== end propagating statements at pass " << pass << " ===\n";
@@ -2821,18 +3184,7 @@ bool UserProc::propagateStatements(bool &convert, int pass) {
 } // propagateStatements
 
 Instruction *UserProc::getStmtAtLex(unsigned int begin, unsigned int end) {
-    StatementList stmts;
-    getStatements(stmts);
-
-    unsigned int lowest = begin;
-    Instruction *loweststmt = nullptr;
-    for (auto &stmt : stmts)
-        if (begin >= (stmt)->getLexBegin() && begin <= lowest && begin <= (stmt)->getLexEnd() &&
-            (end == (unsigned)-1 || end < (stmt)->getLexEnd())) {
-            loweststmt = (stmt);
-            lowest = (stmt)->getLexBegin();
-        }
-    return loweststmt;
+    return stmtTable.findAtLex(begin, end);
 }
 /// promote the signature if possible
 void UserProc::promoteSignature() { signature = signature->promote(this); }
@@ -2865,7 +3217,7 @@ Exp *UserProc::newLocal(SharedType ty, Exp &e, char *nam /* = nullptr */) {
         name = newLocalName(e);
     else
         name = nam; // Use provided name
-    locals[name] = ty;
+    setLocal(name, ty);
     if (ty == nullptr) {
         LOG_STREAM() << "null type passed to newLocal\n";
         assert(false);
@@ -2883,7 +3235,7 @@ void UserProc::addLocal(SharedType ty, const QString &nam, Exp *e) {
     // assert(symbolMap.find(e) == symbolMap.end());
     mapSymbolTo(e, Location::local(nam, this));
     // assert(locals.find(nam) == locals.end());        // Could be r10{20} -> o2, r10{30}->o2 now
-    locals[nam] = ty;
+    setLocal(nam, ty);
 }
 
 /// return a local's type
@@ -2895,11 +3247,17 @@ SharedType UserProc::getLocalType(const QString &nam) {
 }
 
 void UserProc::setLocalType(const QString &nam, SharedType ty) {
-    locals[nam] = ty;
+    setLocal(nam, ty);
 
     LOG_VERBOSE(1) << "setLocalType: updating type of " << nam << " to " << ty->getCtype() << "\n";
 }
 
+void UserProc::setLocal(const QString &nam, SharedType ty) {
+    locals[nam] = ty;
+    if (ty)
+        maxLocalSize = std::max(maxLocalSize, ty->getSize());
+}
+
 SharedType UserProc::getParamType(const QString &nam) {
     for (unsigned int i = 0; i < signature->getNumParams(); i++)
         if (nam == signature->getParamName(i))
@@ -2926,7 +3284,40 @@ void UserProc::mapSymbolTo(const Exp *from, Exp *to) {
         ++it;
     }
     std::pair<const Exp *, Exp *> pr = {from, to};
-    symbolMap.insert(pr);
+    SymbolMap::iterator ins = symbolMap.insert(pr);
+    if (to->isLocal())
+        symbolsByName.insert({((Const *)to->getSubExp1())->getStr(), ins});
+    int n;
+    if (stackSlotOffset(from, n))
+        symbolsByStackOffset.insert({n, ins});
+}
+
+/// Remove the mapping at \a it from the symbol map and its indexes
+void UserProc::eraseSymbol(SymbolMap::iterator it) {
+    if (it->second->isLocal()) {
+        auto range = symbolsByName.equal_range(((Const *)it->second->getSubExp1())->getStr());
+        for (auto nn = range.first; nn != range.second; ++nn)
+            if (nn->second == it) {
+                symbolsByName.erase(nn);
+                break;
+            }
+    }
+    int n;
+    if (stackSlotOffset(it->first, n)) {
+        auto range = symbolsByStackOffset.equal_range(n);
+        for (auto ss = range.first; ss != range.second; ++ss)
+            if (ss->second == it) {
+                symbolsByStackOffset.erase(ss);
+                break;
+            }
+    }
+    symbolMap.erase(it);
+}
+
+void UserProc::clearSymbolMap() {
+    symbolMap.clear();
+    symbolsByName.clear();
+    symbolsByStackOffset.clear();
 }
 
 // FIXME: is this the same as lookupSym() now?
@@ -2953,7 +3344,7 @@ void UserProc::removeSymbolMapping(const Exp *from, Exp *to) {
     SymbolMap::iterator it = symbolMap.find(from);
     while (it != symbolMap.end() && *it->first == *from) {
         if (*it->second == *to) {
-            symbolMap.erase(it);
+            eraseSymbol(it);
             return;
         }
         it++;
@@ -2961,14 +3352,14 @@ void UserProc::removeSymbolMapping(const Exp *from, Exp *to) {
 }
 
 /// return a symbol's exp (note: the original exp, like r24, not local1)
-/// \note linear search!!
 const Exp *UserProc::expFromSymbol(const QString &nam) const {
-    for (const std::pair<const Exp *, Exp *> &it : symbolMap) {
-        const Exp *e = it.second;
-        if (e->isLocal() && ((const Const *)((const Location *)e)->getSubExp1())->getStr()==nam)
-            return it.first;
-    }
-    return nullptr;
+    // If several map to the local, the first in the symbol map
+    const Exp *ret = nullptr;
+    auto range = symbolsByName.equal_range(nam);
+    for (auto it = range.first; it != range.second; ++it)
+        if (ret == nullptr || *it->second->first < *ret)
+            ret = it->second->first;
+    return ret;
 }
 
 QString UserProc::getLocalName(int n) {
@@ -2989,50 +3380,32 @@ QString UserProc::getSymbolName(Exp *e) {
     return ((Const *)loc->getSubExp1())->getStr();
 }
 
-// Count references to the things that are under SSA control. For each SSA subscripting, increment a counter for that
-// definition
-void UserProc::countRefs(RefCounter &refCounts) {
-    StatementList stmts;
-    getStatements(stmts);
-    StatementList::iterator it;
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
-        // Don't count uses in implicit statements. There is no RHS of course, but you can still have x from m[x] on the
-        // LHS and so on, and these are not real uses
-        if (s->isImplicit())
-            continue;
-        if (DEBUG_UNUSED)
-            LOG << "counting references in " << s << "\n";
-        LocationSet refs;
-        s->addUsedLocs(refs, false); // Ignore uses in collectors
-        LocationSet::iterator rr;
-        for (rr = refs.begin(); rr != refs.end(); rr++) {
-            if (((Exp *)*rr)->isSubscript()) {
-                Instruction *def = ((RefExp *)*rr)->getDef();
-                // Used to not count implicit refs here (def->getNumber() == 0), meaning that implicit definitions get
-                // removed as dead code! But these are the ideal place to read off final parameters, and it is
-                // guaranteed now that implicit statements are sorted out for us by now (for dfa type analysis)
-                if (def /* && def->getNumber() */) {
-                    refCounts[def]++;
-                    if (DEBUG_UNUSED)
-                        LOG << "counted ref to " << *rr << "\n";
-                }
-            }
-        }
-    }
-    if (DEBUG_UNUSED) {
-        RefCounter::iterator rr;
-        LOG << "### reference counts for " << getName() << ":\n";
-        for (rr = refCounts.begin(); rr != refCounts.end(); ++rr)
-            LOG << "  " << rr->first->getNumber() << ":" << rr->second << "\t";
-        LOG << "\n### end reference counts\n";
-    }
+/***************************************************************************/ /**
+  * \brief Give every statement its use lists (see Instruction::getUsers()), from the refs in the statements
+  *
+  * Until clearUseLists(), removeStatement() keeps them up to date, and the pass that built them calls
+  * Instruction::updateUses() for each statement it changes. Passes that do neither clear them first.
+  ******************************************************************************/
+void UserProc::buildUseLists() {
+    StatementRange stmts = statements();
+    for (Instruction *s : stmts)
+        s->clearUses();
+    for (Instruction *s : stmts)
+        s->updateUses();
+    useLists = true;
+}
+
+//! Drop the use lists, which the passes that follow would leave out of date
+void UserProc::clearUseLists() {
+    for (Instruction *s : statements())
+        s->clearUses();
+    useLists = false;
 }
 
 // Note: call the below after translating from SSA form
 // FIXME: this can be done before transforming out of SSA form now, surely...
 void UserProc::removeUnusedLocals() {
-    Boomerang::get()->alertDecompileDebugPoint(this, "before removing unused locals");
+    getContext()->alertDecompileDebugPoint(this, "before removing unused locals");
     if (VERBOSE)
         LOG << "removing unused locals (final) for " << getName() << "\n";
 
@@ -3119,13 +3492,13 @@ void UserProc::removeUnusedLocals() {
         if (mapsTo->isLocal()) {
             QString tmpName = ((Const *)((Location *)mapsTo)->getSubExp1())->getStr();
             if (removes.find(tmpName) != removes.end()) {
-                symbolMap.erase(sm++);
+                eraseSymbol(sm++);
                 continue;
             }
         }
         ++sm; // sm is itcremented with the erase, or here
     }
-    Boomerang::get()->alertDecompileDebugPoint(this, "after removing unused locals");
+    getContext()->alertDecompileDebugPoint(this, "after removing unused locals");
 }
 
 //
@@ -3133,27 +3506,29 @@ void UserProc::removeUnusedLocals() {
 //
 
 void UserProc::fromSSAform() {
-    Boomerang::get()->alertDecompiling(this);
+    if (fromCache)
+        return; // Never in SSA form
+    ArenaScope inArena(&arena);
+    StatScope stats(this, "fromSSAform");
+    getContext()->alertDecompiling(this);
 
     if (VERBOSE)
         LOG << "transforming " << getName() << " from SSA\n";
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "before transforming from SSA form");
+    getContext()->alertDecompileDebugPoint(this, "before transforming from SSA form");
 
     if (cfg->getNumBBs() >= 100) // Only for the larger procs
         // Note: emit newline at end of this proc, so we can distinguish getting stuck in this proc with doing a lot of
         // little procs that don't get messages. Also, looks better with progress dots
         LOG_STREAM() << " transforming out of SSA form " << getName() << " with " << cfg->getNumBBs() << " BBs";
 
-    StatementList stmts;
-    getStatements(stmts);
-    StatementList::iterator it;
+    StatementRange stmts = statements();
 
-    for (it = stmts.begin(); it != stmts.end(); it++) {
+    for (Instruction *s : stmts) {
         // Map registers to initial local variables
-        (*it)->mapRegistersToLocals();
+        s->mapRegistersToLocals();
         // Insert casts where needed, as types are about to become inaccessible
-        (*it)->insertCasts();
+        s->insertCasts();
     }
 
     // First split the live ranges where needed by reason of type incompatibility, i.e. when the type of a subscripted
@@ -3179,13 +3554,12 @@ void UserProc::fromSSAform() {
     }
 #endif
     int progress = 0;
-    for (it = stmts.begin(); it != stmts.end(); it++) {
+    for (Instruction *s : stmts) {
         if (++progress > 2000) {
             LOG_STREAM() << ".";
             LOG_STREAM().flush();
             progress = 0;
         }
-        Instruction *s = *it;
         LocationSet defs;
         s->getDefinitions(defs);
         LocationSet::iterator dd;
@@ -3214,7 +3588,9 @@ void UserProc::fromSSAform() {
             }
         }
     }
-    // Find the interferences generated by more than one version of a variable being live at the same program point
+    // Find the interferences generated by more than one version of a variable being live at the same program point.
+    // The passes before this rewrite statements without telling the cfg, so don't trust any livenesses it has kept
+    cfg->invalidateLiveness();
     cfg->findInterferences(ig);
 
     // Find the set of locations that are "united" by phi-functions
@@ -3336,14 +3712,12 @@ void UserProc::fromSSAform() {
     mapParameters();
     removeSubscriptsFromSymbols();
     removeSubscriptsFromParameters();
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
+    for (Instruction *s : stmts)
         s->replaceSubscriptsWithLocals();
-    }
 
-    // Now remove the phis
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
+    // Now remove the phis. Removing the statement the walk is at is safe; the assignments inserted for phi operands are
+    // not phis, so it doesn't matter whether the walk meets them
+    for (Instruction *s : stmts) {
         if (!s->isPhi())
             continue;
         // Check if the base variables are all the same
@@ -3426,8 +3800,14 @@ void UserProc::fromSSAform() {
 
     if (cfg->getNumBBs() >= 100) // Only for the larger procs
         LOG_STREAM() << "\n";
+    cfg->invalidateLiveness(); // The SSA names are gone
+
+    getContext()->alertDecompileDebugPoint(this, "after transforming from SSA form");
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after transforming from SSA form");
+    // Nothing after this adds uses of locals, so prune them while the statements are at hand rather than in another
+    // walk of them at code generation
+    removeUnusedLocals();
+    unusedLocalsRemoved = true;
 }
 
 void UserProc::mapParameters() {
@@ -3446,6 +3826,7 @@ void UserProc::mapParameters() {
         } else
             ((Assignment *)*pp)->setLeft(Location::param(mappedName, this));
     }
+    summaryChanged();
 }
 
 void UserProc::removeSubscriptsFromSymbols() {
@@ -3455,7 +3836,7 @@ void UserProc::removeSubscriptsFromSymbols() {
     // Since this will potentially change the ordering of entries, need to copy the map
     SymbolMap sm2 = symbolMap; // Object copy
     SymbolMap::iterator it;
-    symbolMap.clear();
+    clearSymbolMap();
     ExpSsaXformer esx(this);
     for (it = sm2.begin(); it != sm2.end(); ++it) {
         Exp *from = const_cast<Exp *>(it->first);
@@ -3463,6 +3844,7 @@ void UserProc::removeSubscriptsFromSymbols() {
             // As noted above, don't touch the outer level of subscripts
             Exp *&sub = ((RefExp *)from)->refSubExp1();
             sub = sub->accept(&esx);
+            Exp::changed();
         } else
             from = from->accept(&esx);
         mapSymbolTo(from, it->second);
@@ -3477,14 +3859,105 @@ void UserProc::removeSubscriptsFromParameters() {
         left = left->accept(&esx);
         ((Assignment *)*it)->setLeft(left);
     }
+    summaryChanged();
 }
 
 static Binary allEqAll(opEquals, new Terminal(opDefineAll), new Terminal(opDefineAll));
 
+/***************************************************************************/ /**
+  * \brief   Forget the remembered proof results of this proc and the rest of its recursion group if their statements
+  * have changed since the results were found
+  ******************************************************************************/
+/**
+ * A hash of the printed statements of this proc and of the collector of its return statement (which isn't printed with
+ * it), and with \a withProofs of the equations proven for it. Equal fingerprints mean nothing has changed in between.
+ */
+QByteArray UserProc::getFingerprint(bool withProofs) {
+    QString text;
+    QTextStream os(&text);
+    for (Instruction *s : statements())
+        os << s << "\n";
+    if (theReturnStatement)
+        theReturnStatement->getCollector()->print(os);
+    if (withProofs) {
+        for (const auto &pr : provenTrue)
+            os << pr.first << "=" << pr.second << "\n";
+    }
+    os.flush();
+    return QCryptographicHash::hash(text.toUtf8(), QCryptographicHash::Sha1);
+}
+
+//! Keep the proc as it is now, at the debug point \a description, in its history
+void UserProc::takeSnapshot(const char *description) {
+    QString text;
+    QTextStream os(&text);
+    print(os);
+    os.flush();
+    history.take(description, text);
+}
+
+void UserProc::validateProofs() {
+    std::set<UserProc *> procs{this};
+    if (cycleGrp)
+        procs.insert(cycleGrp->begin(), cycleGrp->end());
+    for (UserProc *p : procs) {
+        QByteArray fp = p->getFingerprint(false);
+        if (fp != p->proofFingerprint) {
+            p->proofResults.clear();
+            p->proofFingerprint = fp;
+        }
+    }
+}
+
+//! Forget the results of prove(), which are worked out again when asked for (see Prog::relieveMemoryPressure)
+void UserProc::dropProofs() {
+    proofResults.clear();
+    proofFingerprint.clear();
+}
+
+/**
+ * The key of \a query in proofResults. Besides the query, a result depends on the premises assumed for the procs of the
+ * recursion group, and may turn from false to true as more is proven about them, so those go into the key too.
+ */
+QString UserProc::getProofKey(const Exp *query) const {
+    QString key;
+    QTextStream os(&key);
+    os << query;
+    std::set<UserProc *> procs{const_cast<UserProc *>(this)};
+    if (cycleGrp)
+        procs.insert(cycleGrp->begin(), cycleGrp->end());
+    for (UserProc *p : procs) {
+        os << "|" << p->getName() << ":" << p->provenTrue.size();
+        for (const auto &pr : p->recurPremises)
+            os << "," << pr.first;
+    }
+    os.flush();
+    return key;
+}
+
+/**
+ * Prove each of \a queries, as prove() would one at a time, into \a results. The queries are one series: a phi function
+ * that one of them proved equal to some right hand side is not walked again when a later one meets it with the same
+ * right hand side.
+ */
+void UserProc::proveAll(const std::vector<Exp *> &queries, std::vector<bool> &results) {
+    ProofSession session(this);
+    std::map<PhiAssign *, Exp *> phiCache;
+    results.clear();
+    for (Exp *query : queries) {
+        if (DEBUG_PROOF)
+            LOG << "attempting to prove " << query << " for " << getName() << "\n";
+        results.push_back(prove(query, false, &phiCache));
+    }
+}
+
 // this function was non-reentrant, but now reentrancy is frequently used
 /// prove any arbitary property of this procedure. If conditional is true, do not save the result, as it may
-/// be conditional on premises stored in other procedures
-bool UserProc::prove(Exp *query, bool conditional /* = false */) {
+/// be conditional on premises stored in other procedures. \a phiCache, if given, holds the phis proven by earlier
+/// queries of a series (see proveAll()), and gets those proven by this one
+bool UserProc::prove(Exp *query, bool conditional /* = false */,
+                     std::map<PhiAssign *, Exp *> *phiCache /* = nullptr */) {
+    ProofSession session(this);
 
     assert(query->isEquality());
     Exp *queryLeft = ((Binary *)query)->getSubExp1();
@@ -3502,7 +3975,7 @@ bool UserProc::prove(Exp *query, bool conditional /* = false */) {
     }
 #endif
 
-    if (Boomerang::get()->noProve)
+    if (getContext()->noProve)
         return false;
 
     Exp *original = query->clone();
@@ -3538,6 +4011,7 @@ bool UserProc::prove(Exp *query, bool conditional /* = false */) {
                     LOG << "Using all=all for " << query->getSubExp1() << "\n"
                         << "prove returns true\n";
                 provenTrue[origLeft->clone()] = right;
+                summaryChanged();
                 return true;
             }
             if (DEBUG_PROOF)
@@ -3547,21 +4021,39 @@ bool UserProc::prove(Exp *query, bool conditional /* = false */) {
         }
     }
 
-    if (cycleGrp) // If in involved in a recursion cycle
-        //    then save the original query as a premise for bypassing calls
-        recurPremises[origLeft->clone()] = origRight;
-
-    std::set<PhiAssign *> lastPhis;
-    std::map<PhiAssign *, Exp *> cache;
-    bool result = prover(query, lastPhis, cache, original);
-    if (cycleGrp)
-        recurPremises.erase(origLeft); // Remove the premise, regardless of result
+    bool result;
+    QString key = getProofKey(original);
+    auto known = proofResults.find(key);
+    if (known != proofResults.end()) {
+        result = known->second;
+        if (DEBUG_PROOF)
+            LOG << "found " << (result ? "true" : "false") << " in proof cache " << original << " in " << getName()
+                << "\n";
+    } else {
+        if (cycleGrp) // If in involved in a recursion cycle
+            //    then save the original query as a premise for bypassing calls
+            recurPremises[origLeft->clone()] = origRight;
+
+        std::set<PhiAssign *> lastPhis;
+        std::map<PhiAssign *, Exp *> cache;
+        if (phiCache)
+            cache = *phiCache;
+        result = prover(query, lastPhis, cache, original);
+        if (cycleGrp)
+            recurPremises.erase(origLeft); // Remove the premise, regardless of result
+        proofResults[key] = result;
+        // What a failed or premised proof found about the phis may rest on what did not hold, so only keep the rest
+        if (phiCache && result && !conditional && cycleGrp == nullptr)
+            phiCache->swap(cache);
+    }
     if (DEBUG_PROOF)
         LOG << "prove returns " << (result ? "true" : "false") << " for " << query << " in " << getName() << "\n";
 
     if (!conditional) {
-        if (result)
+        if (result) {
             provenTrue[origLeft] = origRight; // Save the now proven equation
+            summaryChanged();
+        }
 #if PROVEN_FALSE
         else
             provenFalse[origLeft] = origRight; // Save the now proven-to-be-false equation
@@ -3857,10 +4349,11 @@ void UserProc::conTypeAnalysis() {
     StatementList::iterator ss;
     // For each statement this proc
     int conscript = 0;
+    std::vector<Const *> numbered; // The constants given conscripts, so that they can be cleared without another walk
     for (ss = stmts.begin(); ss != stmts.end(); ss++) {
         cons.clear();
         // So we can co-erce constants:
-        conscript = (*ss)->setConscripts(conscript);
+        conscript = (*ss)->setConscripts(conscript, &numbered);
         (*ss)->genConstraints(cons);
         consObj.addConstraints(cons);
         if (DEBUG_TA)
@@ -3894,6 +4387,9 @@ void UserProc::conTypeAnalysis() {
 
     // Just use the first solution, if there is one
     Prog *prog = getProg();
+    // The constants to cast are all wrapped in one walk of the statements, at the end
+    std::list<ExpConstCaster> casters;
+    ExpModifierPipeline casts;
     if (!solns.empty()) {
         ConstraintMap &cm = *solns.begin();
         for (cc = cm.begin(); cc != cm.end(); cc++) {
@@ -3930,19 +4426,25 @@ void UserProc::conTypeAnalysis() {
                         con->setOper(opStrConst);
                     }
                 } else {
-                    if (ty->isInteger() && ty->getSize() && ty->getSize() != STD_SIZE)
+                    if (ty->isInteger() && ty->getSize() && ty->getSize() != STD_SIZE) {
                         // Wrap the constant in a TypedExp (for a cast)
-                        castConst(con->getConscript(), ty);
+                        casters.emplace_back(con->getConscript(), ty);
+                        casts.add(&casters.back());
+                    }
                 }
             }
         }
     }
+    if (!casts.empty()) {
+        StmtModifier sm(&casts);
+        for (ss = stmts.begin(); ss != stmts.end(); ss++)
+            (*ss)->accept(&sm);
+    }
 
     // Clear the conscripts. These confuse the fromSSA logic, causing infinite
-    // loops
-    for (ss = stmts.begin(); ss != stmts.end(); ss++) {
-        (*ss)->clearConscripts();
-    }
+    // loops. A constant wrapped in a cast above is the same object, so is in the list too
+    for (Const *c : numbered)
+        c->setConscript(0);
 }
 
 bool UserProc::searchAndReplace(const Exp &search, Exp *replace) {
@@ -3957,6 +4459,16 @@ bool UserProc::searchAndReplace(const Exp &search, Exp *replace) {
     return ch;
 }
 
+//! As searchAndReplace, but for all the searches in \a replacements in a single walk of the statements
+bool UserProc::searchAndReplaceAll(const ExpReplaceMap &replacements) {
+    bool ch = false;
+    StatementList stmts;
+    getStatements(stmts);
+    for (Instruction *s : stmts)
+        ch |= s->searchAndReplaceAll(replacements);
+    return ch;
+}
+
 unsigned fudge(StatementList::iterator x) {
     StatementList::iterator y = x;
     return *(unsigned *)&y;
@@ -4025,7 +4537,7 @@ bool UserProc::ellipsisProcessing() {
   * pieces of code add r28{0}
   ******************************************************************************/
 void UserProc::addImplicitAssigns() {
-    Boomerang::get()->alertDecompileDebugPoint(this, "before adding implicit assigns");
+    getContext()->alertDecompileDebugPoint(this, "before adding implicit assigns");
 
     StatementList stmts;
     getStatements(stmts);
@@ -4040,7 +4552,7 @@ void UserProc::addImplicitAssigns() {
     makeSymbolsImplicit();
     // makeParamsImplicit();            // Not necessary yet, since registers are not yet mapped
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after adding implicit assigns");
+    getContext()->alertDecompileDebugPoint(this, "after adding implicit assigns");
 }
 
 // e is a parameter location, e.g. r8 or m[r28{0}+8]. Lookup a symbol for it
@@ -4189,9 +4701,9 @@ void UserProc::dumpLocals() {
 }
 //! Update the arguments in calls
 void UserProc::updateArguments() {
-    Boomerang::get()->alertDecompiling(this);
+    getContext()->alertDecompiling(this);
     LOG_VERBOSE(1) << "### update arguments for " << getName() << " ###\n";
-    Boomerang::get()->alertDecompileDebugPoint(this, "before updating arguments");
+    getContext()->alertDecompileDebugPoint(this, "before updating arguments");
     BasicBlock::rtlrit rrit;
     StatementList::reverse_iterator srit;
     for (BasicBlock *it : *cfg) {
@@ -4209,17 +4721,14 @@ void UserProc::updateArguments() {
         }
     }
     LOG_VERBOSE(1) << "=== end update arguments for " << getName() << "\n";
-    Boomerang::get()->alertDecompileDebugPoint(this, "after updating arguments");
+    getContext()->alertDecompileDebugPoint(this, "after updating arguments");
 }
 //! Update the defines in calls
 void UserProc::updateCallDefines() {
     if (VERBOSE)
         LOG << "### update call defines for " << getName() << " ###\n";
-    StatementList stmts;
-    getStatements(stmts);
-    StatementList::iterator it;
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        CallStatement *call = dynamic_cast<CallStatement *>(*it);
+    for (Instruction *s : statements()) {
+        CallStatement *call = dynamic_cast<CallStatement *>(s);
         if (call == nullptr)
             continue;
         call->updateDefines();
@@ -4268,7 +4777,7 @@ void UserProc::replaceSimpleGlobalConstants() {
     }
 }
 void UserProc::reverseStrengthReduction() {
-    Boomerang::get()->alertDecompileDebugPoint(this, "before reversing strength reduction");
+    getContext()->alertDecompileDebugPoint(this, "before reversing strength reduction");
 
     StatementList stmts;
     getStatements(stmts);
@@ -4311,7 +4820,7 @@ void UserProc::reverseStrengthReduction() {
                 }
             }
         }
-    Boomerang::get()->alertDecompileDebugPoint(this, "after reversing strength reduction");
+    getContext()->alertDecompileDebugPoint(this, "after reversing strength reduction");
 }
 /***************************************************************************/ /**
   *
@@ -4343,6 +4852,7 @@ void UserProc::insertParameter(Exp *e, SharedType ty) {
     }
     if (!inserted)
         parameters.insert(parameters.end(), as); // In case larger than all existing elements
+    summaryChanged();
 
     // update the signature
     signature->setNumParams(0);
@@ -4511,7 +5021,7 @@ void UserProc::fixCallAndPhiRefs() {
     if (VERBOSE)
         LOG << "### start fix call and phi bypass analysis for " << getName() << " ###\n";
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "before fixing call and phi refs");
+    getContext()->alertDecompileDebugPoint(this, "before fixing call and phi refs");
 
     std::map<Exp *, int, lessExpStar> destCounts;
     StatementList::iterator it;
@@ -4666,7 +5176,7 @@ void UserProc::fixCallAndPhiRefs() {
     if (VERBOSE)
         LOG << "### end fix call and phi bypass analysis for " << getName() << " ###\n";
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after fixing call and phi refs");
+    getContext()->alertDecompileDebugPoint(this, "after fixing call and phi refs");
 }
 
 // Not sure that this is needed...
@@ -4738,6 +5248,7 @@ void UserProc::propagateToCollector() {
 void UserProc::initialParameters() {
     LOG_VERBOSE(1) << "### initial parameters for " << getName() << "\n";
     parameters.clear();
+    summaryChanged();
     for (Exp *v : col)
         parameters.append(new ImplicitAssign(v->clone()));
     if (VERBOSE) {
@@ -5004,7 +5515,7 @@ bool UserProc::removeRedundantParameters() {
     bool ret = false;
     StatementList newParameters;
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "before removing redundant parameters");
+    getContext()->alertDecompileDebugPoint(this, "before removing redundant parameters");
 
     if (DEBUG_UNUSED)
         LOG << "%%% removing unused parameters for " << getName() << "\n";
@@ -5032,16 +5543,17 @@ bool UserProc::removeRedundantParameters() {
             // Check if it is in the symbol map. If so, delete it; a local will be created later
             SymbolMap::iterator ss = symbolMap.find(param);
             if (ss != symbolMap.end())
-                symbolMap.erase(ss);           // Kill the symbol
+                eraseSymbol(ss);               // Kill the symbol
             signature->removeParameter(param); // Also remove from the signature
             cfg->removeImplicitAssign(param);  // Remove the implicit assignment so it doesn't come back
         }
     }
     parameters = newParameters;
+    summaryChanged();
     if (DEBUG_UNUSED)
         LOG << "%%% end removing unused parameters for " << getName() << "\n";
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after removing redundant parameters");
+    getContext()->alertDecompileDebugPoint(this, "after removing redundant parameters");
 
     return ret;
 }
@@ -5070,8 +5582,10 @@ bool UserProc::removeRedundantParameters() {
   ******************************************************************************/
 
 bool UserProc::removeRedundantReturns(std::set<UserProc *> &removeRetSet) {
-    Boomerang::get()->alertDecompiling(this);
-    Boomerang::get()->alertDecompileDebugPoint(this, "before removing unused returns");
+    if (fromCache)
+        return false; // The cached returns are what other programs' callers depend on; leave them
+    getContext()->alertDecompiling(this);
+    getContext()->alertDecompileDebugPoint(this, "before removing unused returns");
     // First remove the unused parameters
     bool removedParams = removeRedundantParameters();
     if (theReturnStatement == nullptr)
@@ -5186,7 +5700,7 @@ bool UserProc::removeRedundantReturns(std::set<UserProc *> &removeRetSet) {
         signature->setRetType(a->getType());
     }
 
-    Boomerang::get()->alertDecompileDebugPoint(this, "after removing unused and redundant returns");
+    getContext()->alertDecompileDebugPoint(this, "after removing unused and redundant returns");
     return removedRets || removedParams;
 }
 
@@ -5206,6 +5720,8 @@ bool UserProc::removeRedundantReturns(std::set<UserProc *> &removeRetSet) {
   *
   ******************************************************************************/
 void UserProc::updateForUseChange(std::set<UserProc *> &removeRetSet) {
+    if (fromCache)
+        return;
     // We need to remember the parameters, and all the livenesses for all the calls, to see if these are changed
     // by removing returns
     if (DEBUG_UNUSED) {
@@ -5289,6 +5805,9 @@ void UserProc::clearUses() {
   *
   ******************************************************************************/
 void UserProc::typeAnalysis() {
+    if (fromCache)
+        return; // The cached types are final
+    StatScope stats(this, "typeAnalysis");
     if (VERBOSE)
         LOG << "### type analysis for " << getName() << " ###\n";
 
@@ -5488,11 +6007,12 @@ void Function::setProvenTrue(Exp *fact) {
     Exp *lhs = ((Binary *)fact)->getSubExp1();
     Exp *rhs = ((Binary *)fact)->getSubExp2();
     provenTrue[lhs] = rhs;
+    summaryChanged();
 }
 
 //! Map expressions to locals and initial parameters
 void UserProc::mapLocalsAndParams() {
-    Boomerang::get()->alertDecompileDebugPoint(this, "before mapping locals from dfa type analysis");
+    getContext()->alertDecompileDebugPoint(this, "before mapping locals from dfa type analysis");
     if (DEBUG_TA)
         LOG << " ### mapping expressions to local variables for " << getName() << " ###\n";
     StatementList stmts;
@@ -5509,7 +6029,7 @@ void UserProc::mapLocalsAndParams() {
 void UserProc::makeSymbolsImplicit() {
     SymbolMap::iterator it;
     SymbolMap sm2 = symbolMap; // Copy the whole map; necessary because the keys (Exps) change
-    symbolMap.clear();
+    clearSymbolMap();
     ImplicitConverter ic(cfg);
     for (it = sm2.begin(); it != sm2.end(); ++it) {
         Exp *impFrom = const_cast<Exp *>(it->first)->accept(&ic);
@@ -5612,11 +6132,9 @@ const SharedType UserProc::getTypeForLocation(const Exp *e) const {
 }
 void UserProc::verifyPHIs() {
     StatementList stmts;
-    getStatements(stmts);
+    stmtTable.getOfKind(STMT_PHIASSIGN, stmts);
     for (Instruction *st : stmts) {
         PhiAssign *pi = (PhiAssign *)st;
-        if (!pi->isPhi())
-            continue; // Might be able to optimise this a bit
         for (const auto &pas : *pi) {
             assert(pas.second.def());
         }
@@ -0,0 +1,486 @@
+/***************************************************************************/ /**
+  * \file       proccache.cpp
+  * \brief   Implementation of the ProcCache class
+  *
+  * Each entry is a text file named after its key, one item per line:
+  *
+  *     boomerang-proc-cache 1
+  *     param <name> <type> <exp>      the signature's parameters, in order
+  *     return <type> <exp>            the signature's returns, in order
+  *     modified <type> <exp>          the modifieds of the return statement
+  *     returns <type> <exp>           the returns of the return statement
+  *     proven <exp> <exp>             a proven equation, left and right
+  *
+  * Types and expressions are written prefix, a token per node (see writeType() and writeExp()); operators are written
+  * by name, so the files do not depend on the order of the OPER enum.
+  ******************************************************************************/
+#include "proccache.h"
+
+#include "boomerang.h"
+#include "IBinaryImage.h"
+#include "exp.h"
+#include "frontend.h"
+#include "decoder.h"
+#include "log.h"
+#include "proc.h"
+#include "prog.h"
+#include "rtl.h"
+#include "signature.h"
+#include "statement.h"
+#include "type.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTextStream>
+
+#include <set>
+#include <vector>
+
+extern const char *operStrings[];
+
+namespace {
+const char *const MAGIC = "boomerang-proc-cache 1";
+
+QString escape(const QString &s) {
+    QString res(s);
+    return res.replace('%', "%25").replace(' ', "%20").replace('\n', "%0A");
+}
+QString unescape(const QString &s) { return QString::fromUtf8(QByteArray::fromPercentEncoding(s.toUtf8())); }
+
+int operFromName(const QString &s) {
+    for (int i = 0; i < opNumOf; i++)
+        if (s == operStrings[i])
+            return i;
+    return -1;
+}
+
+//! Write \a ty, returning false for the types that can't be read back (named, compound, function and so on)
+bool writeType(QTextStream &os, const SharedType &ty) {
+    if (ty == nullptr)
+        return false;
+    if (ty->isVoid())
+        os << " v";
+    else if (ty->isBoolean())
+        os << " b";
+    else if (ty->isChar())
+        os << " c";
+    else if (ty->isInteger())
+        os << " i " << (int)ty->getSize() << " " << ty->as<IntegerType>()->getSignedness();
+    else if (ty->isFloat())
+        os << " f " << (int)ty->getSize();
+    else if (ty->isSize())
+        os << " z " << (int)ty->getSize();
+    else if (ty->isPointer()) {
+        os << " p";
+        return writeType(os, ty->as<PointerType>()->getPointsTo());
+    } else if (ty->isArray()) {
+        os << " a " << (qulonglong)ty->as<ArrayType>()->getLength();
+        return writeType(os, ty->as<ArrayType>()->getBaseType());
+    } else
+        return false;
+    return true;
+}
+
+/**
+ * Write \a e, returning false for what can't be read back: subscripts, typed and flag expressions, and constants
+ * other than integers and strings
+ */
+bool writeExp(QTextStream &os, const Exp *e) {
+    OPER op = e->getOper();
+    switch (op) {
+    case opIntConst:
+        os << " k " << ((const Const *)e)->getInt();
+        return true;
+    case opStrConst:
+        os << " s " << escape(((const Const *)e)->getStr());
+        return true;
+    case opSubscript:
+    case opTypedExp:
+    case opFlagDef:
+    case opTypeVal:
+        return false;
+    default:
+        break;
+    }
+    if (dynamic_cast<const Const *>(e))
+        return false;
+    switch (e->getArity()) {
+    case 0:
+        os << " t " << operStrings[op];
+        return true;
+    case 1:
+        os << (dynamic_cast<const Location *>(e) ? " l " : " u ") << operStrings[op];
+        return writeExp(os, e->getSubExp1());
+    case 2:
+        os << " b " << operStrings[op];
+        return writeExp(os, e->getSubExp1()) && writeExp(os, e->getSubExp2());
+    case 3:
+        os << " 3 " << operStrings[op];
+        return writeExp(os, e->getSubExp1()) && writeExp(os, e->getSubExp2()) && writeExp(os, e->getSubExp3());
+    }
+    return false;
+}
+
+/// Reads back what writeType() and writeExp() wrote, from the tokens of one line
+class EntryReader {
+    QStringList tokens;
+    int pos = 0;
+    UserProc *proc;
+
+    QString next() { return pos < tokens.size() ? tokens[pos++] : QString(); }
+    int nextInt(bool &ok) {
+        bool converted = false;
+        int res = next().toInt(&converted);
+        ok &= converted;
+        return res;
+    }
+    OPER nextOper(bool &ok) {
+        int op = operFromName(next());
+        ok &= op >= 0;
+        return op >= 0 ? (OPER)op : opWild;
+    }
+
+  public:
+    EntryReader(const QString &line, UserProc *p) : tokens(line.split(' ', QString::SkipEmptyParts)), proc(p) {}
+    QString word() { return next(); }
+    QString name() { return unescape(next()); }
+    bool atEnd() const { return pos == tokens.size(); }
+
+    SharedType type(bool &ok) {
+        QString t(next());
+        if (t == "v")
+            return VoidType::get();
+        if (t == "b")
+            return BooleanType::get();
+        if (t == "c")
+            return CharType::get();
+        if (t == "i") {
+            int size = nextInt(ok);
+            return IntegerType::get(size, nextInt(ok));
+        }
+        if (t == "f")
+            return FloatType::get(nextInt(ok));
+        if (t == "z")
+            return SizeType::get(nextInt(ok));
+        if (t == "p") {
+            SharedType pointsTo = type(ok);
+            return ok ? PointerType::get(pointsTo) : nullptr;
+        }
+        if (t == "a") {
+            unsigned length = nextInt(ok);
+            SharedType base = type(ok);
+            return ok ? ArrayType::get(base, length) : nullptr;
+        }
+        ok = false;
+        return nullptr;
+    }
+
+    Exp *exp(bool &ok) {
+        QString kind(next());
+        if (kind == "k")
+            return Const::get(nextInt(ok));
+        if (kind == "s")
+            return Const::get(unescape(next()));
+        OPER op = nextOper(ok);
+        if (!ok)
+            return nullptr;
+        if (kind == "t")
+            return Terminal::get(op);
+        Exp *e1 = exp(ok);
+        if (!ok)
+            return nullptr;
+        if (kind == "l")
+            return Location::get(op, e1, (op == opLocal || op == opParam) ? proc : nullptr);
+        if (kind == "u")
+            return Unary::get(op, e1);
+        Exp *e2 = exp(ok);
+        if (!ok)
+            return nullptr;
+        if (kind == "b")
+            return Binary::get(op, e1, e2);
+        Exp *e3 = exp(ok);
+        if (ok && kind == "3")
+            return new Ternary(op, e1, e2, e3);
+        ok = false;
+        return nullptr;
+    }
+};
+
+//! Add the options that change what a procedure decompiles to
+void hashOptions(QCryptographicHash &h, const DecompilerContext *ctx) {
+    const int opts[] = {ctx->noBranchSimplify,  ctx->noRemoveNull,       ctx->noLocals,        ctx->noRemoveLabels,
+                        ctx->noDataflow,        ctx->numToPropagate,     ctx->noPromote,       ctx->propOnlyToAll,
+                        ctx->maxMemDepth,       ctx->noParameterNames,   ctx->decodeThruIndCall, ctx->noProve,
+                        ctx->noChangeSignatures, ctx->conTypeAnalysis,   ctx->dfaTypeAnalysis, ctx->propMaxDepth,
+                        ctx->noGlobals,         ctx->assumeABI,          ctx->experimental,    ctx->prunedSSA,
+                        ctx->foldConstants,     ctx->propGrowthBudget,   ctx->draft};
+    QString s;
+    for (int o : opts)
+        s += QString::number(o) + ",";
+    h.addData(s.toUtf8());
+}
+}
+
+ProcCache &ProcCache::get() {
+    static ProcCache cache;
+    return cache;
+}
+
+//! Use the cache in \a dir, creating it if needed; an empty name disables the cache
+void ProcCache::setDirectory(const QString &dir) {
+    directory = dir;
+    if (directory.isEmpty())
+        return;
+    if (!directory.endsWith('/'))
+        directory += '/';
+    QDir().mkpath(directory);
+}
+
+//! Forget the hashes worked out for the procs of the current program
+void ProcCache::clear() {
+    contents.clear();
+    keys.clear();
+}
+
+QString ProcCache::getFileName(const QByteArray &key) const { return directory + QString(key.toHex()) + ".proc"; }
+
+//! Hash of the instruction bytes of \a proc alone, with addresses relative to its entry; false if it isn't decoded
+bool ProcCache::getContentHash(UserProc *proc, QByteArray &res) {
+    auto it = contents.find(proc);
+    if (it != contents.end()) {
+        res = it->second;
+        return true;
+    }
+    if (!proc->isDecoded() || proc->getDecodedInsns().empty())
+        return false;
+    IBinaryImage *image = Boomerang::get()->getImage();
+    ADDRESS entry = proc->getNativeAddress();
+    QCryptographicHash h(QCryptographicHash::Sha1);
+    for (const auto &insn : proc->getDecodedInsns()) {
+        QByteArray bytes = QByteArray::number((qlonglong)(insn.first - entry).m_value);
+        bytes.append(':');
+        for (unsigned i = 0; i < insn.second; i++)
+            bytes.append(image->readNative1(insn.first + i));
+        h.addData(bytes);
+    }
+    res = h.result();
+    contents[proc] = res;
+    return true;
+}
+
+/***************************************************************************/ /**
+  * \brief   Work out the key of \a proc: the hashes of its own bytes and of those of all the procs it can reach through
+  * calls (sorted, so that the order they are found in doesn't matter), the names of the library procs among them, and
+  * the options, machine description and version
+  * \returns false if some of that code isn't decoded, so that there is no usable key
+  ******************************************************************************/
+bool ProcCache::makeKey(UserProc *proc, QByteArray &res) {
+    std::set<Function *> seen;
+    std::vector<UserProc *> work{proc};
+    std::set<QByteArray> callees;
+    std::set<QString> libs;
+    QByteArray own;
+    if (!getContentHash(proc, own))
+        return false;
+    seen.insert(proc);
+    while (!work.empty()) {
+        UserProc *p = work.back();
+        work.pop_back();
+        for (Function *c : p->getCallees()) {
+            if (!seen.insert(c).second)
+                continue;
+            if (c->isLib()) {
+                libs.insert(c->getName());
+                continue;
+            }
+            QByteArray ch;
+            if (!getContentHash((UserProc *)c, ch))
+                return false;
+            callees.insert(ch);
+            work.push_back((UserProc *)c);
+        }
+    }
+    QCryptographicHash h(QCryptographicHash::Sha1);
+    h.addData(QByteArray(MAGIC));
+    h.addData(QByteArray(Boomerang::getVersionStr()));
+    FrontEnd *fe = proc->getProg()->getFrontEnd();
+    if (fe && fe->getDecoder())
+        h.addData(fe->getDecoder()->getRTLDict().getFingerprint());
+    hashOptions(h, proc->getContext());
+    h.addData(own);
+    for (const QByteArray &ch : callees)
+        h.addData(ch);
+    for (const QString &l : libs)
+        h.addData(l.toUtf8());
+    res = h.result();
+    return true;
+}
+
+/***************************************************************************/ /**
+  * \brief   Work out now the key that store() writes \a proc under, as restore() would look it up: before it is
+  * decompiled, which can decode more of it (e.g. the targets of a switch)
+  ******************************************************************************/
+void ProcCache::keepKey(UserProc *proc) {
+    QByteArray key;
+    if (makeKey(proc, key))
+        keys[proc] = key;
+}
+
+/***************************************************************************/ /**
+  * \brief   If \a proc is in the cache, give it the cached signature, parameters, returns and preservations, and mark
+  * it as coming from the cache
+  * \returns true on a hit; the caller makes proc final
+  ******************************************************************************/
+bool ProcCache::restore(UserProc *proc) {
+    QByteArray key;
+    if (!makeKey(proc, key))
+        return false;
+    keys[proc] = key;
+    QFile f(getFileName(key));
+    if (!f.open(QFile::ReadOnly | QFile::Text)) {
+        misses++;
+        return false;
+    }
+    QTextStream in(&f);
+    if (in.readLine() != MAGIC) {
+        misses++;
+        return false;
+    }
+
+    // Read everything first, so that a corrupt entry leaves proc alone
+    struct Item {
+        QString kind, name;
+        SharedType ty;
+        Exp *e1 = nullptr;
+        Exp *e2 = nullptr;
+    };
+    std::vector<Item> items;
+    bool ok = true;
+    while (ok && !in.atEnd()) {
+        QString line = in.readLine();
+        if (line.isEmpty())
+            continue;
+        EntryReader rd(line, proc);
+        Item it;
+        it.kind = rd.word();
+        if (it.kind == "param")
+            it.name = rd.name();
+        if (it.kind == "proven") {
+            it.e1 = rd.exp(ok);
+            it.e2 = ok ? rd.exp(ok) : nullptr;
+        } else if (it.kind == "param" || it.kind == "return" || it.kind == "modified" || it.kind == "returns") {
+            it.ty = rd.type(ok);
+            it.e1 = ok ? rd.exp(ok) : nullptr;
+        } else
+            ok = false;
+        ok &= rd.atEnd();
+        items.push_back(it);
+    }
+    if (!ok) {
+        LOG << "ignoring corrupt cache entry " << f.fileName() << " for " << proc->getName() << "\n";
+        misses++;
+        return false;
+    }
+
+    Signature *sig = proc->getSignature();
+    sig->setNumParams(0);
+    while (sig->getNumReturns() > 0)
+        sig->removeReturn(sig->getReturnExp(0));
+    proc->parameters.clear();
+    ReturnStatement *ret = proc->getTheReturnStatement();
+    if (ret) {
+        ret->getModifieds().clear();
+        ret->getReturns().clear();
+    }
+    for (const Item &it : items) {
+        if (it.kind == "param") {
+            sig->addParameter(it.ty, it.name, it.e1);
+            ImplicitAssign *as = new ImplicitAssign(it.ty->clone(), it.e1->clone());
+            as->setProc(proc);
+            proc->parameters.append(as);
+        } else if (it.kind == "return")
+            sig->addReturn(it.ty, it.e1);
+        else if (it.kind == "proven")
+            proc->setProvenTrue(Binary::get(opEquals, it.e1, it.e2));
+        else if (ret) {
+            Assign *as = new Assign(it.ty, it.e1, it.e1->clone());
+            as->setProc(proc);
+            if (it.kind == "modified")
+                ret->getModifieds().append(as);
+            else
+                ret->getReturns().append(as);
+        }
+    }
+    proc->summaryChanged();
+    proc->setFromCache();
+    hits++;
+    LOG_VERBOSE(1) << "restored " << proc->getName() << " from cache entry " << f.fileName() << "\n";
+    return true;
+}
+
+/***************************************************************************/ /**
+  * \brief   Write the cache entry for the decompiled \a proc, under the key it was looked up with
+  * \returns false if there is no key (see keepKey(); it may not be all decoded), or it uses types or
+  * expressions that can't be cached, or the file can't be written
+  ******************************************************************************/
+bool ProcCache::store(UserProc *proc) {
+    auto k = keys.find(proc);
+    if (k == keys.end() || proc->isFromCache() || !proc->isDecompiled())
+        return false;
+    QString text;
+    QTextStream os(&text);
+    os << MAGIC << "\n";
+    bool ok = true;
+    Signature *sig = proc->getSignature();
+    for (size_t i = 0; ok && i < sig->getNumParams(); i++) {
+        os << "param " << escape(sig->getParamName(i));
+        ok = !sig->getParamName(i).isEmpty() && writeType(os, sig->getParamType(i)) && writeExp(os, sig->getParamExp(i));
+        os << "\n";
+    }
+    for (size_t i = 0; ok && i < sig->getNumReturns(); i++) {
+        os << "return";
+        ok = writeType(os, sig->getReturnType(i)) && writeExp(os, sig->getReturnExp(i));
+        os << "\n";
+    }
+    ReturnStatement *ret = proc->getTheReturnStatement();
+    if (ret) {
+        for (Instruction *s : ret->getModifieds()) {
+            if (!ok)
+                break;
+            os << "modified";
+            ok = writeType(os, ((Assignment *)s)->getType()) && writeExp(os, ((Assignment *)s)->getLeft());
+            os << "\n";
+        }
+        for (Instruction *s : ret->getReturns()) {
+            if (!ok)
+                break;
+            os << "returns";
+            ok = writeType(os, ((Assignment *)s)->getType()) && writeExp(os, ((Assignment *)s)->getLeft());
+            os << "\n";
+        }
+    }
+    for (const auto &pt : proc->provenTrue) {
+        if (!ok)
+            break;
+        os << "proven";
+        ok = writeExp(os, pt.first) && writeExp(os, pt.second);
+        os << "\n";
+    }
+    if (!ok) {
+        LOG_VERBOSE(1) << "not caching " << proc->getName() << ": it uses types or expressions that can't be cached\n";
+        return false;
+    }
+    os.flush();
+
+    QSaveFile f(getFileName(k->second));
+    if (!f.open(QFile::WriteOnly | QFile::Text))
+        return false;
+    f.write(text.toUtf8());
+    if (!f.commit())
+        return false;
+    stores++;
+    return true;
+}
@@ -0,0 +1,94 @@
+/***************************************************************************/ /**
+  * \file       procprofile.cpp
+  * \brief   Implementation of the ProcProfile class
+  *
+  * The file is a JSON object with a "procedures" object, keyed by the hex address of each proc, of objects with its
+  * "name", "seconds", "statements" and whether its budget was "exhausted". Procs that were not decompiled in this run
+  * (e.g. those of other shards) keep what the file had for them.
+  ******************************************************************************/
+#include "procprofile.h"
+
+#include "log.h"
+#include "proc.h"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+ProcProfile &ProcProfile::get() {
+    static ProcProfile profile;
+    return profile;
+}
+
+/***************************************************************************/ /**
+  * \brief   Keep the profile in \a file, reading the profile of the previous run from it if there is one
+  * \returns false if there is a file that is not a profile; it is overwritten at the end
+  ******************************************************************************/
+bool ProcProfile::setPath(const QString &file) {
+    path = file;
+    previous.clear();
+    current.clear();
+    QFile f(path);
+    if (!f.exists())
+        return true;
+    if (!f.open(QFile::ReadOnly))
+        return false;
+    QJsonDocument doc(QJsonDocument::fromJson(f.readAll()));
+    if (!doc.isObject() || !doc.object()["procedures"].isObject())
+        return false;
+    QJsonObject procs(doc.object()["procedures"].toObject());
+    for (auto it = procs.begin(); it != procs.end(); ++it) {
+        bool ok;
+        ADDRESS a = ADDRESS::g(it.key().toULongLong(&ok, 16));
+        QJsonObject o(it.value().toObject());
+        if (!ok || !o["seconds"].isDouble())
+            continue;
+        Entry &e(previous[a]);
+        e.name = o["name"].toString();
+        e.seconds = o["seconds"].toDouble();
+        e.statements = (size_t)o["statements"].toDouble();
+        e.exhausted = o["exhausted"].toBool();
+    }
+    LOG_VERBOSE(1) << "read the profile of " << (int)previous.size() << " procedures from " << path << "\n";
+    return true;
+}
+
+//! Whether \a proc ran out of its budget in the previous run, or took longer than \a timeBudget seconds (if not 0)
+bool ProcProfile::isPathological(UserProc *proc, int timeBudget) const {
+    auto it = previous.find(proc->getNativeAddress());
+    if (it == previous.end())
+        return false;
+    return it->second.exhausted || (timeBudget > 0 && it->second.seconds >= timeBudget);
+}
+
+//! Record that \a proc, of \a statements when it was scheduled, took \a seconds to decompile in this run
+void ProcProfile::record(UserProc *proc, double seconds, size_t statements) {
+    Entry &e(current[proc->getNativeAddress()]);
+    e.name = proc->getName();
+    e.seconds += seconds;
+    e.statements = statements;
+    e.exhausted = e.exhausted || proc->isBudgetExhausted();
+}
+
+//! Write the profile, the previous one updated with this run, to the file it was read from
+bool ProcProfile::write() const {
+    std::map<ADDRESS, Entry> all(previous);
+    for (const auto &e : current)
+        all[e.first] = e.second;
+    QJsonObject procs;
+    for (const auto &e : all) {
+        QJsonObject o;
+        o["name"] = e.second.name;
+        o["seconds"] = e.second.seconds;
+        o["statements"] = (double)e.second.statements;
+        o["exhausted"] = e.second.exhausted;
+        procs[QString::number((qulonglong)e.first.m_value, 16)] = o;
+    }
+    QJsonObject root;
+    root["procedures"] = procs;
+    QFile f(path);
+    if (!f.open(QFile::WriteOnly | QFile::Truncate))
+        return false;
+    f.write(QJsonDocument(root).toJson());
+    return true;
+}
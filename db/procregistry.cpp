@@ -0,0 +1,90 @@
+/***************************************************************************/ /**
+  * \file       procregistry.cpp
+  * \brief   Implementation of the ProcRegistry class
+  ******************************************************************************/
+#include "procregistry.h"
+
+#include <algorithm>
+
+//! \returns the procedure at \a a, (Function *)-1 if it was deleted, or nullptr if there is none
+Function *ProcRegistry::find(ADDRESS a) const {
+    const Shard &shard(shardOf(a));
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto it = shard.procs.find(a.m_value);
+    return it == shard.procs.end() ? nullptr : it->second;
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief   The procedure at \a a; if there is none, \a make is called to make it, with the shard of \a a locked, so
+  *          that no other thread makes one at the same address meanwhile. \a make must not use the registry.
+  * \param   made - set to whether \a make was called
+  *
+  ******************************************************************************/
+Function *ProcRegistry::insertOrGet(ADDRESS a, const std::function<Function *()> &make, bool &made) {
+    Shard &shard(shardOf(a));
+    std::lock_guard<std::mutex> guard(shard.lock);
+    Function *&proc(shard.procs[a.m_value]);
+    made = proc == nullptr;
+    if (made)
+        proc = make();
+    return proc;
+}
+
+void ProcRegistry::set(ADDRESS a, Function *proc) {
+    Shard &shard(shardOf(a));
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.procs[a.m_value] = proc;
+}
+
+void ProcRegistry::erase(ADDRESS a) {
+    Shard &shard(shardOf(a));
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.procs.erase(a.m_value);
+}
+
+void ProcRegistry::clear() {
+    for (Shard &shard : shards) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.procs.clear();
+    }
+    std::lock_guard<std::mutex> guard(namesLock);
+    byName.clear();
+}
+
+//! \returns the first procedure added with the name whose handle is \a name, or nullptr if there is none
+Function *ProcRegistry::findByName(NameTable::Handle name) const {
+    std::lock_guard<std::mutex> guard(namesLock);
+    auto it = byName.find(name);
+    return it == byName.end() || it->second.empty() ? nullptr : it->second.front();
+}
+
+void ProcRegistry::addName(NameTable::Handle name, Function *proc) {
+    std::lock_guard<std::mutex> guard(namesLock);
+    byName[name].push_back(proc);
+}
+
+void ProcRegistry::removeName(NameTable::Handle name, Function *proc) {
+    std::lock_guard<std::mutex> guard(namesLock);
+    auto it = byName.find(name);
+    if (it == byName.end())
+        return;
+    std::vector<Function *> &procs(it->second);
+    procs.erase(std::remove(procs.begin(), procs.end(), proc), procs.end());
+    if (procs.empty())
+        byName.erase(it);
+}
+
+//! All the entries, sorted by address, e.g. to visit the procedures in an order that does not depend on the order in
+//! which threads found them
+std::vector<std::pair<ADDRESS, Function *>> ProcRegistry::byAddress() const {
+    std::vector<std::pair<ADDRESS, Function *>> res;
+    for (const Shard &shard : shards) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        for (const auto &entry : shard.procs)
+            res.push_back(std::make_pair(ADDRESS::g(entry.first), entry.second));
+    }
+    std::sort(res.begin(), res.end(), [](const std::pair<ADDRESS, Function *> &a,
+                                         const std::pair<ADDRESS, Function *> &b) { return a.first < b.first; });
+    return res;
+}
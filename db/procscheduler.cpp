@@ -0,0 +1,176 @@
+/***************************************************************************/ /**
+  * \file       procscheduler.cpp
+  * \brief   Implementation of the ProcScheduler class
+  ******************************************************************************/
+#include "procscheduler.h"
+
+#include "proc.h"
+#include "cfg.h"
+#include "basicblock.h"
+#include "rtl.h"
+#include "statement.h"
+
+#include <algorithm>
+#include <cassert>
+
+//! The user procs called from \a proc, in the order of their call BBs, as decompile() visits them
+void ProcScheduler::getCallees(UserProc *proc, std::vector<UserProc *> &callees) {
+    callees.clear();
+    Cfg *cfg = proc->getCFG();
+    if (cfg == nullptr)
+        return;
+    BB_IT it;
+    for (BasicBlock *bb = cfg->getFirstBB(it); bb; bb = cfg->getNextBB(it)) {
+        if (bb->getType() != BBTYPE::CALL || bb->getRTLs() == nullptr || bb->getRTLs()->empty())
+            continue;
+        Instruction *last = bb->getRTLs()->back()->getHlStmt();
+        if (last == nullptr || !last->isCall())
+            continue;
+        Function *dest = ((CallStatement *)last)->getDestProc();
+        if (dest == nullptr || dest->isLib())
+            continue;
+        callees.push_back((UserProc *)dest);
+    }
+}
+
+//! An estimate of the work of decompiling \a proc: the number of its statements, at least one
+size_t ProcScheduler::getCost(UserProc *proc) {
+    size_t res = 1;
+    Cfg *cfg = proc->getCFG();
+    if (cfg == nullptr)
+        return res;
+    for (BasicBlock *bb : *cfg) {
+        if (bb->getRTLs() == nullptr)
+            continue;
+        for (RTL *rtl : *bb->getRTLs())
+            res += rtl->size();
+    }
+    return res;
+}
+
+/***************************************************************************/ /**
+  * \brief   Find the recursion groups reachable from \a entries (Tarjan's algorithm, without recursion), and which
+  * groups are ready to decompile
+  *
+  * Procs that are already decompiled are left out, as are the calls to them.
+  ******************************************************************************/
+void ProcScheduler::build(const std::list<UserProc *> &entries) {
+    struct Frame {
+        UserProc *proc;
+        std::vector<UserProc *> callees;
+        size_t next;
+    };
+    std::map<UserProc *, int> dfnum, low;
+    std::set<UserProc *> onStack;
+    std::vector<UserProc *> stack;
+    std::vector<Frame> path;
+    int num = 0;
+    auto enter = [&](UserProc *p) {
+        dfnum[p] = low[p] = num++;
+        stack.push_back(p);
+        onStack.insert(p);
+        path.push_back(Frame{p, std::vector<UserProc *>(), 0});
+        getCallees(p, path.back().callees);
+    };
+    for (UserProc *entry : entries) {
+        if (entry->isDecompiled() || dfnum.count(entry))
+            continue;
+        enter(entry);
+        while (!path.empty()) {
+            Frame &f(path.back());
+            if (f.next < f.callees.size()) {
+                UserProc *c = f.callees[f.next++];
+                if (c->isDecompiled())
+                    continue;
+                if (dfnum.count(c) == 0)
+                    enter(c); // f may be invalid from here
+                else if (onStack.count(c))
+                    low[f.proc] = std::min(low[f.proc], dfnum[c]);
+                continue;
+            }
+            UserProc *p = f.proc;
+            path.pop_back();
+            if (!path.empty())
+                low[path.back().proc] = std::min(low[path.back().proc], low[p]);
+            if (low[p] != dfnum[p])
+                continue;
+            // p is the root of a group: pop it and everything above it
+            int g = groups.size();
+            groups.emplace_back();
+            size_t first = std::find(stack.begin(), stack.end(), p) - stack.begin();
+            for (size_t i = first; i < stack.size(); i++) {
+                groups.back().push_back(stack[i]);
+                groupOf[stack[i]] = g;
+                onStack.erase(stack[i]);
+            }
+            stack.resize(first);
+        }
+    }
+
+    callers.assign(groups.size(), std::vector<int>());
+    callees.assign(groups.size(), std::vector<int>());
+    pending.assign(groups.size(), 0);
+    preferred.assign(groups.size(), false);
+    cost.assign(groups.size(), 0);
+    recursive.assign(groups.size(), false);
+    std::vector<UserProc *> calledProcs;
+    for (size_t g = 0; g < groups.size(); g++) {
+        std::set<int> seen;
+        for (UserProc *p : groups[g]) {
+            cost[g] += getCost(p);
+            getCallees(p, calledProcs);
+            for (UserProc *c : calledProcs) {
+                auto cg = groupOf.find(c);
+                if (cg != groupOf.end() && cg->second == (int)g)
+                    recursive[g] = true;
+                if (cg == groupOf.end() || cg->second == (int)g || !seen.insert(cg->second).second)
+                    continue;
+                assert(cg->second < (int)g); // Callee groups are completed first
+                callers[cg->second].push_back(g);
+                callees[g].push_back(cg->second);
+                pending[g]++;
+            }
+        }
+        if (pending[g] == 0)
+            ready.insert(getReady(g));
+    }
+}
+
+//! The key of group \a g in the ready sets: the lowest numbered first, or the cheapest
+ProcScheduler::ReadyGroup ProcScheduler::getReady(int g) const { return ReadyGroup(cheapestFirst ? cost[g] : 0, g); }
+
+//! Take the next ready group, preferred groups first; only call when hasReady()
+int ProcScheduler::next() {
+    std::set<ReadyGroup> &from(readyPreferred.empty() ? ready : readyPreferred);
+    assert(!from.empty());
+    int g = from.begin()->second;
+    from.erase(from.begin());
+    return g;
+}
+
+//! Hand out the group of \a proc, and every group it calls into, before the other groups. Nothing happens if \a proc
+//! is not in the call graph
+void ProcScheduler::prefer(UserProc *proc) {
+    auto pg = groupOf.find(proc);
+    if (pg == groupOf.end())
+        return;
+    std::vector<int> work{pg->second};
+    while (!work.empty()) {
+        int g = work.back();
+        work.pop_back();
+        if (preferred[g])
+            continue;
+        preferred[g] = true;
+        if (ready.erase(getReady(g)))
+            readyPreferred.insert(getReady(g));
+        work.insert(work.end(), callees[g].begin(), callees[g].end());
+    }
+}
+
+//! Record that group \a g is decompiled, making ready those callers that were waiting only for it
+void ProcScheduler::finished(int g) {
+    for (int c : callers[g]) {
+        if (--pending[c] == 0)
+            (preferred[c] ? readyPreferred : ready).insert(getReady(c));
+    }
+}
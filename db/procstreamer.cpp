@@ -0,0 +1,190 @@
+/***************************************************************************/ /**
+  * \file       procstreamer.cpp
+  * \brief   Implementation of the ProcStreamer class
+  ******************************************************************************/
+#include "procstreamer.h"
+
+#include "boomerang.h"
+#include "cfg.h"
+#include "hllcode.h"
+#include "log.h"
+#include "module.h"
+#include "proc.h"
+#include "proccache.h"
+#include "procscheduler.h"
+#include "prog.h"
+
+#include <QTextStream>
+
+#include <algorithm>
+
+ProcStreamer::ProcStreamer(Prog *_prog, const ProcScheduler &scheduler) : prog(_prog) {
+    std::vector<UserProc *> dests;
+    for (size_t g = 0; g < scheduler.getNumGroups(); g++) {
+        for (UserProc *p : scheduler.getGroup(g))
+            groupOf[p] = g;
+    }
+    for (const auto &pg : groupOf) {
+        ProcScheduler::getCallees(pg.first, dests);
+        for (UserProc *c : dests) {
+            if (groupOf.count(c) == 0)
+                continue; // Already decompiled when the graph was built
+            std::vector<UserProc *> &cs(callees[pg.first]);
+            if (std::find(cs.begin(), cs.end(), c) != cs.end())
+                continue;
+            cs.push_back(c);
+            callers[c].push_back(pg.first);
+        }
+    }
+}
+
+//! A proc can be settled when it and all its callers are final
+bool ProcStreamer::canSettle(UserProc *proc) const {
+    if (settled.count(proc) || !proc->isDecompiled() || proc->getCFG() == nullptr)
+        return false;
+    auto cc = callers.find(proc);
+    if (cc == callers.end())
+        return true;
+    for (UserProc *c : cc->second) {
+        if (!c->isDecompiled())
+            return false;
+    }
+    return true;
+}
+
+//! A settled proc can be emitted when all its callees are settled
+bool ProcStreamer::canGenerate(UserProc *proc) const {
+    if (!settled.count(proc) || emitted.count(proc))
+        return false;
+    auto cc = callees.find(proc);
+    if (cc == callees.end())
+        return true;
+    for (UserProc *c : cc->second) {
+        if (!settled.count(c))
+            return false;
+    }
+    return true;
+}
+
+//! An emitted proc can be released when all its callers are emitted
+bool ProcStreamer::canRelease(UserProc *proc) const {
+    if (!emitted.count(proc) || released.count(proc))
+        return false;
+    auto cc = callers.find(proc);
+    if (cc == callers.end())
+        return true;
+    for (UserProc *c : cc->second) {
+        if (!emitted.count(c))
+            return false;
+    }
+    return true;
+}
+
+//! Do for \a proc the stages Prog::decompile() does for all procs after they are all final
+void ProcStreamer::settle(UserProc *proc) {
+    DecompilerContext *ctx = prog->getContext();
+    settled.insert(proc);
+    if (ProcCache::get().isEnabled())
+        ProcCache::get().store(proc);
+    proc->typeAnalysis();
+    if (!ctx->noDecompile && !ctx->noRemoveReturns) {
+        // Only this proc: those the removal would have looked at again have been settled, and perhaps emitted, or
+        // will be settled later
+        bool change;
+        do {
+            std::set<UserProc *> removeRetSet{proc};
+            change = proc->removeRedundantReturns(removeRetSet);
+        } while (change);
+        proc->printXML();
+    }
+    proc->fromSSAform();
+}
+
+//! Generate the code of \a proc, and keep it and its prototype; count the globals it uses
+void ProcStreamer::generate(UserProc *proc) {
+    emitted.insert(proc);
+    prog->countGlobalRefs(proc);
+    proc->getCFG()->compressCfg();
+    proc->getCFG()->removeOrphanBBs();
+
+    HLLCode *hll = Boomerang::get()->getHLLCode(proc);
+    proc->generateCode(hll);
+    QString &moduleCode(code[proc->getParent()]);
+    int start = moduleCode.length();
+    QTextStream os(&moduleCode);
+    hll->print(os);
+    os.flush();
+    delete hll;
+    if (!streamedFile.isOpen()) {
+        streamedFile.setFileName(Boomerang::get()->getOutputPath() + "streamed.c");
+        streamedFile.open(QFile::WriteOnly | QFile::Text | QFile::Truncate);
+    }
+    if (streamedFile.isOpen()) {
+        QTextStream ss(&streamedFile);
+        ss << "// " << proc->getName() << ", of module " << proc->getParent()->getName() << "\n"
+           << moduleCode.midRef(start) << "\n";
+        ss.flush();
+        streamedFile.flush();
+    }
+
+    hll = Boomerang::get()->getHLLCode(proc);
+    hll->AddPrototype(proc);
+    QTextStream ps(&prototypes[proc]);
+    hll->print(ps);
+    delete hll;
+    LOG_VERBOSE(1) << "streamed code for " << proc->getName() << "\n";
+}
+
+/***************************************************************************/ /**
+  * \brief   Settle, emit and release what the completion of \a group allows: the group itself and the procs it calls
+  * (whose callers may now all be final), then their callers (whose callees may now all be settled)
+  ******************************************************************************/
+void ProcStreamer::groupFinished(const std::vector<UserProc *> &group) {
+    std::set<UserProc *> cands;
+    for (UserProc *p : group) {
+        cands.insert(p);
+        auto cc = callees.find(p);
+        if (cc != callees.end())
+            cands.insert(cc->second.begin(), cc->second.end());
+    }
+    // Callers first, so that each removal of returns sees the uses of the callers as they will be emitted
+    std::vector<UserProc *> order(cands.begin(), cands.end());
+    std::sort(order.begin(), order.end(), [this](UserProc *a, UserProc *b) { return groupOf[a] > groupOf[b]; });
+    std::set<UserProc *> toEmit;
+    for (UserProc *p : order) {
+        if (!canSettle(p))
+            continue;
+        settle(p);
+        toEmit.insert(p);
+        auto cc = callers.find(p);
+        if (cc != callers.end())
+            toEmit.insert(cc->second.begin(), cc->second.end());
+    }
+    std::set<UserProc *> toRelease;
+    for (UserProc *p : toEmit) {
+        if (!canGenerate(p))
+            continue;
+        generate(p);
+        toRelease.insert(p);
+        auto cc = callees.find(p);
+        if (cc != callees.end())
+            toRelease.insert(cc->second.begin(), cc->second.end());
+    }
+    for (UserProc *p : toRelease) {
+        if (!canRelease(p))
+            continue;
+        released.insert(p);
+        p->deleteCFG();
+    }
+}
+
+//! The code emitted so far for the procs of \a module
+QString ProcStreamer::getCode(Module *module) const {
+    auto it = code.find(module);
+    return it == code.end() ? QString() : it->second;
+}
+
+QString ProcStreamer::getPrototype(UserProc *proc) const {
+    auto it = prototypes.find(proc);
+    return it == prototypes.end() ? QString() : it->second;
+}
@@ -39,8 +39,16 @@
 #include "config.h"
 #include "managed.h"
 #include "log.h"
+#include "procscheduler.h"
+#include "procstreamer.h"
+#include "passes/PassManager.h"
+#include "proccache.h"
+#include "stats.h"
+#include "procprofile.h"
+#include "memstats.h"
 #include "BinaryImage.h"
 #include "db/SymTab.h"
+#include "outputwriter.h"
 
 #include <QtCore/QFileInfo>
 #include <QtCore/QDebug>
@@ -48,6 +56,7 @@
 #include <QtCore/QDir>
 #include <QtCore/QString>
 #include <cassert>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
@@ -69,7 +78,27 @@ namespace dbghelp {
 
 #include <sys/types.h>
 
-Prog::Prog() : pLoaderPlugin(nullptr), DefaultFrontend(nullptr), m_iNumberedProc(1) {
+/**
+ * The state of a round of global type analysis with -Tg. The procs of a round all start from the global types as they
+ * were at its beginning; what each proc changes is kept as its own view (seen only by itself) and proposed at the end
+ * of its analysis. mergeGlobalTypes() then meets the proposals for each global, so that the types at the end of a round
+ * do not depend on the order the procs were analysed in. (Globals first seen in the round are still created at once,
+ * with the type of the proc that sees them first.)
+ */
+struct GlobalTypeRound {
+    UserProc *proc = nullptr;                //!< The proc being analysed
+    std::map<QString, SharedType> view;      //!< Its changes to the global types so far
+    std::map<QString, std::vector<std::pair<UserProc *, SharedType>>> proposals;
+    std::map<QString, std::set<UserProc *>> readers; //!< The procs that looked at each global
+    void propose() {
+        for (const auto &v : view)
+            proposals[v.first].emplace_back(proc, v.second);
+        view.clear();
+        proc = nullptr;
+    }
+};
+
+Prog::Prog() : pLoaderPlugin(nullptr), DefaultFrontend(nullptr), Context(Boomerang::get()), m_iNumberedProc(1) {
     m_rootCluster = getOrInsertModule("prog");
     Image = Boomerang::get()->getImage();
     BinarySymbols = (SymTab *)Boomerang::get()->getSymbols();
@@ -107,7 +136,7 @@ void Prog::setFrontEnd(FrontEnd *_pFE) {
 }
 
 Prog::Prog(const char *name)
-    : pLoaderPlugin(nullptr), DefaultFrontend(nullptr), m_name(name), m_iNumberedProc(1) {
+    : pLoaderPlugin(nullptr), DefaultFrontend(nullptr), Context(Boomerang::get()), m_name(name), m_iNumberedProc(1) {
     m_rootCluster = getOrInsertModule(getNameNoPathNoExt());
     // Constructor taking a name. Technically, the allocation of the space for the name could fail, but this is unlikely
     m_path = m_name;
@@ -117,6 +146,9 @@ Prog::Prog(const char *name)
 Prog::~Prog() {
     pLoaderPlugin->deleteLater();
     delete DefaultFrontend;
+    delete streamer;
+    finishDumps();
+    ProcCache::get().clear(); // Its hashes are by proc
     for (Module *m : ModuleList) {
         delete m;
     }
@@ -161,20 +193,29 @@ void Prog::finishDecode() {
 }
 //! Generate dotty file
 void Prog::generateDotFile() {
-    assert(!Boomerang::get()->dotFile.isEmpty());
-    QFile tgt(Boomerang::get()->dotFile);
+    assert(!Context->dotFile.isEmpty());
+    QFile tgt(Context->dotFile);
     if(!tgt.open(QFile::WriteOnly|QFile::Text))
         return;
 
     QTextStream of(&tgt);
     of << "digraph Cfg {\n";
 
+    // With --graph-depth or --graph-module, only the CFGs of that part of the call graph
+    bool limited = Context->graphDepth > 0 || !Context->graphModule.isEmpty();
+    std::set<Function *> inGraph;
+    if (limited)
+        inGraph = getGraphProcs();
     for (Module *module : ModuleList) {
         for (Function *func : *module) {
             if (func->isLib())
                 continue;
+            if (limited && (!inGraph.count(func) || !isInGraph(func)))
+                continue;
             UserProc *p = (UserProc *)func;
-            if (!p->isDecoded())
+            if (!p->isDecoded() || p->getCFG() == nullptr)
+                continue; // Not decoded, or released by the ProcStreamer
+            if (!Context->isDebugProc(p->getName()))
                 continue;
             // Subgraph for the proc name
             of << "\nsubgraph cluster_" << p->getName() << " {\n"
@@ -186,21 +227,127 @@ void Prog::generateDotFile() {
     of << "}";
 }
 
+namespace {
+//! The bytes of a section, as unsigned values
+class SectionBytes : public ArrayInitializer {
+    Prog *prog;
+    ADDRESS at, end;
+    Const elem{0};
+
+  public:
+    SectionBytes(Prog *prog, ADDRESS start, uint32_t size) : prog(prog), at(start), end(start + size) {}
+    const Exp *next() override {
+        if (at >= end)
+            return nullptr;
+        elem.setInt(prog->readNative1(at) & 0xFF);
+        at += 1;
+        return &elem;
+    }
+};
+
+//! The elements of an array global, read as Prog::readNativeAs() reads them
+class GlobalArrayElements : public ArrayInitializer {
+    Prog *prog;
+    ADDRESS addr;
+    SharedType base;
+    int baseSize;
+    int intSize = 0;  //!< Size in bits of the integer elements that are read straight into elem, or 0
+    int nelems = -1;  //!< -1 for up to and including a null element
+    int i = 0;
+    bool done = false;
+    const IBinarySection *section = nullptr; //!< The section of the last element read
+    std::vector<int> table; //!< All nelems elements of 16 or 32 bits, when they could be read at once
+    Const elem{0};
+
+  public:
+    GlobalArrayElements(Prog *prog, ADDRESS addr, std::shared_ptr<ArrayType> type, int nelems)
+        : prog(prog), addr(addr), base(type->getBaseType()), baseSize(base->getSize() / 8), nelems(nelems) {
+        if (base->resolvesToInteger() || base->resolvesToSize()) {
+            int size = base->resolvesToInteger() ? base->asInteger()->getSize() : base->asSize()->getSize();
+            if (size == 8 || size == 16 || size == 32)
+                intSize = size;
+        }
+        // A known number of words is read and swapped in one go, rather than an element at a time
+        if (nelems > 0 && intSize == 16 && baseSize == 2)
+            prog->readNative2Table(addr, nelems, table);
+        else if (nelems > 0 && intSize == 32 && baseSize == 4)
+            prog->readNative4Table(addr, nelems, table);
+    }
+    const Exp *next() override {
+        if (done || (nelems != -1 && i >= nelems))
+            return nullptr;
+        ADDRESS at = addr + i++ * baseSize;
+        const Exp *v = nullptr;
+        if (!table.empty()) {
+            elem.setInt(table[i - 1]);
+            v = &elem;
+        } else if (intSize) {
+            if (section == nullptr || at < section->sourceAddr() || at >= section->sourceAddr() + section->size())
+                section = prog->getSectionInfoByAddr(at);
+            if (section) {
+                switch (intSize) {
+                case 8:
+                    elem.setInt(prog->readNative1(at));
+                    break;
+                case 16:
+                    elem.setInt(prog->readNative2(at));
+                    break;
+                default:
+                    elem.setInt(prog->readNative4(at));
+                }
+                v = &elem;
+            }
+        } else
+            v = prog->readNativeAs(at, base);
+        if (v == nullptr)
+            done = true;
+        // "null" terminated
+        else if (nelems == -1 && v->isConst() && ((const Const *)v)->getInt() == 0)
+            done = true;
+        return v;
+    }
+};
+}
+
 void Prog::generateDataSectionCode(QString section_name, ADDRESS section_start, uint32_t size, HLLCode *code)
 {
     code->AddGlobal("start_" + section_name, IntegerType::get(32, -1), new Const(section_start));
     code->AddGlobal(section_name + "_size", IntegerType::get(32, -1), new Const(size ? size : (unsigned int)-1));
-    Exp *l = new Terminal(opNil);
-    for (unsigned int i = 0; i < size; i++) {
-        int n = Image->readNative1(section_start + size - 1 - i);
-        if (n < 0)
-            n = 256 + n;
-        l = Binary::get(opList, new Const(n), l);
+    // Sections can be megabytes, so the bytes go straight to the code rather than into an opList first
+    SectionBytes bytes(this, section_start, size);
+    code->AddGlobal(section_name, ArrayType::get(IntegerType::get(8, -1), size), bytes);
+}
+
+/**
+ * Add the declaration of \a glob to \a code, with its initial value if it has one; without one, only if \a always.
+ * The elements of an initialised array are read as they are written, rather than into an opList first.
+ */
+void Prog::declareGlobal(Global *glob, HLLCode *code, bool always) {
+    SharedType ty = glob->getType();
+    ADDRESS uaddr = glob->getAddress();
+    const IBinarySection *si = getSectionInfoByAddr(uaddr);
+    if (si && !si->isAddressBss(uaddr) && ty->resolvesToArray() &&
+        !(ty->asArray()->getBaseType()->resolvesToChar() && getStringConstant(uaddr, true))) {
+        // As Prog::readNativeAs()
+        int nelems = -1;
+        QString nam = getGlobalName(uaddr);
+        if (!nam.isEmpty()) {
+            auto symbol = BinarySymbols->find(nam);
+            nelems = symbol ? symbol->getSize() : 0;
+            assert(ty->asArray()->getBaseType()->getSize() / 8);
+            nelems /= ty->asArray()->getBaseType()->getSize() / 8;
+        }
+        GlobalArrayElements elems(this, uaddr, ty->asArray(), nelems);
+        code->AddGlobal(glob->getName(), ty, elems);
+        return;
     }
-    code->AddGlobal(section_name, ArrayType::get(IntegerType::get(8, -1), size), l);
+    Exp *e = glob->getInitialValue(this);
+    if (e || always)
+        code->AddGlobal(glob->getName(), ty, e);
 }
 
 void Prog::generateCode(Module *cluster, UserProc *proc, bool /*intermixRTL*/) {
+    ContextScope inContext(Context);
     // QString basedir = m_rootCluster->makeDirs();
     QTextStream *os;
     if (cluster) {
@@ -209,13 +356,40 @@ void Prog::generateCode(Module *cluster, UserProc *proc, bool /*intermixRTL*/) {
     }
     bool generate_all = cluster == nullptr || cluster == m_rootCluster;
     bool all_procedures = proc==nullptr;
+    // With --split-output, the modules are written by another thread as each is finished, and the prototypes go to
+    // an index header that all of them include, rather than to the top of the root module
+    bool split = Context->splitOutput && cluster == nullptr && all_procedures;
+    OutputWriter writer;
+    QString header, headerPath;
+    QTextStream headerStream(&header);
+    if (split) {
+        for (Module *module : ModuleList)
+            module->setWriter(&writer);
+        headerPath = m_rootCluster->getOutPath("h");
+        QString guard = m_rootCluster->getName().toUpper();
+        for (QChar &c : guard)
+            if (!c.isLetterOrNumber())
+                c = '_';
+        headerStream << "/* Prototypes of the procedures of " << m_rootCluster->getName() << ", in the files\n";
+        for (Module *module : ModuleList)
+            headerStream << " *   " << QDir(QFileInfo(headerPath).absolutePath())
+                                          .relativeFilePath(module->getOutPath("c")) << "\n";
+        headerStream << " */\n#ifndef " << guard << "_H\n#define " << guard << "_H\n\n";
+    }
+    auto includeHeader = [&](Module *module) {
+        if (split)
+            module->getStream() << "#include \""
+                                << QDir(QFileInfo(module->getOutPath("c")).absolutePath()).relativeFilePath(headerPath)
+                                << "\"\n\n";
+    };
     if (generate_all) {
         m_rootCluster->openStream("c");
         os = &m_rootCluster->getStream();
+        includeHeader(m_rootCluster);
         if (proc == nullptr) {
             HLLCode *code = Boomerang::get()->getHLLCode();
             bool global = false;
-            if (Boomerang::get()->noDecompile) {
+            if (Context->noDecompile) {
                 const char *sections[] = {"rodata", "data", "data1", nullptr};
                 for (int j = 0; sections[j]; j++) {
                     QString str = ".";
@@ -233,10 +407,7 @@ void Prog::generateCode(Module *cluster, UserProc *proc, bool /*intermixRTL*/) {
                 global = true;
             }
             for (Global *elem : globals) {
-                // Check for an initial value
-                Exp *e = elem->getInitialValue(this);
-                //                if (e) {
-                code->AddGlobal(elem->getName(), elem->getType(), e);
+                declareGlobal(elem, code, true);
                 global = true;
             }
             if (global)
@@ -245,6 +416,7 @@ void Prog::generateCode(Module *cluster, UserProc *proc, bool /*intermixRTL*/) {
     }
 
     // First declare prototypes for all but the first proc
+    QTextStream *protoStream = split ? &headerStream : os;
     bool first = true, proto = false;
     for ( Module *module : ModuleList) {
         for (Function *func : *module) {
@@ -254,45 +426,82 @@ void Prog::generateCode(Module *cluster, UserProc *proc, bool /*intermixRTL*/) {
                 first = false;
                 continue;
             }
-            proto = true;
             UserProc *up = (UserProc *)func;
+            if (shardWaiting.count(up))
+                continue; // Another run of this shard writes it
+            proto = true;
+            if (streamer && streamer->isGenerated(up)) {
+                if (generate_all)
+                    *protoStream << streamer->getPrototype(up);
+                continue;
+            }
             HLLCode *code = Boomerang::get()->getHLLCode(up);
             code->AddPrototype(up); // May be the wrong signature if up has ellipsis
             if (generate_all)
-                code->print(*os);
+                code->print(*protoStream);
             delete code;
         }
     }
     if (proto && generate_all)
-        *os << "\n"; // Separate prototype(s) from first proc
+        *protoStream << "\n"; // Separate prototype(s) from first proc
+    if (split) {
+        headerStream << "#endif\n";
+        headerStream.flush();
+        writer.write(headerPath, header.toLocal8Bit());
+    }
 
     for ( Module *module : ModuleList) {
         if(!generate_all && cluster!=module) {
             continue;
         }
         module->openStream("c");
+        stmtsByLex.erase(module);
+        if (module != m_rootCluster)
+            includeHeader(module);
+        if (streamer && all_procedures)
+            module->getStream() << streamer->getCode(module);
         for (Function *func : *module) {
             if (func->isLib())
                 continue;
             UserProc *up = (UserProc *)func;
-            if (!up->isDecoded())
+            if (!up->isDecoded() || shardWaiting.count(up))
                 continue;
             if (!all_procedures && up != proc)
                 continue;
+            if (streamer && streamer->isGenerated(up))
+                continue; // Written above
             up->getCFG()->compressCfg();
             up->getCFG()->removeOrphanBBs();
 
             HLLCode *code = Boomerang::get()->getHLLCode(up);
             up->generateCode(code);
+            recordStmtRanges(module, code);
             code->print(module->getStream());
             delete code;
         }
+        if (split)
+            module->closeStream(); // Written while the next module is generated
     }
     for ( Module *module : ModuleList)
         module->closeStreams();
+    if (split) {
+        writer.finish();
+        for (Module *module : ModuleList)
+            module->setWriter(nullptr);
+        for (const QString &failed : writer.getFailures())
+            LOG << "could not write " << failed << "\n";
+    }
+    if (Arena::isEnabled() && generate_all && all_procedures) {
+        // The whole program has been written out; the IR is no longer needed
+        for (Module *module : ModuleList)
+            for (Function *func : *module)
+                if (!func->isLib())
+                    ((UserProc *)func)->deleteCFG();
+    }
 }
 
 void Prog::generateRTL(Module *cluster, UserProc *proc) {
+    ContextScope inContext(Context);
     bool generate_all = cluster==nullptr;
     bool all_procedures = proc==nullptr;
     for(Module *module : ModuleList) {
@@ -314,21 +523,48 @@ void Prog::generateRTL(Module *cluster, UserProc *proc) {
         module->closeStreams();
 }
 
+/***************************************************************************/ /**
+  *
+  * \brief   Record where the code of each statement of \a code, which is about to be printed to the stream of
+  *          \a module, is in the file of the module; also set the lexical range of each statement to it
+  *
+  ******************************************************************************/
+void Prog::recordStmtRanges(Module *module, HLLCode *code) {
+    qint64 start = module->getStream().pos();
+    if (start < 0)
+        return;
+    std::vector<HLLCode::StmtRange> ranges;
+    code->getStmtRanges(ranges);
+    std::map<unsigned, LexRange> &index(stmtsByLex[module]);
+    for (const HLLCode::StmtRange &r : ranges) {
+        unsigned begin = (unsigned)start + r.begin, end = (unsigned)start + r.end;
+        r.stmt->setLexBegin(begin);
+        r.stmt->setLexEnd(end);
+        index[begin] = LexRange{end, r.stmt};
+    }
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief   The statement whose code, as last written by generateCode, contains position \a begin of the file of
+  *          \a cluster (of any module if nullptr) and, unless \a end is -1, goes on past \a end
+  * \returns the statement, or nullptr if there is none
+  *
+  ******************************************************************************/
 Instruction *Prog::getStmtAtLex(Module *cluster, unsigned int begin, unsigned int end) {
-    bool search_all = cluster==nullptr;
-    for(Module *m : ModuleList) {
-        if(!search_all && m!=cluster)
+    for (Module *m : ModuleList) {
+        if (cluster != nullptr && m != cluster)
             continue;
-        for (Function *pProc : *m) {
-            if (pProc->isLib())
-                continue;
-            UserProc *p = (UserProc *)pProc;
-            if (!p->isDecoded())
-                continue;
-            Instruction *s = p->getStmtAtLex(begin, end);
-            if (s)
-                return s;
-        }
+        auto mod = stmtsByLex.find(m);
+        if (mod == stmtsByLex.end())
+            continue;
+        // The code of statements doesn't overlap, so only the last one beginning at or before begin can contain it
+        auto it = mod->second.upper_bound(begin);
+        if (it == mod->second.begin())
+            continue;
+        --it;
+        if (begin <= it->second.end && (end == (unsigned)-1 || end < it->second.end))
+            return it->second.stmt;
     }
     return nullptr;
 }
@@ -356,14 +592,10 @@ Module *Prog::getDefaultModule(const QString &name) {
 }
 
 void Prog::generateCode(QTextStream &os) {
+    ContextScope inContext(Context);
     HLLCode *code = Boomerang::get()->getHLLCode();
-    for (Global *glob : globals) {
-        // Check for an initial value
-        Exp *e = nullptr;
-        e = glob->getInitialValue(this);
-        if (e)
-            code->AddGlobal(glob->getName(), glob->getType(), e);
-    }
+    for (Global *glob : globals)
+        declareGlobal(glob, code, false);
     code->print(os);
     delete code;
     for (Module * module : ModuleList) {
@@ -404,6 +636,11 @@ void Prog::clear() {
     for (Module * module : ModuleList)
         delete module;
     ModuleList.clear();
+    procRegistry.clear();
+    objcClasses.clear();
+    objcClassOfMethod.clear();
+    stmtsByLex.clear();
+    switchTargets.clear();
     pLoaderPlugin->deleteLater();
     pLoaderPlugin = nullptr;
     delete DefaultFrontend;
@@ -434,6 +671,7 @@ Function *Prog::setNewProc(ADDRESS uAddr) {
     ADDRESS other = pLoaderIface->IsJumpToAnotherAddr(uAddr);
     if (other != NO_ADDRESS)
         uAddr = other;
+    makeObjcClassAt(uAddr);
     pProc = findProc(uAddr);
     if (pProc) // Exists already ?
         return pProc; // Yes, we are done
@@ -444,15 +682,103 @@ Function *Prog::setNewProc(ADDRESS uAddr) {
         bLib = sym->isImportedFunction() || sym->isStaticFunction();
         pName = sym->getName();
     }
-    if (pName.isEmpty()) {
-        // No name. Give it a numbered name
-        pName = QString("proc%1").arg(m_iNumberedProc++);
-        LOG_VERBOSE(1) << "assigning name " << pName << " to addr " << uAddr << "\n";
+    if (!bLib && DefaultFrontend) {
+        // Statically linked library code need not be decompiled: recognised, it gets the library's signature instead
+        QString libName = DefaultFrontend->findLibraryFunction(uAddr);
+        if (!libName.isEmpty() && !findProc(libName)) {
+            LOG_VERBOSE(1) << "recognised library function " << libName << " at " << uAddr << "\n";
+            DecompileStats::get().count(nullptr, "fingerprints", "matches");
+            pName = libName;
+            bLib = true;
+        }
     }
-    pProc = m_rootCluster->getOrInsertFunction(pName,uAddr, bLib);
+    // Only the Function is made with the registry locked, so that no other discovery of uAddr makes another; it is
+    // added to its module (which alerts the watchers) after
+    bool made;
+    pProc = procRegistry.insertOrGet(uAddr, [&]() -> Function * {
+        if (pName.isEmpty()) {
+            // No name. Give it a numbered name
+            pName = QString("proc%1").arg(m_iNumberedProc++);
+            LOG_VERBOSE(1) << "assigning name " << pName << " to addr " << uAddr << "\n";
+        }
+        return m_rootCluster->createFunction(pName, uAddr, bLib);
+    }, made);
+    if (!made)
+        return pProc == (Function *)-1 ? nullptr : pProc;
+    m_rootCluster->addFunction(pProc);
+    if (!bLib)
+        decodeQueue.push_back(uAddr);
     return pProc;
 }
 
+/***************************************************************************/ /**
+  * \brief   Note an Objective-C class of the binary, with its methods
+  *
+  * Large Cocoa binaries have thousands of classes, so nothing is made for one yet: its cluster and the procs of all
+  * its methods are made when one of them is first wanted (by setNewProc()), or by makeObjcClasses() when every proc
+  * is to be decoded.
+  ******************************************************************************/
+void Prog::addObjcClass(const QString &module, const QString &name,
+                        const std::vector<std::pair<QString, ADDRESS>> &methods) {
+    std::lock_guard<std::mutex> guard(objcLock);
+    ObjcClassInfo cls;
+    cls.module = module;
+    cls.name = name;
+    cls.methods = methods;
+    cls.made = false;
+    for (const std::pair<QString, ADDRESS> &m : methods)
+        objcClassOfMethod[m.second] = objcClasses.size();
+    objcClasses.push_back(cls);
+}
+
+//! Make the procs of the methods of all the Objective-C classes not made yet
+void Prog::makeObjcClasses() {
+    std::lock_guard<std::mutex> guard(objcLock);
+    for (ObjcClassInfo &cls : objcClasses)
+        makeObjcClass(cls);
+}
+
+//! Make the Objective-C class with a method at \a a, if there is one and it is not made yet
+void Prog::makeObjcClassAt(ADDRESS a) {
+    std::lock_guard<std::mutex> guard(objcLock);
+    auto it = objcClassOfMethod.find(a);
+    if (it != objcClassOfMethod.end())
+        makeObjcClass(objcClasses[it->second]);
+}
+
+//! Make the cluster of \a cls and the procs of its methods; objcLock is held
+void Prog::makeObjcClass(ObjcClassInfo &cls) {
+    if (cls.made)
+        return;
+    cls.made = true;
+    ClassModFactory class_fact;
+    Module *cl = getOrInsertModule(cls.module, class_fact);
+    m_rootCluster->addChild(cl);
+    LOG_VERBOSE(1) << "making Objective-C class " << cls.name << "\n";
+    for (const std::pair<QString, ADDRESS> &m : cls.methods) {
+        Function *existing = findProc(m.first);
+        if (existing) {
+            assert(!"Name clash in objc processor ?");
+            continue;
+        }
+        Function *p = cl->getOrInsertFunction(m.first, m.second);
+        p->setSignature(Signature::instantiate(getFrontEndId(), CONV_C, m.first));
+        // TODO: decode types in the method's types
+    }
+}
+
+/***************************************************************************/ /**
+  * \brief   Take the next entry point off the queue of procedures to decode
+  * \returns false when the queue is empty
+  ******************************************************************************/
+bool Prog::nextToDecode(ADDRESS &a) {
+    if (decodeQueue.empty())
+        return false;
+    a = decodeQueue.front();
+    decodeQueue.pop_front();
+    return true;
+}
+
 #if defined(_WIN32) && !defined(__MINGW32__)
 
 SharedType typeFromDebugInfo(int index, DWORD64 ModBase);
@@ -603,7 +929,7 @@ void Prog::removeProc(const QString &name) {
     Function *f = findProc(name);
     if(f && f!=(Function *)-1) {
         f->removeFromParent();
-        Boomerang::get()->alertRemove(f);
+        Context->alertRemove(f);
         //FIXME: this function removes the function from module, but it leaks it
     }
 }
@@ -637,13 +963,7 @@ int Prog::getNumProcs(bool user_only) {
   * \returns Pointer to the Proc object, or 0 if none, or -1 if deleted
   ******************************************************************************/
 Function *Prog::findProc(ADDRESS uAddr) const {
-    for(Module *m : ModuleList)
-    {
-        Function *r = m->getFunction(uAddr);
-        if(r!=nullptr)
-            return r;
-    }
-    return nullptr;
+    return procRegistry.find(uAddr);
 }
 /***************************************************************************/ /**
   * \brief    Return a pointer to the associated Proc object, or nullptr if none
@@ -652,12 +972,8 @@ Function *Prog::findProc(ADDRESS uAddr) const {
   * \returns Pointer to the Proc object, or 0 if none, or -1 if deleted
   ******************************************************************************/
 Function *Prog::findProc(const QString &name) const {
-    for(Module *m : ModuleList) {
-        Function *f = m->getFunction(name);
-        if(f)
-            return f;
-    }
-    return nullptr;
+    NameTable::Handle h = NameTable::find(name);
+    return h ? procRegistry.findByName(h) : nullptr;
 }
 
 //! lookup a library procedure by name; create if does not exist
@@ -684,13 +1000,48 @@ bool Prog::isWin32() {
 }
 //! Get a global variable if possible, looking up the loader's symbol table if necessary
 QString Prog::getGlobalName(ADDRESS uaddr) {
-    // FIXME: inefficient
-    for (Global *glob : globals) {
-        if (glob->addressWithinGlobal(uaddr))
-            return glob->getName();
-    }
+    Global *glob = findGlobalContaining(uaddr);
+    if (glob)
+        return glob->getName();
     return symbolByAddress(uaddr);
 }
+
+void Prog::addGlobal(Global *global) {
+    globals.insert(global);
+    globalsByAddress.insert(std::make_pair(global->getAddress(), global));
+    globalsByName.insert(std::make_pair(NameTable::intern(global->getName()), global));
+    globalsVersion++;
+}
+
+void Prog::clearGlobals() {
+    globals.clear();
+    globalsByAddress.clear();
+    globalsByName.clear();
+    globalsVersion++;
+}
+
+//! The global whose extent covers \a uaddr (see Global::addressWithinGlobal), the closest one below it if several do
+Global *Prog::findGlobalContaining(ADDRESS uaddr) {
+    for (;;) {
+        auto it = globalsByAddress.upper_bound(uaddr);
+        while (it != globalsByAddress.begin()) {
+            --it;
+            Global *glob = it->second;
+            if (glob->addressWithinGlobal(uaddr))
+                return glob;
+            if ((uaddr - glob->getAddress()).m_value > maxGlobalBytes)
+                break; // Too far below for any global to reach
+        }
+        if (maxGlobalBytesVersion == globalsVersion)
+            return nullptr;
+        // The bound may be stale: a miss is only final once it is based on the current sizes
+        maxGlobalBytes = 0;
+        for (Global *glob : globals)
+            if (glob->getType())
+                maxGlobalBytes = std::max(maxGlobalBytes, glob->getType()->getBytes());
+        maxGlobalBytesVersion = globalsVersion;
+    }
+}
 //! Dump the globals to stderr for debugging
 void Prog::dumpGlobals() {
     for (Global *glob : globals) {
@@ -707,20 +1058,24 @@ ADDRESS Prog::getGlobalAddr(const QString &nam) {
 }
 
 Global *Prog::getGlobal(const QString &nam) {
-    auto iter =
-            std::find_if(globals.begin(), globals.end(), [nam](Global *g) -> bool { return g->getName()==nam; });
-    if (iter == globals.end())
+    auto iter = globalsByName.find(NameTable::find(nam));
+    if (iter == globalsByName.end())
         return nullptr;
-    return *iter;
+    return iter->second;
 }
 //! Indicate that a given global has been seen used in the program.
 bool Prog::globalUsed(ADDRESS uaddr, SharedType knownType) {
-    for (Global *glob : globals) {
-        if (glob->addressWithinGlobal(uaddr)) {
-            if (knownType)
-                glob->meetType(knownType);
-            return true;
-        }
+    Global *glob = findGlobalContaining(uaddr);
+    if (glob) {
+        if (knownType && typeRound && typeRound->proc) {
+            bool ch = false;
+            SharedType cur = getGlobalType(glob->getName());
+            SharedType ty = cur ? cur->meetWith(knownType, ch) : knownType;
+            if (ch || cur == nullptr)
+                typeRound->view[glob->getName()] = ty;
+        } else if (knownType)
+            glob->meetType(knownType);
+        return true;
     }
 
     if (Image->getSectionInfoByAddr(uaddr) == nullptr) {
@@ -748,7 +1103,7 @@ bool Prog::globalUsed(ADDRESS uaddr, SharedType knownType) {
         ty = guessGlobalType(nam, uaddr);
 
     Global *global = new Global(ty, uaddr, nam,this);
-    globals.insert(global);
+    addGlobal(global);
 
     if (VERBOSE) {
         LOG << "globalUsed: name " << nam << ", address " << uaddr;
@@ -806,7 +1161,7 @@ SharedType Prog::guessGlobalType(const QString &nam, ADDRESS u) {
         ty = IntegerType::get(sz * 8);
         break;
     default:
-        ty = std::make_shared<ArrayType>(std::make_shared<CharType>(), sz);
+        ty = std::make_shared<ArrayType>(CharType::get(), sz);
     }
     return ty;
 }
@@ -821,6 +1176,12 @@ QString Prog::newGlobalName(ADDRESS uaddr) {
 }
 //! Get the type of a global variable
 SharedType Prog::getGlobalType(const QString &nam) {
+    if (typeRound && typeRound->proc) {
+        typeRound->readers[nam].insert(typeRound->proc);
+        auto vv = typeRound->view.find(nam);
+        if (vv != typeRound->view.end())
+            return vv->second;
+    }
     for (Global *gl : globals)
         if (gl->getName()==nam)
             return gl->getType();
@@ -828,6 +1189,11 @@ SharedType Prog::getGlobalType(const QString &nam) {
 }
 //! Set the type of a global variable
 void Prog::setGlobalType(const QString &nam, SharedType ty) {
+    if (typeRound && typeRound->proc && getGlobal(nam)) {
+        typeRound->readers[nam].insert(typeRound->proc);
+        typeRound->view[nam] = ty; // Merged at the end of the round
+        return;
+    }
     // FIXME: inefficient
     for (Global *gl : globals) {
         if (gl->getName()!=nam)
@@ -841,13 +1207,12 @@ void Prog::setGlobalType(const QString &nam, SharedType ty) {
 // if knownString, it is already known to be a char*
 //! get a string constant at a give address if appropriate
 const char *Prog::getStringConstant(ADDRESS uaddr, bool knownString /* = false */) {
-    const IBinarySection *si = Image->getSectionInfoByAddr(uaddr);
     // Too many compilers put constants, including string constants, into read/write sections
     // if (si && si->bReadOnly)
-    if (si && !si->isAddressBss(uaddr)) {
+    const char *p = Image->getSpan(uaddr, 1);
+    if (p) {
         // At this stage, only support ascii, null terminated, non unicode strings.
         // At least 4 of the first 6 chars should be printable ascii
-        char *p = (char *)(uaddr + si->hostAddr() - si->sourceAddr()).m_value;
         if (knownString)
             // No need to guess... this is hopefully a known string
             return p;
@@ -917,6 +1282,86 @@ int Prog::readNative4(ADDRESS a) {
     return Image->readNative4(a);
 }
 
+/***************************************************************************/ /**
+  *
+  * \brief Read the \a count 4 byte words from \a a on into \a res, considering endianness, with one lookup of the
+  * section instead of one per word, and the bytes of the whole table swapped at once (see
+  * IBinaryImage::readNative4Span)
+  * \returns false, with \a res empty, unless they are all in one section with data
+  *
+  ******************************************************************************/
+bool Prog::readNative4Table(ADDRESS a, size_t count, std::vector<int> &res) {
+    res.resize(count);
+    if (count == 0 || Image->readNative4Span(a, reinterpret_cast<uint32_t *>(res.data()), count))
+        return true;
+    res.clear();
+    return false;
+}
+
+//! As readNative4Table, for 2 byte words, each read as readNative2 would (0 to 0xFFFF)
+bool Prog::readNative2Table(ADDRESS a, size_t count, std::vector<int> &res) {
+    std::vector<uint16_t> words(count);
+    res.clear();
+    if (count && !Image->readNative2Span(a, words.data(), count))
+        return false;
+    res.assign(words.begin(), words.end());
+    return true;
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief The destinations of the switch described by \a si, one for each of its iUpper - iLower + 1 entries
+  * (NO_ADDRESS for an unused entry of form H), as read from its table. Offset forms are already relative to the table.
+  *
+  * A proc is decoded again after each round of switch analysis, and every switch found so far is processed again
+  * then, so the tables are read once and kept until the image changes. Not for form F, whose table is on the host.
+  *
+  ******************************************************************************/
+const std::vector<ADDRESS> &Prog::getSwitchTargets(const SWITCH_INFO *si) {
+    assert(si->chForm != 'F');
+    if (Image->getWriteCount() != switchTargetsWrites) {
+        switchTargets.clear();
+        switchTargetsWrites = Image->getWriteCount();
+    }
+    auto key = std::make_tuple(si->uTable, si->chForm, si->iUpper - si->iLower + 1, si->iOffset);
+    auto it = switchTargets.find(key);
+    if (it != switchTargets.end()) {
+        DecompileStats::get().count(nullptr, "switch", "cached tables");
+        return it->second;
+    }
+    std::vector<ADDRESS> &res(switchTargets[key]);
+    int num = std::get<2>(key);
+    if (num <= 0)
+        return res;
+    if (si->chForm == 'H') {
+        // Pairs of value and destination; an unused entry has the value -1
+        std::vector<int> words;
+        bool bulk = readNative4Table(si->uTable, num * 2, words);
+        for (int i = 0; i < num; i++) {
+            if ((bulk ? words[i * 2] : readNative4(si->uTable + i * 8)) == -1)
+                res.push_back(NO_ADDRESS);
+            else
+                res.push_back(ADDRESS::g(bulk ? words[i * 2 + 1] : readNative4(si->uTable + i * 8 + 4)));
+        }
+    } else {
+        std::vector<int> words;
+        bool bulk = readNative4Table(si->uTable, num, words);
+        for (int i = 0; i < num; i++) {
+            ADDRESS dest = ADDRESS::g(bulk ? words[i] : readNative4(si->uTable + i * 4));
+            if (si->chForm == 'O' || si->chForm == 'R' || si->chForm == 'r') {
+                // Offset: add table address to make a real pointer to code.  For type R, the table is relative to the
+                // branch, so take iOffset. For others, iOffset is 0, so no harm
+                if (si->chForm != 'R')
+                    assert(si->iOffset == 0);
+                dest += si->uTable - si->iOffset;
+            }
+            res.push_back(dest);
+        }
+    }
+    DecompileStats::get().count(nullptr, "switch", "tables read");
+    return res;
+}
+
 /***************************************************************************/ /**
   *
   * \brief    Return a pointer to the Proc object containing uAddr, or 0 if none
@@ -1001,6 +1446,7 @@ const void *Prog::getCodeInfo(ADDRESS uAddr, const char *&last, int &delta) {
   *
   ******************************************************************************/
 void Prog::decodeEntryPoint(ADDRESS a) {
+    ContextScope inContext(Context);
     Function *p = (UserProc *)findProc(a);
     if (p == nullptr || (!p->isLib() && !((UserProc *)p)->isDecoded())) {
         if (a < Image->getLimitTextLow() || a >= Image->getLimitTextHigh()) {
@@ -1008,7 +1454,12 @@ void Prog::decodeEntryPoint(ADDRESS a) {
             return;
         }
         DefaultFrontend->decode(this, a);
-        finishDecode();
+        // Only the proc at a has been decoded; the callees found are left for later
+        p = findProc(a);
+        if (p && !p->isLib() && ((UserProc *)p)->isDecoded()) {
+            ((UserProc *)p)->assignProcsToCalls();
+            ((UserProc *)p)->finalSimplify();
+        }
     }
     if (p == nullptr)
         p = findProc(a);
@@ -1028,17 +1479,20 @@ void Prog::setEntryPoint(ADDRESS a) {
         entryProcs.push_back((UserProc *)p);
 }
 bool Prog::isDynamicLinkedProcPointer(ADDRESS dest) {
-    auto sym = BinarySymbols->find(dest);
-    return sym && sym->isImportedFunction();
+    return BinarySymbols->findImportedFunction(dest) != nullptr;
 }
 
 const QString &Prog::GetDynamicProcName(ADDRESS uNative) {
     static QString dyn("dynamic");
-    auto sym = BinarySymbols->find(uNative);
+    // Mostly asked about the import slots that isDynamicLinkedProcPointer has just found
+    const IBinarySymbol *sym = BinarySymbols->findImportedFunction(uNative);
+    if (sym == nullptr)
+        sym = BinarySymbols->find(uNative);
     return sym ? sym->getName() : dyn;
 }
 
 void Prog::decodeEverythingUndecoded() {
+    ContextScope inContext(Context);
     for(Module *module : ModuleList) {
         for (Function *pp : *module) {
             UserProc *up = (UserProc *)pp;
@@ -1053,21 +1507,101 @@ void Prog::decodeEverythingUndecoded() {
 }
 //! Do the main non-global decompilation steps
 void Prog::decompile() {
+    ContextScope inContext(Context);
     assert(!ModuleList.empty());
     getNumProcs();
     LOG_VERBOSE(1) << getNumProcs(false) << " procedures\n";
 
-    // Start decompiling each entry point
-    for (UserProc *up : entryProcs) {
-        ProcList call_path;
-        LOG_VERBOSE(1) << "decompiling entry point " << up->getName() << "\n";
-        int indent = 0;
-        up->decompile(&call_path, indent);
+    // Start decompiling from the recursion groups that call nothing undecompiled, working up to the entry points.
+    // This is the order the depth first search from each entry point in decompile() would finish them in; the
+    // scheduler makes explicit which groups are independent of each other.
+    // Recursion groups known from the call graph are given to their members up front, so that decompile() has the
+    // whole group from the start instead of piecing it together from the cycles it meets on the way down (it still
+    // does that for calls found later, e.g. by switch analysis).
+    // Note: the groups, and the members of a group, are decompiled one at a time, as are the procs in decoding, global
+    // type analysis, fromSSAform and code generation. These passes share too much between procs (the current arena,
+    // the simplify cache, the expression table, the log, the decoder and its dictionary, globals and types in the
+    // Prog, the callee's return statement and collectors seen by each call) to run on more than one thread yet; only
+    // the SSL and signature files are parsed on several (see TaskScheduler).
+    // With the profile of a previous run, the procs that ran out of their budget then are finished at the stage they
+    // reach without spending it again. It does not reorder the groups, which would make the output depend on it.
+    ProcScheduler scheduler;
+    ProcProfile &profile(ProcProfile::get());
+    scheduler.setCheapestFirst(Context->cheapestFirst);
+    scheduler.build(entryProcs);
+    LOG_VERBOSE(1) << scheduler.getNumGroups() << " recursion groups in the call graph\n";
+    if (profile.isKnown() && (Context->procTimeBudget > 0 || Context->procStepBudget > 0)) {
+        for (size_t g = 0; g < scheduler.getNumGroups(); g++) {
+            for (UserProc *p : scheduler.getGroup(g)) {
+                if (profile.isPathological(p, Context->procTimeBudget))
+                    p->startDegraded();
+            }
+        }
+    }
+    if (Context->streamCode) {
+        delete streamer;
+        streamer = new ProcStreamer(this, scheduler);
+    }
+    bool sharded = Context->shardCount > 0;
+    if (sharded && !ProcCache::get().isEnabled()) {
+        LOG_STREAM(LL_Warn) << "--shard needs the --cache the shards share; decompiling everything\n";
+        sharded = false;
+    }
+    shardWaiting.clear();
+    std::vector<bool> waiting(scheduler.getNumGroups(), false);
+    std::vector<UserProc *> preferred;
+    while (scheduler.hasReady()) {
+        // A watcher (e.g. the GUI) may want some procs sooner than the others
+        preferred.clear();
+        Context->takePreferredProcs(preferred);
+        for (UserProc *p : preferred)
+            scheduler.prefer(p);
+        int g = scheduler.next();
+        const std::vector<UserProc *> &members(scheduler.getGroup(g));
+        if (sharded && !takeShardGroup(scheduler, g, waiting)) {
+            scheduler.finished(g);
+            if (streamer && !waiting[g])
+                streamer->groupFinished(members);
+            continue;
+        }
+        UserProc *up = members.front();
+        if (!up->isDecompiled() && scheduler.isRecursive(g)) {
+            auto grp = std::make_shared<ProcSet>(members.begin(), members.end());
+            for (UserProc *p : members) {
+                if (p->getStatus() < PROC_VISITED)
+                    p->setCycleGroup(grp);
+            }
+        }
+        if (!up->isDecompiled()) {
+            ProcList call_path;
+            bool isEntry = std::find(entryProcs.begin(), entryProcs.end(), up) != entryProcs.end();
+            if (isEntry)
+                LOG_VERBOSE(1) << "decompiling entry point " << up->getName() << "\n";
+            else
+                up->promoteSignature(); // As decompile() does on the way down to a child
+            int indent = 0;
+            if (profile.isEnabled()) {
+                std::vector<size_t> statements;
+                for (UserProc *p : members)
+                    statements.push_back(ProcScheduler::getCost(p));
+                auto start = std::chrono::steady_clock::now();
+                up->decompile(&call_path, indent);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                for (size_t i = 0; i < members.size(); i++)
+                    profile.record(members[i], seconds / members.size(), statements[i]);
+            } else
+                up->decompile(&call_path, indent);
+        }
+        scheduler.finished(g);
+        if (streamer)
+            streamer->groupFinished(members);
+        relieveMemoryPressure();
     }
 
     // Just in case there are any Procs not in the call graph.
 
-    if (Boomerang::get()->decodeMain && !Boomerang::get()->noDecodeChildren) {
+    // (With lazy decoding, those are the procs nothing needed, and are left undecoded.)
+    if (Context->decodeMain && !Context->noDecodeChildren && !Context->lazyDecode) {
         bool foundone = true;
         while (foundone) {
             foundone = false;
@@ -1076,7 +1610,7 @@ void Prog::decompile() {
                     UserProc *proc = (UserProc *)pp;
                     if (proc->isLib())
                         continue;
-                    if (proc->isDecompiled())
+                    if (proc->isDecompiled() || shardWaiting.count(proc))
                         continue;
                     int indent = 0;
                     proc->decompile(new ProcList, indent);
@@ -1086,87 +1620,322 @@ void Prog::decompile() {
         }
     }
 
+    if (!shardWaiting.empty()) {
+        LOG_STREAM(LL_Warn) << shardWaiting.size() << " procs wait for the summaries of other shards; run shard "
+                            << Context->shardIndex << " again once those have run\n";
+        DecompileStats::get().count(nullptr, "shard", "waiting procs", shardWaiting.size());
+    }
+
+    // Remember the results for later runs, before global analyses make them depend on the callers in this program
+    if (ProcCache::get().isEnabled()) {
+        for (Module *module : ModuleList) {
+            for (Function *pp : *module) {
+                if (!pp->isLib() && !isLeftOut((UserProc *)pp))
+                    ProcCache::get().store((UserProc *)pp);
+            }
+        }
+    }
+
     // Type analysis, if requested
-    if (Boomerang::get()->conTypeAnalysis && Boomerang::get()->dfaTypeAnalysis) {
+    if (Context->conTypeAnalysis && Context->dfaTypeAnalysis) {
         LOG_STREAM() << "can't use two types of type analysis at once!\n";
-        Boomerang::get()->conTypeAnalysis = false;
+        Context->conTypeAnalysis = false;
     }
+    relieveMemoryPressure();
     globalTypeAnalysis();
 
-    if (!Boomerang::get()->noDecompile) {
-        if (!Boomerang::get()->noRemoveReturns) {
+    if (!Context->noDecompile) {
+        if (!Context->noRemoveReturns) {
             // A final pass to remove returns not used by any caller
             LOG_VERBOSE(1) << "prog: global removing unused returns\n";
-            // Repeat until no change. Note 100% sure if needed.
-            while (removeUnusedReturns())
-                ;
+            removeUnusedReturns();
         }
 
-        // print XML after removing returns
-        for(Module *m :ModuleList) {
-            for (Function *pp : *m) {
-                UserProc *proc = (UserProc *)pp;
-                if (proc->isLib())
-                    continue;
-                proc->printXML();
+        // print XML after removing returns; the call graph is the same for all of them, so it is written once
+        if (Context->dumpXML) {
+            for (Module *m : ModuleList) {
+                for (Function *pp : *m) {
+                    UserProc *proc = (UserProc *)pp;
+                    if (proc->isLib() || isLeftOut(proc))
+                        continue;
+                    proc->printXML(false);
+                }
             }
+            printCallGraphXML();
         }
     }
     LOG_VERBOSE(1) << "transforming from SSA\n";
 
     // Now it is OK to transform out of SSA form
+    relieveMemoryPressure();
     fromSSAform();
 
-    // removeUnusedLocals(); Note: is now in UserProc::generateCode()
+    // removeUnusedLocals(); Note: is now done by UserProc::fromSSAform()
     removeUnusedGlobals();
+    for (Module *module : ModuleList) {
+        for (Function *pp : *module) {
+            if (!pp->isLib() && ((UserProc *)pp)->isDecompiled())
+                ((UserProc *)pp)->recordConsumedSummaries();
+        }
+    }
+    finishDumps();
+    PassManager::printTimings();
 }
-//! As the name suggests, removes globals unused in the decompiled code.
-void Prog::removeUnusedGlobals() {
 
-    LOG_VERBOSE(1) << "removing unused globals\n";
-
-    // seach for used globals
-    std::list<Exp *> usedGlobals;
-    for(Module *module : ModuleList) {
-        for (Function *pp : *module) {
-            if (pp->isLib())
-                continue;
-            UserProc *u = (UserProc *)pp;
-            Location search(opGlobal, Terminal::get(opWild), u);
-            // Search each statement in u, excepting implicit assignments (their uses don't count, since they don't really
-            // exist in the program representation)
-            StatementList stmts;
-            StatementList::iterator ss;
-            u->getStatements(stmts);
-            for (Instruction *s : stmts) {
-                if (s->isImplicit())
-                    continue; // Ignore the uses in ImplicitAssigns
-                bool found = s->searchAll(search, usedGlobals);
-                if (found && DEBUG_UNUSED)
-                    LOG << " a global is used by stmt " << s->getNumber() << "\n";
+/***************************************************************************/ /**
+  * \brief   After an edit (e.g. of the library signatures, or new entry points) decompile again the procs it affects
+  *
+  * A decompiled proc is affected when the summary of one of its callees, or the type of one of the globals it uses,
+  * has changed since it was decompiled (see UserProc::consumesStaleSummaries()); an entry point not decompiled yet is
+  * decompiled. The procs are redone callees first, a recursion group at a time, each from its decode. A proc redone
+  * whose summary (UserProc::printCallerSummary()) comes out as it was leaves its callers alone; otherwise they are
+  * affected in turn. All other procs keep their results. A proc is redone at most once per call.
+  * \note    The global stages of decompile() (global type analysis, removing unused returns) are not run again, so
+  *          the results can differ from decompiling the whole program with the edit
+  * \returns the procs decompiled, in the order they were
+  ******************************************************************************/
+std::vector<UserProc *> Prog::redecompileStale() {
+    ContextScope inContext(Context);
+    std::vector<UserProc *> done;
+    std::set<UserProc *> redone;
+    std::map<ADDRESS, UserProc *> stale; // By address, so that the order does not depend on where the procs are
+    auto findStale = [&]() {
+        for (Module *module : ModuleList) {
+            for (Function *pp : *module) {
+                UserProc *proc = (UserProc *)pp;
+                if (proc->isLib() || redone.count(proc))
+                    continue;
+                bool isEntry = std::find(entryProcs.begin(), entryProcs.end(), proc) != entryProcs.end();
+                if (proc->isDecompiled() ? proc->consumesStaleSummaries() : isEntry)
+                    stale[proc->getNativeAddress()] = proc;
+            }
+        }
+    };
+    findStale();
+    while (!stale.empty()) {
+        // Callees first: a proc none of whose callees outside its recursion group is stale, if there is one
+        UserProc *next = stale.begin()->second;
+        for (const auto &pr : stale) {
+            bool ready = true;
+            for (Function *callee : pr.second->getCallees()) {
+                UserProc *c = (UserProc *)callee;
+                if (c != pr.second && !callee->isLib() && stale.count(c->getNativeAddress()) &&
+                    !pr.second->doesRecurseTo(c)) {
+                    ready = false;
+                    break;
+                }
+            }
+            if (ready) {
+                next = pr.second;
+                break;
+            }
+        }
+        std::shared_ptr<ProcSet> grp = next->getCycleGroup();
+        std::vector<UserProc *> members(1, next);
+        if (grp) {
+            for (UserProc *p : *grp) {
+                if (p != next)
+                    members.push_back(p);
+            }
+        }
+        std::vector<QString> before;
+        for (UserProc *p : members) {
+            QString text;
+            QTextStream os(&text);
+            p->printCallerSummary(os);
+            os.flush();
+            before.push_back(text);
+            stale.erase(p->getNativeAddress());
+            redone.insert(p);
+            if (p->getStatus() >= PROC_VISITED)
+                p->forgetDecompilation();
+            if (grp)
+                p->setCycleGroup(grp);
+        }
+        std::set<UserProc *> decompiledBefore;
+        for (Module *module : ModuleList) {
+            for (Function *pp : *module) {
+                if (!pp->isLib() && ((UserProc *)pp)->isDecompiled())
+                    decompiledBefore.insert((UserProc *)pp);
+            }
+        }
+        LOG_VERBOSE(1) << "decompiling " << next->getName() << " again\n";
+        ProcList call_path;
+        int indent = 0;
+        if (std::find(entryProcs.begin(), entryProcs.end(), next) == entryProcs.end())
+            next->promoteSignature();
+        next->decompile(&call_path, indent);
+        // The callees not decompiled before (e.g. of a new entry point) were decompiled on the way down
+        size_t numMembers = members.size();
+        for (Module *module : ModuleList) {
+            for (Function *pp : *module) {
+                UserProc *proc = (UserProc *)pp;
+                if (!pp->isLib() && proc->isDecompiled() && !decompiledBefore.count(proc) &&
+                    std::find(members.begin(), members.begin() + numMembers, proc) == members.begin() + numMembers)
+                    members.push_back(proc);
             }
         }
+        for (size_t i = 0; i < members.size(); i++) {
+            UserProc *p = members[i];
+            if (!p->isDecompiled())
+                continue; // Not reached from next after all
+            p->fromSSAform();
+            countGlobalRefs(p);
+            for (CallStatement *call : p->getCallers())
+                call->setCalleeReturn(p->getTheReturnStatement());
+            done.push_back(p);
+            DecompileStats::get().count(p, "redecompile", "procs");
+            QString after;
+            QTextStream os(&after);
+            p->printCallerSummary(os);
+            os.flush();
+            if (i >= numMembers || after != before[i])
+                continue; // The callers see the change through its summary generation
+            for (CallStatement *call : p->getCallers())
+                call->getProc()->refreshConsumedSummary(p);
+        }
+        for (UserProc *p : members) {
+            if (p->isDecompiled())
+                p->recordConsumedSummaries();
+        }
+        findStale();
     }
-    // make a map to find a global by its name (could be a global var too)
-    QMap<QString, Global *> namedGlobals;
-    for (Global *g : globals)
-        namedGlobals[g->getName()] = g;
+    return done;
+}
+
+//! True if \a proc is to be left out of the global stages: it has been taken through them by the ProcStreamer (with
+//! --stream), or it waits for the summaries of another shard (with --shard)
+bool Prog::isLeftOut(UserProc *proc) const {
+    return (streamer && streamer->isStreamed(proc)) || shardWaiting.count(proc) != 0;
+}
 
-    // rebuild the globals vector
-    Global *usedGlobal;
+//! With --shard, the shard that decompiles the recursion group \a g of \a scheduler, by its lowest address
+int Prog::getShard(const ProcScheduler &scheduler, int g) const {
+    ADDRESS lowest = NO_ADDRESS;
+    for (UserProc *p : scheduler.getGroup(g)) {
+        if (lowest == NO_ADDRESS || p->getNativeAddress() < lowest)
+            lowest = p->getNativeAddress();
+    }
+    // A multiplicative hash, so that the groups next to each other (often a caller and its callees) are spread out
+    uint32_t h = (uint32_t)lowest.m_value * 2654435761u;
+    return (int)((h >> 8) % (uint32_t)Context->shardCount);
+}
 
-    globals.clear();
+/***************************************************************************/ /**
+  * \brief   With --shard, see whether this run is to decompile the recursion group \a g of \a scheduler, which is ready
+  *
+  * A group of this shard is decompiled once the groups it calls have summaries. The members of the group of another
+  * shard are restored from the cache, and so are final for their callers. A group whose summaries are not in the cache
+  * yet, or that calls one that waits, waits too: its members go to shardWaiting, and waiting[g] is set.
+  * \returns true if the group is for this run to decompile
+  ******************************************************************************/
+bool Prog::takeShardGroup(const ProcScheduler &scheduler, int g, std::vector<bool> &waiting) {
+    const std::vector<UserProc *> &members(scheduler.getGroup(g));
+    bool wait = false;
+    for (int callee : scheduler.getCalleeGroups(g))
+        wait |= waiting[callee];
+    if (!wait && getShard(scheduler, g) == Context->shardIndex)
+        return true;
+    for (size_t i = 0; !wait && i < members.size(); i++) {
+        UserProc *p = members[i];
+        if (p->isDecompiled())
+            continue;
+        if (p->getStatus() < PROC_DECODED)
+            decodeOnDemand(p);
+        wait = !ProcCache::get().restore(p);
+    }
+    if (wait) {
+        waiting[g] = true;
+        shardWaiting.insert(members.begin(), members.end());
+        return false;
+    }
+    for (UserProc *p : members) {
+        if (!p->isDecompiled()) {
+            p->setStatus(PROC_FINAL);
+            Context->alertEndDecompile(p);
+        }
+    }
+    return false;
+}
+
+/***************************************************************************/ /**
+  * \brief   With --max-memory, drop what can be worked out again once the process holds more than that
+  *
+  * That is the instructions the front end keeps decoded and the results of prove() of every proc. The statements of
+  * the procs stay: the global analyses that follow need those of every proc (with --stream, the ProcStreamer frees
+  * them as soon as it can). Memory given back is reused by the allocator rather than returned to the system, so this
+  * slows the growth of the process rather than shrinking it, and is done whenever it is still over the budget.
+  ******************************************************************************/
+void Prog::relieveMemoryPressure() {
+    if (Context->maxMemory <= 0)
+        return;
+    size_t budget = (size_t)Context->maxMemory << 20;
+    size_t resident = MemStats::getResidentBytes();
+    if (resident <= budget)
+        return;
+    DefaultFrontend->clearDecodeCache();
+    for (Module *module : ModuleList) {
+        for (Function *pp : *module) {
+            if (!pp->isLib())
+                ((UserProc *)pp)->dropProofs();
+        }
+    }
+    DecompileStats::get().count(nullptr, "memory", "caches dropped");
+    LOG_VERBOSE(1) << "memory: " << (int)(resident >> 20) << " MB resident, over the budget of "
+                   << Context->maxMemory << " MB; dropped the decode cache and proofs\n";
+}
+
+/**
+ * Count the references to globals from the statements of \a proc into the globals, in place of what was counted for it
+ * before. Done for each proc when its statements are final, so that finding the unused globals is a look at the counts.
+ */
+void Prog::countGlobalRefs(UserProc *proc) {
+    std::map<Global *, int> &refs(proc->getGlobalRefs());
+    for (const auto &pr : refs)
+        pr.first->addRefs(-pr.second);
+    refs.clear();
+    std::list<Exp *> usedGlobals;
+    Location search(opGlobal, Terminal::get(opWild), proc);
+    // Search each statement in proc, excepting implicit assignments (their uses don't count, since they don't really
+    // exist in the program representation)
+    for (Instruction *s : proc->statements()) {
+        if (s->isImplicit())
+            continue; // Ignore the uses in ImplicitAssigns
+        bool found = s->searchAll(search, usedGlobals);
+        if (found && DEBUG_UNUSED)
+            LOG << " a global is used by stmt " << s->getNumber() << "\n";
+    }
+    std::map<QString, int> byName;
     for (Exp *e : usedGlobals) {
         if (DEBUG_UNUSED)
             LOG << " " << e << " is used\n";
-        QString name(((Const *)e->getSubExp1())->getStr());
-        usedGlobal = namedGlobals[name];
-        if (usedGlobal) {
-            globals.insert(usedGlobal);
-        } else {
+        byName[((Const *)e->getSubExp1())->getStr()]++;
+    }
+    for (const auto &pr : byName) {
+        Global *glob = getGlobal(pr.first);
+        if (glob == nullptr) {
             LOG << "warning: an expression refers to a nonexistent global\n";
+            continue;
         }
+        refs[glob] += pr.second;
+        glob->addRefs(pr.second);
+    }
+}
+
+//! As the name suggests, removes globals unused in the decompiled code.
+void Prog::removeUnusedGlobals() {
+
+    LOG_VERBOSE(1) << "removing unused globals\n";
+
+    // The references were counted as each proc was finished (see countGlobalRefs())
+    std::vector<Global *> used;
+    for (Global *g : globals) {
+        if (g->getRefCount() > 0)
+            used.push_back(g);
     }
+    clearGlobals();
+    for (Global *g : used)
+        addGlobal(g);
 }
 
 /***************************************************************************/ /**
@@ -1182,12 +1951,14 @@ void Prog::removeUnusedGlobals() {
   * 3) if the return is defined at a call, the location may no longer be live at the call. If not, you need to check
   *    the child, and do the union again (hence needing a list of callers) to find out if this change also affects that
   *    child.
+  * All of these are followed through a work list: removeRedundantReturns() schedules the callers of a proc whose
+  * returns or parameters shrink, and updateForUseChange() the callees whose liveness at a call shrinks, so one run
+  * reaches the fixed point, and only the procs affected by a change are looked at again.
   * \returns true if any change
   *
   ******************************************************************************/
 bool Prog::removeUnusedReturns() {
-    // For each UserProc. Each proc may process many others, so this may duplicate some work. Really need a worklist of
-    // procedures not yet processed.
+    StatScope stats(nullptr, "unused returns");
     // Define a workset for the procedures who have to have their returns checked
     // This will be all user procs, except those undecoded (-sf says just trust the given signature)
     std::set<UserProc *> removeRetSet;
@@ -1195,7 +1966,7 @@ bool Prog::removeUnusedReturns() {
     for(Module *module : ModuleList) {
         for (Function *pp : *module) {
             UserProc *proc = (UserProc *)pp;
-            if (proc->isLib() || !proc->isDecoded())
+            if (proc->isLib() || !proc->isDecoded() || isLeftOut(proc))
                 continue; // e.g. use -sf file to just prototype the proc
             removeRetSet.insert(proc);
         }
@@ -1203,13 +1974,22 @@ bool Prog::removeUnusedReturns() {
     // The workset is processed in arbitrary order. May be able to do better, but note that sometimes changes propagate
     // down the call tree (no caller uses potential returns for child), and sometimes up the call tree (removal of
     // returns and/or dead code removes parameters, which affects all callers).
+    // A draft visits each proc once, ignoring the procs that the changes schedule again.
+    std::set<UserProc *> rescheduled;
+    size_t visits = 0;
     while (!removeRetSet.empty()) {
-        auto it = removeRetSet.begin(); // Pick the first element of the set
-        change |= (*it)->removeRedundantReturns(removeRetSet);
-        // Note: removing the currently processed item here should prevent unnecessary reprocessing of self recursive
-        // procedures
-        removeRetSet.erase(it); // Remove the current element (may no longer be the first)
-    }
+        UserProc *proc = *removeRetSet.begin(); // Pick the first element of the set
+        // Taken out before it is processed, so that a change it makes to itself (when self recursive) schedules it
+        // again; it is only scheduled again on a change, so this terminates
+        removeRetSet.erase(removeRetSet.begin());
+        if (isLeftOut(proc))
+            continue; // Its code is already generated
+        visits++;
+        change |= proc->removeRedundantReturns(Context->draft ? rescheduled : removeRetSet);
+    }
+    if (Context->draft)
+        DecompileStats::get().count(nullptr, "unused returns", "procs not revisited", rescheduled.size());
+    DecompileStats::get().count(nullptr, "unused returns", "visits", visits);
     return change;
 }
 
@@ -1219,15 +1999,16 @@ void Prog::fromSSAform() {
     for(Module *module : ModuleList) {
         for (Function *pp : *module) {
             UserProc *proc = (UserProc *)pp;
-            if (proc->isLib())
+            if (proc->isLib() || isLeftOut(proc))
                 continue;
             if (VERBOSE) {
                 LOG << "===== before transformation from SSA form for " << proc->getName() << " =====\n" << *proc
                     << "===== end before transformation from SSA for " << proc->getName() << " =====\n\n";
-                if (!Boomerang::get()->dotFile.isEmpty())
+                if (DEBUG_HOOKS && !Context->dotFile.isEmpty() && Context->isDebugProc(proc->getName()))
                     proc->printDFG();
             }
             proc->fromSSAform();
+            countGlobalRefs(proc);
             LOG_VERBOSE(1) << "===== after transformation from SSA form for " << proc->getName() << " =====\n" << *proc
                            << "===== end after transformation from SSA for " << proc->getName() << " =====\n\n";
         }
@@ -1254,33 +2035,162 @@ void Prog::conTypeAnalysis() {
 void Prog::globalTypeAnalysis() {
     if (VERBOSE || DEBUG_TA)
         LOG << "### start global data-flow-based type analysis ###\n";
+    std::vector<UserProc *> procs;
     for(Module *module : ModuleList) {
         for (Function *pp : *module) {
             UserProc *proc = (UserProc *)pp;
-            if (proc->isLib() || !proc->isDecoded())
+            if (proc->isLib() || !proc->isDecoded() || isLeftOut(proc))
+                continue;
+            procs.push_back(proc);
+        }
+    }
+    // With -Tg, the procs whose analysis saw a global type that the merge then changed are analysed again, for a few
+    // rounds at most
+    const int MAX_ROUNDS = Context->roundTypeAnalysis ? 4 : 1;
+    std::set<UserProc *> again;
+    for (int round = 0; round < MAX_ROUNDS && !procs.empty(); round++) {
+        GlobalTypeRound state;
+        if (Context->roundTypeAnalysis)
+            typeRound = &state;
+        for (UserProc *proc : procs) {
+            if (round > 0 && again.count(proc) == 0)
                 continue;
             // FIXME: this just does local TA again. Need to meet types for all parameter/arguments, and return/results!
             // This will require a repeat until no change loop
             LOG_STREAM() << "global type analysis for " << proc->getName() << "\n";
+            state.proc = proc;
             proc->typeAnalysis();
+            state.propose();
         }
+        if (typeRound == nullptr)
+            break;
+        again = mergeGlobalTypes();
+        typeRound = nullptr;
+        LOG_VERBOSE(1) << "global type analysis round " << round << ": " << again.size() << " procs to redo\n";
+        if (again.empty())
+            break;
     }
     if (VERBOSE || DEBUG_TA)
         LOG << "### end type analysis ###\n";
 }
+
+/***************************************************************************/ /**
+  * \brief   End a round of global type analysis with -Tg: give each global the meet of the types proposed for it by
+  * the procs of the round (just the proposal, when there is only one, as setGlobalType() would have)
+  * \returns the procs that saw one of the globals changed by the merge, other than as they proposed it themselves
+  ******************************************************************************/
+std::set<UserProc *> Prog::mergeGlobalTypes() {
+    std::set<UserProc *> redo;
+    for (const auto &pp : typeRound->proposals) {
+        Global *glob = getGlobal(pp.first);
+        if (glob == nullptr)
+            continue;
+        SharedType merged;
+        for (const auto &prop : pp.second) {
+            bool ch = false;
+            merged = merged ? merged->meetWith(prop.second, ch) : prop.second;
+        }
+        SharedType old = glob->getType();
+        if (merged == nullptr || (old && *old == *merged))
+            continue;
+        glob->setType(merged);
+        if (DEBUG_TA)
+            LOG << "global " << pp.first << " now has type " << merged->getCtype() << "\n";
+        std::set<UserProc *> agreed;
+        for (const auto &prop : pp.second) {
+            if (*prop.second == *merged)
+                agreed.insert(prop.first);
+        }
+        for (UserProc *p : typeRound->readers[pp.first]) {
+            if (agreed.count(p) == 0)
+                redo.insert(p);
+        }
+    }
+    return redo;
+}
 #include "passes/RangeAnalysis.h"
 void Prog::rangeAnalysis() {
     for(Module *module : ModuleList) {
-        RangeAnalysis ra;
+        PassManager passes;
+        passes.add(new RangeAnalysis);
         for (Function *pp : *module) {
             UserProc *proc = (UserProc *)pp;
             if (proc->isLib() || !proc->isDecoded())
                 continue;
-            ra.runOnFunction(*proc);
+            // The ranges are kept for next time, so they must live as long as the proc's statements
+            ArenaScope inArena(proc->getArena());
+            passes.run(*proc);
         }
     }
 }
 
+//! Clear the visited flags of all the procs, for a walk of the call graph
+void Prog::clearVisited() {
+    for (Module *m : ModuleList) {
+        for (Function *p : *m)
+            p->clearVisited();
+    }
+}
+
+//! True if the calls of \a p are to be written in the graphs of the program: with --graph-module, only those of the
+//! procs of that module are
+bool Prog::isInGraph(Function *p) const {
+    return Context->graphModule.isEmpty() || (p->getParent() && p->getParent()->getName() == Context->graphModule);
+}
+
+//! Where the walks of the call graph start: the entry points, or with --graph-module the procs of that module
+std::vector<Function *> Prog::getGraphRoots() {
+    std::vector<Function *> roots;
+    if (Context->graphModule.isEmpty()) {
+        roots.assign(entryProcs.begin(), entryProcs.end());
+        return roots;
+    }
+    for (UserProc *up : entryProcs) {
+        if (isInGraph(up))
+            roots.push_back(up);
+    }
+    Module *m = findModule(Context->graphModule);
+    if (m == nullptr) {
+        LOG_STREAM(LL_Warn) << "there is no module " << Context->graphModule << " to write the graphs of\n";
+        return roots;
+    }
+    for (Function *p : *m) {
+        if (!p->isLib() && std::find(roots.begin(), roots.end(), p) == roots.end())
+            roots.push_back(p);
+    }
+    return roots;
+}
+
+/***************************************************************************/ /**
+  * \brief   The procs that the graphs of the program are written for: those within --graph-depth calls of the roots
+  * (see getGraphRoots()), through the calls of the procs in the graph (see isInGraph())
+  ******************************************************************************/
+std::set<Function *> Prog::getGraphProcs() {
+    std::set<Function *> procs;
+    std::vector<std::pair<Function *, int>> stack;
+    for (Function *root : getGraphRoots())
+        stack.emplace_back(root, 0);
+    while (!stack.empty()) {
+        Function *p = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+        if (!procs.insert(p).second || p->isLib() || !isInGraph(p))
+            continue;
+        if (Context->graphDepth > 0 && depth >= Context->graphDepth)
+            continue;
+        for (Function *callee : ((UserProc *)p)->getCallees())
+            stack.emplace_back(callee, depth + 1);
+    }
+    return procs;
+}
+
+/***************************************************************************/ /**
+  * \brief   Write the call graph, as an indented tree (callgraph.out) and for dotty (callgraph.dot)
+  *
+  * The graph is walked depth first with a stack of its own, so that deep call chains do not overflow the native one,
+  * and the files are written as it goes. Each proc is listed once, under the first caller it is reached from; with
+  * --graph-depth and --graph-module, only that part of the graph is walked (see getGraphProcs()).
+  ******************************************************************************/
 void Prog::printCallGraph() {
     QString fname1 = Boomerang::get()->getOutputPath() + "callgraph.out";
     QString fname2 = Boomerang::get()->getOutputPath() + "callgraph.dot";
@@ -1290,43 +2200,43 @@ void Prog::printCallGraph() {
     QFile file2(fname2);
     if( !(file1.open(QFile::WriteOnly) && file2.open(QFile::WriteOnly)) ) {
         LOG_STREAM() << "Cannot open output files for callgraph output";
+        unlockFile(fd1);
+        unlockFile(fd2);
         return;
     }
     QTextStream f1(&file1);
     QTextStream f2(&file2);
-    std::set<Function *> seen;
-    std::map<Function *, int> spaces;
-    std::map<Function *, Function *> parent;
-    std::list<Function *> procList;
+    struct Frame {
+        Function *proc;
+        int depth;
+        Function *parent;
+    };
+    std::vector<Frame> stack;
+    clearVisited();
     f2 << "digraph callgraph {\n";
-    std::copy(entryProcs.begin(), entryProcs.end(), std::back_inserter(procList));
-
-    spaces[procList.front()] = 0;
-    while (procList.size()) {
-        Function *p = procList.front();
-        procList.erase(procList.begin());
-        if (ADDRESS::host_ptr(p) == NO_ADDRESS)
-            continue;
-        if (seen.find(p) != seen.end())
+    std::vector<Function *> roots = getGraphRoots();
+    for (auto it = roots.rbegin(); it != roots.rend(); ++it)
+        stack.push_back({*it, 0, nullptr});
+    while (!stack.empty()) {
+        Frame fr = stack.back();
+        stack.pop_back();
+        Function *p = fr.proc;
+        if (p->isVisited())
             continue;
-        seen.insert(p);
-        int n = spaces[p];
-        for (int i = 0; i < n; i++)
+        p->setVisited();
+        for (int i = 0; i < fr.depth; i++)
             f1 << "     ";
         f1 << p->getName() << " @ " << p->getNativeAddress();
-        if (parent.find(p) != parent.end())
-            f1 << " [parent=" << parent[p]->getName() << "]";
+        if (fr.parent)
+            f1 << " [parent=" << fr.parent->getName() << "]";
         f1 << '\n';
-        if (!p->isLib()) {
-            n++;
-            UserProc *u = (UserProc *)p;
-            std::list<Function *> &calleeList = u->getCallees();
-            for (auto it1 = calleeList.rbegin(); it1 != calleeList.rend(); it1++) {
-                procList.push_front(*it1);
-                spaces[*it1] = n;
-                parent[*it1] = p;
-                f2 << p->getName() << " -> " << (*it1)->getName() << ";\n";
-            }
+        if (p->isLib() || !isInGraph(p) || (Context->graphDepth > 0 && fr.depth >= Context->graphDepth))
+            continue;
+        // Pushed last first, so that the callees are listed in the order they are called
+        std::list<Function *> &calleeList = ((UserProc *)p)->getCallees();
+        for (auto it1 = calleeList.rbegin(); it1 != calleeList.rend(); it1++) {
+            stack.push_back({*it1, fr.depth + 1, p});
+            f2 << p->getName() << " -> " << (*it1)->getName() << ";\n";
         }
     }
     f2 << "}\n";
@@ -1391,34 +2301,111 @@ void Prog::printSymbolsToFile() {
     LOG_STREAM() << "leaving Prog::printSymbolsToFile\n";
 }
 
+/***************************************************************************/ /**
+  * \brief   With -x, write the call graph to callgraph.xml in the output directory, as nested proc elements
+  *
+  * The file is written as the graph is walked (see printCallGraphXML(QTextStream &, Function *)), rather than made in
+  * memory first; with --graph-depth and --graph-module, only that part of the graph is written.
+  ******************************************************************************/
 void Prog::printCallGraphXML() {
-    if (!Boomerang::get()->dumpXML)
+    if (!Context->dumpXML)
         return;
 
-    for(Module *m : ModuleList) {
-        for (Function *it : *m)
-            it->clearVisited();
-    }
+    clearVisited();
     QString fname = Boomerang::get()->getOutputPath() + "callgraph.xml";
-    int fd = lockFileWrite(qPrintable(fname));
-    QFile CallGraphFile(fname);
-    QTextStream f(&CallGraphFile);
+    QFile file(fname);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        qDebug() << "Can't write to file:" << fname;
+        return;
+    }
+    QTextStream f(&file);
     f << "<prog name=\"" << getName() << "\">\n";
     f << "     <callgraph>\n";
 
-    for (UserProc *up : entryProcs)
-        up->printCallGraphXML(f, 2);
-    for(Module *m : ModuleList) {
-        for (Function *pp : *m) {
-            if (!pp->isVisited() && !pp->isLib()) {
-                pp->printCallGraphXML(f, 2);
+    for (Function *root : getGraphRoots())
+        printCallGraphXML(f, root);
+    if (Context->graphModule.isEmpty() && Context->graphDepth <= 0) {
+        for (Module *m : ModuleList) {
+            for (Function *pp : *m) {
+                if (!pp->isVisited() && !pp->isLib())
+                    printCallGraphXML(f, pp);
             }
         }
     }
     f << "     </callgraph>\n";
     f << "</prog>\n";
     f.flush();
-    unlockFile(fd);
+}
+
+/***************************************************************************/ /**
+  * \brief   Write the call graph below \a root to \a os, each proc with its callees nested in it
+  *
+  * The callees of a proc are written the first time it is met, and only its name after that. The walk keeps its
+  * own stack of the procs whose elements are open, with the next callee of each, instead of recursing.
+  ******************************************************************************/
+void Prog::printCallGraphXML(QTextStream &os, Function *root) {
+    struct Frame {
+        UserProc *proc;
+        std::list<Function *>::iterator next;
+        int depth;
+    };
+    std::vector<Frame> stack;
+    auto indent = [&os](int depth) {
+        for (int i = 0; i < depth; i++)
+            os << "      ";
+    };
+    // Write the start of the element of p, and unless its callees follow, its end
+    auto open = [&](Function *p, int depth) {
+        bool expand = !p->isVisited() && !p->isLib() && isInGraph(p) &&
+                      (Context->graphDepth <= 0 || depth - 2 < Context->graphDepth);
+        p->setVisited();
+        indent(depth);
+        if (p->isLib()) {
+            os << "<proc name=\"" << p->getName() << "\"/>\n";
+            return;
+        }
+        os << "<proc name=\"" << p->getName() << "\">\n";
+        if (expand) {
+            UserProc *up = (UserProc *)p;
+            stack.push_back({up, up->getCallees().begin(), depth});
+            return;
+        }
+        indent(depth);
+        os << "</proc>\n";
+    };
+    open(root, 2);
+    while (!stack.empty()) {
+        Frame &top = stack.back();
+        if (top.next == top.proc->getCallees().end()) {
+            indent(top.depth);
+            os << "</proc>\n";
+            stack.pop_back();
+            continue;
+        }
+        Function *callee = *top.next++;
+        open(callee, top.depth + 1);
+    }
+}
+
+/***************************************************************************/ /**
+  * \brief   Queue a debugging dump (-x) to be written to \a fileName in the output directory. The file is written by
+  * another thread, so that decompilation need not wait for the disk; finishDumps() waits for it.
+  ******************************************************************************/
+void Prog::writeDump(const QString &fileName, const QString &contents) {
+    if (dumpWriter == nullptr)
+        dumpWriter = new OutputWriter;
+    dumpWriter->write(Boomerang::get()->getOutputPath() + fileName, contents.toUtf8());
+}
+
+//! Wait for the dumps queued by writeDump() to be written, and report those that could not be
+void Prog::finishDumps() {
+    if (dumpWriter == nullptr)
+        return;
+    dumpWriter->finish();
+    for (const QString &name : dumpWriter->getFailures())
+        qDebug() << "Can't write to file:" << name;
+    delete dumpWriter;
+    dumpWriter = nullptr;
 }
 
 Module *Prog::findModule(const QString &name) {
@@ -1444,6 +2431,7 @@ void Prog::readSymbolFile(const QString &fname) {
     if (isWin32())
         cc = CONV_PASCAL;
     par->yyparse(plat, cc);
+    par->defineNamedTypes();
     Module *tgt_mod = getRootCluster();
 
     for (Symbol *sym : par->symbols) {
@@ -1468,7 +2456,7 @@ void Prog::readSymbolFile(const QString &fname) {
             if (ty == nullptr) {
                 ty = guessGlobalType(nam, sym->addr);
             }
-            globals.insert(new Global(ty, sym->addr, nam,this));
+            addGlobal(new Global(ty, sym->addr, nam,this));
         }
     }
 
@@ -1614,6 +2602,16 @@ Exp *Prog::readNativeAs(ADDRESS uaddr, SharedType type) {
 void Global::meetType(SharedType ty) {
     bool ch=false;
     type = type->meetWith(ty, ch);
+    if (ch)
+        typeGeneration++;
+    if (Parent)
+        Parent->globalTypeChanged();
+}
+void Global::setType(SharedType ty) {
+    type = ty;
+    typeGeneration++;
+    if (Parent)
+        Parent->globalTypeChanged();
 }
 //! Re-decode this proc from scratch
 void Prog::reDecode(UserProc *proc) {
@@ -1621,6 +2619,26 @@ void Prog::reDecode(UserProc *proc) {
     DefaultFrontend->processProc(proc->getNativeAddress(), proc, os);
 }
 
+/***************************************************************************/ /**
+  *
+  * \brief Decode \a proc, which decompilation has reached before anything decoded it, and finish its decode as
+  * finishDecode() does for the procs decoded up front. This is how every callee is decoded with --lazy-decode; without
+  * it, only those found late (e.g. by switch analysis) are.
+  * \returns false if it could not be decoded
+  *
+  ******************************************************************************/
+bool Prog::decodeOnDemand(UserProc *proc) {
+    LOG_VERBOSE(1) << "decoding " << proc->getName() << " on demand\n";
+    QTextStream os(stderr); // rtl output target
+    if (!DefaultFrontend->processProc(proc->getNativeAddress(), proc, os))
+        return false;
+    proc->setDecoded();
+    proc->assignProcsToCalls();
+    proc->finalSimplify();
+    DecompileStats::get().count(proc, "decode", "on demand");
+    return true;
+}
+
 void Prog::decodeFragment(UserProc *proc, ADDRESS a) {
     if (a >= Image->getLimitTextLow() && a < Image->getLimitTextHigh())
         DefaultFrontend->decodeFragment(proc, a);
@@ -1657,7 +2675,7 @@ Exp *Prog::addReloc(Exp *e, ADDRESS lc) {
         unsigned int sz = bin_sym->getSize(); // TODO: fix the case of missing symbol table interface
         if (getGlobal(bin_sym->getName()) == nullptr) {
             Global *global = new Global(SizeType::get(sz * 8), c_addr, bin_sym->getName(),this);
-            globals.insert(global);
+            addGlobal(global);
         }
         return new Unary(opAddrOf, Location::global(bin_sym->getName(), nullptr));
     } else {
@@ -1682,11 +2700,17 @@ Exp *Prog::addReloc(Exp *e, ADDRESS lc) {
 
 
 bool Prog::isStringConstant(ADDRESS a) {
+    auto found = stringConstants.find(a);
+    if (found != stringConstants.end())
+        return found->second;
     const SectionInfo *si = static_cast<const SectionInfo *>(Image->getSectionInfoByAddr(a));
-    if(!si)
-        return false;
-    QVariant qv = si->attributeInRange("StringsSection",a,a+1);
-    return !qv.isNull();
+    bool res = false;
+    if(si) {
+        QVariant qv = si->attributeInRange("StringsSection",a,a+1);
+        res = !qv.isNull();
+    }
+    stringConstants[a] = res;
+    return res;
 }
 
 bool Prog::isCFStringConstant(ADDRESS a) { return isStringConstant(a); }
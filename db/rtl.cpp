@@ -24,6 +24,7 @@
 #include "operator.h"                   // for OPER::opIntConst
 #include "statement.h"                  // for Instruction, etc
 #include "types.h"                      // for ADDRESS
+#include "util.h"                       // for TextScratch
 
 #include <QString>
 #include <QTextStream>
@@ -178,15 +179,13 @@ void RTL::dump() {
     print(q_cerr);
 }
 
-extern char debug_buffer[];
+extern thread_local char debug_buffer[];
 
 char *RTL::prints() const {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     print(ost);
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 /***************************************************************************/ /**
@@ -218,7 +217,8 @@ bool RTL::areFlagsAffected() {
     return e->isFlagAssgn();
 }
 
-void RTL::simplify() {
+bool RTL::simplify() {
+    bool removed = false;
     for (iterator it = begin(); it != end();) {
         Instruction *s = *it;
         s->simplify();
@@ -228,11 +228,13 @@ void RTL::simplify() {
                 if (((Const *)cond)->getInt() == 0) {
                     LOG_VERBOSE(1) << "removing branch with false condition at " << getAddress() << " " << *it << "\n";
                     it = this->erase(it);
+                    removed = true;
                     continue;
                 }
                 LOG_VERBOSE(1) << "replacing branch with true condition with goto at " << getAddress() << " " << *it
                                << "\n";
                 *it = new GotoStatement(((BranchStatement *)s)->getFixedDest());
+                removed = true;
             }
         } else if (s->isAssign()) {
             Exp *guard = ((Assign *)s)->getGuard();
@@ -240,11 +242,13 @@ void RTL::simplify() {
                 // This assignment statement can be deleted
                 LOG_VERBOSE(1) << "removing assignment with false guard at " << getAddress() << " " << *it << "\n";
                 it = erase(it);
+                removed = true;
                 continue;
             }
         }
         it++;
     }
+    return removed;
 }
 // Is this RTL a compare instruction? If so, the passed register and compared value (a semantic string) are set.
 
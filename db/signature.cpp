@@ -32,7 +32,7 @@
 #include <string>
 #include <cstring>
 #include <sstream>
-extern char debug_buffer[]; // For prints()
+extern thread_local char debug_buffer[]; // For prints()
 
 QString Signature::platformName(platform plat) {
     switch (plat) {
@@ -279,10 +279,18 @@ static void cloneVec(Returns &from, Returns &to) {
         to[i] = from[i]->clone();
 }
 
+Parameter::Parameter(SharedType _type, const QString &_name, Exp *_exp, const QString &_boundMax)
+    : type(_type), m_name(_name), exp(Exp::outsideArena(_exp)), boundMax(_boundMax) {}
+
 Parameter::~Parameter() {
     delete exp;
 }
-Parameter *Parameter::clone() { return new Parameter(type->clone(), m_name, exp->clone(), boundMax); }
+Parameter *Parameter::clone() {
+    ArenaScope onHeap(nullptr); // Like the original, the copy outlives the proc being decompiled
+    return new Parameter(type->clone(), m_name, exp->clone(), boundMax);
+}
+
+void Parameter::setExp(Exp *e) { exp = Exp::outsideArena(e); }
 
 void Parameter::setBoundMax(const QString &nam) {
     boundMax = nam;
@@ -1414,7 +1422,7 @@ void Signature::addReturn(SharedType type, Exp *exp) {
 // Deprecated. Use the above version.
 void Signature::addReturn(Exp *exp) {
     // addReturn(exp->getType() ? exp->getType() : new IntegerType(), exp);
-    addReturn(std::make_shared<VoidType>(), exp);
+    addReturn(VoidType::get(), exp);
 }
 
 void Signature::removeReturn(Exp *e) {
@@ -1426,51 +1434,71 @@ void Signature::removeReturn(Exp *e) {
     }
 }
 
+void Signature::setReturnExp(size_t n, Exp *e) { returns[n]->exp = Exp::outsideArena(e); }
+
 void Signature::setReturnType(size_t n, SharedType ty) {
     if (n < returns.size())
         returns[n]->type = ty;
 }
 
 Exp *Signature::getArgumentExp(int n) { return getParamExp(n); }
-//! any signature can be promoted to a higher level signature, if available
+namespace {
+//! The signature classes Signature::promote() can promote to
+enum PromotionKind { PROMOTE_NONE, PROMOTE_WIN32, PROMOTE_PENTIUM, PROMOTE_SPARC, PROMOTE_PPC, PROMOTE_ST20 };
+
+//! The first signature class, in the order they are tried, that \a p qualifies for
+PromotionKind qualifyingPromotion(UserProc *p, Signature &candidate) {
+    if (CallingConvention::Win32Signature::qualified(p, candidate))
+        return PROMOTE_WIN32;
+    if (CallingConvention::StdC::PentiumSignature::qualified(p, candidate))
+        return PROMOTE_PENTIUM;
+    if (CallingConvention::StdC::SparcSignature::qualified(p, candidate))
+        return PROMOTE_SPARC;
+    if (CallingConvention::StdC::PPCSignature::qualified(p, candidate))
+        return PROMOTE_PPC;
+    if (CallingConvention::StdC::ST20Signature::qualified(p, candidate))
+        return PROMOTE_ST20;
+    return PROMOTE_NONE;
+}
+}
+
+/***************************************************************************/ /**
+  * \brief   Any signature can be promoted to a higher level signature, if available
+  *
+  * The tests depend on the platform and on what is proven about the entry and exit of \a p, so what they find is
+  * kept with the proc (see UserProc::getCachedPromotion()) and reused until its summary generation moves. On the
+  * platforms no class qualifies for, that saves running them at each point a signature is promoted.
+  ******************************************************************************/
 Signature *Signature::promote(UserProc *p) {
     // FIXME: the whole promotion idea needs a redesign...
-    if (CallingConvention::Win32Signature::qualified(p, *this)) {
-        Signature *sig = new CallingConvention::Win32Signature(*this);
-        //        sig->analyse(p);
-        delete this;
-        return sig;
-    }
-
-    if (CallingConvention::StdC::PentiumSignature::qualified(p, *this)) {
-        Signature *sig = new CallingConvention::StdC::PentiumSignature(*this);
-        //        sig->analyse(p);
-        delete this;
-        return sig;
-    }
-
-    if (CallingConvention::StdC::SparcSignature::qualified(p, *this)) {
-        Signature *sig = new CallingConvention::StdC::SparcSignature(*this);
-        //        sig->analyse(p);
-        delete this;
-        return sig;
-    }
-
-    if (CallingConvention::StdC::PPCSignature::qualified(p, *this)) {
-        Signature *sig = new CallingConvention::StdC::PPCSignature(*this);
-        //        sig->analyse(p);
-        delete this;
-        return sig;
-    }
-
-    if (CallingConvention::StdC::ST20Signature::qualified(p, *this)) {
-        Signature *sig = new CallingConvention::StdC::ST20Signature(*this);
-        //        sig->analyse(p);
-        delete this;
-        return sig;
+    int kind;
+    if (!p->getCachedPromotion(kind)) {
+        kind = qualifyingPromotion(p, *this);
+        p->setCachedPromotion(kind);
+    }
+    Signature *sig;
+    switch (kind) {
+    case PROMOTE_WIN32:
+        sig = new CallingConvention::Win32Signature(*this);
+        break;
+    case PROMOTE_PENTIUM:
+        sig = new CallingConvention::StdC::PentiumSignature(*this);
+        break;
+    case PROMOTE_SPARC:
+        sig = new CallingConvention::StdC::SparcSignature(*this);
+        break;
+    case PROMOTE_PPC:
+        sig = new CallingConvention::StdC::PPCSignature(*this);
+        break;
+    case PROMOTE_ST20:
+        sig = new CallingConvention::StdC::ST20Signature(*this);
+        break;
+    default:
+        return this;
     }
-
-    return this;
+    //        sig->analyse(p);
+    delete this;
+    return sig;
 }
 
 Signature *Signature::instantiate(platform plat, callconv cc, const QString &nam) {
@@ -1527,12 +1555,10 @@ void Signature::print(QTextStream &out, bool /*html*/) const {
 }
 
 char *Signature::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     print(ost);
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 void Signature::printToLog() {
@@ -1680,13 +1706,16 @@ Exp *Signature::getEarlyParamExp(int n, Prog *prog) {
     return nullptr;
 }
 
+// The standard return statements of getStdRetStmt(), at file scope rather than function local statics so that their
+// Exps are never allocated in the arena of the proc that happens to ask first
+// pc := m[r[28]]
+static Assign pent1ret(new Terminal(opPC), Location::memOf(Location::regOf(28)));
+// r[28] := r[28] + 4
+static Assign pent2ret(Location::regOf(28), Binary::get(opPlus, Location::regOf(28), new Const(4)));
+static Assign st20_1ret(new Terminal(opPC), Location::memOf(Location::regOf(3)));
+static Assign st20_2ret(Location::regOf(3), Binary::get(opPlus, Location::regOf(3), new Const(16)));
+
 StatementList &Signature::getStdRetStmt(Prog *prog) {
-    // pc := m[r[28]]
-    static Assign pent1ret(new Terminal(opPC), Location::memOf(Location::regOf(28)));
-    // r[28] := r[28] + 4
-    static Assign pent2ret(Location::regOf(28), Binary::get(opPlus, Location::regOf(28), new Const(4)));
-    static Assign st20_1ret(new Terminal(opPC), Location::memOf(Location::regOf(3)));
-    static Assign st20_2ret(Location::regOf(3), Binary::get(opPlus, Location::regOf(3), new Const(16)));
     MACHINE mach = prog->getMachine();
     switch (mach) {
     case MACHINE_SPARC:
@@ -1752,7 +1781,11 @@ bool Signature::isAddrOfStackLocal(Prog *prog, Exp *e) {
     if (op == opAddrOf)
         return isStackLocal(prog, e->getSubExp1());
     // e must be sp -/+ K or just sp
-    static Exp *sp = Location::regOf(getStackRegister(prog));
+    static Exp *sp = nullptr;
+    if (sp == nullptr) {
+        ArenaScope onHeap(nullptr); // sp outlives the proc being analysed
+        sp = Location::regOf(getStackRegister(prog));
+    }
     if (op != opMinus && op != opPlus) {
         // Matches if e is sp or sp{0} or sp{-}
         return (*e == *sp ||
@@ -1782,7 +1815,11 @@ bool CallingConvention::StdC::SparcSignature::isAddrOfStackLocal(Prog *prog, Exp
     if (op == opAddrOf)
         return isStackLocal(prog, e->getSubExp1());
     // e must be sp -/+ K or just sp
-    static Exp *sp = Location::regOf(14);
+    static Exp *sp = nullptr;
+    if (sp == nullptr) {
+        ArenaScope onHeap(nullptr); // sp outlives the proc being analysed
+        sp = Location::regOf(14);
+    }
     if (op != opMinus && op != opPlus) {
         // Matches if e is sp or sp{0} or sp{-}
         return (*e == *sp ||
@@ -1964,7 +2001,12 @@ bool CallingConvention::StdC::SparcSignature::argumentCompare(Assignment &a, Ass
 }
 
 // Class Return methods
-Return *Return::clone() { return new Return(type->clone(), exp->clone()); }
+Return::Return(SharedType _type, Exp *_exp) : type(_type), exp(Exp::outsideArena(_exp)) {}
+
+Return *Return::clone() {
+    ArenaScope onHeap(nullptr); // Like the original, the copy outlives the proc being decompiled
+    return new Return(type->clone(), exp->clone());
+}
 
 bool Return::operator==(Return &other) {
     if (!(*type == *other.type))
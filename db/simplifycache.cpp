@@ -0,0 +1,165 @@
+/***************************************************************************/ /**
+  * \file       simplifycache.cpp
+  * \brief   Implementation of the SimplifyCache class, a memo for Exp::simplify()
+  ******************************************************************************/
+#include "simplifycache.h"
+
+#include "exp.h"
+#include "type.h"
+
+#include <cstring>
+#include <typeinfo>
+
+SimplifyCache &SimplifyCache::get() {
+    static SimplifyCache theCache;
+    return theCache;
+}
+
+//! Only plain expressions without subscripts; see the class comment
+bool SimplifyCache::isCacheable(const Exp *e) {
+    const std::type_info &ti(typeid(*e));
+    if (ti == typeid(Const)) {
+        // A copy of a Const shares its type, so a cached result with typed constants would share those types with
+        // every expression it is handed out to
+        SharedType ty = static_cast<const Const *>(e)->getType();
+        return ty == nullptr || ty->isVoid();
+    }
+    if (ti != typeid(Terminal) && ti != typeid(Unary) && ti != typeid(Binary) && ti != typeid(Ternary) &&
+        ti != typeid(Location) && ti != typeid(TypedExp))
+        return false;
+    switch (e->getArity()) {
+    case 3:
+        if (!isCacheable(e->getSubExp3()))
+            return false;
+    // fallthrough
+    case 2:
+        if (!isCacheable(e->getSubExp2()))
+            return false;
+    // fallthrough
+    case 1:
+        return isCacheable(e->getSubExp1());
+    default:
+        return true;
+    }
+}
+
+//! Strict structural equality of two cacheable expressions
+bool SimplifyCache::sameExp(const Exp *a, const Exp *b) {
+    if (a == b)
+        return true;
+    if (a->getOper() != b->getOper() || typeid(*a) != typeid(*b))
+        return false;
+    const std::type_info &ti(typeid(*a));
+    if (ti == typeid(Const)) {
+        const Const *ca = static_cast<const Const *>(a);
+        const Const *cb = static_cast<const Const *>(b);
+        if (ca->getConscript() != cb->getConscript())
+            return false;
+        switch (ca->getOper()) {
+        case opIntConst:
+            return ca->getInt() == cb->getInt();
+        case opLongConst:
+            return ca->getLong() == cb->getLong();
+        case opFltConst: {
+            double da = ca->getFlt(), db = cb->getFlt();
+            return memcmp(&da, &db, sizeof(double)) == 0;
+        }
+        case opStrConst:
+            return ca->getStr() == cb->getStr();
+        case opFuncConst:
+            return ca->getFuncName() == cb->getFuncName();
+        default:
+            return true;
+        }
+    }
+    if (ti == typeid(Location) && const_cast<Location *>(static_cast<const Location *>(a))->getProc() !=
+                                      const_cast<Location *>(static_cast<const Location *>(b))->getProc())
+        return false;
+    if (ti == typeid(TypedExp) && !(*static_cast<const TypedExp *>(a)->getType() ==
+                                    *static_cast<const TypedExp *>(b)->getType()))
+        return false;
+    switch (a->getArity()) {
+    case 3:
+        if (!sameExp(a->getSubExp3(), b->getSubExp3()))
+            return false;
+    // fallthrough
+    case 2:
+        if (!sameExp(a->getSubExp2(), b->getSubExp2()))
+            return false;
+    // fallthrough
+    case 1:
+        return sameExp(a->getSubExp1(), b->getSubExp1());
+    default:
+        return true;
+    }
+}
+
+//! Delete \a e, a copy the cache made, and its subexpressions, which (being cloned) it has to itself
+void SimplifyCache::deleteCopy(Exp *e) {
+    if (e == nullptr)
+        return;
+    switch (e->getArity()) {
+    case 3:
+        deleteCopy(e->getSubExp3());
+    // fallthrough
+    case 2:
+        deleteCopy(e->getSubExp2());
+    // fallthrough
+    case 1:
+        deleteCopy(e->getSubExp1());
+    // fallthrough
+    default:
+        delete e;
+    }
+}
+
+//! Delete the entries and the copies they hold
+void SimplifyCache::deleteEntries() {
+    for (const auto &ent : table) {
+        deleteCopy(ent.second.key);
+        deleteCopy(ent.second.result);
+    }
+    table.clear();
+}
+
+/***************************************************************************/ /**
+  * \brief  Simplify e, reusing the result of an earlier simplification of the same expression if there is one
+  * \note   Like Exp::simplify(), this may change e in place; only the returned expression is meaningful. On a hit e is
+  *         left alone and a fresh copy of the remembered result is returned
+  * \param  e expression to simplify
+  * \returns the simplified expression
+  ******************************************************************************/
+Exp *SimplifyCache::simplify(Exp *e) {
+    if (e->getArity() == 0 || !isCacheable(e))
+        return e->simplifyUncached();
+    size_t h = e->hash();
+    auto range = table.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (sameExp(it->second.key, e)) {
+            ++hits;
+            return it->second.result ? it->second.result->clone() : e;
+        }
+    }
+    ++misses;
+    Entry ent;
+    {
+        ArenaScope onHeap(nullptr); // The cache outlives the current proc
+        ent.key = e->clone();
+    }
+    Exp *res = e->simplifyUncached();
+    ent.result = nullptr;
+    if (!sameExp(res, ent.key)) {
+        ArenaScope onHeap(nullptr);
+        ent.result = res->clone();
+    }
+    if (table.size() >= MAX_ENTRIES)
+        deleteEntries(); // Crude, but keeps the memory bounded
+    table.insert(std::make_pair(h, ent));
+    return res;
+}
+
+//! Forget the remembered simplifications and reset the counters
+void SimplifyCache::clear() {
+    deleteEntries();
+    hits = misses = 0;
+}
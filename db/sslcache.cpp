@@ -0,0 +1,524 @@
+/***************************************************************************/ /**
+  * \file       sslcache.cpp
+  * \brief   Binary cache of the parsed SSL dictionary (RTLInstDict::readCache and RTLInstDict::writeCache)
+  *
+  * Parsing the SSL file of a large machine such as pentium takes a good part of the start up time of a short run. With
+  * --ssl-cache, the dictionary as it stands after parsing and fixupParams() is written next to the SSL file, as
+  * <file>.cache, and read back instead of parsing on later runs. The file starts with a magic string, a format version
+  * and a key: a hash of the version of Boomerang, the names of the operators (which are written by number) and the
+  * contents of the SSL file. A cache with any other key is ignored and rewritten.
+  *
+  * Only what the SSL parser produces is written: assignments, and expressions made of constants, terminals, unary,
+  * binary and ternary expressions, locations and flag definitions. Should the dictionary contain anything else, no
+  * cache is written.
+ *
+ * The same format, kept in memory (RTLInstDict::warmImages), is how a process with warmCaches set shares one parse of
+ * each SSL file between the decoders of all the programs it decompiles.
+  ******************************************************************************/
+#include "rtl.h"
+
+#include "boomerang.h"
+#include "exp.h"
+#include "operator.h"
+#include "statement.h"
+#include "type.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+
+#include <cstring>
+
+extern const char *operStrings[];
+
+namespace {
+const char *const MAGIC = "boomerang-ssl-cache";
+const quint32 FORMAT_VERSION = 1;
+
+class CacheWriter {
+    QDataStream &os;
+
+    void writeStrings(const std::list<QString> &l) {
+        os << (quint32)l.size();
+        for (const QString &s : l)
+            os << s;
+    }
+
+  public:
+    CacheWriter(QDataStream &s) : os(s) {}
+
+    //! Write \a ty, returning false for the types the SSL parser does not make
+    bool type(const SharedType &ty) {
+        if (ty == nullptr)
+            os << (quint8)'n';
+        else if (ty->isVoid())
+            os << (quint8)'v';
+        else if (ty->isBoolean())
+            os << (quint8)'b';
+        else if (ty->isChar())
+            os << (quint8)'c';
+        else if (ty->isInteger())
+            os << (quint8)'i' << (qint32)ty->getSize() << (qint32)ty->as<IntegerType>()->getSignedness();
+        else if (ty->isFloat())
+            os << (quint8)'f' << (qint32)ty->getSize();
+        else if (ty->isSize())
+            os << (quint8)'z' << (qint32)ty->getSize();
+        else if (ty->isPointer()) {
+            os << (quint8)'p';
+            return type(ty->as<PointerType>()->getPointsTo());
+        } else
+            return false;
+        return true;
+    }
+
+    bool exp(const Exp *e) {
+        if (e == nullptr) {
+            os << (quint8)'n';
+            return true;
+        }
+        OPER op = e->getOper();
+        if (const Const *c = dynamic_cast<const Const *>(e)) {
+            // Constants are made with the void type, which the reader gives them back; any other type is not written
+            SharedType ty = c->getType();
+            if (ty != nullptr && !ty->isVoid())
+                return false;
+            switch (op) {
+            case opIntConst:
+                os << (quint8)'k' << (qint32)c->getInt();
+                return true;
+            case opLongConst:
+                os << (quint8)'q' << (quint64)c->getLong();
+                return true;
+            case opFltConst:
+                os << (quint8)'d' << c->getFlt();
+                return true;
+            case opStrConst:
+                os << (quint8)'s' << c->getStr();
+                return true;
+            default:
+                return false;
+            }
+        }
+        if (op == opTypeVal || op == opTypedExp || op == opSubscript)
+            return false;
+        if (op == opFlagDef) {
+            os << (quint8)'F';
+            return exp(e->getSubExp1()) && rtl(*((FlagDef *)e)->getRtl());
+        }
+        switch (e->getArity()) {
+        case 0:
+            os << (quint8)'t' << (quint16)op;
+            return true;
+        case 1:
+            os << (quint8)(dynamic_cast<const Location *>(e) ? 'l' : 'u') << (quint16)op;
+            return exp(e->getSubExp1());
+        case 2:
+            os << (quint8)'b' << (quint16)op;
+            return exp(e->getSubExp1()) && exp(e->getSubExp2());
+        case 3:
+            os << (quint8)'3' << (quint16)op;
+            return exp(e->getSubExp1()) && exp(e->getSubExp2()) && exp(e->getSubExp3());
+        }
+        return false;
+    }
+
+    bool stmt(Instruction *s) {
+        if (s == nullptr) {
+            os << (quint8)'n';
+            return true;
+        }
+        if (!s->isAssign())
+            return false;
+        Assign *as = (Assign *)s;
+        os << (quint8)'A';
+        return type(as->getType()) && exp(as->getLeft()) && exp(as->getRight()) && exp(as->getGuard());
+    }
+
+    bool rtl(const std::list<Instruction *> &l) {
+        os << (quint32)l.size();
+        for (Instruction *s : l)
+            if (!stmt(s))
+                return false;
+        return true;
+    }
+
+    void reg(const Register &r) {
+        os << r.g_name() << (qint32)r.g_size() << r.isFloat() << (qint32)r.g_mappedIndex()
+           << (qint32)r.g_mappedOffset();
+    }
+
+    bool param(const ParamEntry &p) {
+        writeStrings(p.params);
+        writeStrings(p.funcParams);
+        os << p.lhs << (qint32)p.kind << (qint32)p.mark << (quint32)p.regIdx.size();
+        for (int i : p.regIdx)
+            os << (qint32)i;
+        return type(p.regType) && stmt(p.asgn);
+    }
+
+    void strings(const std::list<QString> &l) { writeStrings(l); }
+};
+
+class CacheReader {
+    QDataStream &is;
+
+    quint8 tag() {
+        quint8 t = 0;
+        is >> t;
+        return t;
+    }
+    qint32 int32() {
+        qint32 i = 0;
+        is >> i;
+        return i;
+    }
+    OPER oper(bool &ok) {
+        quint16 op = 0;
+        is >> op;
+        ok &= op < opNumOf;
+        return (OPER)op;
+    }
+
+  public:
+    CacheReader(QDataStream &s) : is(s) {}
+    bool good() const { return is.status() == QDataStream::Ok; }
+
+    SharedType type(bool &ok) {
+        switch (tag()) {
+        case 'n':
+            return nullptr;
+        case 'v':
+            return VoidType::get();
+        case 'b':
+            return BooleanType::get();
+        case 'c':
+            return CharType::get();
+        case 'i': {
+            int size = int32();
+            return IntegerType::get(size, int32());
+        }
+        case 'f':
+            return FloatType::get(int32());
+        case 'z':
+            return SizeType::get(int32());
+        case 'p':
+            return PointerType::get(type(ok));
+        }
+        ok = false;
+        return nullptr;
+    }
+
+    Exp *exp(bool &ok) {
+        quint8 t = tag();
+        switch (t) {
+        case 'n':
+            return nullptr;
+        case 'k':
+            return Const::get((int)int32());
+        case 'q': {
+            quint64 ll = 0;
+            is >> ll;
+            return Const::get((QWord)ll);
+        }
+        case 'd': {
+            double d = 0;
+            is >> d;
+            return Const::get(d);
+        }
+        case 's': {
+            QString s;
+            is >> s;
+            return Const::get(s);
+        }
+        case 'F': {
+            Exp *params = exp(ok);
+            RTL *r = new RTL;
+            ok &= rtl(*r);
+            return new FlagDef(params, r);
+        }
+        case 't':
+        case 'l':
+        case 'u':
+        case 'b':
+        case '3':
+            break;
+        default:
+            ok = false;
+            return nullptr;
+        }
+        OPER op = oper(ok);
+        if (!ok || !good())
+            return nullptr;
+        if (t == 't')
+            return Terminal::get(op);
+        Exp *e1 = exp(ok);
+        if (t == 'l')
+            return Location::get(op, e1, nullptr);
+        if (t == 'u')
+            return Unary::get(op, e1);
+        Exp *e2 = exp(ok);
+        if (t == 'b')
+            return Binary::get(op, e1, e2);
+        return new Ternary(op, e1, e2, exp(ok));
+    }
+
+    Instruction *stmt(bool &ok) {
+        quint8 t = tag();
+        if (t == 'n')
+            return nullptr;
+        if (t != 'A') {
+            ok = false;
+            return nullptr;
+        }
+        SharedType ty = type(ok);
+        Exp *lhs = exp(ok);
+        Exp *rhs = exp(ok);
+        Exp *guard = exp(ok);
+        if (!ok || lhs == nullptr || rhs == nullptr)
+            return nullptr;
+        return new Assign(ty, lhs, rhs, guard);
+    }
+
+    bool rtl(std::list<Instruction *> &l) {
+        bool ok = true;
+        quint32 n = 0;
+        is >> n;
+        for (quint32 i = 0; ok && good() && i < n; i++) {
+            Instruction *s = stmt(ok);
+            if (s == nullptr)
+                ok = false;
+            else
+                l.push_back(s);
+        }
+        return ok && good();
+    }
+
+    void reg(Register &r) {
+        QString name;
+        bool flt = false;
+        is >> name;
+        r.s_name(name);
+        r.s_size(int32());
+        is >> flt;
+        r.s_float(flt);
+        r.s_address(nullptr);
+        r.s_mappedIndex(int32());
+        r.s_mappedOffset(int32());
+    }
+
+    void strings(std::list<QString> &l) {
+        quint32 n = 0;
+        is >> n;
+        for (quint32 i = 0; good() && i < n; i++) {
+            QString s;
+            is >> s;
+            l.push_back(s);
+        }
+    }
+
+    bool param(ParamEntry &p) {
+        strings(p.params);
+        strings(p.funcParams);
+        quint32 n = 0;
+        is >> p.lhs;
+        p.kind = (ParamKind)int32();
+        p.mark = int32();
+        is >> n;
+        for (quint32 i = 0; good() && i < n; i++)
+            p.regIdx.insert(int32());
+        bool ok = true;
+        p.regType = type(ok);
+        p.asgn = stmt(ok);
+        return ok && good();
+    }
+};
+
+void setVersion(QDataStream &s) { s.setVersion(QDataStream::Qt_5_0); }
+}
+
+/***************************************************************************/ /**
+  * \brief   The key of the cache of an SSL file with the given contents
+  ******************************************************************************/
+QByteArray RTLInstDict::getCacheKey(const QByteArray &contents) {
+    QCryptographicHash h(QCryptographicHash::Sha1);
+    h.addData(QByteArray(MAGIC));
+    h.addData(QByteArray(Boomerang::getVersionStr()));
+    for (int i = 0; i < opNumOf; i++)
+        h.addData(operStrings[i], (int)strlen(operStrings[i]) + 1);
+    h.addData(contents);
+    return h.result();
+}
+
+/***************************************************************************/ /**
+  * \brief   Fill the dictionary from the cache file \a path, if it was written with the given key
+  * \returns false if there is no such cache, or it can't be read; the dictionary is then reset
+  ******************************************************************************/
+bool RTLInstDict::readCache(const QString &path, const QByteArray &key) {
+    QFile f(path);
+    if (!f.open(QFile::ReadOnly))
+        return false;
+    return readImage(f.readAll(), key);
+}
+
+/***************************************************************************/ /**
+  * \brief   Fill the dictionary from \a image, as made by writeImage() with the given key
+  * \returns false if the image is empty, has another key or can't be read; the dictionary is then reset
+  ******************************************************************************/
+bool RTLInstDict::readImage(const QByteArray &image, const QByteArray &key) {
+    QDataStream is(image);
+    setVersion(is);
+    QByteArray magic, fileKey;
+    quint32 version = 0;
+    is >> magic >> version >> fileKey;
+    if (magic != MAGIC || version != FORMAT_VERSION || fileKey != key)
+        return false;
+
+    CacheReader rd(is);
+    bool ok = true;
+    quint32 n = 0;
+    is >> n;
+    for (quint32 i = 0; rd.good() && i < n; i++) {
+        QString name;
+        qint32 id = 0;
+        is >> name >> id;
+        RegMap[name] = id;
+    }
+    is >> n;
+    for (quint32 i = 0; rd.good() && i < n; i++) {
+        qint32 id = 0;
+        is >> id;
+        rd.reg(DetRegMap[id]);
+    }
+    is >> n;
+    for (quint32 i = 0; rd.good() && i < n; i++) {
+        QString name;
+        is >> name;
+        rd.reg(SpecialRegMap[name]);
+    }
+    is >> n;
+    for (quint32 i = 0; rd.good() && i < n; i++) {
+        QString name;
+        is >> name;
+        ParamSet.insert(name);
+    }
+    is >> n;
+    for (quint32 i = 0; ok && rd.good() && i < n; i++) {
+        QString name;
+        is >> name;
+        ok = rd.param(DetParamMap[name]);
+    }
+    is >> n;
+    for (quint32 i = 0; ok && rd.good() && i < n; i++) {
+        QString name;
+        is >> name;
+        FlagFuncs[name] = rd.exp(ok);
+    }
+    is >> n;
+    for (quint32 i = 0; rd.good() && i < n; i++) {
+        QString from, to;
+        is >> from >> to;
+        fastMap[from] = to;
+    }
+    is >> bigEndian;
+    is >> n;
+    for (quint32 i = 0; ok && rd.good() && i < n; i++) {
+        QString name;
+        qint32 flags = 0;
+        is >> name;
+        TableEntry &entry(idict[name]);
+        rd.strings(entry.params);
+        ok = rd.rtl(entry.rtl);
+        is >> flags;
+        entry.flags = flags;
+    }
+    bool haveCycle = false;
+    is >> haveCycle;
+    if (ok && haveCycle) {
+        fetchExecCycle = new std::list<Instruction *>;
+        ok = rd.rtl(*fetchExecCycle);
+    }
+    if (!ok || !rd.good() || !is.atEnd()) {
+        reset();
+        return false;
+    }
+    return true;
+}
+
+/***************************************************************************/ /**
+  * \brief   Write the dictionary to the cache file \a path, with the given key. Nothing is written if the dictionary
+  * holds something the cache can't represent, or the file can't be written (e.g. a read only installation).
+  ******************************************************************************/
+bool RTLInstDict::writeCache(const QString &path, const QByteArray &key) const {
+    QByteArray data = writeImage(key);
+    if (data.isEmpty())
+        return false;
+    QSaveFile f(path);
+    if (!f.open(QFile::WriteOnly))
+        return false;
+    f.write(data);
+    return f.commit();
+}
+
+/***************************************************************************/ /**
+  * \brief   The dictionary in the format of the cache file, with the given key; empty if it holds something the
+  * format can't represent
+  ******************************************************************************/
+QByteArray RTLInstDict::writeImage(const QByteArray &key) const {
+    if (!DefMap.empty() || !AliasMap.empty())
+        return QByteArray();
+    QByteArray data;
+    QDataStream os(&data, QIODevice::WriteOnly);
+    setVersion(os);
+    os << QByteArray(MAGIC) << FORMAT_VERSION << key;
+
+    CacheWriter wr(os);
+    os << (quint32)RegMap.size();
+    for (const auto &r : RegMap)
+        os << r.first << (qint32)r.second;
+    os << (quint32)DetRegMap.size();
+    for (const auto &r : DetRegMap) {
+        if (r.second.g_address() != nullptr)
+            return QByteArray();
+        os << (qint32)r.first;
+        wr.reg(r.second);
+    }
+    os << (quint32)SpecialRegMap.size();
+    for (const auto &r : SpecialRegMap) {
+        if (r.second.g_address() != nullptr)
+            return QByteArray();
+        os << r.first;
+        wr.reg(r.second);
+    }
+    os << (quint32)ParamSet.size();
+    for (const QString &p : ParamSet)
+        os << p;
+    os << (quint32)DetParamMap.size();
+    for (auto it = DetParamMap.begin(); it != DetParamMap.end(); ++it) {
+        os << it.key();
+        if (!wr.param(it.value()))
+            return QByteArray();
+    }
+    os << (quint32)FlagFuncs.size();
+    for (const auto &ff : FlagFuncs) {
+        os << ff.first;
+        if (!wr.exp(ff.second))
+            return QByteArray();
+    }
+    os << (quint32)fastMap.size();
+    for (const auto &fm : fastMap)
+        os << fm.first << fm.second;
+    os << bigEndian;
+    os << (quint32)idict.size();
+    for (const auto &entry : idict) {
+        os << entry.first;
+        wr.strings(entry.second.params);
+        if (!wr.rtl(entry.second.rtl))
+            return QByteArray();
+        os << (qint32)entry.second.flags;
+    }
+    os << (fetchExecCycle != nullptr);
+    if (fetchExecCycle && !wr.rtl(*fetchExecCycle))
+        return QByteArray();
+    return data;
+}
@@ -34,9 +34,14 @@
 #include "boomerang.h"
 #include "util.h"
 
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <cassert>
 #include <cstring>
 #include <algorithm> // For remove()
+#include <mutex>
 
 //#define DEBUG_SSLPARSER 1
 
@@ -60,14 +65,20 @@ TableEntry::TableEntry(std::list<QString> &p, RTL &r) : rtl(r) {
   * \brief        Set the parameter list.
   * \param        p - a list of strings
   ******************************************************************************/
-void TableEntry::setParam(std::list<QString> &p) { params = p; }
+void TableEntry::setParam(std::list<QString> &p) {
+    params = p;
+    compiled = false;
+}
 
 /***************************************************************************/ /**
   * \brief        Set the RTL.
   * \param        r - a RTL
   *
   ******************************************************************************/
-void TableEntry::setRTL(RTL &r) { rtl = r; }
+void TableEntry::setRTL(RTL &r) {
+    rtl = r;
+    compiled = false;
+}
 
 /***************************************************************************/ /**
   * \brief Sets the contents of this object with a deepcopy from another TableEntry object.  Note that this is
@@ -78,6 +89,7 @@ void TableEntry::setRTL(RTL &r) { rtl = r; }
 TableEntry &TableEntry::operator=(const TableEntry &other) {
     params = other.params;
     rtl = other.rtl;
+    compiled = false;
     return *this;
 }
 
@@ -95,6 +107,7 @@ int TableEntry::appendRTL(std::list<QString> &p, RTL &r) {
         ;
     if (match) {
         rtl.appendListStmt(r);
+        compiled = false;
         return 0;
     }
     return -1;
@@ -121,6 +134,9 @@ int RTLInstDict::appendToDict(const QString &n, std::list<QString> &p, RTL &r) {
     return 0;
 }
 
+std::map<QString, QByteArray> RTLInstDict::warmImages;
+std::mutex RTLInstDict::warmLock;
+
 RTLInstDict::RTLInstDict() {}
 RTLInstDict::~RTLInstDict() {}
 
@@ -136,22 +152,57 @@ bool RTLInstDict::readSSLFile(const QString &SSLFileName) {
     // Clear all state
     reset();
 
-    // Attempt to Parse the SSL file
-    SSLParser theParser(qPrintable(SSLFileName),
+    QFile sslFile(SSLFileName);
+    QByteArray contents;
+    if (sslFile.open(QFile::ReadOnly))
+        contents = sslFile.readAll();
+    Fingerprint = QCryptographicHash::hash(contents, QCryptographicHash::Sha1);
+    // With --ssl-cache, use the dictionary saved by an earlier run from the same file (see sslcache.cpp); with
+    // warmCaches, the one read earlier in this process
+    bool useCache = Boomerang::get()->sslCache && !contents.isEmpty();
+    bool useWarm = Boomerang::get()->warmCaches && !contents.isEmpty();
+    QString cacheName = SSLFileName + ".cache";
+    QString warmName = QDir::cleanPath(QFileInfo(SSLFileName).absoluteFilePath());
+    QByteArray cacheKey;
+    if (useCache || useWarm)
+        cacheKey = getCacheKey(contents);
+    bool warm = false;
+    if (useWarm) {
+        QByteArray image;
+        {
+            std::lock_guard<std::mutex> guard(warmLock);
+            auto it = warmImages.find(warmName);
+            if (it != warmImages.end())
+                image = it->second;
+        }
+        warm = readImage(image, cacheKey);
+    }
+    if (!warm && (!useCache || !readCache(cacheName, cacheKey))) {
+        // Attempt to Parse the SSL file
+        SSLParser theParser(qPrintable(SSLFileName),
 #ifdef DEBUG_SSLPARSER
-                        true
+                            true
 #else
-                        false
+                            false
 #endif
-                        );
-    if (theParser.theScanner == nullptr)
-        return false;
-    addRegister("%CTI", -1, 1, false);
-    addRegister("%NEXT", -1, 32, false);
+                            );
+        if (theParser.theScanner == nullptr)
+            return false;
+        addRegister("%CTI", -1, 1, false);
+        addRegister("%NEXT", -1, 32, false);
 
-    theParser.yyparse(*this);
+        theParser.yyparse(*this);
 
-    fixupParams();
+        fixupParams();
+        if (useCache)
+            writeCache(cacheName, cacheKey);
+    }
+    if (useWarm && !warm) {
+        QByteArray image = writeImage(cacheKey);
+        std::lock_guard<std::mutex> guard(warmLock);
+        warmImages[warmName] = image;
+    }
+    buildRegTables();
 
     if (Boomerang::get()->debugDecoder) {
         QTextStream q_cout(stdout);
@@ -189,6 +240,36 @@ void RTLInstDict::addRegister(const QString &name, int id, int size, bool flt) {
     }
 }
 
+/***************************************************************************/ /**
+  * \brief Fill regNames, regSizes and regIndex from RegMap and DetRegMap
+  *
+  * Where several names map to the same number, the first by RegMap's order names it, as the search of RegMap this
+  * replaces found.
+  ******************************************************************************/
+void RTLInstDict::buildRegTables() {
+    regNames.clear();
+    regSizes.clear();
+    regIndex.clear();
+    int count = 0;
+    for (const auto &r : RegMap)
+        count = std::max(count, r.second + 1);
+    if (!DetRegMap.empty())
+        count = std::max(count, DetRegMap.rbegin()->first + 1);
+    regNames.resize(count);
+    regSizes.assign(count, 32);
+    for (const auto &r : RegMap) {
+        if (r.second < 0)
+            continue;
+        regIndex.insert(r.first, r.second);
+        if (regNames[r.second].isEmpty())
+            regNames[r.second] = r.first;
+    }
+    for (const auto &r : DetRegMap) {
+        if (r.first >= 0)
+            regSizes[r.first] = r.second.g_size();
+    }
+}
+
 /***************************************************************************/ /**
   * \brief        Print a textual representation of the dictionary.
   * \param        os - stream used for printing
@@ -318,6 +399,24 @@ std::pair<QString, unsigned> RTLInstDict::getSignature(const char *name) {
     return {hlpr, (it->second).params.size()};
 }
 
+/***************************************************************************/ /**
+  * \brief   The dictionary entry for the opcode \a name, as spelt by the decoders (in any case, with dots), or nullptr
+  * if there is none. Resolved names are remembered by address, and checked against their text in case the caller's
+  * buffer was reused.
+  ******************************************************************************/
+TableEntry *RTLInstDict::lookupOpcode(const char *name) {
+    auto found = opcodeCache.find(name);
+    if (found != opcodeCache.end() && strcmp(found->second.name.constData(), name) == 0)
+        return found->second.entry;
+    QString hlpr(name);
+    hlpr = hlpr.replace(".", "").toUpper();
+    auto it = idict.find(hlpr);
+    if (it == idict.end())
+        return nullptr;
+    opcodeCache[name] = OpcodeEntry{QByteArray(name), &it->second};
+    return &it->second;
+}
+
 /***************************************************************************/ /**
   * \brief         Scan the Exp* pointed to by exp; if its top level operator indicates even a partial type, then set
   *                        the expression's type, and return true
@@ -364,9 +463,71 @@ std::list<Instruction *> *RTLInstDict::instantiateRTL(const QString &name, ADDRE
         q_cerr << "ERROR: unknown instruction " << lname << " at " << natPC << ", ignoring.\n";
         return nullptr;
     }
-    TableEntry &entry(dict_entry->second);
+    return instantiateRTL(dict_entry->second, natPC, actuals);
+}
+
+/***************************************************************************/ /**
+  * \brief         As above, for an entry already looked up (see lookupOpcode)
+  ******************************************************************************/
+std::list<Instruction *> *RTLInstDict::instantiateRTL(TableEntry &entry, ADDRESS natPC,
+                                                    const std::vector<Exp *> &actuals) {
+    if (!entry.compiled)
+        compileEntry(entry);
+    assert(entry.formals.size() == actuals.size());
+
+    // Get a deep copy of the template RTL, and substitute the actuals where the formals are used
+    std::list<Instruction *> *newList = new std::list<Instruction *>();
+    entry.rtl.deepCopyList(*newList);
+    auto uses = entry.paramUses.begin();
+    for (Instruction *ss : *newList) {
+        for (int p : *uses++)
+            ss->searchAndReplace(*entry.formals[p], actuals[p]);
+        ss->fixSuccessor();
+        if (Boomerang::get()->debugDecoder) {
+            QTextStream q_cout(stdout);
+            q_cout << "            " << ss << "\n";
+        }
+    }
+
+    if (entry.hasPostVars)
+        transformPostVars(*newList, true);
+
+    // Perform simplifications, e.g. *1 in Pentium addressing modes
+    for (Instruction *ss : *newList)
+        ss->simplify();
 
-    return instantiateRTL(entry.rtl, natPC, entry.params, actuals);
+    return newList;
+}
+
+/***************************************************************************/ /**
+  * \brief   Prepare a dictionary entry for instantiation: build its formal parameters once, and record which of them
+  *          each statement of the template uses, so that instantiating it only substitutes those.
+  *
+  * The uses are found by substituting every formal into a scratch copy of the template. transformPostVars is
+  * only needed when the template has post-variables; it can't be run ahead of time, because whether a temporary is
+  * needed depends on the actuals (two operands may be the same register).
+  * \param entry - the entry to compile
+  ******************************************************************************/
+void RTLInstDict::compileEntry(TableEntry &entry) {
+    ArenaScope onHeap(nullptr); // Compiled during decoding, in the arena of the proc, but the entry outlives it
+    entry.formals.clear();
+    entry.paramUses.clear();
+    for (const QString &param : entry.params)
+        entry.formals.push_back(new Location(opParam, Const::get(param), nullptr));
+    entry.hasPostVars = false;
+    std::list<Instruction *> scratch;
+    entry.rtl.deepCopyList(scratch);
+    for (Instruction *ss : scratch) {
+        if (ss->isAssign() && ((Assign *)ss)->getLeft()->isPostVar())
+            entry.hasPostVars = true;
+        std::vector<int> used;
+        for (size_t p = 0; p < entry.formals.size(); p++)
+            if (ss->searchAndReplace(*entry.formals[p], entry.formals[p]))
+                used.push_back(p);
+        entry.paramUses.push_back(used);
+        delete ss;
+    }
+    entry.compiled = true;
 }
 
 /***************************************************************************/ /**
@@ -592,6 +753,9 @@ void RTLInstDict::reset() {
     RegMap.clear();
     DetRegMap.clear();
     SpecialRegMap.clear();
+    regNames.clear();
+    regSizes.clear();
+    regIndex.clear();
     ParamSet.clear();
     DetParamMap.clear();
     FlagFuncs.clear();
@@ -599,5 +763,6 @@ void RTLInstDict::reset() {
     AliasMap.clear();
     fastMap.clear();
     idict.clear();
+    opcodeCache.clear();
     fetchExecCycle = nullptr;
 }
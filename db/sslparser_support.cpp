@@ -91,7 +91,7 @@ int SSLParser::yylex() {
   * \returns An OPER, or -1 if not found (enum opWild)
   ******************************************************************************/
 OPER SSLParser::strToOper(const QString &s) {
-    static QMap<QString,OPER> opMap {
+    static const QMap<QString,OPER> opMap {
         {"*",opMult},{"*!",opMults} , {"*f",opFMult},{"*fsd",opFMultsd},{"*fdq",opFMultdq},
         {"/",opDiv},{"/!",opDivs} , {"/f",opFDiv},{"/fs",opFDiv},{"/fd",opFDivd},{"/fq",opFDivq},
         {"%",opMod},{"%!",opMods}, // no FMod ?
@@ -104,7 +104,7 @@ OPER SSLParser::strToOper(const QString &s) {
     };
         // Could be *, *!, *f, *fsd, *fdq, *f[sdq]
     if(opMap.contains(s))
-        return opMap[s];
+        return opMap.value(s);
     //
     switch (s[0].toLatin1()) {
     case 'a':
@@ -200,13 +200,13 @@ OPER SSLParser::strToOper(const QString &s) {
 }
 
 OPER strToTerm(const QString &s) {
-    static QMap<QString,OPER> mapping = {
+    static const QMap<QString,OPER> mapping = {
         {"%pc",opPC},{"%afp",opAFP},{"%agp",opAGP},{"%CF",opCF},
         {"%ZF",opZF},{"%OF",opOF},{"%NF",opNF},{"%DF",opDF},{"%flags",opFlags},
         {"%fflags",opFflags},
     };
     if(mapping.contains(s))
-        return mapping[s];
+        return mapping.value(s);
     return (OPER)0;
 }
 
@@ -218,16 +218,10 @@ OPER strToTerm(const QString &s) {
   * \returns The opList Expression
   ******************************************************************************/
 Exp *listExpToExp(std::list<Exp *> *le) {
-    Exp *e;
-    Exp **cur = &e;
-    Exp *end = new Terminal(opNil); // Terminate the chain
-    for (auto &elem : *le) {
-        *cur = Binary::get(opList, elem, end);
-        // cur becomes the address of the address of the second subexpression
-        // In other words, cur becomes a reference to the second subexp ptr
-        // Note that declaring cur as a reference doesn't work (remains a reference to e)
-        cur = &(*cur)->refSubExp2();
-    }
+    // Built from the end, so that no node is changed after it is made
+    Exp *e = new Terminal(opNil); // Terminate the chain
+    for (auto it = le->rbegin(); it != le->rend(); ++it)
+        e = Binary::get(opList, *it, e);
     return e;
 }
 
@@ -239,14 +233,9 @@ Exp *listExpToExp(std::list<Exp *> *le) {
   * \returns The opList expression
   ******************************************************************************/
 Exp *listStrToExp(std::list<QString> *ls) {
-    Exp *e;
-    Exp **cur = &e;
-    Exp *end = new Terminal(opNil); // Terminate the chain
-    for (auto &l : *ls) {
-        *cur = Binary::get(opList, new Location(opParam, Const::get(l), nullptr), end);
-        cur = &(*cur)->refSubExp2();
-    }
-    *cur = new Terminal(opNil); // Terminate the chain
+    Exp *e = new Terminal(opNil); // Terminate the chain
+    for (auto it = ls->rbegin(); it != ls->rend(); ++it)
+        e = Binary::get(opList, new Location(opParam, Const::get(*it), nullptr), e);
     return e;
 }
 
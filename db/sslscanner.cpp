@@ -581,8 +581,6 @@ static const short int yy_chk[1068] = {
     335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335, 335,
     335, 335, 335, 335, 335, 335, 335, 335, 335, 335};
 
-static yy_state_type yy_last_accepting_state;
-static YY_CHAR *yy_last_accepting_cpos;
 
 #if YY_SSLScanner_DEBUG != 0
 static const short int yy_rule_linenum[122] = {
@@ -594,12 +592,8 @@ static const short int yy_rule_linenum[122] = {
     258, 263, 267, 268, 272, 273, 274, 275, 276, 277, 281, 286, 291, 303, 304, 305, 306};
 
 #endif
-static yy_state_type yy_state_buf[YY_BUF_SIZE + 2], *yy_state_ptr;
-static YY_CHAR *yy_full_match;
-static int yy_lp;
-static int yy_looking_for_trail_begin = 0;
-static int yy_full_lp;
-static int *yy_full_state;
+// yy_state_buf and the rest of the matcher's state are members of the scanner (see sslscanner.l)
+static_assert(sizeof(yy_state_type) == sizeof(int) && STATE_BUF_SIZE == YY_BUF_SIZE + 2, "see sslscanner.l");
 #define YY_TRAILING_MASK 0x2000
 #define YY_TRAILING_HEAD_MASK 0x4000
 #define REJECT                                                                                                         \
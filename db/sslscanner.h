@@ -52,12 +52,14 @@
 //#line 29 "sslscanner.l"
 #include "sslparser.h"
 #define MAX_LINE 1024 // the longest SSL spec line
+#define STATE_BUF_SIZE (2 * 8192 + 2) // YY_BUF_SIZE + 2, for the REJECT states
 //#line 43 "sslscanner.l"
 #define YY_SSLScanner_CONSTRUCTOR_PARAM std::istream &ins, bool trace
 //#line 44 "sslscanner.l"
 #define YY_SSLScanner_CONSTRUCTOR_INIT  : theLine(1), traceLines(trace), in(ins)
 //#line 45 "sslscanner.l"
-#define YY_SSLScanner_CONSTRUCTOR_CODE
+#define YY_SSLScanner_CONSTRUCTOR_CODE                                                                                 \
+    { yy_looking_for_trail_begin = 0; }
 //#line 46 "sslscanner.l"
 #define YY_SSLScanner_INPUT_CODE                                                                                       \
     if (in.eof()) {                                                                                                    \
@@ -73,7 +75,18 @@
     int theLine;            /* the current line number */                                                              \
     char lineBuf[MAX_LINE]; /* the current line */                                                                     \
     bool traceLines;        /* echo each lines as it is scanned */                                                     \
-    std::istream &in;
+    std::istream &in;                                                                                                  \
+                                                                                                                       \
+  private:                                                                                                             \
+    /* The matcher's state, which flex keeps in statics: here, each scanner can run on its own thread */               \
+    int yy_last_accepting_state;                                                                                       \
+    char *yy_last_accepting_cpos;                                                                                      \
+    int yy_state_buf[STATE_BUF_SIZE], *yy_state_ptr;                                                                   \
+    char *yy_full_match;                                                                                               \
+    int yy_lp;                                                                                                         \
+    int yy_looking_for_trail_begin;                                                                                    \
+    int yy_full_lp;                                                                                                    \
+    int *yy_full_state;
 //#line 60 "sslscanner.l"
 #define YY_SSLScanner_LEX_PARAM yy_SSLParser_stype &yylval
 //#line 62 "sslscanner.l"
@@ -26,7 +26,9 @@
 #include "visitor.h"
 #include "dataflow.h"
 #include "log.h"
+#include "stats.h"
 #include "hllcode.h"
+#include "exppattern.h"
 
 #include <cassert>
 #include <cstring>
@@ -34,9 +36,50 @@
 #include <cstddef>
 #include <algorithm>
 
-extern char debug_buffer[]; // For prints functions
+extern thread_local char debug_buffer[]; // For prints functions
 extern QTextStream &alignStream(QTextStream &str,int align);
 
+void Instruction::updateTable() { proc->getStatementTable().update(this); }
+
+/***************************************************************************/ /**
+  * \brief Bring the use lists up to date after this statement changed: find the definitions it uses now, and move it
+  * to the users of those it started using and off those it stopped using. Uses in collectors, and the locations in
+  * implicit assignments (x of m[x]), are not uses.
+  ******************************************************************************/
+void Instruction::updateUses() {
+    std::vector<Instruction *> defs;
+    if (!isImplicit()) {
+        LocationSet refs;
+        addUsedLocs(refs, false);
+        for (Exp *r : refs) {
+            if (r->isSubscript() && ((RefExp *)r)->getDef())
+                defs.push_back(((RefExp *)r)->getDef());
+        }
+        std::sort(defs.begin(), defs.end());
+        defs.erase(std::unique(defs.begin(), defs.end()), defs.end());
+    }
+    auto oo = UsedDefs.begin(), nn = defs.begin();
+    while (oo != UsedDefs.end() || nn != defs.end()) {
+        if (nn == defs.end() || (oo != UsedDefs.end() && *oo < *nn)) {
+            std::vector<Instruction *> &u((*oo++)->Users);
+            u.erase(std::find(u.begin(), u.end(), this));
+        } else if (oo == UsedDefs.end() || *nn < *oo)
+            (*nn++)->Users.push_back(this);
+        else {
+            ++oo;
+            ++nn;
+        }
+    }
+    UsedDefs.swap(defs);
+}
+
+//! Take this statement, which is being removed, off the users of the definitions it uses
+void Instruction::dropUses() {
+    for (Instruction *d : UsedDefs)
+        d->Users.erase(std::find(d->Users.begin(), d->Users.end(), this));
+    UsedDefs.clear();
+}
+
 void Instruction::setProc(UserProc *p) {
     proc = p;
     LocationSet exps;
@@ -187,12 +230,10 @@ bool Instruction::isFlagAssgn() {
 }
 
 char *Instruction::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     print(ost);
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 // This version prints much better in gdb
@@ -284,7 +325,9 @@ bool Instruction::propagateTo(bool &convert, std::map<Exp *, int, lessExpStar> *
     int changes = 0;
     // int sp = proc->getSignature()->getStackRegister(proc->getProg());
     // Exp* regSp = Location::regOf(sp);
-    int propMaxDepth = Boomerang::get()->propMaxDepth;
+    const DecompilerContext *ctx = proc ? proc->getContext() : Boomerang::get();
+    int propMaxDepth = ctx->propMaxDepth;
+    bool growthBudget = ctx->propGrowthBudget > 0 && proc != nullptr;
     do {
         LocationSet exps;
         addUsedLocs(exps, true); // True to also add uses from collectors. For example, want to propagate into
@@ -378,16 +421,27 @@ bool Instruction::propagateTo(bool &convert, std::map<Exp *, int, lessExpStar> *
             }
 #endif
 
-            // Check if the -l flag (propMaxDepth) prevents this propagation
+            // Check if the -l flag (propMaxDepth), or the growth budget, prevents this propagation
+            long growth = 0;
             if (destCounts && !lhs->isFlags()) { // Always propagate to %flags
                 std::map<Exp *, int, lessExpStar>::iterator ff = destCounts->find(e);
-                if (ff != destCounts->end() && ff->second > 1 && rhs->getComplexityDepth(proc) >= propMaxDepth) {
-                    if (!def->getRight()->containsFlags()) {
+                if (ff != destCounts->end() && ff->second > 1 && !rhs->containsFlags()) {
+                    if (growthBudget) {
+                        // The cost model: a def used n times is moved into one use and copied into the others, so
+                        // each of the n propagations adds, on average, (n - 1) / n copies of the rhs, less the
+                        // reference each replaces. Cheap, rarely used defs go anywhere; large or widely used ones
+                        // only while the proc's budget lasts
+                        growth = (long)(rhs->getSize() - 1) * (ff->second - 1) / ff->second;
+                    } else if (rhs->getComplexityBound() >= propMaxDepth &&
+                               rhs->getComplexityDepth(proc) >= propMaxDepth) {
+                        // The bound is free, and often settles it without looking up symbols
                         // This propagation is prevented by the -l limit
                         continue;
                     }
                 }
             }
+            if (growth > 0 && !proc->takePropagationGrowth(growth))
+                continue;
             change |= doPropagateTo(e, def, convert);
         }
     } while (change && ++changes < 10);
@@ -889,6 +943,21 @@ BasicBlock *BranchStatement::getFallBB() {
     return Parent->getOutEdge(0);
 }
 
+//! Make out edge \a i of the BB of this branch lead to \a bb, and have the Cfg clean up around both ends of the old
+//! edge and the new one (see Cfg::touchBB())
+void BranchStatement::redirectOutEdge(int i, BasicBlock *bb) {
+    BasicBlock *old = Parent->getOutEdge(i);
+    old->deleteInEdge(Parent);
+    Parent->setOutEdge(i, bb);
+    bb->addInEdge(Parent);
+    Cfg *cfg = proc ? proc->getCFG() : nullptr;
+    if (cfg) {
+        cfg->touchBB(Parent);
+        cfg->touchBB(old);
+        cfg->touchBB(bb);
+    }
+}
+
 // not that if you set the taken BB or fixed dest first, you will not be able to set the fall BB
 void BranchStatement::setFallBB(BasicBlock * bb) {
     ADDRESS a = getFixedDest();
@@ -898,15 +967,7 @@ void BranchStatement::setFallBB(BasicBlock * bb) {
         return;
     if (Parent->getNumOutEdges() != 2)
         return;
-    if (Parent->getOutEdge(0)->getLowAddr() == a) {
-        Parent->getOutEdge(1)->deleteInEdge(Parent);
-        Parent->setOutEdge(1, bb);
-        bb->addInEdge(Parent);
-    } else {
-        Parent->getOutEdge(0)->deleteInEdge(Parent);
-        Parent->setOutEdge(0, bb);
-        bb->addInEdge(Parent);
-    }
+    redirectOutEdge(Parent->getOutEdge(0)->getLowAddr() == a ? 1 : 0, bb);
 }
 
 BasicBlock *BranchStatement::getTakenBB() {
@@ -930,15 +991,7 @@ void BranchStatement::setTakenBB(BasicBlock * bb) {
         return;
     if (Parent->getNumOutEdges() != 2)
         return;
-    if (Parent->getOutEdge(0)->getLowAddr() == a) {
-        Parent->getOutEdge(0)->deleteInEdge(Parent);
-        Parent->setOutEdge(0, bb);
-        bb->addInEdge(Parent);
-    } else {
-        Parent->getOutEdge(1)->deleteInEdge(Parent);
-        Parent->setOutEdge(1, bb);
-        bb->addInEdge(Parent);
-    }
+    redirectOutEdge(Parent->getOutEdge(0)->getLowAddr() == a ? 0 : 1, bb);
 }
 
 bool BranchStatement::search(const Exp &search, Exp *&result) {
@@ -957,11 +1010,11 @@ bool BranchStatement::search(const Exp &search, Exp *&result) {
   * \returns True if any change
   ******************************************************************************/
 bool BranchStatement::searchAndReplace(const Exp &search, Exp *replace, bool cc) {
-    GotoStatement::searchAndReplace(search, replace, cc);
+    bool ch = GotoStatement::searchAndReplace(search, replace, cc);
     bool change = false;
     if (pCond)
         pCond = pCond->searchReplaceAll(search, replace, change);
-    return change;
+    return ch | change;
 }
 
 /***************************************************************************/ /**
@@ -1566,7 +1619,7 @@ void CaseStatement::simplify() {
   * \brief         Constructor for a call
   *
   ******************************************************************************/
-CallStatement::CallStatement() : returnAfterCall(false), calleeReturn(nullptr) {
+CallStatement::CallStatement() : returnAfterCall(false), calleeReturn(nullptr), callGeneration(0) {
     Kind = STMT_CALL;
     procDest = nullptr;
     signature = nullptr;
@@ -1638,6 +1691,7 @@ void CallStatement::setArgumentType(int i, SharedType ty) {
   *
   ******************************************************************************/
 void CallStatement::setArguments(StatementList & args) {
+    callGeneration++;
     arguments.clear();
     arguments.append(args);
     StatementList::iterator ll;
@@ -1662,6 +1716,7 @@ void CallStatement::setSigArguments() {
     // Clone here because each call to procDest could have a different signature, modified by ellipsisProcessing
     signature = procDest->getSignature()->clone();
     procDest->addCaller(this);
+    callGeneration++;
 
     if (!procDest->isLib())
         return; // Using dataflow analysis now
@@ -1724,6 +1779,8 @@ bool CallStatement::searchAndReplace(const Exp &search, Exp *replace, bool cc) {
         for (dd = defCol.begin(); dd != defCol.end(); ++dd)
             change |= (*dd)->searchAndReplace(search, replace, cc);
     }
+    if (change)
+        callGeneration++;
     return change;
 }
 
@@ -1884,6 +1941,7 @@ void CallStatement::setDestProc(Function * dest) {
     assert(dest);
     // assert(procDest == nullptr);        // No: not convenient for unit testing
     procDest = dest;
+    callGeneration++;
 }
 
 void CallStatement::generateCode(HLLCode * hll, BasicBlock * pbb, int indLevel) {
@@ -2100,6 +2158,7 @@ void CallStatement::setArgumentExp(int i, Exp *e) {
 int CallStatement::getNumArguments() { return arguments.size(); }
 
 void CallStatement::setNumArguments(int n) {
+    callGeneration++;
     int oldSize = arguments.size();
     if (oldSize > n) {
         StatementList::iterator aa = arguments.begin();
@@ -2125,6 +2184,7 @@ void CallStatement::removeArgument(int i) {
     StatementList::iterator aa = arguments.begin();
     std::advance(aa, i);
     arguments.erase(aa);
+    callGeneration++;
 }
 
 // Processes each argument of a CallStatement, and the RHS of an Assign. Ad-hoc type analysis only.
@@ -2286,78 +2346,17 @@ bool CallStatement::objcSpecificProcessing(const QString &formatStr) {
     return false;
 }
 
-// This function has two jobs. One is to truncate the list of arguments based on the format string.
-// The second is to add parameter types to the signature.
-// If -Td is used, type analysis will be rerun with these changes.
-bool CallStatement::ellipsisProcessing(Prog * prog) {
-    Q_UNUSED(prog);
-    // if (getDestProc() == nullptr || !getDestProc()->getSignature()->hasEllipsis())
-    if (getDestProc() == nullptr || !signature->hasEllipsis())
-        return objcSpecificProcessing(nullptr);
-    // functions like printf almost always have too many args
-    QString name(getDestProc()->getName());
-    int format = -1;
-    if ((name == "printf" || name == "scanf"))
-        format = 0;
-    else if (name == "sprintf" || name == "fprintf" || name == "sscanf")
-        format = 1;
-    else if (getNumArguments() && getArgumentExp(getNumArguments() - 1)->isStrConst())
-        format = getNumArguments() - 1;
-    else
-        return false;
-    if (VERBOSE)
-        LOG << "ellipsis processing for " << name << "\n";
-    QString formatStr=QString::null;
-    Exp *formatExp = getArgumentExp(format);
-    // We sometimes see a[m[blah{...}]]
-    if (formatExp->isAddrOf()) {
-        formatExp = ((Unary *)formatExp)->getSubExp1();
-        if (formatExp->isSubscript())
-            formatExp = ((RefExp *)formatExp)->getSubExp1();
-        if (formatExp->isMemOf())
-            formatExp = ((Unary *)formatExp)->getSubExp1();
-    }
-    if (formatExp->isSubscript()) {
-        // Maybe it's defined to be a Const string
-        Instruction *def = ((RefExp *)formatExp)->getDef();
-        if (def == nullptr)
-            return false; // Not all nullptr refs get converted to implicits
-        if (def->isAssign()) {
-            // This would be unusual; propagation would normally take care of this
-            Exp *rhs = ((Assign *)def)->getRight();
-            if (rhs == nullptr || !rhs->isStrConst())
-                return false;
-            formatStr = ((Const *)rhs)->getStr();
-        } else if (def->isPhi()) {
-            // More likely. Example: switch_gcc. Only need ONE candidate format string
-            PhiAssign *pa = (PhiAssign *)def;
-            for (auto &v : *pa) {
-                def = v.second.def();
-                if ((def == nullptr) or (!def->isAssign()))
-                    continue;
-                Exp *rhs = ((Assign *)def)->getRight();
-                if (rhs == nullptr || !rhs->isStrConst())
-                    continue;
-                formatStr = ((Const *)rhs)->getStr();
-                break;
-            }
-            if (formatStr.isNull())
-                return false;
-        } else
-            return false;
-    } else if (formatExp->isStrConst()) {
-        formatStr = ((Const *)formatExp)->getStr();
-    } else
-        return false;
-    if (objcSpecificProcessing(formatStr))
-        return true;
-
-    // actually have to parse it
+/***************************************************************************/ /**
+  * \brief   The arguments the printf or scanf style \a formatStr calls for (scanf ones are pointers). \a call is only
+  * named in the log
+  ******************************************************************************/
+static FormatArguments parseFormatString(const QString &formatStr, bool isScanf, CallStatement *call) {
+    FormatArguments args;
     // Format string is: % [flags] [width] [.precision] [size] type
-    int n = 1; // Count the format string itself (may also be "format" more arguments)
+    int &n(args.count); // Count the format string itself (may also be "format" more arguments)
+    // scanf is passed pointers to what it reads
+    auto addParam = [&args, isScanf](SharedType ty) { args.types.push_back(isScanf ? PointerType::get(ty) : ty); };
     char ch;
-    // Set a flag if the name of the function is scanf/sscanf/fscanf
-    bool isScanf = name.contains("scanf");
     int p_idx = 0;
     //TODO: use qregularexpression to match scanf arguments
     while ((p_idx = formatStr.indexOf('%',p_idx))!=-1) {
@@ -2369,8 +2368,8 @@ bool CallStatement::ellipsisProcessing(Prog * prog) {
             case '*':
                 // Example: printf("Val: %*.*f\n", width, precision, val);
                 n++; // There is an extra parameter for the width or precision
-                // This extra parameter is of type integer, never int* (so pass false as last argument)
-                addSigParam(IntegerType::get(STD_SIZE), false);
+                // This extra parameter is of type integer, never int*
+                args.types.push_back(IntegerType::get(STD_SIZE));
                 continue;
             case '-':
             case '+':
@@ -2410,13 +2409,13 @@ bool CallStatement::ellipsisProcessing(Prog * prog) {
         switch (ch) {
         case 'd':
         case 'i': // Signed integer
-            addSigParam(IntegerType::get(veryLong ? 64 : 32), isScanf);
+            addParam(IntegerType::get(veryLong ? 64 : 32));
             break;
         case 'u':
         case 'x':
         case 'X':
         case 'o': // Unsigned integer
-            addSigParam(IntegerType::get(32, -1), isScanf);
+            addParam(IntegerType::get(32, -1));
             break;
         case 'f':
         case 'g':
@@ -2425,22 +2424,105 @@ bool CallStatement::ellipsisProcessing(Prog * prog) {
         case 'E': // Various floating point formats
             // Note that for scanf, %f means float, and %lf means double, whereas for printf, both of these mean
             // double
-            addSigParam(FloatType::get(veryLong ? 128 : (isScanf ? 32 : 64)), isScanf); // Note: may not be 64 bits
+            addParam(FloatType::get(veryLong ? 128 : (isScanf ? 32 : 64))); // Note: may not be 64 bits
             // for some archs
             break;
         case 's': // String
-            addSigParam(PointerType::get(ArrayType::get(CharType::get())), isScanf);
+            addParam(PointerType::get(ArrayType::get(CharType::get())));
             break;
         case 'c': // Char
-            addSigParam(CharType::get(), isScanf);
+            addParam(CharType::get());
             break;
         case '%':
             break; // Ignore %% (emits 1 percent char)
         default:
-            LOG << "Unhandled format character " << ch << " in format string for call " << this << "\n";
+            LOG << "Unhandled format character " << ch << " in format string for call " << call << "\n";
         }
     }
-    setNumArguments(format + n);
+    return args;
+}
+
+// This function has two jobs. One is to truncate the list of arguments based on the format string.
+// The second is to add parameter types to the signature.
+// If -Td is used, type analysis will be rerun with these changes.
+bool CallStatement::ellipsisProcessing(Prog * prog) {
+    // if (getDestProc() == nullptr || !getDestProc()->getSignature()->hasEllipsis())
+    if (getDestProc() == nullptr || !signature->hasEllipsis())
+        return objcSpecificProcessing(nullptr);
+    // functions like printf almost always have too many args
+    QString name(getDestProc()->getName());
+    int format = -1;
+    if ((name == "printf" || name == "scanf"))
+        format = 0;
+    else if (name == "sprintf" || name == "fprintf" || name == "sscanf")
+        format = 1;
+    else if (getNumArguments() && getArgumentExp(getNumArguments() - 1)->isStrConst())
+        format = getNumArguments() - 1;
+    else
+        return false;
+    if (VERBOSE)
+        LOG << "ellipsis processing for " << name << "\n";
+    QString formatStr=QString::null;
+    Exp *formatExp = getArgumentExp(format);
+    // We sometimes see a[m[blah{...}]]
+    if (formatExp->isAddrOf()) {
+        formatExp = ((Unary *)formatExp)->getSubExp1();
+        if (formatExp->isSubscript())
+            formatExp = ((RefExp *)formatExp)->getSubExp1();
+        if (formatExp->isMemOf())
+            formatExp = ((Unary *)formatExp)->getSubExp1();
+    }
+    if (formatExp->isSubscript()) {
+        // Maybe it's defined to be a Const string
+        Instruction *def = ((RefExp *)formatExp)->getDef();
+        if (def == nullptr)
+            return false; // Not all nullptr refs get converted to implicits
+        if (def->isAssign()) {
+            // This would be unusual; propagation would normally take care of this
+            Exp *rhs = ((Assign *)def)->getRight();
+            if (rhs == nullptr || !rhs->isStrConst())
+                return false;
+            formatStr = ((Const *)rhs)->getStr();
+        } else if (def->isPhi()) {
+            // More likely. Example: switch_gcc. Only need ONE candidate format string
+            PhiAssign *pa = (PhiAssign *)def;
+            for (auto &v : *pa) {
+                def = v.second.def();
+                if ((def == nullptr) or (!def->isAssign()))
+                    continue;
+                Exp *rhs = ((Assign *)def)->getRight();
+                if (rhs == nullptr || !rhs->isStrConst())
+                    continue;
+                formatStr = ((Const *)rhs)->getStr();
+                break;
+            }
+            if (formatStr.isNull())
+                return false;
+        } else
+            return false;
+    } else if (formatExp->isStrConst()) {
+        formatStr = ((Const *)formatExp)->getStr();
+    } else
+        return false;
+    if (objcSpecificProcessing(formatStr))
+        return true;
+
+    // The same format strings come up at many calls, and again in every pass: parse each once per program
+    bool isScanf = name.contains("scanf");
+    FormatArguments parsed;
+    const FormatArguments *formatArgs = &parsed;
+    if (prog) {
+        std::map<std::pair<QString, bool>, FormatArguments> &cache(prog->getFormatArguments());
+        auto key = std::make_pair(formatStr, isScanf);
+        auto it = cache.find(key);
+        if (it == cache.end())
+            it = cache.insert(std::make_pair(key, parseFormatString(formatStr, isScanf, this))).first;
+        formatArgs = &it->second;
+    } else
+        parsed = parseFormatString(formatStr, isScanf, this);
+    for (const SharedType &ty : formatArgs->types)
+        addSigParam(ty->clone(), false);
+    setNumArguments(format + formatArgs->count);
     signature->killEllipsis(); // So we don't do this again
     return true;
 }
@@ -3166,6 +3248,22 @@ bool Assign::usesExp(const Exp &e) {
             ((lhs->isMemOf() || lhs->isRegOf()) && ((Unary *)lhs)->getSubExp1()->search(e, where)));
 }
 
+/***************************************************************************/ /**
+  * \brief   Match this assignment to a "lhs := rhs" pattern, which is compiled on first use
+  * \param   pattern to match
+  * \param   bindings gets the subexpression bound to each variable of the pattern
+  * \returns true if both sides match
+  ******************************************************************************/
+bool Assign::match(const char *pattern, std::map<QString, Exp *> &bindings) {
+    const CompiledPattern &compiled(CompiledPattern::get(pattern));
+    CompiledPattern::Bindings b;
+    if (!compiled.matchAssign(this, b))
+        return false;
+    for (int i = 0; i < compiled.numVars(); i++)
+        bindings[compiled.varName(i)] = b[i];
+    return true;
+}
+
 #if 0
 bool Assign::match(const QString &pattern, std::map<QString, Exp*> &bindings) {
 if (strstr(pattern, ":=") == nullptr)
@@ -3391,9 +3489,9 @@ void BranchStatement::genConstraints(LocationSet & cons) {
     con = Binary::get(opEquals, Tb, new TypeVal(opsType));
     cons.insert(con);
 }
-//! Set or clear the constant subscripts (using a visitor)
-int Instruction::setConscripts(int n) {
-    StmtConscriptSetter scs(n, false);
+//! Set or clear the constant subscripts (using a visitor); the constants numbered are appended to \a numbered if given
+int Instruction::setConscripts(int n, std::vector<Const *> *numbered) {
+    StmtConscriptSetter scs(n, false, numbered);
     accept(&scs);
     return scs.getLast();
 }
@@ -3631,6 +3729,7 @@ bool CaseStatement::accept(StmtModifier * v) {
 
 bool CallStatement::accept(StmtModifier * v) {
     bool recur;
+    callGeneration++; // Modifiers don't reliably say whether they changed anything
     v->visit(this, recur);
     if (!recur)
         return true;
@@ -3658,6 +3757,8 @@ bool CallStatement::accept(StmtModifier * v) {
 
 bool ReturnStatement::accept(StmtModifier * v) {
     bool recur;
+    if (proc) // The modifieds may change, and modifiers don't reliably say whether they did
+        proc->summaryChanged();
     v->visit(this, recur);
     if (!recur)
         return true;
@@ -3746,6 +3847,7 @@ bool CaseStatement::accept(StmtPartModifier * v) {
 
 bool CallStatement::accept(StmtPartModifier * v) {
     bool recur;
+    callGeneration++; // Modifiers don't reliably say whether they changed anything
     v->visit(this, recur);
     if (pDest && recur)
         pDest = pDest->accept(v->mod);
@@ -3773,6 +3875,8 @@ bool CallStatement::accept(StmtPartModifier * v) {
 
 bool ReturnStatement::accept(StmtPartModifier * v) {
     bool recur;
+    if (proc) // The modifieds may change, and modifiers don't reliably say whether they did
+        proc->summaryChanged();
     v->visit(this, recur);
     ReturnStatement::iterator rr;
     for (rr = modifieds.begin(); rr != modifieds.end(); ++rr)
@@ -3825,6 +3929,16 @@ bool Instruction::addUsedLocals(LocationSet & used) {
     return ulf.wasAllFound();
 }
 
+//! Replace each of the searches in \a replacements with its replacement, in one walk of this Statement
+//! \returns true if any change
+//! \param cc - change collectors as well
+bool Instruction::searchAndReplaceAll(const ExpReplaceMap & replacements, bool cc /* = false */) {
+    ExpReplacer er(replacements);
+    StmtReplacer sr(&er, cc);
+    accept(&sr);
+    return er.isChanged();
+}
+
 //! For all expressions in this Statement, replace any e with e{def}
 void Instruction::subscriptVar(Exp * e, Instruction * def /*, Cfg* cfg */) {
     ExpSubscripter es(e, def /*, cfg*/);
@@ -3856,6 +3970,8 @@ void PhiAssign::convertToAssign(Exp * rhs) {
     SharedType type_ = type;
     this->~PhiAssign();                               // Explicitly destroy this, but keep the memory allocated.
     Assign *a = new (this) Assign(type_, lhs_, rhs_); // construct in-place. Note that 'a' == 'this'
+    // Deleting it will give back the bytes of an Assign
+    MemStats::changed(MemStats::mkPhiAssign, sizeof(PhiAssign), MemStats::mkAssign, sizeof(Assign));
     a->setNumber(n);
     a->setProc(p);
     a->setBB(bb);
@@ -3907,8 +4023,9 @@ void PhiAssign::simplify() {
 void PhiAssign::putAt(BasicBlock * i, Instruction * def, Exp * e) {
     assert(e); // should be something surely
     // assert(defVec.end()==defVec.find(i));
-    DefVec[i].def(def);
-    DefVec[i].e = e;
+    PhiInfo &pi(DefVec[i]);
+    pi.def(def);
+    pi.e = e;
 }
 
 bool Assignment::definesLoc(Exp * loc) {
@@ -4060,6 +4177,7 @@ void ReturnStatement::updateModifieds() {
     Signature *sig = proc->getSignature();
     StatementList oldMods(modifieds); // Copy the old modifieds
     modifieds.clear();
+    proc->summaryChanged();
 
     if (Parent->getNumInEdges() == 1 && Parent->getInEdges()[0]->getLastStmt()->isCall()) {
         CallStatement *call = (CallStatement *)Parent->getInEdges()[0]->getLastStmt();
@@ -4191,6 +4309,45 @@ void ReturnStatement::updateReturns() {
     }
 }
 
+/***************************************************************************/ /**
+  * \brief   Bring \a list, the arguments or the defines of a call, up to date in place: drop the assignments whose
+  * left hand side \a keep rejects, and insert the \a added ones it accepts in the order of \a less. Once the callee
+  * has settled there is nothing to add or drop, and the list is left as it is rather than rebuilt.
+  ******************************************************************************/
+template <class Keep, class Less>
+static void updateAssignments(StatementList &list, const std::vector<Assignment *> &added, Keep keep, Less less) {
+    for (StatementList::iterator it = list.begin(); it != list.end();) {
+        if (keep(((Assignment *)*it)->getLeft()))
+            ++it;
+        else
+            it = list.erase(it);
+    }
+    auto lessStmt = [&less](Instruction *a, Instruction *b) { return less(*(Assignment *)a, *(Assignment *)b); };
+    if (!std::is_sorted(list.begin(), list.end(), lessStmt))
+        list.sort(lessStmt);
+    for (Assignment *as : added) {
+        if (!keep(as->getLeft())) {
+            delete as;
+            continue;
+        }
+        // Insert as, in order, into the existing set of definitions (after any it compares equal to)
+        list.insert(std::upper_bound(list.begin(), list.end(), as, lessStmt), as);
+    }
+}
+
+// What the arguments or defines of this call would be brought up to date from now; the def collector matters only
+// to the arguments
+CallStatement::UpdateStamp CallStatement::currentStamp(bool withCollector) const {
+    UpdateStamp stamp;
+    stamp.callee = procDest;
+    stamp.calleeReturn = calleeReturn;
+    stamp.calleeGeneration = procDest ? procDest->getSummaryGeneration() : 0;
+    stamp.procGeneration = proc->getSummaryGeneration();
+    stamp.collectorGeneration = withCollector ? defCol.getGeneration() : 0;
+    stamp.callGeneration = callGeneration;
+    return stamp;
+}
+
 // Set the defines to the set of locations modified by the callee, or if no callee, to all variables live at this
 // call
 void CallStatement::updateDefines() {
@@ -4211,11 +4368,13 @@ void CallStatement::updateDefines() {
         return;
     }
 
-    // Move the defines to a temporary list
-    StatementList oldDefines(defines); // Copy the old defines
-    StatementList::iterator it;
-    defines.clear();
+    // The defines taken from an analysed callee can only change with its summary
+    UpdateStamp stamp = currentStamp(false);
+    if (procDest && calleeReturn && stamp == definesStamp)
+        return;
 
+    // Only the locations the callee or collector has and the list lacks are made; the list is then updated in place
+    std::vector<Assignment *> added;
     if (procDest && calleeReturn) {
         StatementList::iterator mm;
         StatementList &modifieds = ((UserProc *)procDest)->getModifieds();
@@ -4225,53 +4384,34 @@ void CallStatement::updateDefines() {
             if (proc->filterReturns(loc))
                 continue;
             SharedType ty = as->getType();
-            if (!oldDefines.existsOnLeft(loc))
-                oldDefines.append(new ImplicitAssign(ty, loc));
+            if (!defines.existsOnLeft(loc))
+                added.push_back(new ImplicitAssign(ty, loc));
         }
     } else {
-        // Ensure that everything in the UseCollector has an entry in oldDefines
+        // Ensure that everything in the UseCollector has an entry in the defines
         LocationSet::iterator ll;
         for (ll = useCol.begin(); ll != useCol.end(); ++ll) {
             Exp *loc = *ll;
             if (proc->filterReturns(loc))
                 continue; // Filtered out
-            if (!oldDefines.existsOnLeft(loc)) {
+            if (!defines.existsOnLeft(loc)) {
                 ImplicitAssign *as = new ImplicitAssign(loc->clone());
                 as->setProc(proc);
                 as->setBB(Parent);
-                oldDefines.append(as);
+                added.push_back(as);
             }
         }
     }
 
-    for (it = oldDefines.end(); it != oldDefines.begin();) {
-        --it; // Becuase we are using a forwards iterator backwards
-        // Make sure the LHS is still in the return or collector
-        Assign *as = (Assign *)*it;
-        Exp *lhs = as->getLeft();
-        if (calleeReturn) {
-            if (!calleeReturn->definesLoc(lhs))
-                continue; // Not in callee returns
-        } else {
-            if (!useCol.exists(lhs))
-                continue; // Not in collector: delete it (don't copy it)
-        }
-        if (proc->filterReturns(lhs))
-            continue; // Filtered out: delete it
-
-        // Insert as, in order, into the existing set of definitions
-        StatementList::iterator nn;
-        bool inserted = false;
-        for (nn = defines.begin(); nn != defines.end(); ++nn) {
-            if (sig->returnCompare(*as, *(Assign *)*nn)) { // If the new assignment is less than the current one
-                nn = defines.insert(nn, as);               // then insert before this position
-                inserted = true;
-                break;
-            }
-        }
-        if (!inserted)
-            defines.push_back(as); // In case larger than all existing elements
-    }
+    updateAssignments(defines, added,
+                      [this](Exp *lhs) {
+                          // Make sure the LHS is still in the return or collector
+                          if (calleeReturn ? !calleeReturn->definesLoc(lhs) : !useCol.exists(lhs))
+                              return false;
+                          return !proc->filterReturns(lhs);
+                      },
+                      [sig](Assignment &a, Assignment &b) { return sig->returnCompare(a, b); });
+    definesStamp = (procDest && calleeReturn) ? stamp : UpdateStamp();
 }
 
 // A helper class for updateArguments. It just dishes out a new argument from one of the three sources: the
@@ -4419,16 +4559,14 @@ void CallStatement::updateArguments() {
                 else
                   if a forced callee signature, source = signature
                   else source is def collector in this call.
-                oldArguments = arguments
-                clear arguments
                 for each arg lhs in source
-                        if exists in oldArguments, leave alone
-                        else if not filtered append assignment lhs=lhs to oldarguments
-                for each argument as in oldArguments in reverse order
+                        if exists in arguments, leave alone
+                        else if not filtered make assignment lhs=lhs, to be added
+                for each argument as in arguments
                         lhs = as->getLeft
-                        if (lhs does not exist in source) continue
-                        if filterParams(lhs) continue
-                        insert as into arguments, considering sig->argumentCompare
+                        if (lhs does not exist in source) remove it
+                        if filterParams(lhs) remove it
+                insert each assignment to be added into arguments, considering sig->argumentCompare
         */
     // Note that if propagations are limited, arguments and collected reaching definitions can be in terms of phi
     // statements that have since been translated to assignments. So propagate through them now
@@ -4442,8 +4580,6 @@ void CallStatement::updateArguments() {
         bool convert;
         proc->propagateStatements(convert, 88);
     }
-    StatementList oldArguments(arguments);
-    arguments.clear();
     if (EXPERIMENTAL) {
         // I don't really know why this is needed, but I was seeing r28 := ((((((r28{-}-4)-4)-4)-8)-4)-4)-4:
         DefCollector::iterator dd;
@@ -4451,16 +4587,24 @@ void CallStatement::updateArguments() {
             (*dd)->simplify();
     }
 
+    // Arguments taken from an analysed callee's parameters can only change with its summary, or with the definitions
+    // collected here that localise them
+    bool fromCallee = procDest && !procDest->isLib() && calleeReturn;
+    UpdateStamp stamp = currentStamp(true);
+    if (fromCallee && stamp == argumentsStamp)
+        return;
+
     Signature *sig = proc->getSignature();
     // Ensure everything in the callee's signature (if this is a library call), or the callee parameters (if
     // available),
-    // or the def collector if not,  exists in oldArguments
+    // or the def collector if not,  exists in the arguments
     ArgSourceProvider asp(this);
+    std::vector<Assignment *> added;
     Exp *loc;
     while ((loc = asp.nextArgLoc()) != nullptr) {
         if (proc->filterParams(loc))
             continue;
-        if (!oldArguments.existsOnLeft(loc)) {
+        if (!arguments.existsOnLeft(loc)) {
             // Check if the location is renamable. If not, localising won't work, since it relies on definitions
             // collected in the call, and you just get m[...]{-} even if there are definitions.
             Exp *rhs;
@@ -4474,34 +4618,17 @@ void CallStatement::updateArguments() {
             // as->setParent(this);
             as->setProc(proc);
             as->setBB(Parent);
-            oldArguments.append(as);
+            added.push_back(as);
         }
     }
 
-    StatementList::iterator it;
-    for (it = oldArguments.end(); it != oldArguments.begin();) {
-        --it; // Becuase we are using a forwards iterator backwards
-        // Make sure the LHS is still in the callee signature / callee parameters / use collector
-        Assign *as = (Assign *)*it;
-        Exp *lhs = as->getLeft();
-        if (!asp.exists(lhs))
-            continue;
-        if (proc->filterParams(lhs))
-            continue; // Filtered out: delete it
-
-        // Insert as, in order, into the existing set of definitions
-        StatementList::iterator nn;
-        bool inserted = false;
-        for (nn = arguments.begin(); nn != arguments.end(); ++nn) {
-            if (sig->argumentCompare(*as, *(Assign *)*nn)) { // If the new assignment is less than the current one
-                nn = arguments.insert(nn, as);               // then insert before this position
-                inserted = true;
-                break;
-            }
-        }
-        if (!inserted)
-            arguments.insert(arguments.end(), as); // In case larger than all existing elements
-    }
+    updateAssignments(arguments, added,
+                      [this, &asp](Exp *lhs) {
+                          // Make sure the LHS is still in the callee signature / callee parameters / use collector
+                          return asp.exists(lhs) && !proc->filterParams(lhs);
+                      },
+                      [sig](Assignment &a, Assignment &b) { return sig->argumentCompare(a, b); });
+    argumentsStamp = fromCallee ? stamp : UpdateStamp();
 }
 
 // Calculate results(this) = defines(this) intersect live(this)
@@ -4587,6 +4714,7 @@ void CallStatement::removeDefine(Exp * e) {
         Assign *as = ((Assign *)*ss);
         if (*as->getLeft() == *e) {
             defines.erase(ss);
+            callGeneration++;
             return;
         }
     }
@@ -4604,7 +4732,29 @@ bool CallStatement::isChildless() const {
     return calleeReturn == nullptr;
 }
 
+// Many statements use the same location defined by a call, so the result for each is remembered until the call or its
+// callee changes (see bypasses)
 Exp *CallStatement::bypassRef(RefExp * r, bool &ch) {
+    if (proc == nullptr)
+        return findBypass(r, ch);
+    UpdateStamp stamp = currentStamp(true);
+    if (!(stamp == bypassStamp)) {
+        bypasses.clear();
+        bypassStamp = stamp;
+    }
+    auto it = bypasses.find(r->getSubExp1());
+    if (it != bypasses.end()) {
+        DecompileStats::get().count(proc, "bypass", "cached refs");
+        ch = it->second.second;
+        return it->second.first ? it->second.first->clone() : r;
+    }
+    Exp *ret = findBypass(r, ch);
+    bypasses[r->getSubExp1()->clone()] = std::make_pair(ret == r ? nullptr : ret->clone(), ch);
+    return ret;
+}
+
+//! The work of bypassRef
+Exp *CallStatement::findBypass(RefExp * r, bool &ch) {
     Exp *base = r->getSubExp1();
     Exp *proven;
     ch = false;
@@ -4649,9 +4799,14 @@ Exp *CallStatement::bypassRef(RefExp * r, bool &ch) {
 void ReturnStatement::removeModified(Exp * loc) {
     modifieds.removeDefOf(loc);
     returns.removeDefOf(loc);
+    if (proc)
+        proc->summaryChanged();
 }
 
-void CallStatement::addDefine(ImplicitAssign * as) { defines.append(as); }
+void CallStatement::addDefine(ImplicitAssign * as) {
+    defines.append(as);
+    callGeneration++;
+}
 
 TypingStatement::TypingStatement(SharedType ty) : type(ty) {}
 
@@ -4667,7 +4822,7 @@ void ImpRefStatement::print(QTextStream & os, bool html) const {
         os << "</a></td>";
 }
 
-void ImpRefStatement::meetWith(SharedType ty, bool &ch) { type = type->meetWith(ty, ch); }
+void ImpRefStatement::meetWith(const SharedType &ty, bool &ch) { type = type->meetWith(ty, ch); }
 
 Instruction * ImpRefStatement::clone() const { return new ImpRefStatement(type->clone(), addressExp->clone()); }
 bool ImpRefStatement::accept(StmtVisitor * visitor) { return visitor->visit(this); }
@@ -4722,6 +4877,7 @@ void CallStatement::eliminateDuplicateArgs() {
         if (ls.exists(lhs)) {
             // This is a duplicate
             it = arguments.erase(it);
+            callGeneration++;
             continue;
         }
         ls.insert(lhs);
@@ -0,0 +1,240 @@
+/***************************************************************************/ /**
+  * \file       stats.cpp
+  * \brief   Implementation of the DecompileStats, SimplifyStats and StatScope classes
+  ******************************************************************************/
+#include "stats.h"
+
+#include "arena.h"
+#include "proc.h"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include <algorithm>
+#include <vector>
+
+DecompileStats &DecompileStats::get() {
+    static DecompileStats stats;
+    return stats;
+}
+
+void DecompileStats::setEnabled(bool b) {
+    enabled = b;
+    SimplifyStats::enabled = b;
+}
+
+DecompileStats::Entry &DecompileStats::getEntry(const Function *proc, const QString &stage) {
+    return entries[proc ? proc->getName() : QString()][stage];
+}
+
+//! Add \a n to the counter named \a counter of the given stage
+void DecompileStats::count(const Function *proc, const QString &stage, const QString &counter, size_t n) {
+    if (enabled)
+        getEntry(proc, stage).counters[counter] += n;
+}
+
+/***************************************************************************/ /**
+  * \brief   Write the statistics to \a path as JSON: an object with the preset the program was decompiled with
+  * ("preset": "full" or "draft"), the totals of each stage over all procedures ("stages"), the program wide stages
+  * ("program"), the stages of each procedure ("procedures"), and the hits of the simplifier's rules with the rounds of
+  * its fixed point ("simplify", see SimplifyStats)
+  * \returns false if the file could not be written
+  ******************************************************************************/
+bool DecompileStats::writeJSON(const QString &path) const {
+    auto toJson = [](const Entry &e) {
+        QJsonObject o;
+        o["calls"] = (double)e.calls;
+        o["seconds"] = e.seconds;
+        o["allocations"] = (double)e.allocations;
+        o["allocatedBytes"] = (double)e.allocatedBytes;
+        if (!e.peakByKind.empty()) {
+            o["peakBytes"] = (double)e.peakBytes;
+            QJsonObject k;
+            for (const auto &kind : e.peakByKind)
+                k[kind.first] = (double)kind.second;
+            o["peakByKind"] = k;
+        }
+        if (!e.counters.empty()) {
+            QJsonObject c;
+            for (const auto &ctr : e.counters)
+                c[ctr.first] = (double)ctr.second;
+            o["counters"] = c;
+        }
+        return o;
+    };
+    std::map<QString, Entry> totals;
+    QJsonObject program, procedures;
+    for (const auto &proc : entries) {
+        QJsonObject stages;
+        for (const auto &st : proc.second) {
+            stages[st.first] = toJson(st.second);
+            Entry &t(totals[st.first]);
+            t.calls += st.second.calls;
+            t.seconds += st.second.seconds;
+            t.allocations += st.second.allocations;
+            t.allocatedBytes += st.second.allocatedBytes;
+            t.peakBytes = std::max(t.peakBytes, st.second.peakBytes);
+            for (const auto &kind : st.second.peakByKind)
+                t.peakByKind[kind.first] = std::max(t.peakByKind[kind.first], kind.second);
+            for (const auto &ctr : st.second.counters)
+                t.counters[ctr.first] += ctr.second;
+        }
+        if (proc.first.isEmpty())
+            program = stages;
+        else
+            procedures[proc.first] = stages;
+    }
+    QJsonObject all;
+    for (const auto &st : totals)
+        all[st.first] = toJson(st.second);
+    QJsonObject root;
+    root["preset"] = preset;
+    root["stages"] = all;
+    root["program"] = program;
+    root["procedures"] = procedures;
+    const SimplifyStats &simp(SimplifyStats::get());
+    if (!simp.getRounds().empty()) {
+        QJsonObject rules, rounds, simplify;
+        for (const auto &r : simp.getRuleHits())
+            rules[r.first] = (double)r.second;
+        for (size_t n = 0; n < simp.getRounds().size(); n++) {
+            if (simp.getRounds()[n])
+                rounds[QString::number(n)] = (double)simp.getRounds()[n];
+        }
+        simplify["rules"] = rules;
+        simplify["rounds"] = rounds;
+        root["simplify"] = simplify;
+    }
+
+    QFile f(path);
+    if (!f.open(QFile::WriteOnly | QFile::Truncate))
+        return false;
+    f.write(QJsonDocument(root).toJson());
+    return true;
+}
+
+bool SimplifyStats::enabled = false;
+
+SimplifyStats &SimplifyStats::get() {
+    static SimplifyStats stats;
+    return stats;
+}
+
+//! Count a call of Exp::simplify that took \a n rounds of polySimplify, the last of which changed nothing
+void SimplifyStats::countRounds(size_t n) {
+    if (n >= rounds.size())
+        rounds.resize(n + 1, 0);
+    rounds[n]++;
+}
+
+//! The hits of each rule by its name; the same name used at several places is counted once, over all of them
+std::map<QString, size_t> SimplifyStats::getRuleHits() const {
+    std::map<QString, size_t> hits;
+    for (const auto &r : rules)
+        hits[QString(r.first)] += r.second;
+    return hits;
+}
+
+void SimplifyStats::clear() {
+    rules.clear();
+    rounds.clear();
+}
+
+/***************************************************************************/ /**
+  * \brief   Write to \a path, as text, the \a top procedures with the largest peak footprint in any of their stages,
+  * largest first, with the stage it was reached in and the kinds of object that took most of it
+  * \returns false if the file could not be written
+  ******************************************************************************/
+bool DecompileStats::writeMemoryReport(const QString &path, size_t top) const {
+    struct Peak {
+        QString proc;
+        QString stage;
+        const Entry *entry;
+    };
+    std::vector<Peak> peaks;
+    for (const auto &proc : entries) {
+        if (proc.first.isEmpty() || proc.second.empty())
+            continue;
+        auto best = std::max_element(proc.second.begin(), proc.second.end(),
+                                     [](const std::pair<const QString, Entry> &a,
+                                        const std::pair<const QString, Entry> &b) {
+                                         return a.second.peakBytes < b.second.peakBytes;
+                                     });
+        peaks.push_back(Peak{proc.first, best->first, &best->second});
+    }
+    std::sort(peaks.begin(), peaks.end(),
+              [](const Peak &a, const Peak &b) { return a.entry->peakBytes > b.entry->peakBytes; });
+    if (peaks.size() > top)
+        peaks.resize(top);
+
+    QFile f(path);
+    if (!f.open(QFile::WriteOnly | QFile::Truncate | QFile::Text))
+        return false;
+    QTextStream out(&f);
+    out << "Largest peak footprints of the IR, in bytes above what was live when the stage started (callees decompiled\n"
+           "during the stage included), for the " << peaks.size() << " procedures with the largest\n\n";
+    for (const Peak &p : peaks) {
+        out << QString::number(p.entry->peakBytes).rightJustified(12) << "  " << p.proc << " (" << p.stage << "):";
+        std::vector<std::pair<size_t, QString>> kinds;
+        for (const auto &kind : p.entry->peakByKind)
+            kinds.push_back(std::make_pair(kind.second, kind.first));
+        std::sort(kinds.rbegin(), kinds.rend());
+        for (size_t i = 0; i < kinds.size() && i < 5; i++)
+            out << " " << kinds[i].second << " " << kinds[i].first;
+        out << "\n";
+    }
+    // The blocks behind the IR, for judging how many pages (and TLB entries) walking it touches
+    const Arena::Totals &arenas(Arena::getTotals());
+    out << "\nArenas (-ia): " << arenas.arenas << " holding " << arenas.blocks << " blocks, " << arenas.hugeBlocks
+        << " of them for huge pages (-ih); " << arenas.reserved << " bytes reserved, at most " << arenas.peakReserved
+        << "\n";
+    out.flush();
+    return f.error() == QFile::NoError;
+}
+
+StatScope::StatScope(const Function *proc, const char *stage, int index) {
+    DecompileStats &stats(DecompileStats::get());
+    if (!stats.isEnabled() && !stats.isMemoryEnabled())
+        return;
+    QString name(stage);
+    if (index >= 0)
+        name += QString(" %1").arg(index);
+    entry = &stats.getEntry(proc, name);
+    startAllocations = ArenaAllocated::getNumAllocations();
+    startBytes = ArenaAllocated::getAllocatedBytes();
+    memory = stats.isMemoryEnabled();
+    if (memory) {
+        startLive = MemStats::totalLive;
+        savedPeak = MemStats::totalPeak;
+        MemStats::totalPeak = startLive;
+        for (int k = 0; k < MemStats::NUM_KINDS; k++) {
+            startKindLive[k] = MemStats::liveBytes[k];
+            savedKindPeak[k] = MemStats::peakBytes[k];
+            MemStats::peakBytes[k] = startKindLive[k];
+        }
+    }
+    start = std::chrono::steady_clock::now();
+}
+
+StatScope::~StatScope() {
+    if (entry == nullptr)
+        return;
+    entry->calls++;
+    entry->seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    entry->allocations += ArenaAllocated::getNumAllocations() - startAllocations;
+    entry->allocatedBytes += ArenaAllocated::getAllocatedBytes() - startBytes;
+    if (!memory)
+        return;
+    entry->peakBytes = std::max(entry->peakBytes, MemStats::totalPeak - startLive);
+    MemStats::raise(MemStats::totalPeak, savedPeak);
+    for (int k = 0; k < MemStats::NUM_KINDS; k++) {
+        size_t peak = MemStats::peakBytes[k] - startKindLive[k];
+        if (peak) {
+            size_t &res(entry->peakByKind[MemStats::getName((MemStats::Kind)k)]);
+            res = std::max(res, peak);
+        }
+        MemStats::raise(MemStats::peakBytes[k], savedKindPeak[k]);
+    }
+}
@@ -0,0 +1,236 @@
+/***************************************************************************/ /**
+  * \file       tracewatcher.cpp
+  * \brief   Implementation of the TraceWatcher class
+  ******************************************************************************/
+#include "tracewatcher.h"
+
+#include "proc.h"
+#include "taskscheduler.h"
+
+#include <QFile>
+#include <QTextStream>
+
+TraceWatcher &TraceWatcher::get() {
+    static TraceWatcher watcher;
+    return watcher;
+}
+
+//! Start (or stop) recording. Starting again throws away what was recorded so far
+void TraceWatcher::setEnabled(bool b) {
+    std::lock_guard<std::mutex> guard(lock);
+    enabled = b;
+    if (b) {
+        events.clear();
+        open.clear();
+        threads.clear();
+        start = std::chrono::steady_clock::now();
+    }
+    TaskScheduler::setTraceHook(b ? &TraceWatcher::traceTask : nullptr);
+}
+
+//! The trace hook of the TaskScheduler: a task starting or ending on a worker
+void TraceWatcher::traceTask(const char *name, int, bool begin) {
+    TraceWatcher &tw(get());
+    std::lock_guard<std::mutex> guard(tw.lock);
+    if (tw.enabled)
+        tw.add(begin ? 'B' : 'E', nullptr, name);
+}
+
+void TraceWatcher::add(char phase, const Function *p, const QString &name, int depth) {
+    Event ev;
+    ev.phase = phase;
+    ev.id = p;
+    ev.name = name;
+    if (p)
+        ev.proc = p->getName();
+    ev.depth = depth;
+    auto th = threads.insert(std::make_pair(std::this_thread::get_id(), (int)threads.size() + 1));
+    ev.thread = th.first->second;
+    ev.micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    events.push_back(ev);
+}
+
+void TraceWatcher::begin(const Function *p, const QString &name, int depth) {
+    add('b', p, name, depth);
+    open[p].push_back(name);
+}
+
+//! End the innermost stage of \a p whose name starts with \a name, and the stages opened inside it
+void TraceWatcher::end(const Function *p, const QString &name) {
+    std::vector<QString> &stages(open[p]);
+    size_t i = stages.size();
+    while (i > 0 && !stages[i - 1].startsWith(name))
+        --i;
+    if (i == 0)
+        return;
+    while (stages.size() >= i) {
+        add('e', p, stages.back());
+        stages.pop_back();
+    }
+}
+
+void TraceWatcher::endAll(const Function *p) {
+    auto it = open.find(p);
+    if (it == open.end())
+        return;
+    while (!it->second.empty()) {
+        add('e', p, it->second.back());
+        it->second.pop_back();
+    }
+    open.erase(it);
+}
+
+void TraceWatcher::alertStartDecode(ADDRESS, int) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (enabled)
+        add('B', nullptr, "decode");
+}
+
+void TraceWatcher::alertEndDecode() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (enabled)
+        add('E', nullptr, "decode");
+}
+
+void TraceWatcher::alertDecode(Function *p, ADDRESS, ADDRESS, int) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (enabled)
+        add('n', p, "decoded");
+}
+
+void TraceWatcher::alertStartDecompile(UserProc *p) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (enabled && open[p].empty())
+        begin(p, "decompile");
+}
+
+//! Told before the initial decompilation of \a p, and again before its final one
+void TraceWatcher::alertDecompiling(UserProc *p) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!enabled)
+        return;
+    if (open[p].empty()) {
+        begin(p, "decompile");
+        return;
+    }
+    end(p, "SSA depth");
+    begin(p, "final");
+}
+
+void TraceWatcher::alertDecompileSSADepth(UserProc *p, int depth) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!enabled)
+        return;
+    end(p, "SSA depth");
+    begin(p, QString("SSA depth %1").arg(depth), depth);
+}
+
+void TraceWatcher::alertDecompileBeforePropagate(UserProc *p, int depth) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (enabled)
+        begin(p, "propagate", depth);
+}
+
+void TraceWatcher::alertDecompileAfterPropagate(UserProc *p, int) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (enabled)
+        end(p, "propagate");
+}
+
+void TraceWatcher::alertDecompileAfterRemoveStmts(UserProc *p, int depth) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (enabled)
+        add('n', p, "removed unused statements", depth);
+}
+
+//! A procedure becoming final ends its decompilation, also for the members of a recursion group, which are not ended
+//! one by one
+void TraceWatcher::alertProcStatusChange(UserProc *p) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!enabled || p->getStatus() != PROC_FINAL)
+        return;
+    if (open[p].empty())
+        add('n', p, "final"); // e.g. restored from the cache
+    endAll(p);
+}
+
+void TraceWatcher::alertEndDecompile(UserProc *p) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (enabled)
+        endAll(p);
+}
+
+void TraceWatcher::alertStartCodeGen(UserProc *p) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (enabled)
+        begin(p, "codegen");
+}
+
+void TraceWatcher::alertEndCodeGen(UserProc *p) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (enabled)
+        end(p, "codegen");
+}
+
+static QString jsonString(const QString &s) {
+    QString res("\"");
+    for (QChar c : s) {
+        if (c == '"' || c == '\\')
+            res += '\\';
+        if (c.unicode() < 0x20)
+            res += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+        else
+            res += c;
+    }
+    return res + "\"";
+}
+
+/***************************************************************************/ /**
+  * \brief   Write what was recorded to \a path as a Chrome trace (a JSON object with a "traceEvents" array). Stages
+  * still open, e.g. because decompilation was stopped early, are ended at the time of the last event.
+  * \returns false if the file could not be written
+  ******************************************************************************/
+bool TraceWatcher::writeJSON(const QString &path) {
+    std::lock_guard<std::mutex> guard(lock);
+    double last = events.empty() ? 0 : events.back().micros;
+    for (auto &stages : open)
+        while (!stages.second.empty()) {
+            Event ev = {'e', stages.first, stages.second.back(), QString(), -1, 0, last};
+            events.push_back(ev);
+            stages.second.pop_back();
+        }
+    open.clear();
+
+    QFile f(path);
+    if (!f.open(QFile::WriteOnly | QFile::Truncate | QFile::Text))
+        return false;
+    QTextStream out(&f);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"boomerang\"}}";
+    for (const auto &th : threads)
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << th.second
+            << ",\"args\":{\"name\":\"thread " << th.second << "\"}}";
+    std::map<const void *, int> ids; // Dense, so that the file doesn't depend on where procs were allocated
+    for (const Event &ev : events) {
+        out << ",\n{\"name\":" << jsonString(ev.name) << ",\"ph\":\"" << ev.phase << "\",\"pid\":1,\"tid\":"
+            << (ev.thread ? ev.thread : 1) << ",\"ts\":" << QString::number(ev.micros, 'f', 3);
+        if (ev.id == nullptr) {
+            out << ",\"cat\":\"program\"}";
+            continue;
+        }
+        int id = ids.insert(std::make_pair(ev.id, (int)ids.size() + 1)).first->second;
+        out << ",\"cat\":\"proc\",\"id\":" << id;
+        if (!ev.proc.isEmpty() || ev.depth >= 0) {
+            out << ",\"args\":{";
+            if (!ev.proc.isEmpty())
+                out << "\"proc\":" << jsonString(ev.proc);
+            if (ev.depth >= 0)
+                out << (ev.proc.isEmpty() ? "" : ",") << "\"depth\":" << ev.depth;
+            out << "}";
+        }
+        out << "}";
+    }
+    out << "\n]}\n";
+    out.flush();
+    return f.error() == QFile::NoError;
+}
@@ -0,0 +1,186 @@
+/***************************************************************************/ /**
+  * \file       ArenaTest.cpp
+  * OVERVIEW:   Provides the implementation for the ArenaTest class, which
+  *                tests the Arena region allocator and the objects living in it
+  ******************************************************************************/
+#include "ArenaTest.h"
+
+#include "arena.h"
+#include "exp.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+//! An arena object holding memory of its own on the heap, counting its destructions
+class Counted : public ArenaAllocated {
+  public:
+    typedef Counted ArenaRoot;
+    ARENA_ALLOCATED_AS(mkOther)
+    static int destroyed;
+    std::vector<int> held;
+    Counted() : held(100, 1) {}
+    virtual ~Counted() { destroyed++; }
+};
+int Counted::destroyed = 0;
+
+bool isAligned(const void *p) { return (uintptr_t)p % alignof(std::max_align_t) == 0; }
+}
+
+/***************************************************************************/ /**
+  * \fn        ArenaTest::testAllocate
+  * OVERVIEW:        Test that allocations are aligned and don't overlap, small and large, and that the arena counts
+  *                  them and gives them all back when released
+  ******************************************************************************/
+void ArenaTest::testAllocate() {
+    Arena arena;
+    QCOMPARE(arena.bytesUsed(), size_t(0));
+    std::vector<char *> small;
+    for (int i = 0; i < 5000; i++) {
+        char *p = (char *)arena.allocate(1 + i % 40);
+        QVERIFY(isAligned(p));
+        memset(p, i, 1 + i % 40);
+        small.push_back(p);
+    }
+    for (int i = 0; i < 5000; i++)
+        QCOMPARE(small[i][i % 40], (char)i); // Nothing written over
+    // Larger than a quarter of a block: one of its own, after which the current block goes on being filled
+    char *large = (char *)arena.allocate(Arena::BLOCK_SIZE);
+    QVERIFY(isAligned(large));
+    char *after = (char *)arena.allocate(8);
+    QVERIFY(after < large || after >= large + Arena::BLOCK_SIZE);
+    QVERIFY(arena.bytesUsed() > 5000 + Arena::BLOCK_SIZE);
+    QVERIFY(arena.bytesReserved() >= arena.bytesUsed());
+
+    arena.release();
+    QCOMPARE(arena.bytesUsed(), size_t(0));
+    QCOMPARE(arena.bytesReserved(), size_t(0));
+    QVERIFY(arena.allocate(8) != nullptr); // Usable again
+}
+
+/***************************************************************************/ /**
+  * \fn        ArenaTest::testOwns
+  * OVERVIEW:        Test that Arena::owns() knows arena memory, to the last byte of a large allocation, from heap
+  *                  memory, and that memory stops being the arena's when it is released
+  ******************************************************************************/
+void ArenaTest::testOwns() {
+    Arena arena;
+    char *p = (char *)arena.allocate(16);
+    char *large = (char *)arena.allocate(3 * Arena::BLOCK_SIZE);
+    QVERIFY(Arena::owns(p));
+    QVERIFY(Arena::owns(p + 15));
+    QVERIFY(Arena::owns(large));
+    QVERIFY(Arena::owns(large + 3 * Arena::BLOCK_SIZE - 1));
+    std::vector<char *> heap;
+    for (int i = 0; i < 100; i++) {
+        heap.push_back(new char[1 + i * 100]);
+        QVERIFY(!Arena::owns(heap.back()));
+    }
+    for (char *h : heap)
+        delete[] h;
+    int local;
+    QVERIFY(!Arena::owns(&local));
+
+    arena.release();
+    QVERIFY(!Arena::owns(p));
+    QVERIFY(!Arena::owns(large));
+}
+
+/***************************************************************************/ /**
+  * \fn        ArenaTest::testDestructors
+  * OVERVIEW:        Test that releasing an arena runs the destructors of the objects left in it, once, and not those
+  *                  of the objects deleted before, whose destructors ran then
+  ******************************************************************************/
+void ArenaTest::testDestructors() {
+    Counted::destroyed = 0;
+    Arena arena;
+    std::vector<Counted *> objects;
+    {
+        ArenaScope inArena(&arena, true);
+        for (int i = 0; i < 1000; i++)
+            objects.push_back(new Counted);
+    }
+    for (Counted *c : objects)
+        QVERIFY(Arena::owns(c));
+    for (int i = 0; i < 1000; i += 10)
+        delete objects[i];
+    QCOMPARE(Counted::destroyed, 100);
+
+    arena.release();
+    QCOMPARE(Counted::destroyed, 1000);
+    arena.release(); // Nothing left
+    QCOMPARE(Counted::destroyed, 1000);
+}
+
+/***************************************************************************/ /**
+  * \fn        ArenaTest::testHeap
+  * OVERVIEW:        Test that arena objects come from the heap with no arena current, or one while arenas are not
+  *                  enabled (unless forced), and that nested scopes restore the arena they found
+  ******************************************************************************/
+void ArenaTest::testHeap() {
+    Counted::destroyed = 0;
+    Arena arena;
+    bool wasEnabled = Arena::isEnabled();
+    Arena::setEnabled(false);
+    Counted *c = new Counted;
+    QVERIFY(!Arena::owns(c));
+    {
+        ArenaScope inArena(&arena);
+        QVERIFY(Arena::current() == nullptr);
+        Counted *d = new Counted;
+        QVERIFY(!Arena::owns(d));
+        delete d;
+    }
+    Arena::setEnabled(true);
+    {
+        ArenaScope inArena(&arena);
+        QVERIFY(Arena::current() == &arena);
+        {
+            ArenaScope onHeap(nullptr);
+            QVERIFY(Arena::current() == nullptr);
+        }
+        QVERIFY(Arena::current() == &arena);
+    }
+    QVERIFY(Arena::current() == nullptr);
+    Arena::setEnabled(wasEnabled);
+    delete c;
+    QCOMPARE(Counted::destroyed, 2);
+    arena.release();
+    QCOMPARE(Counted::destroyed, 2);
+}
+
+/***************************************************************************/ /**
+  * \fn        ArenaTest::testOutsideArena
+  * OVERVIEW:        Test that Exp::outsideArena() copies to the heap an expression any of which is in an arena, and
+  *                  keeps one that is all on the heap
+  ******************************************************************************/
+void ArenaTest::testOutsideArena() {
+    Arena arena;
+    Exp *onHeap = Location::memOf(Binary::get(opPlus, Location::regOf(28), new Const(4)));
+    QVERIFY(Exp::outsideArena(onHeap) == onHeap);
+    QVERIFY(Exp::outsideArena(nullptr) == nullptr);
+    Exp *inArena;
+    Exp *part;
+    {
+        ArenaScope scope(&arena, true);
+        inArena = Location::memOf(Binary::get(opPlus, Location::regOf(28), new Const(4)));
+        part = Location::regOf(8);
+    }
+    QVERIFY(Arena::owns(inArena));
+    Exp *copy = Exp::outsideArena(inArena);
+    QVERIFY(copy != inArena);
+    QVERIFY(!Arena::owns(copy));
+    QVERIFY(*copy == *inArena);
+
+    // Only a part of it in the arena
+    Exp *mixed = new Unary(opAddrOf, part);
+    QVERIFY(!Arena::owns(mixed));
+    copy = Exp::outsideArena(mixed);
+    QVERIFY(copy != mixed);
+    QVERIFY(!Arena::owns(copy->getSubExp1()));
+    QVERIFY(*copy == *mixed);
+    arena.release();
+}
+
+QTEST_MAIN(ArenaTest)
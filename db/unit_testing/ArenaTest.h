@@ -0,0 +1,11 @@
+#include <QtTest/QTest>
+
+class ArenaTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void testAllocate();
+    void testOwns();
+    void testDestructors();
+    void testHeap();
+    void testOutsideArena();
+};
@@ -318,4 +318,44 @@ void CfgTest::testRenameVars() {
 
     delete pFE;
 }
+
+/***************************************************************************/ /**
+  * \fn        CfgTest::testSplitBB
+  * OVERVIEW:        Test splitting a BB at labels near either end: the RTLs before the label stay, the rest move
+  ******************************************************************************/
+void CfgTest::testSplitBB() {
+    Cfg cfg;
+    std::list<RTL *> *rtls = new std::list<RTL *>;
+    for (int i = 0; i < 8; i++)
+        rtls->push_back(new RTL(ADDRESS::g(0x1000 + 4 * i)));
+    BasicBlock *top = cfg.newBB(rtls, BBTYPE::FALL, 1);
+    QVERIFY(top != nullptr);
+
+    // Near the end, found from the back
+    BasicBlock *cur = top;
+    QVERIFY(cfg.label(ADDRESS::g(0x1018), cur));
+    QVERIFY(cur != top);
+    QCOMPARE(top->getRTLs()->size(), (size_t)6);
+    QCOMPARE(cur->getRTLs()->size(), (size_t)2);
+    QVERIFY(cur->getLowAddr() == ADDRESS::g(0x1018));
+    QVERIFY(top->getHiAddr() == ADDRESS::g(0x1014));
+    QCOMPARE(top->getNumOutEdges(), (size_t)1);
+    QVERIFY(top->getOutEdge(0) == cur);
+
+    // Near the start, found from the front
+    BasicBlock *bottom = cur;
+    cur = top;
+    QVERIFY(cfg.label(ADDRESS::g(0x1004), cur));
+    QCOMPARE(top->getRTLs()->size(), (size_t)1);
+    QCOMPARE(cur->getRTLs()->size(), (size_t)5);
+    QVERIFY(cur->getLowAddr() == ADDRESS::g(0x1004));
+    QVERIFY(cur->getOutEdge(0) == bottom);
+    QCOMPARE(bottom->getNumInEdges(), (size_t)1);
+    QVERIFY(bottom->getInEdges()[0] == cur);
+
+    // Already a label
+    cur = top;
+    QVERIFY(cfg.label(ADDRESS::g(0x1004), cur));
+    QVERIFY(cur == top);
+}
 QTEST_MAIN(CfgTest)
@@ -12,4 +12,5 @@ class CfgTest : public QObject {
     void testPlacePhi();
     void testPlacePhi2();
     void testRenameVars();
+    void testSplitBB();
 };
@@ -0,0 +1,147 @@
+/***************************************************************************/ /**
+  * \file       DecodeCacheTest.cpp
+  * OVERVIEW:   Provides the implementation for the DecodeCacheTest class, which
+  *                tests the cache of decoded programs
+  ******************************************************************************/
+#include "DecodeCacheTest.h"
+
+#include "decodecache.h"
+#include "proc.h"
+#include "prog.h"
+#include "log.h"
+#include "boomerang.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QProcessEnvironment>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QDebug>
+
+#include <map>
+
+#define FIB_PENTIUM baseDir.absoluteFilePath("tests/inputs/pentium/fib")
+static bool logset = false;
+static QString TEST_BASE;
+static QDir baseDir;
+
+void DecodeCacheTest::initTestCase() {
+    if (!logset) {
+        TEST_BASE = QProcessEnvironment::systemEnvironment().value("BOOMERANG_TEST_BASE", "");
+        baseDir = QDir(TEST_BASE);
+        if (TEST_BASE.isEmpty()) {
+            qWarning() << "BOOMERANG_TEST_BASE environment variable not set, will assume '..', many test may fail";
+            TEST_BASE = "..";
+            baseDir = QDir("..");
+        }
+        logset = true;
+        Boomerang::get()->setProgPath(TEST_BASE);
+        Boomerang::get()->setPluginPath(TEST_BASE + "/out");
+        Boomerang::get()->setLogger(new NullLogger());
+    }
+}
+
+namespace {
+//! The user procs of \a prog by address, with whether each was decoded
+std::map<ADDRESS, bool> userProcs(Prog *prog) {
+    std::map<ADDRESS, bool> procs;
+    for (Module *module : *prog) {
+        for (Function *func : *module) {
+            if (!func->isLib())
+                procs[func->getNativeAddress()] = ((UserProc *)func)->isDecoded();
+        }
+    }
+    return procs;
+}
+
+//! Decompile \a fname and return the C made of it
+QString decompileToC(const QString &fname) {
+    Prog *prog = Boomerang::get()->loadAndDecode(fname);
+    if (prog == nullptr)
+        return QString();
+    prog->decompile();
+    QString text;
+    QTextStream os(&text);
+    prog->generateCode(os);
+    os.flush();
+    delete prog;
+    return text;
+}
+}
+
+/***************************************************************************/ /**
+  * \fn        DecodeCacheTest::testMissThenHit
+  * OVERVIEW:        Test that the first decoding of a binary misses and is stored, and that the next one is read
+  *                  back with the same procedures
+  ******************************************************************************/
+void DecodeCacheTest::testMissThenHit() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    DecodeCache &cache(DecodeCache::get());
+    cache.setDirectory(dir.path());
+    size_t hits = cache.getHits(), misses = cache.getMisses(), stores = cache.getStores();
+
+    Prog *prog = Boomerang::get()->loadAndDecode(FIB_PENTIUM);
+    QVERIFY(prog != nullptr);
+    QCOMPARE(cache.getMisses(), misses + 1);
+    QCOMPARE(cache.getStores(), stores + 1);
+    std::map<ADDRESS, bool> decoded = userProcs(prog);
+    delete prog;
+    QVERIFY(!decoded.empty());
+
+    prog = Boomerang::get()->loadAndDecode(FIB_PENTIUM);
+    QVERIFY(prog != nullptr);
+    QCOMPARE(cache.getHits(), hits + 1);
+    QCOMPARE(cache.getStores(), stores + 1);
+    QVERIFY(userProcs(prog) == decoded);
+    delete prog;
+    cache.setDirectory(QString());
+}
+
+/***************************************************************************/ /**
+  * \fn        DecodeCacheTest::testColdWarm
+  * OVERVIEW:        Test that decompiling a program read from the cache gives the C of a run without the cache
+  ******************************************************************************/
+void DecodeCacheTest::testColdWarm() {
+    QString uncached = decompileToC(FIB_PENTIUM);
+    QVERIFY(!uncached.isEmpty());
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    DecodeCache::get().setDirectory(dir.path());
+    size_t hits = DecodeCache::get().getHits();
+    QString cold = decompileToC(FIB_PENTIUM);
+    QString warm = decompileToC(FIB_PENTIUM);
+    QCOMPARE(DecodeCache::get().getHits(), hits + 1);
+    DecodeCache::get().setDirectory(QString());
+    QCOMPARE(cold, uncached);
+    QCOMPARE(warm, cold);
+}
+
+/***************************************************************************/ /**
+  * \fn        DecodeCacheTest::testKey
+  * OVERVIEW:        Test that an option changing what is decoded keys another entry, and that going back to the
+  *                  first options finds the first entry again
+  ******************************************************************************/
+void DecodeCacheTest::testKey() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    DecodeCache &cache(DecodeCache::get());
+    cache.setDirectory(dir.path());
+    Boomerang &boom(*Boomerang::get());
+    size_t hits = cache.getHits(), misses = cache.getMisses();
+
+    delete boom.loadAndDecode(FIB_PENTIUM);
+    bool noChildren = boom.noDecodeChildren;
+    boom.noDecodeChildren = !noChildren;
+    delete boom.loadAndDecode(FIB_PENTIUM);
+    boom.noDecodeChildren = noChildren;
+    QCOMPARE(cache.getMisses(), misses + 2);
+    QCOMPARE(cache.getHits(), hits);
+
+    delete boom.loadAndDecode(FIB_PENTIUM);
+    QCOMPARE(cache.getHits(), hits + 1);
+    QCOMPARE(cache.getMisses(), misses + 2);
+    QCOMPARE(QDir(dir.path()).entryList(QDir::Dirs | QDir::NoDotAndDotDot).size(), 2);
+    cache.setDirectory(QString());
+}
+
+QTEST_MAIN(DecodeCacheTest)
@@ -0,0 +1,10 @@
+#include <QtTest/QTest>
+
+class DecodeCacheTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void initTestCase();
+    void testMissThenHit();
+    void testColdWarm();
+    void testKey();
+};
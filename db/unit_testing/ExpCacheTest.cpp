@@ -0,0 +1,218 @@
+/***************************************************************************/ /**
+  * \file       ExpCacheTest.cpp
+  * OVERVIEW:   Provides the implementation for the ExpCacheTest class, which
+  *                tests what is cached of and for expressions: their hashes, the
+  *                ExpTable and the simplifications
+  ******************************************************************************/
+#include "ExpCacheTest.h"
+
+#include "exp.h"
+#include "exphelp.h"
+#include "exptable.h"
+#include "memstats.h"
+#include "simplifycache.h"
+#include "statement.h"
+#include "type.h"
+
+/***************************************************************************/ /**
+  * \fn        ExpCacheTest::testHash
+  * OVERVIEW:        Test that expressions that compare equivalent hash the same, and that a few that don't, don't
+  ******************************************************************************/
+void ExpCacheTest::testHash() {
+    // r8 + m[r28 - 4]
+    Exp *a = Binary::get(opPlus, Location::regOf(8),
+                         Location::memOf(Binary::get(opMinus, Location::regOf(28), Const::get(4))));
+    Exp *b = a->clone();
+    QVERIFY(a != b);
+    QVERIFY(*a == *b);
+    QCOMPARE(a->hash(), b->hash());
+    QVERIFY(equalExpStar()(a, b));
+    QCOMPARE(hashExpStar()(a), hashExpStar()(b));
+
+    Exp *c = Binary::get(opPlus, Location::regOf(8),
+                         Location::memOf(Binary::get(opMinus, Location::regOf(28), Const::get(8))));
+    QVERIFY(a->hash() != c->hash());
+    Exp *d = Binary::get(opMinus, Location::regOf(8), Location::regOf(9));
+    Exp *e = Binary::get(opMinus, Location::regOf(9), Location::regOf(8));
+    QVERIFY(d->hash() != e->hash());
+
+    ExpHashSet set;
+    set.insert(a);
+    QVERIFY(set.find(b) != set.end());
+    QVERIFY(set.find(c) == set.end());
+}
+
+/***************************************************************************/ /**
+  * \fn        ExpCacheTest::testHashInvalidation
+  * OVERVIEW:        Test that the cached hash of an expression follows changes to it: through the setters, and
+  *                  through refSubExp* followed by changed(), even when the hash was taken in between
+  ******************************************************************************/
+void ExpCacheTest::testHashInvalidation() {
+    // r8 + (r9 * 4)
+    Binary *mult = new Binary(opMult, Location::regOf(9), Const::get(4));
+    Binary *a = new Binary(opPlus, Location::regOf(8), mult);
+    Exp *expected = Binary::get(opPlus, Location::regOf(8), Binary::get(opMult, Location::regOf(9), Const::get(8)));
+    size_t before = a->hash();
+
+    // A change to a subexpression invalidates the hash of its ancestors
+    mult->setSubExp2(Const::get(8));
+    QVERIFY(a->hash() != before);
+    QCOMPARE(a->hash(), expected->hash());
+
+    // Through the reference, with the hash taken between the call and the write
+    Exp *&ref = mult->refSubExp2();
+    QCOMPARE(a->hash(), expected->hash());
+    ref = Const::get(16);
+    Exp::changed();
+    Exp *now = Binary::get(opPlus, Location::regOf(8), Binary::get(opMult, Location::regOf(9), Const::get(16)));
+    QCOMPARE(a->hash(), now->hash());
+
+    a->setOper(opMinus);
+    QVERIFY(a->hash() != now->hash());
+    QCOMPARE(a->getOper(), opMinus);
+}
+
+/***************************************************************************/ /**
+  * \fn        ExpCacheTest::testExpTable
+  * OVERVIEW:        Test that interning makes structurally identical expressions one node, shared down to the leaves,
+  *                  and keeps apart those that differ only in their definitions or procs
+  ******************************************************************************/
+void ExpCacheTest::testExpTable() {
+    ExpTable &table(ExpTable::get());
+    table.clear();
+    // m[r28 + 4]
+    auto make = []() { return Location::memOf(Binary::get(opPlus, Location::regOf(28), Const::get(4))); };
+    Exp *a = table.intern(make());
+    Exp *b = table.intern(make());
+    QVERIFY(a == b);
+    QVERIFY(table.isInterned(a));
+    QCOMPARE(table.getHits(), (size_t)5); // Every node of b
+    Exp *c = table.intern(Binary::get(opMinus, Location::regOf(28), Const::get(4)));
+    QVERIFY(c->getSubExp1() == a->getSubExp1()->getSubExp1());
+    QVERIFY(c->getSubExp2() == a->getSubExp1()->getSubExp2());
+    QVERIFY(c != a->getSubExp1());
+
+    // Constants of different kinds or values, and references to different definitions, are different nodes
+    QVERIFY(table.intern(Const::get(4)) != table.intern(Const::get(5)));
+    QVERIFY(table.intern(Const::get(4)) != table.intern(Const::get(4.0)));
+    Assign s1(Location::regOf(8), Const::get(1)), s2(Location::regOf(8), Const::get(2));
+    Exp *r1 = table.intern(RefExp::get(Location::regOf(8), &s1));
+    Exp *r2 = table.intern(RefExp::get(Location::regOf(8), &s2));
+    QVERIFY(r1 != r2);
+    QVERIFY(r1->getSubExp1() == r2->getSubExp1());
+    QVERIFY(r1 == table.intern(RefExp::get(Location::regOf(8), &s1)));
+
+    // What can't be shared is left as it is
+    Exp *typed = new TypedExp(IntegerType::get(32), Location::regOf(8));
+    QVERIFY(table.intern(typed) == typed);
+    QVERIFY(!table.isInterned(typed));
+
+    size_t size = table.size();
+    QVERIFY(size > 0);
+    table.clear();
+    QCOMPARE(table.size(), (size_t)0);
+    QVERIFY(!table.isInterned(a));
+    QVERIFY(table.intern(make()) != a);
+    table.clear();
+}
+
+/***************************************************************************/ /**
+  * \fn        ExpCacheTest::testExpTableTerminals
+  * OVERVIEW:        Test that Terminal::get() shares its nodes only while the table is enabled
+  ******************************************************************************/
+void ExpCacheTest::testExpTableTerminals() {
+    ExpTable &table(ExpTable::get());
+    table.clear();
+    QVERIFY(Terminal::get(opPC) != Terminal::get(opPC));
+    table.setEnabled(true);
+    Exp *pc = Terminal::get(opPC);
+    QVERIFY(pc == Terminal::get(opPC));
+    QVERIFY(pc != Terminal::get(opNil));
+    QVERIFY(table.isInterned(pc));
+    QVERIFY(table.intern(new Terminal(opPC)) == pc);
+    table.setEnabled(false);
+    QVERIFY(Terminal::get(opPC) != pc);
+    table.clear();
+}
+
+namespace {
+QString text(const Exp *e) {
+    QString res;
+    QTextStream os(&res);
+    e->print(os);
+    return res;
+}
+}
+
+/***************************************************************************/ /**
+  * \fn        ExpCacheTest::testSimplifyCache
+  * OVERVIEW:        Test that a cached simplification is the same as an uncached one, that the second one is a hit,
+  *                  and that clearing the cache frees the copies it kept
+  ******************************************************************************/
+void ExpCacheTest::testSimplifyCache() {
+    SimplifyCache &cache(SimplifyCache::get());
+    cache.clear();
+    cache.setEnabled(true);
+
+    // ((r9 * 4) + 0 + r8) - r8
+    auto make = []() {
+        Exp *scaled = Binary::get(opPlus, Binary::get(opMult, Location::regOf(9), Const::get(4)), Const::get(0));
+        return Binary::get(opMinus, Binary::get(opPlus, scaled, Location::regOf(8)), Location::regOf(8));
+    };
+    QString expected = text(make()->simplifyUncached());
+
+    Exp *first = make();
+    // What the copy of the key the cache keeps takes up, at least
+    size_t live = MemStats::getTotalLive();
+    Exp *probe = first->clone();
+    size_t keySize = MemStats::getTotalLive() - live;
+
+    QCOMPARE(text(first->simplify()), expected);
+    QCOMPARE(cache.getMisses(), (size_t)1);
+    QCOMPARE(cache.getHits(), (size_t)0);
+    Exp *second = make();
+    Exp *res = second->simplify();
+    QCOMPARE(text(res), expected);
+    QCOMPARE(cache.getHits(), (size_t)1);
+    QCOMPARE(cache.size(), (size_t)1);
+
+    // A hit hands out a copy: changing it leaves the cache alone
+    if (res->getArity() == 2)
+        res->setSubExp2(Const::get(99));
+    QCOMPARE(text(make()->simplify()), expected);
+
+    live = MemStats::getTotalLive();
+    cache.clear();
+    QVERIFY(live - MemStats::getTotalLive() >= keySize);
+    QCOMPARE(cache.size(), (size_t)0);
+    QCOMPARE(cache.getHits(), (size_t)0);
+    cache.setEnabled(false);
+    QCOMPARE(text(probe), text(make()));
+}
+
+/***************************************************************************/ /**
+  * \fn        ExpCacheTest::testSimplifyCacheFull
+  * OVERVIEW:        Test that a full cache starts over, freeing the copies of its entries
+  ******************************************************************************/
+void ExpCacheTest::testSimplifyCacheFull() {
+    SimplifyCache &cache(SimplifyCache::get());
+    cache.clear();
+    cache.setEnabled(true);
+    bool startedOver = false;
+    for (int i = 0; i < (1 << 18) && !startedOver; i++) {
+        Exp *e = Binary::get(opPlus, Location::regOf(8), Const::get(i));
+        size_t entries = cache.size();
+        size_t live = MemStats::getTotalLive();
+        e->simplify();
+        if (cache.size() < entries) {
+            startedOver = true;
+            QCOMPARE(cache.size(), (size_t)1);
+            QVERIFY(MemStats::getTotalLive() < live);
+        }
+    }
+    QVERIFY(startedOver);
+    cache.clear();
+    cache.setEnabled(false);
+}
+
+QTEST_MAIN(ExpCacheTest)
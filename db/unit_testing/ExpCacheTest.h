@@ -0,0 +1,12 @@
+#include <QtTest/QTest>
+
+class ExpCacheTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void testHash();
+    void testHashInvalidation();
+    void testExpTable();
+    void testExpTableTerminals();
+    void testSimplifyCache();
+    void testSimplifyCacheFull();
+};
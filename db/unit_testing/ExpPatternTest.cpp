@@ -0,0 +1,155 @@
+/***************************************************************************/ /**
+  * \file       ExpPatternTest.cpp
+  * OVERVIEW:   Provides the implementation for the ExpPatternTest class, which
+  *                tests the textual expression patterns (CompiledPattern)
+  ******************************************************************************/
+#include "ExpPatternTest.h"
+
+#include "exppattern.h"
+#include "exp.h"
+#include "statement.h"
+
+#include <map>
+
+/***************************************************************************/ /**
+  * \fn        ExpPatternTest::testVariables
+  * OVERVIEW:        Test that variables bind subexpressions, and that a variable used twice must match equal ones
+  ******************************************************************************/
+void ExpPatternTest::testVariables() {
+    CompiledPattern p("m[x + y]");
+    QCOMPARE(p.numVars(), 2);
+    // m[r28 + 4]
+    Exp *e = Location::memOf(Binary::get(opPlus, Location::regOf(28), Const::get(4)));
+    CompiledPattern::Bindings b;
+    QVERIFY(p.match(e, b));
+    QVERIFY(*b[p.varIndex("x")] == *Location::regOf(28));
+    QVERIFY(*b[p.varIndex("y")] == *Const::get(4));
+    QCOMPARE(p.varIndex("z"), -1);
+    QVERIFY(!p.match(Location::regOf(28), b));
+    QVERIFY(!p.match(Location::memOf(Binary::get(opMinus, Location::regOf(28), Const::get(4))), b));
+
+    CompiledPattern twice("x - x");
+    QVERIFY(twice.match(Binary::get(opMinus, Location::regOf(8), Location::regOf(8)), b));
+    QVERIFY(!twice.match(Binary::get(opMinus, Location::regOf(8), Location::regOf(9)), b));
+
+    // Left associative: (a + b) + c
+    CompiledPattern chain("a + b + c");
+    Exp *sum = Binary::get(opPlus, Binary::get(opPlus, Location::regOf(8), Location::regOf(9)), Const::get(1));
+    QVERIFY(chain.match(sum, b));
+    QVERIFY(*b[chain.varIndex("c")] == *Const::get(1));
+    Exp *right = Binary::get(opPlus, Location::regOf(8), Binary::get(opPlus, Location::regOf(9), Const::get(1)));
+    QVERIFY(!chain.match(right, b));
+}
+
+/***************************************************************************/ /**
+  * \fn        ExpPatternTest::testLiterals
+  * OVERVIEW:        Test that literals match only themselves, and never bind
+  ******************************************************************************/
+void ExpPatternTest::testLiterals() {
+    CompiledPattern::Bindings b;
+    CompiledPattern four("r[28] + 4");
+    QCOMPARE(four.numVars(), 0);
+    QVERIFY(four.match(Binary::get(opPlus, Location::regOf(28), Const::get(4)), b));
+    QVERIFY(!four.match(Binary::get(opPlus, Location::regOf(28), Const::get(8)), b));
+    QVERIFY(!four.match(Binary::get(opPlus, Location::regOf(29), Const::get(4)), b));
+    QVERIFY(!four.match(Binary::get(opPlus, Location::regOf(28), Location::regOf(9)), b));
+
+    CompiledPattern hex("m[x + 0x10]");
+    QVERIFY(hex.match(Location::memOf(Binary::get(opPlus, Location::regOf(8), Const::get(16))), b));
+    QVERIFY(!hex.match(Location::memOf(Binary::get(opPlus, Location::regOf(8), Const::get(10))), b));
+
+    CompiledPattern pc("%pc");
+    QCOMPARE(pc.numVars(), 0);
+    QVERIFY(pc.match(Terminal::get(opPC), b));
+    QVERIFY(!pc.match(Terminal::get(opFlags), b));
+    QVERIFY(!pc.match(Location::regOf(8), b));
+}
+
+/***************************************************************************/ /**
+  * \fn        ExpPatternTest::testMembers
+  * OVERVIEW:        Test member access and array indexing
+  ******************************************************************************/
+void ExpPatternTest::testMembers() {
+    CompiledPattern::Bindings b;
+    // m[r8].count
+    Exp *e = Binary::get(opMemberAccess, Location::memOf(Location::regOf(8)), Const::get("count"));
+    CompiledPattern p("m[x].name");
+    QVERIFY(p.match(e, b));
+    Exp *name = b[p.varIndex("name")];
+    QVERIFY(name->isStrConst() && ((Const *)name)->getStr() == "count");
+    QVERIFY(!p.match(Location::memOf(Location::regOf(8)), b));
+
+    // a[i][j]
+    Exp *idx = Binary::get(opArrayIndex, Binary::get(opArrayIndex, Location::regOf(1), Location::regOf(2)),
+                           Location::regOf(3));
+    CompiledPattern arr("a[i][j]");
+    QVERIFY(!arr.match(idx, b)); // a[...] is the address of
+    CompiledPattern arr2("v[i][j]");
+    QVERIFY(arr2.match(idx, b));
+    QVERIFY(*b[arr2.varIndex("j")] == *Location::regOf(3));
+    QVERIFY(b[arr2.varIndex("v")]->getOper() == opRegOf);
+    QVERIFY(CompiledPattern("a[x]").match(Unary::get(opAddrOf, Location::regOf(8)), b));
+}
+
+/***************************************************************************/ /**
+  * \fn        ExpPatternTest::testSubscripts
+  * OVERVIEW:        Test {-} and {n}
+  ******************************************************************************/
+void ExpPatternTest::testSubscripts() {
+    CompiledPattern::Bindings b;
+    Assign def(Location::regOf(8), Const::get(1));
+    def.setNumber(7);
+    CompiledPattern none("x{-}");
+    CompiledPattern seven("r[n]{7}");
+    QVERIFY(none.match(RefExp::get(Location::regOf(8), nullptr), b));
+    QVERIFY(!none.match(RefExp::get(Location::regOf(8), &def), b));
+    QVERIFY(seven.match(RefExp::get(Location::regOf(8), &def), b));
+    QVERIFY(*b[seven.varIndex("n")] == *Const::get(8));
+    def.setNumber(8);
+    QVERIFY(!seven.match(RefExp::get(Location::regOf(8), &def), b));
+    QVERIFY(!seven.match(Location::regOf(8), b));
+}
+
+/***************************************************************************/ /**
+  * \fn        ExpPatternTest::testAssign
+  * OVERVIEW:        Test "lhs := rhs" patterns, through CompiledPattern and Assign::match()
+  ******************************************************************************/
+void ExpPatternTest::testAssign() {
+    CompiledPattern::Bindings b;
+    // r24 := r24 + 1
+    Assign inc(Location::regOf(24), Binary::get(opPlus, Location::regOf(24), Const::get(1)));
+    CompiledPattern p("x := x + 1");
+    QVERIFY(p.matchAssign(&inc, b));
+    QVERIFY(!p.match(inc.getLeft(), b)); // An assignment pattern matches only assignments
+    QVERIFY(!CompiledPattern("x := x + 2").matchAssign(&inc, b));
+    QVERIFY(!CompiledPattern("x + 1").matchAssign(&inc, b));
+
+    std::map<QString, Exp *> bindings;
+    QVERIFY(inc.match("x := y + n", bindings));
+    QCOMPARE(bindings.size(), (size_t)3);
+    QVERIFY(*bindings["x"] == *Location::regOf(24));
+    QVERIFY(*bindings["n"] == *Const::get(1));
+    bindings.clear();
+    QVERIFY(!inc.match("x := m[y]", bindings));
+    QVERIFY(bindings.empty());
+}
+
+/***************************************************************************/ /**
+  * \fn        ExpPatternTest::testStringMatch
+  * OVERVIEW:        Test Exp::match() with a textual pattern, which is compiled once and then reused
+  ******************************************************************************/
+void ExpPatternTest::testStringMatch() {
+    std::map<QString, Exp *> bindings;
+    Exp *e = Location::memOf(Binary::get(opPlus, Location::regOf(28), Const::get(4)));
+    QVERIFY(e->match("m[r[s] + off]", bindings));
+    QVERIFY(*bindings["s"] == *Const::get(28));
+    QVERIFY(*bindings["off"] == *Const::get(4));
+    QVERIFY(&CompiledPattern::get("m[r[s] + off]") == &CompiledPattern::get("m[r[s] + off]"));
+
+    bindings.clear();
+    QVERIFY(!e->match("m[r[28] + 8]", bindings));
+    QVERIFY(e->match("m[r[28] + 4]", bindings));
+    QVERIFY(bindings.empty());
+}
+
+QTEST_MAIN(ExpPatternTest)
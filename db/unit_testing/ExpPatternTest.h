@@ -0,0 +1,12 @@
+#include <QtTest/QTest>
+
+class ExpPatternTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void testVariables();
+    void testLiterals();
+    void testMembers();
+    void testSubscripts();
+    void testAssign();
+    void testStringMatch();
+};
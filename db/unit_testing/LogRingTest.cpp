@@ -0,0 +1,133 @@
+/***************************************************************************/ /**
+  * \file       LogRingTest.cpp
+  * OVERVIEW:   Provides the implementation for the LogRingTest class, which
+  *                tests the ring that queues log messages for the thread writing them
+  ******************************************************************************/
+#include "LogRingTest.h"
+
+#include "log.h"
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+const size_t MEGABYTE = 1 << 20; //!< The capacity of the ring
+
+//! Take from \a ring on another thread until \a total bytes have been taken, into \a to
+std::thread reader(LogRing &ring, std::string &to, size_t total) {
+    return std::thread([&ring, &to, total]() {
+        while (to.size() < total) {
+            if (ring.take(to) == 0)
+                std::this_thread::yield();
+        }
+    });
+}
+
+//! \a n bytes of a pattern that shows where each byte came from
+std::string pattern(size_t n, char first) {
+    std::string s(n, ' ');
+    for (size_t i = 0; i < n; i++)
+        s[i] = first + (char)(i % 23);
+    return s;
+}
+}
+
+/***************************************************************************/ /**
+  * \fn        LogRingTest::testPutTake
+  * OVERVIEW:        Test that take() returns what was put, in order, and only once
+  ******************************************************************************/
+void LogRingTest::testPutTake() {
+    LogRing ring;
+    std::string out;
+    QCOMPARE(ring.take(out), size_t(0));
+    ring.put("hello ", 6);
+    ring.put("world\n", 6);
+    QCOMPARE(ring.getCommitted(), size_t(12));
+    QCOMPARE(ring.take(out), size_t(12));
+    QCOMPARE(out, std::string("hello world\n"));
+    QCOMPARE(ring.take(out), size_t(0));
+    ring.put("again", 5);
+    QCOMPARE(ring.take(out), size_t(5));
+    QCOMPARE(out, std::string("hello world\nagain"));
+}
+
+/***************************************************************************/ /**
+  * \fn        LogRingTest::testWrap
+  * OVERVIEW:        Test that messages are whole across the end of the buffer, taking as it fills
+  ******************************************************************************/
+void LogRingTest::testWrap() {
+    LogRing ring;
+    std::string expected, out;
+    // 7 does not divide the capacity, so messages straddle its end
+    for (int round = 0; round < 5; round++) {
+        for (size_t put = 0; put + 7 * 1000 <= MEGABYTE / 2; put += 7 * 1000) {
+            std::string s = pattern(7 * 1000, 'a' + round);
+            ring.put(s.data(), s.size());
+            expected += s;
+        }
+        ring.take(out);
+    }
+    QVERIFY(expected.size() > 2 * MEGABYTE);
+    QCOMPARE(ring.getCommitted(), expected.size());
+    QVERIFY(out == expected);
+}
+
+/***************************************************************************/ /**
+  * \fn        LogRingTest::testLargePut
+  * OVERVIEW:        Test that a message larger than the ring gets through whole, while a reader takes it
+  ******************************************************************************/
+void LogRingTest::testLargePut() {
+    LogRing ring;
+    std::string big = pattern(5 * MEGABYTE / 2, 'A');
+    std::string out;
+    std::thread r(reader(ring, out, big.size()));
+    ring.put(big.data(), big.size());
+    r.join();
+    QVERIFY(out == big);
+}
+
+/***************************************************************************/ /**
+  * \fn        LogRingTest::testWriters
+  * OVERVIEW:        Test that with several writers at once, every message arrives once and whole, and the messages
+  *                  of each writer in the order it put them
+  ******************************************************************************/
+void LogRingTest::testWriters() {
+    const int WRITERS = 4, MESSAGES = 20000;
+    LogRing ring;
+    std::string out;
+    std::vector<std::thread> writers;
+    std::atomic<size_t> total{0};
+    for (int w = 0; w < WRITERS; w++)
+        writers.emplace_back([&ring, &total, w]() {
+            for (int i = 0; i < MESSAGES; i++) {
+                std::string msg = std::to_string(w) + ":" + std::to_string(i) + "\n";
+                ring.put(msg.data(), msg.size());
+                total += msg.size();
+            }
+        });
+    for (std::thread &t : writers)
+        t.join();
+    while (ring.take(out) != 0)
+        ;
+    QCOMPARE(out.size(), total.load());
+
+    std::vector<int> next(WRITERS, 0);
+    size_t pos = 0;
+    while (pos < out.size()) {
+        size_t colon = out.find(':', pos), end = out.find('\n', pos);
+        QVERIFY(colon != std::string::npos && end != std::string::npos && colon < end);
+        int w = std::stoi(out.substr(pos, colon - pos));
+        int i = std::stoi(out.substr(colon + 1, end - colon - 1));
+        QVERIFY(w >= 0 && w < WRITERS);
+        QCOMPARE(i, next[w]);
+        next[w]++;
+        pos = end + 1;
+    }
+    for (int w = 0; w < WRITERS; w++)
+        QCOMPARE(next[w], MESSAGES);
+}
+
+QTEST_MAIN(LogRingTest)
@@ -0,0 +1,10 @@
+#include <QtTest/QTest>
+
+class LogRingTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void testPutTake();
+    void testWrap();
+    void testLargePut();
+    void testWriters();
+};
@@ -0,0 +1,115 @@
+/***************************************************************************/ /**
+  * \file       NameTableTest.cpp
+  * OVERVIEW:   Provides the implementation for the NameTableTest class, which
+  *                tests the NameTable of names and of the strings of string constants
+  ******************************************************************************/
+#include "NameTableTest.h"
+
+#include "nametable.h"
+#include "exp.h"
+#include "taskscheduler.h"
+
+#include <atomic>
+
+/***************************************************************************/ /**
+  * \fn        NameTableTest::testIntern
+  * OVERVIEW:        Test that each name gets one handle, which gives the name back, and that find() makes none
+  ******************************************************************************/
+void NameTableTest::testIntern() {
+    NameTable::Handle h = NameTable::intern("NameTableTest_main");
+    QVERIFY(h != 0);
+    QCOMPARE(NameTable::intern("NameTableTest_main"), h);
+    QCOMPARE(NameTable::find("NameTableTest_main"), h);
+    QCOMPARE(NameTable::getName(h), QString("NameTableTest_main"));
+    QVERIFY(NameTable::intern("NameTableTest_other") != h);
+    QCOMPARE(NameTable::find("NameTableTest_never"), NameTable::Handle(0));
+    QCOMPARE(NameTable::getName(0), QString());
+}
+
+/***************************************************************************/ /**
+  * \fn        NameTableTest::testPool
+  * OVERVIEW:        Test that equal strings are pooled as one copy, which stays until its last reference is given
+  *                  back, and that the pool is kept apart from the names
+  ******************************************************************************/
+void NameTableTest::testPool() {
+    size_t before = NameTable::poolSize();
+    const QString *a = NameTable::pool("NameTableTest pooled");
+    const QString *b = NameTable::pool(QString("NameTableTest ") + "pooled");
+    QCOMPARE(a, b);
+    QCOMPARE(*a, QString("NameTableTest pooled"));
+    QCOMPARE(NameTable::poolSize(), before + 1);
+    QCOMPARE(NameTable::find("NameTableTest pooled"), NameTable::Handle(0));
+
+    NameTable::retain(a);
+    NameTable::release(a);
+    NameTable::release(b);
+    QCOMPARE(NameTable::poolSize(), before + 1);
+    NameTable::release(a);
+    QCOMPARE(NameTable::poolSize(), before);
+}
+
+/***************************************************************************/ /**
+  * \fn        NameTableTest::testStringConsts
+  * OVERVIEW:        Test that string constants share their pooled string, through copies and setStr(), and that
+  *                  the string is freed with the last constant using it
+  ******************************************************************************/
+void NameTableTest::testStringConsts() {
+    size_t before = NameTable::poolSize();
+    Const *a = new Const(QString("NameTableTest const"));
+    Const *b = new Const(QString("NameTableTest const"));
+    QVERIFY(*a == *b);
+    QCOMPARE(&a->getStr(), &b->getStr());
+    Exp *c = a->clone();
+    QCOMPARE(NameTable::poolSize(), before + 1);
+
+    b->setStr("NameTableTest other");
+    QCOMPARE(b->getStr(), QString("NameTableTest other"));
+    QCOMPARE(NameTable::poolSize(), before + 2);
+    delete b;
+    QCOMPARE(NameTable::poolSize(), before + 1);
+    delete a;
+    QCOMPARE(NameTable::poolSize(), before + 1);
+    delete c;
+    QCOMPARE(NameTable::poolSize(), before);
+
+    // Constants that are not strings, and the empty string, don't count
+    Const *i = new Const(5);
+    Const *e = new Const(QString());
+    QCOMPARE(NameTable::poolSize(), before);
+    delete i;
+    delete e;
+    QCOMPARE(NameTable::poolSize(), before);
+}
+
+/***************************************************************************/ /**
+  * \fn        NameTableTest::testThreads
+  * OVERVIEW:        Test that the table takes its lock while a TaskScheduler runs tasks on several threads: they all
+  *                  get the same handle and pooled string
+  ******************************************************************************/
+void NameTableTest::testThreads() {
+    QVERIFY(!TaskScheduler::isParallel());
+    TaskScheduler scheduler(4);
+    std::atomic<int> mismatches{0};
+    NameTable::Handle h = NameTable::intern("NameTableTest_shared");
+    const QString *s = NameTable::pool("NameTableTest shared");
+    for (int i = 0; i < 64; i++)
+        scheduler.add("names", [&mismatches, h, s, i]() {
+            if (!TaskScheduler::isParallel())
+                mismatches++;
+            for (int j = 0; j < 100; j++) {
+                if (NameTable::intern("NameTableTest_shared") != h)
+                    mismatches++;
+                NameTable::intern(QString("NameTableTest_%1_%2").arg(i).arg(j));
+                const QString *p = NameTable::pool("NameTableTest shared");
+                if (p != s)
+                    mismatches++;
+                NameTable::release(p);
+            }
+        });
+    QVERIFY(scheduler.run());
+    QVERIFY(!TaskScheduler::isParallel());
+    QCOMPARE(mismatches.load(), 0);
+    NameTable::release(s);
+}
+
+QTEST_MAIN(NameTableTest)
@@ -0,0 +1,10 @@
+#include <QtTest/QTest>
+
+class NameTableTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void testIntern();
+    void testPool();
+    void testStringConsts();
+    void testThreads();
+};
@@ -12,6 +12,8 @@
 #include <QtCore/QProcessEnvironment>
 #include <QtCore/QDebug>
 
+#include <thread>
+
 
 #define SPARC_SSL Boomerang::get()->getProgPath() + "frontend/machine/sparc/sparc.ssl"
 static bool logset = false;
@@ -43,6 +45,55 @@ void ParserTest::testRead() {
     QVERIFY(d.readSSLFile(SPARC_SSL));
 }
 
+/***************************************************************************/ /**
+  * \fn        ParserTest::testConcurrentRead
+  * OVERVIEW:        Test that SSL files read on two threads at once give what they give one at a time
+  ******************************************************************************/
+void ParserTest::testConcurrentRead() {
+    QString pentium = Boomerang::get()->getProgPath() + "frontend/machine/pentium/pentium.ssl";
+    RTLInstDict sparc1, pentium1, sparc2, pentium2;
+    QVERIFY(sparc1.readSSLFile(SPARC_SSL));
+    QVERIFY(pentium1.readSSLFile(pentium));
+    bool sparcRead = false, pentiumRead = false;
+    std::thread other([&]() { sparcRead = sparc2.readSSLFile(SPARC_SSL); });
+    pentiumRead = pentium2.readSSLFile(pentium);
+    other.join();
+    QVERIFY(sparcRead && pentiumRead);
+    QCOMPARE(sparc2.idict.size(), sparc1.idict.size());
+    QCOMPARE(pentium2.idict.size(), pentium1.idict.size());
+    QVERIFY(sparc2.RegMap == sparc1.RegMap);
+    QVERIFY(pentium2.RegMap == pentium1.RegMap);
+}
+
+/***************************************************************************/ /**
+  * \fn        ParserTest::testCacheRoundTrip
+  * OVERVIEW:        Test that a dictionary written to the SSL cache format and read back is the one parsed
+  ******************************************************************************/
+void ParserTest::testCacheRoundTrip() {
+    QString pentium = Boomerang::get()->getProgPath() + "frontend/machine/pentium/pentium.ssl";
+    for (const QString &ssl : {QString(SPARC_SSL), pentium}) {
+        RTLInstDict parsed;
+        QVERIFY(parsed.readSSLFile(ssl));
+        QByteArray key = RTLInstDict::getCacheKey(ssl.toUtf8());
+        QByteArray image = parsed.writeImage(key);
+        QVERIFY(!image.isEmpty());
+
+        RTLInstDict cached;
+        QVERIFY(!cached.readImage(image, RTLInstDict::getCacheKey(QByteArray("another"))));
+        QVERIFY(cached.readImage(image, key));
+        QVERIFY(cached.RegMap == parsed.RegMap);
+        QCOMPARE(cached.idict.size(), parsed.idict.size());
+        QCOMPARE(cached.FlagFuncs.size(), parsed.FlagFuncs.size());
+        QString expected, actual;
+        QTextStream expectedStream(&expected), actualStream(&actual);
+        parsed.print(expectedStream);
+        cached.print(actualStream);
+        expectedStream.flush();
+        actualStream.flush();
+        QCOMPARE(actual, expected);
+    }
+}
+
 /***************************************************************************/ /**
   * \fn        ParserTest::testExp
   * OVERVIEW:        Test parsing an expression
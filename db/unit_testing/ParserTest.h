@@ -4,6 +4,8 @@ class ParserTest : public QObject {
     Q_OBJECT
   private slots:
     void testRead();
+    void testConcurrentRead();
+    void testCacheRoundTrip();
     void testExp();
     void initTestCase();
 };
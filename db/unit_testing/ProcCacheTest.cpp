@@ -0,0 +1,129 @@
+/***************************************************************************/ /**
+  * \file       ProcCacheTest.cpp
+  * OVERVIEW:   Provides the implementation for the ProcCacheTest class, which
+  *                tests the cache of the summaries of decompiled procedures
+  ******************************************************************************/
+#include "ProcCacheTest.h"
+
+#include "proccache.h"
+#include "proc.h"
+#include "prog.h"
+#include "log.h"
+#include "boomerang.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QProcessEnvironment>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QDebug>
+
+#include <map>
+
+#define FIB_PENTIUM baseDir.absoluteFilePath("tests/inputs/pentium/fib")
+static bool logset = false;
+static QString TEST_BASE;
+static QDir baseDir;
+
+void ProcCacheTest::initTestCase() {
+    if (!logset) {
+        TEST_BASE = QProcessEnvironment::systemEnvironment().value("BOOMERANG_TEST_BASE", "");
+        baseDir = QDir(TEST_BASE);
+        if (TEST_BASE.isEmpty()) {
+            qWarning() << "BOOMERANG_TEST_BASE environment variable not set, will assume '..', many test may fail";
+            TEST_BASE = "..";
+            baseDir = QDir("..");
+        }
+        logset = true;
+        Boomerang::get()->setProgPath(TEST_BASE);
+        Boomerang::get()->setPluginPath(TEST_BASE + "/out");
+        Boomerang::get()->setLogger(new NullLogger());
+    }
+}
+
+namespace {
+//! Decompile \a fname and return the C made of it
+QString decompileToC(const QString &fname) {
+    Prog *prog = Boomerang::get()->loadAndDecode(fname);
+    if (prog == nullptr)
+        return QString();
+    prog->decompile();
+    QString text;
+    QTextStream os(&text);
+    prog->generateCode(os);
+    os.flush();
+    delete prog;
+    return text;
+}
+
+QString callerSummary(UserProc *proc) {
+    QString text;
+    QTextStream os(&text);
+    proc->printCallerSummary(os);
+    os.flush();
+    return text;
+}
+}
+
+/***************************************************************************/ /**
+  * \fn        ProcCacheTest::testColdWarm
+  * OVERVIEW:        Test that decompiling with a cache filled by an earlier run gives the C of a run without it
+  ******************************************************************************/
+void ProcCacheTest::testColdWarm() {
+    QString uncached = decompileToC(FIB_PENTIUM);
+    QVERIFY(!uncached.isEmpty());
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    ProcCache::get().setDirectory(dir.path());
+    size_t stored = ProcCache::get().getStores();
+    QString cold = decompileToC(FIB_PENTIUM);
+    QVERIFY(ProcCache::get().getStores() > stored);
+    QString warm = decompileToC(FIB_PENTIUM);
+    ProcCache::get().setDirectory(QString());
+    QCOMPARE(cold, uncached);
+    QCOMPARE(warm, cold);
+}
+
+/***************************************************************************/ /**
+  * \fn        ProcCacheTest::testRestore
+  * OVERVIEW:        Test that a proc restored from the cache has the summary it was decompiled to
+  ******************************************************************************/
+void ProcCacheTest::testRestore() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    ProcCache::get().setDirectory(dir.path());
+
+    std::map<ADDRESS, QString> summaries;
+    Prog *prog = Boomerang::get()->loadAndDecode(FIB_PENTIUM);
+    QVERIFY(prog != nullptr);
+    prog->decompile();
+    for (Module *module : *prog) {
+        for (Function *func : *module) {
+            if (!func->isLib() && ((UserProc *)func)->isDecompiled())
+                summaries[func->getNativeAddress()] = callerSummary((UserProc *)func);
+        }
+    }
+    delete prog;
+    QVERIFY(!summaries.empty());
+
+    prog = Boomerang::get()->loadAndDecode(FIB_PENTIUM);
+    QVERIFY(prog != nullptr);
+    size_t restored = 0;
+    for (Module *module : *prog) {
+        for (Function *func : *module) {
+            auto it = summaries.find(func->getNativeAddress());
+            if (func->isLib() || it == summaries.end())
+                continue;
+            UserProc *proc = (UserProc *)func;
+            if (!ProcCache::get().restore(proc))
+                continue; // e.g. uses a type the cache can't write
+            QVERIFY(proc->isFromCache());
+            QCOMPARE(callerSummary(proc), it->second);
+            restored++;
+        }
+    }
+    delete prog;
+    ProcCache::get().setDirectory(QString());
+    QVERIFY(restored > 0);
+}
+
+QTEST_MAIN(ProcCacheTest)
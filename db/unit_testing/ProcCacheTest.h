@@ -0,0 +1,9 @@
+#include <QtTest/QTest>
+
+class ProcCacheTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void initTestCase();
+    void testColdWarm();
+    void testRestore();
+};
@@ -0,0 +1,120 @@
+/***************************************************************************/ /**
+  * \file       ProcStreamerTest.cpp
+  * OVERVIEW:   Provides the implementation for the ProcStreamerTest class, which
+  *                tests generating code for procedures during decompilation (--stream)
+  ******************************************************************************/
+#include "ProcStreamerTest.h"
+
+#include "proc.h"
+#include "prog.h"
+#include "log.h"
+#include "boomerang.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QProcessEnvironment>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QDebug>
+
+#include <vector>
+
+#define FIB_PENTIUM baseDir.absoluteFilePath("tests/inputs/pentium/fib")
+static bool logset = false;
+static QString TEST_BASE;
+static QDir baseDir;
+
+void ProcStreamerTest::initTestCase() {
+    if (!logset) {
+        TEST_BASE = QProcessEnvironment::systemEnvironment().value("BOOMERANG_TEST_BASE", "");
+        baseDir = QDir(TEST_BASE);
+        if (TEST_BASE.isEmpty()) {
+            qWarning() << "BOOMERANG_TEST_BASE environment variable not set, will assume '..', many test may fail";
+            TEST_BASE = "..";
+            baseDir = QDir("..");
+        }
+        logset = true;
+        Boomerang::get()->setProgPath(TEST_BASE);
+        Boomerang::get()->setPluginPath(TEST_BASE + "/out");
+        Boomerang::get()->setLogger(new NullLogger());
+    }
+}
+
+namespace {
+//! The names of the user procs of \a prog that have been decompiled
+std::vector<QString> decompiledProcs(Prog *prog) {
+    std::vector<QString> names;
+    for (Module *module : *prog) {
+        for (Function *func : *module) {
+            if (!func->isLib() && ((UserProc *)func)->isDecompiled())
+                names.push_back(func->getName());
+        }
+    }
+    return names;
+}
+}
+
+/***************************************************************************/ /**
+  * \fn        ProcStreamerTest::testReleased
+  * OVERVIEW:        Test that with --stream, the procs of the call graph have their CFGs released by the end of
+  *                  decompilation, and that their code is still generated
+  ******************************************************************************/
+void ProcStreamerTest::testReleased() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    Boomerang &boom(*Boomerang::get());
+    QString outputPath = boom.getOutputPath();
+    boom.setOutputPath(dir.path() + "/");
+    boom.streamCode = true;
+
+    Prog *prog = boom.loadAndDecode(FIB_PENTIUM);
+    QVERIFY(prog != nullptr);
+    prog->decompile();
+    std::vector<QString> names = decompiledProcs(prog);
+    QVERIFY(!names.empty());
+    for (const QString &name : names) {
+        Function *func = prog->findProc(name);
+        QVERIFY(((UserProc *)func)->getCFG() == nullptr);
+    }
+    QString text;
+    QTextStream os(&text);
+    prog->generateCode(os);
+    os.flush();
+    delete prog;
+    boom.streamCode = false;
+    boom.setOutputPath(outputPath);
+
+    for (const QString &name : names)
+        QVERIFY(text.contains(name + "("));
+}
+
+/***************************************************************************/ /**
+  * \fn        ProcStreamerTest::testStreamedFile
+  * OVERVIEW:        Test that the code of each proc is in streamed.c by the end of decompilation, before the
+  *                  program's code is generated
+  ******************************************************************************/
+void ProcStreamerTest::testStreamedFile() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    Boomerang &boom(*Boomerang::get());
+    QString outputPath = boom.getOutputPath();
+    boom.setOutputPath(dir.path() + "/");
+    boom.streamCode = true;
+
+    Prog *prog = boom.loadAndDecode(FIB_PENTIUM);
+    QVERIFY(prog != nullptr);
+    prog->decompile();
+    std::vector<QString> names = decompiledProcs(prog);
+    QFile streamed(dir.path() + "/streamed.c");
+    bool opened = streamed.open(QFile::ReadOnly | QFile::Text);
+    QString text = QString::fromUtf8(streamed.readAll());
+    delete prog;
+    boom.streamCode = false;
+    boom.setOutputPath(outputPath);
+
+    QVERIFY(opened);
+    QVERIFY(!names.empty());
+    for (const QString &name : names)
+        QVERIFY(text.contains("// " + name + ", of module"));
+}
+
+QTEST_MAIN(ProcStreamerTest)
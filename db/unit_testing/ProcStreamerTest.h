@@ -0,0 +1,9 @@
+#include <QtTest/QTest>
+
+class ProcStreamerTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void initTestCase();
+    void testReleased();
+    void testStreamedFile();
+};
@@ -0,0 +1,86 @@
+/***************************************************************************/ /**
+  * \file       RenameStacksTest.cpp
+  * OVERVIEW:   Provides the implementation for the RenameStacksTest class, which
+  *                tests the stacks of definitions used while renaming
+  ******************************************************************************/
+#include "RenameStacksTest.h"
+
+#include "dataflow.h"
+#include "exp.h"
+#include "statement.h"
+
+/***************************************************************************/ /**
+  * \fn        RenameStacksTest::testIds
+  * OVERVIEW:        Test that each location gets one dense id, found again from an equal expression, and that the
+  *                  stacks keep a copy of the location rather than the expression passed
+  ******************************************************************************/
+void RenameStacksTest::testIds() {
+    RenameStacks stacks;
+    Exp *r24 = Location::regOf(24);
+    Exp *m = Location::memOf(Binary::get(opMinus, Location::regOf(28), Const::get(4)));
+    QCOMPARE(stacks.find(r24), -1);
+    QCOMPARE(stacks.idOf(r24), 0);
+    QCOMPARE(stacks.idOf(m), 1);
+    QCOMPARE(stacks.idOf(Location::regOf(24)), 0);
+    QCOMPARE(stacks.find(m->clone()), 1);
+    QCOMPARE(stacks.size(), size_t(2));
+    QVERIFY(stacks.location(0) != r24);
+    QVERIFY(*stacks.location(0) == *r24);
+    QVERIFY(stacks.top(0) == nullptr);
+    QVERIFY(stacks.top(Location::regOf(25)) == nullptr);
+
+    stacks.clear();
+    QCOMPARE(stacks.size(), size_t(0));
+    QCOMPARE(stacks.find(r24), -1);
+}
+
+/***************************************************************************/ /**
+  * \fn        RenameStacksTest::testPushPop
+  * OVERVIEW:        Test that the innermost definition of each location is on top, separately for each location
+  ******************************************************************************/
+void RenameStacksTest::testPushPop() {
+    RenameStacks stacks;
+    Exp *r24 = Location::regOf(24);
+    Exp *r25 = Location::regOf(25);
+    Instruction *a = new Assign(r24->clone(), Const::get(1));
+    Instruction *b = new Assign(r24->clone(), Const::get(2));
+    Instruction *c = new Assign(r25->clone(), Const::get(3));
+    stacks.push(r24, a);
+    stacks.push(r25, c);
+    stacks.push(r24, b);
+    QCOMPARE(stacks.top(r24), b);
+    QCOMPARE(stacks.top(r25), c);
+    QCOMPARE(stacks.stack(stacks.find(r24)).size(), size_t(2));
+
+    stacks.pop(stacks.find(r24));
+    QCOMPARE(stacks.top(r24), a);
+    stacks.pop(stacks.find(r24));
+    QVERIFY(stacks.top(r24) == nullptr);
+    QCOMPARE(stacks.top(r25), c);
+}
+
+/***************************************************************************/ /**
+  * \fn        RenameStacksTest::testAll
+  * OVERVIEW:        Test that pushAll() pushes on every stack, and that popAll() pops only where it is on top
+  ******************************************************************************/
+void RenameStacksTest::testAll() {
+    RenameStacks stacks;
+    Exp *r24 = Location::regOf(24);
+    Exp *r25 = Location::regOf(25);
+    Instruction *a = new Assign(r24->clone(), Const::get(1));
+    Instruction *all = new Assign(Location::regOf(26), Const::get(0));
+    Instruction *b = new Assign(r25->clone(), Const::get(2));
+    stacks.push(r24, a);
+    stacks.idOf(r25);
+    stacks.pushAll(all);
+    QCOMPARE(stacks.top(r24), all);
+    QCOMPARE(stacks.top(r25), all);
+
+    stacks.push(r25, b);
+    stacks.popAll(all);
+    QCOMPARE(stacks.top(r24), a);
+    QCOMPARE(stacks.top(r25), b);
+    QCOMPARE(stacks.stack(stacks.find(r25)).size(), size_t(2));
+}
+
+QTEST_MAIN(RenameStacksTest)
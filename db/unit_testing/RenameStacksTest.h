@@ -0,0 +1,9 @@
+#include <QtTest/QTest>
+
+class RenameStacksTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void testIds();
+    void testPushPop();
+    void testAll();
+};
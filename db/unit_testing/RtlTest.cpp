@@ -293,4 +293,92 @@ void RtlTest::testSetConscripts() {
     QCOMPARE(actual,expected);
 }
 
+void RtlTest::testModifierPipeline() {
+    // m[1000] := m[1000] + 1000, cast two of the constants, and simplify; once in turn, and once in a single walk
+    Instruction *s1 = new Assign(Location::memOf(new Const(1000), 0),
+                                 new Binary(opPlus, Location::memOf(new Const(1000), nullptr), new Const(1000)));
+    Instruction *s2 = s1->clone();
+    s1->setConscripts(0);
+    s2->setConscripts(0);
+
+    ExpConstCaster c1(1, IntegerType::get(16)), c3(3, IntegerType::get(8));
+    SimpExpModifier simp;
+    StmtModifier sm1(&c1), sm3(&c3), smSimp(&simp);
+    s1->accept(&sm1);
+    s1->accept(&sm3);
+    s1->accept(&smSimp);
+
+    ExpConstCaster d1(1, IntegerType::get(16)), d3(3, IntegerType::get(8));
+    SimpExpModifier dsimp;
+    ExpModifierPipeline pipeline;
+    pipeline.add(&d1);
+    pipeline.add(&d3);
+    pipeline.add(&dsimp);
+    StmtModifier sm(&pipeline);
+    s2->accept(&sm);
+
+    QCOMPARE(d1.isChanged(), true);
+    QCOMPARE(d3.isChanged(), true);
+    QString expected, actual;
+    QTextStream exp_st(&expected), act_st(&actual);
+    s1->print(exp_st);
+    s2->print(act_st);
+    QCOMPARE(actual, expected);
+}
+
+void RtlTest::testExpWalker() {
+    // m[r28 - 4] + r[24]{-} + %pc, subscripted and searched through accept(), then through ExpWalker
+    Exp *e1 = Binary::get(opPlus, Binary::get(opPlus, Location::memOf(Binary::get(opMinus, Location::regOf(28),
+                                                                                  new Const(4))),
+                                              RefExp::get(Location::regOf(24), nullptr)),
+                          new Terminal(opPC));
+    Exp *e2 = e1->clone();
+    QCOMPARE(e2->getKind(), ExpKind::Binary);
+
+    ExpSubscripter es1(Location::regOf(28), nullptr), es2(Location::regOf(28), nullptr);
+    e1 = e1->accept(&es1);
+    e2 = ExpWalker<ExpSubscripter>::modify(e2, es2);
+    QString expected, actual;
+    QTextStream exp_st(&expected), act_st(&actual);
+    e1->print(exp_st);
+    e2->print(act_st);
+    QCOMPARE(actual, expected);
+
+    LocationSet used1, used2;
+    UsedLocsFinder ulf1(used1, false), ulf2(used2, false);
+    e1->accept(&ulf1);
+    ExpWalker<UsedLocsFinder>::visit(e2, ulf2);
+    QCOMPARE(used2.size(), (size_t)4); // m[r28{-} - 4], r28{-}, r24{-} and %pc
+    QVERIFY(used1 == used2);
+}
+
+void RtlTest::testSearchAndReplaceAll() {
+    // r24 := m[r28 - 4] + r26 * r25, replacing m[r28 - 4], r28, r26 and r25; once in turn, and once in a single walk
+    Exp *local = Location::memOf(Binary::get(opMinus, Location::regOf(28), new Const(4)));
+    Instruction *s1 = new Assign(Location::regOf(24), Binary::get(opPlus, local->clone(),
+                                                                 Binary::get(opMult, Location::regOf(26),
+                                                                             Location::regOf(25))));
+    Instruction *s2 = s1->clone();
+    ExpReplaceMap replacements;
+    replacements[local] = Location::local("local0", nullptr);
+    replacements[Location::regOf(28)] = Location::regOf(29); // Inside the local, so not replaced
+    replacements[Location::regOf(26)] = new Const(3);
+    replacements[Location::regOf(25)] = Location::regOf(26); // Not replaced again by 3
+    QVERIFY(s2->searchAndReplaceAll(replacements));
+
+    s1->searchAndReplace(*local, replacements[local]);
+    s1->searchAndReplace(*Location::regOf(25), Location::regOf(27)); // Through r27, which isn't used
+    s1->searchAndReplace(*Location::regOf(26), new Const(3));
+    s1->searchAndReplace(*Location::regOf(27), Location::regOf(26));
+    QString expected, actual;
+    QTextStream exp_st(&expected), act_st(&actual);
+    s1->print(exp_st);
+    s2->print(act_st);
+    QCOMPARE(actual, expected);
+
+    ExpReplaceMap none;
+    none[Location::regOf(30)] = Location::regOf(31);
+    QVERIFY(!s2->searchAndReplaceAll(none));
+}
+
 QTEST_MAIN(RtlTest)
@@ -6,5 +6,8 @@ class RtlTest : public QObject {
     void testClone();
     void testVisitor();
     void testSetConscripts();
+    void testModifierPipeline();
+    void testExpWalker();
+    void testSearchAndReplaceAll();
     void initTestCase();
 };
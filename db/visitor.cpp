@@ -40,8 +40,11 @@ bool SetConscripts::visit(Const *c) {
     if (!bInLocalGlobal) {
         if (bClear)
             c->setConscript(0);
-        else
+        else {
             c->setConscript(++curConscript);
+            if (numbered)
+                numbered->push_back(c);
+        }
     }
     bInLocalGlobal = false;
     return true; // Continue recursion
@@ -69,37 +72,36 @@ bool StmtVisitor::visit(RTL * /*rtl*/) {
 }
 
 bool StmtConscriptSetter::visit(Assign *stmt) {
-    SetConscripts sc(curConscript, bClear);
+    SetConscripts sc(curConscript, bClear, numbered);
     stmt->getLeft()->accept(&sc);
     stmt->getRight()->accept(&sc);
     curConscript = sc.getLast();
     return true;
 }
 bool StmtConscriptSetter::visit(PhiAssign *stmt) {
-    SetConscripts sc(curConscript, bClear);
+    SetConscripts sc(curConscript, bClear, numbered);
     stmt->getLeft()->accept(&sc);
     curConscript = sc.getLast();
     return true;
 }
 bool StmtConscriptSetter::visit(ImplicitAssign *stmt) {
-    SetConscripts sc(curConscript, bClear);
+    SetConscripts sc(curConscript, bClear, numbered);
     stmt->getLeft()->accept(&sc);
     curConscript = sc.getLast();
     return true;
 }
 
 bool StmtConscriptSetter::visit(CallStatement *stmt) {
-    SetConscripts sc(curConscript, bClear);
+    // The arguments are assignments, numbered by this visitor, which keeps the count
     StatementList &args = stmt->getArguments();
     StatementList::iterator ss;
     for (ss = args.begin(); ss != args.end(); ++ss)
         (*ss)->accept(this);
-    curConscript = sc.getLast();
     return true;
 }
 
 bool StmtConscriptSetter::visit(CaseStatement *stmt) {
-    SetConscripts sc(curConscript, bClear);
+    SetConscripts sc(curConscript, bClear, numbered);
     SWITCH_INFO *si = stmt->getSwitchInfo();
     if (si) {
         si->pSwitchVar->accept(&sc);
@@ -109,16 +111,15 @@ bool StmtConscriptSetter::visit(CaseStatement *stmt) {
 }
 
 bool StmtConscriptSetter::visit(ReturnStatement *stmt) {
-    SetConscripts sc(curConscript, bClear);
+    // Likewise the returns
     ReturnStatement::iterator rr;
     for (rr = stmt->begin(); rr != stmt->end(); ++rr)
         (*rr)->accept(this);
-    curConscript = sc.getLast();
     return true;
 }
 
 bool StmtConscriptSetter::visit(BoolAssign *stmt) {
-    SetConscripts sc(curConscript, bClear);
+    SetConscripts sc(curConscript, bClear, numbered);
     stmt->getCondExpr()->accept(&sc);
     stmt->getLeft()->accept(&sc);
     curConscript = sc.getLast();
@@ -126,14 +127,14 @@ bool StmtConscriptSetter::visit(BoolAssign *stmt) {
 }
 
 bool StmtConscriptSetter::visit(BranchStatement *stmt) {
-    SetConscripts sc(curConscript, bClear);
+    SetConscripts sc(curConscript, bClear, numbered);
     stmt->getCondExpr()->accept(&sc);
     curConscript = sc.getLast();
     return true;
 }
 
 bool StmtConscriptSetter::visit(ImpRefStatement *stmt) {
-    SetConscripts sc(curConscript, bClear);
+    SetConscripts sc(curConscript, bClear, numbered);
     stmt->getAddressExp()->accept(&sc);
     curConscript = sc.getLast();
     return true;
@@ -161,7 +162,8 @@ Exp *CallBypasser::postVisit(RefExp *r) {
             mod = true;
             // Now have to recurse to do any further bypassing that may be required
             // E.g. bypass the two recursive calls in fibo?? FIXME: check!
-            return ret->accept(new CallBypasser(enclosingStmt));
+            CallBypasser cb(enclosingStmt);
+            return ExpWalker<CallBypasser>::modify(ret, cb);
         }
     }
 
@@ -243,6 +245,108 @@ Exp *SimpExpModifier::postVisit(Terminal *e) {
     return e;
 }
 
+// ExpModifierPipeline class
+
+//! Call the postVisit of \a m that suits the class of \a e, which an earlier stage may have changed
+static Exp *postVisitAs(ExpModifier *m, Exp *e) {
+    if (Ternary *t = dynamic_cast<Ternary *>(e))
+        return m->postVisit(t);
+    if (Binary *b = dynamic_cast<Binary *>(e))
+        return m->postVisit(b);
+    if (RefExp *r = dynamic_cast<RefExp *>(e))
+        return m->postVisit(r);
+    if (Location *l = dynamic_cast<Location *>(e))
+        return m->postVisit(l);
+    if (TypedExp *t = dynamic_cast<TypedExp *>(e))
+        return m->postVisit(t);
+    if (FlagDef *f = dynamic_cast<FlagDef *>(e))
+        return m->postVisit(f);
+    if (Unary *u = dynamic_cast<Unary *>(e))
+        return m->postVisit(u);
+    if (TypeVal *t = dynamic_cast<TypeVal *>(e))
+        return m->postVisit(t);
+    if (Terminal *t = dynamic_cast<Terminal *>(e))
+        return m->postVisit(t);
+    return m->postVisit((Const *)e);
+}
+
+void ExpModifierPipeline::noteMods() {
+    for (ExpModifier *stage : stages)
+        mod |= stage->isMod();
+}
+
+template <class T> Exp *ExpModifierPipeline::preVisitInner(T *e, bool &recur) {
+    size_t n = stagesHere();
+    assert(n > 0);
+    Exp *ret = stages[0]->preVisit(e, recur);
+    if (ret != e || !recur) {
+        // The first stage has taken over; the others will walk what it returns
+        frames.push_back(Frame{n, true});
+        return ret;
+    }
+    for (size_t i = 1; i < n; i++) {
+        bool r;
+        Exp *same = stages[i]->preVisit(e, r);
+        assert(same == e && r); // Only the first stage may take over an inner node
+        Q_UNUSED(same);
+    }
+    frames.push_back(Frame{n, false});
+    return ret;
+}
+
+template <class T> Exp *ExpModifierPipeline::postVisitInner(T *e) {
+    Frame f = frames.back();
+    frames.pop_back();
+    Exp *ret = stages[0]->postVisit(e);
+    if (f.takenOver) {
+        if (f.numStages > 1) {
+            ExpModifierPipeline tail(std::vector<ExpModifier *>(stages.begin() + 1, stages.begin() + f.numStages));
+            ret = ret->accept(&tail);
+        }
+    } else {
+        for (size_t i = 1; i < f.numStages; i++)
+            ret = postVisitAs(stages[i], ret);
+    }
+    noteMods();
+    return ret;
+}
+
+template <class T> Exp *ExpModifierPipeline::visitLeaf(T *e) {
+    size_t n = stagesHere();
+    Exp *ret = e;
+    for (size_t i = 0; i < n; i++) {
+        // A leaf has no children, so each stage can do all of its work on it before the next one looks at it
+        ret = stages[i]->postVisit((T *)stages[i]->preVisit(e));
+        if (ret != e) {
+            if (i + 1 < n) {
+                ExpModifierPipeline tail(std::vector<ExpModifier *>(stages.begin() + i + 1, stages.begin() + n));
+                ret = ret->accept(&tail);
+            }
+            break;
+        }
+    }
+    noteMods();
+    return ret;
+}
+
+Exp *ExpModifierPipeline::preVisit(Unary *e, bool &recur) { return preVisitInner(e, recur); }
+Exp *ExpModifierPipeline::preVisit(Binary *e, bool &recur) { return preVisitInner(e, recur); }
+Exp *ExpModifierPipeline::preVisit(Ternary *e, bool &recur) { return preVisitInner(e, recur); }
+Exp *ExpModifierPipeline::preVisit(TypedExp *e, bool &recur) { return preVisitInner(e, recur); }
+Exp *ExpModifierPipeline::preVisit(FlagDef *e, bool &recur) { return preVisitInner(e, recur); }
+Exp *ExpModifierPipeline::preVisit(RefExp *e, bool &recur) { return preVisitInner(e, recur); }
+Exp *ExpModifierPipeline::preVisit(Location *e, bool &recur) { return preVisitInner(e, recur); }
+Exp *ExpModifierPipeline::preVisit(Const *e) { return visitLeaf(e); }
+Exp *ExpModifierPipeline::preVisit(Terminal *e) { return visitLeaf(e); }
+Exp *ExpModifierPipeline::preVisit(TypeVal *e) { return visitLeaf(e); }
+Exp *ExpModifierPipeline::postVisit(Unary *e) { return postVisitInner(e); }
+Exp *ExpModifierPipeline::postVisit(Binary *e) { return postVisitInner(e); }
+Exp *ExpModifierPipeline::postVisit(Ternary *e) { return postVisitInner(e); }
+Exp *ExpModifierPipeline::postVisit(TypedExp *e) { return postVisitInner(e); }
+Exp *ExpModifierPipeline::postVisit(FlagDef *e) { return postVisitInner(e); }
+Exp *ExpModifierPipeline::postVisit(RefExp *e) { return postVisitInner(e); }
+Exp *ExpModifierPipeline::postVisit(Location *e) { return postVisitInner(e); }
+
 // Add used locations finder
 bool UsedLocsFinder::visit(Location *e, bool &override) {
     if (!memOnly)
@@ -253,7 +357,7 @@ bool UsedLocsFinder::visit(Location *e, bool &override) {
         // Care! Need to turn off the memOnly flag for work inside the m[...], otherwise everything will get ignored
         bool wasMemOnly = memOnly;
         memOnly = false;
-        child->accept(this);
+        ExpWalker<UsedLocsFinder>::visit(child, *this);
         memOnly = wasMemOnly;
         override = true; // Already looked inside child
     } else
@@ -298,12 +402,12 @@ bool UsedLocsFinder::visit(RefExp &arg, bool &override) {
     // ... unless that is a m[x], array[x] or .x, in which case x (not m[x]/array[x]/refd.x) is used
     Exp *refd = e->getSubExp1();
     if (refd->isMemOf()) {
-        refd->getSubExp1()->accept(this);
+        ExpWalker<UsedLocsFinder>::visit(refd->getSubExp1(), *this);
     } else if (refd->isArrayIndex()) {
-        refd->getSubExp1()->accept(this);
-        refd->getSubExp2()->accept(this);
+        ExpWalker<UsedLocsFinder>::visit(refd->getSubExp1(), *this);
+        ExpWalker<UsedLocsFinder>::visit(refd->getSubExp2(), *this);
     } else if (refd->isMemberOf()) {
-        refd->getSubExp1()->accept(this);
+        ExpWalker<UsedLocsFinder>::visit(refd->getSubExp1(), *this);
     }
     return true;
 }
@@ -352,31 +456,30 @@ bool UsedLocsVisitor::visit(Assign *s, bool &override) {
     Exp *lhs = s->getLeft();
     Exp *rhs = s->getRight();
     if (rhs)
-        rhs->accept(ev);
+        visitExp(rhs);
     // Special logic for the LHS. Note: PPC can have r[tmp + 30] on LHS
     if (lhs->isMemOf() || lhs->isRegOf()) {
         Exp *child = ((Location *)lhs)->getSubExp1(); // m[xxx] uses xxx
         // Care! Don't want the memOnly flag when inside a m[...]. Otherwise, nothing will be found
         // Also beware that ev may be a UsedLocalFinder now
-        UsedLocsFinder *ulf = dynamic_cast<UsedLocsFinder *>(ev);
         if (ulf) {
             bool wasMemOnly = ulf->isMemOnly();
             ulf->setMemOnly(false);
-            child->accept(ev);
+            visitExp(child);
             ulf->setMemOnly(wasMemOnly);
         }
     } else if (lhs->getOper() == opArrayIndex || lhs->getOper() == opMemberAccess) {
         Exp *subExp1 = ((Binary *)lhs)->getSubExp1(); // array(base, index) and member(base, offset)?? use
-        subExp1->accept(ev);                          // base and index
+        visitExp(subExp1);                            // base and index
         Exp *subExp2 = ((Binary *)lhs)->getSubExp2();
-        subExp2->accept(ev);
+        visitExp(subExp2);
     } else if (lhs->getOper() == opAt) { // foo@[first:last] uses foo, first, and last
         Exp *subExp1 = ((Ternary *)lhs)->getSubExp1();
-        subExp1->accept(ev);
+        visitExp(subExp1);
         Exp *subExp2 = ((Ternary *)lhs)->getSubExp2();
-        subExp2->accept(ev);
+        visitExp(subExp2);
         Exp *subExp3 = ((Ternary *)lhs)->getSubExp3();
-        subExp3->accept(ev);
+        visitExp(subExp3);
     }
     override = true; // Don't do the usual accept logic
     return true;     // Continue the recursion
@@ -386,18 +489,17 @@ bool UsedLocsVisitor::visit(PhiAssign *s, bool &override) {
     // Special logic for the LHS
     if (lhs->isMemOf()) {
         Exp *child = ((Location *)lhs)->getSubExp1();
-        UsedLocsFinder *ulf = dynamic_cast<UsedLocsFinder *>(ev);
         if (ulf) {
             bool wasMemOnly = ulf->isMemOnly();
             ulf->setMemOnly(false);
-            child->accept(ev);
+            visitExp(child);
             ulf->setMemOnly(wasMemOnly);
         }
     } else if (lhs->getOper() == opArrayIndex || lhs->getOper() == opMemberAccess) {
         Exp *subExp1 = ((Binary *)lhs)->getSubExp1();
-        subExp1->accept(ev);
+        visitExp(subExp1);
         Exp *subExp2 = ((Binary *)lhs)->getSubExp2();
-        subExp2->accept(ev);
+        visitExp(subExp2);
     }
 
     for (const auto &v : *s) {
@@ -407,7 +509,7 @@ bool UsedLocsVisitor::visit(PhiAssign *s, bool &override) {
         // 0, 1, and 3; inserting the phi parameter at index 3 will cause a null entry at 2
         assert(v.second.e);
         RefExp *temp = RefExp::get(v.second.e, (Instruction *)v.second.def());
-        temp->accept(ev);
+        visitExp(temp);
     }
 
     override = true; // Don't do the usual accept logic
@@ -418,18 +520,17 @@ bool UsedLocsVisitor::visit(ImplicitAssign *s, bool &override) {
     // Special logic for the LHS
     if (lhs->isMemOf()) {
         Exp *child = ((Location *)lhs)->getSubExp1();
-        UsedLocsFinder *ulf = dynamic_cast<UsedLocsFinder *>(ev);
         if (ulf) {
             bool wasMemOnly = ulf->isMemOnly();
             ulf->setMemOnly(false);
-            child->accept(ev);
+            visitExp(child);
             ulf->setMemOnly(wasMemOnly);
         }
     } else if (lhs->getOper() == opArrayIndex || lhs->getOper() == opMemberAccess) {
         Exp *subExp1 = ((Binary *)lhs)->getSubExp1();
-        subExp1->accept(ev);
+        visitExp(subExp1);
         Exp *subExp2 = ((Binary *)lhs)->getSubExp2();
-        subExp2->accept(ev);
+        visitExp(subExp2);
     }
     override = true; // Don't do the usual accept logic
     return true;     // Continue the recursion
@@ -438,12 +539,12 @@ bool UsedLocsVisitor::visit(ImplicitAssign *s, bool &override) {
 bool UsedLocsVisitor::visit(CallStatement *s, bool &override) {
     Exp *pDest = s->getDest();
     if (pDest)
-        pDest->accept(ev);
+        visitExp(pDest);
     StatementList::iterator it;
     StatementList &arguments = s->getArguments();
     for (it = arguments.begin(); it != arguments.end(); it++) {
         // Don't want to ever collect anything from the lhs
-        ((Assign *)*it)->getRight()->accept(ev);
+        visitExp(((Assign *)*it)->getRight());
     }
     if (countCol) {
         DefCollector::iterator dd;
@@ -481,23 +582,22 @@ bool UsedLocsVisitor::visit(ReturnStatement *s, bool &override) {
 bool UsedLocsVisitor::visit(BoolAssign *s, bool &override) {
     Exp *pCond = s->getCondExpr();
     if (pCond)
-        pCond->accept(ev); // Condition is used
+        visitExp(pCond); // Condition is used
     Exp *lhs = s->getLeft();
     assert(lhs);
     if (lhs->isMemOf()) { // If dest is of form m[x]...
         Exp *x = ((Location *)lhs)->getSubExp1();
-        UsedLocsFinder *ulf = dynamic_cast<UsedLocsFinder *>(ev);
         if (ulf) {
             bool wasMemOnly = ulf->isMemOnly();
             ulf->setMemOnly(false);
-            x->accept(ev);
+            visitExp(x);
             ulf->setMemOnly(wasMemOnly);
         }
     } else if (lhs->getOper() == opArrayIndex || lhs->getOper() == opMemberAccess) {
         Exp *subExp1 = ((Binary *)lhs)->getSubExp1();
-        subExp1->accept(ev);
+        visitExp(subExp1);
         Exp *subExp2 = ((Binary *)lhs)->getSubExp2();
-        subExp2->accept(ev);
+        visitExp(subExp2);
     }
     override = true; // Don't do the normal accept logic
     return true;     // Continue the recursion
@@ -539,42 +639,42 @@ Exp *ExpSubscripter::preVisit(RefExp *e, bool &recur) {
 // The Statement subscripter class
 void StmtSubscripter::visit(Assign *s, bool &recur) {
     Exp *rhs = s->getRight();
-    s->setRight(rhs->accept(mod));
+    s->setRight(subscript(rhs));
     // Don't subscript the LHS of an assign, ever
     Exp *lhs = s->getLeft();
     if (lhs->isMemOf() || lhs->isRegOf()) {
-        ((Location *)lhs)->setSubExp1(((Location *)lhs)->getSubExp1()->accept(mod));
+        ((Location *)lhs)->setSubExp1(subscript(((Location *)lhs)->getSubExp1()));
     }
     recur = false;
 }
 void StmtSubscripter::visit(PhiAssign *s, bool &recur) {
     Exp *lhs = s->getLeft();
     if (lhs->isMemOf()) {
-        ((Location *)lhs)->setSubExp1(((Location *)lhs)->getSubExp1()->accept(mod));
+        ((Location *)lhs)->setSubExp1(subscript(((Location *)lhs)->getSubExp1()));
     }
     recur = false;
 }
 void StmtSubscripter::visit(ImplicitAssign *s, bool &recur) {
     Exp *lhs = s->getLeft();
     if (lhs->isMemOf()) {
-        ((Location *)lhs)->setSubExp1(((Location *)lhs)->getSubExp1()->accept(mod));
+        ((Location *)lhs)->setSubExp1(subscript(((Location *)lhs)->getSubExp1()));
     }
     recur = false;
 }
 void StmtSubscripter::visit(BoolAssign *s, bool &recur) {
     Exp *lhs = s->getLeft();
     if (lhs->isMemOf()) {
-        ((Location *)lhs)->setSubExp1(((Location *)lhs)->getSubExp1()->accept(mod));
+        ((Location *)lhs)->setSubExp1(subscript(((Location *)lhs)->getSubExp1()));
     }
     Exp *rhs = s->getCondExpr();
-    s->setCondExpr(rhs->accept(mod));
+    s->setCondExpr(subscript(rhs));
     recur = false;
 }
 
 void StmtSubscripter::visit(CallStatement *s, bool &recur) {
     Exp *pDest = s->getDest();
     if (pDest)
-        s->setDest(pDest->accept(mod));
+        s->setDest(subscript(pDest));
     // Subscript the ordinary arguments
     StatementList &arguments = s->getArguments();
     StatementList::iterator ss;
@@ -585,6 +685,70 @@ void StmtSubscripter::visit(CallStatement *s, bool &recur) {
     recur = false; // Don't do the usual accept logic
 }
 
+// Expression replacer
+ExpReplacer::ExpReplacer(const ExpReplaceMap &r) : replacements(r), change(false) {
+    for (const auto &rr : replacements)
+        opers.set(rr.first->getOper());
+}
+
+Exp *ExpReplacer::replace(Exp *e, bool &recur) {
+    recur = e->getOper() != opInitValueOf; // As in Unary::doSearchChildren
+    if (!opers.test(e->getOper()))
+        return e; // Saves hashing e
+    auto found = replacements.find(e);
+    if (found == replacements.end())
+        return e;
+    recur = false;
+    change = true;
+    mod = true;
+    return found->second->clone();
+}
+
+Exp *ExpReplacer::preVisit(Const *e) {
+    bool recur;
+    return replace(e, recur);
+}
+Exp *ExpReplacer::preVisit(Terminal *e) {
+    bool recur;
+    return replace(e, recur);
+}
+Exp *ExpReplacer::preVisit(TypeVal *e) {
+    bool recur;
+    return replace(e, recur);
+}
+
+// The Statement replacer class
+void StmtReplacer::visit(Assign *s, bool &recur) {
+    if (s->getGuard())
+        s->setGuard(replace(s->getGuard()));
+    recur = true; // The lhs and rhs
+}
+void StmtReplacer::visit(PhiAssign *s, bool &recur) {
+    for (auto &v : *s) {
+        assert(v.second.e);
+        v.second.e = replace(v.second.e);
+    }
+    recur = true; // The lhs
+}
+void StmtReplacer::visit(BoolAssign *s, bool &recur) {
+    s->setCondExpr(replace(s->getCondExpr()));
+    s->setLeft(replace(s->getLeft())); // All of it, not just the x of m[x]
+    recur = false;
+}
+void StmtReplacer::visit(ReturnStatement *s, bool &recur) {
+    // The returns and the collector, but not the modifieds
+    ReturnStatement::iterator rr;
+    for (rr = s->begin(); rr != s->end(); ++rr)
+        (*rr)->accept(this);
+    if (!ignoreCol) {
+        DefCollector::iterator dd;
+        DefCollector *col = s->getCollector();
+        for (dd = col->begin(); dd != col->end(); ++dd)
+            (*dd)->accept(this);
+    }
+    recur = false;
+}
+
 // Size stripper
 Exp *SizeStripper::preVisit(Binary *b, bool &recur) {
     recur = true; // Visit the binary's children
@@ -732,7 +896,7 @@ Exp *ExpPropagator::postVisit(RefExp *e) {
         Exp *lhs = ((Assign *)def)->getLeft();
         Exp *rhs = ((Assign *)def)->getRight();
         bool ch;
-        res = e->searchReplaceAll(RefExp(lhs, def), rhs->clone(), ch);
+        res = e->searchReplaceAll(RefExp(lhs, def), rhs, ch); // Clones rhs for each use
         if (ch) {
             change = true;      // Record this change
             unchanged &= ~mask; // Been changed now (so simplify parent)
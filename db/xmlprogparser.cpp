@@ -19,6 +19,7 @@
 #include "basicblock.h"
 #include "frontend.h"
 
+#include <QtCore/QBuffer>
 #include <QtCore/QFile>
 #include <QtCore/QDebug>
 #include <QtCore/QXmlStreamReader>
@@ -224,18 +225,51 @@ void XMLProgParser::handleElementEnd(const QXmlStreamReader & /*el*/) {
     }
 }
 
+/***************************************************************************/ /**
+  * \brief   The id \a p is written as: objects are numbered from 1 in the order they are first met, 0 being nullptr.
+  * Pointers themselves don't fit the int the reader parses them into on 64 bit hosts, and dense ids let the reader
+  * keep its objects in a vector.
+  ******************************************************************************/
+int XMLProgParser::idOf(const void *p) {
+    if (p == nullptr)
+        return 0;
+    auto it = ids.find(p);
+    if (it != ids.end())
+        return it->second;
+    int id = (int)ids.size() + 1;
+    ids[p] = id;
+    return id;
+}
+
+//! Ids up to this are kept in a vector; larger ones (files written before ids were dense) in a map
+static const int MAX_DENSE_ID = 1 << 24;
+
 void XMLProgParser::addId(const QXmlStreamAttributes &attr, void *x) {
     QStringRef val = attr.value(QLatin1Literal("id"));
     if (!val.isEmpty()) {
         // LOG_STREAM() << "map id " << val << " to " << std::hex << (int)x << std::dec << "\n";
-        idToX[val.toInt()] = x;
+        int n = val.toInt();
+        if (n < 0 || n > MAX_DENSE_ID) {
+            sparseIdToX[n] = x;
+            return;
+        }
+        if ((size_t)n >= idToX.size())
+            idToX.resize(n + 1, nullptr);
+        idToX[n] = x;
     }
 }
 void XMLProgParser::addType(const QXmlStreamAttributes &attr, SharedType x) {
     QStringRef val = attr.value(QLatin1Literal("id"));
     if (!val.isEmpty()) {
         // LOG_STREAM() << "map id " << val << " to " << std::hex << (int)x << std::dec << "\n";
-        idToType[val.toInt()] = x;
+        int n = val.toInt();
+        if (n < 0 || n > MAX_DENSE_ID) {
+            sparseIdToType[n] = x;
+            return;
+        }
+        if ((size_t)n >= idToType.size())
+            idToType.resize(n + 1);
+        idToType[n] = x;
     }
 }
 
@@ -245,8 +279,10 @@ void *XMLProgParser::findId(const QStringRef &id) {
     int n = id.toInt();
     if (n == 0)
         return nullptr;
-    auto it = idToX.find(n);
-    if (it == idToX.end()) {
+    if (n > 0 && n <= MAX_DENSE_ID && (size_t)n < idToX.size() && idToX[n] != nullptr)
+        return idToX[n];
+    auto it = sparseIdToX.find(n);
+    if (it == sparseIdToX.end()) {
         qCritical() << "findId could not find \"" << id << "\"\n";
         assert(false);
         return nullptr;
@@ -259,8 +295,10 @@ SharedType XMLProgParser::findType(const QStringRef &id) {
     int n = id.toInt();
     if (n == 0)
         return nullptr;
-    auto it = idToType.find(n);
-    if (it == idToType.end()) {
+    if (n > 0 && n <= MAX_DENSE_ID && (size_t)n < idToType.size() && idToType[n] != nullptr)
+        return idToType[n];
+    auto it = sparseIdToType.find(n);
+    if (it == sparseIdToType.end()) {
         qCritical() << "findId could not find type for \"" << id << "\"\n";
         assert(false);
         return nullptr;
@@ -304,6 +342,7 @@ void XMLProgParser::addToContext_prog(Context *c, int e) {
         ctx->proc->setProg(c->prog);
         ctx->cluster->getFunctionList().push_back(ctx->proc);
         ctx->cluster->setLocationMap(ctx->proc->getNativeAddress(),stack.front()->proc);
+        ctx->proc->registerName();
         break;
     case e_procs: {
         Module * current_m = ctx->cluster;
@@ -319,7 +358,7 @@ void XMLProgParser::addToContext_prog(Context *c, int e) {
         c->prog->m_rootCluster = ctx->cluster;
         break;
     case e_global:
-        c->prog->globals.insert(ctx->global);
+        c->prog->addGlobal(ctx->global);
         break;
     default:
         if (e == e_unknown)
@@ -532,7 +571,7 @@ void XMLProgParser::addToContext_userproc(Context *c, int e) {
         userproc->setCFG(stack.front()->cfg);
         break;
     case e_local:
-        userproc->locals[stack.front()->str] = stack.front()->type;
+        userproc->setLocal(stack.front()->str, stack.front()->type);
         break;
     case e_symbol:
         userproc->mapSymbolTo(stack.front()->exp, stack.front()->symbol);
@@ -1931,12 +1970,18 @@ void XMLProgParser::addToContext_def(Context * /*c*/, int e) {
     //      }
 }
 
-Prog *XMLProgParser::parse(const QString &filename) {
+//! Read the program saved in \a filename (see persistToXML), and load its binary: \a binary if given, else the one it
+//! was saved from
+Prog *XMLProgParser::parse(const QString &filename, const QString &binary) {
 
     if (!QFile::exists(filename))
         return nullptr;
 
     stack.clear();
+    idToX.clear();
+    idToType.clear();
+    sparseIdToX.clear();
+    sparseIdToType.clear();
     Prog *prog = nullptr;
     for (phase = 0; phase < 2; phase++) {
         parseFile(filename);
@@ -1945,20 +1990,31 @@ Prog *XMLProgParser::parse(const QString &filename) {
             parseChildren(prog->getRootCluster());
         }
     }
+    fileContents.clear();
     if (prog == nullptr)
         return nullptr;
     // FrontEnd *pFE = FrontEnd::Load(prog->getPath(), prog);        // Path is usually empty!?
-    FrontEnd *pFE = FrontEnd::Load(prog->getPathAndName(), prog);
-    prog->setFrontEnd(pFE);
+    FrontEnd *pFE = FrontEnd::Load(binary.isEmpty() ? prog->getPathAndName() : binary, prog);
+    if (pFE == nullptr)
+        return nullptr;
+    // Not setFrontEnd(), which would replace the modules just read with an empty one
+    prog->pLoaderPlugin = pFE->getBinaryFile();
+    prog->pLoaderIface = qobject_cast<LoaderInterface *>(prog->pLoaderPlugin);
+    prog->DefaultFrontend = pFE;
     return prog;
 }
+//! Parse \a filename for the current phase. Each file is read from disk once and parsed from memory in later phases.
 void XMLProgParser::parseFile(const QString &filename) {
-    QFile src(filename);
-    if (!src.exists() || !src.open(QFile::ReadOnly | QFile::Text)) {
-        qWarning() << " File " << filename << " cannot be opened";
-        return;
+    auto cached = fileContents.find(filename);
+    if (cached == fileContents.end()) {
+        QFile src(filename);
+        if (!src.exists() || !src.open(QFile::ReadOnly | QFile::Text)) {
+            qWarning() << " File " << filename << " cannot be opened";
+            return;
+        }
+        cached = fileContents.insert(std::make_pair(filename, src.readAll())).first;
     }
-    QXmlStreamReader xml_stream(&src);
+    QXmlStreamReader xml_stream(cached->second);
     while (!xml_stream.atEnd() && !xml_stream.hasError()) {
         /* Read next element.*/
         QXmlStreamReader::TokenType token = xml_stream.readNext();
@@ -2003,11 +2059,12 @@ int XMLProgParser::operFromString(const QStringRef &s) {
 // out.writeAttribute("\1",\2);
 
 void XMLProgParser::persistToXML(QXmlStreamWriter &out, Module *c) {
+    QIODevice *file = getOutput(c);
     out.writeStartElement("module");
-    out.writeAttribute("id", QString::number(ADDRESS::host_ptr(c).m_value));
+    out.writeAttribute("id", QString::number(idOf(c)));
     out.writeAttribute("name", c->Name);
     for (auto p : *c) {
-        QXmlStreamWriter wrt(c->getStream().device());
+        QXmlStreamWriter wrt(file);
         wrt.writeStartDocument();
         wrt.writeStartElement("procs");
         persistToXML(wrt, p);
@@ -2030,10 +2087,43 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, Global *g) {
     out.writeEndElement();
 }
 
+//! The contents of the file for \a c, as written so far by persistToXML
+QIODevice *XMLProgParser::getOutput(Module *c) {
+    std::unique_ptr<QBuffer> &buf(outputs[c]);
+    if (!buf) {
+        buf.reset(new QBuffer);
+        buf->open(QBuffer::WriteOnly);
+    }
+    return buf.get();
+}
+
+/***************************************************************************/ /**
+  * \brief   Write the files of the modules, leaving alone those whose contents are unchanged. The objects are numbered in
+  * the order they are written (see idOf), so a module whose procedures have not changed, and that comes before any
+  * that have, is written the same as last time.
+  ******************************************************************************/
+void XMLProgParser::writeOutputs() {
+    int unchanged = 0;
+    for (auto &output : outputs) {
+        QFile f(output.first->getOutPath("xml"));
+        const QByteArray &contents(output.second->data());
+        if (f.open(QFile::ReadOnly | QFile::Text) && f.readAll() == contents) {
+            unchanged++;
+            continue;
+        }
+        f.close();
+        if (!f.open(QFile::WriteOnly | QFile::Truncate | QFile::Text) || f.write(contents) != contents.size())
+            qWarning() << " File " << f.fileName() << " cannot be written";
+    }
+    LOG_VERBOSE(1) << "saved " << (int)(outputs.size() - unchanged) << " of " << (int)outputs.size()
+                   << " module files; the others were unchanged\n";
+    outputs.clear();
+}
+
 void XMLProgParser::persistToXML(Prog *prog) {
-    prog->m_rootCluster->openStreams("xml");
-    QTextStream &os = prog->m_rootCluster->getStream();
-    QXmlStreamWriter wrt(os.device());
+    ids.clear();
+    outputs.clear();
+    QXmlStreamWriter wrt(getOutput(prog->m_rootCluster));
     wrt.writeStartDocument();
     if (prog->m_rootCluster->getUpstream())
         wrt.writeStartElement("procs");
@@ -2049,24 +2139,24 @@ void XMLProgParser::persistToXML(Prog *prog) {
     if (prog->m_rootCluster->getUpstream())
         wrt.writeEndElement();
     wrt.writeEndElement();
-    prog->m_rootCluster->closeStreams();
+    writeOutputs();
 }
 
 void XMLProgParser::persistToXML(QXmlStreamWriter &out, LibProc *proc) {
     out.writeStartElement("libproc");
-    out.writeAttribute("id", QString::number(ADDRESS::host_ptr(proc).m_value));
+    out.writeAttribute("id", QString::number(idOf(proc)));
     out.writeAttribute("address", QString::number(proc->address.m_value));
     out.writeAttribute("firstCallerAddress", QString::number(proc->m_firstCallerAddr.m_value));
     if (proc->m_firstCaller)
-        out.writeAttribute("firstCaller", QString::number(ADDRESS::host_ptr(proc->m_firstCaller).m_value));
+        out.writeAttribute("firstCaller", QString::number(idOf(proc->m_firstCaller)));
     if (proc->Parent)
-        out.writeAttribute("cluster", QString::number(ADDRESS::host_ptr(proc->Parent).m_value));
+        out.writeAttribute("cluster", QString::number(idOf(proc->Parent)));
 
     persistToXML(out, proc->signature);
 
     for (auto const &elem : proc->callerSet) {
         out.writeStartElement("caller");
-        out.writeAttribute("call", QString::number(ADDRESS::host_ptr(elem).m_value));
+        out.writeAttribute("call", QString::number(idOf(elem)));
         out.writeEndElement();
     }
     for (auto &elem : proc->provenTrue) {
@@ -2080,22 +2170,22 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, LibProc *proc) {
 
 void XMLProgParser::persistToXML(QXmlStreamWriter &out, UserProc *proc) {
     out.writeStartElement("userproc");
-    out.writeAttribute("id", QString::number(ADDRESS::host_ptr(proc).m_value));
+    out.writeAttribute("id", QString::number(idOf(proc)));
     out.writeAttribute("address", QString::number(proc->address.m_value));
     out.writeAttribute("status", QString::number((int)proc->status));
     out.writeAttribute("firstCallerAddress", QString::number(proc->m_firstCallerAddr.m_value));
     if (proc->m_firstCaller)
-        out.writeAttribute("firstCaller", QString::number(ADDRESS::host_ptr(proc->m_firstCaller).m_value));
+        out.writeAttribute("firstCaller", QString::number(idOf(proc->m_firstCaller)));
     if (proc->Parent)
-        out.writeAttribute("cluster", QString::number(ADDRESS::host_ptr(proc->Parent).m_value));
+        out.writeAttribute("cluster", QString::number(idOf(proc->Parent)));
     if (proc->theReturnStatement)
-        out.writeAttribute("retstmt", QString::number(ADDRESS::host_ptr(proc->theReturnStatement).m_value));
+        out.writeAttribute("retstmt", QString::number(idOf(proc->theReturnStatement)));
 
     persistToXML(out, proc->signature);
 
     for (auto const &elem : proc->callerSet) {
         out.writeStartElement("caller");
-        out.writeAttribute("call", QString::number(ADDRESS::host_ptr(elem).m_value));
+        out.writeAttribute("call", QString::number(idOf(elem)));
         out.writeEndElement();
     }
     for (auto &elem : proc->provenTrue) {
@@ -2127,7 +2217,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, UserProc *proc) {
 
     for (auto &elem : proc->calleeList) {
         out.writeStartElement("callee");
-        out.writeAttribute("proc", QString::number(ADDRESS::host_ptr(elem).m_value));
+        out.writeAttribute("proc", QString::number(idOf(elem)));
         out.writeEndElement();
     }
 
@@ -2145,7 +2235,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, Function *proc) {
 
 void XMLProgParser::persistToXML(QXmlStreamWriter &out, Signature *sig) {
     out.writeStartElement("signature");
-    out.writeAttribute("id", QString::number(ADDRESS::host_ptr(sig).m_value));
+    out.writeAttribute("id", QString::number(idOf(sig)));
     out.writeAttribute("name", sig->name);
     out.writeAttribute("ellipsis", QString::number((int)sig->ellipsis));
     out.writeAttribute("preferedName", sig->preferedName);
@@ -2156,7 +2246,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, Signature *sig) {
 
     for (auto &elem : sig->params) {
         out.writeStartElement("param");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(elem).m_value));
+        out.writeAttribute("id", QString::number(idOf(elem)));
         out.writeAttribute("name", elem->name());
         out.writeStartElement("type");
         persistToXML(out, elem->getType());
@@ -2198,14 +2288,14 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const SharedType &ty) {
     auto v = ty->as<VoidType>();
     if (v) {
         out.writeStartElement("voidtype");
-        out.writeAttribute("index", QString::number(ADDRESS::host_ptr(ty.get()).m_value));
+        out.writeAttribute("index", QString::number(idOf(ty.get())));
         out.writeEndElement();
         return;
     }
     auto f = ty->as<FuncType>();
     if (f) {
         out.writeStartElement("functype");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(ty.get()).m_value));
+        out.writeAttribute("id", QString::number(idOf(ty.get())));
         persistToXML(out, f->signature);
         out.writeEndElement();
         return;
@@ -2213,7 +2303,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const SharedType &ty) {
     auto i = ty->as<IntegerType>();
     if (i) {
         out.writeStartElement("integertype");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(ty.get()).m_value));
+        out.writeAttribute("id", QString::number(idOf(ty.get())));
         out.writeAttribute("size", QString::number(i->size));
         out.writeAttribute("signedness", QString::number(i->signedness));
         out.writeEndElement();
@@ -2222,7 +2312,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const SharedType &ty) {
     auto fl = ty->as<FloatType>();
     if (fl) {
         out.writeStartElement("floattype");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(ty.get()).m_value));
+        out.writeAttribute("id", QString::number(idOf(ty.get())));
         out.writeAttribute("size", QString::number(fl->size));
         out.writeEndElement();
         return;
@@ -2230,21 +2320,21 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const SharedType &ty) {
     auto b = ty->as<BooleanType>();
     if (b) {
         out.writeStartElement("booleantype");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(ty.get()).m_value));
+        out.writeAttribute("id", QString::number(idOf(ty.get())));
         out.writeEndElement();
         return;
     }
     auto c = ty->as<CharType>();
     if (c) {
         out.writeStartElement("chartype");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(ty.get()).m_value));
+        out.writeAttribute("id", QString::number(idOf(ty.get())));
         out.writeEndElement();
         return;
     }
     const PointerType *p = dynamic_cast<const PointerType *>(ty.get());
     if (p) {
         out.writeStartElement("pointertype");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(ty.get()).m_value));
+        out.writeAttribute("id", QString::number(idOf(ty.get())));
         persistToXML(out, p->points_to);
         out.writeEndElement();
         return;
@@ -2252,7 +2342,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const SharedType &ty) {
     auto a = ty->as<ArrayType>();
     if (a) {
         out.writeStartElement("arraytype");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(ty.get()).m_value));
+        out.writeAttribute("id", QString::number(idOf(ty.get())));
         out.writeAttribute("length", QString::number((int)a->Length));
         out.writeStartElement("basetype");
         persistToXML(out, a->BaseType);
@@ -2263,7 +2353,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const SharedType &ty) {
     auto n = ty->asNamed();
     if (n) {
         out.writeStartElement("namedtype");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(ty.get()).m_value));
+        out.writeAttribute("id", QString::number(idOf(ty.get())));
         out.writeAttribute("name", n->name);
         out.writeEndElement();
         return;
@@ -2271,7 +2361,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const SharedType &ty) {
     auto co = ty->as<CompoundType>();
     if (co) {
         out.writeStartElement("compoundtype");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(ty.get()).m_value));
+        out.writeAttribute("id", QString::number(idOf(ty.get())));
         for (unsigned i = 0; i < co->names.size(); i++) {
             out.writeStartElement("member");
             out.writeAttribute("name", co->names[i]);
@@ -2284,7 +2374,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const SharedType &ty) {
     auto sz = ty->as<SizeType>();
     if (sz) {
         out.writeStartElement("sizetype");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(ty.get()).m_value));
+        out.writeAttribute("id", QString::number(idOf(ty.get())));
         out.writeAttribute("size", QString::number(sz->getSize()));
         out.writeEndElement();
         return;
@@ -2298,7 +2388,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Exp *e) {
     const char *op_name = e->getOperName();
     if (t) {
         out.writeStartElement("typeval");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(e).m_value));
+        out.writeAttribute("id", QString::number(idOf(e)));
         out.writeAttribute("op", op_name);
         out.writeStartElement("type");
         persistToXML(out, t->val);
@@ -2309,7 +2399,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Exp *e) {
     const Terminal *te = dynamic_cast<const Terminal *>(e);
     if (te) {
         out.writeStartElement("terminal");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(e).m_value));
+        out.writeAttribute("id", QString::number(idOf(e)));
         out.writeAttribute("op", op_name);
         out.writeEndElement();
         return;
@@ -2317,7 +2407,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Exp *e) {
     const Const *c = dynamic_cast<const Const *>(e);
     if (c) {
         out.writeStartElement("const");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(e).m_value));
+        out.writeAttribute("id", QString::number(idOf(e)));
         out.writeAttribute("op", op_name);
         out.writeAttribute("conscript", QString::number(c->conscript));
         if (c->op == opIntConst)
@@ -2327,7 +2417,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Exp *e) {
         else if (c->op == opFltConst)
             out.writeAttribute("value", QString::number(c->u.d));
         else if (c->op == opStrConst)
-            out.writeAttribute("value", c->strin);
+            out.writeAttribute("value", c->getStr());
         else {
             // TODO
             // QWord ll;
@@ -2340,9 +2430,9 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Exp *e) {
     const Location *l = dynamic_cast<const Location *>(e);
     if (l) {
         out.writeStartElement("location");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(e).m_value));
+        out.writeAttribute("id", QString::number(idOf(e)));
         if (l->proc)
-            out.writeAttribute("proc", QString::number(ADDRESS::host_ptr(l->proc).m_value));
+            out.writeAttribute("proc", QString::number(idOf(l->proc)));
         out.writeAttribute("op", op_name);
         out.writeStartElement("subexp1");
         persistToXML(out, l->subExp1);
@@ -2353,9 +2443,9 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Exp *e) {
     const RefExp *r = dynamic_cast<const RefExp *>(e);
     if (r) {
         out.writeStartElement("refexp");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(e).m_value));
+        out.writeAttribute("id", QString::number(idOf(e)));
         if (r->def)
-            out.writeAttribute("def", QString::number(ADDRESS::host_ptr(r->def).m_value));
+            out.writeAttribute("def", QString::number(idOf(r->def)));
         out.writeAttribute("op", op_name);
         out.writeStartElement("subexp1");
         persistToXML(out, r->subExp1);
@@ -2366,9 +2456,9 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Exp *e) {
     const FlagDef *f = dynamic_cast<const FlagDef *>(e);
     if (f) {
         out.writeStartElement("flagdef");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(e).m_value));
+        out.writeAttribute("id", QString::number(idOf(e)));
         if (f->rtl)
-            out.writeAttribute("rtl", QString::number(ADDRESS::host_ptr(f->rtl).m_value));
+            out.writeAttribute("rtl", QString::number(idOf(f->rtl)));
         out.writeAttribute("op", op_name);
         out.writeStartElement("subexp1");
         persistToXML(out, f->subExp1);
@@ -2379,7 +2469,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Exp *e) {
     const TypedExp *ty = dynamic_cast<const TypedExp *>(e);
     if (ty) {
         out.writeStartElement("typedexp");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(e).m_value));
+        out.writeAttribute("id", QString::number(idOf(e)));
         out.writeAttribute("op", op_name);
         out.writeStartElement("subexp1");
         persistToXML(out, ty->subExp1);
@@ -2393,7 +2483,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Exp *e) {
     const Ternary *tn = dynamic_cast<const Ternary *>(e);
     if (tn) {
         out.writeStartElement("ternary");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(e).m_value));
+        out.writeAttribute("id", QString::number(idOf(e)));
         out.writeAttribute("op", op_name);
         out.writeStartElement("subexp1");
         persistToXML(out, tn->subExp1);
@@ -2410,7 +2500,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Exp *e) {
     const Binary *b = dynamic_cast<const Binary *>(e);
     if (b) {
         out.writeStartElement("binary");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(e).m_value));
+        out.writeAttribute("id", QString::number(idOf(e)));
         out.writeAttribute("op", op_name);
         out.writeStartElement("subexp1");
         persistToXML(out, b->subExp1);
@@ -2424,7 +2514,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Exp *e) {
     const Unary *u = dynamic_cast<const Unary *>(e);
     if (u) {
         out.writeStartElement("unary");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(e).m_value));
+        out.writeAttribute("id", QString::number(idOf(e)));
         out.writeAttribute("op", op_name);
         out.writeStartElement("subexp1");
         persistToXML(out, u->subExp1);
@@ -2438,24 +2528,24 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Exp *e) {
 
 void XMLProgParser::persistToXML(QXmlStreamWriter &out, Cfg *cfg) {
     out.writeStartElement("cfg");
-    out.writeAttribute("id", QString::number(ADDRESS::host_ptr(cfg).m_value));
+    out.writeAttribute("id", QString::number(idOf(cfg)));
     out.writeAttribute("wellformed", QString::number(cfg->WellFormed));
     out.writeAttribute("lastLabel", QString::number(cfg->lastLabel));
-    out.writeAttribute("entryBB", QString::number(ADDRESS::host_ptr(cfg->entryBB).m_value));
-    out.writeAttribute("exitBB", QString::number(ADDRESS::host_ptr(cfg->exitBB).m_value));
+    out.writeAttribute("entryBB", QString::number(idOf(cfg->entryBB)));
+    out.writeAttribute("exitBB", QString::number(idOf(cfg->exitBB)));
 
     for (auto &elem : cfg->m_listBB)
         persistToXML(out, elem);
 
     for (auto &elem : cfg->Ordering) {
         out.writeStartElement("order");
-        out.writeAttribute("bb", QString::number(ADDRESS::host_ptr(elem).m_value));
+        out.writeAttribute("bb", QString::number(idOf(elem)));
         out.writeEndElement();
     }
 
     for (auto &elem : cfg->revOrdering) {
         out.writeStartElement("revorder");
-        out.writeAttribute("bb", QString::number(ADDRESS::host_ptr(elem).m_value));
+        out.writeAttribute("bb", QString::number(idOf(elem)));
         out.writeEndElement();
     }
 
@@ -2470,7 +2560,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, Cfg *cfg) {
 
 void XMLProgParser::persistToXML(QXmlStreamWriter &out, const BasicBlock *bb) {
     out.writeStartElement("order");
-    out.writeAttribute("id", QString::number(ADDRESS::host_ptr(bb).m_value));
+    out.writeAttribute("id", QString::number(idOf(bb)));
     out.writeAttribute("nodeType", QString::number((int)bb->NodeType));
     out.writeAttribute("labelNum", QString::number(bb->LabelNum));
     out.writeAttribute("labelneeded", QString::number(bb->LabelNeeded));
@@ -2499,17 +2589,17 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const BasicBlock *bb) {
     out.writeAttribute("indentLevel", QString::number(bb->IndentLevel));
     // note the rediculous duplication here
     if (bb->ImmPDom)
-        out.writeAttribute("immPDom", QString::number(ADDRESS::host_ptr(bb->ImmPDom).m_value));
+        out.writeAttribute("immPDom", QString::number(idOf(bb->ImmPDom)));
     if (bb->LoopHead)
-        out.writeAttribute("loopHead", QString::number(ADDRESS::host_ptr(bb->LoopHead).m_value));
+        out.writeAttribute("loopHead", QString::number(idOf(bb->LoopHead)));
     if (bb->CaseHead)
-        out.writeAttribute("caseHead", QString::number(ADDRESS::host_ptr(bb->CaseHead).m_value));
+        out.writeAttribute("caseHead", QString::number(idOf(bb->CaseHead)));
     if (bb->CondFollow)
-        out.writeAttribute("condFollow", QString::number(ADDRESS::host_ptr(bb->CondFollow).m_value));
+        out.writeAttribute("condFollow", QString::number(idOf(bb->CondFollow)));
     if (bb->LoopFollow)
-        out.writeAttribute("loopFollow", QString::number(ADDRESS::host_ptr(bb->LoopFollow).m_value));
+        out.writeAttribute("loopFollow", QString::number(idOf(bb->LoopFollow)));
     if (bb->LatchNode)
-        out.writeAttribute("latchNode", QString::number(ADDRESS::host_ptr(bb->LatchNode).m_value));
+        out.writeAttribute("latchNode", QString::number(idOf(bb->LatchNode)));
     out.writeAttribute("sType", QString::number((int)bb->StructuringType));
     out.writeAttribute("usType", QString::number((int)bb->UnstructuredType));
     out.writeAttribute("lType", QString::number((int)bb->LoopHeaderType));
@@ -2517,12 +2607,12 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const BasicBlock *bb) {
 
     for (auto &elem : bb->InEdges) {
         out.writeStartElement("inedge");
-        out.writeAttribute("bb", QString::number(ADDRESS::host_ptr(elem).m_value));
+        out.writeAttribute("bb", QString::number(idOf(elem)));
         out.writeEndElement();
     }
     for (auto &elem : bb->OutEdges) {
         out.writeStartElement("outedge");
-        out.writeAttribute("bb", QString::number(ADDRESS::host_ptr(elem).m_value));
+        out.writeAttribute("bb", QString::number(idOf(elem)));
         out.writeEndElement();
     }
 
@@ -2542,7 +2632,7 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const BasicBlock *bb) {
 
 void XMLProgParser::persistToXML(QXmlStreamWriter &out, const RTL *rtl) {
     out.writeStartElement("rtl");
-    out.writeAttribute("id", QString::number(ADDRESS::host_ptr(rtl).m_value));
+    out.writeAttribute("id", QString::number(idOf(rtl)));
     out.writeAttribute("addr", QString::number(rtl->nativeAddr.m_value));
     for (auto const &elem : *rtl) {
         out.writeStartElement("stmt");
@@ -2556,12 +2646,12 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Instruction *stmt)
     const BoolAssign *b = dynamic_cast<const BoolAssign *>(stmt);
     if (b) {
         out.writeStartElement("boolasgn");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(stmt).m_value));
+        out.writeAttribute("id", QString::number(idOf(stmt)));
         out.writeAttribute("number", QString::number(b->Number));
         //        if (b->parent)
-        //            out.writeAttribute("parent",QString::number(ADDRESS::host_ptr(b->parent).m_value));
+        //            out.writeAttribute("parent",QString::number(idOf(b->parent)));
         if (b->proc)
-            out.writeAttribute("proc", QString::number(ADDRESS::host_ptr(b->proc).m_value));
+            out.writeAttribute("proc", QString::number(idOf(b->proc)));
 
         out.writeAttribute("jtcond", QString::number(b->jtCond));
         out.writeAttribute("float", QString::number((int)b->bFloat));
@@ -2578,12 +2668,12 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Instruction *stmt)
     const ReturnStatement *r = dynamic_cast<const ReturnStatement *>(stmt);
     if (r) {
         out.writeStartElement("returnstmt");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(stmt).m_value));
+        out.writeAttribute("id", QString::number(idOf(stmt)));
         out.writeAttribute("number", QString::number(r->Number));
         //        if (r->parent)
-        //            out.writeAttribute("parent",QString::number(ADDRESS::host_ptr(r->parent).m_value));
+        //            out.writeAttribute("parent",QString::number(idOf(r->parent)));
         if (r->proc)
-            out.writeAttribute("proc", QString::number(ADDRESS::host_ptr(r->proc).m_value));
+            out.writeAttribute("proc", QString::number(idOf(r->proc)));
         out.writeAttribute("retAddr", QString::number(r->retAddr.m_value));
 
         for (auto const &elem : r->modifieds) {
@@ -2603,19 +2693,19 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Instruction *stmt)
     const CallStatement *c = dynamic_cast<const CallStatement *>(stmt);
     if (c) {
         out.writeStartElement("callstmt");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(stmt).m_value));
+        out.writeAttribute("id", QString::number(idOf(stmt)));
         out.writeAttribute("number", QString::number(c->Number));
         out.writeAttribute("computed", QString::number(c->m_isComputed));
         //        if (c->parent)
-        //            out.writeAttribute("parent",QString::number(ADDRESS::host_ptr(c->parent).m_value));
+        //            out.writeAttribute("parent",QString::number(idOf(c->parent)));
         if (c->proc)
-            out.writeAttribute("proc", QString::number(ADDRESS::host_ptr(c->proc).m_value));
+            out.writeAttribute("proc", QString::number(idOf(c->proc)));
         out.writeAttribute("returnAfterCall", QString::number((int)c->returnAfterCall));
 
         if (c->pDest) {
             out.writeStartElement("dest");
             if (c->procDest)
-                out.writeAttribute("proc", QString::number(ADDRESS::host_ptr(c->procDest).m_value));
+                out.writeAttribute("proc", QString::number(idOf(c->procDest)));
             persistToXML(out, c->pDest);
             out.writeEndElement();
         }
@@ -2638,14 +2728,14 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Instruction *stmt)
     const CaseStatement *ca = dynamic_cast<const CaseStatement *>(stmt);
     if (ca) {
         out.writeStartElement("casestmt");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(stmt).m_value));
+        out.writeAttribute("id", QString::number(idOf(stmt)));
         out.writeAttribute("number", QString::number(ca->Number));
         out.writeAttribute("computed", QString::number(ca->m_isComputed));
 
         //        if (ca->parent)
-        //            out.writeAttribute("parent",QString::number(ADDRESS::host_ptr(ca->parent).m_value));
+        //            out.writeAttribute("parent",QString::number(idOf(ca->parent)));
         if (ca->proc)
-            out.writeAttribute("proc", QString::number(ADDRESS::host_ptr(ca->proc).m_value));
+            out.writeAttribute("proc", QString::number(idOf(ca->proc)));
 
         if (ca->pDest) {
             out.writeStartElement("dest");
@@ -2660,15 +2750,15 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Instruction *stmt)
     const BranchStatement *br = dynamic_cast<const BranchStatement *>(stmt);
     if (br) {
         out.writeStartElement("branchstmt");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(stmt).m_value));
+        out.writeAttribute("id", QString::number(idOf(stmt)));
         out.writeAttribute("number", QString::number(br->Number));
         out.writeAttribute("computed", QString::number(br->m_isComputed));
         out.writeAttribute("jtcond", QString::number(br->jtCond));
         out.writeAttribute("float", QString::number(br->bFloat));
         //        if (br->parent)
-        //            out.writeAttribute("parent",QString::number(ADDRESS::host_ptr(br->parent).m_value));
+        //            out.writeAttribute("parent",QString::number(idOf(br->parent)));
         if (br->proc)
-            out.writeAttribute("proc", QString::number(ADDRESS::host_ptr(br->proc).m_value));
+            out.writeAttribute("proc", QString::number(idOf(br->proc)));
 
         if (br->pDest) {
             out.writeStartElement("dest");
@@ -2686,13 +2776,13 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Instruction *stmt)
     const GotoStatement *g = dynamic_cast<const GotoStatement *>(stmt);
     if (g) {
         out.writeStartElement("gotostmt");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(stmt).m_value));
+        out.writeAttribute("id", QString::number(idOf(stmt)));
         out.writeAttribute("number", QString::number(g->Number));
         out.writeAttribute("computed", QString::number(g->m_isComputed));
         //        if (g->parent)
-        //            out.writeAttribute("parent",QString::number(ADDRESS::host_ptr(g->parent).m_value));
+        //            out.writeAttribute("parent",QString::number(idOf(g->parent)));
         if (g->proc)
-            out.writeAttribute("proc", QString::number(ADDRESS::host_ptr(g->proc).m_value));
+            out.writeAttribute("proc", QString::number(idOf(g->proc)));
         if (g->pDest) {
             out.writeStartElement("dest");
             persistToXML(out, g->pDest);
@@ -2704,20 +2794,20 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Instruction *stmt)
     const PhiAssign *p = dynamic_cast<const PhiAssign *>(stmt);
     if (p) {
         out.writeStartElement("phiassign");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(stmt).m_value));
+        out.writeAttribute("id", QString::number(idOf(stmt)));
         out.writeAttribute("number", QString::number(p->Number));
         //        if (p->parent)
-        //            out.writeAttribute("parent",QString::number(ADDRESS::host_ptr(p->parent).m_value));
+        //            out.writeAttribute("parent",QString::number(idOf(p->parent)));
         if (p->proc)
-            out.writeAttribute("proc", QString::number(ADDRESS::host_ptr(p->proc).m_value));
+            out.writeAttribute("proc", QString::number(idOf(p->proc)));
 
         out.writeStartElement("lhs");
         persistToXML(out, p->lhs);
         out.writeEndElement();
         for (auto it = p->cbegin(); it != p->cend(); p++) {
             out.writeStartElement("def");
-            out.writeAttribute("stmt", QString::number(ADDRESS::host_ptr(it->second.def()).m_value));
-            out.writeAttribute("exp", QString::number(ADDRESS::host_ptr(it->second.e).m_value));
+            out.writeAttribute("stmt", QString::number(idOf(it->second.def())));
+            out.writeAttribute("exp", QString::number(idOf(it->second.e)));
             out.writeEndElement();
         }
         out.writeEndElement();
@@ -2726,12 +2816,12 @@ void XMLProgParser::persistToXML(QXmlStreamWriter &out, const Instruction *stmt)
     const Assign *a = dynamic_cast<const Assign *>(stmt);
     if (a) {
         out.writeStartElement("assign");
-        out.writeAttribute("id", QString::number(ADDRESS::host_ptr(stmt).m_value));
+        out.writeAttribute("id", QString::number(idOf(stmt)));
         out.writeAttribute("number", QString::number(a->Number));
         //        if (a->parent)
-        //            out.writeAttribute("parent",QString::number(ADDRESS::host_ptr(a->parent).m_value));
+        //            out.writeAttribute("parent",QString::number(idOf(a->parent)));
         if (a->proc)
-            out.writeAttribute("proc", QString::number(ADDRESS::host_ptr(a->proc).m_value));
+            out.writeAttribute("proc", QString::number(idOf(a->proc)));
 
         out.writeStartElement("lhs");
         persistToXML(out, a->lhs);
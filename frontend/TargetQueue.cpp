@@ -4,6 +4,38 @@
 #include "log.h"
 #include "cfg.h"
 
+/***************************************************************************/ /**
+  *
+  * \brief   Size the bitmap of queued addresses for a text section from \a low up to \a high
+  ******************************************************************************/
+void TargetQueue::setTextLimits(ADDRESS low, ADDRESS high) {
+    size_t size = high > low ? (high - low).m_value : 0;
+    if (low == textLow && size == queued.size())
+        return;
+    // Only happens between procs, with an empty queue
+    textLow = low;
+    queued.assign(size, false);
+}
+
+//! Note that \a a is in targets. \returns false if it already was
+bool TargetQueue::markQueued(ADDRESS a) {
+    if (a >= textLow && (a - textLow).m_value < queued.size()) {
+        std::vector<bool>::reference bit = queued[(a - textLow).m_value];
+        if (bit)
+            return false;
+        bit = true;
+        return true;
+    }
+    return queuedOutside.insert(a).second;
+}
+
+void TargetQueue::unmarkQueued(ADDRESS a) {
+    if (a >= textLow && (a - textLow).m_value < queued.size())
+        queued[(a - textLow).m_value] = false;
+    else
+        queuedOutside.erase(a);
+}
+
 /***************************************************************************/ /**
   *
   * \brief   Visit a destination as a label, i.e. check whether we need to queue it as a new BB to create later.
@@ -20,8 +52,8 @@ void TargetQueue::visit(Cfg *pCfg, ADDRESS uNewAddr, BasicBlock *&pNewBB) {
     // Find out if we've already parsed the destination
     bool bParsed = pCfg->label(uNewAddr, pNewBB);
     // Add this address to the back of the local queue,
-    // if not already processed
-    if (!bParsed) {
+    // if not already processed, nor waiting in the queue already (branches to a common label)
+    if (!bParsed && markQueued(uNewAddr)) {
         targets.push(uNewAddr);
         if (Boomerang::get()->traceDecoder)
             LOG << ">" << uNewAddr << "\t";
@@ -34,7 +66,10 @@ void TargetQueue::visit(Cfg *pCfg, ADDRESS uNewAddr, BasicBlock *&pNewBB) {
   * \note        Can be some targets already in the queue now
   * \param    uAddr Native address to seed the queue with
   ******************************************************************************/
-void TargetQueue::initial(ADDRESS uAddr) { targets.push(uAddr); }
+void TargetQueue::initial(ADDRESS uAddr) {
+    if (markQueued(uAddr))
+        targets.push(uAddr);
+}
 
 /***************************************************************************/ /**
   *
@@ -48,6 +83,7 @@ ADDRESS TargetQueue::nextAddress(const Cfg &cfg) {
     while (!targets.empty()) {
         ADDRESS address = targets.front();
         targets.pop();
+        unmarkQueued(address);
         if (Boomerang::get()->traceDecoder)
             LOG << "<" << address << "\t";
 
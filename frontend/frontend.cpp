@@ -35,16 +35,26 @@
 #include "signature.h"
 #include "boomerang.h"
 #include "log.h"
+#include "stats.h"
 #include "ansi-c-parser.h"
+#include "exptable.h"
+#include "simplifycache.h"
+#include "taskscheduler.h"
 #include "IBinaryImage.h"
+#include "IBinarySection.h"
 #include "db/SymTab.h"
 
+#include <QtCore/QCryptographicHash>
 #include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
 #include <QtCore/QDebug>
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <cstdlib>
 #include <queue>
+#include <set>
 #include <cstdarg> // For varargs
 #include <sstream>
 
@@ -102,6 +112,10 @@ FrontEnd *FrontEnd::instantiate(QObject *pBF, Prog *prog, BinaryFileFactory *pbf
 /***************************************************************************/ /**
   *
   * \brief Create FrontEnd instance given \a fname and \a prog
+  *
+  * With --prefetch, the machine is probed from the header first, and its signature files are read on the other workers
+  * of a TaskScheduler while the loader maps the sections and builds the symbol table; readLibraryCatalog then finds
+  * them read (see prefetch()).
   * \param fname string with full path to decoded file
   * \param prog program being decoded
   * \returns Binary-specific frontend.
@@ -110,7 +124,15 @@ FrontEnd *FrontEnd::Load(const QString &fname, Prog *prog) {
     BinaryFileFactory *pbff = new BinaryFileFactory;
     if (pbff == nullptr)
         return nullptr;
+    TaskScheduler prefetching(getParseWorkers());
+    if (Boomerang::get()->prefetch) {
+        LOAD_FMT format = LOADFMT_ELF;
+        MACHINE machine = BinaryFileFactory::probeMachine(fname, format);
+        prefetch(machine, format, prefetching);
+    }
+    prefetching.start();
     QObject *pBF = pbff->Load(fname);
+    prefetching.wait();
     if (pBF == nullptr)
         return nullptr;
     FrontEnd *fe = instantiate(pBF, prog, pbff);
@@ -122,23 +144,16 @@ void FrontEnd::AddSymbol(ADDRESS addr, const QString &nam) {
 }
 // destructor
 FrontEnd::~FrontEnd() {
+    clearDecodeCache();
+    if (!signatureFiles.empty())
+        Type::setNamedTypeResolver(nullptr);
     if (pbff)
         pbff->UnLoad(); // Unload the BinaryFile library with dlclose() or FreeLibrary()
 }
 
-QString FrontEnd::getRegName(int idx) const {
-    static QString nullres;
-    for (const std::pair<QString,int> &elem : decoder->getRTLDict().RegMap)
-        if (elem.second == idx)
-            return elem.first;
-    return nullres;
-}
+QString FrontEnd::getRegName(int idx) const { return decoder->getRTLDict().getRegName(idx); }
 
-int FrontEnd::getRegSize(int idx) {
-    if (decoder->getRTLDict().DetRegMap.find(idx) == decoder->getRTLDict().DetRegMap.end())
-        return 32;
-    return decoder->getRTLDict().DetRegMap[idx].g_size();
-}
+int FrontEnd::getRegSize(int idx) { return decoder->getRTLDict().getRegSize(idx); }
 
 bool FrontEnd::isWin32() { return ldrIface->GetFormat() == LOADFMT_PE; }
 
@@ -147,15 +162,16 @@ bool FrontEnd::noReturnCallDest(const QString &name) {
             (name == "_assert"));
 }
 
-void FrontEnd::readLibraryCatalog(const QString &sPath) {
+//! The signature files listed in the catalog \a sPath, with the calling convention of each
+std::vector<std::pair<QString, callconv>> FrontEnd::getCatalogFiles(const QString &sPath) {
     // TODO: this is a work for generic semantics provider plugin : HeaderReader
     QFile file(sPath);
     if (!file.open(QFile::ReadOnly|QFile::Text)) {
         qCritical() << "can't open `" << sPath << "'\n";
         exit(1); //TODO: this should not exit, just inform the caller about the problem
     }
+    std::vector<std::pair<QString, callconv>> files;
     QTextStream inf(&file);
-    QString sig_path;
     while (!inf.atEnd()) {
         QString sFile;
         inf >> sFile;
@@ -164,24 +180,150 @@ void FrontEnd::readLibraryCatalog(const QString &sPath) {
             sFile = sFile.mid(0, sFile.size() - 1);
         if (sFile.isEmpty())
             continue;
-        sig_path = Boomerang::get()->getProgPath() + "signatures/" + sFile;
         callconv cc = CONV_C; // Most APIs are C calling convention
         if (sFile == "windows.h")
             cc = CONV_PASCAL; // One exception
         if (sFile == "mfc.h")
             cc = CONV_THISCALL; // Another exception
-        readLibrarySignatures(qPrintable(sig_path), cc);
+        files.emplace_back(Boomerang::get()->getProgPath() + "signatures/" + sFile, cc);
     }
+    return files;
+}
+
+void FrontEnd::readLibraryCatalog(const QString &sPath) {
+    for (const std::pair<QString, callconv> &f : getCatalogFiles(sPath))
+        addSignatureFile(f.first, f.second);
+}
+
+/***************************************************************************/ /**
+  * \brief   The key of the name index of signature file \a path: a hash of its contents, the platform, the calling
+  * convention and the version, since all of those change what the file declares
+  ******************************************************************************/
+QByteArray FrontEnd::getSignatureIndexKey(const QString &path, callconv cc) {
+    return getSignatureIndexKey(path, getFrontEndId(), cc);
+}
+
+QByteArray FrontEnd::getSignatureIndexKey(const QString &path, platform plat, callconv cc) {
+    QFile f(path);
+    if (!f.open(QFile::ReadOnly))
+        return QByteArray();
+    QCryptographicHash h(QCryptographicHash::Sha1);
+    h.addData(QByteArray(Boomerang::getVersionStr()));
+    h.addData(QByteArray::number((int)plat) + "," + QByteArray::number((int)cc) + ",");
+    h.addData(f.readAll());
+    return h.result().toHex();
+}
+
+/***************************************************************************/ /**
+  * \brief   Add a file of the signature catalog. Normally it is read at once; with --lazy-sigs, only the names it
+  * declares are noted, and the file is read the first time one of them is looked up (getLibSignature(), or
+  * Type::getNamedType() through resolveNamedType()).
+  *
+  * The names come from an index saved next to the file as <file>.index, written the first time the file is read
+  * and used for as long as its key (see getSignatureIndexKey()) matches. Without a usable index the file is read now.
+  ******************************************************************************/
+void FrontEnd::addSignatureFile(const QString &path, callconv cc) {
+    if (!Boomerang::get()->lazySignatures) {
+        readLibrarySignatures(qPrintable(path), cc);
+        return;
+    }
+    int idx = signatureFiles.size();
+    signatureFiles.push_back({path, cc, false});
+    if (idx == 0)
+        Type::setNamedTypeResolver([this](const QString &name) { return resolveNamedType(name); });
+
+    QByteArray key = getSignatureIndexKey(path, cc);
+    QFile indexFile(path + ".index");
+    if (!key.isEmpty() && indexFile.open(QFile::ReadOnly | QFile::Text)) {
+        QTextStream is(&indexFile);
+        if (is.readLine() == "boomerang-signature-index 1 " + QString(key)) {
+            while (!is.atEnd()) {
+                QString line = is.readLine();
+                if (line.startsWith("s "))
+                    pendingSignatures[line.mid(2)] = idx;
+                else if (line.startsWith("t "))
+                    pendingTypes[line.mid(2)] = idx;
+            }
+            return;
+        }
+    }
+
+    // No index, or a stale one: read the file, and index what it defined
+    QStringList before = Type::getNamedTypeNames();
+    QStringList sigs;
+    signatureFiles[idx].read = true;
+    readingSignatures = true;
+    readLibrarySignatures(qPrintable(path), cc, &sigs);
+    readingSignatures = false;
+    if (key.isEmpty())
+        return;
+    std::set<QString> known(before.begin(), before.end());
+    QSaveFile out(path + ".index");
+    if (!out.open(QFile::WriteOnly | QFile::Text))
+        return;
+    QTextStream os(&out);
+    os << "boomerang-signature-index 1 " << QString(key) << "\n";
+    for (const QString &s : sigs)
+        os << "s " << s << "\n";
+    for (const QString &t : Type::getNamedTypeNames())
+        if (known.find(t) == known.end())
+            os << "t " << t << "\n";
+    os.flush();
+    out.commit();
+}
+
+//! Read the signature file \a idx of signatureFiles, if it has not been read yet
+void FrontEnd::readSignatureFile(int idx) {
+    SignatureFile &file(signatureFiles[idx]);
+    if (file.read)
+        return;
+    file.read = true;
+    readingSignatures = true;
+    readLibrarySignatures(qPrintable(file.path), file.cc);
+    readingSignatures = false;
+    for (auto it = pendingSignatures.begin(); it != pendingSignatures.end();) {
+        if (it.value() == idx)
+            it = pendingSignatures.erase(it);
+        else
+            ++it;
+    }
+    for (auto it = pendingTypes.begin(); it != pendingTypes.end();) {
+        if (it.value() == idx)
+            it = pendingTypes.erase(it);
+        else
+            ++it;
+    }
+}
+
+/***************************************************************************/ /**
+  * \brief   Called by Type::getNamedType() for a type it does not know: read the signature file defining \a name
+  * \returns true if a file was read
+  ******************************************************************************/
+bool FrontEnd::resolveNamedType(const QString &name) {
+    if (readingSignatures)
+        return false; // Named types are looked up again by name when used, so the file will be read then
+    auto it = pendingTypes.find(name);
+    if (it == pendingTypes.end())
+        return false;
+    readSignatureFile(*it);
+    return true;
 }
 
 void FrontEnd::readLibraryCatalog() {
     // TODO: this is a work for generic semantics provider plugin : HeaderReader
     LibrarySignatures.clear();
+    compiledSignatures.clear();
+    signatureDatabases.clear();
+    signatureFiles.clear();
+    pendingSignatures.clear();
+    pendingTypes.clear();
+    fingerprints.clear();
     QDir sig_dir(Boomerang::get()->getProgPath());
     if(!sig_dir.cd("signatures")) {
         qWarning("Signatures directory does not exist.");
         return;
     }
+    fingerprints.read(sig_dir.absoluteFilePath(Signature::platformName(getFrontEndId()) + ".pat"));
     QString sList = sig_dir.absoluteFilePath("common.hs");
 
     readLibraryCatalog(sList);
@@ -261,12 +403,14 @@ std::vector<ADDRESS> FrontEnd::getEntryPoints() {
 
 void FrontEnd::decode(Prog *prg, bool decodeMain, const char *pname) {
     assert(Program == prg);
+    ContextScope inContext(Program->getContext());
+    StatScope stats(nullptr, "decode");
     if (pname)
         Program->setName(pname);
 
     if (!decodeMain)
         return;
-    Boomerang::get()->alertStartDecode(Image->getLimitTextLow(),
+    Program->getContext()->alertStartDecode(Image->getLimitTextLow(),
                                          (Image->getLimitTextHigh() - Image->getLimitTextLow()).m_value);
 
     bool gotMain;
@@ -276,11 +420,13 @@ void FrontEnd::decode(Prog *prg, bool decodeMain, const char *pname) {
         std::vector<ADDRESS> entrypoints = getEntryPoints();
         for (auto &entrypoint : entrypoints)
             decode(Program, entrypoint);
+        Program->getContext()->alertEndDecode();
         return;
     }
 
     decode(Program, a);
     Program->setEntryPoint(a);
+    Program->getContext()->alertEndDecode();
 
     if (not gotMain)
         return;
@@ -301,7 +447,7 @@ void FrontEnd::decode(Prog *prg, bool decodeMain, const char *pname) {
             LOG << "unable to find signature for known entrypoint " << name << "\n";
         else {
             proc->setSignature(fty->getSignature()->clone());
-            proc->getSignature()->setName(name);
+            proc->setName(name);
             // proc->getSignature()->setFullSig(true);        // Don't add or remove parameters
             proc->getSignature()->setForced(true); // Don't add or remove parameters
         }
@@ -312,6 +458,7 @@ void FrontEnd::decode(Prog *prg, bool decodeMain, const char *pname) {
 // Somehow, a == NO_ADDRESS has come to mean decode anything not already decoded
 void FrontEnd::decode(Prog *prg, ADDRESS a) {
     assert(Program == prg);
+    ContextScope inContext(Program->getContext());
     if (a != NO_ADDRESS) {
         Program->setNewProc(a);
         LOG_VERBOSE(1) << "starting decode at address " << a << "\n";
@@ -329,39 +476,85 @@ void FrontEnd::decode(Prog *prg, ADDRESS a) {
         p->setDecoded();
 
     } else { // a == NO_ADDRESS
+        Program->makeObjcClasses();
+        if (Program->getContext()->scanPrologues)
+            scanForPrologues();
+        // Queue the undecoded procs, then decode from the queue; the callees found on the way are queued by
+        // Prog::setNewProc, so the procs are not all scanned again after each one. A last scan catches procs made
+        // some other way.
+        std::set<UserProc *> failed; // Not retried
         bool change = true;
         while (change) {
             change = false;
-
-            for ( Module *m : *Program) {
-                for (Function *pProc : *m) {
-                    if (pProc->isLib())
-                        continue;
-                    UserProc *p = (UserProc *)pProc;
-                    if (p->isDecoded())
-                        continue;
-                    // undecoded userproc.. decode it
-                    change = true;
-                    QTextStream os(stderr); // rtl output target
-                    int res = processProc(p->getNativeAddress(), p, os);
-                    if (res != 1)
-                        break;
-                    p->setDecoded();
-                    // Break out of the loops if not decoding children
-                    if (Boomerang::get()->noDecodeChildren)
-                        break;
+            for (Module *m : *Program)
+                for (Function *pProc : *m)
+                    if (!pProc->isLib() && !((UserProc *)pProc)->isDecoded() && failed.count((UserProc *)pProc) == 0)
+                        Program->queueForDecode(pProc->getNativeAddress());
+
+            ADDRESS next;
+            while (Program->nextToDecode(next)) {
+                Function *pProc = Program->findProc(next);
+                if (pProc == nullptr || pProc == (Function *)-1 || pProc->isLib())
+                    continue;
+                UserProc *p = (UserProc *)pProc;
+                if (p->isDecoded() || failed.count(p))
+                    continue;
+                // undecoded userproc.. decode it
+                change = true;
+                QTextStream os(stderr); // rtl output target
+                if (!processProc(p->getNativeAddress(), p, os)) {
+                    failed.insert(p);
+                    continue;
+                }
+                p->setDecoded();
+                // Stop after the first if not decoding children
+                if (Program->getContext()->noDecodeChildren) {
+                    Program->wellForm();
+                    return;
                 }
             }
-            if (Boomerang::get()->noDecodeChildren)
-                break;
         }
     }
     Program->wellForm();
 }
 
+/***************************************************************************/ /**
+  * \brief   Sweep the code sections for the prologues the decoder recognises (NJMCDecoder::isFuncPrologue), and make
+  * a new proc, queued for decoding, at each one where there is none yet. This finds the procedures that are only
+  * reached through pointers or tables, or not at all, which following the calls from the entry points misses.
+  *
+  * A match is only a guess: it may be data in the code section, or the middle of a longer instruction. That is why
+  * the sweep is left to the --scan-prologues switch.
+  * \returns the number of procs made
+  ******************************************************************************/
+int FrontEnd::scanForPrologues() {
+    StatScope stats(nullptr, "prologue scan");
+    int step = decoder->getInstructionAlignment();
+    int found = 0;
+    for (IBinarySection *sect : *Image) {
+        if (!sect->isCode() || sect->hostAddr().isZero() || ".plt" == sect->getName())
+            continue;
+        ADDRESS from = sect->sourceAddr();
+        uint32_t start = (step - from.m_value % step) % step;
+        for (uint32_t off = start; off + 4 <= sect->size(); off += step) {
+            ADDRESS addr = from + off;
+            if (sect->isAddressBss(addr) || !decoder->isFuncPrologue(sect->hostAddr() + off))
+                continue;
+            if (Program->findProc(addr) != nullptr)
+                continue; // Known already, or decoded and deleted
+            Program->setNewProc(addr);
+            ++found;
+        }
+    }
+    LOG_VERBOSE(1) << "found " << found << " new procs by their prologues\n";
+    DecompileStats::get().count(nullptr, "prologue scan", "procs found", found);
+    return found;
+}
+
 //! \a a should be the address of an UserProc
 void FrontEnd::decodeOnly(Prog *prg, ADDRESS a) {
     assert(Program == prg);
+    ContextScope inContext(Program->getContext());
     UserProc *p = (UserProc *)Program->setNewProc(a);
     assert(!p->isLib());
     QTextStream os(stderr); // rtl output target
@@ -371,32 +564,142 @@ void FrontEnd::decodeOnly(Prog *prg, ADDRESS a) {
 }
 
 void FrontEnd::decodeFragment(UserProc *proc, ADDRESS a) {
-    if (Boomerang::get()->traceDecoder)
+    if (Program->getContext()->traceDecoder)
         LOG << "decoding fragment at 0x" << a << "\n";
     QTextStream os(stderr); // rtl output target
     processProc(a, proc, os, true);
 }
 
 DecodeResult &FrontEnd::decodeInstruction(ADDRESS pc) {
-    if (!Image || Image->getSectionInfoByAddr(pc) == nullptr) {
+    const IBinarySection *pSect = Image ? Image->getSectionInfoByAddr(pc) : nullptr;
+    if (pSect == nullptr) {
         LOG << "ERROR: attempted to decode outside any known section " << pc << "\n";
         static DecodeResult invalid;
         invalid.reset();
         invalid.valid = false;
         return invalid;
     }
-    const IBinarySection *pSect = Image->getSectionInfoByAddr(pc);
+    if (Image->getWriteCount() != decodeCacheWriteCount) {
+        clearDecodeCache();
+        decodeCacheWriteCount = Image->getWriteCount();
+    }
+    auto found = decodeCache.find(pc);
+    if (found != decodeCache.end()) {
+        // Hand out a copy: the caller owns the RTL it gets, and may well change it
+        static DecodeResult cached;
+        cached.reset();
+        cached.numBytes = found->second.numBytes;
+        cached.rtl = found->second.rtl->clone();
+        cached.type = (ICLASS)found->second.type;
+        cached.forceOutEdge = found->second.forceOutEdge;
+        DecompileStats::get().count(nullptr, "decode", "cached instructions");
+        return cached;
+    }
     ptrdiff_t host_native_diff = (pSect->hostAddr() - pSect->sourceAddr()).m_value;
-    return decoder->decodeInstruction(pc, host_native_diff);
+    DecodeResult &res(decoder->decodeInstruction(pc, host_native_diff));
+    // An instruction decoded in several steps (e.g. pentium BSF/BSR) gives a different result each time: never cache it
+    if (res.reDecode)
+        uncachedDecodes.insert(pc);
+    else if (res.valid && res.rtl && uncachedDecodes.find(pc) == uncachedDecodes.end())
+        cacheDecode(pc, res);
+    return res;
+}
+
+void FrontEnd::cacheDecode(ADDRESS pc, const DecodeResult &res) {
+    ArenaScope onHeap(nullptr); // The cache outlives the proc being decoded
+    decodeCache[pc] = CachedDecode{res.numBytes, res.rtl->clone(), res.type, res.forceOutEdge};
 }
 
 /***************************************************************************/ /**
   *
-  * \brief       Read the library signatures from a file
+  * \brief   Decode the straight-line run of instructions at \a pc into \a results, as NJMCDecoder::decodeRun does:
+  *          at most \a max of them, ending with the first that transfers control. Instructions in the decode cache
+  *          are taken from it; the others are decoded a run at a time, rather than with a call to the decoder each.
+  * \returns how many results there are; always at least one
+  *
+  ******************************************************************************/
+int FrontEnd::decodeRun(ADDRESS pc, DecodeResult *results, int max) {
+    const IBinarySection *pSect = Image ? Image->getSectionInfoByAddr(pc) : nullptr;
+    if (pSect == nullptr) {
+        results[0] = decodeInstruction(pc); // The invalid instruction
+        return 1;
+    }
+    if (Image->getWriteCount() != decodeCacheWriteCount) {
+        clearDecodeCache();
+        decodeCacheWriteCount = Image->getWriteCount();
+    }
+    ptrdiff_t host_native_diff = (pSect->hostAddr() - pSect->sourceAddr()).m_value;
+    ADDRESS limit = pSect->sourceAddr() + pSect->size();
+    int n = 0;
+    while (n < max && pc < limit) {
+        int got = 1;
+        if (decodeCache.find(pc) != decodeCache.end() || uncachedDecodes.find(pc) != uncachedDecodes.end()) {
+            results[n] = decodeInstruction(pc);
+            pc += results[n].numBytes;
+        } else {
+            got = decoder->decodeRun(pc, host_native_diff, limit, results + n, max - n);
+            for (int i = n; i < n + got; i++) {
+                const DecodeResult &res(results[i]);
+                if (res.reDecode)
+                    uncachedDecodes.insert(pc);
+                else if (res.valid && res.rtl)
+                    cacheDecode(pc, res);
+                pc += res.numBytes;
+            }
+        }
+        n += got;
+        if (NJMCDecoder::endsRun(results[n - 1]))
+            break;
+    }
+    return n;
+}
+
+void FrontEnd::clearDecodeCache() {
+    for (auto &elem : decodeCache)
+        delete elem.second.rtl;
+    decodeCache.clear();
+    uncachedDecodes.clear();
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief       Read the library signatures from a file. With warmCaches (or --prefetch), the file is parsed once per
+  *              process (see parseSignatureFile()), and this front end gets copies of its signatures and named types
   * \param       sPath The file to read from
   * \param       cc the calling convention assumed
+  * \param       names if given, the names of the signatures read are appended to it
   */
-void FrontEnd::readLibrarySignatures(const char *sPath, callconv cc) {
+void FrontEnd::readLibrarySignatures(const char *sPath, callconv cc, QStringList *names) {
+    if (useParsedSignatureFiles()) {
+        const ParsedSignatureFile &file(parseSignatureFile(sPath, getFrontEndId(), cc));
+        for (const std::pair<QString, SharedType> &t : file.types)
+            Type::addNamedType(t.first, t.second->clone());
+        for (Signature *sig : file.signatures) {
+            Signature *copy = sig->clone();
+            copy->setSigFile(sPath);
+            LibrarySignatures[copy->getName()] = copy;
+            if (names)
+                names->append(copy->getName());
+        }
+        return;
+    }
+    if (Boomerang::get()->signatureDatabases) {
+        // Use the database compiled from the file, compiling it first if there is none or it is stale
+        if (readSignatureDatabase(sPath, cc, names))
+            return;
+        ParsedSignatureFile file;
+        parseSignatureFile(sPath, getFrontEndId(), cc, file);
+        writeSignatureDatabase(sPath, getFrontEndId(), cc, file);
+        for (const std::pair<QString, SharedType> &t : file.types)
+            Type::addNamedType(t.first, t.second);
+        for (Signature *sig : file.signatures) {
+            LibrarySignatures[sig->getName()] = sig;
+            compiledSignatures.remove(sig->getName());
+            if (names)
+                names->append(sig->getName());
+        }
+        return;
+    }
     std::ifstream ifs;
 
     ifs.open(sPath);
@@ -410,6 +713,7 @@ void FrontEnd::readLibrarySignatures(const char *sPath, callconv cc) {
 
     platform plat = getFrontEndId();
     p->yyparse(plat, cc);
+    p->defineNamedTypes();
 
     for (auto &elem : p->signatures) {
 #if 0
@@ -417,12 +721,221 @@ void FrontEnd::readLibrarySignatures(const char *sPath, callconv cc) {
 #endif
         LibrarySignatures[(elem)->getName()] = elem;
         (elem)->setSigFile(sPath);
+        if (names)
+            names->append(elem->getName());
     }
 
     delete p;
     ifs.close();
 }
 
+std::map<QString, FrontEnd::ParsedSignatureFile> FrontEnd::parsedSignatureFiles;
+
+//! The key of parsedSignatureFiles for the file \a path parsed for \a plat and \a cc
+static QString parsedSignatureKey(const QString &path, platform plat, callconv cc) {
+    return QDir::cleanPath(QFileInfo(path).absoluteFilePath()) + "," + QString::number((int)plat) + "," +
+           QString::number((int)cc);
+}
+
+//! Make the expressions of the parameters and returns of \a sig the nodes of the ExpTable; see parseSignatureFile()
+static void internExps(Signature *sig) {
+    ExpTable &table(ExpTable::get());
+    for (int i = 0; i < (int)sig->getNumParams(); i++)
+        sig->setParamExp(i, table.intern(sig->getParamExp(i)));
+    for (size_t i = 0; i < sig->getNumReturns(); i++)
+        sig->setReturnExp(i, table.intern(sig->getReturnExp(i)));
+}
+
+/***************************************************************************/ /**
+  * \brief   Parse the signature file \a path for \a plat and \a cc into \a file. The parser keeps what it reads to
+  * itself, named types included, so this may run on several threads at once.
+  *
+  * The signatures of \a file are only ever cloned, so with the ExpTable enabled (-ie) their expressions are interned:
+  * the many signatures with a parameter at m[r28 + 4] share its nodes. The files are then parsed on one thread (see
+  * getParseWorkers()), as the table has no lock.
+  ******************************************************************************/
+void FrontEnd::parseSignatureFile(const QString &path, platform plat, callconv cc, ParsedSignatureFile &file) {
+    std::ifstream ifs(qPrintable(path));
+    if (!ifs.good()) {
+        LOG_STREAM() << "can't open `" << path << "'\n";
+        exit(1);
+    }
+    AnsiCParser *p = new AnsiCParser(ifs, false);
+    p->yyparse(plat, cc);
+    bool intern = ExpTable::get().isEnabled();
+    for (Signature *sig : p->signatures) {
+        sig->setSigFile(path);
+        if (intern)
+            internExps(sig);
+        file.signatures.push_back(sig);
+    }
+    file.types = p->namedTypes;
+    delete p;
+}
+
+/***************************************************************************/ /**
+  * \brief   The signature file \a path as parsed for \a plat and \a cc, parsed now if no front end has read it yet
+  * in this process. The front ends reading it add copies of what it defines (see readLibrarySignatures()), so that one
+  * program's types don't leak into the next.
+  ******************************************************************************/
+const FrontEnd::ParsedSignatureFile &FrontEnd::parseSignatureFile(const QString &path, platform plat, callconv cc) {
+    QString key = parsedSignatureKey(path, plat, cc);
+    auto found = parsedSignatureFiles.find(key);
+    if (found != parsedSignatureFiles.end())
+        return found->second;
+    ParsedSignatureFile &file(parsedSignatureFiles[key]);
+    parseSignatureFile(path, plat, cc, file);
+    return file;
+}
+
+/***************************************************************************/ /**
+  * \brief   The signature files a front end for \a plat may read, from the catalogs of the signatures directory;
+  * none if \a plat has no catalog of its own
+  ******************************************************************************/
+std::vector<std::pair<QString, callconv>> FrontEnd::getPlatformSignatureFiles(platform plat) {
+    std::vector<std::pair<QString, callconv>> files;
+    QDir sig_dir(Boomerang::get()->getProgPath());
+    if (!sig_dir.cd("signatures"))
+        return files;
+    QString platformCatalog = Signature::platformName(plat) + ".hs";
+    if (!sig_dir.exists(platformCatalog))
+        return files;
+    QStringList catalogs{"common.hs", platformCatalog};
+    if (plat == PLAT_PENTIUM)
+        catalogs << "win32.hs";
+    if (plat == PLAT_PENTIUM || plat == PLAT_PPC)
+        catalogs << "objc.hs"; // The platforms of Mach-O
+    for (const QString &catalog : catalogs) {
+        if (!sig_dir.exists(catalog))
+            continue;
+        for (const std::pair<QString, callconv> &f : getCatalogFiles(sig_dir.absoluteFilePath(catalog)))
+            files.push_back(f);
+    }
+    return files;
+}
+
+/***************************************************************************/ /**
+  * \brief   Parse the signature files of the catalogs of every platform that has one, for warmCaches: a process
+  * that decompiles many programs (see CommandlineDriver::server) does this once, and its front ends then only copy
+  * what they need. A task parsing each file is added to \a scheduler, which the caller runs (with getParseWorkers()
+  * workers).
+  ******************************************************************************/
+void FrontEnd::preloadSignatures(TaskScheduler &scheduler) {
+    // The entries of parsedSignatureFiles are made here, before the scheduler runs: the tasks only fill them in
+    for (int i = PLAT_PENTIUM; i < PLAT_GENERIC; i++) {
+        platform plat = (platform)i;
+        for (const std::pair<QString, callconv> &f : getPlatformSignatureFiles(plat)) {
+            QString key = parsedSignatureKey(f.first, plat, f.second);
+            if (parsedSignatureFiles.find(key) != parsedSignatureFiles.end())
+                continue;
+            QString path = f.first;
+            callconv cc = f.second;
+            ParsedSignatureFile *file = &parsedSignatureFiles[key];
+            scheduler.add("parse signatures", [path, plat, cc, file]() { parseSignatureFile(path, plat, cc, *file); });
+        }
+    }
+}
+
+//! The number of workers the SSL and signature files may be parsed on: one per core, unless expressions are interned
+//! or simplifications cached (-ie, -is), as the ExpTable and the SimplifyCache are not shared safely between threads
+unsigned FrontEnd::getParseWorkers() {
+    return ExpTable::get().isEnabled() || SimplifyCache::get().isEnabled() ? 1 : 0;
+}
+
+//! Whether the signature files are read through parsedSignatureFiles: with warmCaches, and with --prefetch unless they
+//! come from indexes or databases instead (--lazy-sigs, --sig-db), which a prefetch would defeat
+bool FrontEnd::useParsedSignatureFiles() {
+    Boomerang &boom(*Boomerang::get());
+    return boom.warmCaches || (boom.prefetch && !boom.lazySignatures && !boom.signatureDatabases);
+}
+
+namespace {
+//! The name of the front end for \a machine, as in the path of its SSL file, setting \a plat to its platform; null
+//! for a machine with no front end
+const char *frontEndName(MACHINE machine, platform &plat) {
+    const char *name = nullptr;
+    switch (machine) {
+    case MACHINE_PENTIUM:
+        name = "pentium";
+        plat = PLAT_PENTIUM;
+        break;
+    case MACHINE_SPARC:
+        name = "sparc";
+        plat = PLAT_SPARC;
+        break;
+    case MACHINE_PPC:
+        name = "ppc";
+        plat = PLAT_PPC;
+        break;
+    case MACHINE_MIPS:
+        name = "mips";
+        plat = PLAT_MIPS;
+        break;
+    case MACHINE_ST20:
+        name = "st20";
+        plat = PLAT_ST20;
+        break;
+    default:
+        break;
+    }
+    return name;
+}
+}
+
+//! The SSL file of the front end for \a machine; empty for a machine with no front end
+QString FrontEnd::getSSLFileName(MACHINE machine) {
+    platform plat = PLAT_GENERIC;
+    const char *name = frontEndName(machine, plat);
+    if (name == nullptr)
+        return QString();
+    QDir base_dir = Boomerang::get()->getProgDir();
+    return base_dir.absoluteFilePath(QString("frontend/machine/%1/%1.ssl").arg(name));
+}
+
+/***************************************************************************/ /**
+  * \brief   Add to \a scheduler a task reading each of the signature files of the catalogs that the front end for
+  * \a machine reads for a binary of \a format, into parsedSignatureFiles, the cache that warmCaches keeps. The caller
+  * runs the tasks before making the front end. Nothing is added for a machine with no front end, nor when the files
+  * are to be parsed on one thread (see getParseWorkers()).
+  *
+  * The SSL file is not read here: the front end parses it into the dictionary of its decoder, and a copy parsed here
+  * could only reach that through a cache image, which costs about as much to write and read back as the parse.
+  * A file that is missing is left to the front end to complain about.
+  ******************************************************************************/
+void FrontEnd::prefetch(MACHINE machine, LOAD_FMT format, TaskScheduler &scheduler) {
+    platform plat = PLAT_GENERIC;
+    if (frontEndName(machine, plat) == nullptr || getParseWorkers() == 1)
+        return;
+    if (!useParsedSignatureFiles())
+        return;
+    QDir base_dir = Boomerang::get()->getProgDir();
+
+    // The catalogs readLibraryCatalog() will read. The entries of parsedSignatureFiles are made here, so that the
+    // tasks only fill them in
+    QDir sig_dir(base_dir);
+    if (!sig_dir.cd("signatures"))
+        return;
+    QStringList catalogs{"common.hs", Signature::platformName(plat) + ".hs"};
+    if (format == LOADFMT_PE)
+        catalogs << "win32.hs";
+    if (format == LOADFMT_MACHO)
+        catalogs << "objc.hs";
+    for (const QString &catalog : catalogs) {
+        if (!sig_dir.exists(catalog))
+            continue;
+        for (const std::pair<QString, callconv> &f : getCatalogFiles(sig_dir.absoluteFilePath(catalog))) {
+            QString key = parsedSignatureKey(f.first, plat, f.second);
+            if (!QFile::exists(f.first) || parsedSignatureFiles.find(key) != parsedSignatureFiles.end())
+                continue;
+            QString path = f.first;
+            callconv cc = f.second;
+            ParsedSignatureFile *file = &parsedSignatureFiles[key];
+            scheduler.add("prefetch signatures",
+                          [path, plat, cc, file]() { parseSignatureFile(path, plat, cc, *file); });
+        }
+    }
+}
+
 Signature *FrontEnd::getDefaultSignature(const QString &name) {
     Signature *signature = nullptr;
     // Get a default library signature
@@ -437,6 +950,16 @@ Signature *FrontEnd::getDefaultSignature(const QString &name) {
 // get a library signature by name
 Signature *FrontEnd::getLibSignature(const QString &name) {
     Signature *signature;
+    auto pending = pendingSignatures.find(name);
+    if (pending != pendingSignatures.end())
+        readSignatureFile(*pending);
+    auto compiled = compiledSignatures.find(name);
+    if (compiled != compiledSignatures.end()) {
+        Signature *sig = readCompiledSignature(compiled->first, compiled->second);
+        compiledSignatures.erase(compiled);
+        if (sig)
+            LibrarySignatures[name] = sig;
+    }
     // Look up the name in the librarySignatures map
     auto it = LibrarySignatures.find(name);
     if (it == LibrarySignatures.end()) {
@@ -456,8 +979,7 @@ void FrontEnd::preprocessProcGoto(std::list<Instruction *>::iterator ss, ADDRESS
         return;
     Function *proc = Program->findProc(dest);
     if (proc == nullptr) {
-        auto symb = BinarySymbols->find(dest);
-        if (symb && symb->isImportedFunction())
+        if (BinarySymbols->findImportedFunction(dest))
             proc = Program->setNewProc(dest);
     }
     if (proc != nullptr && proc != (Function *)-1) {
@@ -476,13 +998,42 @@ void FrontEnd::preprocessProcGoto(std::list<Instruction *>::iterator ss, ADDRESS
 }
 bool FrontEnd::refersToImportedFunction(Exp *pDest)
 {
-    if(pDest && pDest->getOper() == opMemOf && pDest->getSubExp1()->getOper() == opIntConst) {
-        auto symbol = BinarySymbols->find(((Const *)pDest->getSubExp1())->getAddr());
-        if(symbol && symbol->isImportedFunction())
-            return true;
+    return pDest && pDest->getOper() == opMemOf && pDest->getSubExp1()->getOper() == opIntConst &&
+           BinarySymbols->findImportedFunction(((Const *)pDest->getSubExp1())->getAddr()) != nullptr;
+}
+
+namespace {
+//! The instructions of a straight-line run decoded ahead by FrontEnd::decodeRun, handed out to processProc one at a
+//! time. Those not taken (decoding went somewhere else) are deleted
+class DecodedRun {
+    static const int LENGTH = 16;
+    FrontEnd &fe;
+    DecodeResult results[LENGTH];
+    int pos = 0;
+    int len = 0;
+    ADDRESS next = NO_ADDRESS; //!< The address of results[pos]
+
+  public:
+    DecodedRun(FrontEnd &fe) : fe(fe) {}
+    ~DecodedRun() { discard(); }
+
+    DecodeResult &take(ADDRESS pc) {
+        if (pos == len || pc != next) {
+            discard();
+            len = fe.decodeRun(pc, results, LENGTH);
+            next = pc;
+        }
+        next += results[pos].numBytes;
+        return results[pos++];
+    }
+    void discard() {
+        for (; pos < len; pos++)
+            delete results[pos].rtl;
+        pos = len = 0;
     }
-    return false;
+};
 }
+
 /***************************************************************************/ /**
   *
   * \brief      Process a procedure, given a native (source machine) address.
@@ -498,9 +1049,11 @@ bool FrontEnd::refersToImportedFunction(Exp *pDest)
 bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/, bool /*frag*/ /* = false */,
                            bool spec /* = false */) {
     BasicBlock *pBB; // Pointer to the current basic block
+    ArenaScope inArena(pProc->getArena()); // The decoded RTLs belong to pProc
+    StatScope stats(pProc, "decode");
 
     // just in case you missed it
-    Boomerang::get()->alertNew(pProc);
+    Program->getContext()->alertNew(pProc);
 
     // We have a set of CallStatement pointers. These may be disregarded if this is a speculative decode
     // that fails (i.e. an illegal instruction is found). If not, this set will be used to add to the set of calls
@@ -519,8 +1072,11 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
     assert(pCfg);
 
     // Initialise the queue of control flow targets that have yet to be decoded.
+    targetQueue.setTextLimits(Image->getLimitTextLow(), Image->getLimitTextHigh());
     targetQueue.initial(uAddr);
 
+    DecodedRun run(*this);
+
     // Clear the pointer used by the caller prologue code to access the last call rtl of this procedure
     // decoder.resetLastCall();
 
@@ -538,11 +1094,11 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
         while (sequentialDecode) {
 
             // Decode and classify the current source instruction
-            if (Boomerang::get()->traceDecoder)
+            if (Program->getContext()->traceDecoder)
                 LOG << "*" << uAddr << "\t";
 
-            // Decode the inst at uAddr.
-            inst = decodeInstruction(uAddr);
+            // Decode the inst at uAddr; the instructions after it up to the next control transfer are decoded with it
+            inst = run.take(uAddr);
             if(!inst.valid || inst.rtl->empty()) {
                 qDebug() << "Valid but undecoded instruction at " << QString::number(uAddr.m_value,16);
             }
@@ -559,7 +1115,7 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
             RTL *pRtl = inst.rtl;
             if (inst.valid == false) {
                 // Alert the watchers to the problem
-                Boomerang::get()->alertBadDecode(uAddr);
+                Program->getContext()->alertBadDecode(uAddr);
 
                 // An invalid instruction. Most likely because a call did not return (e.g. call _exit()), etc.
                 // Best thing is to emit a INVALID BB, and continue with valid instructions
@@ -579,8 +1135,9 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
             }
 
             // alert the watchers that we have decoded an instruction
-            Boomerang::get()->alertDecode(uAddr, inst.numBytes);
+            Program->getContext()->alertDecode(uAddr, inst.numBytes);
             nTotalBytes += inst.numBytes;
+            pProc->addDecodedInsn(uAddr, inst.numBytes);
 
             // Check if this is an already decoded jump instruction (from a previous pass with propagation etc)
             // If so, we throw away the just decoded RTL (but we still may have needed to calculate the number
@@ -598,7 +1155,7 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
             }
 
             // Display RTL representation if asked
-            if (Boomerang::get()->printRtl) {
+            if (Program->getContext()->printRtl) {
                 QString tgt;
                 QTextStream st(&tgt);
                 pRtl->print(st);
@@ -693,8 +1250,8 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
                         LOG_VERBOSE(1) << "jump to a library function: " << stmt_jump << ", replacing with a call/ret.\n";
                         // jump to a library function
                         // replace with a call ret
-                        auto *sym = BinarySymbols->find(((Const *)pDest->getSubExp1())->getAddr());
-                        assert(sym==nullptr);
+                        auto *sym = BinarySymbols->findImportedFunction(((Const *)pDest->getSubExp1())->getAddr());
+                        assert(sym);
                         QString func = sym->getName();
                         CallStatement *call = new CallStatement;
                         call->setDest(pDest->clone());
@@ -716,7 +1273,7 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
                             func = "__imp_" + func;
                             pProc->setName(func);
                             // lp->setName(func.c_str());
-                            Boomerang::get()->alertUpdateSignature(pProc);
+                            Program->getContext()->alertUpdateSignature(pProc);
                         }
                         callList.push_back(call);
                         ss = sl.end();
@@ -727,7 +1284,7 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
                     // We create the BB as a COMPJUMP type, then change to an NWAY if it turns out to be a switch stmt
                     pBB = pCfg->newBB(BB_rtls, BBTYPE::COMPJUMP, 0);
                     LOG << "COMPUTED JUMP at " << uAddr << ", pDest = " << pDest << "\n";
-                    if (Boomerang::get()->noDecompile) {
+                    if (Program->getContext()->noDecompile) {
                         // try some hacks
                         if (pDest->isMemOf() && pDest->getSubExp1()->getOper() == opPlus &&
                             pDest->getSubExp1()->getSubExp2()->isIntConst()) {
@@ -786,7 +1343,7 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
                     if (refersToImportedFunction(call->getDest())) {
                         // Dynamic linked proc pointers are treated as static.
                         ADDRESS linked_addr = ((Const *)call->getDest()->getSubExp1())->getAddr();
-                        QString nam = BinarySymbols->find(linked_addr)->getName();
+                        QString nam = BinarySymbols->findImportedFunction(linked_addr)->getName();
                         Function *p = pProc->getProg()->getLibraryProc(nam);
                         call->setDestProc(p);
                         call->setIsComputed(false);
@@ -815,7 +1372,7 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
                                         refersToImportedFunction(stmt_jump->getDest())) { // Is it an "DynamicLinkedProcPointer"?
                                         // Yes, it's a library function. Look up it's name.
                                         ADDRESS a = ((Const *)stmt_jump->getDest()->getSubExp1())->getAddr();
-                                        QString nam = BinarySymbols->find(a)->getName();
+                                        QString nam = BinarySymbols->findImportedFunction(a)->getName();
                                         // Assign the proc to the call
                                         Function *p = pProc->getProg()->getLibraryProc(nam);
                                         if (call->getDestProc()) {
@@ -873,7 +1430,7 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
                             pProc->getProg()->findProc(uNewAddr) == nullptr) {
                             callList.push_back(call);
                             // newProc(pProc->getProg(), uNewAddr);
-                            if (Boomerang::get()->traceDecoder)
+                            if (Program->getContext()->traceDecoder)
                                 LOG << "p" << uNewAddr << "\t";
                         }
 
@@ -882,7 +1439,7 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
                         QString name = Program->symbolByAddress(uNewAddr);
                         if (name.isEmpty() && refersToImportedFunction(call->getDest())) {
                             ADDRESS a = ((Const *)call->getDest()->getSubExp1())->getAddr();
-                            name = BinarySymbols->find(a)->getName();
+                            name = BinarySymbols->findImportedFunction(a)->getName();
                         }
                         if (!name.isEmpty() && noReturnCallDest(name)) {
                             // Make sure it has a return appended (so there is only one exit from the function)
@@ -1004,10 +1561,9 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
     std::list<CallStatement *>::iterator it;
     for (it = callList.begin(); it != callList.end(); it++) {
         ADDRESS dest = (*it)->getFixedDest();
-        auto symb = BinarySymbols->find(dest);
         // Don't speculatively decode procs that are outside of the main text section, apart from dynamically
         // linked ones (in the .plt)
-        if ((symb && symb->isImportedFunction()) || !spec || (dest < Image->getLimitTextHigh())) {
+        if (BinarySymbols->findImportedFunction(dest) || !spec || (dest < Image->getLimitTextHigh())) {
             pCfg->addCall(*it);
             // Don't visit the destination of a register call
             Function *np = (*it)->getDestProc();
@@ -1022,7 +1578,7 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
         }
     }
 
-    Boomerang::get()->alertDecode(pProc, startAddr, lastAddr, nTotalBytes);
+    Program->getContext()->alertDecode(pProc, startAddr, lastAddr, nTotalBytes);
 
     if (VERBOSE)
         LOG << "finished processing proc " << pProc->getName() << " at address " << pProc->getNativeAddress() << "\n";
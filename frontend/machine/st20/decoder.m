@@ -40,6 +40,47 @@
 void ST20Decoder::unused(int x)
 {}
 
+namespace {
+//! OpcodeTable::Spec::flags of the secondary operations that return
+const unsigned RET = 1;
+
+//! The secondary operations (those of opr), by the operand the prefixes built up, with their names in st20.ssl
+const OpcodeTable::Spec SECONDARY_OPS[] = {
+	{0x00, "rev"}, {0x01, "lb"}, {0x02, "bsub"}, {0x03, "endp"}, {0x04, "diff"}, {0x05, "add"}, {0x06, "gcall"},
+	{0x07, "in"}, {0x08, "prod"}, {0x09, "gt"}, {0x0A, "wsub"}, {0x0B, "out"}, {0x0C, "sub"}, {0x0D, "startp"},
+	{0x0E, "outbyte"}, {0x0F, "outword"}, {0x10, "seterr"}, {0x12, "resetch"}, {0x13, "csub0"}, {0x15, "stopp"},
+	{0x16, "ladd"}, {0x17, "stlb"}, {0x18, "sthf"}, {0x19, "norm"}, {0x1A, "ldiv"}, {0x1B, "ldpi"}, {0x1C, "stlf"},
+	{0x1D, "xdble"}, {0x1E, "ldpri"}, {0x1F, "rem"}, {0x20, "ret", RET}, {0x21, "lend"}, {0x22, "ldtimer"},
+	{0x29, "testerr"}, {0x2A, "testpranal"}, {0x2B, "tin"}, {0x2C, "div"}, {0x2E, "dist"}, {0x2F, "disc"},
+	{0x30, "diss"}, {0x31, "lmul"}, {0x32, "not"}, {0x33, "xor"}, {0x34, "bcnt"}, {0x35, "lshr"}, {0x36, "lshl"},
+	{0x37, "lsum"}, {0x38, "lsub"}, {0x39, "runp"}, {0x3A, "xword"}, {0x3B, "sb"}, {0x3C, "gajw"}, {0x3D, "savel"},
+	{0x3E, "saveh"}, {0x3F, "wcnt"}, {0x40, "shr"}, {0x41, "shl"}, {0x42, "mint"}, {0x43, "alt"}, {0x44, "altwt"},
+	{0x45, "altend"}, {0x46, "and"}, {0x47, "enbt"}, {0x48, "enbc"}, {0x49, "enbs"}, {0x4A, "move"}, {0x4B, "or"},
+	{0x4C, "csngl"}, {0x4D, "ccnt1"}, {0x4E, "talt"}, {0x4F, "ldiff"}, {0x50, "sthb"}, {0x51, "taltwt"},
+	{0x52, "sum"}, {0x53, "mul"}, {0x54, "sttimer"}, {0x55, "stoperr"}, {0x56, "cword"}, {0x57, "clrhalterr"},
+	{0x58, "sethalterr"}, {0x59, "testhalterr"}, {0x5A, "dup"}, {0x5B, "move2dinit"}, {0x5C, "move2dall"},
+	{0x5D, "move2dnonzero"}, {0x5E, "move2dzero"}, {0x5F, "gtu"}, {0x63, "unpacksn"}, {0x64, "slmul"},
+	{0x65, "sulmul"}, {0x68, "satadd"}, {0x69, "satsub"}, {0x6A, "satmul"}, {0x6C, "postnormsn"}, {0x6D, "roundsn"},
+	{0x6E, "ldtraph"}, {0x6F, "sttraph"}, {0x71, "ldinf"}, {0x72, "fmul"}, {0x73, "cflerr"}, {0x74, "crcword"},
+	{0x75, "crcbyte"}, {0x76, "bitcnt"}, {0x77, "bitrevword"}, {0x78, "bitrevnbits"}, {0x79, "pop"},
+	{0x7E, "ldmemstartval"}, {0x81, "wsubdb"}, {0x9C, "fptesterr"}, {0xB0, "settimeslice"}, {0xB8, "xbword"},
+	{0xB9, "lbx"}, {0xBA, "cb"}, {0xBB, "cbu"}, {0xC1, "ssub"}, {0xC4, "intdis"}, {0xC5, "intenb"},
+	{0xC6, "ldtrapped"}, {0xC7, "cir"}, {0xC8, "ss"}, {0xCA, "ls"}, {0xCB, "sttrapped"}, {0xCC, "ciru"},
+	{0xCD, "gintdis"}, {0xCE, "gintenb"}, {0xF0, "devlb"}, {0xF1, "devsb"}, {0xF2, "devls"}, {0xF3, "devss"},
+	{0xF4, "devlw"}, {0xF5, "devsw"}, {0xF6, "null"}, {0xF7, "null"}, {0xF8, "xsword"}, {0xF9, "lsx"}, {0xFA, "cs"},
+	{0xFB, "csu"}, {0x17C, "lddevid"}
+};
+
+//! The secondary operations with a negative operand (after nfix), by its 1's complement above the bottom nibble
+const OpcodeTable::Spec NEGATIVE_OPS[] = {
+	{0x00, "swapqueue"}, {0x01, "swaptimer"}, {0x02, "insertqueue"}, {0x03, "timeslice"}, {0x04, "signal"},
+	{0x05, "wait"}, {0x06, "trapdis"}, {0x07, "trapenb"}, {0x0B, "tret", RET}, {0x0C, "ldshadow"},
+	{0x0D, "stshadow"}, {0x1F, "iret", RET}, {0x24, "devmove"}, {0x2E, "restart"}, {0x2F, "causeerror"},
+	{0x30, "nop"}, {0x4C, "stclock"}, {0x4D, "ldclock"}, {0x4E, "clockdis"}, {0x4F, "clockenb"}, {0x8C, "ldprodid"},
+	{0x8D, "reboot"}
+};
+}
+
 /*==============================================================================
  * FUNCTION:	   ST20Decoder::decodeInstruction
  * OVERVIEW:	   Decodes a machine instruction and returns an RTL instance. In all cases a single instruction is decoded.
@@ -94,182 +135,18 @@ DecodeResult& ST20Decoder::decodeInstruction (ADDRESS pc, int delta) {
 
 		| opr (oper) =>
 			total |= oper;
-			char* name = NULL;
-			bool isRet = false;
-			if (total >= 0) {
-				switch (total) {
-					case 0x00:	name = "rev";	break;
-					case 0x01: name = "lb";		break;
-					case 0x02: name = "bsub";	break;
-					case 0x03: name = "endp";	break;
-					case 0x04: name = "diff";	break;
-					case 0x05: name = "add";	break;
-					case 0x06: name = "gcall";	break;
-					case 0x07: name = "in";		break;
-					case 0x08: name = "prod";	break;
-					case 0x09: name = "gt";		break;
-					case 0x0A: name = "wsub";	break;
-					case 0x0B: name = "out";	break;
-					case 0x0C: name = "sub";	break;
-					case 0x0D: name = "startp";	break;
-					case 0x0E: name = "outbyte";break;
-					case 0x0F: name = "outword";break;
-					case 0x10: name = "seterr";	break;
-					case 0x12: name = "resetch";break;
-					case 0x13: name = "csub0";	break;
-					case 0x15: name = "stopp";	break;
-					case 0x16: name = "ladd";	break;
-					case 0x17: name = "stlb";	break;
-					case 0x18: name = "sthf";	break;
-					case 0x19: name = "norm";	break;
-					case 0x1A: name = "ldiv";	break;
-					case 0x1B: name = "ldpi";	break;
-					case 0x1C: name = "stlf";	break;
-					case 0x1D: name = "xdble";	break;
-					case 0x1E: name = "ldpri";	break;
-					case 0x1F: name = "rem";	break;
-					case 0x20: name = "ret"; isRet = true; break;
-					case 0x21: name = "lend";	break;
-					case 0x22: name = "ldtimer";break;
-					case 0x29: name = "testerr";break;
-					case 0x2A: name = "testpranal";break;
-					case 0x2B: name = "tin";	break;
-					case 0x2C: name = "div";	break;
-					case 0x2E: name = "dist";	break;
-					case 0x2F: name = "disc";	break;
-					case 0x30: name = "diss";	break;
-					case 0x31: name = "lmul";	break;
-					case 0x32: name = "not";	break;
-					case 0x33: name = "xor";	break;
-					case 0x34: name = "bcnt";	break;
-					case 0x35: name = "lshr";	break;
-					case 0x36: name = "lshl";	break;
-					case 0x37: name = "lsum";	break;
-					case 0x38: name = "lsub";	break;
-					case 0x39: name = "runp";	break;
-					case 0x3A: name = "xword";	break;
-					case 0x3B: name = "sb";		break;
-					case 0x3C: name = "gajw";	break;
-					case 0x3D: name = "savel";	break;
-					case 0x3E: name = "saveh";	break;
-					case 0x3F: name = "wcnt";	break;
-					case 0x40: name = "shr";	break;
-					case 0x41: name = "shl";	break;
-					case 0x42: name = "mint";	break;
-					case 0x43: name = "alt";	break;
-					case 0x44: name = "altwt";	break;
-					case 0x45: name = "altend";	break;
-					case 0x46: name = "and";	break;
-					case 0x47: name = "enbt";	break;
-					case 0x48: name = "enbc";	break;
-					case 0x49: name = "enbs";	break;
-					case 0x4A: name = "move";	break;
-					case 0x4B: name = "or";		break;
-					case 0x4C: name = "csngl";	break;
-					case 0x4D: name = "ccnt1";	break;
-					case 0x4E: name = "talt";	break;
-					case 0x4F: name = "ldiff";	break;
-					case 0x50: name = "sthb";	break;
-					case 0x51: name = "taltwt";	break;
-					case 0x52: name = "sum";	break;
-					case 0x53: name = "mul";	break;
-					case 0x54: name = "sttimer";break;
-					case 0x55: name = "stoperr";break;
-					case 0x56: name = "cword";	break;
-					case 0x57: name = "clrhalterr";	break;
-					case 0x58: name = "sethalterr";	break;
-					case 0x59: name = "testhalterr";break;
-					case 0x5A: name = "dup";		break;
-					case 0x5B: name = "move2dinit";	break;
-					case 0x5C: name = "move2dall";	break;
-					case 0x5D: name = "move2dnonzero";break;
-					case 0x5E: name = "move2dzero";	break;
-					case 0x5F: name = "gtu";		break;
-					case 0x63: name = "unpacksn";	break;
-					case 0x64: name = "slmul";		break;
-					case 0x65: name = "sulmul";		break;
-					case 0x68: name = "satadd";		break;
-					case 0x69: name = "satsub";		break;
-					case 0x6A: name = "satmul";		break;
-					case 0x6C: name = "postnormsn";	break;
-					case 0x6D: name = "roundsn";	break;
-					case 0x6E: name = "ldtraph";	break;
-					case 0x6F: name = "sttraph";	break;
-					case 0x71: name = "ldinf";		break;
-					case 0x72: name = "fmul";		break;
-					case 0x73: name = "cflerr";		break;
-					case 0x74: name = "crcword";	break;
-					case 0x75: name = "crcbyte";	break;
-					case 0x76: name = "bitcnt";		break;
-					case 0x77: name = "bitrevword";	break;
-					case 0x78: name = "bitrevnbits";break;
-					case 0x79: name = "pop";		break;
-					case 0x7E: name = "ldmemstartval";break;
-					case 0x81: name = "wsubdb";		break;
-					case 0x9C: name = "fptesterr";	break;
-					case 0xB0: name = "settimeslice";break;
-					case 0xB8: name = "xbword";		break;
-					case 0xB9: name = "lbx";		break;
-					case 0xBA: name = "cb";			break;
-					case 0xBB: name = "cbu";		break;
-					case 0xC1: name = "ssub";		break;
-					case 0xC4: name = "intdis";		break;
-					case 0xC5: name = "intenb";		break;
-					case 0xC6: name = "ldtrapped";	break;
-					case 0xC7: name = "cir";		break;
-					case 0xC8: name = "ss";			break;
-					case 0xCA: name = "ls";			break;
-					case 0xCB: name = "sttrapped";	break;
-					case 0xCC: name = "ciru";		break;
-					case 0xCD: name = "gintdis";	break;
-					case 0xCE: name = "gintenb";	break;
-					case 0xF0: name = "devlb";		break;
-					case 0xF1: name = "devsb";		break;
-					case 0xF2: name = "devls";		break;
-					case 0xF3: name = "devss";		break;
-					case 0xF4: name = "devlw";		break;
-					case 0xF5: name = "devsw";		break;
-					case 0xF6: name = "null";		break;
-					case 0xF7: name = "null";		break;
-					case 0xF8: name = "xsword";		break;
-					case 0xF9: name = "lsx";		break;
-					case 0xFA: name = "cs";			break;
-					case 0xFB: name = "csu";		break;
-					case 0x17C:name = "lddevid";	break;
-				}
-			} else {
-				// Total is negative, as a result of nfixes
-				total = (~total & ~0xF) | (total & 0xF);		// 1's complement the upper nibbles
-				switch (total) {
-					case 0x00: name = "swapqueue";	break;
-					case 0x01: name = "swaptimer";	break;
-					case 0x02: name = "insertqueue";break;
-					case 0x03: name = "timeslice";	break;
-					case 0x04: name = "signal";		break;
-					case 0x05: name = "wait";		break;
-					case 0x06: name = "trapdis";	break;
-					case 0x07: name = "trapenb";	break;
-					case 0x0B: name = "tret"; isRet = true;	break;
-					case 0x0C: name = "ldshadow";	break;
-					case 0x0D: name = "stshadow";	break;
-					case 0x1F: name = "iret"; isRet = true;	break;
-					case 0x24: name = "devmove";	break;
-					case 0x2E: name = "restart";	break;
-					case 0x2F: name = "causeerror";	break;
-					case 0x30: name = "nop";		break;
-					case 0x4C: name = "stclock";	break;
-					case 0x4D: name = "ldclock";	break;
-					case 0x4E: name = "clockdis";	break;
-					case 0x4F: name = "clockenb";	break;
-					case 0x8C: name = "ldprodid";	break;
-					case 0x8D: name = "reboot";		break;
-				}
-			}
-			if (name) {
-				stmts = instantiate(pc, name);
-				if (isRet) {
-                	result.rtl = new RTL(pc, stmts);
-                	result.rtl->appendStmt(new ReturnStatement);
+			// The secondary operations, by the operand the prefixes built up (see secondaryOps)
+			const OpcodeTable::Op* op;
+			if (total >= 0)
+				op = secondaryOps.find((unsigned)total);
+			else
+				// Total is negative, as a result of nfixes: 1's complement the upper nibbles
+				op = negativeOps.find((~total & ~0xF) | (total & 0xF));
+			if (op) {
+				stmts = instantiate(pc, op);
+				if (op->flags & RET) {
+					result.rtl = new RTL(pc, stmts);
+					result.rtl->appendStmt(new ReturnStatement);
 				}
 			} else {
 				result.valid = false;		// Invalid instruction
@@ -344,6 +221,8 @@ ST20Decoder::ST20Decoder() : NJMCDecoder(prog)
 {
 	std::string file = Boomerang::get()->getProgPath() + "frontend/machine/st20/st20.ssl";
 	RTLDict.readSSLFile(file.c_str());
+	secondaryOps.build(RTLDict, SECONDARY_OPS, sizeof(SECONDARY_OPS) / sizeof(*SECONDARY_OPS));
+	negativeOps.build(RTLDict, NEGATIVE_OPS, sizeof(NEGATIVE_OPS) / sizeof(*NEGATIVE_OPS));
 }
 
 // For now...
@@ -36,7 +36,10 @@ class MIPSDecoder : public NJMCDecoder {
          * Decodes the machine instruction at pc and returns an RTL instance for
          * the instruction.
          */
-    virtual DecodeResult &decodeInstruction(ADDRESS pc, ptrdiff_t delta);
+    virtual DecodeResult &decodeInstruction(ADDRESS pc, ptrdiff_t delta) final;
+    virtual int decodeRun(ADDRESS pc, ptrdiff_t delta, ADDRESS limit, DecodeResult *results, int max) {
+        return decodeRunOf(this, pc, delta, limit, results, max);
+    }
 
     /*
          * Disassembles the machine instruction at pc and returns the number of
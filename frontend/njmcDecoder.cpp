@@ -15,6 +15,7 @@
   ******************************************************************************/
 #include "decoder.h"
 #include "rtl.h"
+#include "statement.h"
 #include "exp.h"
 #include "register.h"
 #include "cfg.h"
@@ -24,6 +25,7 @@
 #include "boomerang.h"
 #include "util.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdarg> // For varargs
 #include <cstring>
@@ -39,6 +41,48 @@
   ******************************************************************************/
 NJMCDecoder::NJMCDecoder(Prog *prg) : prog(prg),Image(Boomerang::get()->getImage()) {}
 
+int NJMCDecoder::decodeRun(ADDRESS pc, ptrdiff_t delta, ADDRESS limit, DecodeResult *results, int max) {
+    return decodeRunOf(this, pc, delta, limit, results, max);
+}
+
+/***************************************************************************/ /**
+  * \brief   Does \a res end a straight-line run of instructions (see decodeRun)? It does if it was not decoded, is
+  *          to be decoded again, is a delayed or otherwise special instruction, or holds a control transfer: after it,
+  *          decoding does not simply go on with the next instruction
+  ******************************************************************************/
+bool NJMCDecoder::endsRun(const DecodeResult &res) {
+    if (!res.valid || res.reDecode || res.rtl == nullptr || res.numBytes <= 0 || res.type != NCT ||
+        !res.forceOutEdge.isZero())
+        return true;
+    for (Instruction *s : *res.rtl) {
+        switch (s->getKind()) {
+        case STMT_GOTO:
+        case STMT_BRANCH:
+        case STMT_CALL:
+        case STMT_RET:
+        case STMT_CASE:
+            return true;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+//! Make the table of the \a n opcodes of \a spec, binding each to its entry in \a dict
+void OpcodeTable::build(RTLInstDict &dict, const Spec *spec, size_t n) {
+    unsigned size = 0;
+    for (size_t i = 0; i < n; i++)
+        size = std::max(size, spec[i].code + 1);
+    ops.assign(size, Op());
+    for (size_t i = 0; i < n; i++) {
+        Op &op(ops[spec[i].code]);
+        op.name = spec[i].name;
+        op.flags = spec[i].flags;
+        op.entry = dict.lookupOpcode(spec[i].name);
+    }
+}
+
 /***************************************************************************/ /**
   * \brief   Given an instruction name and a variable list of expressions representing the actual operands of
   *              the instruction, use the RTL template dictionary to return the instantiated RTL representing the
@@ -50,18 +94,36 @@ NJMCDecoder::NJMCDecoder(Prog *prg) : prog(prg),Image(Boomerang::get()->getImage
   * \returns an instantiated list of Exps
   ******************************************************************************/
 std::list<Instruction *> *NJMCDecoder::instantiate(ADDRESS pc, const char *name, ...) {
-    // Get the signature of the instruction and extract its parts
-    std::pair<QString, unsigned> sig = RTLDict.getSignature(name);
-    QString opcode = sig.first;
-    unsigned numOperands = sig.second;
+    va_list args;
+    va_start(args, name);
+    // Known opcodes take the fast path of lookupOpcode
+    std::list<Instruction *> *instance = instantiateArgs(pc, name, RTLDict.lookupOpcode(name), args);
+    va_end(args);
+    return instance;
+}
+
+//! As above, for an opcode of an OpcodeTable, whose RTL template is already bound
+std::list<Instruction *> *NJMCDecoder::instantiate(ADDRESS pc, const OpcodeTable::Op *op, ...) {
+    va_list args;
+    va_start(args, op);
+    std::list<Instruction *> *instance = instantiateArgs(pc, op->name, op->entry, args);
+    va_end(args);
+    return instance;
+}
+
+//! The work of instantiate, with the \a entry of \a name if it is known, and the operands in \a args
+std::list<Instruction *> *NJMCDecoder::instantiateArgs(ADDRESS pc, const char *name, TableEntry *entry, va_list args) {
+    // Get the signature of the instruction and extract its parts. An unknown opcode goes the long way, which reports
+    // the error
+    std::pair<QString, unsigned> sig;
+    if (entry == nullptr)
+        sig = RTLDict.getSignature(name);
+    unsigned numOperands = entry ? entry->params.size() : sig.second;
 
     // Put the operands into a vector
     std::vector<Exp *> actuals(numOperands);
-    va_list args;
-    va_start(args, name);
     for (unsigned i = 0; i < numOperands; i++)
         actuals[i] = va_arg(args, Exp *);
-    va_end(args);
 
     if (DEBUG_DECODER) {
         QTextStream q_cout(stdout);
@@ -82,7 +144,8 @@ std::list<Instruction *> *NJMCDecoder::instantiate(ADDRESS pc, const char *name,
         q_cout << '\n';
     }
 
-    std::list<Instruction *> *instance = RTLDict.instantiateRTL(opcode, pc, actuals);
+    std::list<Instruction *> *instance =
+        entry ? RTLDict.instantiateRTL(*entry, pc, actuals) : RTLDict.instantiateRTL(sig.first, pc, actuals);
 
     return instance;
 }
@@ -40706,9 +40706,14 @@ Exp *PentiumDecoder::dis_Eaddr(ADDRESS pc, int size) {
   *                    is a pointer to a function?
   * \param      hostPC - pointer to the code in question (native address)
   * \returns           True if a match found
+  * \note Only the frame setting prologue is recognised: push ebp, then mov ebp, esp in either of its encodings
   ******************************************************************************/
 bool PentiumDecoder::isFuncPrologue(ADDRESS hostPC) {
-    Q_UNUSED(hostPC);
+    if (getByte(hostPC) != 0x55) // push ebp
+        return false;
+    SWord mov = getWord(hostPC + 1);
+    if (mov == (SWord)0xE589 || mov == (SWord)0xEC8B) // mov ebp, esp (89 E5 or 8B EC)
+        return true;
 #if 0
     int locals, regs;
     if ((InstructionPatterns::frameless_pro(prog.csrSrc, hostPC, locals, regs))
@@ -25,8 +25,12 @@ struct DecodeResult;
 class PentiumDecoder : public NJMCDecoder {
   public:
     PentiumDecoder(Prog *prog);
-    virtual DecodeResult &decodeInstruction(ADDRESS pc, ptrdiff_t delta);
+    virtual DecodeResult &decodeInstruction(ADDRESS pc, ptrdiff_t delta) final;
+    virtual int decodeRun(ADDRESS pc, ptrdiff_t delta, ADDRESS limit, DecodeResult *results, int max) {
+        return decodeRunOf(this, pc, delta, limit, results, max);
+    }
     virtual int decodeAssemblyInstruction(ADDRESS pc, ptrdiff_t delta);
+    virtual int getInstructionAlignment() const { return 1; }
 
   private:
     /*
@@ -37,7 +41,7 @@ class PentiumDecoder : public NJMCDecoder {
     Exp *dis_Mem(ADDRESS ps);
     Exp *addReloc(Exp *e);
 
-    bool isFuncPrologue(ADDRESS hostPC);
+    virtual bool isFuncPrologue(ADDRESS hostPC);
 
     Byte getByte(intptr_t lc); // TODO: switch to using ADDRESS objects
     SWord getWord(intptr_t lc);
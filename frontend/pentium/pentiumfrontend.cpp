@@ -132,18 +132,17 @@ bool PentiumFrontEnd::isAssignFromTern(Instruction *s) {
   *
   ******************************************************************************/
 void PentiumFrontEnd::bumpRegisterAll(Exp *e, int min, int max, int delta, int mask) {
-    std::list<Exp **> li;
-    std::list<Exp **>::iterator it;
+    ExpSlotList li;
     Exp *exp = e;
     // Use doSearch, which is normally an internal method of Exp, to avoid problems of replacing the wrong
     // subexpression (in some odd cases)
     Exp::doSearch(*Location::regOf(Terminal::get(opWild)), exp, li, false);
-    for (it = li.begin(); it != li.end(); it++) {
-        int reg = ((Const *)((Unary *)**it)->getSubExp1())->getInt();
+    for (Exp **pp : li) {
+        int reg = ((Const *)((Unary *)*pp)->getSubExp1())->getInt();
         if ((min <= reg) && (reg <= max)) {
             // Replace the K in r[ K] with a new K
-            // **it is a reg[K]
-            Const *K = (Const *)((Unary *)**it)->getSubExp1();
+            // *pp is a reg[K]
+            Const *K = (Const *)((Unary *)*pp)->getSubExp1();
             K->setInt(min + ((reg - min + delta) & mask));
         }
     }
@@ -376,7 +375,7 @@ void PentiumFrontEnd::processFloatCode(BasicBlock *pBB, int &tos, Cfg *pCfg) {
     pBB->setTraversed(true);
 
     // Now recurse to process my out edges, if not already processed
-    const std::vector<BasicBlock *> &outs = pBB->getOutEdges();
+    const BBEdgeList &outs = pBB->getOutEdges();
     unsigned n;
     do {
         n = outs.size();
@@ -841,8 +840,8 @@ bool PentiumFrontEnd::decodeSpecial_out(ADDRESS pc, DecodeResult &r) {
     r.type = NCT;
     r.reDecode = false;
     r.rtl = new RTL(pc);
-    Exp *dx = Location::regOf(decoder->getRTLDict().RegMap["%dx"]);
-    Exp *al = Location::regOf(decoder->getRTLDict().RegMap["%al"]);
+    Exp *dx = Location::regOf(decoder->getRTLDict().getRegIndex("%dx"));
+    Exp *al = Location::regOf(decoder->getRTLDict().getRegIndex("%al"));
     CallStatement *call = new CallStatement();
     call->setDestProc(Program->getLibraryProc("outp"));
     call->setArgumentExp(0, dx);
@@ -876,12 +875,32 @@ bool PentiumFrontEnd::decodeSpecial(ADDRESS pc, DecodeResult &r) {
     }
     return false;
 }
+//! Is the instruction at \a pc one of those decodeSpecial() handles?
+bool PentiumFrontEnd::isSpecial(ADDRESS pc) {
+    char n = Image->readNative1(pc);
+    return n == (char)0xee || (n == 0x0f && Image->readNative1(pc + 1) == 0x0b);
+}
 DecodeResult &PentiumFrontEnd::decodeInstruction(ADDRESS pc) {
     static DecodeResult r;
     if (decodeSpecial(pc, r))
         return r;
     return FrontEnd::decodeInstruction(pc);
 }
+//! As FrontEnd::decodeRun, but the decoder does not know the instructions of decodeSpecial(): a run stops before them
+int PentiumFrontEnd::decodeRun(ADDRESS pc, DecodeResult *results, int max) {
+    if (decodeSpecial(pc, results[0]))
+        return 1;
+    int n = FrontEnd::decodeRun(pc, results, max);
+    for (int i = 1; i < n; i++) {
+        pc += results[i - 1].numBytes;
+        if (isSpecial(pc)) {
+            for (int j = i; j < n; j++)
+                delete results[j].rtl;
+            return i;
+        }
+    }
+    return n;
+}
 
 // EXPERIMENTAL: can we find function pointers in arguments to calls this early?
 void PentiumFrontEnd::extraProcessCall(CallStatement *call, std::list<RTL *> *BB_rtls) {
@@ -65,11 +65,13 @@ class PentiumFrontEnd : public FrontEnd {
     void bumpRegisterAll(Exp *e, int min, int max, int delta, int mask);
     unsigned fetch4(unsigned char *ptr);
     bool decodeSpecial(ADDRESS pc, DecodeResult &r);
+    bool isSpecial(ADDRESS pc);
     bool decodeSpecial_out(ADDRESS pc, DecodeResult &r);
     bool decodeSpecial_invalid(ADDRESS pc, DecodeResult &r);
 
   protected:
     virtual DecodeResult &decodeInstruction(ADDRESS pc);
+    virtual int decodeRun(ADDRESS pc, DecodeResult *results, int max);
     virtual void extraProcessCall(CallStatement *call, std::list<RTL *> *BB_rtls);
 };
 
@@ -8970,8 +8970,12 @@ Exp *PPCDecoder::dis_RAmbz(unsigned r) {
   *                    is a pointer to a function?
   * \param      hostPC - pointer to the code in question (host address)
   * \returns           True if a match found
+  * \note Matches stwu r1, -n(r1), which makes the stack frame of every procedure that has one
   ******************************************************************************/
-bool PPCDecoder::isFuncPrologue(ADDRESS /*hostPC*/) { return false; }
+bool PPCDecoder::isFuncPrologue(ADDRESS hostPC) {
+    DWord w = getDword(hostPC);
+    return (w & 0xFFFF8000) == 0x94218000; // opcode 37, rS = rA = 1, negative displacement
+}
 
 /**********************************
  * These are the fetch routines.
@@ -32,7 +32,10 @@ class PPCDecoder : public NJMCDecoder {
          * Decodes the machine instruction at pc and returns an RTL instance for
          * the instruction.
          */
-    virtual DecodeResult &decodeInstruction(ADDRESS pc, ptrdiff_t delta);
+    virtual DecodeResult &decodeInstruction(ADDRESS pc, ptrdiff_t delta) final;
+    virtual int decodeRun(ADDRESS pc, ptrdiff_t delta, ADDRESS limit, DecodeResult *results, int max) {
+        return decodeRunOf(this, pc, delta, limit, results, max);
+    }
 
     /*
          * Disassembles the machine instruction at pc and returns the number of
@@ -50,7 +53,7 @@ class PPCDecoder : public NJMCDecoder {
     Exp *dis_RAmbz(unsigned r); // Special for rA of certain instructions
 
     RTL *createBranchRtl(ADDRESS pc, std::list<Instruction *> *stmts, const char *name);
-    bool isFuncPrologue(ADDRESS);
+    virtual bool isFuncPrologue(ADDRESS hostPC);
     DWord getDword(ADDRESS lc);
 };
 
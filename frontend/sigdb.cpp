@@ -0,0 +1,422 @@
+/***************************************************************************/ /**
+  * \file       sigdb.cpp
+  * \brief   Compiled signature databases (FrontEnd::readSignatureDatabase and FrontEnd::writeSignatureDatabase)
+  *
+  * Every signature file of the catalog is normally run through the C parser on each run. With --sig-db, the file is
+  * instead compiled, for the platform of the front end reading it, into <file>.<platform>.sigdb: the named types it
+  * defines and its signatures, with their parameter lists and types, in binary form. The database is mapped rather
+  * than read (see MappedImage). Its named types are made as it is opened, since anything may look them up by name,
+  * but a signature is only decoded when getLibSignature() first asks for it, found by a hash probe of the names.
+  *
+  * The file starts with a magic string, a format version and a key: that of the name index of the signature file
+  * (see FrontEnd::getSignatureIndexKey), a hash of the version of Boomerang, the platform, the calling convention and
+  * the contents of the file. A database with any other key is ignored, and made again from the signature file.
+  * "boomerang --compile-sigs" compiles the databases of every platform at once; the signature-db target of the build
+  * runs it.
+  *
+  * Only what the C parser makes is written: signatures of a platform and convention (not custom ones), and void,
+  * boolean, char, integer, float, size, pointer, array, named, compound and function types. A file declaring anything
+  * else gets no database, and is parsed as before.
+  ******************************************************************************/
+#include "frontend.h"
+
+#include "boomerang.h"
+#include "log.h"
+#include "signature.h"
+#include "type.h"
+
+#include <QDataStream>
+#include <QSaveFile>
+
+#include <set>
+
+namespace {
+const char *const MAGIC = "boomerang-signature-db";
+const quint32 FORMAT_VERSION = 1;
+
+class DatabaseWriter {
+    QDataStream &os;
+
+  public:
+    DatabaseWriter(QDataStream &s) : os(s) {}
+
+    //! Write \a ty, returning false for the types the C parser does not make
+    bool type(const SharedType &ty) {
+        if (ty == nullptr)
+            os << (quint8)'n';
+        else if (ty->isVoid())
+            os << (quint8)'v';
+        else if (ty->isBoolean())
+            os << (quint8)'b';
+        else if (ty->isChar())
+            os << (quint8)'c';
+        else if (ty->isInteger())
+            os << (quint8)'i' << (qint32)ty->getSize() << (qint32)ty->as<IntegerType>()->getSignedness();
+        else if (ty->isFloat())
+            os << (quint8)'f' << (qint32)ty->getSize();
+        else if (ty->isSize())
+            os << (quint8)'z' << (qint32)ty->getSize();
+        else if (ty->isNamed())
+            os << (quint8)'N' << ty->as<NamedType>()->getName();
+        else if (ty->isPointer()) {
+            os << (quint8)'p';
+            return type(ty->as<PointerType>()->getPointsTo());
+        } else if (ty->isArray()) {
+            std::shared_ptr<ArrayType> a = ty->as<ArrayType>();
+            os << (quint8)'a' << a->isUnbounded() << (quint32)(a->isUnbounded() ? 0 : a->getLength());
+            return type(a->getBaseType());
+        } else if (ty->isCompound()) {
+            std::shared_ptr<CompoundType> c = ty->as<CompoundType>();
+            if (c->isGeneric())
+                return false;
+            os << (quint8)'s' << (quint32)c->getNumTypes();
+            for (unsigned i = 0; i < c->getNumTypes(); i++) {
+                os << c->getName(i);
+                if (!type(c->getType(i)))
+                    return false;
+            }
+        } else if (ty->isFunc()) {
+            os << (quint8)'F';
+            return signature(ty->as<FuncType>()->getSignature());
+        } else
+            return false;
+        return true;
+    }
+
+    //! Write \a sig as the replay of what the C parser did to make it: instantiate, then add returns and parameters
+    bool signature(Signature *sig) {
+        if (sig == nullptr || sig->getPlatform() == PLAT_GENERIC || sig->getConvention() == CONV_NONE)
+            return false;
+        // Returns the signature starts with are made again by instantiate(); only those added after are written
+        Signature *fresh = Signature::instantiate(sig->getPlatform(), sig->getConvention(), sig->getName());
+        if (fresh == nullptr)
+            return false;
+        size_t firstReturn = fresh->getNumReturns();
+        delete fresh;
+        if (sig->getNumReturns() < firstReturn)
+            return false;
+        os << sig->getName() << (qint32)sig->getPlatform() << (qint32)sig->getConvention();
+        os << (quint32)(sig->getNumReturns() - firstReturn);
+        for (size_t i = firstReturn; i < sig->getNumReturns(); i++)
+            if (!type(sig->getReturnType(i)))
+                return false;
+        os << (quint32)sig->getNumParams();
+        for (size_t i = 0; i < sig->getNumParams(); i++) {
+            os << sig->getParamName(i) << sig->getParamBoundMax(i);
+            if (!type(sig->getParamType(i)))
+                return false;
+        }
+        os << sig->hasEllipsis() << sig->getPreferedName();
+        if (!type(sig->getPreferedReturn()))
+            return false;
+        os << (quint32)sig->getNumPreferedParams();
+        for (size_t i = 0; i < sig->getNumPreferedParams(); i++)
+            os << (qint32)sig->getPreferedParam(i);
+        return true;
+    }
+};
+
+class DatabaseReader {
+    QDataStream &is;
+
+    quint8 tag() {
+        quint8 t = 0;
+        is >> t;
+        return t;
+    }
+    qint32 int32() {
+        qint32 i = 0;
+        is >> i;
+        return i;
+    }
+    quint32 uint32() {
+        quint32 i = 0;
+        is >> i;
+        return i;
+    }
+
+  public:
+    DatabaseReader(QDataStream &s) : is(s) {}
+    bool good() const { return is.status() == QDataStream::Ok; }
+
+    SharedType type(bool &ok) {
+        switch (tag()) {
+        case 'n':
+            return nullptr;
+        case 'v':
+            return VoidType::get();
+        case 'b':
+            return BooleanType::get();
+        case 'c':
+            return CharType::get();
+        case 'i': {
+            int size = int32();
+            return IntegerType::get(size, int32());
+        }
+        case 'f':
+            return FloatType::get(int32());
+        case 'z':
+            return SizeType::get(int32());
+        case 'N': {
+            QString name;
+            is >> name;
+            return NamedType::get(name);
+        }
+        case 'p':
+            return PointerType::get(type(ok));
+        case 'a': {
+            bool unbounded = false;
+            is >> unbounded;
+            quint32 length = uint32();
+            SharedType base = type(ok);
+            if (unbounded)
+                return ArrayType::get(base);
+            return ArrayType::get(base, length);
+        }
+        case 's': {
+            std::shared_ptr<CompoundType> c = CompoundType::get();
+            quint32 n = uint32();
+            for (quint32 i = 0; ok && good() && i < n; i++) {
+                QString name;
+                is >> name;
+                SharedType member = type(ok);
+                if (member == nullptr)
+                    ok = false;
+                else
+                    c->addType(member, name);
+            }
+            return c;
+        }
+        case 'F': {
+            Signature *sig = signature(ok);
+            if (sig == nullptr)
+                return nullptr;
+            return FuncType::get(sig);
+        }
+        }
+        ok = false;
+        return nullptr;
+    }
+
+    Signature *signature(bool &ok) {
+        QString name;
+        is >> name;
+        qint32 plat = int32();
+        qint32 cc = int32();
+        if (!good() || plat < PLAT_PENTIUM || plat >= PLAT_GENERIC || cc < CONV_C || cc >= CONV_NONE ||
+            (plat == PLAT_SPARC && cc != CONV_C)) {
+            ok = false;
+            return nullptr;
+        }
+        Signature *sig = Signature::instantiate((platform)plat, (callconv)cc, name);
+        if (sig == nullptr) {
+            ok = false;
+            return nullptr;
+        }
+        quint32 n = uint32();
+        for (quint32 i = 0; ok && good() && i < n; i++) {
+            SharedType ty = type(ok);
+            if (ty == nullptr)
+                ok = false;
+            else
+                sig->addReturn(ty);
+        }
+        n = uint32();
+        for (quint32 i = 0; ok && good() && i < n; i++) {
+            QString paramName, boundMax;
+            is >> paramName >> boundMax;
+            SharedType ty = type(ok);
+            if (ty == nullptr)
+                ok = false;
+            else
+                sig->addParameter(ty, paramName, nullptr, boundMax);
+        }
+        bool ellipsis = false;
+        QString preferedName;
+        is >> ellipsis >> preferedName;
+        if (ellipsis)
+            sig->addEllipsis();
+        sig->setPreferedName(preferedName);
+        if (ok)
+            sig->setPreferedReturn(type(ok));
+        n = uint32();
+        for (quint32 i = 0; ok && good() && i < n; i++)
+            sig->addPreferedParameter(int32());
+        if (!ok || !good()) {
+            delete sig;
+            ok = false;
+            return nullptr;
+        }
+        return sig;
+    }
+};
+
+void setVersion(QDataStream &s) { s.setVersion(QDataStream::Qt_5_0); }
+}
+
+//! Where the database of the signature file \a path compiled for \a plat is kept
+QString FrontEnd::getSignatureDatabasePath(const QString &path, platform plat) {
+    return path + "." + Signature::platformName(plat) + ".sigdb";
+}
+
+/***************************************************************************/ /**
+  * \brief   Read the database compiled from the signature file \a path for this platform and \a cc, if it is there
+  * and up to date: its named types are added now, and its signatures noted for getLibSignature() to decode
+  * \param   names if given, the names of the signatures of the file are appended to it
+  * \returns false if there is no such database, or it can't be read; nothing is added then
+  ******************************************************************************/
+bool FrontEnd::readSignatureDatabase(const QString &path, callconv cc, QStringList *names) {
+    QByteArray key = getSignatureIndexKey(path, getFrontEndId(), cc);
+    if (key.isEmpty())
+        return false;
+    std::unique_ptr<SignatureDatabase> db(new SignatureDatabase);
+    db->path = path;
+    if (!db->image.open(getSignatureDatabasePath(path, getFrontEndId())))
+        return false;
+    QByteArray image = QByteArray::fromRawData(db->image.data(), (int)db->image.size());
+    QDataStream is(image);
+    setVersion(is);
+    QByteArray magic, fileKey;
+    quint32 version = 0;
+    is >> magic >> version >> fileKey;
+    if (magic != MAGIC || version != FORMAT_VERSION || fileKey != key)
+        return false;
+
+    DatabaseReader rd(is);
+    bool ok = true;
+    quint32 n = 0;
+    is >> n;
+    std::list<std::pair<QString, SharedType>> types;
+    for (quint32 i = 0; ok && rd.good() && i < n; i++) {
+        QString name;
+        is >> name;
+        SharedType ty = rd.type(ok);
+        if (ty == nullptr)
+            ok = false;
+        types.emplace_back(name, ty);
+    }
+    is >> n;
+    std::vector<std::pair<QString, quint32>> sigs;
+    for (quint32 i = 0; ok && rd.good() && i < n; i++) {
+        QString name;
+        quint32 offset = 0;
+        is >> name >> offset;
+        sigs.emplace_back(name, offset);
+    }
+    if (!ok || !rd.good())
+        return false;
+    // The records of the signatures follow the directory, which gives their offsets from there
+    qint64 records = is.device()->pos();
+    for (const std::pair<QString, quint32> &s : sigs)
+        if (records + s.second >= image.size())
+            return false;
+
+    for (const std::pair<QString, SharedType> &t : types)
+        Type::addNamedType(t.first, t.second);
+    int idx = signatureDatabases.size();
+    for (const std::pair<QString, quint32> &s : sigs) {
+        compiledSignatures[s.first] = std::make_pair(idx, (quint32)(records + s.second));
+        if (names)
+            names->append(s.first);
+    }
+    signatureDatabases.push_back(std::move(db));
+    return true;
+}
+
+//! Decode the signature at \a offset of the database \a db of signatureDatabases. \returns nullptr if it can't be read
+Signature *FrontEnd::readCompiledSignature(int db, quint32 offset) {
+    SignatureDatabase &d(*signatureDatabases[db]);
+    QByteArray image = QByteArray::fromRawData(d.image.data(), (int)d.image.size());
+    QDataStream is(image);
+    setVersion(is);
+    is.device()->seek(offset);
+    DatabaseReader rd(is);
+    bool ok = true;
+    Signature *sig = rd.signature(ok);
+    if (sig == nullptr) {
+        LOG_STREAM(LL_Warn) << "can't read a signature of " << getSignatureDatabasePath(d.path, getFrontEndId())
+                            << "\n";
+        return nullptr;
+    }
+    sig->setSigFile(d.path);
+    return sig;
+}
+
+/***************************************************************************/ /**
+  * \brief   Compile \a file, the signature file \a path as parsed for \a plat and \a cc, into its database. Nothing is
+  * written if the file declares something the database can't represent, or it can't be written (e.g. a read only
+  * installation).
+  ******************************************************************************/
+bool FrontEnd::writeSignatureDatabase(const QString &path, platform plat, callconv cc,
+                                      const ParsedSignatureFile &file) {
+    QByteArray key = getSignatureIndexKey(path, plat, cc);
+    if (key.isEmpty())
+        return false;
+    QByteArray records;
+    std::vector<std::pair<QString, quint32>> sigs;
+    {
+        QDataStream os(&records, QIODevice::WriteOnly);
+        setVersion(os);
+        DatabaseWriter wr(os);
+        for (Signature *sig : file.signatures) {
+            sigs.emplace_back(sig->getName(), (quint32)records.size());
+            if (!wr.signature(sig))
+                return false;
+        }
+    }
+    QByteArray data;
+    QDataStream os(&data, QIODevice::WriteOnly);
+    setVersion(os);
+    os << QByteArray(MAGIC) << FORMAT_VERSION << key;
+    DatabaseWriter wr(os);
+    os << (quint32)file.types.size();
+    for (const std::pair<QString, SharedType> &t : file.types) {
+        os << t.first;
+        if (t.second == nullptr || !wr.type(t.second))
+            return false;
+    }
+    os << (quint32)sigs.size();
+    for (const std::pair<QString, quint32> &s : sigs)
+        os << s.first << s.second;
+    os.writeRawData(records.constData(), records.size());
+
+    QSaveFile f(getSignatureDatabasePath(path, plat));
+    if (!f.open(QFile::WriteOnly))
+        return false;
+    f.write(data);
+    return f.commit();
+}
+
+/***************************************************************************/ /**
+  * \brief   Compile the databases of the signature files of every platform that has a catalog, the build step of
+  * --sig-db. The files of a platform are parsed in the order a front end reads them, with the named types of those
+  * before them defined, as they would be when read.
+  * \returns false if some file could not be compiled
+  ******************************************************************************/
+bool FrontEnd::compileSignatureDatabases() {
+    bool ok = true;
+    for (int i = PLAT_PENTIUM; i < PLAT_GENERIC; i++) {
+        platform plat = (platform)i;
+        std::set<QString> done;
+        Type::clearNamedTypes();
+        for (const std::pair<QString, callconv> &f : getPlatformSignatureFiles(plat)) {
+            if (!done.insert(f.first).second)
+                continue; // In more than one catalog
+            ParsedSignatureFile file;
+            parseSignatureFile(f.first, plat, f.second, file);
+            if (writeSignatureDatabase(f.first, plat, f.second, file))
+                LOG_STREAM() << "compiled " << getSignatureDatabasePath(f.first, plat) << "\n";
+            else {
+                LOG_STREAM(LL_Error) << "can't compile " << f.first << " for " << Signature::platformName(plat)
+                                     << "\n";
+                ok = false;
+            }
+            for (const std::pair<QString, SharedType> &t : file.types)
+                Type::addNamedType(t.first, t.second);
+            for (Signature *sig : file.signatures)
+                delete sig;
+        }
+    }
+    Type::clearNamedTypes();
+    return ok;
+}
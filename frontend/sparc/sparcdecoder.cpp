@@ -2191,10 +2191,12 @@ Exp *SparcDecoder::dis_Eaddr(ADDRESS pc, int size) {
   *                    like this offset is a pointer to a function?
   * \param      hostPC - pointer to the code in question (host address)
   * \returns           True if a match found
+  * \note Matches save %sp, -n, %sp, which starts every procedure that has a register window of its own
   ******************************************************************************/
 bool SparcDecoder::isFuncPrologue(ADDRESS hostPC) {
-    Q_UNUSED(hostPC);
-    return false;
+    unsigned w = getDword(hostPC);
+    return (w >> 30 & 0x3) /* op */ == 2 && (w >> 19 & 0x3f) /* op3 */ == 60 && (w >> 13 & 0x1) /* i */ == 1 &&
+           (w >> 25 & 0x1f) /* rd */ == 14 && (w >> 14 & 0x1f) /* rs1 */ == 14 && (w >> 12 & 0x1) /* simm13 < 0 */;
 }
 
 /***************************************************************************/ /**
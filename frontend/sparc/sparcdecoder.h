@@ -37,7 +37,10 @@ public:
          * Decodes the machine instruction at pc and returns an RTL instance for
          * the instruction.
          */
-    virtual DecodeResult &decodeInstruction(ADDRESS pc, ptrdiff_t delta);
+    virtual DecodeResult &decodeInstruction(ADDRESS pc, ptrdiff_t delta) final;
+    virtual int decodeRun(ADDRESS pc, ptrdiff_t delta, ADDRESS limit, DecodeResult *results, int max) {
+        return decodeRunOf(this, pc, delta, limit, results, max);
+    }
 
     /*
          * Disassembles the machine instruction at pc and returns the number of
@@ -60,7 +63,7 @@ public:
     Exp *dis_RegLhs(unsigned r);
 
     RTL *createBranchRtl(ADDRESS pc, std::list<Instruction *> *stmts, const char *name);
-    bool isFuncPrologue(ADDRESS hostPC);
+    virtual bool isFuncPrologue(ADDRESS hostPC);
     DWord getDword(ADDRESS lc);
 };
 
@@ -38,6 +38,7 @@
 #include "rtl.h"
 #include "signature.h"
 #include "sparcdecoder.h"
+#include "stats.h"
 
 #include <cassert>
 #include <cstring>
@@ -249,9 +250,8 @@ bool SparcFrontEnd::case_CALL(ADDRESS &address, DecodeResult &inst, DecodeResult
 
         // First check for helper functions
         ADDRESS dest = call_stmt->getFixedDest();
-        const IBinarySymbol *symb = SymbolTable->find(dest);
         // Special check for calls to weird PLT entries which don't have symbols
-        if ((symb && symb->isImportedFunction()) && (Program->symbolByAddress(dest) == nullptr)) {
+        if (SymbolTable->findImportedFunction(dest) && (Program->symbolByAddress(dest) == nullptr)) {
             // This is one of those. Flag this as an invalid instruction
             inst.valid = false;
         }
@@ -596,7 +596,9 @@ bool SparcFrontEnd::case_SCD(ADDRESS &address, ptrdiff_t delta, ADDRESS hiAddres
         cfg->addOutEdge(pBB, pOrBB, true);
         // Add the "false" leg to the NCT
         cfg->addOutEdge(pBB, address + 4);
-        // Don't skip the delay instruction, so it will be decoded next.
+        // Don't skip the delay instruction, so it will be decoded next. Its RTL is the orphan's now, so it cannot be
+        // reused for that (see processProc)
+        delay_inst.rtl = nullptr;
         address += 4;
     }
     // Start a new list of RTLs for the next BB
@@ -747,12 +749,19 @@ bool SparcFrontEnd::processProc(ADDRESS uAddr, UserProc *proc, QTextStream &os,
     assert(cfg);
 
     // Initialise the queue of control flow targets that have yet to be decoded.
+    targetQueue.setTextLimits(Image->getLimitTextLow(), Image->getLimitTextHigh());
     targetQueue.initial(uAddr);
 
+    // The delay slot of a branch that was left to be decoded next as an instruction of its own (see case_SCD), with
+    // its RTL unused: it is taken as is rather than decoded (or cloned from the decode cache) a second time
+    DecodeResult lookahead;
+    ADDRESS lookaheadAddr = NO_ADDRESS;
+
     // Get the next address from which to continue decoding and go from
     // there. Exit the loop if there are no more addresses or they all
     // correspond to locations that have been decoded.
     while ((uAddr = targetQueue.nextAddress(*cfg)) != NO_ADDRESS) {
+        lookaheadAddr = NO_ADDRESS;
 
         // The list of RTLs for the current basic block
         std::list<RTL *> *BB_rtls = new std::list<RTL *>();
@@ -774,8 +783,12 @@ bool SparcFrontEnd::processProc(ADDRESS uAddr, UserProc *proc, QTextStream &os,
                 inst.rtl = ff->second;
                 inst.valid = true;
                 inst.type = DD; // E.g. decode the delay slot instruction
+            } else if (uAddr == lookaheadAddr) {
+                inst = lookahead;
+                DecompileStats::get().count(nullptr, "decode", "reused delay slots");
             } else
                 inst = decodeInstruction(uAddr);
+            lookaheadAddr = NO_ADDRESS;
 
             // If invalid and we are speculating, just exit
             if (spec && !inst.valid)
@@ -1060,7 +1073,8 @@ bool SparcFrontEnd::processProc(ADDRESS uAddr, UserProc *proc, QTextStream &os,
                 // instruction just before the target; if so, we can branch to that and not need the orphan.  We do
                 // just a binary comparison; that may fail to make this optimisation if the instr has relative fields.
 
-                DecodeResult delay_inst = decodeInstruction(uAddr + 4);
+                ADDRESS delaySlot = uAddr + 4;
+                DecodeResult delay_inst = decodeInstruction(delaySlot);
                 RTL *delay_rtl = delay_inst.rtl;
 
                 // Display low level RTL representation if asked
@@ -1084,6 +1098,11 @@ bool SparcFrontEnd::processProc(ADDRESS uAddr, UserProc *proc, QTextStream &os,
                     case_unhandled_stub(uAddr);
                     break;
                 }
+                // If only the branch was skipped, the delay slot comes next
+                if (uAddr == delaySlot && delay_inst.rtl != nullptr) {
+                    lookahead = delay_inst;
+                    lookaheadAddr = delaySlot;
+                }
                 break;
             }
 
@@ -1166,10 +1185,9 @@ bool SparcFrontEnd::processProc(ADDRESS uAddr, UserProc *proc, QTextStream &os,
     // Add the callees to the set of CallStatements to proces for parameter recovery, and also to the Prog object
     for (std::list<CallStatement *>::iterator it = callList.begin(); it != callList.end(); it++) {
         ADDRESS dest = (*it)->getFixedDest();
-        const IBinarySymbol *symb = SymbolTable->find(dest);
         // Don't speculatively decode procs that are outside of the main text section, apart from dynamically linked
         // ones (in the .plt)
-        if ((symb && symb->isImportedFunction()) || !spec || (dest < Image->getLimitTextHigh())) {
+        if (SymbolTable->findImportedFunction(dest) || !spec || (dest < Image->getLimitTextHigh())) {
             cfg->addCall(*it);
             // Don't visit the destination of a register call
             // if (dest != NO_ADDRESS) newProc(proc->getProg(), dest);
@@ -1249,8 +1267,7 @@ void SparcFrontEnd::quadOperation(ADDRESS addr, std::list<RTL *> *lrtl, OPER op)
   * \returns True if a helper function was found and handled; false otherwise
   ******************************************************************************/
 bool SparcFrontEnd::helperFunc(ADDRESS dest, ADDRESS addr, std::list<RTL *> *lrtl) {
-    const IBinarySymbol *sym = SymbolTable->find(dest);
-    if (! (sym && sym->isImportedFunction()) )
+    if (SymbolTable->findImportedFunction(dest) == nullptr)
         return false;
     QString name = Program->symbolByAddress(dest);
     if (name.isEmpty()) {
@@ -32,7 +32,10 @@ class ST20Decoder : public NJMCDecoder {
          * Decodes the machine instruction at pc and returns an RTL instance for
          * the instruction.
          */
-    virtual DecodeResult &decodeInstruction(ADDRESS pc, ptrdiff_t delta);
+    virtual DecodeResult &decodeInstruction(ADDRESS pc, ptrdiff_t delta) final;
+    virtual int decodeRun(ADDRESS pc, ptrdiff_t delta, ADDRESS limit, DecodeResult *results, int max) {
+        return decodeRunOf(this, pc, delta, limit, results, max);
+    }
 
     /*
          * Disassembles the machine instruction at pc and returns the number of
@@ -51,8 +54,11 @@ class ST20Decoder : public NJMCDecoder {
     // Exp*    dis_RAmbz(unsigned r);        // Special for rA of certain instructions
 
     void unused(int);
+    //! The secondary operations, by their operand: positive, and negative (see decodeInstruction)
+    OpcodeTable secondaryOps, negativeOps;
     RTL *createBranchRtl(ADDRESS pc, std::list<Instruction *> *stmts, const char *name);
-    bool isFuncPrologue(ADDRESS hostPC);
+    virtual bool isFuncPrologue(ADDRESS hostPC);
+    virtual int getInstructionAlignment() const { return 1; }
     DWord getDword(intptr_t lc); // TODO: switch back to using ADDRESS objects
     SWord getWord(intptr_t lc);
     Byte getByte(intptr_t lc);
@@ -0,0 +1,108 @@
+/***************************************************************************/ /**
+  * \file       SignatureDatabaseTest.cpp
+  * OVERVIEW:   Provides the implementation for the SignatureDatabaseTest class, which
+  *                tests the signature databases compiled from the signature files (--sig-db)
+  ******************************************************************************/
+#include "SignatureDatabaseTest.h"
+
+#include "prog.h"
+#include "frontend.h"
+#include "pentiumfrontend.h"
+#include "BinaryFile.h"
+#include "signature.h"
+#include "boomerang.h"
+#include "log.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcessEnvironment>
+#include <QDebug>
+
+#define HELLO_PENT baseDir.absoluteFilePath("tests/inputs/pentium/hello")
+
+static bool logset = false;
+static QString TEST_BASE;
+static QDir baseDir;
+void SignatureDatabaseTest::initTestCase() {
+    if (!logset) {
+        TEST_BASE = QProcessEnvironment::systemEnvironment().value("BOOMERANG_TEST_BASE", "");
+        baseDir = QDir(TEST_BASE);
+        if (TEST_BASE.isEmpty()) {
+            qWarning() << "BOOMERANG_TEST_BASE environment variable not set, will assume '..', many test may fail";
+            TEST_BASE = "..";
+            baseDir = QDir("..");
+        }
+        logset = true;
+        Boomerang::get()->setProgPath(TEST_BASE);
+        Boomerang::get()->setPluginPath(TEST_BASE + "/out");
+        Boomerang::get()->setLogger(new NullLogger());
+    }
+}
+
+namespace {
+//! The database of stdio.h for pentium, which declares printf and fopen
+QString stdioDatabase() {
+    return QDir(Boomerang::get()->getProgPath())
+        .absoluteFilePath("signatures/stdio.h." + Signature::platformName(PLAT_PENTIUM) + ".sigdb");
+}
+
+//! The signatures of a few library functions, as a pentium front end reads them with or without \a databases
+QString librarySignatures(bool databases) {
+    Boomerang::get()->signatureDatabases = databases;
+    BinaryFileFactory bff;
+    QObject *pBF = bff.Load(HELLO_PENT);
+    if (pBF == nullptr)
+        return QString();
+    Prog *prog = new Prog;
+    FrontEnd *pFE = new PentiumFrontEnd(pBF, prog, &bff);
+    prog->setFrontEnd(pFE);
+    pFE->readLibraryCatalog();
+    QString text;
+    QTextStream os(&text);
+    for (const char *name : {"printf", "fopen", "strlen", "malloc"}) {
+        pFE->getLibSignature(name)->print(os);
+        os << "\n";
+    }
+    os.flush();
+    delete prog;
+    Boomerang::get()->signatureDatabases = false;
+    return text;
+}
+}
+
+/***************************************************************************/ /**
+  * \fn        SignatureDatabaseTest::testCompileAndRead
+  * OVERVIEW:        Test that the signatures are the same when parsed, when the database is compiled on first use,
+  *                  and when they are read back from it
+  ******************************************************************************/
+void SignatureDatabaseTest::testCompileAndRead() {
+    QString parsed = librarySignatures(false);
+    QVERIFY(!parsed.isEmpty());
+
+    QFile::remove(stdioDatabase());
+    QString compiled = librarySignatures(true);
+    QVERIFY(QFile::exists(stdioDatabase()));
+    QString read = librarySignatures(true);
+    QCOMPARE(compiled, parsed);
+    QCOMPARE(read, parsed);
+}
+
+/***************************************************************************/ /**
+  * \fn        SignatureDatabaseTest::testStale
+  * OVERVIEW:        Test that a database that is not of the current key is ignored and compiled again
+  ******************************************************************************/
+void SignatureDatabaseTest::testStale() {
+    QString parsed = librarySignatures(false);
+    QFile db(stdioDatabase());
+    QVERIFY(db.open(QFile::WriteOnly | QFile::Truncate));
+    db.write("boomerang-signature-db, but not of this file");
+    db.close();
+    qint64 staleSize = QFileInfo(stdioDatabase()).size();
+
+    QCOMPARE(librarySignatures(true), parsed);
+    QVERIFY(QFileInfo(stdioDatabase()).size() != staleSize);
+    QCOMPARE(librarySignatures(true), parsed);
+}
+
+QTEST_MAIN(SignatureDatabaseTest)
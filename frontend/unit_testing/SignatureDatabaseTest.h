@@ -0,0 +1,9 @@
+#include <QtTest/QTest>
+
+class SignatureDatabaseTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void initTestCase();
+    void testCompileAndRead();
+    void testStale();
+};
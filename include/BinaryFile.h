@@ -99,6 +99,7 @@ public:
     static void setBasePath(const QString &path) { m_base_path = path; } //!< sets the base directory for plugin search
     QObject *Load(const QString &sName);
     void UnLoad();
+    static MACHINE probeMachine(const QString &sName, LOAD_FMT &format);
 };
 
 #define LoaderInterface_iid "org.boomerang.LoaderInterface"
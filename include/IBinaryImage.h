@@ -32,6 +32,16 @@ public:
     virtual float readNativeFloat4(ADDRESS nat) = 0;//!< Read 4 bytes as a float; considers endianness
     virtual double readNativeFloat8(ADDRESS nat) = 0;//!< Read 8 bytes as a float; considers endianness
     virtual void writeNative4(ADDRESS nat, uint32_t n)=0;
+    //! Incremented whenever the contents of the image change (writeNative4, reset), so that anything derived from the
+    //! bytes, such as decoded instructions, can tell when it has become stale
+    virtual unsigned getWriteCount() const = 0;
+    //! Host pointer to the \a size bytes at \a nat, or nullptr unless they all have data in the same section
+    virtual const char *getSpan(ADDRESS nat, size_t size) = 0;
+    //! Read the \a count 2 byte words from \a nat on into \a out, considering endianness, converting them all at once;
+    //! false, with \a out untouched, unless they all have data in the same section (see getSpan)
+    virtual bool readNative2Span(ADDRESS nat, uint16_t *out, size_t count) = 0;
+    //! Likewise for 4 byte words
+    virtual bool readNative4Span(ADDRESS nat, uint32_t *out, size_t count) = 0;
 
     virtual bool isReadOnly(ADDRESS uEntry) =0; //!< returns true if the given address is in a read only section
     virtual iterator                begin()       =0;
@@ -7,6 +7,14 @@
 
 class IBinarySymbol  {
 public:
+    //! The attributes that the loaders set on many symbols, which are kept as bits rather than by name
+    enum Flag {
+        IMPORTED = 1,
+        FUNCTION = 2,
+        STATIC_FUNCTION = 4,
+        EXPORT = 8,
+        ENTRY_POINT = 16,
+    };
     virtual ~IBinarySymbol() {}
     virtual const QString &getName() const = 0;
     virtual size_t getSize() const = 0;
@@ -18,6 +26,7 @@ public:
     virtual bool isImported() const = 0;
     virtual QString belongsToSourceFile() const = 0;
     virtual const IBinarySymbol &setAttr(const QString &name,const QVariant &) const = 0;
+    virtual const IBinarySymbol &setFlag(Flag f, bool on = true) const = 0;
     //    virtual IBinarySymbol &setName(const QString &name) = 0;
     //    virtual IBinarySymbol &setSize(size_t sz) = 0;
     virtual bool rename(const QString &s) = 0; //!< Rename an existing symbol
@@ -33,9 +42,16 @@ public:
 public:
     virtual const IBinarySymbol *find(ADDRESS a) const = 0;  //!< Find an entry by address; nullptr if none
     virtual const IBinarySymbol *find(const QString &s) const = 0;  //!< Find an entry by name; NO_ADDRESS if none
+    //! As find(ADDRESS), but only an imported function (an import slot or thunk); nullptr for any other symbol
+    virtual const IBinarySymbol *findImportedFunction(ADDRESS a) const = 0;
     //! Add a new symbol to table, if \a local is set than the symbol is local, thus it won't be
     //! added to global name->symbol mapping
     virtual IBinarySymbol &create(ADDRESS a, const QString &s,bool local=false) = 0;
+    //! As create, but the name is kept as the \a len bytes (UTF-8) at \a name, and only made into a QString when
+    //! first asked for. \a name must stay valid as long as the symbol does (typically: it is in the loaded image)
+    virtual IBinarySymbol &createLazy(ADDRESS a, const char *name, int len, bool local=false) = 0;
+    //! Make room for \a n more symbols; the loaders call this before adding a symbol table in bulk
+    virtual void reserve(size_t n) = 0;
 
     virtual iterator            begin()       = 0;
     virtual const_iterator      begin() const = 0;
@@ -0,0 +1,66 @@
+/***************************************************************************/ /**
+  * \file       MappedImage.h
+  * \brief   The contents of an input file as the loaders see it: mapped into memory rather than read
+  ******************************************************************************/
+
+#ifndef MAPPEDIMAGE_H
+#define MAPPEDIMAGE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QString>
+
+/**
+ * \class MappedImage
+ * The whole of a loader's input file. The file is mapped copy-on-write (QFile::map with MapPrivateOption): pages are
+ * only read once touched, are shared with the page cache until written to, and writes (relocations) stay private to
+ * this process and never reach the file. Where the file can't be mapped, it is read into memory instead.
+ *
+ * Loaders that lay the sections out at their virtual addresses (PE, Mach-O) still need a copy of their own; this is
+ * for those that use the file as it is.
+ */
+class MappedImage {
+    QFile File;
+    uchar *Mapped = nullptr;
+    QByteArray Contents; //!< Only when the file could not be mapped
+    qint64 Size = 0;
+
+  public:
+    MappedImage() = default;
+    MappedImage(const MappedImage &) = delete;
+    MappedImage &operator=(const MappedImage &) = delete;
+    ~MappedImage() { close(); }
+
+    //! Map (or failing that, read) the file \a path. \returns false if it can't be opened or read
+    bool open(const QString &path) {
+        close();
+        File.setFileName(path);
+        if (!File.open(QFile::ReadOnly))
+            return false;
+        Size = File.size();
+        if (Size > 0)
+            Mapped = File.map(0, Size, QFileDevice::MapPrivateOption);
+        if (Mapped == nullptr) {
+            Contents = File.readAll();
+            File.close();
+            if (Contents.size() != Size) {
+                close();
+                return false;
+            }
+        }
+        return true;
+    }
+    void close() {
+        if (Mapped)
+            File.unmap(Mapped);
+        Mapped = nullptr;
+        File.close();
+        Contents.clear();
+        Size = 0;
+    }
+    char *data() { return Mapped ? (char *)Mapped : Contents.data(); }
+    qint64 size() const { return Size; }
+    bool isMapped() const { return Mapped != nullptr; }
+};
+
+#endif // MAPPEDIMAGE_H
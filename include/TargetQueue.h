@@ -3,13 +3,23 @@
 #include "types.h"
 
 #include <queue>
+#include <set>
+#include <vector>
 class Cfg;
 class BasicBlock;
 //! Put the target queue logic into this small class
 class TargetQueue {
     std::queue<ADDRESS> targets;
+    //! One bit per byte of the text section, set while that address is in targets, so that it is queued only once
+    std::vector<bool> queued;
+    ADDRESS textLow = ADDRESS::g(0);
+    std::set<ADDRESS> queuedOutside; //!< Likewise for addresses outside the text section
+
+    bool markQueued(ADDRESS a);
+    void unmarkQueued(ADDRESS a);
 
   public:
+    void setTextLimits(ADDRESS low, ADDRESS high);
     void visit(Cfg *pCfg, ADDRESS uNewAddr, BasicBlock *&pNewBB);
     void initial(ADDRESS uAddr);
     ADDRESS nextAddress(const Cfg &cfg);
@@ -0,0 +1,140 @@
+/***************************************************************************/ /**
+  * \file       arena.h
+  * \brief   Region allocator for the intermediate representation of one procedure
+  ******************************************************************************/
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include "memstats.h"
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * \class Arena
+ * A bump-pointer region allocator. Memory is handed out from large blocks and is never freed one object at a time;
+ * release() gives back all the blocks at once. Before that it runs the destructors of the objects still in the arena,
+ * so that what they hold on the heap (the nodes of the lists of an RTL or a call, the types they refer to) goes too;
+ * those destructors must not delete other objects of the arena, which the IR classes' don't. Each allocation is
+ * preceded by a small header saying how to destroy it (if at all) and how big it is, which is how release() walks
+ * the blocks.
+ *
+ * Each UserProc owns an Arena. While an ArenaScope for it is active, new Exp, Instruction and RTL objects are carved
+ * out of it (see ArenaAllocated); otherwise they come from the ordinary heap. This is off by default and enabled with
+ * the -ia switch, because anything allocated while a procedure is current becomes invalid when that procedure's arena
+ * is released: what outlives it (e.g. the Exps of its signature) must be made on the heap.
+ *
+ * The blocks are aligned to and sized in multiples of BLOCK_SIZE, and which of those chunks of the address space
+ * are in live blocks is kept in a two-level table, so owns() (asked on every delete of an IR object) is two loads.
+ *
+ * With -ih, an arena that has grown past HUGE_BLOCK_SIZE takes its further blocks in that size, aligned to it and
+ * marked for transparent huge pages, so that walking the IR of a large procedure needs far fewer TLB entries. Small
+ * procedures keep their small blocks, which a huge page would mostly waste.
+ */
+class Arena {
+  public:
+    typedef void (*Destroyer)(void *object);
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+  private:
+    static const size_t HUGE_BLOCK_SIZE = 2 * 1024 * 1024; //!< The huge page size of x86-64
+    struct Block {
+        char *start;
+        char *end; //!< Of the objects in it; kept in next while the block is the current one
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t currentBlock = 0; //!< Of the blocks, the one being filled, if next is set
+    char *next = nullptr;    //!< First free byte in the current block
+    char *limit = nullptr;   //!< One past the end of the current block
+    size_t used = 0;         //!< Bytes handed out since the last release()
+    size_t reserved = 0;     //!< Bytes of the blocks held
+    size_t hugeBlocks = 0;   //!< Of the blocks, those marked for huge pages
+
+    char *newBlock(size_t size, bool huge = false);
+
+  public:
+    Arena() {}
+    ~Arena() { release(); }
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t size, Destroyer destroy = nullptr);
+    void release();
+    size_t bytesUsed() const { return used; }
+    size_t bytesReserved() const { return reserved; }
+
+    static Arena *current();
+    static bool owns(const void *p);
+    static void forget(void *object);
+    static void setEnabled(bool b);
+    static bool isEnabled();
+    static void setHugePages(bool b);
+
+    //! The blocks of all arenas, for the memory report
+    struct Totals {
+        size_t arenas = 0;      //!< Arenas holding blocks
+        size_t blocks = 0;
+        size_t hugeBlocks = 0;  //!< Of the blocks, those marked for huge pages
+        size_t reserved = 0;    //!< Bytes of the blocks
+        size_t peakReserved = 0;
+    };
+    static const Totals &getTotals();
+
+    friend class ArenaScope;
+};
+
+/**
+ * \class ArenaScope
+ * Makes an arena current for the lifetime of the object, restoring the previous one afterwards, so scopes nest the
+ * same way as UserProc::decompile() recurses into callees. Constructing one with nullptr (or while arenas are disabled)
+ * sends allocations to the heap; use that around objects that must outlive the procedure, e.g. cached patterns.
+ */
+class ArenaScope {
+    Arena *saved;
+
+  public:
+    //! With \a force, \a a is used even while arenas are disabled; only for objects that are known not to escape it
+    explicit ArenaScope(Arena *a, bool force = false);
+    ~ArenaScope();
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+};
+
+/**
+ * \class ArenaAllocated
+ * Base class giving a class hierarchy arena-aware operator new and delete. Deleting an object that lives in an arena
+ * runs its destructor but keeps its memory, which goes back with the arena; the arena destroys the objects not deleted
+ * when it is released, as their root class (ArenaRoot, which the root of each hierarchy names, and whose destructor
+ * is virtual where the hierarchy has subclasses). The classes of the hierarchy say with ARENA_ALLOCATED_AS what kind
+ * of object MemStats counts them as.
+ */
+class ArenaAllocated {
+  public:
+    static void *allocate(size_t size, MemStats::Kind kind, Arena::Destroyer destroy = nullptr);
+    static void deallocate(void *p, size_t size, MemStats::Kind kind);
+    template <class T> static void destroy(void *p) { static_cast<T *>(p)->~T(); }
+
+    static void *operator new(size_t size) { return allocate(size, MemStats::mkOther); }
+    static void operator delete(void *p, size_t size) { deallocate(p, size, MemStats::mkOther); }
+    // The class operator new hides the global placement form, which is used to change the class of a statement
+    static void *operator new(size_t, void *where) { return where; }
+    static void operator delete(void *, void *) {}
+
+    //! Totals over all objects allocated so far, from arenas and the heap alike (for --stats)
+    static size_t getNumAllocations();
+    static size_t getAllocatedBytes();
+};
+
+//! In the declaration of a class derived from ArenaAllocated: count its objects as of kind \a kind. Deleting through
+//! a pointer to a base class finds these in the class of the object, as the destructors are virtual
+#define ARENA_ALLOCATED_AS(kind)                                                                                       \
+    static void *operator new(size_t size) {                                                                           \
+        return ArenaAllocated::allocate(size, MemStats::kind, &ArenaAllocated::destroy<ArenaRoot>);                    \
+    }                                                                                                                  \
+    static void operator delete(void *p, size_t size) { ArenaAllocated::deallocate(p, size, MemStats::kind); }         \
+    static void *operator new(size_t, void *where) { return where; }                                                   \
+    static void operator delete(void *, void *) {}
+
+#endif // __ARENA_H__
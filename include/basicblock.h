@@ -17,6 +17,8 @@
 
 #include "types.h"
 #include "managed.h" // For LocationSet etc
+#include "memstats.h"
+#include "smallvector.h"
 
 #include <QtCore/QString>
 
@@ -28,6 +30,9 @@ class Function;
 class UserProc;
 struct SWITCH_INFO; // Declared in include/statement.h
 
+//! In- or out-edges of a BasicBlock; nearly all blocks have at most two of each, which are kept in the block itself
+typedef SmallVector<BasicBlock *, 2> BBEdgeList;
+
 /*    *    *    *    *    *    *    *    *    *    *    *    *    *    *    *\
 *                                                             *
 *    e n u m s   u s e d   i n   C f g . h   a n d   h e r e     *
@@ -118,6 +123,7 @@ class BasicBlock {
     friend class Cfg;
 
   public:
+    MEM_COUNTED_AS(mkBasicBlock)
     typedef std::vector<BasicBlock *>::iterator iEdgeIterator;
     typedef std::list<RTL *>::iterator rtlit;
     typedef std::list<RTL *>::reverse_iterator rtlrit;
@@ -129,13 +135,14 @@ class BasicBlock {
     BBTYPE NodeType = BBTYPE::INVALID;         //!< type of basic block
     std::list<RTL *> *ListOfRTLs = nullptr; //!< Ptr to list of RTLs
     int LabelNum = 0;                 //!< Nonzero if start of BB needs label
+    int Index = -1;                   //!< Dense number given by the Cfg, for side tables (see Cfg::getNumBBIndices)
     bool LabelNeeded = false;
     bool Incomplete = true; //!< True if not yet complete
     bool JumpReqd = false;  //!< True if jump required for "fall through"
 
     /* in-edges and out-edges */
-    std::vector<BasicBlock *> InEdges;  //!< Vector of in-edges
-    std::vector<BasicBlock *> OutEdges; //!< Vector of out-edges
+    BBEdgeList InEdges;                //!< Vector of in-edges
+    BBEdgeList OutEdges;               //!< Vector of out-edges
     size_t TargetOutEdges;             //!< support resize() of vectors!
 
     /* for traversal */
@@ -216,11 +223,12 @@ class BasicBlock {
 
     RTL *getRTLWithStatement(Instruction *stmt);
 
-    std::vector<BasicBlock *> &getInEdges();
+    BBEdgeList &getInEdges();
 
     size_t getNumInEdges() const { return InEdges.size(); }
+    int getIndex() const { return Index; }
 
-    const std::vector<BasicBlock *> &getOutEdges();
+    const BBEdgeList &getOutEdges();
     void clearOutEdges() { OutEdges.clear(); } //!<called when noreturn call is found
     void setInEdge(size_t i, BasicBlock *newIn);
     void setOutEdge(size_t i, BasicBlock *newInEdge);
@@ -229,7 +237,7 @@ class BasicBlock {
     int whichPred(BasicBlock *pred);
     void addInEdge(BasicBlock *newInEdge);
     void deleteEdge(BasicBlock *edge);
-    void deleteInEdge(std::vector<BasicBlock *>::iterator &it);
+    void deleteInEdge(BBEdgeList::iterator &it);
     void deleteInEdge(BasicBlock *edge);
     ADDRESS getCallDest();
     Function *getCallDestProc();
@@ -258,7 +266,7 @@ class BasicBlock {
     Exp *getDest() noexcept(false);
     bool isJmpZ(BasicBlock *dest);
     BasicBlock *getLoopBody();
-    void simplify();
+    bool simplify();
     BasicBlock *getCorrectOutEdge(ADDRESS a);
     bool isPostCall();
     static void doAvail(InstructionSet &s, BasicBlock *inEdge);
@@ -288,15 +296,15 @@ class BasicBlock {
     void prependStmt(Instruction *s, UserProc *proc);
 
     // Liveness
-    bool calcLiveness(ConnectionGraph &ig, UserProc *proc);
-    void getLiveOut(LocationSet &live, LocationSet &phiLocs);
+    void getPhiUses(BasicBlock *succ, LocationSet &uses);
 
     bool decodeIndirectJmp(UserProc *proc);
     void processSwitch(UserProc *proc);
     int findNumCases();
     bool undoComputedBB(Instruction *stmt);
-    bool searchAll(const Exp &search_for, std::list<Exp *> &results);
+    bool searchAll(const Exp &search_for, ExpMatchList &results);
     bool searchAndReplace(const Exp &search, Exp *replace);
+    bool searchAndReplaceAll(const ExpReplaceMap &replacements);
 
     void generateCode_Loop(HLLCode *hll, std::list<BasicBlock *> &gotoSet, int indLevel, UserProc *proc,
                            BasicBlock *latch, std::list<BasicBlock *> &followSet);
@@ -31,6 +31,7 @@
 #include "config.h"
 #include "types.h"
 #include "IBoomerang.h"
+#include "decompilercontext.h"
 
 #include <QObject>
 #include <QDir>
@@ -56,45 +57,20 @@ enum LogLevel {
     LL_Warn = 2,
     LL_Error= 3,
 };
-#define LOG Boomerang::get()->log()
+// LOG << a << b; only looks for the log once, and when nothing is to be logged, doesn't evaluate a or b at all. A
+// for statement rather than an if, so that an else after LOG << ...; still belongs to the if of the caller
+#define LOG_IF_ACTIVE(x) for (Log *activeLog_ = DecompilerContext::current()->getActiveLog(x); activeLog_; activeLog_ = nullptr) (*activeLog_)
+#define LOG LOG_IF_ACTIVE(2)
 #define LOG_SEPARATE(x) Boomerang::get()->separate_log(x)
-#define LOG_VERBOSE(x) Boomerang::get()->if_verbose_log(x)
+#define LOG_VERBOSE(x) LOG_IF_ACTIVE(x)
 #define LOGTAIL Boomerang::get()->logTail()
 #define LOG_STREAM Boomerang::get()->getLogStream
 
-/// Virtual class to monitor the decompilation.
-class Watcher {
-public:
-    Watcher() {}
-    virtual ~Watcher() {} // Prevent gcc4 warning
-
-    virtual void alert_complete() {}
-    virtual void alertNew(Function *) {}
-    virtual void alertRemove(Function *) {}
-    virtual void alertUpdateSignature(Function *) {}
-    virtual void alertDecode(ADDRESS /*pc*/, int /*nBytes*/) {}
-    virtual void alertBadDecode(ADDRESS /*pc*/) {}
-    virtual void alertStartDecode(ADDRESS /*start*/, int /*nBytes*/) {}
-    virtual void alertEndDecode() {}
-    virtual void alertDecode(Function *, ADDRESS /*pc*/, ADDRESS /*last*/, int /*nBytes*/) {}
-    virtual void alertStartDecompile(UserProc *) {}
-    virtual void alertProcStatusChange(UserProc *) {}
-    virtual void alertDecompileSSADepth(UserProc *, int /*depth*/) {}
-    virtual void alertDecompileBeforePropagate(UserProc *, int /*depth*/) {}
-    virtual void alertDecompileAfterPropagate(UserProc *, int /*depth*/) {}
-    virtual void alertDecompileAfterRemoveStmts(UserProc *, int /*depth*/) {}
-    virtual void alertEndDecompile(UserProc *) {}
-    virtual void alert_load(Function *) {}
-    virtual void alertConsidering(Function * /*parent*/, Function *) {}
-    virtual void alertDecompiling(UserProc *) {}
-    virtual void alertDecompileDebugPoint(UserProc *, const char * /*description*/) {}
-};
-
 /**
  * Controls the loading, decoding, decompilation and code generation for a program.
- * This is the main class of the decompiler.
+ * This is the main class of the decompiler. It is also the DecompilerContext of the command line session.
  */
-class Boomerang : public QObject,public IBoomerang {
+class Boomerang : public QObject,public IBoomerang,public DecompilerContext {
     Q_OBJECT
 private:
     static Boomerang *boomerang;
@@ -102,8 +78,6 @@ private:
     IBinarySymbolTable *Symbols = nullptr;
     QString progPath;               //!< String with the path to the boomerang executable.
     QString outputPath;             //!< The path where all output files are created.
-    Log *logger = nullptr;          //!< Takes care of the log messages.
-    std::set<Watcher *> watchers;   //!< The watchers which are interested in this decompilation.
 
     /* Documentation about a function should be at one place only
      * So: Document all functions at the point of implementation (in the .c file)
@@ -122,9 +96,7 @@ public:
     IBinarySymbolTable *getSymbols() override;
     int processCommand(QStringList &args);
     static const char *getVersionStr();
-    Log &log();
     SeparateLogger separate_log(const QString &);
-    Log &if_verbose_log(int verbosity_level);
     void setLogger(Log *l);
     bool setOutputDirectory(const QString &path);
 
@@ -140,152 +112,18 @@ public:
     /// Returns the path to where the output files are saved.
     const QString &getOutputPath() { return outputPath; }
     Prog *loadAndDecode(const QString &fname, const char *pname = nullptr);
+    void decode(Prog *prog, const QString &fname, const char *pname = nullptr);
     int decompile(const QString &fname, const char *pname = nullptr);
-    /// Add a Watcher to the set of Watchers for this Boomerang object.
-    void addWatcher(Watcher *watcher) { watchers.insert(watcher); }
     void persistToXML(Prog *prog);
     Prog *loadFromXML(const char *fname);
     void objcDecode(const std::map<QString, ObjcModule> &modules, Prog *prog);
 
-    /// Alert the watchers that decompilation has completed.
-    void alert_complete() {
-        for (Watcher *it : watchers)
-            it->alert_complete();
-    }
-    /// Alert the watchers we have found a new %Proc.
-    void alertNew(Function *p) {
-        for (Watcher *it : watchers)
-            it->alertNew(p);
-    }
-    /// Alert the watchers we have removed a %Proc.
-    void alertRemove(Function *p) {
-        for (Watcher *it : watchers)
-            it->alertRemove(p);
-    }
-    /// Alert the watchers we have updated this Procs signature
-    void alertUpdateSignature(Function *p) {
-        for (Watcher *it : watchers)
-            it->alertUpdateSignature(p);
-    }
-    /// Alert the watchers we are currently decoding \a nBytes bytes at address \a pc.
-    void alertDecode(ADDRESS pc, int nBytes) {
-        for (Watcher *it : watchers)
-            it->alertDecode(pc, nBytes);
-    }
-    /// Alert the watchers of a bad decode of an instruction at \a pc.
-    void alertBadDecode(ADDRESS pc) {
-        for (Watcher *it : watchers)
-            it->alertBadDecode(pc);
-    }
-    /// Alert the watchers we have succesfully decoded this function
-    void alertDecode(Function *p, ADDRESS pc, ADDRESS last, int nBytes) {
-        for (Watcher *it : watchers)
-            it->alertDecode(p, pc, last, nBytes);
-    }
-    /// Alert the watchers we have loaded the Proc.
-    void alertLoad(Function *p) {
-        for (Watcher *it : watchers)
-            it->alert_load(p);
-    }
-    /// Alert the watchers we are starting to decode.
-    void alertStartDecode(ADDRESS start, int nBytes) {
-        for (Watcher *it : watchers)
-            it->alertStartDecode(start, nBytes);
-    }
-    /// Alert the watchers we finished decoding.
-    void alertEndDecode() {
-        for (Watcher *it : watchers)
-            it->alertEndDecode();
-    }
-    virtual void alertStartDecompile(UserProc *p) {
-        for (Watcher *it : watchers)
-            it->alertStartDecompile(p);
-    }
-    virtual void alertProcStatusChange(UserProc *p) {
-        for (Watcher *it : watchers)
-            it->alertProcStatusChange(p);
-    }
-    virtual void alertDecompileSSADepth(UserProc *p, int depth) {
-        for (Watcher *it : watchers)
-            it->alertDecompileSSADepth(p, depth);
-    }
-    virtual void alertDecompileBeforePropagate(UserProc *p, int depth) {
-        for (Watcher *it : watchers)
-            it->alertDecompileBeforePropagate(p, depth);
-    }
-    virtual void alertDecompileAfterPropagate(UserProc *p, int depth) {
-        for (Watcher *it : watchers)
-            it->alertDecompileAfterPropagate(p, depth);
-    }
-    virtual void alertDecompileAfterRemoveStmts(UserProc *p, int depth) {
-        for (Watcher *it : watchers)
-            it->alertDecompileAfterRemoveStmts(p, depth);
-    }
-    virtual void alertEndDecompile(UserProc *p) {
-        for (Watcher *it : watchers)
-            it->alertEndDecompile(p);
-    }
-    virtual void alertConsidering(Function *parent, Function *p) {
-        for (Watcher *it : watchers)
-            it->alertConsidering(parent, p);
-    }
-    virtual void alertDecompiling(UserProc *p) {
-        for (Watcher *it : watchers)
-            it->alertDecompiling(p);
-    }
-    virtual void alertDecompileDebugPoint(UserProc *p, const char *description);
+    void alertDecompileDebugPoint(UserProc *p, const char *description) override;
 
     QTextStream &getLogStream(int level=LL_Default); //!< Return overall logging target
 
     void logTail();
 
-    // Command line flags
-    bool vFlag = false;
-    bool debugSwitch = false;
-    bool debugLiveness = false;
-    bool debugTA = false;
-    bool debugDecoder = false;
-    bool debugProof = false;
-    bool debugUnused = false;
-    bool debugRangeAnalysis = false;
-    bool printRtl = false;
-    bool noBranchSimplify = false;
-    bool noRemoveNull = false;
-    bool noLocals = false;
-    bool noRemoveLabels = false;
-    bool noDataflow = false;
-    bool noDecompile = false;
-    bool stopBeforeDecompile = false;
-    bool traceDecoder = false;
-    /// The file in which the dotty graph is saved
-    QString dotFile;
-    int numToPropagate = -1;
-    bool noPromote = false;
-    bool propOnlyToAll = false;
-    bool debugGen = false;
-    int maxMemDepth = 99;
-    bool noParameterNames = false;
-    bool stopAtDebugPoints = false;
-    /// When true, attempt to decode main, all children, and all procs.
-    /// \a decodeMain is set when there are no -e or -E switches given
-    bool decodeMain = true;
-    bool printAST = false;
-    bool dumpXML = false;
-    bool noRemoveReturns = false;
-    bool decodeThruIndCall = false;
-    bool noDecodeChildren = false;
-    bool loadBeforeDecompile = false;
-    bool saveBeforeDecompile = false;
-    bool noProve = false;
-    bool noChangeSignatures = false;
-    bool conTypeAnalysis = false;
-    bool dfaTypeAnalysis = true;
-    int propMaxDepth = 3; ///< Max depth of expression that'll be propagated to more than one dest
-    bool generateCallGraph = false;
-    bool generateSymbols = false;
-    bool noGlobals = false;
-    bool assumeABI = false;    ///< Assume ABI compliance
-    bool experimental = false; ///< Activate experimental code. Caution!
     QTextStream LogStream;
     QTextStream ErrStream;
     std::vector<ADDRESS> entrypoints;       /// A vector which contains all know entrypoints for the Prog.
@@ -293,18 +131,19 @@ public:
     std::map<ADDRESS, QString> symbols; /// A map to find a name by a given address.
 };
 
-#define VERBOSE (Boomerang::get()->vFlag)
-#define DEBUG_TA (Boomerang::get()->debugTA)
-#define DEBUG_PROOF (Boomerang::get()->debugProof)
-#define DEBUG_UNUSED (Boomerang::get()->debugUnused)
-#define DEBUG_LIVENESS (Boomerang::get()->debugLiveness)
-#define DEBUG_RANGE_ANALYSIS Boomerang::get()->debugRangeAnalysis
-#define DFA_TYPE_ANALYSIS (Boomerang::get()->dfaTypeAnalysis)
-#define CON_TYPE_ANALYSIS (Boomerang::get()->conTypeAnalysis)
-#define ADHOC_TYPE_ANALYSIS (!Boomerang::get()->dfaTypeAnalysis && !Boomerang::get()->conTypeAnalysis)
-#define DEBUG_GEN (Boomerang::get()->debugGen)
-#define DUMP_XML (Boomerang::get()->dumpXML)
-#define DEBUG_SWITCH (Boomerang::get()->debugSwitch)
-#define EXPERIMENTAL (Boomerang::get()->experimental)
+#define VERBOSE (DecompilerContext::current()->vFlag)
+#define DEBUG_TA (DecompilerContext::current()->debugTA)
+#define DEBUG_PROOF (DecompilerContext::current()->debugProof)
+#define DEBUG_UNUSED (DecompilerContext::current()->debugUnused)
+#define DEBUG_LIVENESS (DecompilerContext::current()->debugLiveness)
+#define DEBUG_RANGE_ANALYSIS DecompilerContext::current()->debugRangeAnalysis
+#define DFA_TYPE_ANALYSIS (DecompilerContext::current()->dfaTypeAnalysis)
+#define CON_TYPE_ANALYSIS (DecompilerContext::current()->conTypeAnalysis)
+#define ADHOC_TYPE_ANALYSIS                                                                                            \
+    (!DecompilerContext::current()->dfaTypeAnalysis && !DecompilerContext::current()->conTypeAnalysis)
+#define DEBUG_GEN (DecompilerContext::current()->debugGen)
+#define DUMP_XML (DecompilerContext::current()->dumpXML)
+#define DEBUG_SWITCH (DecompilerContext::current()->debugSwitch)
+#define EXPERIMENTAL (DecompilerContext::current()->experimental)
 
 #endif
@@ -21,10 +21,12 @@
 #include "exphelp.h"    // For lessExpStar
 
 #include <cstdio> // For FILE
+#include <iterator>
 #include <list>
 #include <vector>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <string>
 #define DEBUG_LIVENESS (Boomerang::get()->debugLiveness)
 
@@ -49,8 +51,73 @@ enum class BBTYPE;
 #define BTHEN 0
 #define BELSE 1
 
-// A type for the ADDRESS to BB map
-typedef std::map<ADDRESS, BasicBlock *, std::less<ADDRESS>> MAPBB;
+/// The ADDRESS to BB map. Decoding needs it ordered, to find the BB that contains an address, but most lookups are
+/// for an exact address (Cfg::label(), existsBB(), isIncomplete() and so on, once for each decoded jump target), so
+/// beside the ordered map there is a hash index of its entries. Entries are never moved in a std::map, so the index
+/// holds iterators into it, and find() returns an iterator that can be stepped through the ordered map as usual.
+class BBAddressMap {
+    typedef std::map<ADDRESS, BasicBlock *, std::less<ADDRESS>> Ordered;
+    struct AddrHash {
+        size_t operator()(ADDRESS a) const { return std::hash<ADDRESS::value_type>()(a.m_value); }
+    };
+    Ordered ordered;
+    std::unordered_map<ADDRESS, Ordered::iterator, AddrHash> index;
+
+    void reindex() {
+        index.clear();
+        for (Ordered::iterator it = ordered.begin(); it != ordered.end(); ++it)
+            index.emplace(it->first, it);
+    }
+
+  public:
+    typedef Ordered::iterator iterator;
+    typedef Ordered::const_iterator const_iterator;
+    BBAddressMap() {}
+    BBAddressMap(const BBAddressMap &o) : ordered(o.ordered) { reindex(); }
+    BBAddressMap &operator=(const BBAddressMap &o) {
+        if (this != &o) {
+            ordered = o.ordered;
+            reindex();
+        }
+        return *this;
+    }
+
+    iterator begin() { return ordered.begin(); }
+    iterator end() { return ordered.end(); }
+    const_iterator begin() const { return ordered.begin(); }
+    const_iterator end() const { return ordered.end(); }
+    size_t size() const { return ordered.size(); }
+    bool empty() const { return ordered.empty(); }
+    void clear() {
+        ordered.clear();
+        index.clear();
+    }
+    iterator find(ADDRESS a) {
+        auto ff = index.find(a);
+        return ff == index.end() ? ordered.end() : ff->second;
+    }
+    const_iterator find(ADDRESS a) const {
+        auto ff = index.find(a);
+        return ff == index.end() ? ordered.end() : const_iterator(ff->second);
+    }
+    BasicBlock *&operator[](ADDRESS a) {
+        auto ff = index.find(a);
+        if (ff != index.end())
+            return ff->second->second;
+        iterator it = ordered.insert(std::make_pair(a, (BasicBlock *)nullptr)).first;
+        index.emplace(a, it);
+        return it->second;
+    }
+    size_t erase(ADDRESS a) {
+        auto ff = index.find(a);
+        if (ff == index.end())
+            return 0;
+        ordered.erase(ff->second);
+        index.erase(ff);
+        return 1;
+    }
+};
+typedef BBAddressMap MAPBB;
 typedef std::list<BasicBlock *>::iterator BB_IT;
 typedef std::list<BasicBlock *>::const_iterator BBC_IT;
 
@@ -61,7 +128,29 @@ class Cfg {
     bool structured;
     bool ImplicitsDone;
     int lastLabel;
+    int nextBBIndex = 0; //!< Index for the next BB made; indexes of removed BBs are not reused
+    bool LiveInValid = false; //!< True while the LiveIn sets of the BBs are those that calcLiveIn() last found
+    unsigned Version = 0;     //!< Changes with every change to the BBs or edges
+    bool DFTValid = false;    //!< True if the DFT numbers were set by establishDFTOrder() at DFTVersion
+    unsigned DFTVersion = 0;
+    struct LiveSolution;
+    void solveLiveness(LiveSolution &sol);
+    bool RevDFTValid = false; //!< Likewise for the reverse DFT numbers and establishRevDFTOrder()
+    unsigned RevDFTVersion = 0;
+    bool StampsValid = false; //!< True if the loop stamps and Ordering were set by setTimeStamps() at StampsVersion
+    unsigned StampsVersion = 0;
     UserProc *myProc;
+    //! BBs whose edges or statements have changed since a clean-up last looked at them; see Cfg::touchBB()
+    struct BBWorklist {
+        std::vector<BasicBlock *> bbs;
+        std::vector<bool> queued; //!< By BasicBlock::getIndex()
+        void add(BasicBlock *bb);
+        void remove(BasicBlock *bb);
+        void clear();
+        std::vector<BasicBlock *> take();
+    };
+    BBWorklist CompressWork; //!< For compressCfg()
+    BBWorklist OrphanWork;   //!< For removeOrphanBBs()
     std::list<BasicBlock *> m_listBB;
     std::vector<BasicBlock *> Ordering;
     std::vector<BasicBlock *> revOrdering;
@@ -82,6 +171,8 @@ class Cfg {
     void setProc(UserProc *proc);
     void clear();
     size_t getNumBBs() { return m_listBB.size(); } //!<Get the number of BBs
+    //! One more than the largest BasicBlock::getIndex() in this Cfg, for sizing tables indexed by BB
+    int getNumBBIndices() const { return nextBBIndex; }
     Cfg &operator=(const Cfg &other);        /* Copy constructor */
 
     BasicBlock *newBB(std::list<RTL *> *pRtls, BBTYPE bbType, uint32_t iNumOutEdges) noexcept(false);
@@ -112,6 +203,8 @@ class Cfg {
     bool mergeBBs(BasicBlock *pb1, BasicBlock *pb2);
     bool compressCfg();
     bool establishDFTOrder();
+    bool isDFTOrderValid() const { return DFTValid && DFTVersion == Version; }
+    void invalidateDFTOrder() { DFTValid = RevDFTValid = StampsValid = false; }
     bool establishRevDFTOrder();
 
     int pbbToIndex(BasicBlock *pBB);
@@ -124,7 +217,8 @@ class Cfg {
     void addCall(CallStatement *call);
     sCallStatement &getCalls();
     void searchAndReplace(const Exp &search, Exp *replace);
-    bool searchAll(const Exp &search, std::list<Exp *> &result);
+    void searchAndReplaceAll(const ExpReplaceMap &replacements);
+    bool searchAll(const Exp &search, ExpMatchList &result);
     Exp *getReturnVal();
     void structure();
     void removeJunctionStatements();
@@ -132,12 +226,15 @@ class Cfg {
     //! return a bb given an address
     BasicBlock *bbForAddr(ADDRESS addr) { return m_mapBB[addr]; }
     void simplify();
+    bool simplifyBB(BasicBlock *bb);
+    void touchBB(BasicBlock *bb);
     void undoComputedBB(Instruction *stmt);
 
   private:
     BasicBlock *splitBB(BasicBlock *pBB, ADDRESS uNativeAddr, BasicBlock *pNewBB = 0, bool bDelRtls = false);
     void completeMerge(BasicBlock *pb1, BasicBlock *pb2, bool bDelete = false);
     bool checkEntryBB();
+    void forgetBB(BasicBlock *bb);
 
   public:
     BasicBlock *splitForBranch(BasicBlock *pBB, RTL *rtl, BranchStatement *br1, BranchStatement *br2, BB_IT &it);
@@ -151,9 +248,9 @@ class Cfg {
     void structConds();
     void structLoops();
     void checkConds();
-    void determineLoopType(BasicBlock *header, bool *&loopNodes);
-    void findLoopFollow(BasicBlock *header, bool *&loopNodes);
-    void tagNodesInLoop(BasicBlock *header, bool *&loopNodes);
+    void determineLoopType(BasicBlock *header, std::vector<bool> &loopNodes);
+    void findLoopFollow(BasicBlock *header, std::vector<bool> &loopNodes);
+    void tagNodesInLoop(BasicBlock *header, std::vector<bool> &loopNodes);
 
     void removeUnneededLabels(HLLCode *hll);
     void generateDotFile(QTextStream &of);
@@ -190,15 +287,70 @@ class Cfg {
     void removeImplicitAssign(Exp *x);
     bool implicitsDone() { return ImplicitsDone; }    //!<  True if implicits have been created
     void setImplicitsDone() { ImplicitsDone = true; } //!< Call when implicits have been created
+    //! The version of the BBs and edges; analyses computed at an older version are stale
+    unsigned getVersion() const { return Version; }
+    //! Call after changing the BBs or edges other than through the Cfg, e.g. with BasicBlock::simplify()
+    void setStructureChanged() {
+        Version++;
+        LiveInValid = false;
+    }
+    void calcLiveIn();
+    //! Call when the statements or edges change, so that the next calcLiveIn() solves again
+    void invalidateLiveness() { LiveInValid = false; }
     void findInterferences(ConnectionGraph &ig);
-    void appendBBs(std::list<BasicBlock *> &worklist, std::set<BasicBlock *> &workset);
+    void findLiveAtEntry(LocationSet &live);
+    void appendBBs(std::list<BasicBlock *> &worklist, std::vector<bool> &inWork);
     void removeUsedGlobals(std::set<Global *> &unusedGlobals);
     void bbSearchAll(Exp *search, std::list<Exp *> &result, bool ch);
 
     bool removeOrphanBBs();
 protected:
-    void addBB(BasicBlock *bb) { m_listBB.push_back(bb); }
+    void addBB(BasicBlock *bb);
     friend class XMLProgParser;
 }; /* Cfg */
 
+/***************************************************************************/ /**
+  * A forward range over the statements of a procedure, BB by BB and RTL by RTL, walked in place rather than copied
+  * into a StatementList. The iterator steps past a statement before handing it out, so that statement may be removed
+  * (e.g. with UserProc::removeStatement) without disturbing the walk. No other statement, RTL or BB may be removed
+  * while walking; statements inserted ahead of the walk may or may not be met.
+  ******************************************************************************/
+class StatementRange {
+    BB_IT first, last;
+    UserProc *proc;
+
+  public:
+    class iterator {
+        BB_IT bb, last;
+        UserProc *proc = nullptr;
+        std::list<RTL *> *rtls = nullptr;      // Of *bb, once entered
+        std::list<RTL *>::iterator rtl;
+        std::list<Instruction *>::iterator st; // The statement after cur
+        Instruction *cur = nullptr;             // nullptr at the end
+        void fetch();
+
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Instruction *value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Instruction *const *pointer;
+        typedef Instruction *const &reference;
+
+        iterator() {}
+        iterator(BB_IT first, BB_IT last, UserProc *proc) : bb(first), last(last), proc(proc) { fetch(); }
+        Instruction *operator*() const { return cur; }
+        iterator &operator++() {
+            fetch();
+            return *this;
+        }
+        // A statement is in one place only, so it identifies the position
+        bool operator==(const iterator &other) const { return cur == other.cur; }
+        bool operator!=(const iterator &other) const { return cur != other.cur; }
+    };
+
+    StatementRange(BB_IT first, BB_IT last, UserProc *proc) : first(first), last(last), proc(proc) {}
+    iterator begin() const { return iterator(first, last, proc); }
+    iterator end() const { return iterator(); }
+};
+
 #endif
@@ -15,6 +15,8 @@
 #include "statement.h"
 #include "exphelp.h"
 #include <sstream>
+#include <map>
+#include <vector>
 class Exp;
 class Instruction;
 // This class represents fixed constraints (e.g. Ta = <int>, Tb = <alpha2*>),
@@ -94,6 +96,11 @@ class Constraints {
     ConstraintMap fixed;
     //! EquateMap of locations that are equal
     EquateMap equates;
+    //! Dense id of each type variable (Tloc) appearing in an equate; the classes of equal variables are kept as a
+    //! union-find forest over these ids in parent
+    std::map<Exp *, int, lessExpStar> varIds;
+    std::vector<int> parent;
+    size_t searchSteps = 0; //!< Disjuncts tried so far by doSolve
 
   public:
     Constraints() {}
@@ -116,6 +123,9 @@ class Constraints {
     bool solve(std::list<ConstraintMap> &solns);
 
   private:
+    int getVar(Exp *e);
+    int findClass(int v);
+    void joinClasses(Exp *a, Exp *b);
     bool doSolve(std::list<Exp *>::iterator it, ConstraintMap &extra, std::list<ConstraintMap> &solns);
     //! Test for compatibility of these types. Sometimes, they are compatible
     //! with an extra constraint (e.g. alpha3* is compatible with alpha4* with
@@ -28,17 +28,54 @@ class BasicBlock;
 class Exp;
 class RefExp;
 class Instruction;
+class LivenessSolver;
 class UserProc;
 class PhiAssign;
 class Type;
 class QTextStream;
 
+/**
+ * \class RenameStacks
+ * The stacks of definitions used while renaming: for each location, the statements that define it on the current path
+ * down the dominator tree, innermost last. Each location is given a dense id the first time a definition of it is
+ * pushed, and its stack is kept in a vector under that id, so the location is hashed only once per use or definition;
+ * operations on all the stacks (for childless calls and collectors) are a walk over the vector.
+ */
+class RenameStacks {
+    ExpHashMap<int> ids;
+    std::vector<Exp *> locs;
+    std::vector<std::vector<Instruction *>> defs;
+
+  public:
+    //! Id of the location e, or -1 if nothing has been pushed for it
+    int find(const Exp *e) const {
+        auto it = ids.find(const_cast<Exp *>(e));
+        return it == ids.end() ? -1 : it->second;
+    }
+    int idOf(const Exp *e);
+    size_t size() const { return locs.size(); }
+    Exp *location(int id) const { return locs[id]; }
+    //! Innermost definition of the location with this id, or nullptr if none reaches
+    Instruction *top(int id) const { return defs[id].empty() ? nullptr : defs[id].back(); }
+    //! Innermost definition of e, or nullptr if none reaches
+    Instruction *top(const Exp *e) const {
+        int id = find(e);
+        return id == -1 ? nullptr : top(id);
+    }
+    const std::vector<Instruction *> &stack(int id) const { return defs[id]; }
+    void push(const Exp *e, Instruction *def) { defs[idOf(e)].push_back(def); }
+    void pushAll(Instruction *def);
+    void pop(int id) { defs[id].pop_back(); }
+    void popAll(Instruction *def);
+    void clear();
+};
+
 class DataFlow {
     /******************** Dominance Frontier Data *******************/
 
     /* These first two are not from Appel; they map PBBs to indices */
-    std::vector<BasicBlock *> BBs;       // Pointers to BBs from indices
-    std::map<BasicBlock *, int> indices; // Indices from pointers to BBs
+    std::vector<BasicBlock *> BBs; // Pointers to BBs from indices
+    std::vector<int> indices;      // Indices from BasicBlock::getIndex() values; -1 if not in the cfg
                                          /*
                                           * Calculating the dominance frontier
                                           */
@@ -52,7 +89,10 @@ class DataFlow {
     std::vector<int> vertex;           // ?
     std::vector<int> parent;           // Parent in the dominator tree?
     std::vector<int> best;             // Improves ancestorWithLowestSemi
-    std::vector<std::set<int>> bucket; // Deferred calculation?
+    // Deferred calculation: the nodes whose semi dominator is s, as a list threaded through bucketNext starting at
+    // bucketHead[s] and ending with -1
+    std::vector<int> bucketHead;
+    std::vector<int> bucketNext;
     int N;                             // Current node number in algorithm
     std::vector<std::set<int>> DF;     // The dominance frontiers
 
@@ -73,15 +113,25 @@ class DataFlow {
     /*
      * Renaming variables
      */
-    // The stack which remembers the last definition of an expression.
-    // A map from expression (Exp*) to a stack of (pointers to) Statements
-    std::map<Exp *, std::deque<Instruction *>, lessExpStar> Stacks;
+    // The stack which remembers the last definition of an expression
+    RenameStacks Stacks;
+    // The children of each node in the dominator tree, as lists threaded through domNext starting at domChild[n] and
+    // ending with -1; set up for each renaming
+    std::vector<int> domChild;
+    std::vector<int> domNext;
 
     // Initially false, meaning that locals and parameters are not renamed and hence not propagated.
     // When true, locals and parameters can be renamed if their address does not escape the local procedure.
     // See Mike's thesis for details.
     bool renameLocalsAndParams;
 
+    // The cfg and its version that the dominator tree and frontiers were last computed for
+    const Cfg *domCfg = nullptr;
+    unsigned domVersion = 0;
+
+    bool renameBlock(UserProc *proc, int n);
+    void popBlockDefs(UserProc *proc, int n);
+
   public:
     DataFlow() : renameLocalsAndParams(false) {} // Constructor
                                                  /*
@@ -90,14 +140,18 @@ class DataFlow {
     ~DataFlow();
     void DFS(int p, size_t n);
     void dominators(Cfg *cfg);
+    bool dominatorsValid(const Cfg *cfg) const;
+    void invalidateDominators() { domCfg = nullptr; }
     int ancestorWithLowestSemi(int v);
     void Link(int p, int n);
-    void computeDF(int n);
+    void computeDF();
+    void updateDominators(Cfg *cfg);
     // Place phi functions. Return true if any change
     bool placePhiFunctions(UserProc *proc);
     // Rename variables in basicblock n. Return true if any change made
     bool renameBlockVars(UserProc *proc, int n, bool clearStacks = false);
     bool doesDominate(int n, int w);
+    void findLiveIn(UserProc *proc, const std::map<Exp *, int, lessExpStar> &varNums, LivenessSolver &live);
     void setRenameLocalsParams(bool b) { renameLocalsAndParams = b; }
     bool canRenameLocalsParams() { return renameLocalsAndParams; }
     bool canRename(Exp *e, UserProc *proc);
@@ -109,7 +163,7 @@ class DataFlow {
     void clearA_phi() { A_phi.clear(); }
 
     // For testing:
-    int pbbToNode(BasicBlock *bb) { return indices[bb]; }
+    int pbbToNode(BasicBlock *bb);
     std::set<int> &getDF(size_t node) { return DF[node]; }
     BasicBlock *nodeToBB(size_t node) { return BBs[node]; }
     int getIdom(size_t node) { return idom[node]; }
@@ -138,9 +192,10 @@ class DefCollector {
      * associated CallStatement
      */
     bool initialised;
-    AssignSet defs; //!< The set of definitions.
+    AssignSet defs;      //!< The set of definitions.
+    unsigned generation; //!< Moves whenever definitions are inserted, removed or replaced
   public:
-    DefCollector() : initialised(false) {}
+    DefCollector() : initialised(false), generation(0) {}
     void makeCloneOf(const DefCollector &other);
 
     /*
@@ -148,12 +203,19 @@ class DefCollector {
      */
     bool isInitialised() { return initialised; }
 
+    /*
+     * Return a number that changes whenever the set of definitions does. Changes made through the iterators are
+     * not counted; whoever makes them is expected to know
+     */
+    unsigned getGeneration() const { return generation; }
+
     /*
      * Clear the location set
      */
     void clear() {
         defs.clear();
         initialised = false;
+        generation++;
     }
 
     /*
@@ -180,7 +242,7 @@ class DefCollector {
      * Update the definitions with the current set of reaching definitions
      * proc is the enclosing procedure
      */
-    void updateDefs(std::map<Exp *, std::deque<Instruction *>, lessExpStar> &Stacks, UserProc *proc);
+    void updateDefs(RenameStacks &Stacks, UserProc *proc);
 
     /**
      * Find the definition for a location. If not found, return nullptr
@@ -0,0 +1,49 @@
+/***************************************************************************/ /**
+  * \file       decodecache.h
+  * \brief   On-disk cache of decoded programs, shared between runs on the same binary
+  ******************************************************************************/
+
+#ifndef __DECODECACHE_H__
+#define __DECODECACHE_H__
+
+#include <QString>
+
+#include <cstddef>
+
+class Prog;
+
+/**
+ * \class DecodeCache
+ * Keeps, across runs, the program as Boomerang::loadAndDecode leaves it: its procedures with their CFGs and RTLs, the
+ * entry points and callees found, and its globals. A run on a binary decoded before, typically with other
+ * decompilation options (-nP, -nT, -p...), then goes straight from loading the binary to decompiling it. Enabled with
+ * --decode-cache <dir>.
+ *
+ * Each entry is a directory holding the program in the format of -SD and -LD (see XMLProgParser), named by a hash of
+ * the contents and name of the binary, the SSL file of its machine, the version of Boomerang and the options that
+ * change what is decoded (-e, -E, -s, -sf, -nD, -ic, --lazy-decode, --scan-prologues). The options that only affect
+ * decompilation are not part of the key, so the runs that vary them share the entry.
+ */
+class DecodeCache {
+    QString directory;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t stores = 0;
+
+    QString getEntry(const QString &binary, const char *pname) const;
+
+  public:
+    static DecodeCache &get();
+
+    void setDirectory(const QString &dir);
+    bool isEnabled() const { return !directory.isEmpty(); }
+
+    Prog *restore(const QString &binary, const char *pname);
+    bool store(Prog *prog, const QString &binary, const char *pname);
+
+    size_t getHits() const { return hits; }
+    size_t getMisses() const { return misses; }
+    size_t getStores() const { return stores; }
+};
+
+#endif // __DECODECACHE_H__
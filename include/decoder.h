@@ -19,6 +19,8 @@
 
 #include <list>
 #include <cstddef>
+#include <cstdarg>
+#include <vector>
 #include "types.h"
 #include "rtl.h"
 
@@ -83,6 +85,34 @@ struct DecodeResult {
     ADDRESS forceOutEdge;
 };
 
+/***************************************************************************/ /**
+  * A dense dispatch table for opcodes numbered in a small range, built when the decoder is made from a compact spec:
+  * the code of each opcode, its name in the .ssl file, and flags of the decoder's own. Finding an opcode is then an
+  * index, and its RTL template is bound once (see RTLInstDict::lookupOpcode), not looked up by name for each
+  * instruction decoded. Codes not in the spec are not opcodes.
+  ******************************************************************************/
+class OpcodeTable {
+public:
+    struct Spec {
+        unsigned code;
+        const char *name; //!< Must stay valid, e.g. a literal
+        unsigned flags;
+    };
+    struct Op {
+        const char *name = nullptr;
+        unsigned flags = 0;
+        TableEntry *entry = nullptr; //!< Null if the .ssl file has no such instruction
+    };
+
+private:
+    std::vector<Op> ops;
+
+public:
+    void build(RTLInstDict &dict, const Spec *spec, size_t n);
+    //! The opcode of \a code, or nullptr if there is none
+    const Op *find(unsigned code) const { return code < ops.size() && ops[code].name ? &ops[code] : nullptr; }
+};
+
 /***************************************************************************/ /**
   * The NJMCDecoder class is a class that contains NJMC generated decoding methods.
   ******************************************************************************/
@@ -97,6 +127,15 @@ public:
     //! Decodes the machine instruction at pc and returns an RTL instance for the instruction.
     virtual DecodeResult &decodeInstruction(ADDRESS pc, ptrdiff_t delta) = 0;
 
+    /**
+     * Decodes the straight-line run of instructions at \a pc into \a results: at most \a max of them, none at or
+     * after \a limit, the last being the first that ends a run (see endsRun). Each result is what decodeInstruction
+     * would have returned, and the caller owns its RTL.
+     * \returns how many were decoded; at least one unless \a pc >= \a limit
+     */
+    virtual int decodeRun(ADDRESS pc, ptrdiff_t delta, ADDRESS limit, DecodeResult *results, int max);
+    static bool endsRun(const DecodeResult &res);
+
     /**
      * Disassembles the machine instruction at pc and returns the number of bytes disassembled.
      * Assembler output goes to global _assembly
@@ -108,9 +147,33 @@ public:
     void computedCall(const char *name, int size, Exp *dest, ADDRESS pc, std::list<Instruction *> *stmts,
                       DecodeResult &result);
     Prog *getProg() { return prog; }
+    //! Does the code at host address \a hostPC look like the start of a procedure (a callee prologue)? Used to find
+    //! procedures that are never called directly (see FrontEnd::scanForPrologues)
+    virtual bool isFuncPrologue(ADDRESS /*hostPC*/) { return false; }
+    //! Alignment of the machine's instructions in bytes, i.e. the addresses that can start a procedure
+    virtual int getInstructionAlignment() const { return 4; }
+
+private:
+    std::list<Instruction *> *instantiateArgs(ADDRESS pc, const char *name, TableEntry *entry, va_list args);
 
 protected:
+    //! decodeRun with the decodeInstruction of \a Decoder, called directly when it is final rather than through the
+    //! vtable, so that a run costs one virtual call
+    template <class Decoder>
+    static int decodeRunOf(Decoder *d, ADDRESS pc, ptrdiff_t delta, ADDRESS limit, DecodeResult *results, int max) {
+        int n = 0;
+        while (n < max && pc < limit) {
+            DecodeResult &res(results[n++]);
+            res = d->decodeInstruction(pc, delta);
+            if (endsRun(res))
+                break;
+            pc += res.numBytes;
+        }
+        return n;
+    }
+
     std::list<Instruction *> *instantiate(ADDRESS pc, const char *name, ...);
+    std::list<Instruction *> *instantiate(ADDRESS pc, const OpcodeTable::Op *op, ...);
 
     Exp *instantiateNamedParam(char *name, ...);
 
@@ -0,0 +1,370 @@
+/***************************************************************************/ /**
+  * \file       decompilercontext.h
+  * \brief   The options, log and watchers of one decompilation session
+  ******************************************************************************/
+
+#ifndef __DECOMPILERCONTEXT_H__
+#define __DECOMPILERCONTEXT_H__
+
+#include "log.h"
+#include "types.h"
+
+#include <QtCore/QString>
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <vector>
+
+class Function;
+class UserProc;
+
+/// Whether the per-procedure debugging output (the debug prints of -v and the dot files of -gd) is compiled in. It is
+/// unless configured with -DBOOMERANG_DEBUG_HOOKS=OFF; the code testing it is then dead, and removed by the compiler
+#ifdef BOOMERANG_NO_DEBUG_HOOKS
+#define DEBUG_HOOKS false
+#else
+#define DEBUG_HOOKS true
+#endif
+
+/// Virtual class to monitor the decompilation.
+class Watcher {
+public:
+    Watcher() {}
+    virtual ~Watcher() {} // Prevent gcc4 warning
+
+    virtual void alert_complete() {}
+    //! Asked when the watcher is added: true if it wants alertDecode(ADDRESS, int) for every instruction decoded.
+    //! Those that only show progress should take alertDecodeProgress instead
+    virtual bool wantsInstructionAlerts() const { return false; }
+    //! \a numInsns more instructions, of \a numBytes bytes in all, have been decoded since the last call
+    virtual void alertDecodeProgress(int /*numInsns*/, int /*numBytes*/) {}
+    virtual void alertNew(Function *) {}
+    virtual void alertRemove(Function *) {}
+    virtual void alertUpdateSignature(Function *) {}
+    virtual void alertDecode(ADDRESS /*pc*/, int /*nBytes*/) {}
+    virtual void alertBadDecode(ADDRESS /*pc*/) {}
+    virtual void alertStartDecode(ADDRESS /*start*/, int /*nBytes*/) {}
+    virtual void alertEndDecode() {}
+    virtual void alertDecode(Function *, ADDRESS /*pc*/, ADDRESS /*last*/, int /*nBytes*/) {}
+    virtual void alertStartDecompile(UserProc *) {}
+    virtual void alertProcStatusChange(UserProc *) {}
+    virtual void alertDecompileSSADepth(UserProc *, int /*depth*/) {}
+    virtual void alertDecompileBeforePropagate(UserProc *, int /*depth*/) {}
+    virtual void alertDecompileAfterPropagate(UserProc *, int /*depth*/) {}
+    virtual void alertDecompileAfterRemoveStmts(UserProc *, int /*depth*/) {}
+    virtual void alertEndDecompile(UserProc *) {}
+    virtual void alert_load(Function *) {}
+    virtual void alertConsidering(Function * /*parent*/, Function *) {}
+    virtual void alertDecompiling(UserProc *) {}
+    virtual void alertDecompileDebugPoint(UserProc *, const char * /*description*/) {}
+    virtual void alertStartCodeGen(UserProc *) {}
+    virtual void alertEndCodeGen(UserProc *) {}
+    //! Asked between recursion groups: a proc to decompile, with what it calls, before the others; null for none
+    virtual UserProc *takePreferredProc() { return nullptr; }
+    //! Asked as the decompilation of a proc goes on: true to finish it at the stage it has reached, as when its
+    //! budget runs out (see UserProc::isOverBudget)
+    virtual bool isCancelled(UserProc *) { return false; }
+};
+
+/**
+ * \struct DecompilerOptions
+ * The switches that control decoding and decompilation, as set from the command line.
+ */
+struct DecompilerOptions {
+    bool vFlag = false;
+    bool debugSwitch = false;
+    bool debugLiveness = false;
+    bool debugTA = false;
+    bool debugDecoder = false;
+    bool debugProof = false;
+    bool debugUnused = false;
+    bool debugRangeAnalysis = false;
+    bool printRtl = false;
+    bool noBranchSimplify = false;
+    bool noRemoveNull = false;
+    bool noLocals = false;
+    bool noRemoveLabels = false;
+    bool noDataflow = false;
+    bool noDecompile = false;
+    bool stopBeforeDecompile = false;
+    bool traceDecoder = false;
+    /// The file in which the dotty graph is saved
+    QString dotFile;
+    /// With --debug-proc, the procedures whose debugging output (debug prints, dot files) is wanted; empty for all
+    std::set<QString> debugProcs;
+    bool isDebugProc(const QString &name) const { return debugProcs.empty() || debugProcs.count(name) != 0; }
+    int numToPropagate = -1;
+    bool noPromote = false;
+    bool propOnlyToAll = false;
+    bool debugGen = false;
+    int maxMemDepth = 99;
+    bool noParameterNames = false;
+    bool stopAtDebugPoints = false;
+    /// When true, attempt to decode main, all children, and all procs.
+    /// \a decodeMain is set when there are no -e or -E switches given
+    bool decodeMain = true;
+    bool printAST = false;
+    bool dumpXML = false;
+    bool noRemoveReturns = false;
+    bool decodeThruIndCall = false;
+    bool noDecodeChildren = false;
+    bool loadBeforeDecompile = false;
+    bool saveBeforeDecompile = false;
+    bool noProve = false;
+    bool noChangeSignatures = false;
+    bool conTypeAnalysis = false;
+    bool dfaTypeAnalysis = true;
+    bool roundTypeAnalysis = false; ///< Global type analysis in rounds, merging global types between them
+    int propMaxDepth = 3; ///< Max depth of expression that'll be propagated to more than one dest
+    /// When not 0, propagations to more than one dest are limited by a cost model instead of propMaxDepth: the
+    /// nodes they add to a proc's expressions may total this many per statement (see Instruction::propagateTo)
+    int propGrowthBudget = 0;
+    bool generateCallGraph = false;
+    /// With -gc, -gd and -x, the depth below the entry points that the call graph and the CFGs are written to (0: all)
+    int graphDepth = 0;
+    /// With -gc, -gd and -x, the module whose procs (and their calls) are the only ones written; empty for all
+    QString graphModule;
+    bool generateSymbols = false;
+    bool noGlobals = false;
+    bool assumeABI = false;     ///< Assume ABI compliance
+    bool experimental = false;  ///< Activate experimental code. Caution!
+    bool prunedSSA = false;     ///< Place phi functions only where their location is live
+    bool foldConstants = false; ///< Run sparse conditional constant propagation after the first renaming
+    /// Seconds each procedure may spend in decompilation before it is finished at the stage it has reached (0: none)
+    int procTimeBudget = 0;
+    /// Likewise, as a number of SSA passes and propagations (0: no limit)
+    int procStepBudget = 0;
+    bool streamCode = false; ///< Generate code for procs during decompilation, and free their IR (see ProcStreamer)
+    bool cheapestFirst = false; ///< Decompile the cheapest ready recursion groups first (see ProcScheduler)
+    /// Megabytes the process may hold before the caches that can be rebuilt are dropped (see
+    /// Prog::relieveMemoryPressure); 0 for no limit
+    int maxMemory = 0;
+    bool sslCache = false;   ///< Save the parsed SSL dictionary next to the SSL file, and load it from there
+    /// Read the signatures of the machine on other threads while the binary is loaded (see FrontEnd::Load), keeping
+    /// them in memory as warmCaches does
+    bool prefetch = false;
+    bool lazySignatures = false; ///< Read each library signature file only once one of its names is needed
+    bool signatureDatabases = false; ///< Load the signature files from databases compiled next to them (see sigdb.cpp)
+    bool scanPrologues = false;  ///< Look for procedure prologues in the code no call leads to (see FrontEnd)
+    /// Draft quality (--draft), for a quick first look: one SSA pass and one round of updating the returns, only the
+    /// stack pointer proven preserved, one forward sweep of type analysis and one visit of each proc when removing
+    /// unused returns. The switch also turns on scanPrologues and a small propGrowthBudget
+    bool draft = false;
+    /// Decode a callee when decompilation first reaches it (see Prog::decodeOnDemand), rather than decoding everything
+    /// reachable before decompiling; procs that decompilation never reaches are never decoded
+    bool lazyDecode = false;
+    /// With --shard i/n, decompile only the recursion groups of shard i of n, taking the summaries of the others from
+    /// the --cache that the shards share (see Prog::takeShardGroup); 0 shards means no sharding
+    int shardIndex = 0;
+    int shardCount = 0;
+    bool splitOutput = false;    ///< Write the modules on another thread, with the prototypes in an index header
+    /// Keep the parsed SSL dictionaries and signature files in memory, for the programs decompiled later in this
+    /// process (or its children: see CommandlineDriver::server)
+    bool warmCaches = false;
+    /// Once the output and the reports are written, end the process without destroying the Prog, the caches and the
+    /// other statics (--fast-exit): the operating system takes the memory back in one go
+    bool fastExit = false;
+};
+
+/**
+ * \class DecompilerContext
+ * Everything a decompilation reads that is not part of the program itself: the options, the log and the watchers. The
+ * Boomerang object is the context of the command line session, and the one in effect when no other is. A process that
+ * decompiles several programs at once gives each Prog its own copy (see Prog::setContext()), and makes it current with
+ * a ContextScope on the thread doing the work, so that the VERBOSE, DEBUG_* and LOG macros see that session's
+ * settings.
+ *
+ * Copying a context copies the pointers to its log and watchers; neither is owned by the context.
+ */
+class DecompilerContext : public DecompilerOptions {
+    static thread_local DecompilerContext *currentContext;
+    friend class ContextScope;
+
+  protected:
+    Log *logger = nullptr;         //!< Takes care of the log messages.
+    std::set<Watcher *> watchers;  //!< The watchers which are interested in this decompilation.
+    std::vector<Watcher *> instructionWatchers; //!< Those of them that want an alert per instruction decoded
+
+    //! Decoding progress not yet passed on by flushDecodeProgress(). A session decodes on one thread at a time, so
+    //! these are per session rather than per thread
+    struct DecodeProgress {
+        int insns = 0;
+        int bytes = 0;
+        std::chrono::steady_clock::time_point lastFlush;
+    } decodeProgress;
+    static const int PROGRESS_INSNS = 4096; //!< Pass progress on after this many instructions,
+    static const int PROGRESS_MS = 100;     //!< or after this long, looked at every 256 instructions
+
+    void flushDecodeProgress();
+
+  public:
+    DecompilerContext() {}
+    DecompilerContext(const DecompilerContext &other) = default;
+    virtual ~DecompilerContext() {}
+
+    static DecompilerContext *current();
+
+    Log &log() { return *logger; }
+    Log &if_verbose_log(int verbosity_level);
+    //! The log if messages of \a verbosity_level are to be written, as for if_verbose_log(), else null. This is what
+    //! the LOG and LOG_VERBOSE macros test before they format anything
+    Log *getActiveLog(int verbosity_level) const {
+        if (logger == nullptr || !logger->isEnabled())
+            return nullptr;
+        return verbosity_level == 2 || (verbosity_level == 1 && vFlag) ? logger : nullptr;
+    }
+    //! Send this session's messages to \a l, which the caller keeps ownership of
+    void setLog(Log *l) { logger = l; }
+
+    /// Add a Watcher to the set of Watchers for this session.
+    void addWatcher(Watcher *watcher) {
+        if (watchers.insert(watcher).second && watcher->wantsInstructionAlerts())
+            instructionWatchers.push_back(watcher);
+    }
+    void removeWatcher(Watcher *watcher) {
+        watchers.erase(watcher);
+        instructionWatchers.erase(std::remove(instructionWatchers.begin(), instructionWatchers.end(), watcher),
+                                  instructionWatchers.end());
+    }
+
+    /// Alert the watchers that decompilation has completed.
+    void alert_complete() {
+        for (Watcher *it : watchers)
+            it->alert_complete();
+    }
+    /// Alert the watchers we have found a new %Proc.
+    void alertNew(Function *p) {
+        for (Watcher *it : watchers)
+            it->alertNew(p);
+    }
+    /// Alert the watchers we have removed a %Proc.
+    void alertRemove(Function *p) {
+        for (Watcher *it : watchers)
+            it->alertRemove(p);
+    }
+    /// Alert the watchers we have updated this Procs signature
+    void alertUpdateSignature(Function *p) {
+        for (Watcher *it : watchers)
+            it->alertUpdateSignature(p);
+    }
+    /// Alert the watchers we are currently decoding \a nBytes bytes at address \a pc. Only those that asked for it
+    /// (see Watcher::wantsInstructionAlerts) hear of each instruction; the rest get alertDecodeProgress now and then.
+    void alertDecode(ADDRESS pc, int nBytes) {
+        for (Watcher *it : instructionWatchers)
+            it->alertDecode(pc, nBytes);
+        decodeProgress.insns++;
+        decodeProgress.bytes += nBytes;
+        if (decodeProgress.insns >= PROGRESS_INSNS || (decodeProgress.insns % 256 == 0 &&
+                                                       std::chrono::steady_clock::now() - decodeProgress.lastFlush >=
+                                                           std::chrono::milliseconds(PROGRESS_MS)))
+            flushDecodeProgress();
+    }
+    /// Alert the watchers of a bad decode of an instruction at \a pc.
+    void alertBadDecode(ADDRESS pc) {
+        for (Watcher *it : watchers)
+            it->alertBadDecode(pc);
+    }
+    /// Alert the watchers we have succesfully decoded this function
+    void alertDecode(Function *p, ADDRESS pc, ADDRESS last, int nBytes) {
+        flushDecodeProgress();
+        for (Watcher *it : watchers)
+            it->alertDecode(p, pc, last, nBytes);
+    }
+    /// Alert the watchers we have loaded the Proc.
+    void alertLoad(Function *p) {
+        for (Watcher *it : watchers)
+            it->alert_load(p);
+    }
+    /// Alert the watchers we are starting to decode.
+    void alertStartDecode(ADDRESS start, int nBytes) {
+        for (Watcher *it : watchers)
+            it->alertStartDecode(start, nBytes);
+    }
+    /// Alert the watchers we finished decoding.
+    void alertEndDecode() {
+        flushDecodeProgress();
+        for (Watcher *it : watchers)
+            it->alertEndDecode();
+    }
+    virtual void alertStartDecompile(UserProc *p) {
+        for (Watcher *it : watchers)
+            it->alertStartDecompile(p);
+    }
+    virtual void alertProcStatusChange(UserProc *p) {
+        for (Watcher *it : watchers)
+            it->alertProcStatusChange(p);
+    }
+    virtual void alertDecompileSSADepth(UserProc *p, int depth) {
+        for (Watcher *it : watchers)
+            it->alertDecompileSSADepth(p, depth);
+    }
+    virtual void alertDecompileBeforePropagate(UserProc *p, int depth) {
+        for (Watcher *it : watchers)
+            it->alertDecompileBeforePropagate(p, depth);
+    }
+    virtual void alertDecompileAfterPropagate(UserProc *p, int depth) {
+        for (Watcher *it : watchers)
+            it->alertDecompileAfterPropagate(p, depth);
+    }
+    virtual void alertDecompileAfterRemoveStmts(UserProc *p, int depth) {
+        for (Watcher *it : watchers)
+            it->alertDecompileAfterRemoveStmts(p, depth);
+    }
+    virtual void alertEndDecompile(UserProc *p) {
+        for (Watcher *it : watchers)
+            it->alertEndDecompile(p);
+    }
+    virtual void alertConsidering(Function *parent, Function *p) {
+        for (Watcher *it : watchers)
+            it->alertConsidering(parent, p);
+    }
+    virtual void alertDecompiling(UserProc *p) {
+        for (Watcher *it : watchers)
+            it->alertDecompiling(p);
+    }
+    virtual void alertDecompileDebugPoint(UserProc *p, const char *description);
+    /// Alert the watchers that code is about to be generated for \a p
+    void alertStartCodeGen(UserProc *p) {
+        for (Watcher *it : watchers)
+            it->alertStartCodeGen(p);
+    }
+    /// Alert the watchers that code has been generated for \a p
+    void alertEndCodeGen(UserProc *p) {
+        for (Watcher *it : watchers)
+            it->alertEndCodeGen(p);
+    }
+    /// Collect the procs the watchers want decompiled next, in the order asked for
+    void takePreferredProcs(std::vector<UserProc *> &procs) {
+        for (Watcher *it : watchers) {
+            while (UserProc *p = it->takePreferredProc())
+                procs.push_back(p);
+        }
+    }
+    /// True if a watcher has cancelled the decompilation of \a p
+    bool isCancelled(UserProc *p) {
+        for (Watcher *it : watchers) {
+            if (it->isCancelled(p))
+                return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * \class ContextScope
+ * Makes a context current on this thread for the lifetime of the object, restoring the previous one afterwards, in
+ * the same way as ArenaScope does for arenas.
+ */
+class ContextScope {
+    DecompilerContext *saved;
+
+  public:
+    explicit ContextScope(DecompilerContext *c) : saved(DecompilerContext::currentContext) {
+        DecompilerContext::currentContext = c;
+    }
+    ~ContextScope() { DecompilerContext::currentContext = saved; }
+    ContextScope(const ContextScope &) = delete;
+    ContextScope &operator=(const ContextScope &) = delete;
+};
+
+#endif // __DECOMPILERCONTEXT_H__
@@ -0,0 +1,97 @@
+/***************************************************************************/ /**
+  * \file       densebitset.h
+  * \brief   A bit set over densely numbered elements, for the dataflow solvers
+  ******************************************************************************/
+
+#ifndef __DENSEBITSET_H__
+#define __DENSEBITSET_H__
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * \class DenseBitSet
+ * A set of the numbers below its size, one bit each in 64-bit words. It is the set type of the passes that number
+ * what they track (statements, locations, nodes): the liveness solver, the statement sets of the proc and the
+ * interference matrix of the connection graph.
+ *
+ * The set operations run a word at a time over plain arrays, with no branches in the loops, which compilers turn into
+ * vector code for the target they build for. The operations that a solver iterates to a fixed point return whether
+ * they changed the set, so that no copy is needed to find out.
+ */
+class DenseBitSet {
+  public:
+    static const size_t WORD_BITS = 64;
+
+  private:
+    std::vector<uint64_t> words;
+    size_t numBits = 0;
+
+    static size_t wordsFor(size_t n) { return (n + WORD_BITS - 1) / WORD_BITS; }
+    void clearTail(); // Clear the bits of the last word at or above numBits
+
+  public:
+    DenseBitSet() {}
+    explicit DenseBitSet(size_t n) : words(wordsFor(n), 0), numBits(n) {}
+
+    //! How many numbers the set can hold, not how many it does (see count())
+    size_t size() const { return numBits; }
+    size_t numWords() const { return words.size(); }
+    uint64_t word(size_t w) const { return words[w]; }
+    void resize(size_t n);
+    //! Make the set hold n numbers, none of them in it
+    void assign(size_t n) {
+        words.assign(wordsFor(n), 0);
+        numBits = n;
+    }
+    void resetAll() { words.assign(words.size(), 0); }
+    void clear() {
+        words.clear();
+        numBits = 0;
+    }
+    //! Exchange the contents with \a o; swapping with an empty set frees the memory, which clear() keeps
+    void swap(DenseBitSet &o) {
+        words.swap(o.words);
+        std::swap(numBits, o.numBits);
+    }
+
+    bool test(size_t i) const { return i < numBits && ((words[i / WORD_BITS] >> (i % WORD_BITS)) & 1); }
+    void set(size_t i) {
+        assert(i < numBits);
+        words[i / WORD_BITS] |= uint64_t(1) << (i % WORD_BITS);
+    }
+    void reset(size_t i) {
+        if (i < numBits)
+            words[i / WORD_BITS] &= ~(uint64_t(1) << (i % WORD_BITS));
+    }
+
+    bool none() const;
+    size_t count() const;
+    size_t findNext(size_t from) const;
+    //! The smallest number in the set, or size() if it is empty
+    size_t findFirst() const { return findNext(0); }
+    //! Call f with each number in the set, in increasing order
+    template <class F> void forEach(F f) const {
+        for (size_t w = 0; w < words.size(); w++) {
+            for (uint64_t bits = words[w]; bits; bits &= bits - 1)
+                f(w * WORD_BITS + lowestBit(bits));
+        }
+    }
+
+    bool unite(const DenseBitSet &o);
+    bool subtract(const DenseBitSet &o);
+    bool intersect(const DenseBitSet &o);
+    bool uniteComplement(const DenseBitSet &o);
+    bool assignTransfer(const DenseBitSet &gen, const DenseBitSet &in, const DenseBitSet &kill);
+    bool isSubsetOf(const DenseBitSet &o) const;
+    bool operator==(const DenseBitSet &o) const;
+    bool operator!=(const DenseBitSet &o) const { return !(*this == o); }
+
+    static int popcount(uint64_t w);
+    static int lowestBit(uint64_t w);
+};
+
+#endif // __DENSEBITSET_H__
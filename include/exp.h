@@ -23,9 +23,11 @@
 #include "util.h"
 //#include "statement.h"    // For StmtSet etc
 #include "exphelp.h"
+#include "arena.h"
 //#include "memo.h"
 
 #include <QtCore/QString>
+#include <atomic>
 #include <cstdio>  // For sprintf
 #include <list>
 #include <vector>
@@ -47,6 +49,7 @@ class XMLProgParser;
 class Function;
 class UserProc;
 class Exp;
+template <class V> class ExpWalker;
 #define DEBUG_BUFSIZE 5000 // Size of the debug print buffer
 
 typedef std::unique_ptr<Exp> UniqExp;
@@ -60,14 +63,39 @@ typedef std::shared_ptr<Exp> SharedExp;
   * separate classes, derived from Exp.
   */
 
+//! The most derived class of an Exp, so that its class can be found without a virtual call (see ExpWalker)
+enum class ExpKind : unsigned char { Const, Terminal, TypeVal, Unary, Binary, Ternary, TypedExp, FlagDef, RefExp, Location };
+
 //! class Exp is abstract. However, the constructor can be called from the constructors of derived classes, and virtual
 //! functions not overridden by derived classes can be called
-class Exp : public Printable {
+class Exp : public Printable, public ArenaAllocated {
+  public:
+    typedef Exp ArenaRoot; //!< What an arena destroys the Exps left in it as (see ArenaAllocated)
+    //! Summaries of the whole subtree, for the guards that would otherwise walk it (getMemDepth() etc)
+    struct Props {
+        int memofs = 0;        //!< Number of m[] (what getMemDepth() returns)
+        int complexity = 0;    //!< getComplexityDepth() when no location maps to a symbol
+        int nodes = 0;         //!< Size of the tree, counting every node (see getSize())
+        bool flags = false;    //!< containsFlags()
+        bool badMemof = false; //!< containsBadMemof()
+    };
+
   protected:
     OPER op; // The operator (e.g. opPlus)
+    ExpKind kind; //!< Set by the constructor of each class to that class
     mutable unsigned lexBegin = 0, lexEnd = 0;
+    mutable size_t hashValue = 0; //!< Cached result of hash(); only valid while hashStamp == changeStamp
+    mutable size_t hashStamp = 0;
+    static std::atomic<size_t> changeStamp; //!< Bumped by every in place change to any Exp, on any thread
+    mutable Props propsValue; //!< Cached like hashValue
+    mutable size_t propsStamp = 0;
+
     // Constructor, with ID
-    constexpr Exp(OPER _op) : op(_op) {}
+    constexpr Exp(OPER _op, ExpKind _kind) : op(_op), kind(_kind) {}
+    //! Hash of this node, given the (cached) hashes of the subexpressions. Overridden by classes with more state
+    virtual size_t computeHash() const;
+    //! Props of this node, given the (cached) props of the subexpressions. Leaves have none
+    virtual void computeProps(Props & /*p*/) const {}
 
   public:
     // Virtual destructor
@@ -76,8 +104,39 @@ class Exp : public Printable {
     //! Return the operator. Note: I'd like to make this protected, but then subclasses don't seem to be able to use
     //! it (at least, for subexpressions)
     OPER getOper() const { return op; }
+    ExpKind getKind() const { return kind; }
     const char *getOperName() const;
-    void setOper(OPER x) { op = x; } // A few simplifications use this
+    void setOper(OPER x) { // A few simplifications use this
+        op = x;
+        changed();
+    }
+
+    //! Structural hash, consistent with lessExpStar: expressions that compare equivalent have the same hash.
+    //! Cached in each node. Since a change to a subexpression can't invalidate the ancestors' caches, every in place
+    //! change to any Exp (through the setters, or changed() after writing through refSubExp*) invalidates all of them
+    //! The stamp is read before the hash is worked out, so that a change made meanwhile invalidates it again.
+    size_t hash() const {
+        size_t stamp = changeStamp.load(std::memory_order_relaxed);
+        if (hashStamp != stamp) {
+            hashValue = computeHash();
+            hashStamp = stamp;
+        }
+        return hashValue;
+    }
+    //! Call after changing an Exp other than through its setters, e.g. by writing subExp1 directly or through
+    //! refSubExp1(): a cache filled between the call and the write would be stale
+    static void changed() { changeStamp.fetch_add(1, std::memory_order_relaxed); }
+    //! Cached summary of the subtree; invalidated the same way as hash()
+    const Props &props() const {
+        size_t stamp = changeStamp.load(std::memory_order_relaxed);
+        if (propsStamp != stamp) {
+            propsValue = Props();
+            computeProps(propsValue);
+            propsValue.nodes++;
+            propsStamp = stamp;
+        }
+        return propsValue;
+    }
 
     void setLexBegin(unsigned int n) const { lexBegin = n; }
     void setLexEnd(unsigned int n) const { lexEnd = n; }
@@ -102,6 +161,7 @@ class Exp : public Printable {
 
     //! Clone (make copy of self that can be deleted without affecting self)
     virtual Exp *clone() const = 0;
+    static Exp *outsideArena(Exp *e);
 
     // Comparison
     //! Type sensitive equality
@@ -214,7 +274,7 @@ class Exp : public Printable {
     virtual Exp *match(Exp *pattern);
 
     //! match a string pattern
-    virtual bool match(const QString &pattern, std::map<QString, Exp *> &bindings);
+    bool match(const QString &pattern, std::map<QString, Exp *> &bindings);
 
     //    //    //    //    //    //    //
     //    Search and Replace    //
@@ -227,18 +287,21 @@ class Exp : public Printable {
     // Search for Exp search in this Exp. For each found, add a ptr to the matching expression in result (useful
     // with wildcards).      Does NOT clear result on entry
     bool searchAll(const Exp &search, std::list<Exp *> &result);
+    bool searchAll(const Exp &search, ExpMatchList &result);
 
     //! Search this Exp for *search; if found, replace with *replace
     Exp *searchReplace(const Exp &search, Exp *replace, bool &change);
 
     //! Search *pSrc for *search; for all occurrences, replace with *replace
     Exp *searchReplaceAll(const Exp &search, Exp *replace, bool &change, bool once = false);
+    //! As above, for all the searches in \a replacements at once
+    Exp *searchReplaceAll(const ExpReplaceMap &replacements, bool &change);
 
     // Mostly not for public use. Search for subexpression matches.
-    static void doSearch(const Exp &search, Exp *&pSrc, std::list<Exp **> &li, bool once);
+    static void doSearch(const Exp &search, Exp *&pSrc, ExpSlotList &li, bool once);
 
     // As above.
-    virtual void doSearchChildren(const Exp &, std::list<Exp **> &, bool);
+    virtual void doSearchChildren(const Exp &, ExpSlotList &, bool);
 
     /// Propagate all possible assignments to components of this expression.
     Exp *propagateAll();
@@ -257,6 +320,7 @@ class Exp : public Printable {
     virtual const Exp *getSubExp2() const { return nullptr; }
     virtual Exp *getSubExp3() { return nullptr; }
     virtual const Exp *getSubExp3() const { return nullptr; }
+    //! References to the subexpressions; call changed() after writing through one
     virtual Exp *&refSubExp1();
     virtual Exp *&refSubExp2();
     virtual Exp *&refSubExp3();
@@ -266,8 +330,13 @@ class Exp : public Printable {
 
     // Get the complexity depth. Basically, add one for each unary, binary, or ternary
     int getComplexityDepth(UserProc *proc);
+    //! Upper bound of getComplexityDepth() for any proc, in constant time; locations that map to symbols make the
+    //! real depth smaller
+    int getComplexityBound() const { return props().complexity; }
+    //! Number of nodes of the expression tree, in constant time while nothing changes
+    int getSize() const { return props().nodes; }
     // Get memory depth. Add one for each m[]
-    int getMemDepth();
+    int getMemDepth() const { return props().memofs; }
 
     //    //    //    //    //    //    //
     //    Guarded assignment    //
@@ -284,6 +353,7 @@ class Exp : public Printable {
     static Exp *Accumulate(std::list<Exp *> exprs);
     // Simplify the expression
     Exp *simplify();
+    Exp *simplifyUncached();
     virtual Exp *polySimplify(bool &bMod) {
         bMod = false;
         return this;
@@ -339,9 +409,12 @@ class Exp : public Printable {
     // Note: can change this, so often need to clone before calling
     Exp *bypass();
     void bypassComp();                  // As above, but only the xxx of m[xxx]
-    bool containsFlags();               // Check if this exp contains any flag calls
-    bool containsBadMemof(UserProc *p); // Check if this Exp contains a bare (non subscripted) memof
-    bool containsMemof(UserProc *proc); // Check of this Exp contains any memof at all. Not used.
+    // These three are answered from the cached props, so they don't walk the expression
+    bool containsFlags() const { return props().flags; } // Check if this exp contains any flag calls
+    // Check if this Exp contains a bare (non subscripted) memof
+    bool containsBadMemof(UserProc * /*p*/) const { return props().badMemof; }
+    // Check of this Exp contains any memof at all. Not used.
+    bool containsMemof(UserProc * /*proc*/) const { return props().memofs != 0; }
 
     // Data flow based type analysis (implemented in type/dfa.cpp)
     // Pull type information up the expression tree
@@ -374,10 +447,11 @@ class Const : public Exp {
                        // Don't store string: function could be renamed
         Function *pp;      // Pointer to function
     } u;
-    QString strin;
+    const QString *strin; //!< In the pool of NameTable (counted): copies share it, equal strings are equal pointers
     int conscript; // like a subscript for constants
     SharedType type;    // Constants need types during type analysis
   public:
+    ARENA_ALLOCATED_AS(mkConst)
     // Special constructors overloaded for the various constants
     Const(uint32_t i);
     Const(int i);
@@ -390,8 +464,7 @@ class Const : public Exp {
     // Copy constructor
     Const(const Const &o);
     template <class T> static Const *get(T i) { return new Const(i); }
-
-    // Nothing to destruct: Don't deallocate the string passed to constructor
+    ~Const();
 
     // Clone
     virtual Exp *clone() const;
@@ -405,16 +478,28 @@ class Const : public Exp {
     int getInt() const { return u.i; }
     QWord getLong() const { return u.ll; }
     double getFlt() const { return u.d; }
-    QString getStr() const { return strin; }
+    const QString &getStr() const { return *strin; }
     ADDRESS getAddr() const { return u.a; }
     QString getFuncName() const;
 
     // Set the constant
-    void setInt(int i) { u.i = i; }
-    void setLong(QWord ll) { u.ll = ll; }
-    void setFlt(double d) { u.d = d; }
-    void setStr(const QString &p) { strin = p; }
-    void setAddr(ADDRESS a) { u.a = a; }
+    void setInt(int i) {
+        u.i = i;
+        changed();
+    }
+    void setLong(QWord ll) {
+        u.ll = ll;
+        changed();
+    }
+    void setFlt(double d) {
+        u.d = d;
+        changed();
+    }
+    void setStr(const QString &p);
+    void setAddr(ADDRESS a) {
+        u.a = a;
+        changed();
+    }
 
     // Get and set the type
     SharedType getType() { return type; }
@@ -433,15 +518,18 @@ class Const : public Exp {
     virtual bool accept(ExpVisitor *v);
     virtual Exp *accept(ExpModifier *v);
 
-    virtual bool match(const QString &pattern, std::map<QString, Exp *> &bindings);
 
-    int getConscript() { return conscript; }
-    void setConscript(int cs) { conscript = cs; }
+    int getConscript() const { return conscript; }
+    void setConscript(int cs) {
+        conscript = cs;
+        changed();
+    }
 
     virtual SharedType ascendType();
     virtual void descendType(SharedType parentType, bool &ch, Instruction *s);
 
   protected:
+    size_t computeHash() const override;
     friend class XMLProgParser;
 }; // class Const
 
@@ -450,10 +538,11 @@ class Const : public Exp {
   ******************************************************************************/
 class Terminal : public Exp {
   public:
+    ARENA_ALLOCATED_AS(mkTerminal)
     // Constructors
     Terminal(OPER op);
     Terminal(const Terminal &o); // Copy constructor
-    static Exp *get(OPER op) { return new Terminal(op); }
+    static Exp *get(OPER op);
 
     // Clone
     virtual Exp *clone() const;
@@ -474,7 +563,6 @@ class Terminal : public Exp {
     virtual SharedType ascendType();
     virtual void descendType(SharedType parentType, bool &ch, Instruction *s);
 
-    virtual bool match(const QString &pattern, std::map<QString, Exp *> &bindings);
 
   protected:
     friend class XMLProgParser;
@@ -484,6 +572,8 @@ class Terminal : public Exp {
   * Unary is a subclass of Exp, holding one subexpression
   ******************************************************************************/
 class Unary : public Exp {
+    template <class V> friend class ExpWalker;
+
   protected:
     Exp *subExp1; // One subexpression pointer
 
@@ -491,6 +581,7 @@ class Unary : public Exp {
     Unary(OPER op);
 
   public:
+    ARENA_ALLOCATED_AS(mkUnary)
     // Constructor, with ID and subexpression
     Unary(OPER op, Exp *e);
     // Copy constructor
@@ -518,18 +609,21 @@ class Unary : public Exp {
 
     // Set first subexpression
     void setSubExp1(Exp *e);
-    void setSubExp1ND(Exp *e) { subExp1 = e; }
+    void setSubExp1ND(Exp *e) {
+        subExp1 = e;
+        changed();
+    }
     // Get first subexpression
     Exp *getSubExp1();
     const Exp *getSubExp1() const;
-    // Get a reference to subexpression 1
+    // Get a reference to subexpression 1; call changed() after writing through it
     Exp *&refSubExp1();
 
     virtual Exp *match(Exp *pattern);
-    virtual bool match(const QString &pattern, std::map<QString, Exp *> &bindings);
+    using Exp::match; // The textual patterns
 
     // Search children
-    void doSearchChildren(const Exp &search, std::list<Exp **> &li, bool once);
+    void doSearchChildren(const Exp &search, ExpSlotList &li, bool once);
 
     // Do the work of simplifying this expression
     virtual Exp *polySimplify(bool &bMod);
@@ -548,6 +642,8 @@ class Unary : public Exp {
     virtual void descendType(SharedType parentType, bool &ch, Instruction *s);
 
   protected:
+    size_t computeHash() const override;
+    void computeProps(Props &p) const override;
     friend class XMLProgParser;
 }; // class Unary
 
@@ -555,6 +651,8 @@ class Unary : public Exp {
  * Binary is a subclass of Unary, holding two subexpressions
  */
 class Binary : public Unary {
+    template <class V> friend class ExpWalker;
+
   protected:
     Exp *subExp2; // Second subexpression pointer
 
@@ -562,6 +660,7 @@ class Binary : public Unary {
     Binary(OPER op);
 
   public:
+    ARENA_ALLOCATED_AS(mkBinary)
     // Constructor, with ID and subexpressions
     Binary(OPER op, Exp *e1, Exp *e2);
     // Copy constructor
@@ -594,13 +693,13 @@ class Binary : public Unary {
     Exp *getSubExp2();
     const Exp *getSubExp2() const;
     void commute();     //!< Commute the two operands
-    Exp *&refSubExp2(); //!< Get a reference to subexpression 2
+    Exp *&refSubExp2(); //!< Get a reference to subexpression 2; call changed() after writing through it
 
     virtual Exp *match(Exp *pattern);
-    virtual bool match(const QString &pattern, std::map<QString, Exp *> &bindings);
+    using Exp::match; // The textual patterns
 
     // Search children
-    void doSearchChildren(const Exp &search, std::list<Exp **> &li, bool once);
+    void doSearchChildren(const Exp &search, ExpSlotList &li, bool once);
 
     // Do the work of simplifying this expression
     virtual Exp *polySimplify(bool &bMod);
@@ -622,6 +721,8 @@ class Binary : public Unary {
     Exp *constrainSub(TypeVal *typeVal1, TypeVal *typeVal2);
 
   protected:
+    size_t computeHash() const override;
+    void computeProps(Props &p) const override;
     friend class XMLProgParser;
 }; // class Binary
 
@@ -629,12 +730,14 @@ class Binary : public Unary {
   * Ternary is a subclass of Binary, holding three subexpressions
   ******************************************************************************/
 class Ternary : public Binary {
+    template <class V> friend class ExpWalker;
     Exp *subExp3; // Third subexpression pointer
 
     // Constructor, with operator
     Ternary(OPER op);
 
   public:
+    ARENA_ALLOCATED_AS(mkTernary)
     // Constructor, with operator and subexpressions
     Ternary(OPER op, Exp *e1, Exp *e2, Exp *e3);
     // Copy constructor
@@ -665,11 +768,11 @@ class Ternary : public Binary {
     // Get third subexpression
     Exp *getSubExp3();
     const Exp *getSubExp3() const;
-    // Get a reference to subexpression 3
+    // Get a reference to subexpression 3; call changed() after writing through it
     Exp *&refSubExp3();
 
     // Search children
-    void doSearchChildren(const Exp &search, std::list<Exp **> &li, bool once);
+    void doSearchChildren(const Exp &search, ExpSlotList &li, bool once);
 
     virtual Exp *polySimplify(bool &bMod);
     Exp *simplifyArith();
@@ -682,12 +785,13 @@ class Ternary : public Binary {
     virtual bool accept(ExpVisitor *v);
     virtual Exp *accept(ExpModifier *v);
 
-    virtual bool match(const QString &pattern, std::map<QString, Exp *> &bindings);
 
     virtual SharedType ascendType();
     virtual void descendType(SharedType /*parentType*/, bool &ch, Instruction *s);
 
   protected:
+    size_t computeHash() const override;
+    void computeProps(Props &p) const override;
     friend class XMLProgParser;
 }; // class Ternary
 
@@ -698,6 +802,7 @@ class TypedExp : public Unary {
     SharedType type;
 
   public:
+    ARENA_ALLOCATED_AS(mkTypedExp)
     // Constructor
     TypedExp();
     // Constructor, subexpression
@@ -738,6 +843,7 @@ class TypedExp : public Unary {
     virtual void descendType(SharedType , bool &, Instruction *);
 
   protected:
+    void computeProps(Props &p) const override;
     friend class XMLProgParser;
 }; // class TypedExp
 
@@ -748,6 +854,7 @@ class FlagDef : public Unary {
     RTL *rtl;
 
   public:
+    ARENA_ALLOCATED_AS(mkFlagDef)
     FlagDef(Exp *params, RTL *rtl); // Constructor
     virtual ~FlagDef();             // Destructor
     virtual void appendDotFile(QTextStream &of);
@@ -759,6 +866,7 @@ class FlagDef : public Unary {
     virtual Exp *accept(ExpModifier *v);
 
   protected:
+    void computeProps(Props &p) const override;
     friend class XMLProgParser;
 }; // class FlagDef
 
@@ -772,6 +880,7 @@ class RefExp : public Unary {
     Instruction *def; // The defining statement
 
   public:
+    ARENA_ALLOCATED_AS(mkRefExp)
     // Constructor with expression (e) and statement defining it (def)
     RefExp(Exp *e, Instruction *def);
     // virtual ~RefExp()   {
@@ -789,16 +898,18 @@ class RefExp : public Unary {
     Instruction *getDef() { return def; } // Ugh was called getRef()
     Exp *addSubscript(Instruction *_def) {
         def = _def;
+        changed();
         return this;
     }
     void setDef(Instruction *_def) { /*assert(_def);*/
         def = _def;
+        changed();
     }
     virtual Exp *genConstraints(Exp *restrictTo);
     bool references(Instruction *s) { return def == s; }
     virtual Exp *polySimplify(bool &bMod);
     virtual Exp *match(Exp *pattern);
-    virtual bool match(const QString &pattern, std::map<QString, Exp *> &bindings);
+    using Exp::match; // The textual patterns
 
     // Before type analysis, implicit definitions are nullptr.  During and after TA, they point to an implicit
     // assignment statement.  Don't implement here, since it would require #including of statement.h
@@ -812,7 +923,9 @@ class RefExp : public Unary {
     virtual void descendType(SharedType parentType, bool &ch, Instruction *s);
 
   protected:
-    RefExp() : Unary(opSubscript), def(nullptr) {}
+    RefExp() : Unary(opSubscript), def(nullptr) { kind = ExpKind::RefExp; }
+    size_t computeHash() const override;
+    void computeProps(Props &p) const override;
     friend class XMLProgParser;
 }; // class RefExp
 
@@ -823,6 +936,7 @@ class TypeVal : public Terminal {
     SharedType val;
 
   public:
+    ARENA_ALLOCATED_AS(mkTypeVal)
     TypeVal(SharedType ty);
     ~TypeVal();
 
@@ -851,8 +965,10 @@ class TypeVal : public Terminal {
 class Location : public Unary {
   protected:
     UserProc *proc;
+    void computeProps(Props &p) const override;
 
   public:
+    ARENA_ALLOCATED_AS(mkLocation)
     // Constructor with ID, subexpression, and UserProc*
     Location(OPER op, Exp *e, UserProc *proc);
     // Copy constructor
@@ -880,11 +996,10 @@ class Location : public Unary {
     // Visitation
     virtual bool accept(ExpVisitor *v);
     virtual Exp *accept(ExpModifier *v);
-    virtual bool match(const QString &pattern, std::map<QString, Exp *> &bindings);
 
   protected:
     friend class XMLProgParser;
-    Location(OPER op) : Unary(op), proc(nullptr) {}
+    Location(OPER op) : Unary(op), proc(nullptr) { kind = ExpKind::Location; }
 }; // class Location
 
 typedef std::set<Exp *, lessExpStar> sExp;
@@ -15,8 +15,13 @@
 #ifndef __EXPHELP_H__
 #define __EXPHELP_H__
 
+#include "smallvector.h"
+
+#include <cstddef>
 #include <map>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 class Exp;
 class Assign;
 class Assignment;
@@ -29,6 +34,30 @@ struct lessExpStar : public std::binary_function<Exp *, Exp *, bool> {
     bool operator()(const Exp *x, const Exp *y) const;
 };
 
+/**
+ * Hash and equality of Exp*s (of the actual expressions) for unordered containers; equal means neither is lessExpStar
+ * than the other. These are an alternative to the lessExpStar sets and maps where the iteration order doesn't matter.
+ * Keys must not be changed in place while they are in a container (which is true of the ordered containers as well).
+ */
+struct hashExpStar {
+    size_t operator()(const Exp *e) const;
+};
+struct equalExpStar {
+    bool operator()(const Exp *x, const Exp *y) const;
+};
+typedef std::unordered_set<Exp *, hashExpStar, equalExpStar> ExpHashSet;
+template <class T> using ExpHashMap = std::unordered_map<Exp *, T, hashExpStar, equalExpStar>;
+//! Several searches (without wildcards) and what to replace each of them with, to be made in one walk (see ExpReplacer)
+typedef ExpHashMap<Exp *> ExpReplaceMap;
+
+//! Places where a search (Exp::doSearch) found its target; nearly always zero or one, so these don't need the heap
+typedef SmallVector<Exp **, 4> ExpSlotList;
+//! The matches themselves, as collected by Exp::searchAll
+typedef SmallVector<Exp *, 4> ExpMatchList;
+
+//! Mix the hash value v into seed (as boost::hash_combine does)
+inline size_t hashCombine(size_t seed, size_t v) { return seed ^ (v + 0x9e3779b9 + (seed << 6) + (seed >> 2)); }
+
 struct lessExpShared : public std::binary_function<std::shared_ptr<Exp>, std::shared_ptr<Exp>, bool> {
     bool operator()(const std::shared_ptr<Exp> &x, const std::shared_ptr<Exp> &y) const;
 };
@@ -0,0 +1,71 @@
+/***************************************************************************/ /**
+  * \file       exppattern.h
+  * \brief   Textual expression patterns, parsed once and matched many times
+  ******************************************************************************/
+
+#ifndef __EXPPATTERN_H__
+#define __EXPPATTERN_H__
+
+#include <QtCore/QString>
+#include <array>
+#include <vector>
+
+class Exp;
+class Assign;
+
+/**
+ * \class CompiledPattern
+ * The compiled form of the patterns accepted by Exp::match(const QString &, std::map<QString, Exp *> &). The pattern
+ * is parsed once, when the object is made (or looked up with get()), so matching it costs no string operations, and
+ * the variables are numbered so that their bindings go into a fixed size array instead of a map.
+ *
+ * Syntax, loosest binding first:
+ *  - \a lhs := \a rhs   only at the top level, for matching an Assign with matchAssign()
+ *  - \a x + \a y, \a x - \a y   (left associative)
+ *  - \a x . \a member   member access; \a member is a variable, bound to the name of the member (a Const)
+ *  - a[\a x], m[\a x], r[\a x], \a x[\a y]   address of, memory, register and array index
+ *  - \a x{-}, \a x{\a n}   subscripts; {-} matches only a null definition, {\a n} the statement with number \a n
+ *  - (\a x)   grouping
+ *  - an alphanumeric name starting with a letter is a variable, and matches anything; a variable used twice must
+ *    match equal expressions
+ *  - an integer (decimal, or hexadecimal with 0x) matches an integer constant of that value
+ *  - anything else (e.g. %pc) must equal the printed form of the expression. Literals never bind
+ *
+ * Exp::match(const QString &, std::map<QString, Exp *> &) and Assign::match() compile their patterns with get().
+ */
+class CompiledPattern {
+  public:
+    static const int MAX_VARS = 8;
+    typedef std::array<Exp *, MAX_VARS> Bindings;
+
+  private:
+    enum Kind { Var, IntLiteral, Literal, AddrOf, MemOf, RegOf, Plus, Minus, Member, ArrayIndex, RefNull, RefNum };
+    struct Node {
+        Kind kind;
+        int sub1, sub2; //!< Indexes into nodes, or -1
+        int num;        //!< Variable index for Var and Member, statement number for RefNum, value for IntLiteral
+        QString text;   //!< For Literal
+    };
+    std::vector<Node> nodes;
+    std::vector<QString> varNames;
+    int root = -1;
+    int assignRhs = -1; //!< Root of the right hand side when the pattern is an assignment, else -1
+
+    int parse(const QString &s);
+    int add(Kind k, int sub1 = -1, int sub2 = -1, int num = 0, const QString &text = QString());
+    int var(const QString &name);
+    bool bind(int var, Exp *e, Bindings &b) const;
+    bool matchNode(int n, Exp *e, Bindings &b) const;
+
+  public:
+    explicit CompiledPattern(const QString &pattern);
+    static const CompiledPattern &get(const QString &pattern);
+
+    bool match(Exp *e, Bindings &b) const;
+    bool matchAssign(Assign *a, Bindings &b) const;
+    int varIndex(const QString &name) const;
+    const QString &varName(int i) const { return varNames[i]; }
+    int numVars() const { return (int)varNames.size(); }
+};
+
+#endif // __EXPPATTERN_H__
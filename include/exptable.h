@@ -0,0 +1,58 @@
+/***************************************************************************/ /**
+  * \file       exptable.h
+  * \brief   Hash-consing table for structurally identical expressions
+  ******************************************************************************/
+
+#ifndef __EXPTABLE_H__
+#define __EXPTABLE_H__
+
+#include "operator.h"
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+class Exp;
+
+/**
+ * \class ExpTable
+ * Interning ("hash-consing") table for expressions. Structurally identical expressions handed to intern() come back
+ * as one shared node, built bottom-up so that two interned nodes are equal exactly when their children are the same
+ * pointers.
+ *
+ * Interned nodes are shared, so they must be treated as read-only: clone() before changing one in place (setSubExp*,
+ * refSubExp*, setConscript, fixLocationProc, ...). Since most of the decompiler still modifies expressions in place,
+ * only Terminal::get() interns automatically (Terminals are never modified), and only when the table is enabled with
+ * the -ie switch. Everything else has to be interned explicitly: so far the expressions of the signatures parsed for
+ * warmCaches and --prefetch, which are only ever cloned (see FrontEnd::parseSignatureFile).
+ * Don't intern nodes allocated in a proc's Arena (-ia) unless the table is cleared before that arena is released.
+ */
+class ExpTable {
+    typedef std::unordered_multimap<size_t, Exp *> HashBucket;
+    HashBucket table;               //!< Interned Const/Unary/Binary/Ternary/Location/RefExp nodes keyed by hash
+    std::vector<Exp *> terminals;   //!< Interned Terminals, indexed by operator
+    bool enabled = false;
+    size_t hits = 0;
+    size_t misses = 0;
+
+    static size_t nodeHash(const Exp *e);
+    static bool sameNode(const Exp *a, const Exp *b);
+    static bool isInternable(const Exp *e);
+
+  public:
+    static ExpTable &get();
+
+    void setEnabled(bool b) { enabled = b; }
+    bool isEnabled() const { return enabled; }
+
+    Exp *intern(Exp *e);
+    Exp *terminal(OPER op);
+    bool isInterned(const Exp *e) const;
+
+    size_t size() const;
+    size_t getHits() const { return hits; }
+    size_t getMisses() const { return misses; }
+    void clear();
+};
+
+#endif // __EXPTABLE_H__
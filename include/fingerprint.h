@@ -0,0 +1,54 @@
+/***************************************************************************/ /**
+  * \file       fingerprint.h
+  * \brief   Recognition of statically linked library functions by the bytes they start with
+  ******************************************************************************/
+
+#ifndef __FINGERPRINT_H__
+#define __FINGERPRINT_H__
+
+#include "types.h"
+
+#include <QHash>
+#include <QString>
+
+#include <vector>
+
+class IBinaryImage;
+class LoaderInterface;
+
+/**
+ * \class LibraryFingerprints
+ * Patterns of the library functions (C runtime, compiler support) that statically linked binaries carry, read from
+ * a FLIRT style pattern file. Prog::setNewProc looks a new procedure up here before it is decoded; one that matches
+ * becomes a LibProc with the library name, and so gets the library signature instead of being decompiled.
+ *
+ * A pattern is the first bytes of the function, with the bytes that a linker fills in (relocated addresses and
+ * offsets) masked out, and a CRC16 of the bytes that follow them. Code whose leading bytes hold a relocation the
+ * pattern did not mask does not match: those bytes depend on where it was linked.
+ */
+class LibraryFingerprints {
+    struct Pattern {
+        QByteArray bytes;     //!< The leading bytes, with 0 where masked
+        QByteArray mask;      //!< 1 for each leading byte that must match, 0 for a masked one
+        unsigned crcLength;   //!< How many bytes after the leading ones the CRC covers
+        unsigned short crc;
+        QString name;
+    };
+    std::vector<Pattern> patterns;
+    QHash<unsigned, int> byPrefix;    //!< Index of the first pattern starting with each pair of unmasked bytes
+    std::vector<int> nextWithPrefix;  //!< The next pattern with the same prefix, or -1
+    std::vector<int> maskedPrefix;    //!< The patterns whose first two bytes are not both fixed
+
+    bool matches(const Pattern &p, IBinaryImage *image, LoaderInterface *loader, ADDRESS addr) const;
+
+  public:
+    static unsigned short crc16(const unsigned char *data, size_t len);
+
+    bool read(const QString &path);
+    void clear();
+    bool empty() const { return patterns.empty(); }
+    size_t size() const { return patterns.size(); }
+    QString match(IBinaryImage *image, LoaderInterface *loader, ADDRESS addr) const;
+};
+
+#endif // __FINGERPRINT_H__
@@ -0,0 +1,83 @@
+/***************************************************************************/ /**
+  * \file       flatmap.h
+  * \brief   A map kept as a sorted vector, for maps with only a few entries
+  ******************************************************************************/
+
+#ifndef __FLATMAP_H__
+#define __FLATMAP_H__
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/**
+ * \class FlatMap
+ * Subset of the std::map interface over a vector of (key, value) pairs sorted by key. Iteration order is the same as
+ * for a std::map with the same comparison, but the entries are contiguous, so small maps cost one allocation and
+ * lookups touch no tree nodes. As with a vector, inserting or erasing invalidates iterators and references to the
+ * entries after the point of change.
+ */
+template <class K, class V, class Compare = std::less<K>> class FlatMap {
+  public:
+    typedef std::pair<K, V> value_type;
+    typedef typename std::vector<value_type>::iterator iterator;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+    typedef typename std::vector<value_type>::reverse_iterator reverse_iterator;
+    typedef typename std::vector<value_type>::const_reverse_iterator const_reverse_iterator;
+
+  private:
+    std::vector<value_type> elems;
+
+    struct KeyLess {
+        bool operator()(const value_type &a, const K &b) const { return Compare()(a.first, b); }
+    };
+    iterator lower(const K &k) { return std::lower_bound(elems.begin(), elems.end(), k, KeyLess()); }
+    const_iterator lower(const K &k) const { return std::lower_bound(elems.begin(), elems.end(), k, KeyLess()); }
+
+  public:
+    iterator begin() { return elems.begin(); }
+    iterator end() { return elems.end(); }
+    const_iterator begin() const { return elems.begin(); }
+    const_iterator end() const { return elems.end(); }
+    reverse_iterator rbegin() { return elems.rbegin(); }
+    reverse_iterator rend() { return elems.rend(); }
+    const_reverse_iterator rbegin() const { return elems.rbegin(); }
+    const_reverse_iterator rend() const { return elems.rend(); }
+    size_t size() const { return elems.size(); }
+    bool empty() const { return elems.empty(); }
+    void clear() { elems.clear(); }
+
+    iterator find(const K &k) {
+        iterator it = lower(k);
+        return (it != elems.end() && !Compare()(k, it->first)) ? it : elems.end();
+    }
+    const_iterator find(const K &k) const {
+        const_iterator it = lower(k);
+        return (it != elems.end() && !Compare()(k, it->first)) ? it : elems.end();
+    }
+    size_t count(const K &k) const { return find(k) != end() ? 1 : 0; }
+
+    std::pair<iterator, bool> insert(const value_type &v) {
+        iterator it = lower(v.first);
+        if (it != elems.end() && !Compare()(v.first, it->first))
+            return std::make_pair(it, false);
+        return std::make_pair(elems.insert(it, v), true);
+    }
+    V &operator[](const K &k) {
+        iterator it = lower(k);
+        if (it == elems.end() || Compare()(k, it->first))
+            it = elems.insert(it, value_type(k, V()));
+        return it->second;
+    }
+    iterator erase(iterator it) { return elems.erase(it); }
+    size_t erase(const K &k) {
+        iterator it = find(k);
+        if (it == elems.end())
+            return 0;
+        elems.erase(it);
+        return 1;
+    }
+};
+
+#endif // __FLATMAP_H__
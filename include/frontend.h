@@ -23,12 +23,19 @@
 #include "sigenum.h" // For enums platform and cc
 #include "BinaryFile.h"
 #include "TargetQueue.h"
+#include "MappedImage.h"
+#include "fingerprint.h"
 
 #include <list>
+#include <memory>
 #include <map>
 #include <queue>
+#include <set>
+#include <vector>
 #include <fstream>
+#include <QHash>
 #include <QMap>
+#include <QStringList>
 class UserProc;
 class Function;
 class RTL;
@@ -43,6 +50,9 @@ class Signature;
 class Instruction;
 class CallStatement;
 class SymTab;
+class TaskScheduler;
+class Type;
+typedef std::shared_ptr<Type> SharedType;
 
 // Control flow types
 enum INSTTYPE {
@@ -81,6 +91,67 @@ protected:
     std::map<ADDRESS, QString> refHints;
     // Map from address to previously decoded RTLs for decoded indirect control transfer instructions
     std::map<ADDRESS, RTL *> previouslyDecoded;
+    //! An instruction already decoded: what decodeInstruction returned for it, with the RTL owned by the cache
+    struct CachedDecode {
+        int numBytes;
+        RTL *rtl;
+        int type; //!< The ICLASS of the instruction
+        ADDRESS forceOutEdge;
+    };
+    //! Instructions decoded so far, so that re-decoding a procedure (after switch analysis, for a fragment, ...) need
+    //! not run the decoder again. Emptied whenever the image is written to (see IBinaryImage::getWriteCount)
+    std::map<ADDRESS, CachedDecode> decodeCache;
+    std::set<ADDRESS> uncachedDecodes; //!< Addresses whose decoding depends on more than the bytes (reDecode)
+    unsigned decodeCacheWriteCount = 0;
+    void clearDecodeCache();
+    void cacheDecode(ADDRESS pc, const DecodeResult &res);
+    //! A signature file of the catalog. With --lazy-sigs, it is only read once one of its names is needed
+    struct SignatureFile {
+        QString path;
+        callconv cc;
+        bool read;
+    };
+    std::vector<SignatureFile> signatureFiles;
+    QMap<QString, int> pendingSignatures; //!< Function declared by a file not read yet -> index in signatureFiles
+    QMap<QString, int> pendingTypes;      //!< Likewise for the named types the files define
+    bool readingSignatures = false;       //!< The C parser is not reentrant: no file is read while another is
+
+    //! A signature file as parsed, kept with warmCaches for the front ends that read it later
+    struct ParsedSignatureFile {
+        std::vector<Signature *> signatures; //!< Never handed out: each front end gets clones
+        std::list<std::pair<QString, SharedType>> types; //!< The named types the file defined, in order
+    };
+    static std::map<QString, ParsedSignatureFile> parsedSignatureFiles;
+    static const ParsedSignatureFile &parseSignatureFile(const QString &path, platform plat, callconv cc);
+    static void parseSignatureFile(const QString &path, platform plat, callconv cc, ParsedSignatureFile &file);
+    static std::vector<std::pair<QString, callconv>> getCatalogFiles(const QString &sPath);
+    static std::vector<std::pair<QString, callconv>> getPlatformSignatureFiles(platform plat);
+    static bool useParsedSignatureFiles();
+    static unsigned getParseWorkers();
+    static void prefetch(MACHINE machine, LOAD_FMT format, TaskScheduler &scheduler);
+    static QString getSSLFileName(MACHINE machine);
+
+    void addSignatureFile(const QString &path, callconv cc);
+    void readSignatureFile(int idx);
+    bool resolveNamedType(const QString &name);
+    QByteArray getSignatureIndexKey(const QString &path, callconv cc);
+    static QByteArray getSignatureIndexKey(const QString &path, platform plat, callconv cc);
+
+    //! A signature file compiled for this platform (see sigdb.cpp), kept mapped while its signatures may be needed
+    struct SignatureDatabase {
+        QString path; //!< The signature file it was compiled from
+        MappedImage image;
+    };
+    std::vector<std::unique_ptr<SignatureDatabase>> signatureDatabases;
+    //! Signature of a database not decoded yet -> index in signatureDatabases and offset of its record there
+    QHash<QString, std::pair<int, quint32>> compiledSignatures;
+    static QString getSignatureDatabasePath(const QString &path, platform plat);
+    bool readSignatureDatabase(const QString &path, callconv cc, QStringList *names);
+    Signature *readCompiledSignature(int db, quint32 offset);
+    static bool writeSignatureDatabase(const QString &path, platform plat, callconv cc,
+                                       const ParsedSignatureFile &file);
+    //! Patterns of the library functions statically linked binaries of this platform may hold (signatures/<platform>.pat)
+    LibraryFingerprints fingerprints;
 
 public:
     /*
@@ -109,18 +180,24 @@ public:
     // virtual    int            getInst(int addr);
 
     virtual DecodeResult &decodeInstruction(ADDRESS pc);
+    virtual int decodeRun(ADDRESS pc, DecodeResult *results, int max);
 
     virtual void extraProcessCall(CallStatement * /*call*/, std::list<RTL *> * /*BB_rtls*/) {}
 
     // Accessor function to get the decoder.
     NJMCDecoder *getDecoder() { return decoder; }
 
-    void readLibrarySignatures(const char *sPath, callconv cc); //!< Read library signatures from a file.
+    //! Read library signatures from a file.
+    void readLibrarySignatures(const char *sPath, callconv cc, QStringList *names = nullptr);
     void readLibraryCatalog(const QString &sPath);                 //!< read from a catalog
     void readLibraryCatalog();                                  //!< read from default catalog
+    static void preloadSignatures(TaskScheduler &scheduler);
+    static bool compileSignatureDatabases();
 
     // lookup a library signature by name
     Signature *getLibSignature(const QString &name);
+    //! The library function at \a addr, recognised by its bytes, or an empty string (see LibraryFingerprints)
+    QString findLibraryFunction(ADDRESS addr) const { return fingerprints.match(Image, ldrIface, addr); }
 
     // return a signature that matches the architecture best
     Signature *getDefaultSignature(const QString &name);
@@ -138,6 +215,8 @@ public:
     void decodeOnly(Prog *Program, ADDRESS a);
     // Decode a fragment of a procedure, e.g. for each destination of a switch statement
     void decodeFragment(UserProc *proc, ADDRESS a);
+    // Make a proc of everything in the code sections that starts like one
+    int scanForPrologues();
 
     /**
      * This is the main function for decoding a procedure. It is usually overridden in the derived
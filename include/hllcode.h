@@ -22,6 +22,7 @@
 
 #include <vector>
 #include <cassert>
+#include "arena.h"
 #include "statement.h" // For CallStatement::RetLocs
 
 class BasicBlock;
@@ -37,6 +38,17 @@ class QTextStream;
 // class CallStatement::RetLocs;
 class ReturnStatement;
 
+/**
+ * The elements of the initial value of an array global, produced one at a time as they are written (e.g. straight from
+ * the bytes of a section) so that no opList of them is built first
+ */
+class ArrayInitializer {
+  public:
+    virtual ~ArrayInitializer() {}
+    //! The next element, valid until the following call, or nullptr after the last one
+    virtual const Exp *next() = 0;
+};
+
 class HLLCode {
   protected:
     UserProc *m_proc; // Pointer to the enclosing UserProc
@@ -110,11 +122,23 @@ class HLLCode {
     virtual void AddProcEnd() = 0;
     virtual void AddLocal(const QString &name, SharedType type, bool last = false) = 0;
     virtual void AddGlobal(const QString &name, SharedType type, Exp *init = nullptr) = 0;
+    virtual void AddGlobal(const QString &name, SharedType type, ArrayInitializer &init) = 0;
     virtual void AddPrototype(UserProc *proc) = 0;
 
     // comments
     virtual void AddLineComment(const QString &cmt) = 0;
 
+    // where the code of each statement is (optional)
+    //! Where the code of a statement is in what print() writes, as [begin, end) offsets from its start
+    struct StmtRange {
+        unsigned begin;
+        unsigned end;
+        Instruction *stmt;
+    };
+    virtual void StartStatement(Instruction * /*s*/) {} // Bracket the code generated for one statement
+    virtual void EndStatement() {}
+    virtual void getStmtRanges(std::vector<StmtRange> & /*ranges*/) const {}
+
     /*
      * output functions, pure virtual.
      */
@@ -122,7 +146,8 @@ class HLLCode {
 
 }; // class HLLCode
 
-class SyntaxNode {
+//! Nodes of the trees searched by UserProc::getAST(), which are allocated from an arena of their own
+class SyntaxNode : public ArenaAllocated {
   protected:
     BasicBlock *pbb;
     int nodenum;
@@ -132,6 +157,8 @@ class SyntaxNode {
     int depth;
 
   public:
+    typedef SyntaxNode ArenaRoot; //!< What an arena destroys the nodes left in it as (see ArenaAllocated)
+    ARENA_ALLOCATED_AS(mkSyntaxNode)
     SyntaxNode();
     virtual ~SyntaxNode();
 
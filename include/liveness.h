@@ -0,0 +1,51 @@
+/***************************************************************************/ /**
+  * \file       liveness.h
+  * \brief   A backward liveness solver over bit vectors
+  ******************************************************************************/
+
+#ifndef __LIVENESS_H__
+#define __LIVENESS_H__
+
+#include "densebitset.h"
+
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+/**
+ * \class LivenessSolver
+ * Solves the liveness equations for a graph of nodes (basic blocks), over locations that the caller has numbered
+ * densely:
+ *
+ *     liveOut(n) = union over the successors s of n of (liveIn(s) + edgeUses(n, s))
+ *     liveIn(n)  = uses(n) + (liveOut(n) - defs(n))
+ *
+ * where uses(n) are the locations used in n before any definition of them in n, and edgeUses(n, s) are those used
+ * only along the edge from n to s (the operands of phi functions). Each set is a DenseBitSet. The nodes are visited
+ * in postorder, so that the successors of a node (apart from those along back edges) are done before it, and an
+ * acyclic graph settles in one pass.
+ */
+class LivenessSolver {
+    size_t numLocations = 0;
+    std::vector<std::vector<int>> succs;
+    std::vector<DenseBitSet> useSets, defSets, liveInSets;
+    std::map<std::pair<int, int>, DenseBitSet> edgeUseSets;
+
+  public:
+    void init(size_t numNodes, size_t numLocations);
+    void addSuccessor(int n, int succ) { succs[n].push_back(succ); }
+    void addUse(int n, int loc) { useSets[n].set(loc); }
+    void addEdgeUse(int n, int succ, int loc);
+    //! The uses and definitions of n, for callers that build them as sets
+    DenseBitSet &uses(int n) { return useSets[n]; }
+    DenseBitSet &defs(int n) { return defSets[n]; }
+    size_t getNumLocations() const { return numLocations; }
+    void solve();
+
+    const DenseBitSet &liveIn(int n) const { return liveInSets[n]; }
+    bool isLiveIn(int n, int loc) const { return liveInSets[n].test(loc); }
+    void getLiveOut(int n, DenseBitSet &res) const;
+};
+
+#endif // __LIVENESS_H__
@@ -3,8 +3,11 @@
 #define LOG_H
 
 #include <QString>
+#include <atomic>
 #include <memory>
 #include <fstream>
+#include <string>
+#include <thread>
 
 class Instruction;
 class Exp;
@@ -15,8 +18,11 @@ struct ADDRESS;
 struct Printable;
 typedef std::shared_ptr<Type> SharedType;
 class Log {
+protected:
+    bool enabled = true; //!< False for loggers that throw everything away, so that LOG skips formatting the message
 public:
     Log() {}
+    bool isEnabled() const { return enabled; }
     virtual Log &operator<<(const QString &s) = 0;
     virtual Log &operator<<(const Instruction *s);
     virtual Log &operator<<(const Exp *e);
@@ -31,15 +37,60 @@ public:
     virtual Log &operator<<(const LocationSet *l);
     virtual ~Log() {}
     virtual void tail();
+    //! Wait until everything logged so far has reached its destination
+    virtual void flush() {}
+    //! Write out what is queued and stop the threads of the log, which fork() would not copy; resume() starts them
+    virtual void suspend() {}
+    virtual void resume() {}
+};
+
+/**
+ * \class LogRing
+ * Bytes on their way from the threads that log to the thread that writes them out. Writers claim space with a
+ * compare and swap on \a reserved, copy their bytes in, and then publish them, in the order they were claimed, by
+ * moving \a committed on; the reader takes everything up to \a committed and gives the space back by moving
+ * \a consumed on. Nobody takes a lock: a writer only waits when the ring is full, or for an earlier writer to publish.
+ * The positions only ever grow; they are reduced modulo the (power of two) capacity when the buffer is indexed.
+ */
+class LogRing {
+    static const size_t Capacity = 1 << 20;
+    std::unique_ptr<char[]> data;
+    std::atomic<size_t> reserved;
+    std::atomic<size_t> committed;
+    std::atomic<size_t> consumed;
+
+public:
+    LogRing() : data(new char[Capacity]), reserved(0), committed(0), consumed(0) {}
+    void put(const char *bytes, size_t n);
+    size_t take(std::string &to);
+    //! The position the reader has to reach for everything put so far to have been taken
+    size_t getCommitted() const { return committed.load(std::memory_order_acquire); }
 };
 
+/**
+ * \class FileLogger
+ * The log file of the session ("log" in the output directory). Messages are queued on a LogRing and written by a
+ * thread of its own, so that logging (with -v, a great deal of it) costs the decompiler little more than formatting
+ * the messages. flush() waits for the file to be up to date; it is also done when the program exits.
+ */
 class FileLogger : public Log {
 protected:
     std::ofstream out;
+    LogRing ring;
+    std::atomic<size_t> written; //!< Position in the ring up to which the file has been written
+    std::atomic<bool> stopping;
+    std::thread writer;
+
+    void writeLoop();
+    void start();
+    void stop();
 public:
     FileLogger(); // Implemented in boomerang.cpp
-    virtual ~FileLogger() {}
+    virtual ~FileLogger();
     void tail()  override;
+    void flush() override;
+    void suspend() override { stop(); }
+    void resume() override;
     Log &operator<<(const QString &str)  override;
 };
 class SeparateLogger : public Log {
@@ -54,6 +105,7 @@ public:
 };
 class NullLogger : public Log {
 public:
+    NullLogger() { enabled = false; }
     virtual Log &operator<<(const QString & /*str*/) {
         return *this;
     }
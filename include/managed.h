@@ -11,6 +11,8 @@
   * \file       managed.h
   * \brief   Definition of "managed" classes such as InstructionSet, which feature makeUnion etc
   * CLASSES:        InstructionSet
+  *                StatementTable
+  *                InstructionBitSet
   *                AssignSet
   *                StatementList
   *                StatementVec
@@ -21,14 +23,20 @@
 
 #ifndef __MANAGED_H__
 #define __MANAGED_H__
+#include "densebitset.h"
 #include "exphelp.h" // For lessExpStar
 
+#include <cstdint>
 #include <list>
+#include <map>
 #include <set>
 #include <vector>
 
 class Instruction;
 class Assign;
+class BasicBlock;
+class StatementList;
+enum STMT_KIND : uint8_t;
 class Exp;
 class RefExp;
 class Cfg;
@@ -58,6 +66,87 @@ class InstructionSet : public std::set<Instruction *> {
     void dump();                                 // Print to standard error for debugging
 };                                               // class InstructionSet
 
+/// The statements of one proc by number (see UserProc::numberStatements), so that the side tables of the dataflow
+/// passes can key a statement by its 32-bit number instead of holding a pointer to it. A number belongs to the
+/// statement that was given it; statements that share it (the defines of a call) or have none are not in the table.
+///
+/// Next to each statement the table keeps, as parallel arrays, the fields that whole-proc scans filter on: kind,
+/// enclosing BB and lexical extent. A scan for, say, the branches of a proc then runs over a byte per statement
+/// instead of visiting every Instruction. The arrays are rebuilt by numberStatements() and kept up to date by the
+/// statement setters (see Instruction::noteChanged), UserProc::removeStatement and Cfg::removeBB; statements added
+/// since the last numberStatements() are not in the table yet.
+class StatementTable {
+    std::vector<Instruction *> byNumber; // Stays set after the statement is removed, for the InstructionBitSets
+    std::vector<STMT_KIND> kinds;
+    std::vector<BasicBlock *> bbs;       // nullptr if the statement is not in the proc
+    std::vector<unsigned> lexBegins, lexEnds;
+    std::vector<Instruction *> pending;  // Statements found during a rebuild with a number already taken
+
+    void set(uint32_t n, Instruction *s);
+
+  public:
+    void add(Instruction *s);
+    Instruction *at(uint32_t n) const { return n < byNumber.size() ? byNumber[n] : nullptr; }
+    bool owns(Instruction *s) const; // Is s the statement its number belongs to?
+    uint32_t size() const { return (uint32_t)byNumber.size(); }
+    void clear();
+
+    void beginRebuild();
+    void endRebuild();
+    void update(Instruction *s);
+    void remove(Instruction *s);
+    void getOfKind(STMT_KIND k, StatementList &res) const;
+    Instruction *findAtLex(unsigned begin, unsigned end) const;
+}; // class StatementTable
+
+/// A set of statements of one proc, stored as a bitset indexed by statement number. The numbers are resolved through
+/// the proc's StatementTable, so the set holds no pointer for its numbered members. The set algebra works a word at a
+/// time, and iteration is in statement number order. Statements that don't own a number in the table (implicit
+/// assignments have number 0, and calls share theirs with their defines) are kept in a small InstructionSet on the
+/// side, and come after the numbered ones when iterating. Sets combined with each other must share their table.
+class InstructionBitSet {
+    const StatementTable *table;
+    DenseBitSet bits;                  // Bit n is set if table->at(n) is in the set
+    InstructionSet others;             // Members that can't be keyed by their number
+
+    int limit() const { return (int)bits.size(); }
+    bool has(int n) const { return bits.test(n); }
+    bool isKeyed(Instruction *s) const; // Is s kept as a bit rather than in others?
+
+  public:
+    class const_iterator {
+        const InstructionBitSet *set;
+        int num;                           // Current statement number, or limit() once in others
+        InstructionSet::const_iterator it; // Position in others
+
+      public:
+        const_iterator() : set(nullptr), num(0) {}
+        const_iterator(const InstructionBitSet *s, bool atEnd);
+        Instruction *operator*() const { return num < set->limit() ? set->table->at(num) : *it; }
+        const_iterator &operator++();
+        bool operator==(const const_iterator &o) const { return num == o.num && it == o.it; }
+        bool operator!=(const const_iterator &o) const { return !(*this == o); }
+    };
+
+    explicit InstructionBitSet(const StatementTable &t) : table(&t) {}
+    InstructionBitSet(const StatementTable &t, const InstructionSet &o);
+
+    const_iterator begin() const { return const_iterator(this, false); }
+    const_iterator end() const { return const_iterator(this, true); }
+    void insert(Instruction *s);
+    bool remove(Instruction *s); // Removal; rets false if not found
+    bool exists(Instruction *s) const;
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+    void makeUnion(const InstructionBitSet &other);
+    void makeDiff(const InstructionBitSet &other);
+    void makeIsect(const InstructionBitSet &other);
+    bool isSubSetOf(const InstructionBitSet &other) const;
+    void toSet(InstructionSet &res) const; // Copy the members into res
+}; // class InstructionBitSet
+
 // As above, but the Statements are known to be Assigns, and are sorted sensibly
 class AssignSet : public std::set<Assign *, lessAssign> {
   public:
@@ -157,7 +246,7 @@ class LocationSet {
     iterator begin() { return lset.begin(); }
     iterator end() { return lset.end(); }
     const_iterator begin() const { return lset.begin(); }
-    const_iterator end() const { return lset.begin(); }
+    const_iterator end() const { return lset.end(); }
     void insert(Exp *loc) { lset.insert(loc); }  // Insert the given location
     void remove(Exp *loc);                       // Remove the given location
     void remove(iterator ll) { lset.erase(ll); } // Remove location, given iterator
@@ -183,26 +272,61 @@ class LocationSet {
 /// A class to store connections in a graph, e.g. for interferences of types or live ranges, or the phi_unite relation
 /// that phi statements imply
 /// If a is connected to b, then b is automatically connected to a
-// This is implemented in a std::multimap, even though Appel suggests a bitmap (e.g. std::vector<bool> does this in a
-// space efficient manner), but then you still need maps from expression to bit number. So here a standard map is used,
-// and when a -> b is inserted, b->a is redundantly inserted.
+// Following Appel, the connections are kept in a bitmap: each location is given a number when first connected, and a
+// triangular bit matrix records which pairs are connected. Each location also has a vector of its neighbours, in the
+// order they were connected, for iterating. Iteration visits the locations in lessExpStar order, and for each its
+// neighbours, so each connection is seen twice (as a -> b and b -> a), the same as the multimap this used to be.
+// Very large graphs don't get a matrix, and isConnected() searches the neighbour vectors instead.
 class ConnectionGraph {
-    std::multimap<Exp *, Exp *, lessExpStar> emap; // The map
+    typedef std::map<Exp *, int, lessExpStar> NodeMap;
+    static const size_t MAX_MATRIX_NODES = 8192; // 4MB of matrix
+
+    NodeMap ids;                         // Number of each location
+    std::vector<Exp *> nodes;            // Location with each number
+    std::vector<std::vector<int>> adj;   // Neighbours of each location
+    DenseBitSet matrix;                  // Bit i*(i+1)/2+j is set if i and j (j <= i) are connected
+    bool useMatrix = true;
+
+    int idOf(Exp *e);
+    int findId(const Exp *e) const;
+    bool connected(int i, int j) const;
+    void setBit(int i, int j, bool on);
+    void addEdge(int i, int j);
+    void removeEdge(int i, int j);
+
   public:
-    typedef std::multimap<Exp *, Exp *, lessExpStar>::iterator iterator;
-    typedef std::multimap<Exp *, Exp *, lessExpStar>::const_iterator const_iterator;
+    class iterator {
+        friend class ConnectionGraph;
+        const ConnectionGraph *graph;
+        NodeMap::const_iterator node;
+        size_t idx; // Index into the neighbours of node
+        std::pair<Exp *, Exp *> cur;
+        void settle();
+
+      public:
+        iterator() : graph(nullptr), idx(0) {}
+        iterator(const ConnectionGraph *g, NodeMap::const_iterator n);
+        const std::pair<Exp *, Exp *> &operator*() const { return cur; }
+        const std::pair<Exp *, Exp *> *operator->() const { return &cur; }
+        iterator &operator++();
+        iterator operator++(int) {
+            iterator res(*this);
+            ++*this;
+            return res;
+        }
+        bool operator==(const iterator &o) const { return node == o.node && idx == o.idx; }
+        bool operator!=(const iterator &o) const { return !(*this == o); }
+    };
+    typedef iterator const_iterator;
     ConnectionGraph() {}
 
-    void add(Exp *a, Exp *b); // Add pair with check for existing
     void connect(Exp *a, Exp *b);
-    iterator begin() { return emap.begin(); }
-    iterator end() { return emap.end(); }
-    const_iterator begin() const { return emap.begin(); }
-    const_iterator end() const { return emap.end(); }
+    iterator begin() const { return iterator(this, ids.begin()); }
+    iterator end() const { return iterator(this, ids.end()); }
     int count(Exp *a) const;
     bool isConnected(Exp *a, const Exp &b) const;
     void update(Exp *a, Exp *b, Exp *c);
-    iterator remove(iterator aa); // Remove the mapping at *aa
+    iterator remove(iterator aa); // Remove the connection at *aa
     void dump() const;            // Dump for debugging
 };
 QTextStream &operator<<(QTextStream &os, const AssignSet *as);
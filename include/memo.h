@@ -14,7 +14,11 @@
 
 #ifndef MEMO_H
 #define MEMO_H
+#include <QHash>
+#include <QString>
+
 #include <list>
+#include <vector>
 class Memo {
   public:
     Memo(int m) : mId(m) {}
@@ -43,4 +47,28 @@ class Memoisable {
     std::list<Memo *>::iterator cur_memo;
 };
 
+/**
+ * \class ProcHistory
+ * The states of a proc at the debug points it has passed, as its printed text, so that the steps of its decompilation
+ * can be looked back at. Each line is kept once, in a pool shared by all the snapshots, and a snapshot is the numbers
+ * of its lines: a step that changes a few statements costs those lines and one number per line, rather than another
+ * copy of the proc.
+ */
+class ProcHistory {
+    QHash<QString, unsigned> lineIds;
+    std::vector<QString> lines;
+    struct Snapshot {
+        QString description;
+        std::vector<unsigned> text;
+    };
+    std::vector<Snapshot> snapshots;
+
+  public:
+    void take(const QString &description, const QString &text);
+    size_t size() const { return snapshots.size(); }
+    const QString &getDescription(size_t i) const { return snapshots[i].description; }
+    QString getText(size_t i) const;
+    void clear();
+};
+
 #endif
@@ -0,0 +1,92 @@
+/***************************************************************************/ /**
+  * \file       memstats.h
+  * \brief   Live and peak bytes of the intermediate representation, by kind of object
+  ******************************************************************************/
+
+#ifndef __MEMSTATS_H__
+#define __MEMSTATS_H__
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+/**
+ * \class MemStats
+ * Counts the objects and bytes of each kind of IR object alive (allocated and not yet deleted), and the high-water
+ * mark of the bytes, in total and by kind. The counting is always on and costs a few additions per allocation; the
+ * marks are what StatScope reads, with --memstats, to give each stage of each procedure its peak footprint.
+ *
+ * The classes counted declare their kind with ARENA_ALLOCATED_AS (those living in arenas) or MEM_COUNTED_AS (those on
+ * the heap); types are counted by their constructors, as they are made with std::make_shared. Objects in an arena that
+ * are never deleted stay counted after the arena is released.
+ *
+ * The counts are atomic (and relaxed), as the SSL and signature files are parsed on several threads (see
+ * FrontEnd::preloadSignatures); the peaks are then those of the process, not of the thread of the stage.
+ */
+class MemStats {
+  public:
+    enum Kind {
+        // Exp
+        mkConst, mkTerminal, mkUnary, mkBinary, mkTernary, mkTypedExp, mkFlagDef, mkRefExp, mkTypeVal, mkLocation,
+        // Instruction
+        mkAssign, mkPhiAssign, mkImplicitAssign, mkBoolAssign, mkImpRefStatement, mkGotoStatement,
+        mkJunctionStatement, mkBranchStatement, mkCaseStatement, mkCallStatement, mkReturnStatement,
+        // The rest
+        mkRTL, mkSyntaxNode, mkBasicBlock, mkType, mkOther,
+        NUM_KINDS
+    };
+
+  private:
+    static std::atomic<size_t> liveObjects[NUM_KINDS];
+    static std::atomic<size_t> liveBytes[NUM_KINDS];
+    static std::atomic<size_t> peakBytes[NUM_KINDS];
+    static std::atomic<size_t> totalLive;
+    static std::atomic<size_t> totalPeak;
+
+    friend class StatScope;
+
+    //! Raise \a peak to \a value, unless another thread has raised it higher
+    static void raise(std::atomic<size_t> &peak, size_t value) {
+        size_t cur = peak.load(std::memory_order_relaxed);
+        while (value > cur && !peak.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+        }
+    }
+
+  public:
+    static void allocated(Kind k, size_t size) {
+        liveObjects[k].fetch_add(1, std::memory_order_relaxed);
+        raise(peakBytes[k], liveBytes[k].fetch_add(size, std::memory_order_relaxed) + size);
+        raise(totalPeak, totalLive.fetch_add(size, std::memory_order_relaxed) + size);
+    }
+    static void freed(Kind k, size_t size) {
+        liveObjects[k].fetch_sub(1, std::memory_order_relaxed);
+        liveBytes[k].fetch_sub(size, std::memory_order_relaxed);
+        totalLive.fetch_sub(size, std::memory_order_relaxed);
+    }
+    //! An object of kind \a from made into one of kind \a to in place (see PhiAssign::convertToAssign)
+    static void changed(Kind from, size_t fromSize, Kind to, size_t toSize) {
+        freed(from, fromSize);
+        allocated(to, toSize);
+    }
+
+    static const char *getName(Kind k);
+    static size_t getLiveObjects(Kind k) { return liveObjects[k]; }
+    static size_t getLiveBytes(Kind k) { return liveBytes[k]; }
+    static size_t getTotalLive() { return totalLive; }
+    static size_t getResidentBytes();
+};
+
+//! In the declaration of a heap allocated class: count its objects as of kind \a kind
+#define MEM_COUNTED_AS(kind)                                                                                           \
+    static void *operator new(size_t size) {                                                                           \
+        void *p = ::operator new(size);                                                                                \
+        MemStats::allocated(MemStats::kind, size);                                                                     \
+        return p;                                                                                                      \
+    }                                                                                                                  \
+    static void operator delete(void *p, size_t size) {                                                                \
+        if (p)                                                                                                         \
+            MemStats::freed(MemStats::kind, size);                                                                     \
+        ::operator delete(p);                                                                                          \
+    }
+
+#endif // __MEMSTATS_H__
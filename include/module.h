@@ -31,6 +31,7 @@
 #include <QtCore/QFile>
 
 class XMLProgParser;
+class OutputWriter;
 class Function;
 class Prog;
 class FrontEnd;
@@ -55,6 +56,9 @@ protected:
     QFile out;
     QTextStream strm;
     QString stream_ext;
+    OutputWriter *writer = nullptr; //!< If set, the stream is kept in memory, and handed to it when closed
+    QString buffered;               //!< The contents of the stream with a writer
+    QString bufferedPath;           //!< Where they go; empty while the stream is closed
 public slots:
     void onLibrarySignaturesChanged();
 signals:
@@ -76,7 +80,10 @@ public:
 
     void openStream(const char *ext);
     void openStreams(const char *ext);
+    void closeStream();
     void closeStreams();
+    //! Hand the files of this module to \a w instead of writing them (nullptr to write them again)
+    void setWriter(OutputWriter *w) { writer = w; }
     QTextStream &getStream() { return strm; }
     QString makeDirs();
     QString getOutPath(const char *ext);
@@ -97,6 +104,8 @@ public:
     size_t                  size()  const { return FunctionList.size(); }
     bool                    empty() const { return FunctionList.empty(); }
     Function *              getOrInsertFunction(const QString &name, ADDRESS uNative, bool bLib = false);
+    Function *              createFunction(const QString &name, ADDRESS uNative, bool bLib = false);
+    void                    addFunction(Function *pProc);
     Function *              getFunction(const QString &name);
     Function *              getFunction(ADDRESS loc);
 
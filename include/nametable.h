@@ -0,0 +1,40 @@
+/***************************************************************************/ /**
+  * \file       nametable.h
+  * \brief   Small numbers for the names of procedures and globals
+  ******************************************************************************/
+
+#ifndef __NAMETABLE_H__
+#define __NAMETABLE_H__
+
+#include <QString>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \class NameTable
+ * Interns the names of procedures and globals: each distinct name gets a number, its handle, the first time it is
+ * seen. Maps keyed by name are keyed by the handle instead, so that a lookup hashes the string once, here, and the
+ * maps themselves compare and hash integers. Handles are never reused, and 0 is the handle of no name. The table is
+ * shared by all programs and safe to use from several threads; it takes its lock only while a TaskScheduler runs
+ * tasks on more than one (see TaskScheduler::isParallel()), so a decompilation on one thread does not pay for it.
+ *
+ * The table also keeps the strings of string constants (see Const), apart from the names: pool() gives the one copy
+ * of a string, which never moves or changes, so equal strings have equal pointers. Each copy counts the references
+ * taken by pool() and retain(), and is freed by the release() of the last, so the strings of the expressions of a
+ * finished job (e.g. with --server) do not stay behind.
+ */
+class NameTable {
+  public:
+    typedef uint32_t Handle;
+
+    static Handle intern(const QString &name);
+    static Handle find(const QString &name);
+    static QString getName(Handle h);
+    static const QString *pool(const QString &str);
+    static void retain(const QString *str);
+    static void release(const QString *str);
+    static size_t poolSize();
+};
+
+#endif // __NAMETABLE_H__
@@ -0,0 +1,45 @@
+/***************************************************************************/ /**
+  * \file       outputwriter.h
+  * \brief   Writes finished output files on a thread of their own
+  ******************************************************************************/
+
+#ifndef __OUTPUTWRITER_H__
+#define __OUTPUTWRITER_H__
+
+#include <QtCore/QByteArray>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+#include <list>
+#include <utility>
+
+/**
+ * \class OutputWriter
+ * Takes the contents of output files once they are complete, and writes them to disk in the order they were given,
+ * while the caller goes on generating the next ones. Nothing but the queue is shared with the thread: the contents
+ * are handed over whole, as bytes, and the directories are expected to exist already (see Module::makeDirs()).
+ */
+class OutputWriter : public QThread {
+    QMutex lock;
+    QWaitCondition changed;
+    std::list<std::pair<QString, QByteArray>> pending;
+    bool finishing = false;
+    QStringList failures; //!< Files that could not be written
+
+  protected:
+    virtual void run();
+
+  public:
+    OutputWriter() {}
+    virtual ~OutputWriter() { finish(); }
+
+    void write(const QString &path, const QByteArray &contents);
+    void finish();
+    //! The files that could not be written; only complete once finish() has returned
+    const QStringList &getFailures() const { return failures; }
+};
+
+#endif // __OUTPUTWRITER_H__
@@ -24,6 +24,8 @@
 #include "memo.h"
 #include "dataflow.h"  // For class UseCollector
 #include "statement.h" // For embedded ReturnStatement pointer, etc
+#include "decompilercontext.h" // For DEBUG_HOOKS
+#include "nametable.h"
 
 #include <list>
 #include <vector>
@@ -31,8 +33,10 @@
 #include <set>
 #include <string>
 #include <cassert>
+#include <chrono>
 
 class Prog;
+class DecompilerContext;
 class UserProc;
 class Cfg;
 class BasicBlock;
@@ -47,6 +51,7 @@ class Parameter;
 class Argument;
 class Signature;
 class Module;
+class Global;
 class XMLProgParser;
 class QTextStream;
 class Log;
@@ -65,10 +70,12 @@ public:
 
     void eraseFromParent();
     QString getName() const;
+    NameTable::Handle getNameHandle() const { return nameHandle; } //!< 0 while it is in no Module
     void setName(const QString &nam);
     ADDRESS getNativeAddress() const;
     void setNativeAddress(ADDRESS a);
     Prog *getProg() { return prog; } //!< Get the program this procedure belongs to.
+    DecompilerContext *getContext() const;
     void setProg(Prog *p) { prog = p; }
     Function *getFirstCaller();
     //! Set the first procedure that calls this procedure (or null for main/start).
@@ -77,7 +84,11 @@ public:
             m_firstCaller = p;
     }
     Signature *getSignature() { return signature; } //!< Returns a pointer to the Signature
-    void setSignature(Signature *sig) { signature = sig; }
+    void setSignature(Signature *sig);
+    //! Moves whenever what callers take from this proc (signature, parameters, modifieds, preserved locations) may
+    //! have changed, so that a call can tell whether its arguments and defines need updating again
+    unsigned getSummaryGeneration() const { return summaryGeneration; }
+    void summaryChanged() { ++summaryGeneration; }
 
     virtual void renameParam(const char *oldName, const char *newName);
 
@@ -112,14 +123,16 @@ public:
     // virtual void        addReturn(Exp *e);
     //        void        sortParameters();
 
-    virtual void printCallGraphXML(QTextStream &os, int depth, bool = true);
     void printDetailsXML();
     void clearVisited() { Visited = false; }
+    void setVisited() { Visited = true; }
     bool isVisited() { return Visited; }
 
     Module *getParent() { return Parent; }
     void setParent(Module *c);
     void removeFromParent();
+    void registerName();
+    void unregisterName();
 private:
     virtual void deleteCFG() {}
 protected:
@@ -136,11 +149,13 @@ protected:
     // FIXME: shouldn't provenTrue be in UserProc, with logic associated with the signature doing the equivalent thing
     // for LibProcs?
     mExpExp provenTrue;
+    unsigned summaryGeneration = 0; //!< See getSummaryGeneration()
     // Cache of queries proven false (to save time)
     // mExpExp provenFalse;
     mExpExp recurPremises;
     std::set<CallStatement *> callerSet;
     Module *Parent;
+    NameTable::Handle nameHandle = 0; //!< The name it is kept by in the ProcRegistry of the program, if it is
 
     Function();
 }; // class Proc
@@ -189,6 +204,7 @@ typedef std::list<UserProc *> ProcList;
 class UserProc : public Function {
 protected:
     friend class XMLProgParser;
+    friend class ProcCache;
     Cfg *cfg; //!< The control flow graph.
 
     /**
@@ -206,6 +222,7 @@ protected:
      * This map could be combined with symbolMap below, but beware of parameters (in symbols but not locals)
      */
     std::map<QString, SharedType > locals;
+    void setLocal(const QString &nam, SharedType ty); //!< locals[nam] = ty, and keep maxLocalSize
 
     int nextLocal = 0; //!< Number of the next local. Can't use locals.size() because some get deleted
     int nextParam = 0; //!< Number for param1, param2, etc
@@ -223,6 +240,19 @@ public:
 
 private:
     SymbolMap symbolMap;
+    /**
+     * Indexes of symbolMap, kept up to date by mapSymbolTo, eraseSymbol and clearSymbolMap (so all changes to
+     * symbolMap go through those):
+     * the mappings to each local, by the local's name (for expFromSymbol), and the mappings from stack slots of the form
+     * m[reg{..} - K], by -K (for finding the local that a stack location is in the middle of)
+     */
+    std::multimap<QString, SymbolMap::iterator> symbolsByName;
+    std::multimap<int, SymbolMap::iterator> symbolsByStackOffset;
+    /**
+     * At least the size in bits of the largest type that any local has had, so that looking for the local that a stack
+     * location is in the middle of can stop at locals that are too far away to contain it
+     */
+    size_t maxLocalSize = 0;
     /**
      * The local "symbol table", which is aware of overlaps
      */
@@ -247,17 +277,101 @@ private:
      */
     DataFlow df;
     int stmtNumber;
+    StatementTable stmtTable;
     std::shared_ptr<ProcSet> cycleGrp;
 
+    /**
+     * Region that this procedure's Exps, Instructions and RTLs are allocated from while it is being decoded,
+     * decompiled or generated (only with -ia). Released as a whole by deleteCFG(), once the other procs no longer
+     * refer to it: signatures keep their Exps on the heap, and deleteCFG() detaches the calls to and from this proc.
+     */
+    Arena arena;
+    //! The candidate trees of getAST(), and so the tree it returns, until it is called again
+    Arena astArena;
+
+    /**
+     * The native instructions decoded for this procedure, from their addresses to their sizes in bytes (for the keys
+     * of the ProcCache)
+     */
+    std::map<ADDRESS, unsigned> decodedInsns;
+    bool fromCache = false; //!< True if the results of decompiling this proc were restored by the ProcCache
+    bool unusedLocalsRemoved = false; //!< Done by fromSSAform(), so generateCode() need not do it again
+    //! The signature class that Signature::promote() found this proc qualifies for (-1 until it looks), and the
+    //! summary generation it found it at: what is proven about the entry and exit, which the tests use, moves that
+    int promotionKind = -1;
+    unsigned promotionGeneration = 0;
+
+    /**
+     * Results of prove(), keyed by the query and the premises and proven equations in force (see getProofKey()). They
+     * stay valid while the statements of this proc are unchanged; validateProofs() checks that with a fingerprint.
+     */
+    std::map<QString, bool> proofResults;
+    QByteArray proofFingerprint;
+    QString getProofKey(const Exp *query) const;
+    QByteArray getFingerprint(bool withProofs);
+
+    /**
+     * The decompilation budget of this proc (see DecompilerOptions::procTimeBudget and procStepBudget): when it was
+     * started, the SSA passes and propagations done since, and whether it has run out. Once it has, no further
+     * passes or propagations are done, and the proc is finished with what it has.
+     */
+    std::chrono::steady_clock::time_point budgetStart;
+    unsigned budgetSteps = 0;
+    bool budgetExhausted = false;
+    bool degraded = false; //!< Known from a profile to exhaust its budget: start with it exhausted
+    //! Nodes that propagations to more than one dest may still add to the expressions (with propGrowthBudget), or -1
+    //! until the first propagation sets it from the number of statements
+    long propGrowthLeft = -1;
+    //! Whether the statements have use lists (see buildUseLists()), which removeStatement() then keeps up to date
+    bool useLists = false;
+    void startBudget();
+    bool isOverBudget();
+    bool takeBudgetStep();
+
+    //! The references to each global from the statements, as last counted into the globals by Prog::countGlobalRefs()
+    std::map<Global *, int> globalRefs;
+    //! The generations of the summaries of the callees (see Function::getSummaryGeneration()) and of the types of the
+    //! globals (see Global::getTypeGeneration()) that the last decompilation of this proc used
+    std::map<Function *, unsigned> consumedSummaries;
+    std::map<Global *, unsigned> consumedGlobals;
+    ProcHistory history; //!< The proc at the debug points it stopped at (see takeSnapshot())
+
 public:
     UserProc(Module *mod, const QString &name, ADDRESS address);
+    std::map<Global *, int> &getGlobalRefs() { return globalRefs; }
+    void takeSnapshot(const char *description);
+    const ProcHistory &getHistory() const { return history; }
     virtual ~UserProc();
     void setDecoded();
     void unDecode();
+    void forgetDecompilation();
+    void recordConsumedSummaries();
+    bool consumesStaleSummaries() const;
+    void refreshConsumedSummary(Function *callee);
+    void printCallerSummary(QTextStream &out) const;
     //! Returns a pointer to the CFG object.
     Cfg *getCFG() { return cfg; }
     //! Returns a pointer to the DataFlow object.
     DataFlow *getDataFlow() { return &df; }
+    //! Returns the arena that IR for this procedure is allocated from (see ArenaScope)
+    Arena *getArena() { return &arena; }
+    void addDecodedInsn(ADDRESS a, unsigned numBytes) { decodedInsns[a] = numBytes; }
+    const std::map<ADDRESS, unsigned> &getDecodedInsns() const { return decodedInsns; }
+    bool isFromCache() const { return fromCache; }
+    void setFromCache() { fromCache = true; }
+    //! Set kind to what Signature::promote() last found, if nothing it depends on has changed since
+    bool getCachedPromotion(int &kind) const {
+        kind = promotionKind;
+        return promotionKind >= 0 && promotionGeneration == summaryGeneration;
+    }
+    void setCachedPromotion(int kind) {
+        promotionKind = kind;
+        promotionGeneration = summaryGeneration;
+    }
+    bool isBudgetExhausted() const { return budgetExhausted; }
+    //! Finish this proc at the stage it reaches without propagating, as if its budget had run out at the start
+    void startDegraded() { degraded = true; }
+    bool takePropagationGrowth(long nodes);
     void deleteCFG() override;
     virtual bool isNoReturn();
 
@@ -269,6 +383,8 @@ public:
     bool isDecompiled() { return status >= PROC_FINAL; }
     bool isEarlyRecursive() const { return cycleGrp != nullptr && status <= PROC_INCYCLE; }
     bool doesRecurseTo(UserProc *p) { return cycleGrp && cycleGrp->find(p) != cycleGrp->end(); }
+    void setCycleGroup(const std::shared_ptr<ProcSet> &grp) { cycleGrp = grp; }
+    const std::shared_ptr<ProcSet> &getCycleGroup() const { return cycleGrp; }
 
     bool isSorted() { return status >= PROC_SORTED; }
     void setSorted() { setStatus(PROC_SORTED); }
@@ -278,6 +394,7 @@ public:
     void generateCode(HLLCode *hll);
 
     void print(QTextStream &out, bool html = false) const;
+    void printSummary(QTextStream &out, bool html = false) const;
     void printParams(QTextStream &out, bool html = false) const;
     char *prints();
     void dump();
@@ -313,6 +430,7 @@ public:
     bool canRename(Exp *e) { return df.canRename(e, this); }
 
     Instruction *getStmtAtLex(unsigned int begin, unsigned int end);
+    StatementTable &getStatementTable() { return stmtTable; }
 
     void initStatements();
     void numberStatements();
@@ -352,17 +470,18 @@ public:
     void eliminateDuplicateArgs();
 
 private:
+    void releaseIR();
     void searchRegularLocals(OPER minusOrPlus, bool lastPass, int sp, StatementList &stmts);
     QString newLocalName(Exp &e);
 
 public:
     bool removeNullStatements();
     bool removeDeadStatements();
-    typedef std::map<Instruction *, int> RefCounter;
-    void countRefs(RefCounter &refCounts);
+    void buildUseLists();
+    void clearUseLists();
 
     void remUnusedStmtEtc();
-    void remUnusedStmtEtc(RefCounter &refCounts /* , int depth*/);
+    void remUnusedStatements();
     void removeUnusedLocals();
     void mapTempsToLocals();
     void removeCallLiveness();
@@ -403,15 +522,20 @@ public:
     bool removeRedundantReturns(std::set<UserProc *> &removeRetSet);
     bool checkForGainfulUse(Exp *e, ProcSet &Visited);
     void updateForUseChange(std::set<UserProc *> &removeRetSet);
-    bool prove(Exp *query, bool conditional = false);
+    bool prove(Exp *query, bool conditional = false, std::map<PhiAssign *, Exp *> *phiCache = nullptr);
+    void proveAll(const std::vector<Exp *> &queries, std::vector<bool> &results);
+    void validateProofs();
+    void dropProofs();
 
     bool prover(Exp *query, std::set<PhiAssign *> &lastPhis, std::map<PhiAssign *, Exp *> &cache, Exp *original,
                 PhiAssign *lastPhi = nullptr);
     void promoteSignature();
     void getStatements(StatementList &stmts) const;
+    //! The statements of this proc, walked in place; see StatementRange
+    StatementRange statements() { return StatementRange(cfg->begin(), cfg->end(), this); }
     virtual void removeReturn(Exp *e);
     void removeStatement(Instruction *stmt);
-    bool searchAll(const Exp &search, std::list<Exp *> &result);
+    bool searchAll(const Exp &search, ExpMatchList &result);
 
     void getDefinitions(LocationSet &defs);
     void addImplicitAssigns();
@@ -430,6 +554,8 @@ public:
     void mapSymbolTo(const Exp *from, Exp *to);
     void mapSymbolToRepl(const Exp *from, Exp *oldTo, Exp *newTo);
     void removeSymbolMapping(const Exp *from, Exp *to);
+    void eraseSymbol(SymbolMap::iterator it);
+    void clearSymbolMap();
     Exp *getSymbolFor(const Exp *e, SharedType ty);
     QString lookupSym(const Exp &e, SharedType ty);
     QString lookupSymFromRef(RefExp &r);
@@ -470,14 +596,14 @@ public:
     void killPremise(Exp *e) { recurPremises.erase(e); }
     virtual bool isPreserved(Exp *e);
 
-    virtual void printCallGraphXML(QTextStream &os, int depth, bool recurse = true);
     void printDecodedXML();
     void printAnalysedXML();
     void printSSAXML();
-    void printXML();
+    void printXML(bool callGraph = true);
     void printUseGraph();
 
     bool searchAndReplace(const Exp &search, Exp *replace);
+    bool searchAndReplaceAll(const ExpReplaceMap &replacements);
     void castConst(int num, SharedType ty);
     /// Add a location to the UseCollector; this means this location is used before defined,
     /// and hence is an *initial* parameter.
@@ -501,9 +627,16 @@ public:
     void setImplicitRef(Instruction *s, Exp *a, SharedType ty);
 
     void verifyPHIs();
-    void debugPrintAll(const char *c);
+    //! Print the whole proc to its separate log, with -v, if it is one of the --debug-proc procs (if any). Nothing is
+    //! tested at all when the hooks are compiled out
+    void debugPrintAll(const char *step_name) {
+        if (DEBUG_HOOKS && wantsDebugOutput())
+            printForDebug(step_name);
+    }
+    bool wantsDebugOutput() const;
 
 protected:
+    void printForDebug(const char *step_name);
     UserProc();
     void setCFG(Cfg *c) { cfg = c; }
 }; // class UserProc
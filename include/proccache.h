@@ -0,0 +1,64 @@
+/***************************************************************************/ /**
+  * \file       proccache.h
+  * \brief   On-disk cache of the results of decompiling procedures, shared between runs
+  ******************************************************************************/
+
+#ifndef __PROCCACHE_H__
+#define __PROCCACHE_H__
+
+#include <QByteArray>
+#include <QString>
+
+#include <cstddef>
+#include <map>
+
+class UserProc;
+
+/**
+ * \class ProcCache
+ * Remembers, across runs, what procedures decompiled to, so that code met again in another binary (typically
+ * statically linked library routines) need not be decompiled again. Enabled with --cache <dir>.
+ *
+ * An entry is keyed by a hash of the instruction bytes of the procedure and of every procedure it calls (directly or
+ * not), together with the options that affect decompilation, the SSL description of the machine and the version of
+ * Boomerang. Because the bytes include the operands of calls and jumps, code linked at different relative addresses
+ * gets different keys; that is a miss, never a wrong hit.
+ *
+ * What is kept is what the callers of a procedure see: its signature, its parameters, the locations it modifies and
+ * returns, and the preservations proven for it. The statements themselves are not: they refer to the callees, globals
+ * and addresses of the binary they came from. So the cache never stands in for decompiling a procedure whose code is
+ * written: every run decompiles and writes the procedures it is given in full, and gives the same output with the
+ * cache as without. Entries are read only for the groups of other shards (with --shard, see Prog::takeShardGroup),
+ * whose procedures are then final as far as their callers are concerned, and only their prototypes are written.
+ * Entries are only written for types and expressions that can be read back (see proccache.cpp); a procedure using
+ * anything else is simply not cached.
+ */
+class ProcCache {
+    QString directory;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t stores = 0;
+    std::map<UserProc *, QByteArray> contents; //!< Hash of each proc's own bytes, once computed
+    std::map<UserProc *, QByteArray> keys;     //!< The key each proc was looked up with
+
+    bool getContentHash(UserProc *proc, QByteArray &res);
+    bool makeKey(UserProc *proc, QByteArray &res);
+    QString getFileName(const QByteArray &key) const;
+
+  public:
+    static ProcCache &get();
+
+    void setDirectory(const QString &dir);
+    bool isEnabled() const { return !directory.isEmpty(); }
+
+    void keepKey(UserProc *proc);
+    bool restore(UserProc *proc);
+    bool store(UserProc *proc);
+    void clear();
+
+    size_t getHits() const { return hits; }
+    size_t getMisses() const { return misses; }
+    size_t getStores() const { return stores; }
+};
+
+#endif // __PROCCACHE_H__
@@ -0,0 +1,56 @@
+/***************************************************************************/ /**
+  * \file       procprofile.h
+  * \brief   Decompile times of procedures, kept between runs on the same binary to budget the next one
+  ******************************************************************************/
+
+#ifndef __PROCPROFILE_H__
+#define __PROCPROFILE_H__
+
+#include "types.h"
+
+#include <QString>
+
+#include <cstddef>
+#include <map>
+
+class UserProc;
+
+/**
+ * \class ProcProfile
+ * The wall time each procedure took to decompile, by its address, read from the profile of a previous run of the
+ * same binary and written back, updated, at the end of this one. Enabled with --profile <file>.
+ *
+ * When a decompilation budget is set (--proc-time, --proc-steps), the procs that ran out of it last time, or took
+ * longer than --proc-time, are finished at the stage they reach without waiting for their budget to run out again
+ * (see UserProc::startDegraded()). The profile does not change the order the procs are decompiled in: they are
+ * decompiled one at a time, and the order can change the output (e.g. through the globals and types they share), so
+ * ordering by the times of a previous run would make the output depend on that run.
+ */
+class ProcProfile {
+  public:
+    struct Entry {
+        QString name;           //!< Only for whoever reads the file
+        double seconds = 0;     //!< Wall time of UserProc::decompile, shared evenly by the members of a group
+        size_t statements = 0;  //!< Size of the proc when it was scheduled (see ProcScheduler::getCost())
+        bool exhausted = false; //!< Whether its decompilation budget ran out
+    };
+
+  private:
+    QString path;
+    std::map<ADDRESS, Entry> previous; //!< As read from the file
+    std::map<ADDRESS, Entry> current;  //!< As recorded in this run
+
+  public:
+    static ProcProfile &get();
+
+    bool setPath(const QString &file);
+    bool isEnabled() const { return !path.isEmpty(); }
+    bool isKnown() const { return !previous.empty(); }
+
+    bool isPathological(UserProc *proc, int timeBudget) const;
+    void record(UserProc *proc, double seconds, size_t statements);
+    bool write() const;
+    const QString &getPath() const { return path; }
+};
+
+#endif // __PROCPROFILE_H__
@@ -0,0 +1,58 @@
+/***************************************************************************/ /**
+  * \file       procregistry.h
+  * \brief   The procedures of a program by entry address, safe to use from several threads
+  ******************************************************************************/
+
+#ifndef __PROCREGISTRY_H__
+#define __PROCREGISTRY_H__
+
+#include "nametable.h"
+#include "types.h"
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class Function;
+
+/**
+ * \class ProcRegistry
+ * Maps the entry address of each procedure of a Prog to it (or to (Function *)-1 for one deleted, that must not be
+ * decoded again). Prog::findProc looks addresses up here rather than in the map of each Module in turn, and
+ * Prog::setNewProc makes procedures through insertOrGet(), so that two threads discovering the same call target get
+ * the same procedure. The Modules keep it up to date (see Module::setLocationMap and Module::addFunction).
+ *
+ * The map is split into shards by address, each with its own lock, so that lookups of different addresses seldom
+ * wait for each other.
+ *
+ * The procedures are also kept by the handles of their names (see NameTable), for Prog::findProc by name. The procs
+ * of each name are in the order they were added, the first being the one found. A Function adds itself when it joins
+ * a Module and removes itself when it leaves one, and moves when it is renamed (see Function::setName).
+ */
+class ProcRegistry {
+    static const size_t NUM_SHARDS = 16;
+    struct Shard {
+        mutable std::mutex lock;
+        std::unordered_map<uintptr_t, Function *> procs;
+    };
+    Shard shards[NUM_SHARDS];
+    mutable std::mutex namesLock;
+    std::unordered_map<NameTable::Handle, std::vector<Function *>> byName;
+
+    Shard &shardOf(ADDRESS a) { return shards[(a.m_value >> 2) % NUM_SHARDS]; }
+    const Shard &shardOf(ADDRESS a) const { return shards[(a.m_value >> 2) % NUM_SHARDS]; }
+
+  public:
+    Function *find(ADDRESS a) const;
+    Function *insertOrGet(ADDRESS a, const std::function<Function *()> &make, bool &made);
+    void set(ADDRESS a, Function *proc);
+    void erase(ADDRESS a);
+    void clear();
+    Function *findByName(NameTable::Handle name) const;
+    void addName(NameTable::Handle name, Function *proc);
+    void removeName(NameTable::Handle name, Function *proc);
+    std::vector<std::pair<ADDRESS, Function *>> byAddress() const;
+};
+
+#endif // __PROCREGISTRY_H__
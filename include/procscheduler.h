@@ -0,0 +1,73 @@
+/***************************************************************************/ /**
+  * \file       procscheduler.h
+  * \brief   Orders the decompilation of procedures by the strongly connected components of the call graph
+  ******************************************************************************/
+
+#ifndef __PROCSCHEDULER_H__
+#define __PROCSCHEDULER_H__
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+class UserProc;
+
+/**
+ * \class ProcScheduler
+ * Finds the strongly connected components (the recursion groups) of the call graph reachable from the entry points,
+ * as far as it is known from the decoded calls, and hands them out once every group they call into has been
+ * decompiled. Groups are numbered in the order they are completed by a depth first search that visits callees in the
+ * order of their call BBs, which calls every callee group before its callers. Ready groups are handed out lowest
+ * number first, so the order does not depend on addresses or on the order in which groups are finished, and is the
+ * order decompile() itself would finish them in.
+ *
+ * With setCheapestFirst() (--cheapest-first), ready groups are handed out cheapest first instead, by the number of
+ * statements of their members, and lowest number first among those of the same cost. Finishing the cheap groups first
+ * lets their callers become ready sooner, and with --stream, code is written sooner (see ProcStreamer). It is not
+ * the default as the order can change the output, through what the procs share (e.g. globals and their types).
+ *
+ * The groups of procs asked for with prefer(), and the groups they call into, are handed out before the others as
+ * soon as they are ready.
+ *
+ * Callees that only become known during decompilation (e.g. through switch or indirect call analysis) are not in the
+ * graph; UserProc::decompile() still recurses into those itself.
+ */
+class ProcScheduler {
+    std::vector<std::vector<UserProc *>> groups; //!< Members of each group, the first being where the search entered
+    std::vector<std::vector<int>> callers;       //!< For each group, the groups that call into it
+    std::vector<std::vector<int>> callees;       //!< For each group, the groups it calls into
+    std::vector<int> pending;                    //!< For each group, how many of its callee groups are unfinished
+    typedef std::pair<size_t, int> ReadyGroup;   //!< Cost (if cheapest first) and number of a group
+    std::set<ReadyGroup> ready;                  //!< Groups with no unfinished callee groups, not yet handed out
+    std::set<ReadyGroup> readyPreferred;         //!< Likewise for the preferred groups, which go first
+    std::vector<size_t> cost;                    //!< For each group, the statements of its members
+    std::vector<bool> preferred;                 //!< For each group, whether prefer() has been asked for it
+    std::vector<bool> recursive;                 //!< For each group, whether its members call into it
+    std::map<UserProc *, int> groupOf;
+    bool cheapestFirst = false;
+
+    ReadyGroup getReady(int g) const;
+
+  public:
+    static void getCallees(UserProc *proc, std::vector<UserProc *> &callees);
+    static size_t getCost(UserProc *proc);
+
+    //! Hand out the cheapest ready groups first, rather than in the order they were numbered; call before build()
+    void setCheapestFirst(bool b) { cheapestFirst = b; }
+    void build(const std::list<UserProc *> &entries);
+    size_t getNumGroups() const { return groups.size(); }
+    const std::vector<UserProc *> &getGroup(int g) const { return groups[g]; }
+    //! The groups that group \a g calls into
+    const std::vector<int> &getCalleeGroups(int g) const { return callees[g]; }
+    //! True if group \a g is involved in recursion (has more than one member, or one that calls itself)
+    bool isRecursive(int g) const { return recursive[g]; }
+    bool hasReady() const { return !ready.empty() || !readyPreferred.empty(); }
+    int next();
+    void prefer(UserProc *proc);
+    void finished(int g);
+};
+
+#endif // __PROCSCHEDULER_H__
@@ -0,0 +1,67 @@
+/***************************************************************************/ /**
+  * \file       procstreamer.h
+  * \brief   Generates code for procedures as soon as nothing more can change them, and releases their IR
+  ******************************************************************************/
+
+#ifndef __PROCSTREAMER_H__
+#define __PROCSTREAMER_H__
+
+#include <QFile>
+#include <QString>
+
+#include <map>
+#include <set>
+#include <vector>
+
+class Module;
+class Prog;
+class ProcScheduler;
+class UserProc;
+
+/**
+ * \class ProcStreamer
+ * With the --stream switch, keeps the memory used by decompilation proportional to the procedures in progress rather
+ * than to the program. Using the call graph of the ProcScheduler, a procedure goes through three steps as the recursion
+ * groups are finished:
+ *  - settled, once it and all its callers are final: the global stages (type analysis, removal of unused returns and
+ *    parameters, translation out of SSA form) are done for it alone;
+ *  - emitted, once all its callees are settled too, so that the signatures it calls are fixed: its C code and its
+ *    prototype are kept, as text, and its references to globals are counted;
+ *  - released, once all its callers are emitted as well, so that no call statement refers to its return statement any
+ *    more: its CFG is deleted (with -ia, its arena is released with it), leaving the signature.
+ *
+ * The code of each procedure is also appended to streamed.c in the output directory as soon as it is emitted, so that
+ * what has been decompiled can be read long before the end. Prog::generateCode() then writes the kept text in place
+ * of these procedures. Unused returns are removed from each
+ * procedure once, when it is settled, rather than until no change over the whole program, so a little less may be
+ * removed than without --stream. Procedures that are only found during decompilation are not in the call graph; they
+ * are left to the global stages as usual.
+ */
+class ProcStreamer {
+    Prog *prog;
+    std::map<UserProc *, std::vector<UserProc *>> callers; //!< Within the call graph
+    std::map<UserProc *, std::vector<UserProc *>> callees;
+    std::map<UserProc *, int> groupOf;                     //!< Callers are in later groups than their callees
+    std::set<UserProc *> settled, emitted, released;
+    std::map<Module *, QString> code;                      //!< The code emitted for each module, in order
+    std::map<UserProc *, QString> prototypes;
+    QFile streamedFile;                                    //!< streamed.c, opened with the first code emitted
+
+    bool canSettle(UserProc *proc) const;
+    bool canGenerate(UserProc *proc) const;
+    bool canRelease(UserProc *proc) const;
+    void settle(UserProc *proc);
+    void generate(UserProc *proc);
+
+  public:
+    ProcStreamer(Prog *prog, const ProcScheduler &scheduler);
+
+    void groupFinished(const std::vector<UserProc *> &group);
+    //! True if \a proc has been through the global stages here, and so must be left out of them in Prog
+    bool isStreamed(UserProc *proc) const { return settled.count(proc) != 0; }
+    bool isGenerated(UserProc *proc) const { return emitted.count(proc) != 0; }
+    QString getCode(Module *module) const;
+    QString getPrototype(UserProc *proc) const;
+};
+
+#endif // __PROCSTREAMER_H__
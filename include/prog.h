@@ -16,11 +16,18 @@
 #ifndef _PROG_H_
 #define _PROG_H_
 
+#include <deque>
 #include <map>
+#include <mutex>
+#include <unordered_map>
+#include <set>
+#include <tuple>
+#include <vector>
 #include "BinaryFile.h"
 #include "frontend.h"
 #include "type.h"
 #include "module.h"
+#include "procregistry.h"
 #include "util.h"
 // TODO: refactor Prog Global handling into separate class
 class RTLInstDict;
@@ -34,6 +41,18 @@ class Module;
 class XMLProgParser;
 class BinarySymbol;
 class HLLCode;
+class DecompilerContext;
+class ProcStreamer;
+class ProcScheduler;
+class OutputWriter;
+struct GlobalTypeRound;
+struct SWITCH_INFO;
+
+//! The arguments a printf or scanf style format string calls for (see CallStatement::ellipsisProcessing)
+struct FormatArguments {
+    int count = 1;                 //!< How many, the format string included
+    std::vector<SharedType> types; //!< The types of those after it, in order, as far as the conversions are known
+};
 
 class Global : public Printable {
 private:
@@ -41,13 +60,18 @@ private:
     ADDRESS uaddr;
     QString nam;
     Prog *Parent;
+    int refCount = 0; //!< References from the statements of the procs, as Prog::countGlobalRefs() counts them
+    unsigned typeGeneration = 0; //!< See getTypeGeneration()
 public:
     Global(SharedType _type, ADDRESS _uaddr, const QString &_nam,Prog *_p) : type(_type), uaddr(_uaddr), nam(_nam),Parent(_p) {}
     virtual ~Global();
 
     SharedType getType() { return type; }
-    void setType(SharedType ty) { type = ty; }
+    void setType(SharedType ty);
     void meetType(SharedType ty);
+    //! Moves whenever the type changes, so that the procs that use the global can tell (see
+    //! UserProc::consumesStaleSummaries())
+    unsigned getTypeGeneration() const { return typeGeneration; }
     ADDRESS getAddress() { return uaddr; }
     bool addressWithinGlobal(ADDRESS addr) {
         // TODO: use getType()->getBytes()
@@ -56,11 +80,13 @@ public:
         return (addr > uaddr) && (addr <= (uaddr + getType()->getBytes()));
     }
     const QString &getName() const { return nam; }
+    int getRefCount() const { return refCount; }
+    void addRefs(int n) { refCount += n; }
     Exp *getInitialValue(Prog *prog) const;
     QString toString() const;
 
 protected:
-    Global() : type(nullptr), uaddr(ADDRESS::g(0L)) {}
+    Global() : type(nullptr), uaddr(ADDRESS::g(0L)), Parent(nullptr) {}
     friend class XMLProgParser;
 }; // class Global
 
@@ -83,8 +109,16 @@ public:
     Prog(const char *name);
     void setFrontEnd(FrontEnd *_pFE);
     FrontEnd *getFrontEnd() { return DefaultFrontend; }
+    //! The options, log and watchers of the session this program is decompiled in
+    DecompilerContext *getContext() const { return Context; }
+    void setContext(DecompilerContext *c) { Context = c; }
     void setName(const char *name);
     Function *setNewProc(ADDRESS uNative);
+    bool nextToDecode(ADDRESS &a);
+    void queueForDecode(ADDRESS a) { decodeQueue.push_back(a); }
+    void addObjcClass(const QString &module, const QString &name,
+                      const std::vector<std::pair<QString, ADDRESS>> &methods);
+    void makeObjcClasses();
 
     void removeProc(const QString &name);
     QString getName(); // Get the name of this program
@@ -111,12 +145,16 @@ public:
     void decodeEverythingUndecoded();
     void decodeFragment(UserProc *proc, ADDRESS a);
     void reDecode(UserProc *proc);
+    bool decodeOnDemand(UserProc *proc);
     bool wellForm();
     void finishDecode();
     void decompile();
+    std::vector<UserProc *> redecompileStale();
     void removeUnusedGlobals();
+    void countGlobalRefs(UserProc *proc);
     void removeRestoreStmts(InstructionSet &rs);
     void globalTypeAnalysis();
+    std::set<UserProc *> mergeGlobalTypes();
     bool removeUnusedReturns();
     void fromSSAform();
     void conTypeAnalysis();
@@ -141,6 +179,8 @@ public:
     QString getGlobalName(ADDRESS uaddr);
     ADDRESS getGlobalAddr(const QString &nam);
     Global *getGlobal(const QString &nam);
+    //! Note that the type of a global may have changed, and with it its size
+    void globalTypeChanged() { globalsVersion++; }
     QString newGlobalName(ADDRESS uaddr);
     SharedType guessGlobalType(const QString &nam, ADDRESS u);
     std::shared_ptr<ArrayType> makeArrayType(ADDRESS u, SharedType t);
@@ -168,7 +208,13 @@ public:
     int readNative1(ADDRESS a);
     int readNative2(ADDRESS a);
     int readNative4(ADDRESS a);
+    bool readNative2Table(ADDRESS a, size_t count, std::vector<int> &res);
+    bool readNative4Table(ADDRESS a, size_t count, std::vector<int> &res);
     Exp *readNativeAs(ADDRESS uaddr, SharedType type);
+    const std::vector<ADDRESS> &getSwitchTargets(const SWITCH_INFO *si);
+
+    //! The format strings parsed by ellipsisProcessing so far, with whether each was for scanf
+    std::map<std::pair<QString, bool>, FormatArguments> &getFormatArguments() { return formatArguments; }
 
     bool isDynamicLinkedProcPointer(ADDRESS dest);
     const QString &GetDynamicProcName(ADDRESS uNative);
@@ -183,6 +229,8 @@ public:
     void printSymbolsToFile();
     void printCallGraph();
     void printCallGraphXML();
+    void writeDump(const QString &fileName, const QString &contents);
+    void finishDumps();
 
     Module *getRootCluster() { return m_rootCluster; }
     Module *findModule(const QString &name);
@@ -205,6 +253,7 @@ public:
 
     const ModuleListType &  getModuleList() const { return ModuleList; }
     ModuleListType       &  getModuleList()       { return ModuleList; }
+    ProcRegistry         &  getProcRegistry()     { return procRegistry; }
 
     iterator                begin()       { return ModuleList.begin(); }
     const_iterator          begin() const { return ModuleList.begin(); }
@@ -213,6 +262,7 @@ public:
     size_t                  size()  const { return ModuleList.size(); }
     bool                    empty() const { return ModuleList.empty(); }
     void generateDataSectionCode(QString section_name, ADDRESS section_start, uint32_t size, HLLCode *code);
+    void declareGlobal(Global *glob, HLLCode *code, bool always);
 signals:
     void rereadLibSignatures();
 
@@ -220,15 +270,77 @@ protected:
     QObject *pLoaderPlugin; //!< Pointer to the instance returned by loader plugin
     LoaderInterface *pLoaderIface = nullptr;
     FrontEnd *DefaultFrontend; //!< Pointer to the FrontEnd object for the project
+    DecompilerContext *Context; //!< The session; the Boomerang object unless set otherwise. Not owned
+
+    // The walks of the call graph for -gc, -gd and -x, limited by --graph-depth and --graph-module
+    void clearVisited();
+    bool isInGraph(Function *p) const;
+    std::vector<Function *> getGraphRoots();
+    std::set<Function *> getGraphProcs();
+    void printCallGraphXML(QTextStream &os, Function *root);
 
     /* Persistent state */
     QString m_name;            // name of the program
     QString m_path;            // its full path
     // FIXME: is a set of Globals the most appropriate data structure? Surely not.
     std::set<Global *> globals; //!< globals to print at code generation time
+    //! The globals again, by address and by name. Kept together with globals by addGlobal and clearGlobals
+    std::multimap<ADDRESS, Global *> globalsByAddress;
+    std::unordered_map<NameTable::Handle, Global *> globalsByName;
+    //! The largest size in bytes of any global, which bounds how far back findGlobalContaining looks. Types can
+    //! grow, so it is recomputed after a miss whenever globalsVersion has changed since it last was
+    size_t maxGlobalBytes = 0;
+    unsigned globalsVersion = 0;
+    unsigned maxGlobalBytesVersion = ~0u;
     DataIntervalMap globalMap;  //!< Map from address to DataInterval (has size, name, type)
     int m_iNumberedProc;        //!< Next numbered proc will use this
     Module *m_rootCluster;     //!< Root of the cluster tree
+    ProcStreamer *streamer = nullptr; //!< With --stream, what has been generated during decompile()
+    OutputWriter *dumpWriter = nullptr; //!< With -x, writes the XML and dot dumps while decompilation goes on
+    GlobalTypeRound *typeRound = nullptr; //!< With -Tg, the global types proposed in this round of global TA
+    //! Entry points of the procs made by setNewProc, for FrontEnd::decode to decode them (and the procs they call)
+    std::deque<ADDRESS> decodeQueue;
+    ProcRegistry procRegistry; //!< All the procedures of all the modules, by entry address
+
+    //! An Objective-C class of the binary, whose cluster and method procs are made when first needed
+    struct ObjcClassInfo {
+        QString module;
+        QString name;
+        std::vector<std::pair<QString, ADDRESS>> methods; //!< Names (with the types) and addresses
+        bool made;
+    };
+    std::vector<ObjcClassInfo> objcClasses;
+    std::map<ADDRESS, size_t> objcClassOfMethod; //!< Index into objcClasses of the class of each method
+    std::mutex objcLock;
+    void makeObjcClass(ObjcClassInfo &cls);
+    void makeObjcClassAt(ADDRESS a);
+    //! Answers of isStringConstant so far. They depend only on the section attributes set by the loader
+    std::map<ADDRESS, bool> stringConstants;
+    //! The destinations read from each jump table, by its address, form, entries and offset (see getSwitchTargets),
+    //! as they were when the image had been written to switchTargetsWrites times
+    std::map<std::tuple<ADDRESS, char, int, int>, std::vector<ADDRESS>> switchTargets;
+    unsigned switchTargetsWrites = 0;
+    std::map<std::pair<QString, bool>, FormatArguments> formatArguments; //!< See getFormatArguments
+
+    //! With --shard, the procs not decompiled in this run, because they wait for summaries from other shards
+    std::set<UserProc *> shardWaiting;
+
+    //! Where generateCode wrote the code of a statement in the file of its module: from the key up to \a end
+    struct LexRange {
+        unsigned end;
+        Instruction *stmt;
+    };
+    //! For each module, its statements by where their code begins in its file (see getStmtAtLex)
+    std::map<Module *, std::map<unsigned, LexRange>> stmtsByLex;
+    void recordStmtRanges(Module *module, HLLCode *code);
+
+    bool isLeftOut(UserProc *proc) const;
+    void relieveMemoryPressure();
+    int getShard(const ProcScheduler &scheduler, int g) const;
+    bool takeShardGroup(const ProcScheduler &scheduler, int g, std::vector<bool> &waiting);
+    void addGlobal(Global *global);
+    void clearGlobals();
+    Global *findGlobalContaining(ADDRESS uaddr);
 
     friend class XMLProgParser;
 }; // class Prog
@@ -23,6 +23,7 @@
 #ifndef __RTL_H__
 #define __RTL_H__
 
+#include "arena.h"                      // for ArenaAllocated
 #include "register.h"                   // for Register
 #include "type.h"                       // for Type
 #include "types.h"                      // for ADDRESS
@@ -30,10 +31,14 @@
 #include <functional>                   // for less
 #include <list>                         // for list
 #include <map>                          // for map
+#include <mutex>                        // for mutex
 #include <set>                          // for set
 #include <string>                       // for string
+#include <unordered_map>                // for unordered_map
 #include <utility>                      // for pair
 #include <vector>                       // for vector
+#include <QByteArray>
+#include <QHash>
 #include <QMap>
 
 class Exp;  // lines 38-38
@@ -48,9 +53,11 @@ enum STMT_KIND : uint8_t;
   * \note when time permits, this class could be removed, replaced with new Statements that mark the current native
   * address
   ******************************************************************************/
-class RTL : public std::list<Instruction *> {
+class RTL : public std::list<Instruction *>, public ArenaAllocated {
     ADDRESS nativeAddr; // RTL's source program instruction address
   public:
+    typedef RTL ArenaRoot; //!< No class derives from RTL, so its destructor need not be virtual
+    ARENA_ALLOCATED_AS(mkRTL)
     RTL();
     RTL(ADDRESS instNativeAddr, const std::list<Instruction *> *listStmt = nullptr);
     RTL(const RTL &other); // Makes deep copy of "other"
@@ -77,7 +84,7 @@ class RTL : public std::list<Instruction *> {
     Instruction *getHlStmt();
     char *prints() const; // Print to a string (mainly for debugging)
   protected:
-    void simplify();
+    bool simplify(); // True if a statement was removed or replaced
     friend class XMLProgParser;
     friend class BasicBlock;
 };
@@ -107,6 +114,12 @@ class TableEntry {
 
 #define TEF_NEXTPC 1
     int flags; // aka required capabilities. Init. to 0
+
+    //! The template is compiled by RTLInstDict::compileEntry on first instantiation, and again after it changes
+    bool compiled = false;
+    bool hasPostVars = false;                //!< True if some statement of rtl assigns to a post-variable
+    std::vector<Exp *> formals;              //!< The opParam location of each of params, in order
+    std::vector<std::vector<int>> paramUses; //!< For each statement of rtl, the indices of the formals it uses
 };
 
 /***************************************************************************/ /**
@@ -148,18 +161,38 @@ class RTLInstDict {
     ~RTLInstDict();
 
     bool readSSLFile(const QString &SSLFileName);
+    static QByteArray getCacheKey(const QByteArray &contents);
+    bool readCache(const QString &path, const QByteArray &key);
+    bool writeCache(const QString &path, const QByteArray &key) const;
+    bool readImage(const QByteArray &image, const QByteArray &key);
+    QByteArray writeImage(const QByteArray &key) const;
+    //! A hash of the contents of the SSL file read, which changes whenever the semantics do
+    const QByteArray &getFingerprint() const { return Fingerprint; }
     void reset();
     std::pair<QString, unsigned> getSignature(const char *name);
+    TableEntry *lookupOpcode(const char *name);
 
     int appendToDict(const QString &n, std::list<QString> &p, RTL &rtl);
 
     std::list<Instruction *> *instantiateRTL(const QString &name, ADDRESS natPC, const std::vector<Exp *> &actuals);
+    std::list<Instruction *> *instantiateRTL(TableEntry &entry, ADDRESS natPC, const std::vector<Exp *> &actuals);
     std::list<Instruction *> *instantiateRTL(RTL &rtls, ADDRESS, std::list<QString> &params,
                                            const std::vector<Exp *> &actuals);
 
     void transformPostVars(std::list<Instruction *> &rts, bool optimise);
+    void compileEntry(TableEntry &entry);
     void print(QTextStream &os);
     void addRegister(const QString &name, int id, int size, bool flt);
+    void buildRegTables();
+    //! The name of register \a idx, or an empty string if there is none
+    const QString &getRegName(int idx) const {
+        static const QString none;
+        return idx >= 0 && idx < (int)regNames.size() ? regNames[idx] : none;
+    }
+    //! The size in bits of register \a idx, or 32 if it has no details
+    int getRegSize(int idx) const { return idx >= 0 && idx < (int)regSizes.size() ? regSizes[idx] : 32; }
+    //! The index of the register called \a name, or -1 for none or a special register
+    int getRegIndex(const QString &name) const { return regIndex.value(name, -1); }
     bool partialType(Exp *exp, Type &ty);
     void fixupParams();
 
@@ -170,6 +203,12 @@ class RTLInstDict {
     //! Similar to r_map but stores more info about a register such as its size, its addresss etc (see register.h).
     std::map<int, Register, std::less<int>> DetRegMap;
 
+    //! RegMap and DetRegMap again, indexed by register number, for the frontends that look registers up by number
+    //! for every location they name; built by buildRegTables() once the dictionary is read
+    std::vector<QString> regNames;
+    std::vector<int> regSizes;
+    QHash<QString, int> regIndex;
+
     //! A map from symbolic representation of a special (non-addressable) register to a Register object
     std::map<QString, Register, std::less<QString>> SpecialRegMap;
 
@@ -190,12 +229,28 @@ class RTLInstDict {
 
     bool bigEndian; // True if this source is big endian
 
+    QByteArray Fingerprint;
+
     //! The actual dictionary.
     std::map<QString, TableEntry, std::less<QString>> idict;
 
     //! An RTL describing the machine's basic fetch-execute cycle
     std::list<Instruction *> *fetchExecCycle;
 
+    //! With warmCaches, the image (see writeImage) of each SSL file read in this process, by absolute path: the
+    //! decoders made later load it instead of parsing the file again. Dictionaries may be read on several threads
+    static std::map<QString, QByteArray> warmImages;
+    static std::mutex warmLock;
+
+    //! An opcode name as the decoders pass it (see lookupOpcode), with the entry it resolved to
+    struct OpcodeEntry {
+        QByteArray name;
+        TableEntry *entry;
+    };
+    //! Keyed by the address of the name: the decoders use string constants, so this is one hash lookup per
+    //! instruction decoded instead of a case conversion and two searches of idict
+    std::unordered_map<const char *, OpcodeEntry> opcodeCache;
+
     void fixupParamsSub(const QString &s, std::list<QString> &funcParams, bool &haveCount, int mark);
 };
 
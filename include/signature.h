@@ -33,6 +33,8 @@ class LoaderInterface;
 class XMLProgParser;
 class Exp;
 
+//! The Exps of parameters and returns are kept on the heap (see Exp::outsideArena()), as a signature outlives the arena
+//! of its proc, and is what its callers go by
 class Parameter {
   private:
     SharedType type;
@@ -41,8 +43,7 @@ class Parameter {
     QString boundMax;
 
   public:
-    Parameter(SharedType _type, const QString &_name, Exp *_exp = nullptr, const QString &_boundMax = "")
-        : type(_type), m_name(_name), exp(_exp), boundMax(_boundMax) {}
+    Parameter(SharedType _type, const QString &_name, Exp *_exp = nullptr, const QString &_boundMax = "");
     virtual ~Parameter();
     bool operator==(Parameter &other);
     Parameter *clone();
@@ -52,7 +53,7 @@ class Parameter {
     const QString &name() { return m_name; }
     void name(const QString &nam) { m_name = nam; }
     Exp *getExp() { return exp; }
-    void setExp(Exp *e) { exp = e; }
+    void setExp(Exp *e);
 
     // this parameter is the bound of another parameter with name nam
     QString getBoundMax() { return boundMax; }
@@ -68,7 +69,7 @@ class Return {
     SharedType type;
     Exp *exp;
 
-    Return(SharedType _type, Exp *_exp) : type(_type), exp(_exp) {}
+    Return(SharedType _type, Exp *_exp);
     virtual ~Return() {}
     bool operator==(Return &other);
     Return *clone();
@@ -127,7 +128,7 @@ class Signature {
     virtual void removeReturn(Exp *e);
     virtual size_t getNumReturns() { return returns.size(); }
     virtual Exp *getReturnExp(size_t n) { return returns[n]->exp; }
-    void setReturnExp(size_t n, Exp *e) { returns[n]->exp = e; }
+    void setReturnExp(size_t n, Exp *e);
     virtual SharedType getReturnType(size_t n) { return returns[n]->type; }
     virtual void setReturnType(size_t n, SharedType ty);
     int findReturn(Exp *e);
@@ -0,0 +1,59 @@
+/***************************************************************************/ /**
+  * \file       simplifycache.h
+  * \brief   Memo of the results of Exp::simplify()
+  ******************************************************************************/
+
+#ifndef __SIMPLIFYCACHE_H__
+#define __SIMPLIFYCACHE_H__
+
+#include <cstddef>
+#include <unordered_map>
+
+class Exp;
+
+/**
+ * \class SimplifyCache
+ * Remembers, for expressions that have been simplified before, what they simplified to, so that Exp::simplify() can
+ * return a copy of that instead of running polySimplify to a fixed point again. Enabled with the -is switch.
+ *
+ * Entries are looked up by strict structure: besides what lessExpStar compares, the types of typed expressions and
+ * the procs of locations must be the same too, since those carry over into the result. Expressions with subscripts
+ * are not cached at all, because how they simplify depends on the (changing) types of their definitions, nor are
+ * expressions with typed constants (see isCacheable()).
+ *
+ * The copies in the entries belong to the cache, and are deleted with them: when it is cleared, and when it is full.
+ */
+class SimplifyCache {
+    struct Entry {
+        Exp *key;    //!< Private copy of the expression before simplification
+        Exp *result; //!< Private copy of what it simplified to, or nullptr when simplify() didn't change it
+    };
+    typedef std::unordered_multimap<size_t, Entry> EntryMap;
+    static const size_t MAX_ENTRIES = 1 << 16;
+
+    EntryMap table;
+    bool enabled = false;
+    size_t hits = 0;
+    size_t misses = 0;
+
+    static bool isCacheable(const Exp *e);
+    static bool sameExp(const Exp *a, const Exp *b);
+    static void deleteCopy(Exp *e);
+    void deleteEntries();
+
+  public:
+    ~SimplifyCache() { deleteEntries(); }
+    static SimplifyCache &get();
+
+    void setEnabled(bool b) { enabled = b; }
+    bool isEnabled() const { return enabled; }
+
+    Exp *simplify(Exp *e);
+
+    size_t size() const { return table.size(); }
+    size_t getHits() const { return hits; }
+    size_t getMisses() const { return misses; }
+    void clear();
+};
+
+#endif // __SIMPLIFYCACHE_H__
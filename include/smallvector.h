@@ -0,0 +1,101 @@
+/***************************************************************************/ /**
+  * \file       smallvector.h
+  * \brief   A vector with room for a few elements inside the object itself
+  ******************************************************************************/
+
+#ifndef __SMALLVECTOR_H__
+#define __SMALLVECTOR_H__
+
+#include <cstddef>
+#include <cstring>
+
+/**
+ * \class SmallVector
+ * Sequence of up to N elements stored in place, spilling to the heap only when it grows beyond that. Meant for short
+ * lived results that are nearly always empty or tiny, like the matches of an expression search. Elements are copied
+ * with memcpy, so T must be a plain type such as a pointer.
+ */
+template <class T, size_t N> class SmallVector {
+    T local[N];
+    T *elems;
+    size_t count = 0;
+    size_t capacity = N;
+
+    void grow() { reserve(capacity * 2); }
+
+  public:
+    typedef T value_type;
+    typedef T *iterator;
+    typedef const T *const_iterator;
+
+    SmallVector() : elems(local) {}
+    SmallVector(const SmallVector &other) : elems(local) { *this = other; }
+    ~SmallVector() {
+        if (elems != local)
+            delete[] elems;
+    }
+    SmallVector &operator=(const SmallVector &other) {
+        if (this == &other)
+            return *this;
+        count = 0;
+        reserve(other.count);
+        memcpy(elems, other.elems, other.count * sizeof(T));
+        count = other.count;
+        return *this;
+    }
+
+    void reserve(size_t n) {
+        if (n <= capacity)
+            return;
+        T *bigger = new T[n];
+        memcpy(bigger, elems, count * sizeof(T));
+        if (elems != local)
+            delete[] elems;
+        elems = bigger;
+        capacity = n;
+    }
+    void push_back(const T &v) {
+        if (count == capacity)
+            grow();
+        elems[count++] = v;
+    }
+    void pop_back() { count--; }
+    //! Grow with value initialised elements (e.g. nullptr), or shrink
+    void resize(size_t n) {
+        while (capacity < n)
+            grow();
+        for (size_t i = count; i < n; ++i)
+            elems[i] = T();
+        count = n;
+    }
+    iterator insert(iterator pos, const T &v) {
+        size_t i = pos - elems;
+        if (count == capacity)
+            grow();
+        memmove(elems + i + 1, elems + i, (count - i) * sizeof(T));
+        elems[i] = v;
+        count++;
+        return elems + i;
+    }
+    iterator erase(iterator first, iterator last) {
+        memmove(first, last, (end() - last) * sizeof(T));
+        count -= last - first;
+        return first;
+    }
+    iterator erase(iterator pos) { return erase(pos, pos + 1); }
+    void clear() { count = 0; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T &operator[](size_t i) { return elems[i]; }
+    const T &operator[](size_t i) const { return elems[i]; }
+    T &front() { return elems[0]; }
+    T &back() { return elems[count - 1]; }
+    const T &front() const { return elems[0]; }
+    const T &back() const { return elems[count - 1]; }
+    iterator begin() { return elems; }
+    iterator end() { return elems + count; }
+    const_iterator begin() const { return elems; }
+    const_iterator end() const { return elems + count; }
+};
+
+#endif // __SMALLVECTOR_H__
@@ -32,6 +32,8 @@
 #include "types.h"
 #include "managed.h"
 #include "dataflow.h"  // For embedded objects DefCollector and UseCollector
+#include "arena.h"     // For ArenaAllocated
+#include "flatmap.h"   // For PhiAssign::Definitions
 //#include "boomerang.h" // For USE_DOMINANCE_NUMS etc
 
 #include <QtCore/QTextStream>
@@ -118,7 +120,10 @@ enum BRANCH_TYPE {
 /* Statements define values that are used in expressions.
  * They are akin to "definition" in the Dragon Book.
  */
-class Instruction {
+class Instruction : public ArenaAllocated {
+public:
+    typedef Instruction ArenaRoot; //!< What an arena destroys the statements left in it as (see ArenaAllocated)
+
 protected:
     typedef std::map<Exp *, int, lessExpStar> mExpInt;
     BasicBlock *Parent; // contains a pointer to the enclosing BB
@@ -134,15 +139,28 @@ protected:
 #endif
     STMT_KIND Kind; // Statement kind (e.g. STMT_BRANCH)
     unsigned int LexBegin, LexEnd;
+    //! Use lists, without repeats: the statements that use this definition, and the definitions this statement uses.
+    //! Only kept while the proc has them (see UserProc::buildUseLists())
+    std::vector<Instruction *> Users, UsedDefs;
+
+    //! Keep the proc's StatementTable in step with a change to a field it holds; numbered statements only
+    void noteChanged() {
+        if (proc && Number > 0)
+            updateTable();
+    }
+    void updateTable();
 
 public:
-    Instruction() : Parent(nullptr), proc(nullptr), Number(0) {} //, parent(nullptr)
+    Instruction() : Parent(nullptr), proc(nullptr), Number(0), LexBegin(0), LexEnd(0) {} //, parent(nullptr)
     virtual ~Instruction() {}
 
     // get/set the enclosing BB, etc
     BasicBlock *getBB() { return Parent; }
     const BasicBlock *getBB() const { return Parent; }
-    void setBB(BasicBlock *bb) { Parent = bb; }
+    void setBB(BasicBlock *bb) {
+        Parent = bb;
+        noteChanged();
+    }
 
     //        bool        operator==(Statement& o);
     // Get and set *enclosing* proc (not destination proc)
@@ -153,7 +171,10 @@ public:
     virtual void setNumber(int num) { Number = num; } // Overridden for calls (and maybe later returns)
 
     STMT_KIND getKind() const { return Kind; }
-    void setKind(STMT_KIND k) { Kind = k; }
+    void setKind(STMT_KIND k) {
+        Kind = k;
+        noteChanged();
+    }
 
     virtual Instruction * clone() const = 0; // Make copy of self
 
@@ -163,11 +184,26 @@ public:
     virtual bool accept(StmtModifier *visitor) = 0;
     virtual bool accept(StmtPartModifier *visitor) = 0;
 
-    void setLexBegin(unsigned int n) { LexBegin = n; }
-    void setLexEnd(unsigned int n) { LexEnd = n; }
+    void setLexBegin(unsigned int n) {
+        LexBegin = n;
+        noteChanged();
+    }
+    void setLexEnd(unsigned int n) {
+        LexEnd = n;
+        noteChanged();
+    }
     unsigned int getLexBegin() { return LexBegin; }
     unsigned int getLexEnd() { return LexEnd; }
 
+    const std::vector<Instruction *> &getUsers() const { return Users; }
+    const std::vector<Instruction *> &getUsedDefs() const { return UsedDefs; }
+    void updateUses();
+    void dropUses();
+    void clearUses() {
+        Users.clear();
+        UsedDefs.clear();
+    }
+
     //! returns true if this statement defines anything
     virtual bool isDefinition() = 0;
     bool isNullStatement(); //!< true if is a null statement
@@ -234,6 +270,8 @@ public:
 
     // general search and replace. Set cc true to change collectors as well. Return true if any change
     virtual bool searchAndReplace(const Exp &search, Exp *replace, bool cc = false) = 0; // TODO: consider constness
+    // As above, for all the searches in replacements at once
+    bool searchAndReplaceAll(const ExpReplaceMap &replacements, bool cc = false);
 
     // True if can propagate to expression e in this Statement.
     static bool canPropagateToExp(Exp &e);
@@ -267,7 +305,7 @@ public:
 
     // Data flow based type analysis
     virtual void dfaTypeAnalysis(bool & /*ch*/) {} // Use the type information in this Statement
-    SharedType meetWithFor(SharedType ty, Exp *e, bool &ch); // Meet the type associated with e with ty
+    SharedType meetWithFor(const SharedType &ty, Exp *e, bool &ch); // Meet the type associated with e with ty
 
 public:
 
@@ -288,7 +326,7 @@ public:
     void bypass();
     bool replaceRef(Exp *e, Assign *def, bool &convert);
     void findConstants(std::list<Const *> &lc);
-    int setConscripts(int n);
+    int setConscripts(int n, std::vector<Const *> *numbered = nullptr);
     void clearConscripts();
     void stripSizes();
     void subscriptVar(Exp *e, Instruction *def /*, Cfg* cfg */);
@@ -421,6 +459,7 @@ class Assign : public Assignment {
     Exp *guard;
 
 public:
+    ARENA_ALLOCATED_AS(mkAssign)
     // Constructor, subexpressions
     Assign(Exp *lhs, Exp *r, Exp *guard = nullptr);
     // Constructor, type and subexpressions
@@ -486,7 +525,7 @@ public:
     // Data flow based type analysis
     void dfaTypeAnalysis(bool &ch);
 
-    // FIXME: I suspect that this was only used by adhoc TA, and can be deleted
+    //! Match a "lhs := rhs" pattern (see CompiledPattern)
     bool match(const char *pattern, std::map<QString, Exp *> &bindings);
 
     friend class XMLProgParser;
@@ -519,7 +558,8 @@ protected:
   ******************************************************************************/
 class PhiAssign : public Assignment {
 public:
-    typedef std::map<BasicBlock *, PhiInfo> Definitions;
+    ARENA_ALLOCATED_AS(mkPhiAssign)
+    typedef FlatMap<BasicBlock *, PhiInfo> Definitions; // Few predecessors per phi, so a sorted vector
     typedef Definitions::iterator iterator;
     typedef Definitions::const_iterator const_iterator;
 
@@ -603,6 +643,7 @@ protected:
 // globals.  That way, you can always find the type of a subscripted variable by looking in its defining Assignment
 class ImplicitAssign : public Assignment {
 public:
+    ARENA_ALLOCATED_AS(mkImplicitAssign)
     ImplicitAssign(Exp *lhs);
     ImplicitAssign(SharedType ty, Exp *lhs);
     ImplicitAssign(ImplicitAssign &o);
@@ -643,6 +684,7 @@ class BoolAssign : public Assignment {
     bool bFloat;        // True if condition uses floating point CC
     int Size;           // The size of the dest
 public:
+    ARENA_ALLOCATED_AS(mkBoolAssign)
     BoolAssign(int size);
     virtual ~BoolAssign();
 
@@ -696,11 +738,12 @@ public:
 class ImpRefStatement : public TypingStatement {
     Exp *addressExp; // The expression representing the address of the location referenced
 public:
+    ARENA_ALLOCATED_AS(mkImpRefStatement)
     // Constructor, subexpression
     ImpRefStatement(SharedType ty, Exp *a) : TypingStatement(ty), addressExp(a) { Kind = STMT_IMPREF; }
     Exp *getAddressExp() { return addressExp; }
     SharedType getType() { return type; }
-    void meetWith(SharedType ty, bool &ch); // Meet the internal type with ty. Set ch if a change
+    void meetWith(const SharedType &ty, bool &ch); // Meet the internal type with ty. Set ch if a change
 
     // Virtuals
     virtual Instruction * clone() const;
@@ -739,6 +782,7 @@ protected:
     const Const *constDest() const { return ((const Const *)pDest); }
 
 public:
+    ARENA_ALLOCATED_AS(mkGotoStatement)
     GotoStatement();
     GotoStatement(ADDRESS jumpDest);
     virtual ~GotoStatement();
@@ -793,6 +837,7 @@ public:
 
 class JunctionStatement : public Instruction {
 public:
+    ARENA_ALLOCATED_AS(mkJunctionStatement)
     JunctionStatement() { Kind = STMT_JUNCTION; }
 
     Instruction * clone() const override { return new JunctionStatement(); }
@@ -836,7 +881,10 @@ class BranchStatement : public GotoStatement {
     // Perhaps bFloat, jtCond, and size could one day be merged into a type
     int size;         // Size of the operands, in bits
 
+    void redirectOutEdge(int i, BasicBlock *bb);
+
 public:
+    ARENA_ALLOCATED_AS(mkBranchStatement)
     BranchStatement();
     virtual ~BranchStatement();
 
@@ -917,6 +965,7 @@ struct SWITCH_INFO {
 class CaseStatement : public GotoStatement {
     SWITCH_INFO *pSwitchInfo; // Ptr to struct with info about the switch
 public:
+    ARENA_ALLOCATED_AS(mkCaseStatement)
     CaseStatement();
     virtual ~CaseStatement();
 
@@ -991,7 +1040,35 @@ class CallStatement : public GotoStatement {
     // break".
     ReturnStatement *calleeReturn;
 
+    // What updateArguments or updateDefines last brought the arguments or defines up to date from. While none of it
+    // has moved, doing it again would change nothing
+    struct UpdateStamp {
+        Function *callee = nullptr;
+        ReturnStatement *calleeReturn = nullptr;
+        unsigned calleeGeneration = 0;    // Of the callee's summary: its parameters, modifieds and so on
+        unsigned procGeneration = 0;      // Of the enclosing proc's, which filters the parameters and returns
+        unsigned collectorGeneration = 0; // Of defCol, which localises the callee's parameters
+        unsigned callGeneration = 0;
+        bool operator==(const UpdateStamp &o) const {
+            return callee == o.callee && calleeReturn == o.calleeReturn && calleeGeneration == o.calleeGeneration &&
+                   procGeneration == o.procGeneration && collectorGeneration == o.collectorGeneration &&
+                   callGeneration == o.callGeneration;
+        }
+    };
+    UpdateStamp argumentsStamp, definesStamp;
+
+    // Results of bypassRef, keyed by the base of the reference: what it returns (nullptr for the reference itself) and
+    // whether that is a change. They hold while bypassStamp is current, as the callee's proven set and the collector
+    // that localises it are in it
+    std::map<Exp *, std::pair<Exp *, bool>, lessExpStar> bypasses;
+    UpdateStamp bypassStamp;
+
+    // Moves whenever the destination, arguments, defines or collectors of this call may have been changed other than
+    // by updateArguments or updateDefines
+    unsigned callGeneration;
+
 public:
+    ARENA_ALLOCATED_AS(mkCallStatement)
     CallStatement();
     virtual ~CallStatement();
 
@@ -1022,11 +1099,17 @@ public:
     void updateDefines();         // Update the defines based on a callee change
     StatementList *calcResults(); // Calculate defines(this) isect live(this)
     ReturnStatement *getCalleeReturn() { return calleeReturn; }
-    void setCalleeReturn(ReturnStatement *ret) { calleeReturn = ret; }
+    void setCalleeReturn(ReturnStatement *ret) {
+        calleeReturn = ret;
+        callGeneration++;
+    }
     bool isChildless() const;
     Exp *getProven(Exp *e);
     Signature *getSignature() { return signature; }
-    void setSignature(Signature *sig) { signature = sig;} ///< Only used by range analysis
+    void setSignature(Signature *sig) { ///< Only used by range analysis
+        signature = sig;
+        callGeneration++;
+    }
     // Localise the various components of expression e with reaching definitions to this call
     // Note: can change e so usually need to clone the argument
     // Was called substituteParams
@@ -1035,6 +1118,7 @@ public:
     // Do the call bypass logic e.g. r28{20} -> r28{17} + 4 (where 20 is this CallStatement)
     // Set ch if changed (bypassed)
     Exp *bypassRef(RefExp *r, bool &ch);
+    Exp *findBypass(RefExp *r, bool &ch);
     void clearUseCollector() { useCol.clear(); }
     void addArgument(Exp *e, UserProc *proc);
     Exp *findDefFor(Exp *e); // Find the reaching definition for expression e
@@ -1128,10 +1212,14 @@ private:
     void addSigParam(SharedType ty, bool isScanf);
     Assign *makeArgAssign(SharedType ty, Exp *e);
     bool objcSpecificProcessing(const QString &formatStr);
+    UpdateStamp currentStamp(bool withCollector) const;
 
 protected:
     void updateDefineWithType(int n);
-    void appendArgument(Assignment *as) { arguments.append(as); }
+    void appendArgument(Assignment *as) {
+        arguments.append(as);
+        callGeneration++;
+    }
     friend class XMLProgParser;
 }; // class CallStatement
 
@@ -1170,6 +1258,7 @@ protected:
     StatementList returns;
 
 public:
+    ARENA_ALLOCATED_AS(mkReturnStatement)
     ReturnStatement();
     virtual ~ReturnStatement();
 
@@ -0,0 +1,126 @@
+/***************************************************************************/ /**
+  * \file       stats.h
+  * \brief   Wall time, allocation and counter report for the stages of decompilation
+  ******************************************************************************/
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include "memstats.h"
+
+#include <QString>
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Function;
+
+/**
+ * \class DecompileStats
+ * Accumulates, for each procedure and stage of decompilation (decode, initialiseDecompile, earlyDecompile,
+ * middleDecompile, each depth of the SSA passes, propagation, findPreserveds, typeAnalysis, dfaTypeAnalysis,
+ * fromSSAform, codegen), how often the stage ran, its wall time, the number and size of IR objects allocated meanwhile
+ * (see ArenaAllocated), and any counters the stage keeps. Times and allocations
+ * are inclusive: a stage that runs inside another is counted in both. Enabled with the --stats switch, and written to
+ * stats.json in the output directory at the end.
+ *
+ * With --memstats, each stage also gets the peak footprint of the IR during it (the high-water mark of the live bytes
+ * counted by MemStats, above what was live when it started), in total and by kind of object, and the procedures with
+ * the largest peaks are listed in memstats.txt.
+ */
+class DecompileStats {
+  public:
+    struct Entry {
+        size_t calls = 0;
+        double seconds = 0;
+        size_t allocations = 0;
+        size_t allocatedBytes = 0;
+        size_t peakBytes = 0;                  //!< Largest peak footprint of any of the calls (with --memstats)
+        std::map<QString, size_t> peakByKind;  //!< Likewise for each kind of object, in bytes
+        std::map<QString, size_t> counters;
+    };
+
+  private:
+    //! Keyed by procedure name ("" for the program as a whole), then by stage
+    std::map<QString, std::map<QString, Entry>> entries;
+    QString preset = "full"; //!< The quality the program was decompiled at, e.g. "draft"
+    bool enabled = false;
+    bool memory = false;
+
+  public:
+    static DecompileStats &get();
+
+    void setEnabled(bool b);
+    bool isEnabled() const { return enabled; }
+    void setMemoryEnabled(bool b) { memory = b; }
+    bool isMemoryEnabled() const { return memory; }
+    void setPreset(const QString &name) { preset = name; }
+
+    Entry &getEntry(const Function *proc, const QString &stage);
+    void count(const Function *proc, const QString &stage, const QString &counter, size_t n = 1);
+    bool writeJSON(const QString &path) const;
+    bool writeMemoryReport(const QString &path, size_t top) const;
+    void clear() { entries.clear(); }
+};
+
+/**
+ * \class SimplifyStats
+ * How often each rewrite rule of the expression simplifier fired (the cases of polySimplify, simplifyArith and
+ * simplifyAddr, counted with SIMPLIFY_RULE), and a histogram of the number of polySimplify rounds Exp::simplify took to
+ * reach its fixed point, to show which rules are worth making cheaper or testing first. Kept while DecompileStats is
+ * enabled and written to stats.json with it, as "simplify". Expressions answered by the SimplifyCache are not
+ * simplified again, so are not counted again.
+ */
+class SimplifyStats {
+    std::unordered_map<const char *, size_t> rules; //!< By the name of the rule, a string literal, so by its address
+    std::vector<size_t> rounds;                     //!< Calls of Exp::simplify by number of rounds
+
+  public:
+    //! Static rather than a member of get(), so that a rule that fires with the stats off costs one test
+    static bool enabled;
+    static SimplifyStats &get();
+
+    void hit(const char *rule) { rules[rule]++; }
+    void countRounds(size_t n);
+    std::map<QString, size_t> getRuleHits() const;
+    const std::vector<size_t> &getRounds() const { return rounds; }
+    void clear();
+};
+
+//! Count a firing of the rewrite rule named \a name (a string literal) of the simplifier, with --stats
+#define SIMPLIFY_RULE(name)                                                                                            \
+    do {                                                                                                               \
+        if (SimplifyStats::enabled)                                                                                    \
+            SimplifyStats::get().hit(name);                                                                            \
+    } while (0)
+
+/**
+ * \class StatScope
+ * Charges the time and allocations between its construction and destruction to one stage of one procedure (or of the
+ * program, for nullptr). Does nothing while DecompileStats is disabled. An index >= 0 is appended to the stage name,
+ * e.g. for the depth of an SSA pass. For the peak footprint, the high-water marks of MemStats are reset to what is
+ * live when the scope starts, and put back, raised to what was reached meanwhile, when it ends.
+ */
+class StatScope {
+    DecompileStats::Entry *entry = nullptr;
+    std::chrono::steady_clock::time_point start;
+    size_t startAllocations = 0;
+    size_t startBytes = 0;
+    bool memory = false;
+    size_t startLive = 0;
+    size_t savedPeak = 0;
+    size_t startKindLive[MemStats::NUM_KINDS];
+    size_t savedKindPeak[MemStats::NUM_KINDS];
+
+  public:
+    StatScope(const Function *proc, const char *stage, int index = -1);
+    ~StatScope();
+    StatScope(const StatScope &) = delete;
+    StatScope &operator=(const StatScope &) = delete;
+};
+
+#endif // __STATS_H__
@@ -0,0 +1,133 @@
+/***************************************************************************/ /**
+  * \file       taskscheduler.h
+  * \brief   A pool of worker threads running a graph of tasks, for the parts of the decompiler that work in parallel
+  ******************************************************************************/
+
+#ifndef __TASKSCHEDULER_H__
+#define __TASKSCHEDULER_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \class TaskScheduler
+ * Runs tasks on a number of workers, the thread calling run() being the first of them, so that the passes that work
+ * in parallel share one way of doing it instead of each starting and joining threads of their own. Only the parsing
+ * of the SSL and signature files does (see FrontEnd::prefetch and FrontEnd::preloadSignatures): decoding,
+ * decompiling, type analysis, leaving SSA form and generating code all run on one thread, for the reasons given in
+ * Prog::decompile().
+ *
+ * Tasks are added with a priority and may be made to wait for other tasks (addDependency()): each task counts the
+ * tasks it still waits for, and becomes ready when that reaches 0 (so the dependencies must not form a cycle).
+ * Each worker keeps the tasks it made ready in a heap of its own and runs the highest priority one first; a worker
+ * with none takes the highest priority task of another (work stealing). So the tasks a worker made ready, whose
+ * inputs it has just written, mostly stay on it, and the priorities (e.g. the SSL files before the signature files)
+ * hold for each worker.
+ *
+ * Tasks can add tasks while running; those are ready at once. cancel() (or a task throwing) stops tasks from being
+ * started, and running tasks that look at cancelled() can stop early; run() then returns false, or rethrows the
+ * first exception. Each worker has a scratch region (scratch()) for the data of its tasks, freed when run() ends.
+ *
+ * run() is start() and then wait(). A thread with something else to do meanwhile (e.g. loading the binary while its
+ * signature files are read) calls start(), does it, and then calls wait(); the other workers have started on the
+ * tasks, and the calling thread joins them as the first worker in wait().
+ *
+ * While a trace hook is set (see setTraceHook(), which TraceWatcher does), each task is reported as it starts and
+ * ends, with its name and worker.
+ *
+ * isParallel() tells whether any scheduler is running tasks on more than one thread, so that what they share can skip
+ * its locks the rest of the time (see NameTable).
+ */
+class TaskScheduler {
+  public:
+    typedef size_t TaskId;
+    typedef void (*TraceHook)(const char *name, int worker, bool begin);
+
+    /**
+     * \class Scratch
+     * A bump-pointer region for the temporary data of the tasks of one worker, which needs no locking since only
+     * that worker uses it. Unlike Arena, it is not for IR objects: all of it is freed when run() ends.
+     */
+    class Scratch {
+        static const size_t BLOCK_SIZE = 64 * 1024;
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char *next = nullptr;
+        char *limit = nullptr;
+
+      public:
+        void *allocate(size_t size);
+        void release();
+    };
+
+  private:
+    struct Task {
+        std::function<void()> work;
+        const char *name;
+        int priority;
+        size_t waitingFor = 0;         //!< Tasks to finish before this one is ready
+        std::vector<TaskId> dependents; //!< Tasks waiting for this one
+    };
+    //! A ready task as the heaps hold it, with its priority so that they need not look at the tasks
+    struct Ready {
+        int priority;
+        TaskId id;
+    };
+    struct Worker {
+        std::mutex lock;
+        std::vector<Ready> ready; //!< A heap by priority, then by the order the tasks were added
+        Scratch scratch;
+    };
+
+    unsigned numWorkers;
+    std::vector<std::unique_ptr<Task>> tasks; //!< By id; only added to (under lock) while running
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> started;        //!< Of the workers but the first, from start() to wait()
+    std::mutex lock;                         //!< Of tasks, and of the counts of the tasks while running
+    std::condition_variable wake;            //!< Signalled when tasks become ready or the run is over
+    size_t unfinished = 0;                   //!< Tasks added and not yet run (or skipped)
+    size_t readyCount = 0;                   //!< Tasks in the heaps of the workers
+    bool running = false;
+    std::atomic<bool> cancelling{false};
+    std::exception_ptr failure;
+
+    static TraceHook traceHook;
+    static std::atomic<int> parallelRuns; //!< Schedulers between start() and the end of wait() with several workers
+
+    static bool runsAfter(const Ready &a, const Ready &b);
+    void makeReady(TaskId t, int priority, unsigned worker);
+    bool take(unsigned worker, TaskId &t);
+    void finish(TaskId t, unsigned worker);
+    void workLoop(unsigned worker);
+
+  public:
+    explicit TaskScheduler(unsigned numWorkers = 0);
+    ~TaskScheduler();
+    TaskScheduler(const TaskScheduler &) = delete;
+    TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+    unsigned getNumWorkers() const { return numWorkers; }
+
+    TaskId add(const char *name, std::function<void()> work, int priority = 0);
+    void addDependency(TaskId first, TaskId then);
+    bool run();
+    void start();
+    bool wait();
+
+    void cancel() { cancelling = true; }
+    bool cancelled() const { return cancelling; }
+
+    static int currentWorker();
+    static bool isParallel() { return parallelRuns.load(std::memory_order_relaxed) > 0; }
+    Scratch &scratch();
+
+    static void setTraceHook(TraceHook hook) { traceHook = hook; }
+};
+
+#endif // __TASKSCHEDULER_H__
@@ -0,0 +1,78 @@
+/***************************************************************************/ /**
+  * \file       tracewatcher.h
+  * \brief   Timeline of decoding, decompilation and code generation in the Chrome trace event format
+  ******************************************************************************/
+
+#ifndef __TRACEWATCHER_H__
+#define __TRACEWATCHER_H__
+
+#include "decompilercontext.h"
+
+#include <QString>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \class TraceWatcher
+ * Records, as it is told of them through the Watcher alerts (and the codegen ones), when each procedure starts and
+ * ends being decompiled, each depth of its SSA passes, its propagations and its code generation, together with the
+ * decoding of the program. Enabled with --trace, and written to trace.json in the output directory at the end, for
+ * chrome://tracing or Perfetto (ui.perfetto.dev) to show.
+ *
+ * The stages of a procedure are async events ("b"/"e") with the procedure as id, since the procedures of a recursion
+ * group are decompiled in turns and do not nest on the thread doing it. Each event also carries the thread it came
+ * from (as a small number), and the SSA depth where there is one. Alerts are not always paired (a procedure restored
+ * from the cache only ends), so the stages still open for a procedure are closed when it becomes final.
+ *
+ * The tasks of a TaskScheduler are shown too, as program wide events on the thread of the worker running them.
+ */
+class TraceWatcher : public Watcher {
+    struct Event {
+        char phase;       //!< 'b', 'e' or 'n' (async begin, end, instant), or 'B', 'E' (program wide, on the thread)
+        const void *id;   //!< The procedure, or nullptr for program wide events
+        QString name;     //!< Of the stage
+        QString proc;     //!< Name of the procedure
+        int depth;        //!< SSA depth, or -1
+        int thread;
+        double micros;    //!< Since the trace was started
+    };
+    std::vector<Event> events;
+    std::map<const void *, std::vector<QString>> open; //!< The stages open for each procedure, innermost last
+    std::map<std::thread::id, int> threads;
+    std::chrono::steady_clock::time_point start;
+    std::mutex lock;
+    bool enabled = false;
+
+    void add(char phase, const Function *p, const QString &name, int depth = -1);
+    void begin(const Function *p, const QString &name, int depth = -1);
+    void end(const Function *p, const QString &name);
+    void endAll(const Function *p);
+    static void traceTask(const char *name, int worker, bool begin);
+
+  public:
+    static TraceWatcher &get();
+
+    void setEnabled(bool b);
+    bool isEnabled() const { return enabled; }
+    bool writeJSON(const QString &path);
+
+    void alertStartDecode(ADDRESS start, int nBytes) override;
+    void alertEndDecode() override;
+    void alertDecode(Function *p, ADDRESS pc, ADDRESS last, int nBytes) override;
+    void alertStartDecompile(UserProc *p) override;
+    void alertDecompiling(UserProc *p) override;
+    void alertProcStatusChange(UserProc *p) override;
+    void alertDecompileSSADepth(UserProc *p, int depth) override;
+    void alertDecompileBeforePropagate(UserProc *p, int depth) override;
+    void alertDecompileAfterPropagate(UserProc *p, int depth) override;
+    void alertDecompileAfterRemoveStmts(UserProc *p, int depth) override;
+    void alertEndDecompile(UserProc *p) override;
+    void alertStartCodeGen(UserProc *p) override;
+    void alertEndCodeGen(UserProc *p) override;
+};
+
+#endif // __TRACEWATCHER_H__
@@ -7,11 +7,23 @@
   ******************************************************************************/
 
 #pragma once
+#include "operator.h"
+
+#include <cstddef>
 #include <list>
+#include <vector>
 class Exp;
 class ExpTransformer {
   protected:
     static std::list<ExpTransformer *> transformers;
+    //! transformers, bucketed by the root operator and arity they can apply to (see candidates())
+    static std::vector<std::vector<ExpTransformer *>> index;
+    static bool indexValid;
+    size_t order; //!< Position in transformers
+
+    static bool createdBefore(const ExpTransformer *a, const ExpTransformer *b);
+    static void buildIndex();
+    static const std::vector<ExpTransformer *> &candidates(const Exp *e);
 
   public:
     ExpTransformer();
@@ -19,6 +31,11 @@ class ExpTransformer {
 
     static void loadAll();
 
+    //! Root operator of the expressions applyTo() can change, or opWild if it isn't restricted to one
+    virtual OPER rootOper() const { return opWild; }
+    //! Arity of those expressions, or -1 if any
+    virtual int rootArity() const { return -1; }
+
     virtual Exp *applyTo(Exp *e, bool &bMod) = 0;
     static Exp *applyAllTo(Exp *e, bool &bMod);
 };
@@ -19,6 +19,7 @@
 #include "memo.h"
 #include "types.h" // For STD_SIZE
 
+#include <atomic>
 #include <string>
 #include <map>
 #include <memory>
@@ -29,6 +30,7 @@
 #include <fstream>
 #include <QString>
 #include <QMap>
+#include <QStringList>
 
 class Signature;
 class UserProc;
@@ -86,14 +88,26 @@ protected:
 
 private:
     static QMap<QString, SharedType > namedTypes;
+    //! Bumped whenever the size of a type may have changed (see layoutChanged), on any thread: the signature files
+    //! may be parsed on several
+    static std::atomic<unsigned> layoutVersion;
+    //! Asked to define a named type that is not known yet (see setNamedTypeResolver)
+    static std::function<bool(const QString &)> namedTypeResolver;
 public:
-    // Constructors
+    // Constructors. They and the destructor count the type for MemStats
     Type(eType id);
+    Type(const Type &other);
     virtual ~Type();
     eType getId() const { return id; }
 
     static void addNamedType(const QString &name, SharedType type);
     static SharedType getNamedType(const QString &name);
+    static unsigned getLayoutVersion() { return layoutVersion.load(std::memory_order_relaxed); }
+    //! To be called after changing a type in place in a way that can change its size, including redefining a
+    //! named type: any structure may have it as a member, and must then recompute its member offsets
+    static void layoutChanged() { layoutVersion.fetch_add(1, std::memory_order_relaxed); }
+    static QStringList getNamedTypeNames();
+    static void setNamedTypeResolver(std::function<bool(const QString &)> resolver) { namedTypeResolver = resolver; }
 
     // Return type for given temporary variable name
     static SharedType getTempType(const QString &name);
@@ -124,6 +138,12 @@ public:
     std::shared_ptr<T> as();
     template <class T>
     std::shared_ptr<const T> as() const;
+    //! Like as(), but a plain pointer, for where the type is only looked at: no reference count is touched, which
+    //! is most of the cost of a meet of two small types
+    template <class T>
+    T *ptrAs();
+    template <class T>
+    const T *ptrAs() const;
 
     // These replace type casts
     std::shared_ptr<VoidType> asVoid();
@@ -220,7 +240,7 @@ public:
     // For data-flow-based type analysis only: implement the meet operator. Set ch true if any change
     // If bHighestPtr is true, then if this and other are non void* pointers, set the result to the
     // *highest* possible type compatible with both (i.e. this JOIN other)
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr = false) const = 0;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr = false) const = 0;
     // When all=false (default), return true if can use this and other interchangeably; in particular,
     // if at most one of the types is compound and the first element is compatible with the other, then
     // the types are considered compatible. With all set to true, if one or both types is compound, all
@@ -230,9 +250,9 @@ public:
     // reverses the parameters (this and other) to prevent many tedious repetitions
     virtual bool isCompatible(const Type &other, bool all) const = 0;
     // Return true if this is a subset or equal to other
-    bool isSubTypeOrEqual(SharedType other);
+    bool isSubTypeOrEqual(const SharedType &other);
     // Create a union of this Type and other. Set ch true if any change
-    SharedType createUnion(SharedType other, bool &ch, bool bHighestPtr = false) const;
+    SharedType createUnion(const SharedType &other, bool &ch, bool bHighestPtr = false) const;
     static SharedType newIntegerLikeType(int size, int signedness); // Return a new Bool/Char/Int
     // From a complex type like an array of structs with a float, return a list of components so you
     // can construct e.g. myarray1[8].mystruct2.myfloat7
@@ -252,7 +272,7 @@ public:
     virtual bool isVoid() const { return true; }
 
     virtual SharedType clone() const;
-    static std::shared_ptr<VoidType> get() { return std::make_shared<VoidType>(); }
+    static std::shared_ptr<VoidType> get();
 
     virtual bool operator==(const Type &other) const;
     // virtual bool          operator-=(const Type& other) const;
@@ -263,7 +283,7 @@ public:
 
     virtual QString getCtype(bool final = false) const;
 
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatible(const Type &other, bool all) const;
 
 protected:
@@ -296,7 +316,7 @@ public:
     // Split the C type into return and parameter parts
     void getReturnAndParam(QString &ret, QString &param);
 
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatible(const Type &other, bool all) const;
 
 protected:
@@ -326,7 +346,10 @@ public:
     virtual Exp *match(SharedType pattern);
 
     virtual size_t getSize() const; // Get size in bits
-    virtual void setSize(size_t sz) { size = sz; }
+    virtual void setSize(size_t sz) {
+        size = sz;
+        layoutChanged();
+    }
     // Is it signed? 0=unknown, pos=yes, neg = no
     bool isSigned() { return signedness >= 0; }   // True if not unsigned
     bool isUnsigned() { return signedness <= 0; } // True if not definately signed
@@ -342,7 +365,7 @@ public:
 
     virtual QString getTempName() const override;
 
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatible(const Type &other, bool all) const;
 
 protected:
@@ -367,13 +390,16 @@ public:
     virtual Exp *match(SharedType pattern);
 
     virtual size_t getSize() const;
-    virtual void setSize(size_t sz) { size = sz; }
+    virtual void setSize(size_t sz) {
+        size = sz;
+        layoutChanged();
+    }
 
     virtual QString getCtype(bool final = false) const;
 
     virtual QString getTempName() const override;
 
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatible(const Type &other, bool all) const;
 
 protected:
@@ -385,7 +411,7 @@ public:
     BooleanType();
     virtual ~BooleanType();
     virtual bool isBoolean() const { return true; }
-    static std::shared_ptr<BooleanType> get() { return std::make_shared<BooleanType>(); }
+    static std::shared_ptr<BooleanType> get();
     virtual SharedType clone() const;
 
     virtual bool operator==(const Type &other) const;
@@ -397,7 +423,7 @@ public:
 
     virtual QString getCtype(bool final = false) const;
 
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatible(const Type &other, bool all) const;
 
 protected:
@@ -411,7 +437,7 @@ public:
     virtual bool isChar() const { return true; }
 
     virtual SharedType clone() const;
-    static std::shared_ptr<CharType> get() {return std::make_shared<CharType>();}
+    static std::shared_ptr<CharType> get();
     virtual bool operator==(const Type &other) const;
     // virtual bool        operator-=(const Type& other) const;
     virtual bool operator<(const Type &other) const;
@@ -421,7 +447,7 @@ public:
 
     virtual QString getCtype(bool final = false) const;
 
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatible(const Type &other, bool all) const;
 
 protected:
@@ -457,7 +483,7 @@ public:
 
     virtual QString getCtype(bool final = false) const;
 
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatible(const Type &other, bool all) const;
 
 protected:
@@ -484,7 +510,10 @@ public:
     void setBaseType(SharedType b);
     void fixBaseType(SharedType b);
     size_t getLength() const { return Length; }
-    void setLength(unsigned n) { Length = n; }
+    void setLength(unsigned n) {
+        Length = n;
+        layoutChanged();
+    }
     bool isUnbounded() const;
 
     virtual SharedType clone() const;
@@ -499,7 +528,7 @@ public:
 
     virtual QString getCtype(bool final = false) const;
 
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatibleWith(const Type &other, bool all = false) const { return isCompatible(other, all); }
     virtual bool isCompatible(const Type &other, bool all) const;
 
@@ -536,7 +565,7 @@ public:
 
     virtual QString getCtype(bool final = false) const;
 
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatible(const Type &other, bool all) const;
 
 protected:
@@ -550,6 +579,14 @@ private:
     std::vector<QString> names;
     int nextGenericMemberNum;
     bool generic;
+    //! Bit offset of each member, followed by the total size; empty when it must be rebuilt (see getOffsets)
+    mutable std::vector<unsigned> offsets;
+    mutable unsigned offsetsVersion = 0;          //!< Layout version the offsets were computed against
+    mutable std::map<QString, unsigned> nameIndex; //!< Index of the first member of each name, built with offsets
+
+    const std::vector<unsigned> &getOffsets() const;
+    void invalidateOffsets() const { offsets.clear(); }
+    int findMemberAt(unsigned n) const;
 
 public:
     CompoundType(bool generic = false);
@@ -564,6 +601,7 @@ public:
 
         types.push_back(n);
         names.push_back(str);
+        layoutChanged();
     }
     size_t getNumTypes() const { return types.size(); }
     SharedType getType(unsigned n) {
@@ -599,7 +637,7 @@ public:
     bool isSuperStructOf(const SharedType &other); // True if this is is a superstructure of other
     bool isSubStructOf(SharedType other) const;   // True if this is is a substructure of other
 
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatibleWith(const Type &other, bool all = false) const { return isCompatible(other, all); }
     virtual bool isCompatible(const Type &other, bool all) const;
 
@@ -641,7 +679,7 @@ public:
 
     virtual QString getCtype(bool final = false) const;
 
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatibleWith(const Type &other, bool all) const { return isCompatible(other, all); }
     virtual bool isCompatible(const Type &other, bool all) const;
     // if this is a union of pointer types, get the union of things they point to. In dfa.cpp
@@ -669,11 +707,14 @@ public:
     virtual SharedType mergeWith(SharedType other) const;
 
     virtual size_t getSize() const;
-    virtual void setSize(size_t sz) { size = sz; }
+    virtual void setSize(size_t sz) {
+        size = sz;
+        layoutChanged();
+    }
     virtual bool isSize() const { return true; }
     virtual bool isComplete() { return false; } // Basic type is unknown
     virtual QString getCtype(bool final = false) const;
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatible(const Type &other, bool) const;
 
     friend class XMLProgParser;
@@ -694,14 +735,17 @@ public:
     virtual SharedType mergeWith(SharedType other) const;
     SharedType getBaseType() { return base_type; }
     const SharedType getBaseType() const { return base_type; }
-    void setBaseType(SharedType b) { base_type = b; }
+    void setBaseType(SharedType b) {
+        base_type = b;
+        layoutChanged();
+    }
 
     virtual size_t getSize() const { return base_type->getSize() / 2; }
     virtual void setSize(size_t sz); // Does this make sense?
     virtual bool isUpper() const { return true; }
     virtual bool isComplete() { return base_type->isComplete(); }
     virtual QString getCtype(bool final = false) const;
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatible(const Type &other, bool all) const;
 
 }; // class UpperType
@@ -720,14 +764,17 @@ public:
     virtual SharedType mergeWith(SharedType other) const;
     SharedType getBaseType() { return base_type; }
     const SharedType getBaseType() const { return base_type; }
-    void setBaseType(SharedType b) { base_type = b; }
+    void setBaseType(SharedType b) {
+        base_type = b;
+        layoutChanged();
+    }
 
     virtual size_t getSize() const { return base_type->getSize() / 2; }
     virtual void setSize(size_t sz); // Does this make sense?
     virtual bool isLower() const { return true; }
     virtual bool isComplete() { return base_type->isComplete(); }
     virtual QString getCtype(bool final = false) const;
-    virtual SharedType meetWith(SharedType other, bool &ch, bool bHighestPtr) const;
+    virtual SharedType meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const;
     virtual bool isCompatible(const Type &other, bool all) const;
 
 }; // class LowerType
@@ -798,5 +845,23 @@ std::shared_ptr<const T> Type::as() const {
     assert(res);
     return res;
 }
+template <class T>
+T *Type::ptrAs() {
+    Type *ty = this;
+    if (isNamed())
+        ty = static_cast<NamedType *>(this)->resolvesTo().get(); // Kept alive by the table of named types
+    T *res = dynamic_cast<T *>(ty);
+    assert(res);
+    return res;
+}
+template <class T>
+const T *Type::ptrAs() const {
+    const Type *ty = this;
+    if (isNamed())
+        ty = static_cast<const NamedType *>(this)->resolvesTo().get();
+    const T *res = dynamic_cast<const T *>(ty);
+    assert(res);
+    return res;
+}
 
 #endif // __TYPE_H__
@@ -7,6 +7,7 @@
 #define __UTIL_H__
 
 #include <QString>
+#include <cstddef>
 #include <string>
 struct Printable {
     virtual QString toString() const = 0;
@@ -14,6 +15,32 @@ struct Printable {
 // was a workaround
 #define STR(x) (char *)(x.str().c_str())
 
+class QTextStream;
+
+/**
+ * \class TextScratch
+ * A QString and a QTextStream writing to it, to print into. They are taken from a pool of the thread and given back,
+ * emptied but with the storage kept, when the TextScratch goes out of scope; so the prints() functions and the log
+ * operators for Exp, Instruction and RTL neither allocate a string and stream each time nor share them between
+ * threads. Nested uses (printing something while printing something else) each get their own.
+ */
+class TextScratch {
+  public:
+    struct Entry;
+
+  private:
+    Entry *entry;
+
+  public:
+    TextScratch();
+    ~TextScratch();
+    TextScratch(const TextScratch &) = delete;
+    TextScratch &operator=(const TextScratch &) = delete;
+    QTextStream &stream();
+    const QString &text();
+    char *copyTo(char *buf, size_t size);
+};
+
 QString escapeStr(const QString &str);
 int lockFileWrite(const char *fname);
 void unlockFile(int n);
@@ -16,6 +16,8 @@
   * StmtExpVisitor    | (visit expressions in statements)
   * ExpModifier       | (modify expressions)
   * SimpExpModifier   | (simplifying expression modifier)
+  * ExpModifierPipeline | (several expression modifiers in one walk)
+  * ExpWalker         | (accept() for one final visitor or modifier class, without virtual calls)
   * StmtModifier      | (modify expressions in statements; not abstract)
   * StmtPartModifier  | (as above with special case for whole of LHS)
   *
@@ -37,6 +39,10 @@
 #include "exp.h" // Needs to know class hierarchy, e.g. so that can convert Unary* to Exp* in return of
                  // ExpModifier::preVisit()
 
+#include <bitset>
+#include <typeinfo>
+#include <vector>
+
 class Instruction;
 class Assignment;
 class Assign;
@@ -127,13 +133,18 @@ class GetProcVisitor : public ExpVisitor {
     // All others inherit and visit their children
 };
 
-// This class visits subexpressions, and if a Const, sets or clears a new conscript
+// This class visits subexpressions, and if a Const, sets or clears a new conscript. The constants numbered are
+// appended to \a numbered when given, so that their conscripts can be cleared without walking the expressions again
 class SetConscripts : public ExpVisitor {
     int curConscript;
     bool bInLocalGlobal; // True when inside a local or global
     bool bClear;         // True when clearing, not setting
+    std::vector<Const *> *numbered;
   public:
-    SetConscripts(int n, bool _bClear) : bInLocalGlobal(false), bClear(_bClear) { curConscript = n; }
+    SetConscripts(int n, bool _bClear, std::vector<Const *> *_numbered = nullptr)
+        : bInLocalGlobal(false), bClear(_bClear), numbered(_numbered) {
+        curConscript = n;
+    }
     int getLast() { return curConscript; }
     virtual bool visit(Const *e);
     virtual bool visit(Location *e, bool &override);
@@ -203,6 +214,129 @@ class ExpModifier {
     virtual Exp *postVisit(TypeVal *e) { return e; }
 };
 
+/*
+ * ExpWalker<V> does what Exp::accept(V *) does, for a visitor or modifier of class V. Instead of a virtual accept() and
+ * a virtual visit() (or preVisit() and postVisit()) per node, it switches on Exp::getKind() and calls V's members by
+ * their qualified names, so that they can be inlined. V must be final (so these are the members accept() would call)
+ * and must bring the overloads of its base class that it hides back into scope with a using declaration.
+ * Used for the visitors that run on every expression of every statement, e.g. UsedLocsFinder and ExpSubscripter.
+ */
+template <class V> class ExpWalker {
+  public:
+    static bool visit(Exp *e, V &v) {
+        assert(typeid(v) == typeid(V)); // Else the members of the derived class would be skipped
+        return walk(e, v);
+    }
+    static Exp *modify(Exp *e, V &v) {
+        assert(typeid(v) == typeid(V));
+        return rewrite(e, v);
+    }
+
+  private:
+    static bool walk(Exp *e, V &v) {
+        switch (e->getKind()) {
+        case ExpKind::Const:
+            return v.V::visit(static_cast<Const *>(e));
+        case ExpKind::Terminal:
+            return v.V::visit(static_cast<Terminal *>(e));
+        case ExpKind::TypeVal:
+            return v.V::visit(static_cast<TypeVal *>(e));
+        case ExpKind::Unary:
+            return visitInner(static_cast<Unary *>(e), v);
+        case ExpKind::Binary:
+            return visitInner(static_cast<Binary *>(e), v);
+        case ExpKind::Ternary:
+            return visitInner(static_cast<Ternary *>(e), v);
+        case ExpKind::TypedExp:
+            return visitInner(static_cast<TypedExp *>(e), v);
+        case ExpKind::FlagDef:
+            return visitInner(static_cast<FlagDef *>(e), v);
+        case ExpKind::RefExp:
+            return visitInner(static_cast<RefExp *>(e), v);
+        case ExpKind::Location:
+            return visitInner(static_cast<Location *>(e), v);
+        }
+        assert(false);
+        return false;
+    }
+
+    static Exp *rewrite(Exp *e, V &v) {
+        switch (e->getKind()) {
+        case ExpKind::Const:
+            return modifyLeaf(static_cast<Const *>(e), v);
+        case ExpKind::Terminal:
+            return modifyLeaf(static_cast<Terminal *>(e), v);
+        case ExpKind::TypeVal:
+            return modifyLeaf(static_cast<TypeVal *>(e), v);
+        case ExpKind::Unary:
+            return modifyInner(static_cast<Unary *>(e), v);
+        case ExpKind::Binary:
+            return modifyInner(static_cast<Binary *>(e), v);
+        case ExpKind::Ternary:
+            return modifyInner(static_cast<Ternary *>(e), v);
+        case ExpKind::TypedExp:
+            return modifyInner(static_cast<TypedExp *>(e), v);
+        case ExpKind::FlagDef:
+            return modifyInner(static_cast<FlagDef *>(e), v);
+        case ExpKind::RefExp:
+            return modifyInner(static_cast<RefExp *>(e), v);
+        case ExpKind::Location:
+            return modifyInner(static_cast<Location *>(e), v);
+        }
+        assert(false);
+        return e;
+    }
+
+    // RefExps are visited by reference, everything else by pointer
+    template <class T> static bool visitNode(T *e, V &v, bool &override) { return v.V::visit(e, override); }
+    static bool visitNode(RefExp *e, V &v, bool &override) { return v.V::visit(*e, override); }
+
+    static bool visitChildren(Unary *e, V &v) { return walk(e->subExp1, v); }
+    static bool visitChildren(Binary *e, V &v) { return walk(e->subExp1, v) && walk(e->subExp2, v); }
+    static bool visitChildren(Ternary *e, V &v) {
+        return walk(e->subExp1, v) && walk(e->subExp2, v) && walk(e->subExp3, v);
+    }
+    template <class T> static bool visitInner(T *e, V &v) {
+        bool override = false;
+        bool ret = visitNode(e, v, override);
+        if (override || !ret)
+            return ret;
+        return visitChildren(e, v);
+    }
+
+    //! Rewrite \a child in place; \returns true if it was replaced
+    static bool modifyChild(Exp *&child, V &v) {
+        Exp *e = rewrite(child, v);
+        if (e == child)
+            return false;
+        child = e;
+        return true;
+    }
+    static bool modifyChildren(Unary *e, V &v) { return modifyChild(e->subExp1, v); }
+    static bool modifyChildren(Binary *e, V &v) {
+        bool changed = modifyChild(e->subExp1, v);
+        return modifyChild(e->subExp2, v) || changed;
+    }
+    static bool modifyChildren(Ternary *e, V &v) {
+        bool changed = modifyChild(e->subExp1, v);
+        changed = modifyChild(e->subExp2, v) || changed;
+        return modifyChild(e->subExp3, v) || changed;
+    }
+    // As in accept(), the result of preVisit is treated as the same class as the node; postVisit doesn't care if it
+    // isn't. Changes made inside a child went through the setters (or a modifyChildren of their own), so the caches
+    // need only be invalidated here when a child was replaced.
+    template <class T> static Exp *modifyInner(T *e, V &v) {
+        bool recur;
+        T *ret = static_cast<T *>(v.V::preVisit(e, recur));
+        if (recur && modifyChildren(e, v))
+            Exp::changed();
+        return v.V::postVisit(ret);
+    }
+    template <class T> static Exp *modifyLeaf(T *e, V &v) {
+        return v.V::postVisit(static_cast<T *>(v.V::preVisit(e)));
+    }
+};
+
 /*
  * The StmtVisitor class is used for code that has to work with all the Statement classes. One advantage is that you
  * don't need to declare a function in every class derived from Statement: the accept methods already do that for you.
@@ -232,9 +366,11 @@ class StmtVisitor {
 class StmtConscriptSetter : public StmtVisitor {
     int curConscript;
     bool bClear;
+    std::vector<Const *> *numbered; // See SetConscripts
 
   public:
-    StmtConscriptSetter(int n, bool _bClear) : curConscript(n), bClear(_bClear) {}
+    StmtConscriptSetter(int n, bool _bClear, std::vector<Const *> *_numbered = nullptr)
+        : curConscript(n), bClear(_bClear), numbered(_numbered) {}
     int getLast() { return curConscript; }
 
     virtual bool visit(Assign *stmt);
@@ -443,15 +579,16 @@ class SimpExpModifier : public ExpModifier {
 // NOTE: this is sometimes not enough! Consider changing (r+x)+K2) where x gets changed to K1. Now you have (r+K1)+K2,
 // but simplifying only the parent doesn't simplify the K1+K2.
 // Used to also propagate, but this became unwieldy with -l propagation limiting
-class CallBypasser : public SimpExpModifier {
+class CallBypasser final : public SimpExpModifier {
     Instruction *enclosingStmt; // Statement that is being modified at present, for debugging only
   public:
     CallBypasser(Instruction *enclosing) : enclosingStmt(enclosing) {}
+    using SimpExpModifier::postVisit;
     virtual Exp *postVisit(RefExp *e);
     virtual Exp *postVisit(Location *e);
 };
 
-class UsedLocsFinder : public ExpVisitor {
+class UsedLocsFinder final : public ExpVisitor {
     LocationSet *used; // Set of Exps
     bool memOnly;      // If true, only look inside m[...]
   public:
@@ -462,6 +599,7 @@ class UsedLocsFinder : public ExpVisitor {
     void setMemOnly(bool b) { memOnly = b; }
     bool isMemOnly() { return memOnly; }
 
+    using ExpVisitor::visit;
     virtual bool visit(RefExp &e, bool &override);
     virtual bool visit(Location *e, bool &override);
     virtual bool visit(Terminal *e);
@@ -488,9 +626,12 @@ class UsedLocalFinder : public ExpVisitor {
 };
 
 class UsedLocsVisitor : public StmtExpVisitor {
-    bool countCol; // True to count uses in collectors
+    bool countCol;       // True to count uses in collectors
+    UsedLocsFinder *ulf; // ev, if it is a UsedLocsFinder (ev may be a UsedLocalFinder)
+    bool visitExp(Exp *e) { return ulf ? ExpWalker<UsedLocsFinder>::visit(e, *ulf) : e->accept(ev); }
+
   public:
-    UsedLocsVisitor(ExpVisitor *v, bool cc) : StmtExpVisitor(v), countCol(cc) {}
+    UsedLocsVisitor(ExpVisitor *v, bool cc) : StmtExpVisitor(v), countCol(cc), ulf(dynamic_cast<UsedLocsFinder *>(v)) {}
     virtual ~UsedLocsVisitor() {}
     // Needs special attention because the lhs of an assignment isn't used (except where it's m[blah], when blah is
     // used)
@@ -507,12 +648,13 @@ class UsedLocsVisitor : public StmtExpVisitor {
     virtual bool visit(ReturnStatement *stmt, bool &override);
 };
 
-class ExpSubscripter : public ExpModifier {
+class ExpSubscripter final : public ExpModifier {
     Exp *search;
     Instruction *def;
 
   public:
     ExpSubscripter(Exp *s, Instruction *d) : search(s), def(d) {}
+    using ExpModifier::preVisit;
     virtual Exp *preVisit(Location *e, bool &recur);
     virtual Exp *preVisit(Binary *e, bool &recur);
     virtual Exp *preVisit(Terminal *e);
@@ -520,8 +662,11 @@ class ExpSubscripter : public ExpModifier {
 };
 
 class StmtSubscripter : public StmtModifier {
+    ExpSubscripter *es; // mod, with its class known
+    Exp *subscript(Exp *e) { return ExpWalker<ExpSubscripter>::modify(e, *es); }
+
   public:
-    StmtSubscripter(ExpSubscripter *es) : StmtModifier(es) {}
+    StmtSubscripter(ExpSubscripter *_es) : StmtModifier(_es), es(_es) {}
     virtual ~StmtSubscripter() {}
 
     virtual void visit(Assign *s, bool &recur);
@@ -531,6 +676,43 @@ class StmtSubscripter : public StmtModifier {
     virtual void visit(CallStatement *s, bool &recur);
 };
 
+// Replaces each subexpression that is one of the searches of an ExpReplaceMap with a clone of its replacement, as
+// searchReplaceAll does for a single search: nothing inside a match (or inside a replacement) is searched again
+class ExpReplacer final : public ExpModifier {
+    const ExpReplaceMap &replacements;
+    std::bitset<opNumOf> opers; // The operators of the searches; nodes with other operators can't match
+    bool change;
+    Exp *replace(Exp *e, bool &recur);
+
+  public:
+    ExpReplacer(const ExpReplaceMap &r);
+    bool isChanged() { return change; }
+    void clearChanged() { change = false; }
+    virtual Exp *preVisit(Unary *e, bool &recur) { return replace(e, recur); }
+    virtual Exp *preVisit(Binary *e, bool &recur) { return replace(e, recur); }
+    virtual Exp *preVisit(Ternary *e, bool &recur) { return replace(e, recur); }
+    virtual Exp *preVisit(TypedExp *e, bool &recur) { return replace(e, recur); }
+    virtual Exp *preVisit(FlagDef *e, bool &recur) { return replace(e, recur); }
+    virtual Exp *preVisit(RefExp *e, bool &recur) { return replace(e, recur); }
+    virtual Exp *preVisit(Location *e, bool &recur) { return replace(e, recur); }
+    virtual Exp *preVisit(Const *e);
+    virtual Exp *preVisit(Terminal *e);
+    virtual Exp *preVisit(TypeVal *e);
+};
+
+// Makes the replacements of an ExpReplacer in the same parts of a statement as Instruction::searchAndReplace
+class StmtReplacer : public StmtModifier {
+    ExpReplacer *er; // mod, with its class known
+    Exp *replace(Exp *e) { return ExpWalker<ExpReplacer>::modify(e, *er); }
+
+  public:
+    StmtReplacer(ExpReplacer *_er, bool cc) : StmtModifier(_er, !cc), er(_er) {}
+    virtual void visit(Assign *s, bool &recur);
+    virtual void visit(PhiAssign *s, bool &recur);
+    virtual void visit(BoolAssign *s, bool &recur);
+    virtual void visit(ReturnStatement *s, bool &recur);
+};
+
 class SizeStripper : public ExpModifier {
   public:
     SizeStripper() {}
@@ -539,6 +721,61 @@ class SizeStripper : public ExpModifier {
     virtual Exp *preVisit(Binary *b, bool &recur);
 };
 
+// ExpModifierPipeline applies several ExpModifiers in a single walk of each expression, instead of one walk per
+// modifier, e.g. StmtModifier sm(&pipeline) modifies all the expressions of a statement with every stage while they are
+// still in the cache. At each node the stages are applied in the order they were added. Only the first stage may take
+// over an inner node in its preVisit (return another expression, or stop the recursion); the later stages then walk
+// what it returned, as they would have done after it when run separately. Any stage may replace a leaf
+// (Const, Terminal, TypeVal); the stages after it walk the replacement.
+// The result is the same as running the stages one after the other, provided that no stage cares whether the later
+// stages have already been applied to the children of the node it is looking at (true for local rewrites such as
+// simplification, casting constants and bypassing).
+class ExpModifierPipeline : public ExpModifier {
+    struct Frame {
+        size_t numStages; // The number of stages (from the first) applied to this node
+        bool takenOver;   // Set if the first stage took over the node, so that only it visits the children
+    };
+    std::vector<ExpModifier *> stages;
+    std::vector<Frame> frames; // The inner nodes being visited, from the top down
+
+    size_t stagesHere() const {
+        if (frames.empty())
+            return stages.size();
+        return frames.back().takenOver ? 1 : frames.back().numStages;
+    }
+    void noteMods();
+    template <class T> Exp *preVisitInner(T *e, bool &recur);
+    template <class T> Exp *postVisitInner(T *e);
+    template <class T> Exp *visitLeaf(T *e);
+
+  public:
+    ExpModifierPipeline() {}
+    ExpModifierPipeline(const std::vector<ExpModifier *> &s) : stages(s) {}
+    //! Append \a stage; the pipeline does not take ownership of it
+    void add(ExpModifier *stage) { stages.push_back(stage); }
+    bool empty() const { return stages.empty(); }
+
+    virtual Exp *preVisit(Unary *e, bool &recur);
+    virtual Exp *preVisit(Binary *e, bool &recur);
+    virtual Exp *preVisit(Ternary *e, bool &recur);
+    virtual Exp *preVisit(TypedExp *e, bool &recur);
+    virtual Exp *preVisit(FlagDef *e, bool &recur);
+    virtual Exp *preVisit(RefExp *e, bool &recur);
+    virtual Exp *preVisit(Location *e, bool &recur);
+    // The leaves are done completely by the preVisits; the default postVisits return them as they are
+    virtual Exp *preVisit(Const *e);
+    virtual Exp *preVisit(Terminal *e);
+    virtual Exp *preVisit(TypeVal *e);
+
+    virtual Exp *postVisit(Unary *e);
+    virtual Exp *postVisit(Binary *e);
+    virtual Exp *postVisit(Ternary *e);
+    virtual Exp *postVisit(TypedExp *e);
+    virtual Exp *postVisit(FlagDef *e);
+    virtual Exp *postVisit(RefExp *e);
+    virtual Exp *postVisit(Location *e);
+};
+
 class ExpConstCaster : public ExpModifier {
     int num;
     SharedType ty;
@@ -661,11 +898,12 @@ class MemDepthFinder : public ExpVisitor {
 
 // A class to propagate everything, regardless, to this expression. Does not consider memory expressions and whether
 // the address expression is primitive. Use with caution; mostly Statement::propagateTo() should be used.
-class ExpPropagator : public SimpExpModifier {
+class ExpPropagator final : public SimpExpModifier {
     bool change;
 
   public:
     ExpPropagator() : change(false) {}
+    using SimpExpModifier::postVisit;
     bool isChanged() { return change; }
     void clearChanged() { change = false; }
     Exp *postVisit(RefExp *e);
@@ -14,10 +14,16 @@
 #ifndef _XMLPROGPARSER_H_
 #define _XMLPROGPARSER_H_
 
+#include <QtCore/QBuffer>
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
 #include <string>
 #include <list>
 #include <map>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 class Global;
 class Module;
@@ -54,7 +60,7 @@ typedef struct {
 class XMLProgParser {
   public:
     XMLProgParser() {}
-    Prog *parse(const QString &filename);
+    Prog *parse(const QString &filename, const QString &binary = QString());
     void persistToXML(Prog *prog);
     void handleElementStart(QXmlStreamReader &strm);
     void handleElementEnd(const QXmlStreamReader &el);
@@ -155,10 +161,19 @@ class XMLProgParser {
     const char *getAttr(const QXmlStreamAttributes &attr, const char *name);
 
     std::list<Context *> stack;
-    std::map<int, void *> idToX;
-    std::map<int, SharedType> idToType;
+    std::vector<void *> idToX;                   //!< Indexed by the ids of the file being read
+    std::vector<SharedType> idToType;
+    std::map<int, void *> sparseIdToX;           //!< Ids too large for the vectors
+    std::map<int, SharedType> sparseIdToType;
+    std::unordered_map<const void *, int> ids;   //!< Ids given to the objects written so far
+    std::map<QString, QByteArray> fileContents;  //!< The files read by parse(), kept for its second phase
+    std::map<Module *, std::unique_ptr<QBuffer>> outputs; //!< The files being written by persistToXML
     int phase;
 
+    int idOf(const void *p);
+    QIODevice *getOutput(Module *c);
+    void writeOutputs();
+
     void addId(const QXmlStreamAttributes &attr, void *x);
     void addType(const QXmlStreamAttributes &attr, SharedType x);
     void *findId(const QStringRef &id);
@@ -9,6 +9,7 @@
 
 /** \file ArchiveFile.cpp
  * Desc: This file contains the implementation of the ArchiveFile class
+ * \note Not built: this predates the loader plugins (BinaryFileFactory), which don't take archives.
 */
 
 #include "global.h"
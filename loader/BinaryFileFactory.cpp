@@ -17,6 +17,7 @@
 #include <QString>
 #include <QDebug>
 #include <cstdio>
+#include <cstring>
 
 #define LMMH(x)                                                                                                        \
     ((unsigned)((Byte *)(&x))[0] + ((unsigned)((Byte *)(&x))[1] << 8) + ((unsigned)((Byte *)(&x))[2] << 16) +          \
@@ -49,57 +50,137 @@ QObject *BinaryFileFactory::Load(const QString &sName) {
 #define TESTMAGIC2(buf, off, a, b) (buf[off] == a && buf[off + 1] == b)
 #define TESTMAGIC4(buf, off, a, b, c, d) (buf[off] == a && buf[off + 1] == b && buf[off + 2] == c && buf[off + 3] == d)
 
+static const int HEADER_SIZE = 64; //!< How much of the file the probes get to see
+
+//! DOS based files: the kind of file is given by the signature at the offset in the MZ header
+static const char *probeDosBased(const unsigned char *buf, QFile &f) {
+    int peoff = LMMH(buf[0x3C]);
+    unsigned char sig[4];
+    if (peoff != 0 && f.seek(peoff) && f.read((char *)sig, 4) == 4) {
+        if (TESTMAGIC4(sig, 0, 'P', 'E', 0, 0))
+            return "Win32BinaryFile"; /* Win32 Binary */
+        if (TESTMAGIC2(sig, 0, 'L', 'E'))
+            return "DOS4GWBinaryFile"; /* Win32 VxD (Linear Executable) or DOS4GW app */
+        /* NE: Win16 / Old OS/2 Binary; LX: New OS/2 Binary */
+    }
+    /* Assume MS-DOS Real-mode binary. */
+    return "ExeBinaryFile";
+}
+
+//! HP Som binary (last as it's not really particularly good magic)
+static const char *probeHpSom(const unsigned char *buf, QFile &) {
+    if (buf[0] == 0x02 && buf[2] == 0x01 && (buf[1] == 0x10 || buf[1] == 0x0B) &&
+        (buf[3] == 0x07 || buf[3] == 0x08 || buf[4] == 0x0B))
+        return "HpSomBinaryFile";
+    return nullptr;
+}
+
+/**
+ * What each loader plugin recognises: either \a length bytes of \a magic at \a offset in the header, or, for formats
+ * that need more than that, whatever \a probe says (the name of the plugin, or nullptr). The first match wins, and
+ * only the plugin it names is loaded. A new loader adds its line here.
+ */
+struct LoaderSignature {
+    const char *plugin;
+    int offset;
+    const char *magic;
+    int length;
+    const char *(*probe)(const unsigned char *buf, QFile &f);
+};
+static const LoaderSignature loaderSignatures[] = {
+    {"ElfBinaryFile", 0, "\177ELF", 4, nullptr},
+    {nullptr, 0, "MZ", 2, probeDosBased},
+    {"PalmBinaryFile", 0x3C, "appl", 4, nullptr}, /* PRC Palm-pilot binary */
+    {"PalmBinaryFile", 0x3C, "panl", 4, nullptr},
+    {"MachOBinaryFile", 0, "\xfe\xed\xfa\xce", 4, nullptr}, /* Mach-O Mac OS-X binary */
+    {"MachOBinaryFile", 0, "\xce\xfa\xed\xfe", 4, nullptr},
+    {"MachOBinaryFile", 0, "\xca\xfe\xba\xbe", 4, nullptr},
+    {nullptr, 0, nullptr, 0, probeHpSom},
+    {"IntelCoffFile", 0, "\x4c\x01", 2, nullptr},
+};
+
 static QString selectPluginForFile(const QString &sName) {
-    QString libName;
-    unsigned char buf[64];
+    unsigned char buf[HEADER_SIZE] = {0};
     QFile f(sName);
     if(!f.open(QFile::ReadOnly)) {
         fprintf(stderr, "Unable to open binary file: %s\n", qPrintable(sName));
         return nullptr;
     }
     f.read((char *)buf,sizeof(buf));
-    if (TESTMAGIC4(buf, 0, '\177', 'E', 'L', 'F')) {
-        /* ELF Binary */
-        libName = "ElfBinaryFile";
-    } else if (TESTMAGIC2(buf, 0, 'M', 'Z')) { /* DOS-based file */
-        int peoff = LMMH(buf[0x3C]);
-        if (peoff != 0 && f.seek(peoff) ) {
-            f.read((char *)buf,4);
-            if (TESTMAGIC4(buf, 0, 'P', 'E', 0, 0)) {
-                /* Win32 Binary */
-                libName = "Win32BinaryFile";
-            } else if (TESTMAGIC2(buf, 0, 'N', 'E')) {
-                /* Win16 / Old OS/2 Binary */
-            } else if (TESTMAGIC2(buf, 0, 'L', 'E')) {
-                /* Win32 VxD (Linear Executable) or DOS4GW app */
-                libName = "DOS4GWBinaryFile";
-            } else if (TESTMAGIC2(buf, 0, 'L', 'X')) {
-                /* New OS/2 Binary */
-            }
-        }
-        /* Assume MS-DOS Real-mode binary. */
-        if (libName.size() == 0)
-            libName = "ExeBinaryFile";
-    } else if (TESTMAGIC4(buf, 0x3C, 'a', 'p', 'p', 'l') || TESTMAGIC4(buf, 0x3C, 'p', 'a', 'n', 'l')) {
-        /* PRC Palm-pilot binary */
-        libName = "PalmBinaryFile";
-    } else if ((buf[0] == 0xfe && buf[1] == 0xed && buf[2] == 0xfa && buf[3] == 0xce) ||
-               (buf[0] == 0xce && buf[1] == 0xfa && buf[2] == 0xed && buf[3] == 0xfe) ||
-               (buf[0] == 0xca && buf[1] == 0xfe && buf[2] == 0xba && buf[3] == 0xbe)) {
-        /* Mach-O Mac OS-X binary */
-        libName = "MachOBinaryFile";
-    } else if (buf[0] == 0x02 && buf[2] == 0x01 && (buf[1] == 0x10 || buf[1] == 0x0B) &&
-               (buf[3] == 0x07 || buf[3] == 0x08 || buf[4] == 0x0B)) {
-        /* HP Som binary (last as it's not really particularly good magic) */
-        libName = "HpSomBinaryFile";
-    } else if (buf[0] == 0x4c && buf[1] == 0x01) {
-        libName = "IntelCoffFile";
-    } else {
-        fprintf(stderr, "Unrecognised binary file\n");
+    for (const LoaderSignature &sig : loaderSignatures) {
+        if (sig.magic && memcmp(buf + sig.offset, sig.magic, sig.length) != 0)
+            continue;
+        const char *plugin = sig.probe ? sig.probe(buf, f) : sig.plugin;
+        if (plugin)
+            return plugin;
+    }
+    if (memcmp(buf, "!<arch>\n", 8) == 0) {
+        // No loader takes archives (ArchiveFile.cpp and elf/ElfArchiveFile.cpp predate the plugins, and are not built)
+        fprintf(stderr, "%s is an archive: extract its members (ar x) and decompile them one by one\n",
+                qPrintable(sName));
         return "";
     }
-    return libName;
+    fprintf(stderr, "Unrecognised binary file\n");
+    return "";
 }
+/**
+ * The machine the binary \a sName is for, and its \a format, as far as the header tells without loading it (see
+ * FrontEnd::Load, which starts reading what the front end will need from this): MACHINE_UNKNOWN if it is not a format
+ * with a front end, or the header does not say. The loader has the last word (LoaderInterface::getMachine).
+ */
+MACHINE BinaryFileFactory::probeMachine(const QString &sName, LOAD_FMT &format) {
+    unsigned char buf[HEADER_SIZE] = {0};
+    QFile f(sName);
+    if (!f.open(QFile::ReadOnly) || f.read((char *)buf, sizeof(buf)) < 24)
+        return MACHINE_UNKNOWN;
+    if (TESTMAGIC4(buf, 0, 0x7F, 'E', 'L', 'F')) {
+        format = LOADFMT_ELF;
+        // e_machine, in the byte order given by e_ident[EI_DATA]
+        int machine = buf[5] == 2 ? (buf[18] << 8) | buf[19] : buf[18] | (buf[19] << 8);
+        switch (machine) {
+        case 2:  // EM_SPARC
+        case 18: // EM_SPARC32PLUS
+            return MACHINE_SPARC;
+        case 3: // EM_386
+            return MACHINE_PENTIUM;
+        case 8: // EM_MIPS
+            return MACHINE_MIPS;
+        case 20: // EM_PPC
+            return MACHINE_PPC;
+        case 0xA8: // EM_ST20
+            return MACHINE_ST20;
+        default:
+            return MACHINE_UNKNOWN;
+        }
+    }
+    if (TESTMAGIC2(buf, 0, 'M', 'Z')) {
+        QString plugin = probeDosBased(buf, f);
+        format = plugin == "Win32BinaryFile" ? LOADFMT_PE : plugin == "DOS4GWBinaryFile" ? LOADFMT_LX : LOADFMT_EXE;
+        return MACHINE_PENTIUM;
+    }
+    if (TESTMAGIC4(buf, 0, 0xFE, 0xED, 0xFA, 0xCE) || TESTMAGIC4(buf, 0, 0xCE, 0xFA, 0xED, 0xFE)) {
+        format = LOADFMT_MACHO;
+        // cputype, in the byte order of the magic; the loader takes anything but i386 for PowerPC
+        unsigned cputype = buf[0] == 0xFE ? buf[7] : buf[4];
+        return cputype == 7 ? MACHINE_PENTIUM : MACHINE_PPC;
+    }
+    if (TESTMAGIC4(buf, 0, 0xCA, 0xFE, 0xBA, 0xBE)) {
+        format = LOADFMT_MACHO;
+        // Universal: the loader takes the i386 image if there is one
+        int images = (buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7];
+        for (int i = 0; i < images && 8 + i * 20 + 4 <= HEADER_SIZE; i++) {
+            if (buf[8 + i * 20 + 3] == 7 && buf[8 + i * 20] == 0)
+                return MACHINE_PENTIUM;
+        }
+        return MACHINE_UNKNOWN;
+    }
+    if (TESTMAGIC2(buf, 0, 0x4C, 0x01)) {
+        format = LOADFMT_COFF;
+        return MACHINE_PENTIUM;
+    }
+    return MACHINE_UNKNOWN;
+}
+
 /**
  * Perform simple magic on the file by the given name in order to determine the appropriate type, and then return an
  * instance of the appropriate subclass.
@@ -10,6 +10,7 @@
 /**
  * \file ElfArchiveFile.cpp
  * Desc: This file contains the implementation of the ElfArchiveFile class
+ * \note Not built: this predates the loader plugins (BinaryFileFactory), which don't take archives.
  */
 
 #include "global.h"
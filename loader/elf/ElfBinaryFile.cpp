@@ -29,10 +29,12 @@
 #include <sys/types.h> // Next three for open()
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <algorithm>
 #include <cstddef>
 #include <cassert>
 #include <cstring>
 #include <inttypes.h>
+#include <thread>
 
 struct SectionParam {
     QString Name;
@@ -49,7 +51,9 @@ struct SectionParam {
 // not part of anonymous namespace, since it would create an ambiguity
 // anonymous_namespace::Translated_ElfSym vs. ElfTypes.h/Translated_ElfSym declarations
 struct Translated_ElfSym{
-    QString Name;
+    const char *Name; //!< In the string table of the image; not terminated after NameLength
+    int NameLength;
+    QString name() const { return QString::fromUtf8(Name, NameLength); }
     ElfSymType Type;
     ElfSymBinding Binding;
     ElfSymVisibility Visibility;
@@ -61,7 +65,6 @@ struct Translated_ElfSym{
 typedef std::map<QString, int, std::less<QString>> StrIntMap;
 
 ElfBinaryFile::ElfBinaryFile() : next_extern(ADDRESS::g(0L)) {
-    m_fd = nullptr;
     m_pFileName = nullptr;
     Init(); // Initialise all the common stuff
 }
@@ -92,6 +95,8 @@ void ElfBinaryFile::Init() {
     m_iLastSize = 0;
     m_pImportStubs = nullptr;
     ElfSections.clear();
+    m_RelocatedAddrs.clear();
+    m_bRelocsIndexed = false;
 }
 
 // Hand decompiled from sparc library function
@@ -125,31 +130,17 @@ bool ElfBinaryFile::RealLoad(const QString &sName) {
     //    }
 
     m_pFileName = sName;
-    m_fd = fopen(qPrintable(sName), "rb");
-    if (m_fd == nullptr)
-        return 0;
-
-    // Determine file size
-    if (fseek(m_fd, 0, SEEK_END)) {
-        fprintf(stderr, "Error seeking to end of binary file\n");
+    // Map the whole file; the sections point into it, and relocations are applied to private copies of its pages
+    if (!m_File.open(sName))
         return false;
-    }
-    m_lImageSize = ftell(m_fd);
-
-    // Allocate memory to hold the file
-    m_pImage = new char[m_lImageSize];
-    if (m_pImage == nullptr) {
-        fprintf(stderr, "Could not allocate %ld bytes for program image\n", m_lImageSize);
+    m_lImageSize = m_File.size();
+    m_pImage = m_File.data();
+    if ((size_t)m_lImageSize < sizeof(Elf32_Ehdr)) {
+        fprintf(stderr, "File too short for an ELF header: %ld bytes\n", m_lImageSize);
         return false;
     }
     Elf32_Ehdr *pHeader = (Elf32_Ehdr *)m_pImage; // Save a lot of casts
 
-    // Read the whole file in
-    fseek(m_fd, 0, SEEK_SET);
-    size_t size = fread(m_pImage, 1, m_lImageSize, m_fd);
-    if (size != (size_t)m_lImageSize)
-        fprintf(stderr, "WARNING! Only read %zd of %ld bytes of binary file!\n", size, m_lImageSize);
-
     // Basic checks
     if (strncmp(m_pImage, "\x7F"
                 "ELF",
@@ -323,12 +314,7 @@ bool ElfBinaryFile::RealLoad(const QString &sName) {
 
 // Clean up and unload the binary image
 void ElfBinaryFile::UnLoad() {
-    if (m_pImage)
-        delete[] m_pImage;
-    if(m_fd) {
-        fclose(m_fd);
-        m_fd = nullptr;
-    }
+    m_File.close();
     Init(); // Set all internal state to 0
 }
 
@@ -420,7 +406,7 @@ void ElfBinaryFile::processSymbol(Translated_ElfSym &sym,int e_type, int i)
             sym.Value += ElfSections[sym.SectionIdx].SourceAddr;
     }
     // try to find given symbol, if it has Value of 0, try to use the name.
-    const IBinarySymbol *symbol = sym.Value.isZero() ? Symbols->find(sym.Name) : Symbols->find(sym.Value);
+    const IBinarySymbol *symbol = sym.Value.isZero() ? Symbols->find(sym.name()) : Symbols->find(sym.Value);
     // Ensure no overwriting (except functions)
     if(symbol!=nullptr) //TODO: if symbol already exists
         return;
@@ -428,27 +414,28 @@ void ElfBinaryFile::processSymbol(Translated_ElfSym &sym,int e_type, int i)
         return;
     }
     if(sym.Type==STT_FILE) {
-        current_file = sym.Name;
+        current_file = sym.name();
         return;
     }
     if(sym.Binding!=STB_LOCAL && !current_file.isEmpty()) {
         // first non-local symbol, clear the current_file
         current_file.clear();
     }
-    if(sym.Name.isEmpty()) {
+    if(sym.NameLength == 0) {
         return;
     }
     if(sym.Value.isZero()) {
-        qDebug() << "Skipping symbol "<<sym.Name<<"with unknown location!";
+        qDebug() << "Skipping symbol "<<sym.name()<<"with unknown location!";
         return;
     }
     // TODO: add more symbol information here (function/export etc. ) ?
-    IBinarySymbol &new_symbol(Symbols->create(sym.Value,sym.Name,local));
+    // The name stays in the string table until someone asks for it
+    IBinarySymbol &new_symbol(Symbols->createLazy(sym.Value,sym.Name,sym.NameLength,local));
     new_symbol.setSize(elfRead4(&m_pSym[i].st_size));
     if(imported)
-        new_symbol.setAttr("Imported",true);
+        new_symbol.setFlag(IBinarySymbol::IMPORTED);
     if(sym.Type==STT_FUNC)
-        new_symbol.setAttr("Function",true);
+        new_symbol.setFlag(IBinarySymbol::FUNCTION);
     if(!current_file.isEmpty())
         new_symbol.setAttr("SourceFile",current_file);
 }
@@ -461,6 +448,7 @@ void ElfBinaryFile::AddSyms(int secIndex) {
     int nSyms = pSect.Size / pSect.entry_size;
     m_pSym = (const Elf32_Sym *)pSect.image_ptr.m_value; // Pointer to symbols
     int strIdx = m_sh_link[secIndex];               // sh_link points to the string table
+    Symbols->reserve(nSyms);
 
     // Index 0 is a dummy entry
     for (int i = 1; i < nSyms; i++) {
@@ -469,9 +457,10 @@ void ElfBinaryFile::AddSyms(int secIndex) {
         int name = elfRead4(&m_pSym[i].st_name);
         if (name == 0) /* Silly symbols with no names */
             continue;
-        QString str(GetStrPtr(strIdx, name));
+        trans.Name = GetStrPtr(strIdx, name);
         // Hack off the "@@GLIBC_2.0" of Linux, if present
-        trans.Name = str.left(str.indexOf("@@"));
+        const char *version = strstr(trans.Name, "@@");
+        trans.NameLength = version ? version - trans.Name : strlen(trans.Name);
         trans.Type = ELF32_ST_TYPE(m_pSym[i].st_info);
         trans.Binding = ELF32_ST_BIND(m_pSym[i].st_info);
         trans.Visibility = ELF32_ST_VISIBILITY(m_pSym[i].st_other);
@@ -656,7 +645,7 @@ void ElfBinaryFile::markImports() {
             break;
         }
         const IBinarySymbol *sym = *last;
-        sym->setAttr("Imported",true);
+        sym->setFlag(IBinarySymbol::IMPORTED);
     }
 }
 
@@ -701,7 +690,6 @@ void ElfBinaryFile::elfWrite4(int *pi, int val) {
     }
 }
 void ElfBinaryFile::applyRelocations() {
-    int nextFakeLibAddr = -2; // See R_386_PC32 below; -1 sometimes used for main
     if (m_pImage == nullptr)
         return; // No file loaded
     int machine = elfRead2(&((Elf32_Ehdr *)m_pImage)->e_machine);
@@ -738,111 +726,209 @@ void ElfBinaryFile::applyRelocations() {
         qDebug() << "Unhandled relocation !";
         break; // Not implemented yet
     }
-    case EM_386: {
-        for (unsigned i = 1; i < ElfSections.size(); ++i) {
-            const SectionParam &ps(ElfSections[i]);
+    case EM_386:
+        applyRelocations386(e_type);
+        break;
+    default:
+        break; // Not implemented
+    }
+}
 
-            if (ps.uType == SHT_REL) {
-                // A section such as .rel.dyn or .rel.plt (without an addend field).
-                // Each entry has 2 words: r_offet and r_info. The r_offset is just the offset from the beginning
-                // of the section (section given by the section header's sh_info) to the word to be modified.
-                // r_info has the type in the bottom byte, and a symbol table index in the top 3 bytes.
-                // A symbol table offset of 0 (STN_UNDEF) means use value 0. The symbol table involved comes from
-                // the section header's sh_link field.
-                int *pReloc = (int *)ps.image_ptr.m_value;
-                unsigned size = ps.Size;
-                // NOTE: the r_offset is different for .o files (E_REL in the e_type header field) than for exe's
-                // and shared objects!
-                ADDRESS destNatOrigin = ADDRESS::g(0L), destHostOrigin = ADDRESS::g(0L);
+namespace {
+//! A relocation of a SHT_REL section of an i386 binary, decoded: where it applies and the symbol value S it adds
+struct Rel386 {
+    int *word = nullptr; //!< Host address of the word to relocate; null if it is in no section
+    ADDRESS P;           //!< Native address of the word
+    ADDRESS indexed;     //!< The address of the word as IsRelocationAt knows it
+    ADDRESS S = ADDRESS::g(0L);
+    const char *fakeName = nullptr; //!< Name of a symbol not in this module, for R_386_PC32 (see below)
+    unsigned char type = 0;
+};
+
+//! Call \a f(begin, end) for chunks of [0, \a n), on up to \a threads threads when there are enough items to repay
+//! starting them
+template <class F> void forChunks(size_t n, unsigned threads, F f) {
+    const size_t minChunk = 1 << 14;
+    threads = (unsigned)std::max<size_t>(1, std::min<size_t>(threads, n / minChunk));
+    std::vector<std::thread> started;
+    size_t chunk = (n + threads - 1) / threads;
+    for (unsigned t = 1; t < threads; t++)
+        started.emplace_back(f, std::min(n, t * chunk), std::min(n, (t + 1) * chunk));
+    f(0, std::min(n, chunk));
+    for (std::thread &t : started)
+        t.join();
+}
+}
+
+/***************************************************************************/ /**
+  * \brief   Apply the relocations of the SHT_REL sections (such as .rel.dyn or .rel.plt) of an i386 binary, and build
+  * the index of the addresses they apply to for IsRelocationAt, in the same pass
+  *
+  * Each entry has 2 words: r_offset and r_info. For an object file (E_REL), r_offset is the offset from the beginning
+  * of the section given by the section header's sh_info to the word to be modified; for executables and shared objects
+  * it is the address of the word. r_info has the type in the bottom byte, and a symbol table index in the top 3 bytes.
+  * A symbol table offset of 0 (STN_UNDEF) means use value 0. The symbol table involved comes from the section header's
+  * sh_link field.
+  *
+  * There can be millions of relocations, so the work is split over threads in three steps. The entries are decoded in
+  * chunks, finding the word and S of each. Then, in order on this thread, the symbols that are not in the module are
+  * given fake addresses and the index is built. Last, the words are relocated by threads that each own a range of the
+  * image, applying the relocations of their range in the order of the sections, so that the result is that of one
+  * thread.
+  ******************************************************************************/
+void ElfBinaryFile::applyRelocations386(int e_type) {
+    int nextFakeLibAddr = -2; // See R_386_PC32 below; -1 sometimes used for main
+    unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+    // The sections by address, to find those of the words without the cache of getSectionInfoByAddr, which is not
+    // shared safely between threads
+    std::vector<const IBinarySection *> sections(Image->begin(), Image->end());
+    std::sort(sections.begin(), sections.end(), [](const IBinarySection *a, const IBinarySection *b) {
+        return a->sourceAddr() < b->sourceAddr();
+    });
+    auto sectionAt = [&sections](ADDRESS a) -> const IBinarySection * {
+        auto it = std::upper_bound(sections.begin(), sections.end(), a, [](ADDRESS x, const IBinarySection *sec) {
+            return x < sec->sourceAddr();
+        });
+        if (it == sections.begin())
+            return nullptr;
+        const IBinarySection *sec = *--it;
+        return a < sec->sourceAddr() + sec->size() ? sec : nullptr;
+    };
+
+    std::vector<Rel386> relocs;
+    for (unsigned i = 1; i < ElfSections.size(); ++i) {
+        const SectionParam &ps(ElfSections[i]);
+        if (ps.uType != SHT_REL)
+            continue;
+        const int *pReloc = (const int *)ps.image_ptr.m_value;
+        size_t first = relocs.size();
+        relocs.resize(first + ps.Size / (2 * sizeof(unsigned)));
+        ADDRESS destNatOrigin = ADDRESS::g(0L), destHostOrigin = ADDRESS::g(0L);
+        if (e_type == E_REL) {
+            int destSection = m_sh_info[i];
+            destNatOrigin = ElfSections[destSection].SourceAddr;
+            destHostOrigin = ElfSections[destSection].image_ptr;
+        }
+        int symSection = m_sh_link[i];          // Section index for the associated symbol table
+        int strSection = m_sh_link[symSection]; // Section index for the string section assoc with this
+        const char *pStrSection = (const char *)ElfSections[strSection].image_ptr.m_value;
+        const Elf32_Sym *symOrigin = (const Elf32_Sym *)ElfSections[symSection].image_ptr.m_value;
+        auto decode = [&](size_t begin, size_t end) {
+            for (size_t u = begin; u < end; u++) {
+                Rel386 &r(relocs[first + u]);
+                unsigned r_offset = elfRead4(pReloc + 2 * u);
+                unsigned info = elfRead4(pReloc + 2 * u + 1);
+                unsigned symTabIndex = info >> 8;
+                r.type = (unsigned char)info;
                 if (e_type == E_REL) {
-                    int destSection = m_sh_info[i];
-                    destNatOrigin = ElfSections[destSection].SourceAddr;
-                    destHostOrigin = ElfSections[destSection].image_ptr;
+                    r.word = (int *)(destHostOrigin + r_offset).m_value;
+                    r.P = destNatOrigin + r_offset;
+                    r.indexed = r.P;
+                } else {
+                    const IBinarySection *destSec = sectionAt(ADDRESS::g(r_offset));
+                    if (destSec == nullptr)
+                        continue;
+                    r.word = (int *)(destSec->hostAddr() - destSec->sourceAddr() + r_offset).m_value;
+                    r.P = ADDRESS::g(r_offset);
+                    r.indexed = destSec->sourceAddr() + r_offset;
                 }
-                int symSection = m_sh_link[i];          // Section index for the associated symbol table
-                int strSection = m_sh_link[symSection]; // Section index for the string section assoc with this
-                char *pStrSection = (char *)ElfSections[strSection].image_ptr.m_value;
-                const Elf32_Sym *symOrigin = (const Elf32_Sym *)ElfSections[symSection].image_ptr.m_value;
-                for (unsigned u = 0; u < size; u += 2 * sizeof(unsigned)) {
-                    unsigned r_offset = elfRead4(pReloc++);
-                    unsigned info = elfRead4(pReloc++);
-                    unsigned char relType = (unsigned char)info;
-                    unsigned symTabIndex = info >> 8;
-                    int *pRelWord; // Pointer to the word to be relocated
-                    if (e_type == E_REL)
-                        pRelWord = ((int *)(destHostOrigin + r_offset).m_value);
-                    else {
-                        const IBinarySection *destSec =Image->getSectionInfoByAddr(ADDRESS::n(r_offset));
-                        pRelWord = (int *)(destSec->hostAddr() - destSec->sourceAddr() + r_offset).m_value;
-                        destNatOrigin = ADDRESS::g(0L);
+                unsigned nsec;
+                switch (r.type) {
+                case 1: // R_386_32: S + A
+                    r.S = elfRead4((const int *)&symOrigin[symTabIndex].st_value);
+                    if (e_type == E_REL) {
+                        nsec = elfRead2(&symOrigin[symTabIndex].st_shndx);
+                        if (nsec < ElfSections.size())
+                            r.S += ElfSections[nsec].SourceAddr;
                     }
-                    ADDRESS A, S = ADDRESS::g(0L), P;
-                    unsigned nsec;
-                    switch (relType) {
-                    case 0: // R_386_NONE: just ignore (common)
-                        break;
-                    case 1: // R_386_32: S + A
-                        S = elfRead4((int *)&symOrigin[symTabIndex].st_value);
-                        if (e_type == E_REL) {
-                            nsec = elfRead2(&symOrigin[symTabIndex].st_shndx);
-                            if (nsec < ElfSections.size() )
-                                S += ElfSections[nsec].SourceAddr;
-                        }
-                        A = elfRead4(pRelWord);
-                        elfWrite4(pRelWord, (S + A).m_value);
-                        break;
-                    case 2: // R_386_PC32: S + A - P
-                        if (ELF32_ST_TYPE(symOrigin[symTabIndex].st_info) == STT_SECTION) {
+                    break;
+                case 2: // R_386_PC32: S + A - P
+                    if (ELF32_ST_TYPE(symOrigin[symTabIndex].st_info) == STT_SECTION) {
+                        nsec = elfRead2(&symOrigin[symTabIndex].st_shndx);
+                        if (nsec < ElfSections.size())
+                            r.S += ElfSections[nsec].SourceAddr;
+                    } else {
+                        r.S = elfRead4((const int *)&symOrigin[symTabIndex].st_value);
+                        if (r.S.isZero()) {
+                            // This means that the symbol doesn't exist in this module, and is not accessed through
+                            // the PLT, i.e. it will be statically linked, e.g. strcmp. We have the name of the symbol
+                            // right here in the symbol table entry, but the only way to communicate with the loader is
+                            // through the target address of the call. So we use some very improbable addresses (e.g.
+                            // -1, -2, etc) and give them entries in the symbol table, in the next step
+                            r.fakeName = pStrSection + elfRead4((const int *)&symOrigin[symTabIndex].st_name);
+                        } else if (e_type == E_REL) {
                             nsec = elfRead2(&symOrigin[symTabIndex].st_shndx);
-                            if (nsec < ElfSections.size() )
-                                S += ElfSections[nsec].SourceAddr;
-                        } else {
-                            S = elfRead4((int *)&symOrigin[symTabIndex].st_value);
-                            if (S.isZero()) {
-                                // This means that the symbol doesn't exist in this module, and is not accessed
-                                // through the PLT, i.e. it will be statically linked, e.g. strcmp. We have the
-                                // name of the symbol right here in the symbol table entry, but the only way
-                                // to communicate with the loader is through the target address of the call.
-                                // So we use some very improbable addresses (e.g. -1, -2, etc) and give them entries
-                                // in the symbol table
-                                int nameOffset = elfRead4((int *)&symOrigin[symTabIndex].st_name);
-                                char *pName = pStrSection + nameOffset;
-                                // this is too slow, I'm just going to assume it is 0
-                                // S = GetAddressByName(pName);
-                                // if (S == (e_type == E_REL ? 0x8000000 : 0)) {
-                                S = nextFakeLibAddr--; // Allocate a new fake address
-                                Symbols->create(S,pName);
-                                //}
-                            } else if (e_type == E_REL) {
-                                nsec = elfRead2(&symOrigin[symTabIndex].st_shndx);
-                                if (nsec < ElfSections.size() )
-                                    S += ElfSections[nsec].SourceAddr;
-                            }
+                            if (nsec < ElfSections.size())
+                                r.S += ElfSections[nsec].SourceAddr;
                         }
-                        A = elfRead4(pRelWord);
-                        P = destNatOrigin + r_offset;
-                        elfWrite4(pRelWord, (S + A - P).m_value);
-                        break;
-                    case 7:
-                    case 8:    // R_386_RELATIVE
-                        break; // No need to do anything with these, if a shared object
-                    default:
-                        // std::cout << "Relocation type " << (int)relType << " not handled yet\n";
-                        ;
                     }
+                    break;
+                default: // R_386_NONE (common), and R_386_RELATIVE needs nothing if a shared object
+                    break;
                 }
             }
+        };
+        forChunks(relocs.size() - first, numThreads, decode);
+    }
+
+    // Fake addresses are handed out in the order of the relocations, as the symbol table is not shared between threads
+    m_RelocatedAddrs.clear();
+    m_RelocatedAddrs.reserve(relocs.size());
+    std::vector<const Rel386 *> writes;
+    for (Rel386 &r : relocs) {
+        if (r.word == nullptr)
+            continue;
+        m_RelocatedAddrs.push_back(r.indexed);
+        if (r.fakeName) {
+            r.S = nextFakeLibAddr--; // Allocate a new fake address
+            Symbols->create(r.S, r.fakeName);
         }
+        if (r.type == 1 || r.type == 2)
+            writes.push_back(&r);
     }
-    default:
-        break; // Not implemented
+    std::sort(m_RelocatedAddrs.begin(), m_RelocatedAddrs.end());
+    m_bRelocsIndexed = true;
+    if (writes.empty())
+        return;
+
+    // Split the image into as many ranges as there are threads, each relocated by one of them
+    uintptr_t lo = UINTPTR_MAX, hi = 0;
+    for (const Rel386 *r : writes) {
+        lo = std::min(lo, (uintptr_t)r->word);
+        hi = std::max(hi, (uintptr_t)r->word);
+    }
+    auto apply = [this, &writes, lo](size_t begin, size_t end) {
+        for (const Rel386 *r : writes) {
+            uintptr_t at = (uintptr_t)r->word - lo;
+            if (at < begin || at >= end)
+                continue;
+            ADDRESS A;
+            A = elfRead4(r->word);
+            if (r->type == 1)
+                elfWrite4(r->word, (r->S + A).m_value);
+            else
+                elfWrite4(r->word, (r->S + A - r->P).m_value);
+        }
+    };
+    if (writes.size() < (1 << 14) || numThreads == 1) {
+        apply(0, hi - lo + 1);
+        return;
     }
+    size_t width = (hi - lo) / numThreads + 1;
+    std::vector<std::thread> started;
+    for (unsigned t = 1; t < numThreads; t++)
+        started.emplace_back(apply, t * width, (t + 1) * width);
+    apply(0, width);
+    for (std::thread &t : started)
+        t.join();
 }
 
-bool ElfBinaryFile::IsRelocationAt(ADDRESS uNative) {
+// Collect the addresses that relocations apply to, sorted, for IsRelocationAt
+void ElfBinaryFile::indexRelocations() {
     // int nextFakeLibAddr = -2;            // See R_386_PC32 below; -1 sometimes used for main
     if (m_pImage == nullptr)
-        return false; // No file loaded
+        return; // No file loaded
+    m_bRelocsIndexed = true;
     int machine = elfRead2(&((Elf32_Ehdr *)m_pImage)->e_machine);
     int e_type = elfRead2(&((Elf32_Ehdr *)m_pImage)->e_type);
     switch (machine) {
@@ -884,11 +970,12 @@ bool ElfBinaryFile::IsRelocationAt(ADDRESS uNative) {
                         pRelWord = destNatOrigin + r_offset;
                     else {
                         const IBinarySection *destSec = Image->getSectionInfoByAddr(ADDRESS::g(r_offset));
+                        if (destSec == nullptr)
+                            continue;
                         pRelWord = destSec->sourceAddr() + r_offset;
                         destNatOrigin = 0;
                     }
-                    if (uNative == pRelWord)
-                        return true;
+                    m_RelocatedAddrs.push_back(pRelWord);
                 }
             }
         }
@@ -896,5 +983,11 @@ bool ElfBinaryFile::IsRelocationAt(ADDRESS uNative) {
     default:
         break; // Not implemented
     }
-    return false;
+    std::sort(m_RelocatedAddrs.begin(), m_RelocatedAddrs.end());
+}
+
+bool ElfBinaryFile::IsRelocationAt(ADDRESS uNative) {
+    if (!m_bRelocsIndexed)
+        indexRelocations();
+    return std::binary_search(m_RelocatedAddrs.begin(), m_RelocatedAddrs.end(), uNative);
 }
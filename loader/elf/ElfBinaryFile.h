@@ -19,6 +19,7 @@
   ******************************************************************************/
 
 #include "BinaryFile.h"
+#include "MappedImage.h"
 struct Elf32_Phdr;
 struct Elf32_Shdr;
 struct Elf32_Rel;
@@ -68,6 +69,7 @@ class ElfBinaryFile : public QObject, public LoaderInterface {
   private:
     // Apply relocations; important when compiled without -fPIC
     void applyRelocations();
+    void applyRelocations386(int e_type);
     // Not meant to be used externally, but sometimes you just have to have it.
     const char *GetStrPtr(int idx, int offset); // Calc string pointer
     void Init();          // Initialise most member variables
@@ -85,7 +87,7 @@ class ElfBinaryFile : public QObject, public LoaderInterface {
     int elfRead4(const int *pi) const;      // Read an int with endianness care
     void elfWrite4(int *pi, int val); // Write an int with endianness care
 
-    FILE *m_fd;                             // File stream
+    MappedImage m_File;                     // The input file, mapped copy-on-write
     long m_lImageSize;                      // Size of image in bytes
     char *m_pImage;                         // Pointer to the loaded image
     Elf32_Phdr *m_pPhdrs;                   // Pointer to program headers
@@ -109,9 +111,12 @@ class ElfBinaryFile : public QObject, public LoaderInterface {
     int *m_sh_info;                         // pointer to array of sh_info values
 
     std::vector<struct SectionParam> ElfSections;
+    std::vector<ADDRESS> m_RelocatedAddrs;  // Sorted addresses of the words that relocations apply to
+    bool m_bRelocsIndexed;                  // True once m_RelocatedAddrs is built
     class IBinaryImage *Image;
     class IBinarySymbolTable *Symbols;
     void markImports();
+    void indexRelocations();
     void processSymbol(Translated_ElfSym &sym, int e_type, int i);
 };
 
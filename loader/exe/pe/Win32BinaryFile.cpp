@@ -362,18 +362,21 @@ void Win32BinaryFile::processIAT()
             unsigned iatEntry = LMMH(*iat);
             ADDRESS paddr = ADDRESS::g(LMMH(id->firstThunk) + LMMH(m_pPEHeader->Imagebase));
             while (iatEntry) {
+                iatSlots.insert((uint32_t)paddr.m_value);
                 if (iatEntry >> 31) {
                     // This is an ordinal number (stupid idea)
                     QString nodots = QString(dllName).replace(".","_"); // Dots can't be in identifiers
                     nodots = QString("%1_%2").arg(nodots).arg(iatEntry & 0x7FFFFFFF);
-                    Symbols->create(paddr,nodots).setAttr("Imported",true).setAttr("Function",true);
+                    Symbols->create(paddr,nodots).setFlag(IBinarySymbol::IMPORTED).setFlag(IBinarySymbol::FUNCTION);
                 } else {
                     // Normal case (IMAGE_IMPORT_BY_NAME). Skip the useless hint (2 bytes)
                     QString name((const char *)(iatEntry + 2 + base));
-                    Symbols->create(paddr,name).setAttr("Imported",true).setAttr("Function",true);
+                    Symbols->create(paddr,name).setFlag(IBinarySymbol::IMPORTED).setFlag(IBinarySymbol::FUNCTION);
                     ADDRESS old_loc = ADDRESS::host_ptr(iat) - ADDRESS::host_ptr(base) + LMMH(m_pPEHeader->Imagebase);
                     if (paddr != old_loc) // add both possibilities
-                        Symbols->create(old_loc,QString("old_") + name).setAttr("Imported",true).setAttr("Function",true);
+                        Symbols->create(old_loc,QString("old_") + name)
+                            .setFlag(IBinarySymbol::IMPORTED)
+                            .setFlag(IBinarySymbol::FUNCTION);
                 }
                 iat++;
                 iatEntry = LMMH(*iat);
@@ -508,13 +511,11 @@ bool Win32BinaryFile::LoadFromArray(QByteArray &arr) {
     ADDRESS entry = GetMainEntryPoint();
     if (entry != NO_ADDRESS) {
         if (!Symbols->find(entry))
-            Symbols->create(entry,"main").setAttr("Function",true);
+            Symbols->create(entry,"main").setFlag(IBinarySymbol::FUNCTION);
     }
 
     // Give a name to any jumps you find to these import entries
-    // NOTE: VERY early MSVC specific!! Temporary till we can think of a better way.
-    ADDRESS start = GetEntryPoint();
-    findJumps(start);
+    findJumps();
 
     readDebugData();
     return true;
@@ -530,40 +531,47 @@ bool Win32BinaryFile::RealLoad(const QString &sName) {
     return false;
 }
 
-// Used above for a hack to find jump instructions pointing to IATs.
-// Heuristic: start just before the "start" entry point looking for FF 25 opcodes followed by a pointer to an import
-// entry.  E.g. FF 25 58 44 40 00  where 00404458 is the IAT for _ftol.
-// Note: some are on 0x10 byte boundaries, some on 2 byte boundaries (6 byte jumps packed), and there are often up to
-// 0x30 bytes of statically linked library code (e.g. _atexit, __onexit) with sometimes two static libs in a row.
-// So keep going until there is about 0x60 bytes with no match.
-// Note: slight chance of coming across a misaligned match; probability is about 1/65536 times dozens in 2^32 ~= 10^-13
-void Win32BinaryFile::findJumps(ADDRESS curr) {
-    int cnt = 0; // Count of bytes with no match
-    IBinarySection *sec = Image->GetSectionInfoByName(".text");
-    if (sec == nullptr)
-        sec = Image->GetSectionInfoByName("CODE");
-    assert(sec);
-    // Add to native addr to get host:
-    ptrdiff_t delta = (sec->hostAddr() - sec->sourceAddr()).m_value;
-    while (cnt < 0x60) { // Max of 0x60 bytes without a match
-        curr -= 2;       // Has to be on 2-byte boundary
-        cnt += 2;
-        if(curr<sec->sourceAddr())
-            break; // stepped out of section
-        if (LH((curr + delta).m_value) != 0xFF + (0x25 << 8))
-            continue;
-        ADDRESS operand = ADDRESS::g(LMMH2((curr + delta + 2).m_value));
-        auto symbol_it = Symbols->find(operand);
-        if (nullptr == symbol_it)
-            continue;
-        QString sym_name = symbol_it->getName();
-        if(false == const_cast<IBinarySymbol *>(symbol_it)->rename("__imp_" + sym_name)) {
+// Used above to find the thunks of imports: jmp [iat] instructions, FF 25 followed by the address of an IAT entry, e.g.
+// FF 25 58 44 40 00  where 00404458 is the IAT entry of _ftol. The thunk takes the name of the import, which the IAT
+// entry keeps with an __imp_ prefix, so that calls to the thunk are calls to the library proc.
+// Every code section is scanned in one pass; memchr finds the FF bytes, a word at a time or better, and the operand is
+// looked up in the set of IAT entries made by processIAT. Thunks are on 2-byte boundaries (some are packed 6 bytes
+// apart, some on 0x10 byte boundaries between statically linked library code) and follow another thunk, padding or a
+// ret, which keeps out a jmp [iat] at the end of a function (a tail call) and misaligned matches.
+void Win32BinaryFile::findJumps() {
+    for (const IBinarySection *sec : *Image) {
+        if (!sec->isCode() || sec->size() < 6)
             continue;
+        const unsigned char *start = (const unsigned char *)sec->hostAddr().m_value;
+        const unsigned char *end = start + sec->size() - 5; // Room for the opcode and operand
+        ADDRESS native = sec->sourceAddr();
+        const unsigned char *lastThunk = nullptr;
+        for (const unsigned char *p = start; p < end; p++) {
+            p = (const unsigned char *)memchr(p, 0xFF, end - p);
+            if (p == nullptr)
+                break;
+            if (p[1] != 0x25 || ((p - start) & 1))
+                continue;
+            if (p != start && p != lastThunk + 6 && p[-1] != 0xCC && p[-1] != 0x90 && p[-1] != 0xC3 && p[-1] != 0x00)
+                continue;
+            uint32_t operand = LMMH2(p + 2);
+            if (iatSlots.find(operand) == iatSlots.end())
+                continue;
+            ADDRESS curr = native + (p - start);
+            auto symbol_it = Symbols->find(ADDRESS::g(operand));
+            if (nullptr == symbol_it || Symbols->find(curr))
+                continue;
+            QString sym_name = symbol_it->getName();
+            if(false == const_cast<IBinarySymbol *>(symbol_it)->rename("__imp_" + sym_name)) {
+                continue;
+            }
+            Symbols->create(curr,sym_name).setFlag(IBinarySymbol::FUNCTION).setFlag(IBinarySymbol::IMPORTED);
+            iatSlots.erase(operand); // One thunk per import; the name is taken
+            lastThunk = p;
+            p += 5;
         }
-        Symbols->create(curr,sym_name).setAttr("Function",true).setAttr("Imported",true);
-        curr -= 4; // Next match is at least 4+2 bytes away
-        cnt = 0;
     }
+    iatSlots.clear();
 }
 
 // Clean up and unload the binary image
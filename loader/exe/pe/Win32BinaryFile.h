@@ -16,6 +16,7 @@
 
 #include "BinaryFile.h"
 #include <string>
+#include <unordered_set>
 
 /**
  * This file contains the definition of the Win32BinaryFile class, and some
@@ -200,7 +201,7 @@ protected:
     bool LoadFromArray(QByteArray &arr);
 private:
     bool PostLoad(void *handle);  // Called after archive member loaded
-    void findJumps(ADDRESS curr); // Find names for jumps to IATs
+    void findJumps();             // Find names for jumps to IATs
 
     Header *m_pHeader;     // Pointer to header
     PEHeader *m_pPEHeader; // Pointer to pe header
@@ -212,6 +213,7 @@ private:
     QString m_pFileName;
     bool haveDebugInfo;
     bool mingw_main;
+    std::unordered_set<uint32_t> iatSlots; // Native addresses of the IAT entries, for findJumps
     class IBinaryImage *Image;
     class IBinarySymbolTable *Symbols;
 };
@@ -351,7 +351,7 @@ bool HpSomBinaryFile::RealLoad(const QString &sName) {
         //TODO: add some type info to the imported symbols
         // Add it to the set of imports; needed by IsDynamicLinkedProc()
         Symbols->create(ADDRESS::n(UINT4(&PLTs[v].value)),pDlStrings + UINT4(&import_list[u].name))
-                .setAttr("Imported",true).setAttr("Function",true);
+                .setFlag(IBinarySymbol::IMPORTED).setFlag(IBinarySymbol::FUNCTION);
     }
     // Work through the exports, and find main. This isn't main itself,
     // but in fact a call to main.
@@ -379,13 +379,13 @@ bool HpSomBinaryFile::RealLoad(const QString &sName) {
                           ((bincall & 0x1ff8) >> 3));     // w2@0..9
             // Address of main is st + 8 + offset << 2
             Symbols->create(UINT4ADDR(&export_list[u].value) + 8 + (offset << 2),"main")
-                    .setAttr("Export",true);
+                    .setFlag(IBinarySymbol::EXPORT);
             break;
         }
     }
 
     processSymbols();
-    Symbols->find("main")->setAttr("EntryPoint",true);
+    Symbols->find("main")->setFlag(IBinarySymbol::ENTRY_POINT);
     return true;
 }
 
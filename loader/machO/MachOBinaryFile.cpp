@@ -310,7 +310,9 @@ bool MachOBinaryFile::RealLoad(const QString &sName) {
             char *name = strtbl + BMMH(symbols[symbol].n_un.n_strx);
             if (*name == '_') // we want printf not _printf
                 name++;
-            Symbols->create(addr,name).setAttr("Function",true).setAttr("Imported",true);
+            Symbols->createLazy(addr,name,strlen(name))
+                .setFlag(IBinarySymbol::FUNCTION)
+                .setFlag(IBinarySymbol::IMPORTED);
         }
     }
 
@@ -326,7 +328,7 @@ bool MachOBinaryFile::RealLoad(const QString &sName) {
             DEBUG_PRINT("symbol %s at %x type %x\n", name, BMMH(symbols[i].n_value), sym_type & N_TYPE);
             if (*name == '_') // we want main not _main
                 name++;
-            Symbols->create(ADDRESS::g(BMMH(symbols[i].n_value)),name);
+            Symbols->createLazy(ADDRESS::g(BMMH(symbols[i].n_value)),name,strlen(name));
         }
     }
 
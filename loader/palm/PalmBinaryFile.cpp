@@ -33,9 +33,6 @@ PalmBinaryFile::PalmBinaryFile() : m_pImage(nullptr), m_pData(nullptr) {
 }
 
 PalmBinaryFile::~PalmBinaryFile() {
-    if (m_pImage) {
-        delete[] m_pImage;
-    }
     if (m_pData) {
         delete[] m_pData;
     }
@@ -69,28 +66,15 @@ struct SectionParams {
 };
 }
 bool PalmBinaryFile::RealLoad(const QString &sName) {
-    FILE *fp;
     m_pFileName = sName;
 
-    if ((fp = fopen(qPrintable(sName), "rb")) == nullptr) {
+    if (!m_File.open(sName)) {
         fprintf(stderr, "Could not open binary file %s\n", qPrintable(sName));
         return false;
     }
-
-    fseek(fp, 0, SEEK_END);
-    long size = ftell(fp);
-
-    // Allocate a buffer for the image
-    m_pImage = new unsigned char[size];
-    if (m_pImage == nullptr) {
-        fprintf(stderr, "Could not allocate %ld bytes for image\n", size);
-        return false;
-    }
-    memset(m_pImage, size, 0);
-
-    fseek(fp, 0, SEEK_SET);
-    if (fread(m_pImage, 1, size, fp) != (unsigned)size) {
-        fprintf(stderr, "Error reading binary file %s\n", qPrintable(sName));
+    m_pImage = (unsigned char *)m_File.data();
+    if (m_File.size() < 0x4E) {
+        fprintf(stderr, "%s is too short for a .prc file\n", qPrintable(sName));
         return false;
     }
 
@@ -129,7 +113,7 @@ bool PalmBinaryFile::RealLoad(const QString &sName) {
         params.push_back({name,start_addr,NO_ADDRESS,ADDRESS::host_ptr(m_pImage + off)}); // NO_ADDRESS will be overwritten
     }
     // Set the length for the last section
-    params.back().to = params.back().from + size - off;
+    params.back().to = params.back().from + m_File.size() - off;
 
     for(SectionParams param : params) {
         assert(param.to!=NO_ADDRESS);
@@ -261,15 +245,13 @@ bool PalmBinaryFile::RealLoad(const QString &sName) {
     // May as well make the native address zero; certainly the offset in the
     // file is no longer appropriate (and is confusing)
     // pData->sourceAddr() = 0;
-    Symbols->create(GetMainEntryPoint(),"PilotMain").setAttr("EntryPoint",true);
+    Symbols->create(GetMainEntryPoint(),"PilotMain").setFlag(IBinarySymbol::ENTRY_POINT);
     return true;
 }
 
 void PalmBinaryFile::UnLoad() {
-    if (m_pImage) {
-        delete[] m_pImage;
-        m_pImage = nullptr;
-    }
+    m_File.close();
+    m_pImage = nullptr;
 }
 
 ADDRESS PalmBinaryFile::GetEntryPoint() {
@@ -18,6 +18,7 @@
   ******************************************************************************/
 
 #include "BinaryFile.h"
+#include "MappedImage.h"
 #include <QtCore/QObject>
 
 class PalmBinaryFile : public QObject, public LoaderInterface {
@@ -72,6 +73,7 @@ class PalmBinaryFile : public QObject, public LoaderInterface {
 
 private:
     void addTrapSymbols();
+    MappedImage m_File;      //!< The input file, mapped copy-on-write
     unsigned char *m_pImage; //!< Points to loaded image
     unsigned char *m_pData;  //!< Points to data
     // Offset from start of data to where register a5 should be initialised to
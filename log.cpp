@@ -4,22 +4,27 @@
 #include "exp.h"
 #include "managed.h"
 #include "boomerang.h"
+#include "util.h"
 
 #include <QTextStream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
 Log &Log::operator<<(const Instruction *s) {
-    QString tgt;
-    QTextStream st(&tgt);
+    TextScratch tgt;
+    QTextStream &st(tgt.stream());
     s->print(st);
-    *this << tgt;
+    *this << tgt.text();
     return *this;
 }
 
 Log &Log::operator<<(const Exp *e) {
-    QString tgt;
-    QTextStream st(&tgt);
+    TextScratch tgt;
+    QTextStream &st(tgt.stream());
     e->print(st);
-    *this << tgt;
+    *this << tgt.text();
     return *this;
 }
 
@@ -35,18 +40,18 @@ Log &Log::operator<<(const Printable &p) {
 }
 
 Log &Log::operator<<(const RTL *r) {
-    QString tgt;
-    QTextStream st(&tgt);
+    TextScratch tgt;
+    QTextStream &st(tgt.stream());
     r->print(st);
-    *this << tgt;
+    *this << tgt.text();
     return *this;
 }
 
 Log &Log::operator<<(const LocationSet *l) {
-    QString tgt;
-    QTextStream st(&tgt);
+    TextScratch tgt;
+    QTextStream &st(tgt.stream());
     st << l;
-    *this << tgt;
+    *this << tgt.text();
     return *this;
 }
 
@@ -77,12 +82,129 @@ Log &Log::operator<<(ADDRESS a) {
 
 void Log::tail() {}
 
+//! Wait for another thread: yield at first, and then sleep, so that on a busy machine the thread waited for runs
+static void backOff(unsigned &spins) {
+    if (++spins < 64)
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+//! Queue the \a n bytes at \a bytes, waiting for the reader if there isn't room for them
+void LogRing::put(const char *bytes, size_t n) {
+    while (n > Capacity) {
+        put(bytes, Capacity);
+        bytes += Capacity;
+        n -= Capacity;
+    }
+    size_t start;
+    unsigned spins = 0;
+    for (;;) {
+        start = reserved.load(std::memory_order_relaxed);
+        if (start + n - consumed.load(std::memory_order_acquire) > Capacity) {
+            backOff(spins);
+            continue;
+        }
+        if (reserved.compare_exchange_weak(start, start + n, std::memory_order_relaxed))
+            break;
+    }
+    size_t at = start & (Capacity - 1);
+    size_t first = std::min(n, Capacity - at);
+    memcpy(data.get() + at, bytes, first);
+    memcpy(data.get(), bytes + first, n - first);
+    // Publish in order: the reader must not see these bytes before those of the writers that claimed space earlier
+    spins = 0;
+    while (committed.load(std::memory_order_acquire) != start)
+        backOff(spins);
+    committed.store(start + n, std::memory_order_release);
+}
+
+//! Append to \a to everything published and not yet taken. Only one thread may take. \returns the number of bytes
+size_t LogRing::take(std::string &to) {
+    size_t from = consumed.load(std::memory_order_relaxed);
+    size_t end = committed.load(std::memory_order_acquire);
+    for (size_t pos = from; pos != end;) {
+        size_t at = pos & (Capacity - 1);
+        size_t len = std::min(end - pos, Capacity - at);
+        to.append(data.get() + at, len);
+        pos += len;
+    }
+    consumed.store(end, std::memory_order_release);
+    return end - from;
+}
+
+//! The log files still open when the program exits, so that what is queued for them is not lost
+static std::atomic<FileLogger *> openLog(nullptr);
+
+static void flushAtExit() {
+    if (FileLogger *log = openLog.load())
+        log->flush();
+}
+
+void FileLogger::start() {
+    written = ring.getCommitted();
+    stopping = false;
+    writer = std::thread(&FileLogger::writeLoop, this);
+    static bool registered = false;
+    if (!registered) {
+        registered = true;
+        atexit(flushAtExit);
+    }
+    openLog = this;
+}
+
+//! Write out what is queued and let the writing thread finish
+void FileLogger::stop() {
+    if (!writer.joinable())
+        return;
+    FileLogger *self = this;
+    openLog.compare_exchange_strong(self, nullptr);
+    stopping = true;
+    writer.join();
+}
+
+void FileLogger::writeLoop() {
+    std::string chunk;
+    for (;;) {
+        // Read the flag first: whatever was queued before it was set is then taken by this round
+        bool last = stopping.load();
+        chunk.clear();
+        size_t taken = ring.take(chunk);
+        if (taken) {
+            out << chunk << std::flush;
+            written.fetch_add(taken);
+        } else if (last)
+            return;
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+FileLogger::~FileLogger() { stop(); }
+
+void FileLogger::resume() {
+    if (!writer.joinable())
+        start();
+}
+
+void FileLogger::flush() {
+    size_t target = ring.getCommitted();
+    unsigned spins = 0;
+    while (written.load() < target && writer.joinable())
+        backOff(spins);
+}
+
 void FileLogger::tail() {
+    // The stream belongs to the writing thread while it runs
+    stop();
     out.seekp(-200, std::ios::end);
     LOG_STREAM() << out;
+    out.seekp(0, std::ios::end);
+    start();
 }
 Log &FileLogger::operator<<(const QString &str) {
-    out << str.toStdString() << std::flush;
+    QByteArray bytes(str.toUtf8());
+    ring.put(bytes.constData(), bytes.size());
     return *this;
 }
 
@@ -0,0 +1,329 @@
+#include "ConstantPropagation.h"
+
+#include "proc.h"
+#include "boomerang.h"
+#include "log.h"
+#include "cfg.h"
+#include "basicblock.h"
+#include "dataflow.h"
+#include "statement.h"
+#include "exp.h"
+#include "managed.h"
+
+namespace {
+//! Remove the operands of the phi functions in bb that come from pred, which is no longer a predecessor
+void dropPhiOperands(BasicBlock *bb, BasicBlock *pred) {
+    BasicBlock::rtlit rit;
+    StatementList::iterator sit;
+    for (Instruction *s = bb->getFirstStmt(rit, sit); s; s = bb->getNextStmt(rit, sit)) {
+        if (s->isPhi())
+            ((PhiAssign *)s)->getDefs().erase(pred);
+    }
+}
+}
+
+ConstantPropagation::ConstantPropagation() {}
+
+bool ConstantPropagation::runOnFunction(Function &F) {
+    if (F.isLib())
+        return false;
+    UserProc &UF((UserProc &)F);
+    Cfg *cfg = UF.getCFG();
+    if (cfg == nullptr || cfg->getEntryBB() == nullptr)
+        return false;
+    LOG_VERBOSE(1) << "### sparse conditional constant propagation for " << UF.getName() << " ###\n";
+    clear();
+    findUsers(UF);
+    analyse(*cfg);
+    bool change = substitute(UF);
+    bool cfgChange = foldBranches(UF);
+    cfgChange |= removeUnreachable(UF);
+    if (cfgChange) {
+        cfg->setStructureChanged();
+        UF.getDataFlow()->updateDominators(cfg);
+    }
+    clear();
+    return change || cfgChange;
+}
+
+void ConstantPropagation::clear() {
+    values.clear();
+    users.clear();
+    executableEdges.clear();
+    executableBBs.clear();
+    flowWork.clear();
+    ssaWork.clear();
+}
+
+ConstantPropagation::Value ConstantPropagation::meet(const Value &a, const Value &b) {
+    if (a.state == Value::Top)
+        return b;
+    if (b.state == Value::Top)
+        return a;
+    if (a.state == Value::Constant && b.state == Value::Constant && a.value == b.value)
+        return a;
+    return Value(Value::Bottom);
+}
+
+//! Only ordinary assignments and phi functions can be found constant; anything else defines an unknown value
+ConstantPropagation::Value ConstantPropagation::valueOf(Instruction *def) {
+    if (def == nullptr || !(def->isAssign() || def->isPhi()))
+        return Value(Value::Bottom);
+    auto it = values.find(def);
+    return it == values.end() ? Value() : it->second;
+}
+
+/***************************************************************************/ /**
+  * \brief   Find the value of e, given the current values of the definitions it refers to
+  * \param   e the expression
+  * \param   isCondition true if e is a branch condition, which may simplify to true or false instead of a number
+  * \returns Top if any definition still is, the constant if e folds to an integer, else Bottom
+  ******************************************************************************/
+ConstantPropagation::Value ConstantPropagation::evaluate(Exp *e, bool isCondition) {
+    if (e == nullptr)
+        return Value(Value::Bottom);
+    LocationSet refs;
+    e->addUsedLocs(refs);
+    Exp *res = e->clone();
+    bool top = false;
+    // Replace the memofs first: once the constant address inside one is replaced, the memof would no longer match
+    for (int memofs = 1; memofs >= 0; memofs--) {
+        for (Exp *r : refs) {
+            if (!r->isSubscript() || r->getSubExp1()->isMemOf() != (memofs == 1))
+                continue;
+            Value v = valueOf(((RefExp *)r)->getDef());
+            if (v.state == Value::Top)
+                top = true;
+            else if (v.state == Value::Constant) {
+                Const c(v.value);
+                bool ch;
+                res = res->searchReplaceAll(*r, &c, ch);
+            }
+        }
+    }
+    if (top)
+        return Value();
+    res = res->simplify();
+    if (res->isIntConst())
+        return Value(Value::Constant, ((Const *)res)->getInt());
+    if (isCondition && res->isTrue())
+        return Value(Value::Constant, 1);
+    if (isCondition && res->isFalse())
+        return Value(Value::Constant, 0);
+    return Value(Value::Bottom);
+}
+
+//! Map each definition to the statements that refer to it, which need another look when its value changes
+void ConstantPropagation::findUsers(UserProc &proc) {
+    StatementList stmts;
+    proc.getStatements(stmts);
+    for (Instruction *s : stmts) {
+        if (s->isPhi()) {
+            for (auto &pp : *(PhiAssign *)s) {
+                if (pp.second.def())
+                    users[pp.second.def()].push_back(s);
+            }
+            continue;
+        }
+        LocationSet refs;
+        s->addUsedLocs(refs);
+        for (Exp *r : refs) {
+            if (r->isSubscript() && ((RefExp *)r)->getDef())
+                users[((RefExp *)r)->getDef()].push_back(s);
+        }
+    }
+}
+
+void ConstantPropagation::markEdge(BasicBlock *from, BasicBlock *to) {
+    if (executableEdges.insert(Edge(from, to)).second)
+        flowWork.push_back(Edge(from, to));
+}
+
+//! Lower the value of s to its meet with v; if that changes it, its users need visiting again
+void ConstantPropagation::lower(Instruction *s, const Value &v) {
+    Value &old(values[s]);
+    Value res = meet(old, v);
+    if (!(res != old))
+        return;
+    old = res;
+    auto uu = users.find(s);
+    if (uu != users.end())
+        ssaWork.insert(ssaWork.end(), uu->second.begin(), uu->second.end());
+}
+
+void ConstantPropagation::visit(Instruction *s) {
+    if (s->isPhi()) {
+        Value v;
+        for (auto &pp : *(PhiAssign *)s) {
+            if (executableEdges.count(Edge(pp.first, s->getBB())))
+                v = meet(v, valueOf(pp.second.def()));
+        }
+        lower(s, v);
+    } else if (s->isAssign()) {
+        Assign *as = (Assign *)s;
+        lower(s, as->getGuard() ? Value(Value::Bottom) : evaluate(as->getRight(), false));
+    } else if (s->isBranch() && s == s->getBB()->getLastStmt())
+        visitExits(s->getBB());
+}
+
+//! Mark the out edges of bb that can be taken, as far as is known now
+void ConstantPropagation::visitExits(BasicBlock *bb) {
+    Instruction *last = bb->getLastStmt();
+    if (last && last->isBranch() && bb->getNumOutEdges() == 2) {
+        visitBranch((BranchStatement *)last);
+        return;
+    }
+    for (BasicBlock *succ : bb->getOutEdges())
+        markEdge(bb, succ);
+}
+
+void ConstantPropagation::visitBranch(BranchStatement *branch) {
+    BasicBlock *bb = branch->getBB();
+    BasicBlock *taken = branch->getTakenBB();
+    BasicBlock *fall = branch->getFallBB();
+    Value v = evaluate(branch->getCondExpr(), true);
+    if (v.state == Value::Top)
+        return;
+    if (v.state == Value::Constant && taken && fall) {
+        markEdge(bb, v.value ? taken : fall);
+        return;
+    }
+    for (BasicBlock *succ : bb->getOutEdges())
+        markEdge(bb, succ);
+}
+
+//! Find the executable edges, and the values of the definitions along them
+void ConstantPropagation::analyse(Cfg &cfg) {
+    markEdge(nullptr, cfg.getEntryBB());
+    while (!flowWork.empty() || !ssaWork.empty()) {
+        while (!flowWork.empty()) {
+            BasicBlock *bb = flowWork.front().second;
+            flowWork.pop_front();
+            bool first = executableBBs.insert(bb).second;
+            BasicBlock::rtlit rit;
+            StatementList::iterator sit;
+            for (Instruction *s = bb->getFirstStmt(rit, sit); s; s = bb->getNextStmt(rit, sit)) {
+                // A block seen before only has new operands for its phis; the branch is left to visitExits()
+                if (first ? !s->isBranch() : s->isPhi())
+                    visit(s);
+            }
+            if (first)
+                visitExits(bb);
+        }
+        while (!ssaWork.empty()) {
+            Instruction *s = ssaWork.front();
+            ssaWork.pop_front();
+            if (executableBBs.count(s->getBB()))
+                visit(s);
+        }
+    }
+}
+
+//! Replace the uses of constant definitions in the executable blocks with the constants
+bool ConstantPropagation::substitute(UserProc &proc) {
+    bool change = false;
+    StatementList stmts;
+    proc.getStatements(stmts);
+    for (Instruction *s : stmts) {
+        if (s->isPhi() || executableBBs.count(s->getBB()) == 0)
+            continue;
+        LocationSet refs;
+        s->addUsedLocs(refs);
+        // Replace them all in one walk. Where one is inside another (r8{3} in m[r8{3}]{5}), only the outer one is
+        // replaced, as when the memofs were replaced first
+        ExpReplaceMap constants;
+        for (Exp *r : refs) {
+            if (!r->isSubscript())
+                continue;
+            Value v = valueOf(((RefExp *)r)->getDef());
+            if (v.state != Value::Constant)
+                continue;
+            constants[r] = new Const(v.value);
+        }
+        bool changed = !constants.empty() && s->searchAndReplaceAll(constants);
+        if (changed)
+            s->simplify();
+        change |= changed;
+    }
+    return change;
+}
+
+//! Make the branches that can only go one way unconditional, and remove their other out edge
+bool ConstantPropagation::foldBranches(UserProc &proc) {
+    bool change = false;
+    for (BasicBlock *bb : *proc.getCFG()) {
+        if (executableBBs.count(bb) == 0 || bb->getNumOutEdges() != 2)
+            continue;
+        Instruction *last = bb->getLastStmt();
+        if (last == nullptr || !last->isBranch())
+            continue;
+        BranchStatement *branch = (BranchStatement *)last;
+        BasicBlock *taken = branch->getTakenBB();
+        BasicBlock *fall = branch->getFallBB();
+        // BasicBlock::simplify() keeps out edge 0 for the taken branch
+        if (taken == nullptr || fall == nullptr || taken == fall || bb->getOutEdge(0) != taken)
+            continue;
+        bool takenLive = executableEdges.count(Edge(bb, taken)) != 0;
+        bool fallLive = executableEdges.count(Edge(bb, fall)) != 0;
+        if (takenLive == fallLive)
+            continue;
+        LOG_VERBOSE(1) << "branch " << branch->getNumber() << " always " << (takenLive ? "taken" : "falls through")
+                       << "\n";
+        dropPhiOperands(takenLive ? fall : taken, bb);
+        branch->setCondExpr(new Const(takenLive ? 1 : 0));
+        proc.getCFG()->simplifyBB(bb); // Turns the branch into a goto or removes it, and updates the edges
+        change = true;
+    }
+    return change;
+}
+
+/***************************************************************************/ /**
+  * \brief   Remove the blocks that can't be reached from the entry any more
+  *
+  * Nothing is removed if one of the blocks to go has a call, return or switch, since those are referred to from
+  * outside the cfg (the call graph, the return statement of the proc, switch analysis); later passes can still tidy
+  * those up.
+  * \returns true if any block was removed
+  ******************************************************************************/
+bool ConstantPropagation::removeUnreachable(UserProc &proc) {
+    Cfg *cfg = proc.getCFG();
+    std::set<BasicBlock *> reached;
+    std::vector<BasicBlock *> stack{cfg->getEntryBB()};
+    reached.insert(cfg->getEntryBB());
+    while (!stack.empty()) {
+        BasicBlock *bb = stack.back();
+        stack.pop_back();
+        for (BasicBlock *succ : bb->getOutEdges()) {
+            if (reached.insert(succ).second)
+                stack.push_back(succ);
+        }
+    }
+    std::vector<BasicBlock *> dead;
+    for (BasicBlock *bb : *cfg) {
+        if (reached.count(bb))
+            continue;
+        if (bb == cfg->getExitBB())
+            return false;
+        BasicBlock::rtlit rit;
+        StatementList::iterator sit;
+        for (Instruction *s = bb->getFirstStmt(rit, sit); s; s = bb->getNextStmt(rit, sit)) {
+            if (s->isCall() || s->isReturn() || s->isCase())
+                return false;
+        }
+        dead.push_back(bb);
+    }
+    for (BasicBlock *bb : dead) {
+        for (BasicBlock *succ : bb->getOutEdges()) {
+            if (reached.count(succ) == 0)
+                continue;
+            dropPhiOperands(succ, bb);
+            succ->deleteInEdge(bb);
+            cfg->touchBB(succ);
+        }
+    }
+    for (BasicBlock *bb : dead) {
+        LOG_VERBOSE(1) << "removing unreachable BB at " << bb->getLowAddr() << "\n";
+        cfg->removeBB(bb);
+    }
+    return !dead.empty();
+}
@@ -0,0 +1,63 @@
+#ifndef CONSTANTPROPAGATION_H
+#define CONSTANTPROPAGATION_H
+#include "Pass.h"
+#include <deque>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+class BasicBlock;
+class BranchStatement;
+class Cfg;
+class Exp;
+class Function;
+class Instruction;
+class UserProc;
+/**
+ * Sparse conditional constant propagation (Wegman and Zadeck) over the SSA form. Finds the definitions that are
+ * integer constants along every path that can execute, and the branches that can only go one way; then substitutes
+ * the constants into their uses, folds those branches, and removes the blocks that can no longer be reached.
+ */
+class ConstantPropagation : public FunctionPass
+{
+public:
+    ConstantPropagation();
+    const char *getName() const { return "ConstantPropagation"; }
+    //! The dominators are recomputed when the cfg changes
+    unsigned getPreserved() const { return ANALYSIS_DOMINATORS; }
+    bool runOnFunction(Function &F);
+private:
+    //! Lattice value of a definition: not yet known to execute (Top), one constant, or not constant (Bottom)
+    struct Value {
+        enum State { Top, Constant, Bottom } state = Top;
+        int value = 0;
+        Value() {}
+        Value(State s, int v = 0) : state(s), value(v) {}
+        bool operator!=(const Value &o) const { return state != o.state || value != o.value; }
+    };
+    typedef std::pair<BasicBlock *, BasicBlock *> Edge;
+
+    std::map<Instruction *, Value> values;
+    std::map<Instruction *, std::vector<Instruction *>> users;
+    std::set<Edge> executableEdges;
+    std::set<BasicBlock *> executableBBs;
+    std::deque<Edge> flowWork;
+    std::deque<Instruction *> ssaWork;
+
+    static Value meet(const Value &a, const Value &b);
+    Value valueOf(Instruction *def);
+    Value evaluate(Exp *e, bool isCondition);
+    void findUsers(UserProc &proc);
+    void analyse(Cfg &cfg);
+    void markEdge(BasicBlock *from, BasicBlock *to);
+    void visit(Instruction *s);
+    void visitExits(BasicBlock *bb);
+    void visitBranch(BranchStatement *branch);
+    void lower(Instruction *s, const Value &v);
+    bool substitute(UserProc &proc);
+    bool foldBranches(UserProc &proc);
+    bool removeUnreachable(UserProc &proc);
+    void clear();
+};
+
+#endif // CONSTANTPROPAGATION_H
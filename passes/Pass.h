@@ -1,12 +1,27 @@
 #ifndef PASS_H
 #define PASS_H
 class Function;
+//! The analyses a pass can need up to date before it runs, or keep up to date itself; see PassManager
+enum PassAnalysis : unsigned {
+    ANALYSIS_NONE = 0,
+    ANALYSIS_DOMINATORS = 1, //!< Dominator tree and dominance frontiers (DataFlow::dominators())
+    ANALYSIS_LIVENESS = 2,   //!< Live in sets of the BBs (Cfg::calcLiveIn())
+    ANALYSIS_DFT_ORDER = 4,  //!< Depth first numbering of the BBs (Cfg::establishDFTOrder())
+    ANALYSIS_ALL = 7
+};
 class Pass
 {
 public:
     Pass();
+    virtual ~Pass() {}
+    virtual const char *getName() const = 0;
+    //! The analyses that must be up to date before the pass runs
+    virtual unsigned getRequired() const { return ANALYSIS_NONE; }
+    //! The analyses that are still up to date after the pass has changed something
+    virtual unsigned getPreserved() const { return ANALYSIS_NONE; }
 };
 class FunctionPass : public Pass {
+public:
     virtual bool runOnFunction(Function &F)=0;
 };
 #endif // PASS_H
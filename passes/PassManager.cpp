@@ -0,0 +1,73 @@
+#include "PassManager.h"
+
+#include "proc.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "boomerang.h"
+#include "log.h"
+
+#include <chrono>
+
+std::map<QString, PassManager::Timing> PassManager::timings;
+
+PassManager::~PassManager() {
+    for (FunctionPass *p : passes)
+        delete p;
+}
+
+//! Append \a pass to the sequence; the manager takes ownership of it
+void PassManager::add(FunctionPass *pass) { passes.push_back(pass); }
+
+/***************************************************************************/ /**
+  * \brief   Run each pass in turn over \a proc
+  * \returns true if any pass changed something
+  ******************************************************************************/
+bool PassManager::run(UserProc &proc) {
+    bool change = false;
+    for (FunctionPass *p : passes) {
+        require(proc, p->getRequired());
+        auto start = std::chrono::steady_clock::now();
+        bool changed = p->runOnFunction(proc);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        Timing &t(timings[p->getName()]);
+        t.runs++;
+        t.seconds += elapsed.count();
+        if (!changed)
+            continue;
+        t.changes++;
+        invalidate(proc, ANALYSIS_ALL & ~p->getPreserved());
+        change = true;
+    }
+    return change;
+}
+
+//! Bring those of \a analyses that are stale up to date for \a proc
+void PassManager::require(UserProc &proc, unsigned analyses) {
+    Cfg *cfg = proc.getCFG();
+    if (cfg == nullptr || cfg->getEntryBB() == nullptr)
+        return;
+    if ((analyses & ANALYSIS_DOMINATORS) && !proc.getDataFlow()->dominatorsValid(cfg))
+        proc.getDataFlow()->updateDominators(cfg); // Renumbers the phi sites too, if there are any yet
+    if (analyses & ANALYSIS_LIVENESS)
+        cfg->calcLiveIn(); // Does nothing if the livenesses are still valid
+    if ((analyses & ANALYSIS_DFT_ORDER) && !cfg->isDFTOrderValid())
+        cfg->establishDFTOrder();
+}
+
+//! Mark \a analyses of \a proc stale, e.g. after changing it outside a pass
+void PassManager::invalidate(UserProc &proc, unsigned analyses) {
+    Cfg *cfg = proc.getCFG();
+    if (analyses & ANALYSIS_DOMINATORS)
+        proc.getDataFlow()->invalidateDominators();
+    if (cfg && (analyses & ANALYSIS_LIVENESS))
+        cfg->invalidateLiveness();
+    if (cfg && (analyses & ANALYSIS_DFT_ORDER))
+        cfg->invalidateDFTOrder();
+}
+
+//! Log, when verbose, how often each pass ran and changed something, and the time it took in all
+void PassManager::printTimings() {
+    for (auto &tt : timings)
+        LOG_VERBOSE(1) << "pass " << tt.first << ": " << tt.second.runs << " runs, " << tt.second.changes
+                       << " changes, " << tt.second.seconds << " s\n";
+}
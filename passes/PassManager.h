@@ -0,0 +1,40 @@
+#ifndef PASSMANAGER_H
+#define PASSMANAGER_H
+#include "Pass.h"
+#include <map>
+#include <QtCore/QString>
+#include <vector>
+class DataFlow;
+class UserProc;
+/**
+ * Runs a sequence of function passes over procedures. Before each pass, the analyses it requires are brought up to
+ * date; an analysis is only computed again when it is stale, i.e. when the cfg has changed since it was computed or
+ * a pass that changed something did not preserve it. The analyses themselves stay where they always were (on the
+ * proc's DataFlow and Cfg), so they are shared with the passes still called directly from UserProc.
+ *
+ * The time taken by each pass is added to a per pass total, which printTimings() logs.
+ */
+class PassManager
+{
+public:
+    PassManager() {}
+    ~PassManager();
+    PassManager(const PassManager &) = delete;
+    PassManager &operator=(const PassManager &) = delete;
+
+    void add(FunctionPass *pass);
+    bool run(UserProc &proc);
+    static void require(UserProc &proc, unsigned analyses);
+    static void invalidate(UserProc &proc, unsigned analyses);
+    static void printTimings();
+private:
+    struct Timing {
+        int runs = 0;
+        int changes = 0;
+        double seconds = 0;
+    };
+    std::vector<FunctionPass *> passes; //!< Owned
+    static std::map<QString, Timing> timings;
+};
+
+#endif // PASSMANAGER_H
@@ -16,6 +16,8 @@
 #include "exp.h"
 #include "exphelp.h"
 
+#include <algorithm>
+
 class Range : public Printable {
 protected:
     int stride, lowerBound, upperBound;
@@ -30,7 +32,8 @@ public:
     int getLowerBound() const { return lowerBound; }
     int getUpperBound() const { return upperBound; }
     void unionWith(Range &r);
-    void widenWith(Range &r);
+    void widenWith(Range &r, const std::set<int> &thresholds);
+    void narrowWith(Range &r);
     QString toString() const;
     bool operator==(Range &other);
 
@@ -47,7 +50,8 @@ public:
     bool hasRange(Exp *loc) { return ranges.find(loc) != ranges.end(); }
     Range &getRange(Exp *loc);
     void unionwith(RangeMap &other);
-    void widenwith(RangeMap &other);
+    void widenwith(RangeMap &other, const std::set<int> &thresholds);
+    void narrowwith(RangeMap &other);
     QString toString() const;
     void print() const;
     Exp *substInto(Exp *e, std::set<Exp *, lessExpStar> *only = nullptr) const;
@@ -60,6 +64,11 @@ struct RangePrivateData {
     std::map<Instruction *,RangeMap> SavedInputRanges; //!< overestimation of ranges of locations
     std::map<Instruction *,RangeMap> Ranges;           //!< saved overestimation of ranges of locations
     std::map<BranchStatement *,RangeMap> BranchRanges;
+    std::map<BasicBlock *,int> JunctionVisits;          //!< times each loop junction was visited while widening
+    std::set<int> Thresholds;                           //!< constants the loop junctions widen to, before infinity
+    // The junction statements are only there while the analysis runs, so their ranges are kept by block in between
+    std::map<BasicBlock *,RangeMap> JunctionRanges;
+    std::map<BasicBlock *,QString> BlockDefs;           //!< each block's predecessors and statements, when last analysed
     RangeMap &getRanges(Instruction *insn) {
         return Ranges[insn];
     }
@@ -68,7 +77,10 @@ struct RangePrivateData {
     }
     void clearRanges() {
         SavedInputRanges.clear();
+        Thresholds.clear();
     }
+    void forgetBlock(BasicBlock *bb);
+    void keepOnly(UserProc &UF);
     RangeMap &getBranchRange(BranchStatement *s) {
         return BranchRanges[s];
     }
@@ -79,9 +91,18 @@ public:
     void setSavedRanges(Instruction *insn, RangeMap map);
     RangeMap getSavedRanges(Instruction *insn);
 };
-RangeAnalysis::RangeAnalysis() : RangeData(new RangePrivateData)
+//! The ranges found in each proc, so that running the analysis again only redoes what changed since
+static std::map<const UserProc *, RangePrivateData> cachedRanges;
+
+RangeAnalysis::RangeAnalysis() : RangeData(nullptr)
 {
 }
+/***************************************************************************/ /**
+  * \brief Drop the ranges kept for \a proc, e.g. because its statements are about to be deleted
+  *******************************************************************************/
+void RangeAnalysis::forgetRanges(const UserProc *proc) {
+    cachedRanges.erase(proc);
+}
 /***************************************************************************/ /**
   * \brief Add Junction statements
   *******************************************************************************/
@@ -98,11 +119,71 @@ void RangeAnalysis::addJunctionStatements(Cfg &cfg) {
 void RangeAnalysis::clearRanges() {
     RangeData->clearRanges();
 }
+// Search patterns for RangeVisitor::visit(Assign *); not function local, so that they are never put in a proc's arena
+static Unary search_term(opTemp, Terminal::get(opWild));
+static Unary search_regof(opRegOf, Terminal::get(opWild));
+static Terminal search_intconst(opWildIntConst);
+
+//! Number of times a loop junction just unions its inputs, before it starts widening
+static const int WIDENING_DELAY = 2;
+//! Number of times any one block may be visited in each phase, before the analysis gives up
+static const int MAX_BLOCK_VISITS = 50;
+
+/**
+ * The blocks waiting to be visited, popped in reverse postorder so that each block is visited after its forward
+ * predecessors, and a loop body is finished before the code after the loop is looked at.
+ */
+struct RangeWorklist {
+    std::vector<BasicBlock *> order;      //!< the blocks reachable from the entry, in reverse postorder
+    std::map<BasicBlock *, int> position; //!< the index of each block in order
+    std::set<int> pending;                //!< the positions of the blocks to visit
+
+    RangeWorklist(Cfg &cfg) {
+        // Iterative depth first search, so that deep CFGs can't overflow the stack
+        std::set<BasicBlock *> seen;
+        std::vector<std::pair<BasicBlock *, size_t>> stack;
+        stack.emplace_back(cfg.getEntryBB(), 0);
+        seen.insert(cfg.getEntryBB());
+        while (!stack.empty()) {
+            BasicBlock *bb = stack.back().first;
+            size_t i = stack.back().second++;
+            if (i < bb->getNumOutEdges()) {
+                BasicBlock *succ = bb->getOutEdge(i);
+                if (succ && seen.insert(succ).second)
+                    stack.emplace_back(succ, 0);
+                continue;
+            }
+            order.push_back(bb);
+            stack.pop_back();
+        }
+        std::reverse(order.begin(), order.end());
+        for (size_t i = 0; i < order.size(); i++)
+            position[order[i]] = i;
+    }
+    void push(BasicBlock *bb) {
+        auto it = position.find(bb);
+        if (it != position.end())
+            pending.insert(it->second);
+    }
+    void pushAll() {
+        for (size_t i = 0; i < order.size(); i++)
+            pending.insert(i);
+    }
+    BasicBlock *pop() {
+        BasicBlock *bb = order[*pending.begin()];
+        pending.erase(pending.begin());
+        return bb;
+    }
+    bool empty() const { return pending.empty(); }
+};
+
 struct RangeVisitor : public StmtVisitor {
     RangePrivateData *tgt;
-    std::list<Instruction *> &execution_paths;
-    RangeVisitor(RangePrivateData *t,std::list<Instruction *> & ex_paths) :
-        tgt(t),execution_paths(ex_paths) {
+    RangeWorklist &worklist;
+    bool changed = false;   //!< set when the last statement visited got new output ranges
+    bool narrowing = false; //!< true in the descending phase, when loop junctions narrow instead of widening
+    RangeVisitor(RangePrivateData *t,RangeWorklist &wl) :
+        tgt(t),worklist(wl) {
 
     }
     void processRange(Instruction *i) {
@@ -142,11 +223,10 @@ struct RangeVisitor : public StmtVisitor {
             BasicBlock *pred = insn->getBB()->getInEdges()[0];
             Instruction *last = pred->getLastStmt();
             assert(last);
-            if (pred->getNumOutEdges() != 2) {
+            // A two way branch keeps separate ranges for each of its out edges
+            if (pred->getNumOutEdges() != 2 || !last->isBranch()) {
                 input = tgt->getRanges(last);
             } else {
-                assert(pred->getNumOutEdges() == 2);
-                assert(last->isBranch());
                 input = getRangesForOutEdgeTo((BranchStatement *)last,insn->getBB());
             }
         }
@@ -161,34 +241,30 @@ struct RangeVisitor : public StmtVisitor {
                     tgt->setBranchRange(self_branch,output);
                 else
                     tgt->setRanges(insn,output);
-                if (insn->isLastStatementInBB()) {
-                    if (insn->getBB()->getNumOutEdges()) {
-                        uint32_t arc = 0;
-                        if (insn->getBB()->getOutEdge(0)->getLowAddr() != self_branch->getFixedDest())
-                            arc = 1;
-                        if (notTaken)
-                            arc ^= 1;
-                        execution_paths.push_back(insn->getBB()->getOutEdge(arc)->getFirstStmt());
-                    }
-                } else
-                    execution_paths.push_back(insn->getNextStatementInBB());
+                changed = true;
+                // Only the successor on this edge sees the new ranges
+                if (insn->isLastStatementInBB() && insn->getBB()->getNumOutEdges()) {
+                    uint32_t arc = 0;
+                    if (insn->getBB()->getOutEdge(0)->getLowAddr() != self_branch->getFixedDest())
+                        arc = 1;
+                    if (notTaken)
+                        arc ^= 1;
+                    worklist.push(insn->getBB()->getOutEdge(arc));
+                }
             }
         } else if (!notTaken) {
             if (!output.isSubset(tgt->getRanges(insn))) {
                 tgt->setRanges(insn,output);
+                changed = true;
                 if (insn->isLastStatementInBB()) {
-                    if (insn->getBB()->getNumOutEdges()) {
-                        execution_paths.push_back(insn->getBB()->getOutEdge(0)->getFirstStmt());
-                    }
-                } else
-                    execution_paths.push_back(insn->getNextStatementInBB());
+                    for (BasicBlock *succ : insn->getBB()->getOutEdges())
+                        worklist.push(succ);
+                }
             }
         }
     }
 
     bool visit(Assign *insn) {
-        static Unary search_term(opTemp, Terminal::get(opWild));
-        static Unary search_regof(opRegOf, Terminal::get(opWild));
         RangeMap output = getInputRanges(insn);
         Exp *a_lhs = insn->getLeft()->clone();
         if (a_lhs->isFlags()) {
@@ -473,8 +549,13 @@ struct RangeVisitor : public StmtVisitor {
             }
 
             if (stmt->isLoopJunction()) {
-                output = tgt->getRanges(stmt);
-                output.widenwith(input);
+                if (narrowing) {
+                    output = tgt->getRanges(stmt);
+                    output.narrowwith(input);
+                } else if (++tgt->JunctionVisits[stmt->getBB()] > WIDENING_DELAY) {
+                    output = tgt->getRanges(stmt);
+                    output.widenwith(input, tgt->Thresholds);
+                }
             }
 
             updateRanges(stmt,output);
@@ -554,71 +635,186 @@ bool RangeAnalysis::runOnFunction(Function &F)
 {
     if(F.isLib())
         return false;
-    LOG_STREAM() << "performing range analysis on " << F.getName() << "\n";
     UserProc &UF((UserProc &)F);
     assert(UF.getCFG());
+    assert(UF.getCFG()->getEntryBB());
+    assert(UF.getCFG()->getEntryBB()->getFirstStmt());
     // this helps
     UF.getCFG()->sortByAddress();
 
-    addJunctionStatements(*UF.getCFG());
-    UF.getCFG()->establishDFTOrder();
+    RangeData = &cachedRanges[&UF];
+    RangeWorklist worklist(*UF.getCFG());
+    std::set<BasicBlock *> affected;
+    findAffectedBlocks(worklist.order, affected);
+    if (affected.empty()) {
+        LOG_VERBOSE(1) << "reusing the ranges found before for " << F.getName() << "\n";
+        return false;
+    }
+    LOG_STREAM() << "performing range analysis on " << F.getName() << " (" << (int)affected.size() << " of "
+                 << (int)worklist.order.size() << " BBs)\n";
+    for (BasicBlock *bb : affected)
+        RangeData->forgetBlock(bb);
+
+    addJunctionStatements(*UF.getCFG()); // The DFT order is required from the PassManager
+    for (BasicBlock *bb : worklist.order) {
+        Instruction *first = bb->getFirstStmt();
+        if (first && first->isJunction() && affected.count(bb) == 0)
+            RangeData->setRanges(first, RangeData->JunctionRanges[bb]);
+    }
 
     clearRanges();
+    collectThresholds(UF);
 
     UF.debugPrintAll("Before performing range analysis");
 
-    std::list<Instruction *> execution_paths;
-    std::list<Instruction *> junctions;
+    RangeVisitor rv(this->RangeData,worklist);
 
-    assert(UF.getCFG()->getEntryBB());
-    assert(UF.getCFG()->getEntryBB()->getFirstStmt());
-    execution_paths.push_back(UF.getCFG()->getEntryBB()->getFirstStmt());
-
-    int watchdog = 0;
-    RangeVisitor rv(this->RangeData,execution_paths);
-    while (!execution_paths.empty()) {
-        while (!execution_paths.empty()) {
-            Instruction *stmt = execution_paths.front();
-            execution_paths.pop_front();
-            if (stmt == nullptr)
-                continue; // ??
-            if (stmt->isJunction())
-                junctions.push_back(stmt);
-            else
-                stmt->accept(&rv);
-        }
-        if (watchdog > 45)
-            LOG << "processing execution paths resulted in " << (int)junctions.size() << " junctions to process\n";
-        while (!junctions.empty()) {
-            Instruction *junction = junctions.front();
-            junctions.pop_front();
-            if (watchdog > 45)
-                LOG << "processing junction " << junction << "\n";
-            assert(junction->isJunction());
-            junction->accept(&rv);
+    // Ascending phase: propagate from the changed blocks until nothing changes, widening at the loop headers. Then
+    // the descending phase revisits what was visited once more, and lets the loop headers take back the bounds that
+    // widening threw away. The other blocks keep the ranges from last time
+    for (BasicBlock *bb : affected)
+        worklist.push(bb);
+    std::map<BasicBlock *, int> visits;
+    for (int phase = 0; phase < 2; phase++) {
+        rv.narrowing = phase == 1;
+        if (rv.narrowing) {
+            for (const std::pair<BasicBlock *, int> &v : visits)
+                worklist.push(v.first);
+            visits.clear();
         }
-
-        watchdog++;
-        if (watchdog > 10) {
-            LOG << "  watchdog " << watchdog << "\n";
-            if (watchdog > 45) {
-                LOG << (int)execution_paths.size() << " execution paths remaining.\n";
-                LOG_SEPARATE(UF.getName()) << "=== After range analysis watchdog " << watchdog << " for " << UF.getName()
-                                           << " ===\n" << UF << "=== end after range analysis watchdog " << watchdog
-                                           << " for " << UF.getName() << " ===\n\n";
+        while (!worklist.empty()) {
+            BasicBlock *bb = worklist.pop();
+            if (++visits[bb] > MAX_BLOCK_VISITS) {
+                LOG << "  watchdog expired at BB " << bb->getLowAddr() << (rv.narrowing ? " while narrowing\n" : "\n");
+                LOG_SEPARATE(UF.getName()) << "=== After range analysis watchdog for " << UF.getName() << " ===\n"
+                                           << UF << "=== end after range analysis watchdog for " << UF.getName()
+                                           << " ===\n\n";
+                worklist.pending.clear();
+                RangeData->BlockDefs.clear(); // the ranges are incomplete, so don't reuse them
+                break;
+            }
+            BasicBlock::rtlit rit;
+            StatementList::iterator sit;
+            for (Instruction *s = bb->getFirstStmt(rit, sit); s; s = bb->getNextStmt(rit, sit)) {
+                rv.changed = false;
+                s->accept(&rv);
+                // The rest of the block would see the same input as last time
+                if (!rv.changed)
+                    break;
             }
-        }
-        if (watchdog > 50) {
-            LOG << "  watchdog expired\n";
-            break;
         }
     }
     UF.debugPrintAll("After range analysis");
 
+    for (BasicBlock *bb : worklist.order) {
+        Instruction *first = bb->getFirstStmt();
+        if (first && first->isJunction())
+            RangeData->JunctionRanges[bb] = RangeData->getRanges(first);
+    }
     UF.getCFG()->removeJunctionStatements();
+    RangeData->keepOnly(UF);
     logSuspectMemoryDefs(UF);
     return true;
 }
+/***************************************************************************/ /**
+  *
+  * \brief Collect the widening thresholds of \a UF: the constants its branches and flag calls compare against,
+  * and their neighbours, since the conditions limit a range to one either side of the constant
+  *
+  ******************************************************************************/
+void RangeAnalysis::collectThresholds(UserProc &UF) {
+    std::set<int> &thresholds(RangeData->Thresholds);
+    thresholds.insert(0);
+    StatementList stmts;
+    UF.getStatements(stmts);
+    for (Instruction *st : stmts) {
+        Exp *e = nullptr;
+        if (st->isBranch())
+            e = ((BranchStatement *)st)->getCondExpr();
+        else if (st->isAssign() && ((Assign *)st)->getRight()->isFlagCall())
+            e = ((Assign *)st)->getRight();
+        std::list<Exp *> found;
+        if (e == nullptr || !e->searchAll(search_intconst, found))
+            continue;
+        for (Exp *k : found) {
+            int c = ((Const *)k)->getInt();
+            thresholds.insert(c);
+            if (c > Range::MIN)
+                thresholds.insert(c - 1);
+            if (c < Range::MAX)
+                thresholds.insert(c + 1);
+        }
+    }
+}
+/***************************************************************************/ /**
+  * \brief Describe the predecessors and statements of \a bb, so that a change to them can be noticed
+  ******************************************************************************/
+static QString describeBlock(BasicBlock *bb) {
+    QString res;
+    QTextStream os(&res);
+    for (BasicBlock *pred : bb->getInEdges())
+        os << (const void *)pred << " ";
+    os << "\n";
+    BasicBlock::rtlit rit;
+    StatementList::iterator sit;
+    for (Instruction *s = bb->getFirstStmt(rit, sit); s; s = bb->getNextStmt(rit, sit)) {
+        os << (const void *)s << " ";
+        s->print(os);
+        os << "\n";
+    }
+    return res;
+}
+/***************************************************************************/ /**
+  *
+  * \brief Find the blocks of \a blocks that need their ranges found again: those that are new, or whose
+  * predecessors or statements changed since the last run, and all the blocks their ranges flow into
+  *
+  ******************************************************************************/
+void RangeAnalysis::findAffectedBlocks(const std::vector<BasicBlock *> &blocks, std::set<BasicBlock *> &affected) {
+    std::map<BasicBlock *, QString> defs;
+    std::list<BasicBlock *> changed;
+    for (BasicBlock *bb : blocks) {
+        QString &d(defs[bb]);
+        d = describeBlock(bb);
+        auto it = RangeData->BlockDefs.find(bb);
+        if (it == RangeData->BlockDefs.end() || it->second != d)
+            changed.push_back(bb);
+    }
+    RangeData->BlockDefs = defs;
+    while (!changed.empty()) {
+        BasicBlock *bb = changed.front();
+        changed.pop_front();
+        if (!affected.insert(bb).second)
+            continue;
+        for (BasicBlock *succ : bb->getOutEdges())
+            changed.push_back(succ);
+    }
+}
+//! Forget the ranges of the statements in \a bb, and of the junction at its start
+void RangePrivateData::forgetBlock(BasicBlock *bb) {
+    BasicBlock::rtlit rit;
+    StatementList::iterator sit;
+    for (Instruction *s = bb->getFirstStmt(rit, sit); s; s = bb->getNextStmt(rit, sit)) {
+        Ranges.erase(s);
+        SavedInputRanges.erase(s);
+        if (s->isBranch())
+            BranchRanges.erase((BranchStatement *)s);
+    }
+    JunctionRanges.erase(bb);
+    JunctionVisits.erase(bb);
+}
+//! Forget the ranges of statements that are no longer in \a UF
+void RangePrivateData::keepOnly(UserProc &UF) {
+    StatementList stmts;
+    UF.getStatements(stmts);
+    std::set<Instruction *> live(stmts.begin(), stmts.end());
+    for (auto it = Ranges.begin(); it != Ranges.end();)
+        it = live.count(it->first) ? std::next(it) : Ranges.erase(it);
+    for (auto it = SavedInputRanges.begin(); it != SavedInputRanges.end();)
+        it = live.count(it->first) ? std::next(it) : SavedInputRanges.erase(it);
+    for (auto it = BranchRanges.begin(); it != BranchRanges.end();)
+        it = live.count(it->first) ? std::next(it) : BranchRanges.erase(it);
+}
 RangeMap RangePrivateData::getSavedRanges(Instruction *insn) {
     return SavedInputRanges[insn];
 }
@@ -760,7 +956,11 @@ void Range::unionWith(Range &r) {
         LOG_STREAM(LL_Default) << toString();
 }
 
-void Range::widenWith(Range &r) {
+/**
+ * Widen this range so that it also covers \a r. A bound that moves is extended to the nearest of \a thresholds
+ * rather than straight to infinity, so that a loop counted up to a constant gets its bound at the first widening.
+ */
+void Range::widenWith(Range &r, const std::set<int> &thresholds) {
     if (VERBOSE && DEBUG_RANGE_ANALYSIS)
         LOG << "widening " << toString() << " with " << r << " got ";
     if (!(*base == *r.base)) {
@@ -772,14 +972,32 @@ void Range::widenWith(Range &r) {
             LOG_STREAM(LL_Default) << toString();
                     return;
     }
-    // ignore stride for now
-    if (r.getLowerBound() < lowerBound)
-        lowerBound = MIN;
-    if (r.getUpperBound() > upperBound)
-        upperBound = MAX;
+    // ignore stride for now; the thresholds are only meaningful for ranges of plain numbers
+    bool useThresholds = base->isIntConst() && ((Const *)base)->getInt() == 0;
+    if (r.getLowerBound() < lowerBound) {
+        auto it = thresholds.upper_bound(r.getLowerBound());
+        lowerBound = (useThresholds && it != thresholds.begin()) ? *--it : MIN;
+    }
+    if (r.getUpperBound() > upperBound) {
+        auto it = thresholds.lower_bound(r.getUpperBound());
+        upperBound = (useThresholds && it != thresholds.end()) ? *it : MAX;
+    }
     if (VERBOSE && DEBUG_RANGE_ANALYSIS)
         LOG_STREAM(LL_Default) << toString();
 }
+
+/**
+ * Narrow this (widened) range with \a r, a range computed from it. Only the infinite bounds are replaced, so that
+ * the descending phase can't go on forever.
+ */
+void Range::narrowWith(Range &r) {
+    if (!(*base == *r.base))
+        return;
+    if (lowerBound == MIN)
+        lowerBound = std::min(r.lowerBound, upperBound);
+    if (upperBound == MAX)
+        upperBound = std::max(r.upperBound, lowerBound);
+}
 Range &RangeMap::getRange(Exp *loc) {
     if (ranges.find(loc) == ranges.end()) {
         return *(new Range(1, Range::MIN, Range::MAX, Const::get(0)));
@@ -797,12 +1015,22 @@ void RangeMap::unionwith(RangeMap &other) {
     }
 }
 
-void RangeMap::widenwith(RangeMap &other) {
+void RangeMap::widenwith(RangeMap &other, const std::set<int> &thresholds) {
+    for (auto &elem : other.ranges) {
+        if (ranges.find((elem).first) == ranges.end()) {
+            ranges[(elem).first] = (elem).second;
+        } else {
+            ranges[(elem).first].widenWith((elem).second, thresholds);
+        }
+    }
+}
+
+void RangeMap::narrowwith(RangeMap &other) {
     for (auto &elem : other.ranges) {
         if (ranges.find((elem).first) == ranges.end()) {
             ranges[(elem).first] = (elem).second;
         } else {
-            ranges[(elem).first].widenWith((elem).second);
+            ranges[(elem).first].narrowWith((elem).second);
         }
     }
 }
@@ -2,6 +2,9 @@
 #define RANGEANALYSIS_H
 #include "Pass.h"
 #include <map>
+#include <set>
+#include <vector>
+class BasicBlock;
 class Cfg;
 class Function;
 class Instruction;
@@ -11,11 +14,18 @@ class RangeAnalysis : public FunctionPass
 {
 public:
     RangeAnalysis();
+    const char *getName() const { return "RangeAnalysis"; }
+    unsigned getRequired() const { return ANALYSIS_DFT_ORDER; }
+    //! Only adds junction statements, and ranges to statements
+    unsigned getPreserved() const { return ANALYSIS_DOMINATORS | ANALYSIS_DFT_ORDER; }
     bool runOnFunction(Function &F);
+    static void forgetRanges(const UserProc *proc);
 private:
     friend class rangeVisitor;
     void addJunctionStatements(Cfg &cfg);
     void clearRanges();
+    void collectThresholds(UserProc &UF);
+    void findAffectedBlocks(const std::vector<BasicBlock *> &blocks, std::set<BasicBlock *> &affected);
     RangePrivateData * RangeData;
     void logSuspectMemoryDefs(UserProc &UF);
 };
@@ -6,34 +6,88 @@
 # ARGV[3] test-set
 # ARGV[4] options
 # ARGV[5] parameters to the recompiled executable
+#
+# Performance mode: with --perf-runs=N anywhere in the arguments, each input is decompiled N times (with --stats), and
+# the median wall time, the peak RSS and the stage times of stats.json are compared against tests/baseline/perf.json.
+# Inputs slower or bigger than the baseline by more than --perf-threshold=PERCENT (default 10) are reported, and the
+# exit status is 1 if there are any. --perf-record writes the measurements to the baseline instead of comparing.
 
 import os
 import subprocess
 import shutil
 import sys
 import time
+import json
 import operator
 from collections import defaultdict
 
 TESTS_DIR="."+os.sep+"tests"
 TEST_INPUT=os.path.join(TESTS_DIR,"inputs")
+PERF_BASELINE=os.path.join(TESTS_DIR,"baseline","perf.json")
+PERF_MIN_SECONDS=0.05 # Differences in time smaller than this are noise, whatever the ratio
+
+perf_runs = 0
+perf_record = False
+perf_threshold = 10.0
+for arg in sys.argv[1:]:
+    if arg.startswith("--perf-runs="):
+        perf_runs = int(arg.split("=",1)[1])
+    elif arg == "--perf-record":
+        perf_record = True
+    elif arg.startswith("--perf-threshold="):
+        perf_threshold = float(arg.split("=",1)[1])
+sys.argv = [a for a in sys.argv if not a.startswith("--perf-")]
+if perf_record and perf_runs == 0:
+    perf_runs = 1
 
 print("Regression tester 0.0.1\n")
 FAILED_COMMANDLINES=""
+def run_measured(cmd, stdout, stderr):
+    """Run cmd, returning its exit status, wall time in seconds and peak RSS in KiB (None where unknown)"""
+    start_t = time.time()
+    proc = subprocess.Popen(cmd, stdout=stdout, stderr=stderr)
+    if hasattr(os, "wait4"):
+        _, status, usage = os.wait4(proc.pid, 0)
+        end_t = time.time()
+        result = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -os.WTERMSIG(status)
+        proc.returncode = result
+        rss = usage.ru_maxrss
+        if sys.platform == "darwin":
+            rss = rss / 1024 # bytes there, KiB elsewhere
+        return result, end_t-start_t, rss
+    result = proc.wait()
+    return result, time.time()-start_t, None
+
 def perform_test(exepath,test_file,output_path,args):
     log_name = output_path
     file_size = os.path.getsize(test_file)
     upper_dir = os.sep.join(output_path.split(os.sep)[:-1])
+    if perf_runs and "--stats" not in args:
+        args = args + ["--stats"]
     cmdline = ['-P',os.getcwd(),'-o',upper_dir] + args + [test_file]
     test_stdout = open(log_name+".stdout", "w")
     test_stderr = open(log_name+".stderr", "w")
-    start_t = time.time()
-    result = subprocess.call([exepath]+cmdline, stdout=test_stdout, stderr=test_stderr)
-    end_t = time.time()
-    test_stdout.close()
+    result, seconds, rss = run_measured([exepath]+cmdline, test_stdout, test_stderr)
     test_stdout.close()
+    test_stderr.close()
     sys.stdout.write('.' if result == 0 else '!')
-    return [result == 0, ' '.join(cmdline), test_file, float(file_size)/(end_t-start_t)]
+    return [result == 0, ' '.join(cmdline), test_file, float(file_size)/max(seconds, 1e-6), seconds, rss]
+
+def read_stage_times(output_dir):
+    """The seconds spent in each stage, over all procedures, from the stats.json of a run (empty if there is none)"""
+    try:
+        with open(os.path.join(output_dir,"stats.json")) as f:
+            stages = json.load(f).get("stages", {})
+    except (IOError, ValueError):
+        return {}
+    return dict((name, st.get("seconds", 0.0)) for name, st in stages.items())
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    if n == 0:
+        return None
+    return values[n//2] if n % 2 else (values[n//2-1]+values[n//2])/2.0
 
 if os.path.isdir(os.path.join(TESTS_DIR,"outputs_prev")):
     shutil.rmtree(os.path.join(TESTS_DIR,"outputs_prev"))
@@ -45,6 +99,7 @@ if os.path.isdir(os.path.join(TESTS_DIR,"outputs")):
 #sh -c "./boomerang -o functest $4 test/$1/$2 2>/dev/null >/dev/null"
 crashes = defaultdict(list)
 times = {}
+perf = {} # input -> {"seconds": median wall time, "max_rss_kb": largest peak RSS, "stages": median stage seconds}
 
 def test_all_inputs_in(base_dir, dirname=""):
     if dirname != "":
@@ -67,6 +122,18 @@ def test_all_inputs_in(base_dir, dirname=""):
             except:
                 pass
             test_res = perform_test(sys.argv[1],source,result_path,sys.argv[2:])
+            if perf_runs and test_res[0]:
+                runs = [test_res]
+                stage_runs = [read_stage_times(output_dir)]
+                while len(runs) < perf_runs:
+                    runs.append(perform_test(sys.argv[1],source,result_path,sys.argv[2:]))
+                    stage_runs.append(read_stage_times(output_dir))
+                stage_names = set(name for st in stage_runs for name in st)
+                rss = [r[5] for r in runs if r[5] is not None]
+                perf[source.replace(os.sep, "/")] = {
+                    "seconds": median([r[4] for r in runs]),
+                    "max_rss_kb": max(rss) if rss else None,
+                    "stages": dict((name, median([st.get(name, 0.0) for st in stage_runs])) for name in stage_names)}
             assert(not test_res[0] or os.path.isfile(os.path.join(output_dir,"log")))
             try:
                 shutil.move(os.path.join(output_dir,"log"),os.path.join(output_dir,f+".log"))
@@ -87,6 +154,51 @@ for machine, crash_list in crashes.iteritems():
 sorted_times = sorted(times.iteritems(), key=operator.itemgetter(1), reverse=True)
 print("Slowest run in bytes/sec "+sorted_times[0][0]+" - "+str(sorted_times[0][1])+" bytes/sec")
 
+def compare_perf(baseline, current):
+    """Print the inputs that got slower or bigger than the baseline allows, and return how many there are"""
+    limit = 1.0 + perf_threshold/100.0
+    regressions = 0
+    for test in sorted(current):
+        now = current[test]
+        before = baseline.get(test)
+        if before is None:
+            print("No performance baseline for "+test)
+            continue
+        problems = []
+        if now["seconds"] > before["seconds"]*limit and now["seconds"]-before["seconds"] > PERF_MIN_SECONDS:
+            problems.append("%.3fs instead of %.3fs" % (now["seconds"], before["seconds"]))
+        if now["max_rss_kb"] and before.get("max_rss_kb") and now["max_rss_kb"] > before["max_rss_kb"]*limit:
+            problems.append("peak RSS %d KiB instead of %d KiB" % (now["max_rss_kb"], before["max_rss_kb"]))
+        if not problems:
+            continue
+        regressions += 1
+        print("Performance regression in "+test+": "+", ".join(problems))
+        # Say where the time went, for the stages that grew the most
+        growth = []
+        for name, seconds in now["stages"].items():
+            was = before.get("stages", {}).get(name, 0.0)
+            if seconds-was > PERF_MIN_SECONDS:
+                growth.append((seconds-was, name, was, seconds))
+        for _, name, was, seconds in sorted(growth, reverse=True)[:5]:
+            print("    %s: %.3fs instead of %.3fs" % (name, seconds, was))
+    return regressions
+
+if perf_runs:
+    if perf_record:
+        with open(PERF_BASELINE, "w") as f:
+            json.dump(perf, f, indent=1, sort_keys=True)
+        print("\nPerformance baseline of "+str(len(perf))+" inputs written to "+PERF_BASELINE)
+    elif not os.path.isfile(PERF_BASELINE):
+        print("\nNo performance baseline in "+PERF_BASELINE+"; make one with --perf-record")
+    else:
+        with open(PERF_BASELINE) as f:
+            perf_baseline = json.load(f)
+        print("")
+        regressions = compare_perf(perf_baseline, perf)
+        print(str(regressions)+" performance regressions beyond "+str(perf_threshold)+"% in "+str(len(perf))+" inputs")
+        if regressions:
+            sys.exit(1)
+
 #Dir.open(TESTS_DIR+"/inputs").each() {|f|
 #        next if f=="." or f==".."
 #        FileUtils.mv(TESTS_DIR+"/inputs/"+f,TESTS_DIR+"/outputs/"+f) if f.end_with?(".b")
@@ -45,7 +45,7 @@ Exp *GenericExpTransformer::applyFuncs(Exp *rhs) {
         QString member = ty->asCompound()->getNameAtOffset(offset);
         Exp *result = Const::get(member);
         bool change;
-        rhs = rhs->searchReplace(*callw, result->clone(), change);
+        rhs = rhs->searchReplace(*callw, result, change);
         assert(change);
 #if 0
         LOG << "replaced " << call << " with " << result << "\n";
@@ -68,7 +68,7 @@ Exp *GenericExpTransformer::applyFuncs(Exp *rhs) {
         int offset = ty->asCompound()->getOffsetTo(member) / 8;
         Exp *result = new Const(offset);
         bool change;
-        rhs = rhs->searchReplace(*callw, result->clone(), change);
+        rhs = rhs->searchReplace(*callw, result, change);
         assert(change);
 #if 0
         LOG << "replaced " << call << " with " << result << "\n";
@@ -85,7 +85,7 @@ Exp *GenericExpTransformer::applyFuncs(Exp *rhs) {
         int b = ((Const *)p2)->getInt();
         Exp *result = new Const(a + b);
         bool change;
-        rhs = rhs->searchReplace(*callw, result->clone(), change);
+        rhs = rhs->searchReplace(*callw, result, change);
         assert(change);
 #if 0
         LOG << "replaced " << call << " with " << result << "\n";
@@ -98,7 +98,7 @@ Exp *GenericExpTransformer::applyFuncs(Exp *rhs) {
         int a = ((Const *)p1)->getInt();
         Exp *result = new Const(-a);
         bool change;
-        rhs = rhs->searchReplace(*callw, result->clone(), change);
+        rhs = rhs->searchReplace(*callw, result, change);
         assert(change);
 #if 0
         LOG << "replaced " << call << " with " << result << "\n";
@@ -116,13 +116,13 @@ bool GenericExpTransformer::checkCond(Exp *cond, Exp *bindings) {
         for (Exp *l = bindings; l->getOper() != opNil; l = l->getSubExp2()) {
             Exp *e = l->getSubExp1();
             bool change = false;
-            lhs = lhs->searchReplaceAll(*e->getSubExp1(), e->getSubExp2()->clone(), change);
+            lhs = lhs->searchReplaceAll(*e->getSubExp1(), e->getSubExp2(), change);
 #if 0
                     if (change)
                         LOG << "replaced " << e->getSubExp1() << " with " << e->getSubExp2() << "\n";
 #endif
             change = false;
-            rhs = rhs->searchReplaceAll(*e->getSubExp1(), e->getSubExp2()->clone(), change);
+            rhs = rhs->searchReplaceAll(*e->getSubExp1(), e->getSubExp2(), change);
 #if 0
                     if (change)
                         LOG << "replaced " << e->getSubExp1() << " with " << e->getSubExp2() << "\n";
@@ -204,6 +204,10 @@ bool GenericExpTransformer::checkCond(Exp *cond, Exp *bindings) {
     return false;
 }
 
+//! A pattern that is just a variable matches anything
+OPER GenericExpTransformer::rootOper() const { return match->getOper() == opVar ? opWild : match->getOper(); }
+int GenericExpTransformer::rootArity() const { return match->getOper() == opVar ? -1 : match->getArity(); }
+
 Exp *GenericExpTransformer::applyTo(Exp *e, bool &bMod) {
     bool change;
     Exp *bindings = e->match(match);
@@ -20,6 +20,8 @@ class GenericExpTransformer : public ExpTransformer {
 
   public:
     GenericExpTransformer(Exp *_match, Exp *_where, Exp *_become) : match(_match), where(_where), become(_become) {}
+    virtual OPER rootOper() const;
+    virtual int rootArity() const;
     virtual Exp *applyTo(Exp *e, bool &bMod);
 };
 
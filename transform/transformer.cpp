@@ -30,8 +30,47 @@
 #include <sstream>   // Need gcc 3.0 or better
 
 std::list<ExpTransformer *> ExpTransformer::transformers;
+std::vector<std::vector<ExpTransformer *>> ExpTransformer::index;
+bool ExpTransformer::indexValid = false;
 
-ExpTransformer::ExpTransformer() { transformers.push_back(this); }
+// The index can't be updated here, since rootOper() isn't the derived one yet while this runs
+ExpTransformer::ExpTransformer() : order(transformers.size()) {
+    transformers.push_back(this);
+    indexValid = false;
+}
+
+namespace {
+const int MAX_ARITY = 3;
+inline size_t bucketOf(int op, int arity) { return (size_t)(op + 1) * (MAX_ARITY + 1) + arity; }
+}
+
+bool ExpTransformer::createdBefore(const ExpTransformer *a, const ExpTransformer *b) { return a->order < b->order; }
+
+/***************************************************************************/ /**
+  * \brief Sort the transformers into one bucket per root operator and arity. A transformer that isn't restricted to
+  * an operator (or arity) goes into every bucket it could apply to; each bucket keeps the order of transformers.
+  ******************************************************************************/
+void ExpTransformer::buildIndex() {
+    index.assign(bucketOf(opNumOf, 0), std::vector<ExpTransformer *>());
+    for (ExpTransformer *t : transformers) {
+        int tOp = t->rootOper(), tArity = t->rootArity();
+        for (int op = opWild; op < opNumOf; op++) {
+            if (tOp != opWild && tOp != op)
+                continue;
+            for (int arity = 0; arity <= MAX_ARITY; arity++)
+                if (tArity == -1 || tArity == arity)
+                    index[bucketOf(op, arity)].push_back(t);
+        }
+    }
+    indexValid = true;
+}
+
+//! The transformers that could apply to e, in the order they were created
+const std::vector<ExpTransformer *> &ExpTransformer::candidates(const Exp *e) {
+    if (!indexValid)
+        buildIndex();
+    return index[bucketOf(e->getOper(), e->getArity())];
+}
 
 std::list<Exp *> cache;
 
@@ -66,10 +105,23 @@ Exp *ExpTransformer::applyAllTo(Exp *p, bool &bMod) {
     bool mod;
     // do {
     mod = false;
-    for (auto &transformer : transformers) {
-        e = (transformer)->applyTo(e, mod);
-        bMod |= mod;
+    // Only the transformers for the root of e are tried. One of them may change the root, so after a change the
+    // ones that come later in creation order are looked up again, for the new e
+    const std::vector<ExpTransformer *> *cands = &candidates(e);
+    size_t i = 0;
+    while (i < cands->size()) {
+        ExpTransformer *transformer = (*cands)[i];
+        bool changed = false;
+        e = transformer->applyTo(e, changed);
+        if (!changed) {
+            i++;
+            continue;
+        }
+        mod = true;
+        cands = &candidates(e);
+        i = std::upper_bound(cands->begin(), cands->end(), transformer, createdBefore) - cands->begin();
     }
+    bMod |= mod;
     //} while (mod);
 
     cache.push_back(Binary::get(opEquals, p->clone(), e->clone()));
@@ -17,9 +17,16 @@
 #include "exp.h"
 #include "boomerang.h"
 #include "log.h"
+#include "util.h"
+#include <algorithm>
 #include <sstream>
 #include <cstring>
 
+//! Give up the search over disjunctions after this many disjuncts have been tried, keeping any solutions found
+static const size_t MAX_SOLVE_STEPS = 10000;
+//! Stop looking once this many solutions are known; only the first is used (see UserProc::conTypeAnalysis)
+static const size_t MAX_SOLUTIONS = 4;
+
 void ConstraintMap::print(QTextStream &os) {
     iterator kk;
     bool first = true;
@@ -33,14 +40,12 @@ void ConstraintMap::print(QTextStream &os) {
     os << "\n";
 }
 
-extern char debug_buffer[];
+extern thread_local char debug_buffer[];
 char *ConstraintMap::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     print(ost);
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 void ConstraintMap::makeUnion(ConstraintMap &o) {
@@ -91,12 +96,10 @@ void EquateMap::print(QTextStream &os) {
 }
 
 char *EquateMap::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     print(ost);
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 // Substitute the given constraints into this map
@@ -180,53 +183,80 @@ void Constraints::substIntoDisjuncts(ConstraintMap &in) {
     alphaSubst();
 }
 
+Exp *nextDisjunct(Exp *&remainder);
+
+//! The dense id of type variable \a e, allocated on first use
+int Constraints::getVar(Exp *e) {
+    auto ret = varIds.insert(std::make_pair(e, (int)parent.size()));
+    if (ret.second)
+        parent.push_back(ret.first->second);
+    return ret.first->second;
+}
+
+//! The representative of the class of equal type variables containing \a v
+int Constraints::findClass(int v) {
+    while (parent[v] != v) {
+        parent[v] = parent[parent[v]]; // Path halving
+        v = parent[v];
+    }
+    return v;
+}
+
+//! Record that type variables \a a and \a b are equal
+void Constraints::joinClasses(Exp *a, Exp *b) {
+    int ra = findClass(getVar(a));
+    int rb = findClass(getVar(b));
+    if (ra != rb)
+        parent[std::max(ra, rb)] = std::min(ra, rb);
+}
+
 void Constraints::substIntoEquates(ConstraintMap &in) {
-    // Substitute the fixed types into the equates. This may generate more
-    // fixed types
+    // Substitute the fixed types into the equates. This may generate more fixed types. The equates are closed
+    // transitively by the union-find classes, so each class is handled once: every fixed type in it must unify with
+    // the first, and its other members get that type
+    std::map<int, std::vector<Exp *>> classes;
+    for (auto &v : varIds)
+        classes[findClass(v.second)].push_back(v.first);
     ConstraintMap extra;
-    ConstraintMap cur = in;
-    while (cur.size()) {
-        extra.clear();
-        ConstraintMap::iterator kk;
-        for (kk = cur.begin(); kk != cur.end(); kk++) {
-            Exp *lhs = kk->first;
-            std::map<Exp *, LocationSet, lessExpStar>::iterator it = equates.find(lhs);
-            if (it != equates.end()) {
-                // Possibly new constraints that
-                // typeof(elements in it->second) == val
-                Exp *val = kk->second;
-                LocationSet &ls = it->second;
-                LocationSet::iterator ll;
-                for (ll = ls.begin(); ll != ls.end(); ll++) {
-                    ConstraintMap::iterator ff;
-                    ff = fixed.find(*ll);
-                    if (ff != fixed.end()) {
-                        if (!unify(val, ff->second, extra)) {
-                            LOG_VERBOSE(DEBUG_TA) << "Constraint failure: " << *ll << " constrained to be "
-                                                  << ((TypeVal *)val)->getType()->getCtype() << " and "
-                                                  << ((TypeVal *)ff->second)->getType()->getCtype() << "\n";
-                            return;
-                        }
-                    } else
-                        extra[*ll] = val; // A new constant constraint
-                }
-                if (((TypeVal *)val)->getType()->isComplete()) {
-                    // We have a complete type equal to one or more variables
-                    // Remove the equate, and generate more fixed
-                    // e.g. Ta = Tb,Tc and Ta = K => Tb=K, Tc=K
-                    for (ll = ls.begin(); ll != ls.end(); ll++) {
-                        Exp *newFixed = Binary::get(opEquals,
-                                                    *ll,  // e.g. Tb
-                                                    val); // e.g. K
-                        extra.insert(newFixed);
-                    }
+    for (auto &cls : classes) {
+        Exp *val = nullptr;
+        for (Exp *loc : cls.second) {
+            ConstraintMap::iterator ff = in.find(loc);
+            if (ff == in.end())
+                continue;
+            if (val == nullptr)
+                val = ff->second;
+            else if (!unify(val, ff->second, extra)) {
+                LOG_VERBOSE(DEBUG_TA) << "Constraint failure: " << loc << " constrained to be "
+                                      << ((TypeVal *)val)->getType()->getCtype() << " and "
+                                      << ((TypeVal *)ff->second)->getType()->getCtype() << "\n";
+                return;
+            }
+        }
+        if (val == nullptr)
+            continue;
+        for (Exp *loc : cls.second)
+            if (!in.isFound(loc))
+                extra[loc] = val; // A new constant constraint
+        if (((TypeVal *)val)->getType()->isComplete()) {
+            // We have a complete type equal to all the variables of the class
+            // Remove the equates; they are now fixed
+            for (Exp *loc : cls.second) {
+                EquateMap::iterator it = equates.find(loc);
+                if (it != equates.end())
                     equates.erase(it);
-                }
             }
         }
-        fixed.makeUnion(extra);
-        cur = extra; // Take care of any "ripple effect"
-    }                // Repeat until no ripples
+    }
+    fixed.makeUnion(extra);
+}
+
+//! The number of disjuncts of the disjunction \a dj
+static int countDisjuncts(Exp *dj) {
+    int n = 0;
+    while (nextDisjunct(dj) != nullptr)
+        n++;
+    return n;
 }
 
 // Get the next disjunct from this disjunction
@@ -342,6 +372,7 @@ bool Constraints::solve(std::list<ConstraintMap> &solns) {
                 // Of the form typeof(x) = typeof(z)
                 // Insert into equates
                 equates.addEquate(lhs, rhs);
+                joinClasses(lhs, rhs);
             } else {
                 // Of the form typeof(x) = <typeval>
                 // Insert into fixed
@@ -393,8 +424,23 @@ bool Constraints::solve(std::list<ConstraintMap> &solns) {
     LOG << fixed.size() << " fixed: " << fixed.prints();
     LOG << equates.size() << " equates: " << equates.prints();
 
+    // Try the disjunctions with the fewest alternatives first, so that dead ends are found near the root of the search
+    std::vector<std::pair<int, Exp *>> order;
+    for (Exp *dj : disjunctions)
+        order.push_back(std::make_pair(countDisjuncts(dj), dj));
+    std::stable_sort(order.begin(), order.end(),
+                     [](const std::pair<int, Exp *> &a, const std::pair<int, Exp *> &b) { return a.first < b.first; });
+    disjunctions.clear();
+    for (auto &o : order)
+        disjunctions.push_back(o.second);
+
     ConstraintMap soln;
+    searchSteps = 0;
     bool ret = doSolve(disjunctions.begin(), soln, solns);
+    if (searchSteps > MAX_SOLVE_STEPS)
+        LOG_VERBOSE(1) << "type constraints: search over " << (int)disjunctions.size() << " disjunctions stopped after "
+                       << (int)MAX_SOLVE_STEPS << " steps with " << (int)solns.size() << " solutions\n";
+    ret = ret && !solns.empty();
     if (ret) {
         // For each solution, we need to find disjunctions of the form
         // <alphaN> = <type>      or
@@ -412,8 +458,11 @@ static int level = 0;
 // The current solution is soln
 // The set of all solutions is in solns
 bool Constraints::doSolve(std::list<Exp *>::iterator it, ConstraintMap &soln, std::list<ConstraintMap> &solns) {
-    LOG << "Begin doSolve at level " << ++level << "\n";
-    LOG << "Soln now: " << soln.prints() << "\n";
+    ++level;
+    if (DEBUG_TA) {
+        LOG << "Begin doSolve at level " << level << "\n";
+        LOG << "Soln now: " << soln.prints() << "\n";
+    }
     if (it == disjunctions.end()) {
         // We have gotten to the end with no unification failures
         // Copy the current set of constraints as a solution
@@ -424,7 +473,9 @@ bool Constraints::doSolve(std::list<Exp *>::iterator it, ConstraintMap &soln, st
         // Copy the fixed constraints
         soln.makeUnion(fixed);
         solns.push_back(soln);
-        LOG << "Exiting doSolve at level " << level-- << " returning true\n";
+        if (DEBUG_TA)
+            LOG << "Exiting doSolve at level " << level << " returning true\n";
+        level--;
         return true;
     }
 
@@ -434,7 +485,11 @@ bool Constraints::doSolve(std::list<Exp *>::iterator it, ConstraintMap &soln, st
     bool anyUnified = false;
     Exp *d;
     while ((d = nextDisjunct(rem1)) != nullptr) {
-        LOG << " $$ d is " << d << ", rem1 is " << ((rem1 == nullptr) ? "NULL" : rem1->prints()) << " $$\n";
+        // Bound the search: it is exponential in the number of disjunctions
+        if (solns.size() >= MAX_SOLUTIONS || ++searchSteps > MAX_SOLVE_STEPS)
+            break;
+        if (DEBUG_TA)
+            LOG << " $$ d is " << d << ", rem1 is " << ((rem1 == nullptr) ? "NULL" : rem1->prints()) << " $$\n";
         // Match disjunct d against the fixed types; it could be compatible,
         // compatible and generate an additional constraint, or be
         // incompatible
@@ -443,7 +498,8 @@ bool Constraints::doSolve(std::list<Exp *>::iterator it, ConstraintMap &soln, st
         Exp *rem2 = d;
         bool unified = true;
         while ((c = nextConjunct(rem2)) != nullptr) {
-            LOG << "   $$ c is " << c << ", rem2 is " << ((rem2 == nullptr) ? "NULL" : rem2->prints()) << " $$\n";
+            if (DEBUG_TA)
+                LOG << "   $$ c is " << c << ", rem2 is " << ((rem2 == nullptr) ? "NULL" : rem2->prints()) << " $$\n";
             if (c->isFalse()) {
                 unified = false;
                 break;
@@ -456,7 +512,8 @@ bool Constraints::doSolve(std::list<Exp *>::iterator it, ConstraintMap &soln, st
             kk = fixed.find(lhs);
             if (kk != fixed.end()) {
                 unified &= unify(rhs, kk->second, extra);
-                LOG << "Unified now " << unified << "; extra now " << extra.prints() << "\n";
+                if (DEBUG_TA)
+                    LOG << "Unified now " << unified << "; extra now " << extra.prints() << "\n";
                 if (!unified)
                     break;
             }
@@ -477,14 +534,17 @@ bool Constraints::doSolve(std::list<Exp *>::iterator it, ConstraintMap &soln, st
         // If this recursion did any good, it will have gotten to the end and
         // added the resultant soln to solns
         soln = oldSoln;
-        LOG << "After doSolve returned: soln back to: " << soln.prints() << "\n";
+        if (DEBUG_TA)
+            LOG << "After doSolve returned: soln back to: " << soln.prints() << "\n";
         // Back to the current disjunction
         it--;
         // Continue for more disjuncts this disjunction
     }
     // We have run out of disjuncts. Return true if any disjuncts had no
     // unification failures
-    LOG << "Exiting doSolve at level " << level-- << " returning " << anyUnified << "\n";
+    if (DEBUG_TA)
+        LOG << "Exiting doSolve at level " << level << " returning " << anyUnified << "\n";
+    level--;
     return anyUnified;
 }
 
@@ -602,10 +662,8 @@ void Constraints::print(QTextStream &os) {
 }
 
 char *Constraints::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     print(ost);
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
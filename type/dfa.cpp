@@ -27,10 +27,13 @@
 #include "log.h"
 #include "proc.h"
 #include "util.h"
+#include "stats.h"
 
 #include <sstream>
 #include <cstring>
+#include <deque>
 #include <utility>
+#include <vector>
 #include <QDebug>
 
 static int nextUnionNumber = 0;
@@ -52,47 +55,110 @@ void init_dfa() {
 }
 
 static int dfa_progress = 0;
+
+//! Queue \a s, unless it is queued already
+static void queueForTypes(Instruction *s, InstructionBitSet &queued, std::deque<Instruction *> &work) {
+    if (queued.exists(s))
+        return;
+    queued.insert(s);
+    work.push_back(s);
+}
+
+/**
+ * After the types in \a s have changed, queue what may see the change: the users of s, the definitions s refers to
+ * (whose types it meets with what it knows of them), and the other users of those definitions.
+ */
+static void queueTypeNeighbours(Instruction *s, std::map<Instruction *, std::vector<Instruction *>> &users,
+                                std::map<Instruction *, std::vector<Instruction *>> &defs, InstructionBitSet &queued,
+                                std::deque<Instruction *> &work) {
+    for (Instruction *u : users[s])
+        queueForTypes(u, queued, work);
+    for (Instruction *d : defs[s]) {
+        queueForTypes(d, queued, work);
+        for (Instruction *u : users[d])
+            queueForTypes(u, queued, work);
+    }
+}
 void UserProc::dfaTypeAnalysis() {
+    StatScope stats(this, "dfaTypeAnalysis");
     Boomerang::get()->alertDecompileDebugPoint(this, "before dfa type analysis");
 
     // First use the type information from the signature. Sometimes needed to split variables (e.g. argc as a
     // int and char* in sparc/switch_gcc)
     bool ch = signature->dfaTypeAnalysis(cfg);
-    StatementList stmts;
-    getStatements(stmts);
-
-    StatementList::iterator it;
+    StatementRange stmts = statements();
+    size_t numStmts = 0;
+
+    // The SSA def-use edges, along which type changes travel
+    std::map<Instruction *, std::vector<Instruction *>> users, defs;
+    for (Instruction *s : stmts) {
+        numStmts++;
+        LocationSet refs;
+        s->addUsedLocs(refs, true);
+        for (Exp *r : refs) {
+            Instruction *def = r->isSubscript() ? ((RefExp *)r)->getDef() : nullptr;
+            if (def == nullptr)
+                continue;
+            users[def].push_back(s);
+            defs[s].push_back(def);
+        }
+    }
+    auto analyse = [this](Instruction *s) {
+        if (++dfa_progress >= 2000) {
+            dfa_progress = 0;
+            LOG_STREAM() << "t";
+            LOG_STREAM().flush();
+        }
+        bool thisCh = false;
+        s->dfaTypeAnalysis(thisCh);
+        if (thisCh && DEBUG_TA)
+            LOG << " caused change: " << s << "\n";
+        return thisCh;
+    };
+    // Each iteration is a sweep over all the statements, then a work list of the statements that may see the changes
+    // made, until it is empty. Types also travel in ways the def-use edges do not show (globals, the signature, the
+    // callee's return statement), so iterate until a whole sweep finds no change, as the round robin algorithm did.
+    // A draft (see DecompilerOptions::draft) makes one forward sweep and takes the types as they are then.
+    bool draft = getContext()->draft;
+    InstructionBitSet queued(stmtTable);
+    std::deque<Instruction *> work;
+    size_t remet = 0, revisits = 0;
+    size_t maxRevisits = draft ? 0 : DFA_ITER_LIMIT * numStmts;
     int iter;
     for (iter = 1; iter <= DFA_ITER_LIMIT; ++iter) {
         ch = false;
-        for (it = stmts.begin(); it != stmts.end(); ++it) {
-            if (++dfa_progress >= 2000) {
-                dfa_progress = 0;
-                LOG_STREAM() << "t";
-                LOG_STREAM().flush();
-            }
-            bool thisCh = false;
-            //auto before = (*it)->clone();
-            (*it)->dfaTypeAnalysis(thisCh);
-            if (thisCh) {
-                ch = true;
-                if (DEBUG_TA)
-                    LOG << " caused change: " << *it << "\n"; //<< before << " TO: "
-            }
-            //delete before;
+        for (Instruction *s : stmts) {
+            if (!analyse(s))
+                continue;
+            ch = true;
+            remet++;
+            if (!draft)
+                queueTypeNeighbours(s, users, defs, queued, work);
         }
-        if (!ch)
+        if (!ch || draft)
             // No more changes: round robin algorithm terminates
             break;
+        while (!work.empty() && revisits < maxRevisits) {
+            Instruction *s = work.front();
+            work.pop_front();
+            queued.remove(s);
+            revisits++;
+            if (analyse(s)) {
+                remet++;
+                queueTypeNeighbours(s, users, defs, queued, work);
+            }
+        }
     }
-    if (ch)
+    DecompileStats::get().count(this, "dfaTypeAnalysis", "iterations", ch && !draft ? DFA_ITER_LIMIT : iter);
+    DecompileStats::get().count(this, "dfaTypeAnalysis", "revisits", revisits);
+    DecompileStats::get().count(this, "dfaTypeAnalysis", "types re-met", remet);
+    if (ch && !draft)
         LOG << "### WARNING: iteration limit exceeded for dfaTypeAnalysis of procedure " << getName() << " ###\n";
 
     if (DEBUG_TA) {
         LOG << "\n ### results for data flow based type analysis for " << getName() << " ###\n";
         LOG << iter << " iterations\n";
-        for (it = stmts.begin(); it != stmts.end(); ++it) {
-            Instruction *s = *it;
+        for (Instruction *s : stmts) {
             LOG << s << "\n"; // Print the statement; has dest type
             // Now print type for each constant in this Statement
             std::list<Const *> lc;
@@ -149,8 +215,7 @@ void UserProc::dfaTypeAnalysis() {
     debugPrintAll("before other uses of dfa type analysis");
 
     Prog *_prog = getProg();
-    for (it = stmts.begin(); it != stmts.end(); ++it) {
-        Instruction *s = *it;
+    for (Instruction *s : stmts) {
 
         // 1) constants
         std::list<Const *> lc;
@@ -318,13 +383,13 @@ void UserProc::dfaTypeAnalysis() {
 
 // ch set true if any change
 
-SharedType VoidType::meetWith(SharedType other, bool &ch, bool /*bHighestPtr*/) const {
+SharedType VoidType::meetWith(const SharedType &other, bool &ch, bool /*bHighestPtr*/) const {
     // void meet x = x
     ch |= !other->resolvesToVoid();
     return other->clone();
 }
 
-SharedType FuncType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType FuncType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     if (other->resolvesToVoid())
         return ((FuncType *)this)->shared_from_this();
     // NOTE: at present, compares names as well as types and num parameters
@@ -333,11 +398,11 @@ SharedType FuncType::meetWith(SharedType other, bool &ch, bool bHighestPtr) cons
     return createUnion(other, ch, bHighestPtr);
 }
 
-SharedType IntegerType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType IntegerType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     if (other->resolvesToVoid())
         return ((IntegerType *)this)->shared_from_this();
     if (other->resolvesToInteger()) {
-        std::shared_ptr<IntegerType> otherInt = other->as<IntegerType>();
+        const IntegerType *otherInt = other->ptrAs<IntegerType>();
         // Signedness
         int oldSignedness = signedness;
         if (otherInt->signedness > 0)
@@ -349,52 +414,64 @@ SharedType IntegerType::meetWith(SharedType other, bool &ch, bool bHighestPtr) c
         // Size. Assume 0 indicates unknown size
         unsigned oldSize = size;
         size = std::max(size, otherInt->size);
-        ch |= (size != oldSize);
+        if (size != oldSize) {
+            ch = true;
+            layoutChanged();
+        }
         return ((IntegerType *)this)->shared_from_this();
     }
     if (other->resolvesToSize()) {
-        std::shared_ptr<SizeType> other_sz=other->as<SizeType>();
+        const SizeType *other_sz = other->ptrAs<SizeType>();
         if (size == 0) { // Doubt this will ever happen
             size = other_sz->getSize();
+            layoutChanged();
             return ((IntegerType *)this)->shared_from_this();
         }
         if (size == other_sz->getSize())
             return ((IntegerType *)this)->shared_from_this();
-        LOG << "integer size " << size << " meet with SizeType size " << other->as<SizeType>()->getSize() << "!\n";
+        LOG << "integer size " << size << " meet with SizeType size " << other_sz->getSize() << "!\n";
         unsigned oldSize = size;
         size = std::max(size, other_sz->getSize());
         ch = size != oldSize;
+        if (ch)
+            layoutChanged();
         return ((IntegerType *)this)->shared_from_this();
     }
     return createUnion(other, ch, bHighestPtr);
 }
 
-SharedType FloatType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType FloatType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     if (other->resolvesToVoid())
         return ((FloatType *)this)->shared_from_this();
     if (other->resolvesToFloat()) {
-        std::shared_ptr<FloatType> otherFlt(other->as<FloatType>());
+        const FloatType *otherFlt = other->ptrAs<FloatType>();
         size_t oldSize = size;
         size = std::max(size, otherFlt->size);
-        ch |= size != oldSize;
+        if (size != oldSize) {
+            ch = true;
+            layoutChanged();
+        }
         return ((FloatType *)this)->shared_from_this();
     }
     if (other->resolvesToSize()) {
         size_t otherSize = other->getSize();
         ch |= size != otherSize;
-        size = std::max(size, otherSize);
+        if (otherSize > size) {
+            size = otherSize;
+            layoutChanged();
+        }
         return ((FloatType *)this)->shared_from_this();
     }
     return createUnion(other, ch, bHighestPtr);
 }
 
-SharedType BooleanType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType BooleanType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     if (other->resolvesToVoid() || other->resolvesToBoolean())
         return ((BooleanType *)this)->shared_from_this();
     return createUnion(other, ch, bHighestPtr);
 }
 
-SharedType CharType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType CharType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     if (other->resolvesToVoid() || other->resolvesToChar())
         return ((CharType *)this)->shared_from_this();
     // Also allow char to merge with integer
@@ -402,18 +479,18 @@ SharedType CharType::meetWith(SharedType other, bool &ch, bool bHighestPtr) cons
         ch = true;
         return other->clone();
     }
-    if (other->resolvesToSize() && other->as<SizeType>()->getSize() == 8)
+    if (other->resolvesToSize() && other->ptrAs<SizeType>()->getSize() == 8)
         return ((CharType *)this)->shared_from_this();
     return createUnion(other, ch, bHighestPtr);
 }
 
-SharedType PointerType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType PointerType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     if (other->resolvesToVoid())
         return ((PointerType *)this)->shared_from_this();
-    if (other->resolvesToSize() && other->asSize()->getSize() == STD_SIZE)
+    if (other->resolvesToSize() && other->ptrAs<SizeType>()->getSize() == STD_SIZE)
         return ((PointerType *)this)->shared_from_this();
     if (other->resolvesToPointer()) {
-        auto otherPtr = other->asPointer();
+        const PointerType *otherPtr = other->ptrAs<PointerType>();
         if (pointsToAlpha() && !otherPtr->pointsToAlpha()) {
             ch = true;
             // Can't point to self; impossible to compare, print, etc
@@ -468,19 +545,21 @@ SharedType PointerType::meetWith(SharedType other, bool &ch, bool bHighestPtr) c
     return createUnion(other, ch, bHighestPtr);
 }
 
-SharedType ArrayType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType ArrayType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     if (other->resolvesToVoid())
         return ((ArrayType *)this)->shared_from_this();
     if (other->resolvesToArray()) {
-        auto otherArr = other->asArray();
+        const ArrayType *otherArr = other->ptrAs<ArrayType>();
         SharedType newBase = BaseType->clone()->meetWith(otherArr->BaseType, ch, bHighestPtr);
         if (*newBase != *BaseType) {
             ch = true;
             Length = convertLength(newBase);
             BaseType = newBase; // No: call setBaseType to adjust length
+            layoutChanged();
         }
-        if (other->asArray()->getLength() < getLength()) {
-            Length = other->asArray()->getLength();
+        if (otherArr->getLength() < getLength()) {
+            Length = otherArr->getLength();
+            layoutChanged();
         }
         return std::const_pointer_cast<Type>(this->shared_from_this());
     }
@@ -523,7 +602,7 @@ SharedType ArrayType::meetWith(SharedType other, bool &ch, bool bHighestPtr) con
     return createUnion(other, ch, bHighestPtr);
 }
 
-SharedType NamedType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType NamedType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     SharedType rt = resolvesTo();
     if (rt) {
         SharedType ret = rt->meetWith(other, ch, bHighestPtr);
@@ -538,7 +617,7 @@ SharedType NamedType::meetWith(SharedType other, bool &ch, bool bHighestPtr) con
     return createUnion(other, ch, bHighestPtr);
 }
 
-SharedType CompoundType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType CompoundType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     if (other->resolvesToVoid())
         return ((CompoundType *)this)->shared_from_this();
     if (!other->resolvesToCompound()) {
@@ -570,14 +649,14 @@ SharedType CompoundType::meetWith(SharedType other, bool &ch, bool bHighestPtr)
 unsigned unionCount = 0;
 #endif
 
-SharedType UnionType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType UnionType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     if (other->resolvesToVoid())
         return ((UnionType *)this)->shared_from_this();
     if (other->resolvesToUnion()) {
         if (this == other.get())       // Note: pointer comparison
             return ((UnionType *)this)->shared_from_this(); // Avoid infinite recursion
 
-        auto otherUnion = other->as<UnionType>();
+        const UnionType *otherUnion = other->ptrAs<UnionType>();
         // Always return this, never other, (even if other is larger than this) because otherwise iterators can become
         // invalid below
         std::list<UnionElement>::iterator it;
@@ -589,7 +668,7 @@ SharedType UnionType::meetWith(SharedType other, bool &ch, bool bHighestPtr) con
     }
 
     // Other is a non union type
-    if (other->resolvesToPointer() && other->asPointer()->getPointsTo().get() == this) {
+    if (other->resolvesToPointer() && other->ptrAs<PointerType>()->getPointsTo().get() == this) {
         LOG << "WARNING! attempt to union " << getCtype() << " with pointer to self!\n";
         return ((UnionType *)this)->shared_from_this();
     }
@@ -639,6 +718,7 @@ SharedType UnionType::meetWith(SharedType other, bool &ch, bool bHighestPtr) con
     }
     if(best_meet_quality!=INT_MAX) {
         location_of_meet->type = best_so_far;
+        layoutChanged();
 //        qDebug() << getCtype();
         return ((UnionType *)this)->shared_from_this();
     }
@@ -657,15 +737,18 @@ SharedType UnionType::meetWith(SharedType other, bool &ch, bool bHighestPtr) con
     return ((UnionType *)this)->shared_from_this();
 }
 
-SharedType SizeType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType SizeType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     if (other->resolvesToVoid())
         return ((SizeType *)this)->shared_from_this();
     if (other->resolvesToSize()) {
-        if (other->asSize()->size != size) {
-            LOG << "size " << size << " meet with size " << other->asSize()->size << "!\n";
+        const SizeType *otherSize = other->ptrAs<SizeType>();
+        if (otherSize->size != size) {
+            LOG << "size " << size << " meet with size " << otherSize->size << "!\n";
             unsigned oldSize = size;
-            size = std::max(size, other->asSize()->size);
+            size = std::max(size, otherSize->size);
             ch = size != oldSize;
+            if (ch)
+                layoutChanged();
         }
         return ((SizeType *)this)->shared_from_this();
     }
@@ -682,15 +765,16 @@ SharedType SizeType::meetWith(SharedType other, bool &ch, bool bHighestPtr) cons
     return createUnion(other, ch, bHighestPtr);
 }
 
-SharedType UpperType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType UpperType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     if (other->resolvesToVoid())
         return ((UpperType *)this)->shared_from_this();
     if (other->resolvesToUpper()) {
-        auto otherUpp = other->asUpper();
+        const UpperType *otherUpp = other->ptrAs<UpperType>();
         auto newBase = base_type->clone()->meetWith(otherUpp->base_type, ch, bHighestPtr);
         if (*newBase != *base_type) {
             ch = true;
             base_type = newBase;
+            layoutChanged();
         }
         return ((UpperType *)this)->shared_from_this();
     }
@@ -698,15 +782,16 @@ SharedType UpperType::meetWith(SharedType other, bool &ch, bool bHighestPtr) con
     return createUnion(other, ch, bHighestPtr);
 }
 
-SharedType LowerType::meetWith(SharedType other, bool &ch, bool bHighestPtr) const {
+SharedType LowerType::meetWith(const SharedType &other, bool &ch, bool bHighestPtr) const {
     if (other->resolvesToVoid())
         return ((LowerType *)this)->shared_from_this();
     if (other->resolvesToUpper()) {
-        std::shared_ptr<LowerType> otherLow = other->asLower();
+        const LowerType *otherLow = other->ptrAs<LowerType>();
         SharedType newBase = base_type->clone()->meetWith(otherLow->base_type, ch, bHighestPtr);
         if (*newBase != *base_type) {
             ch = true;
             base_type = newBase;
+            layoutChanged();
         }
         return ((LowerType *)this)->shared_from_this();
     }
@@ -714,7 +799,7 @@ SharedType LowerType::meetWith(SharedType other, bool &ch, bool bHighestPtr) con
     return createUnion(other, ch, bHighestPtr);
 }
 
-SharedType Instruction::meetWithFor(SharedType ty, Exp *e, bool &ch) {
+SharedType Instruction::meetWithFor(const SharedType &ty, Exp *e, bool &ch) {
     bool thisCh = false;
     SharedType typeFor = getTypeFor(e);
     assert(typeFor);
@@ -726,7 +811,7 @@ SharedType Instruction::meetWithFor(SharedType ty, Exp *e, bool &ch) {
     return newType;
 }
 
-SharedType Type::createUnion(SharedType other, bool &ch, bool bHighestPtr /* = false */) const {
+SharedType Type::createUnion(const SharedType &other, bool &ch, bool bHighestPtr /* = false */) const {
 
     assert(!resolvesToUnion()); // `this' should not be a UnionType
     if (other->resolvesToUnion()) // Put all the hard union logic in one place
@@ -884,7 +969,7 @@ void BoolAssign::dfaTypeAnalysis(bool &ch) {
 //  beta*     bottom    void*    void*
 //  int        void*     int      pi
 //  pi         void*     pi       pi
-SharedType sigmaSum(SharedType ta, SharedType tb) {
+SharedType sigmaSum(const SharedType &ta, const SharedType &tb) {
     bool ch;
     if (ta->resolvesToPointer()) {
         if (tb->resolvesToPointer())
@@ -906,7 +991,7 @@ SharedType sigmaSum(SharedType ta, SharedType tb) {
 // alpha*    int        bottom    int
 // int        void*    int        pi
 // pi        pi        pi        pi
-SharedType sigmaAddend(SharedType tc, SharedType to) {
+SharedType sigmaAddend(const SharedType &tc, const SharedType &to) {
     bool ch;
     if (tc->resolvesToPointer()) {
         if (to->resolvesToPointer())
@@ -930,7 +1015,7 @@ SharedType sigmaAddend(SharedType tc, SharedType to) {
 // alpha*    bottom    void*    void*
 // int        void*    int        pi
 // pi        void*    int        pi
-SharedType deltaMinuend(SharedType tc, SharedType tb) {
+SharedType deltaMinuend(const SharedType &tc, const SharedType &tb) {
     bool ch;
     if (tc->resolvesToPointer()) {
         if (tb->resolvesToPointer())
@@ -952,7 +1037,7 @@ SharedType deltaMinuend(SharedType tc, SharedType tb) {
 // alpha*    int        void*    pi
 // int        bottom    int        int
 // pi        int        pi        pi
-SharedType deltaSubtrahend(SharedType tc, SharedType ta) {
+SharedType deltaSubtrahend(const SharedType &tc, const SharedType &ta) {
     bool ch;
     if (tc->resolvesToPointer()) {
         if (ta->resolvesToPointer())
@@ -975,7 +1060,7 @@ SharedType deltaSubtrahend(SharedType tc, SharedType ta) {
 // beta*    int        bottom    int
 // int        void*    int        pi
 // pi        pi        int        pi
-SharedType deltaDifference(SharedType ta, SharedType tb) {
+SharedType deltaDifference(const SharedType &ta, const SharedType &tb) {
     bool ch;
     if (ta->resolvesToPointer()) {
         if (tb->resolvesToPointer())
@@ -1393,10 +1478,57 @@ bool Signature::dfaTypeAnalysis(Cfg *cfg) {
 
 // Note: to prevent infinite recursion, CompoundType, ArrayType, and UnionType implement this function as a delegation
 // to isCompatible()
+namespace {
+/**
+ * The results of isCompatibleWith() for pairs of composite types during one outermost call. Checking compatibility
+ * changes no type, so they stay valid until that call returns; but meetWith() and the setters change types in place,
+ * so nothing is kept beyond it. Pays off for unions, where the same pairs of members (e.g. pointers to one struct)
+ * are compared again for every pair of elements.
+ */
+struct CompatMemo {
+    struct Entry {
+        const Type *a, *b;
+        bool all, result;
+    };
+    static const size_t MAX_ENTRIES = 64; //!< Looked up linearly; a query big enough to need more just recomputes
+    std::vector<Entry> entries;
+
+    const Entry *find(const Type *a, const Type *b, bool all) const {
+        for (const Entry &e : entries)
+            if (e.a == a && e.b == b && e.all == all)
+                return &e;
+        return nullptr;
+    }
+};
+thread_local CompatMemo *compatMemo = nullptr;
+
+bool isComposite(const Type &t) {
+    return t.resolvesToCompound() || t.resolvesToArray() || t.resolvesToUnion() || t.resolvesToPointer();
+}
+}
+
 bool Type::isCompatibleWith(const Type &other, bool all /* = false */) const {
+    if (this == &other)
+        return true; // E.g. the shared void, char and bool types
+    bool memoise = isComposite(*this) && isComposite(other);
+    CompatMemo memo;
+    bool outermost = memoise && compatMemo == nullptr;
+    if (outermost)
+        compatMemo = &memo;
+    if (memoise && compatMemo) {
+        if (const CompatMemo::Entry *e = compatMemo->find(this, &other, all))
+            return e->result;
+    }
+    bool result;
     if (other.resolvesToCompound() || other.resolvesToArray() || other.resolvesToUnion())
-        return other.isCompatible(*this, all);
-    return isCompatible(other, all);
+        result = other.isCompatible(*this, all);
+    else
+        result = isCompatible(other, all);
+    if (memoise && compatMemo && compatMemo->entries.size() < CompatMemo::MAX_ENTRIES)
+        compatMemo->entries.push_back(CompatMemo::Entry{this, &other, all, result});
+    if (outermost)
+        compatMemo = nullptr;
+    return result;
 }
 
 bool VoidType::isCompatible(const Type &/*other*/, bool /*all*/) const {
@@ -1596,7 +1728,7 @@ bool LowerType::isCompatible(const Type &other, bool /*all*/) const {
     return false;
 }
 
-bool Type::isSubTypeOrEqual(SharedType other) {
+bool Type::isSubTypeOrEqual(const SharedType &other) {
     if (resolvesToVoid())
         return true;
     if (*this == *other)
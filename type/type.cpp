@@ -25,11 +25,14 @@
 #include "log.h"
 
 #include <QtCore/QDebug>
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
-extern char debug_buffer[]; // For prints functions
+extern thread_local char debug_buffer[]; // For prints functions
 QMap<QString, SharedType > Type::namedTypes;
+std::atomic<unsigned> Type::layoutVersion(0);
+std::function<bool(const QString &)> Type::namedTypeResolver;
 //QMap<QString, SharedType > Type::namedTypes;
 
 bool Type::isCString() {
@@ -44,7 +47,33 @@ bool Type::isCString() {
     return p->resolvesToChar();
 }
 
-Type::Type(eType _id) : id(_id) {}
+//! The size of the object of a type with id \a id, for MemStats (types are made with std::make_shared, so the class
+//! operator new that counts the other IR objects is not used for them)
+static size_t typeSize(eType id) {
+    switch (id) {
+    case eVoid: return sizeof(VoidType);
+    case eFunc: return sizeof(FuncType);
+    case eBoolean: return sizeof(BooleanType);
+    case eChar: return sizeof(CharType);
+    case eInteger: return sizeof(IntegerType);
+    case eFloat: return sizeof(FloatType);
+    case ePointer: return sizeof(PointerType);
+    case eArray: return sizeof(ArrayType);
+    case eNamed: return sizeof(NamedType);
+    case eCompound: return sizeof(CompoundType);
+    case eUnion: return sizeof(UnionType);
+    case eSize: return sizeof(SizeType);
+    case eUpper: return sizeof(UpperType);
+    case eLower: return sizeof(LowerType);
+    }
+    return sizeof(Type);
+}
+
+Type::Type(eType _id) : id(_id) { MemStats::allocated(MemStats::mkType, typeSize(id)); }
+
+Type::Type(const Type &other) : std::enable_shared_from_this<Type>(), Printable(other), id(other.id) {
+    MemStats::allocated(MemStats::mkType, typeSize(id));
+}
 
 VoidType::VoidType() : Type(eVoid) {}
 
@@ -100,6 +129,7 @@ void ArrayType::setBaseType(SharedType b) {
         Length = baseSize / newSize; // Preserve same byte size for array
     }
     BaseType = b;
+    layoutChanged();
 }
 
 NamedType::NamedType(const QString &_name) : Type(eNamed), name(_name) {}
@@ -109,7 +139,7 @@ CompoundType::CompoundType(bool is_generic /* = false */)
 
 UnionType::UnionType() : Type(eUnion) {}
 
-Type::~Type() {}
+Type::~Type() { MemStats::freed(MemStats::mkType, typeSize(id)); }
 VoidType::~VoidType() {}
 FuncType::~FuncType() {}
 // IntegerType::~IntegerType() { }
@@ -126,6 +156,21 @@ NamedType::~NamedType() {}
 CompoundType::~CompoundType() {}
 UnionType::~UnionType() {}
 
+// The types without any state of their own are shared: one object each, so that getting one allocates nothing and
+// comparing two is usually comparing a pointer with itself. The others (integers, floats, sizes, pointers...) are
+// updated in place by meetWith() and friends, so every user needs its own.
+std::shared_ptr<VoidType> VoidType::get() {
+    static std::shared_ptr<VoidType> instance = std::make_shared<VoidType>();
+    return instance;
+}
+std::shared_ptr<BooleanType> BooleanType::get() {
+    static std::shared_ptr<BooleanType> instance = std::make_shared<BooleanType>();
+    return instance;
+}
+std::shared_ptr<CharType> CharType::get() {
+    static std::shared_ptr<CharType> instance = std::make_shared<CharType>();
+    return instance;
+}
 std::shared_ptr<IntegerType> IntegerType::get(unsigned NumBits, int sign) { return std::make_shared<IntegerType>(NumBits, sign); }
 /***************************************************************************/ /**
   *
@@ -137,7 +182,7 @@ SharedType IntegerType::clone() const { return IntegerType::get(size, signedness
 SharedType FloatType::clone() const { return FloatType::get(size); }
 
 SharedType BooleanType::clone() const {
-    return std::make_shared<BooleanType>();
+    return BooleanType::get();
 }
 
 SharedType CharType::clone() const {
@@ -210,11 +255,8 @@ size_t NamedType::getSize() const {
     return 0; // don't know
 }
 size_t CompoundType::getSize() const {
-    int n = 0;
-    for (auto &elem : types)
-        // NOTE: this assumes no padding... perhaps explicit padding will be needed
-        n += elem->getSize();
-    return n;
+    // NOTE: this assumes no padding... perhaps explicit padding will be needed
+    return getOffsets().back();
 }
 size_t UnionType::getSize() const {
     int max = 0;
@@ -228,98 +270,96 @@ size_t UnionType::getSize() const {
 }
 size_t SizeType::getSize() const { return size; }
 
+/***************************************************************************/ /**
+  * \brief   The bit offset of each member, followed by the size of the whole structure
+  *
+  * Structures from the signature files have hundreds of members, so the offsets are kept rather than summed on every
+  * lookup, together with an index of the member names. Member types are shared and are changed in place (meetWith
+  * grows integers and arrays, unions gain elements, a typedef gets defined), so the offsets are rebuilt whenever
+  * Type::layoutChanged() has been called since they were computed, not just when the members of this structure change.
+  ******************************************************************************/
+const std::vector<unsigned> &CompoundType::getOffsets() const {
+    if (!offsets.empty() && offsetsVersion == getLayoutVersion())
+        return offsets;
+    offsets.clear();
+    nameIndex.clear();
+    offsets.reserve(types.size() + 1);
+    unsigned offset = 0;
+    for (unsigned i = 0; i < types.size(); i++) {
+        offsets.push_back(offset);
+        nameIndex.insert(std::make_pair(names[i], i)); // keeps the first of duplicate names
+        offset += types[i]->getSize();
+    }
+    offsets.push_back(offset);
+    offsetsVersion = getLayoutVersion();
+    return offsets;
+}
+
+//! \returns the index of the member covering bit offset \a n, or -1 if there is none
+int CompoundType::findMemberAt(unsigned n) const {
+    const std::vector<unsigned> &offs(getOffsets());
+    // The first member starting after n, less one; zero sized members (e.g. empty arrays) are skipped this way
+    auto it = std::upper_bound(offs.begin(), offs.end() - 1, n);
+    if (it == offs.begin())
+        return -1;
+    unsigned i = (it - offs.begin()) - 1;
+    return n < offs[i + 1] ? (int)i : -1;
+}
+
 SharedType CompoundType::getType(const QString &nam) {
-    for (unsigned i = 0; i < types.size(); i++)
-        if (names[i] == nam)
-            return types[i];
-    return nullptr;
+    getOffsets();
+    auto it = nameIndex.find(nam);
+    return it == nameIndex.end() ? nullptr : types[it->second];
 }
 
 // Note: n is a BIT offset
 SharedType CompoundType::getTypeAtOffset(unsigned n) {
-    unsigned offset = 0;
-    for (auto &elem : types) {
-        if (offset <= n && n < offset + elem->getSize())
-            return elem;
-        offset += elem->getSize();
-    }
-    return nullptr;
+    int i = findMemberAt(n);
+    return i < 0 ? nullptr : types[i];
 }
 
 // Note: n is a BIT offset
 void CompoundType::setTypeAtOffset(unsigned n, SharedType ty) {
-    unsigned offset = 0;
-    for (unsigned i = 0; i < types.size(); i++) {
-        if (offset <= n && n < offset + types[i]->getSize()) {
-            unsigned oldsz = types[i]->getSize();
-            types[i] = ty;
-            if (ty->getSize() < oldsz) {
-                types.push_back(types[types.size() - 1]);
-                names.push_back(names[names.size() - 1]);
-                for (size_t _n = types.size() - 1; _n > i; _n--) {
-                    types[_n] = types[_n - 1];
-                    names[_n] = names[_n - 1];
-                }
-                types[i + 1] = SizeType::get(oldsz - ty->getSize());
-                names[i + 1] = "pad";
-            }
-            return;
-        }
-        offset += types[i]->getSize();
+    int i = findMemberAt(n);
+    if (i < 0)
+        return;
+    unsigned oldsz = types[i]->getSize();
+    types[i] = ty;
+    if (ty->getSize() < oldsz) {
+        types.insert(types.begin() + i + 1, SizeType::get(oldsz - ty->getSize()));
+        names.insert(names.begin() + i + 1, "pad");
     }
+    layoutChanged(); // Structures that have this one as a member may be affected too
 }
 
 void CompoundType::setNameAtOffset(unsigned n, const QString &nam) {
-    unsigned offset = 0;
-    for (unsigned i = 0; i < types.size(); i++) {
-        if (offset <= n && n < offset + types[i]->getSize()) {
-            names[i] = nam;
-            return;
-        }
-        offset += types[i]->getSize();
-    }
+    int i = findMemberAt(n);
+    if (i < 0)
+        return;
+    names[i] = nam;
+    invalidateOffsets();
 }
 
 QString CompoundType::getNameAtOffset(size_t n) {
-    unsigned offset = 0;
-    for (unsigned i = 0; i < types.size(); i++) {
-        // if (offset >= n && n < offset + types[i]->getSize())
-        if (offset <= n && n < offset + types[i]->getSize())
-            // return getName(offset == n ? i : i - 1);
-            return names[i];
-        offset += types[i]->getSize();
-    }
-    return nullptr;
+    int i = findMemberAt(n);
+    return i < 0 ? nullptr : names[i];
 }
 
 unsigned CompoundType::getOffsetTo(unsigned n) {
-    unsigned offset = 0;
-    for (unsigned i = 0; i < n; i++) {
-        offset += types[i]->getSize();
-    }
-    return offset;
+    return getOffsets()[std::min<size_t>(n, types.size())];
 }
 
 unsigned CompoundType::getOffsetTo(const QString &member) {
-    unsigned offset = 0;
-    for (unsigned i = 0; i < types.size(); i++) {
-        if (names[i] == member)
-            return offset;
-        offset += types[i]->getSize();
-    }
-    return (unsigned)-1;
+    getOffsets();
+    auto it = nameIndex.find(member);
+    return it == nameIndex.end() ? (unsigned)-1 : offsets[it->second];
 }
 
 unsigned CompoundType::getOffsetRemainder(unsigned n) {
-    unsigned r = n;
-    unsigned offset = 0;
-    for (auto &elem : types) {
-        offset += elem->getSize();
-        if (offset > n)
-            break;
-        r -= elem->getSize();
-    }
-    return r;
+    int i = findMemberAt(n);
+    if (i < 0)
+        return n - getOffsets().back(); // Past the end: what remains after the last member
+    return n - offsets[i];
 }
 
 /***************************************************************************/ /**
@@ -389,6 +429,8 @@ bool ArrayType::operator==(const Type &other) const {
 bool NamedType::operator==(const Type &other) const { return other.isNamed() && (name == ((NamedType &)other).name); }
 
 bool CompoundType::operator==(const Type &other) const {
+    if (this == &other)
+        return true;
     const CompoundType &cother = (CompoundType &)other;
     if (other.isCompound() && cother.types.size() == types.size()) {
         for (unsigned i = 0; i < types.size(); i++)
@@ -400,6 +442,8 @@ bool CompoundType::operator==(const Type &other) const {
 }
 
 bool UnionType::operator==(const Type &other) const {
+    if (this == &other)
+        return true;
     const UnionType &uother = (UnionType &)other;
     std::list<UnionElement>::const_iterator it1, it2;
     if (other.isUnion() && uother.li.size() == li.size()) {
@@ -797,6 +841,7 @@ void Type::dump() {
 
 // named type accessors
 void Type::addNamedType(const QString &name, SharedType type) {
+    layoutChanged();
     if (namedTypes.find(name) != namedTypes.end()) {
         if (!(*type == *namedTypes[name])) {
             // LOG << "addNamedType: name " << name << " type " << type->getCtype() << " != " <<
@@ -823,11 +868,20 @@ void Type::addNamedType(const QString &name, SharedType type) {
 
 SharedType Type::getNamedType(const QString &name) {
     auto iter= namedTypes.find(name);
-    if (iter == namedTypes.end())
-        return nullptr;
+    if (iter == namedTypes.end()) {
+        // The resolver may know where the type is defined, e.g. a signature file that has not been read yet
+        if (!namedTypeResolver || !namedTypeResolver(name))
+            return nullptr;
+        iter = namedTypes.find(name);
+        if (iter == namedTypes.end())
+            return nullptr;
+    }
     return *iter;
 }
 
+//! The names of all the named types defined so far
+QStringList Type::getNamedTypeNames() { return namedTypes.keys(); }
+
 void Type::dumpNames() {
     for (auto it = namedTypes.begin(); it != namedTypes.end(); ++it)
         qDebug() << it.key() << " -> " << it.value()->getCtype() << "\n";
@@ -960,9 +1014,10 @@ SharedType NamedType::resolvesTo() const {
 }
 
 void ArrayType::fixBaseType(SharedType b) {
-    if (BaseType == nullptr)
+    if (BaseType == nullptr) {
         BaseType = b;
-    else {
+        layoutChanged();
+    } else {
         assert(BaseType->isArray());
         BaseType->asArray()->fixBaseType(b);
     }
@@ -1434,15 +1489,13 @@ void DataIntervalMap::deleteItem(ADDRESS addr) {
 void DataIntervalMap::dump() { LOG_STREAM() << prints(); }
 
 char *DataIntervalMap::prints() {
-    QString tgt;
-    QTextStream ost(&tgt);
+    TextScratch tgt;
+    QTextStream &ost(tgt.stream());
     iterator it;
     for (it = dimap.begin(); it != dimap.end(); ++it)
         ost << "0x" << it->first << "-0x" << it->first+it->second.type->getBytes() << " " << it->second.name << " " << it->second.type->getCtype()
             << "\n";
-    strncpy(debug_buffer, qPrintable(tgt), DEBUG_BUFSIZE - 1);
-    debug_buffer[DEBUG_BUFSIZE - 1] = '\0';
-    return debug_buffer;
+    return tgt.copyTo(debug_buffer, DEBUG_BUFSIZE);
 }
 
 ComplexTypeCompList &Type::compForAddress(ADDRESS addr, DataIntervalMap &dim) {
@@ -1485,6 +1538,7 @@ void UnionType::addType(SharedType n, const QString &str) {
         auto utp = std::static_pointer_cast<UnionType>(n);
         // Note: need to check for name clashes eventually
         li.insert(li.end(), utp->li.begin(), utp->li.end());
+        layoutChanged();
     } else {
         if (n->isPointer() && n->asPointer()->getPointsTo().get() == this) { // Note: pointer comparison
             n = PointerType::get(VoidType::get());
@@ -1494,6 +1548,7 @@ void UnionType::addType(SharedType n, const QString &str) {
         ue.type = n;
         ue.name = str;
         li.push_back(ue);
+        layoutChanged();
     }
 }
 
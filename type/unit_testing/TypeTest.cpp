@@ -125,6 +125,37 @@ void TypeTest::testCompound() {
     delete pFE;
 }
 
+/***************************************************************************/ /**
+  * \fn        TypeTest::testCompoundMemberGrows
+  * OVERVIEW:        Test that the member offsets of a structure follow a member that grows in place
+  ******************************************************************************/
+void TypeTest::testCompoundMemberGrows() {
+    auto inner = CompoundType::get();
+    inner->addType(IntegerType::get(32, 1), "x");
+    auto pad = SizeType::get(16);
+    auto outer = CompoundType::get();
+    outer->addType(pad, "pad");
+    outer->addType(inner, "s");
+    outer->addType(IntegerType::get(32, 1), "y");
+    QCOMPARE(outer->getOffsetTo("y"), 48U);
+    QCOMPARE(outer->getNameAtOffset(40), QString("s"));
+
+    // A meet grows the first member in place
+    bool ch = false;
+    pad->meetWith(SizeType::get(32), ch);
+    QVERIFY(ch);
+    QCOMPARE(outer->getOffsetTo("y"), 64U);
+    QCOMPARE(outer->getNameAtOffset(40), QString("s"));
+    QCOMPARE(outer->getOffsetTo(1), 32U);
+
+    // So does a new member of a member
+    inner->addType(IntegerType::get(32, 1), "z");
+    QCOMPARE(outer->getOffsetTo("y"), 96U);
+    QCOMPARE(outer->getNameAtOffset(80), QString("s"));
+    QCOMPARE(outer->getTypeAtOffset(96)->getSize(), (size_t)32);
+    QCOMPARE(outer->getSize(), (size_t)128);
+}
+
 /***************************************************************************/ /**
   * \fn        TypeTest::testDataInterval
   * OVERVIEW:        Test the DataIntervalMap class
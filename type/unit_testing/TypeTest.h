@@ -6,6 +6,7 @@ private slots:
     void testTypeLong();
     void testNotEqual();
     void testCompound();
+    void testCompoundMemberGrows();
 
     void testDataInterval();
     void testDataIntervalOverlaps();
@@ -8,6 +8,10 @@
 #include "proc.h"
 #include "signature.h"
 #include "module.h"
+#include "cfg.h"
+#include "basicblock.h"
+#include "rtl.h"
+#include "statement.h"
 
 #include <QtWidgets>
 #include <QtCore>
@@ -65,6 +69,9 @@ void Decompiler::setNoDecodeChildren(bool d) { Boomerang::get()->noDecodeChildre
 void Decompiler::addEntryPoint(ADDRESS a, const char *nam) {
     user_entrypoints.push_back(a);
     fe->AddSymbol(a, nam);
+    QMutexLocker locker(&editsMutex);
+    newEntrypoints.push_back(a);
+    queueEdits();
 }
 
 void Decompiler::removeEntryPoint(ADDRESS a) {
@@ -138,6 +145,7 @@ void Decompiler::load() {
 
 void Decompiler::decode() {
     emit decoding();
+    decodedInsns = decodedBytes = 0;
 
     bool gotMain;
     ADDRESS a = fe->getMainEntryPoint(gotMain);
@@ -151,7 +159,7 @@ void Decompiler::decode() {
         prog->decodeEntryPoint(user_entrypoints[i]);
     }
 
-    if (!Boomerang::get()->noDecodeChildren) {
+    if (!Boomerang::get()->noDecodeChildren && !Boomerang::get()->lazyDecode) {
         // decode anything undecoded
         fe->decode(prog, NO_ADDRESS);
     }
@@ -163,10 +171,55 @@ void Decompiler::decode() {
 
 void Decompiler::decompile() {
     emit decompiling();
+    {
+        QMutexLocker locker(&requestsMutex);
+        cancelledProcs.clear();
+        anyCancelled = false;
+    }
 
     prog->decompile();
+    {
+        // Edits made while decompiling were to what it has decompiled since
+        QMutexLocker locker(&editsMutex);
+        decompiled = true;
+        newEntrypoints.clear();
+        libSignaturesChanged = false;
+    }
+
+    emit decompileCompleted();
+}
 
+//! Have applyEdits() run on the decompiler's thread once it is free, if the program is decompiled. Called with
+//! editsMutex held.
+void Decompiler::queueEdits() {
+    if (decompiled)
+        QMetaObject::invokeMethod(this, "applyEdits", Qt::QueuedConnection);
+}
+
+/***************************************************************************/ /**
+  * \brief   Bring the decompiled program up to date with the edits made since, decompiling again only the procs
+  * they affect (see Prog::redecompileStale()), and generate the code again
+  ******************************************************************************/
+void Decompiler::applyEdits() {
+    std::vector<ADDRESS> entries;
+    bool reread;
+    {
+        QMutexLocker locker(&editsMutex);
+        entries.swap(newEntrypoints);
+        reread = libSignaturesChanged;
+        libSignaturesChanged = false;
+    }
+    if (entries.empty() && !reread)
+        return; // Applied with the edits queued before
+    emit decompiling();
+    if (reread)
+        prog->rereadLibSignatures();
+    for (ADDRESS a : entries)
+        prog->decodeEntryPoint(a);
+    std::vector<UserProc *> redone = prog->redecompileStale();
+    LOG_VERBOSE(1) << redone.size() << " procs decompiled again after edits\n";
     emit decompileCompleted();
+    generateCode();
 }
 
 void Decompiler::emitClusterAndChildren(Module *root) {
@@ -224,6 +277,39 @@ void Decompiler::alertConsidering(Function *parent, Function *p) {
 
 void Decompiler::alertDecompiling(UserProc *p) { emit decompilingProc(p->getName()); }
 
+void Decompiler::alertEndDecompile(UserProc *p) { emit decompiledProc(p->getName()); }
+
+//! Decompile \a name, and what it calls, before the other procs not started yet
+void Decompiler::preferProc(const QString &name) {
+    QMutexLocker locker(&requestsMutex);
+    preferredProcs.push_back(name);
+}
+
+//! Finish the decompilation of \a name at the stage it has reached
+void Decompiler::cancelProc(const QString &name) {
+    QMutexLocker locker(&requestsMutex);
+    cancelledProcs.insert(name);
+    anyCancelled = true;
+}
+
+UserProc *Decompiler::takePreferredProc() {
+    QMutexLocker locker(&requestsMutex);
+    while (!preferredProcs.empty()) {
+        Function *p = prog->findProc(preferredProcs.front());
+        preferredProcs.pop_front();
+        if (p && !p->isLib())
+            return (UserProc *)p;
+    }
+    return nullptr;
+}
+
+bool Decompiler::isCancelled(UserProc *p) {
+    if (!anyCancelled)
+        return false;
+    QMutexLocker locker(&requestsMutex);
+    return cancelledProcs.count(p->getName()) != 0;
+}
+
 void Decompiler::alertNew(Function *p) {
     if (p->isLib()) {
         QString params;
@@ -255,16 +341,71 @@ void Decompiler::alertRemove(Function *p) {
 
 void Decompiler::alertUpdateSignature(Function *p) { alertNew(p); }
 
-bool Decompiler::getRtlForProc(const QString &name, QString &rtl) {
+void Decompiler::alertDecodeProgress(int numInsns, int numBytes) {
+    decodedInsns += numInsns;
+    decodedBytes += numBytes;
+    emit decodeProgress(decodedInsns, decodedBytes);
+}
+
+UserProc *Decompiler::findUserProc(const QString &name) {
     Function *p = prog->findProc(name);
-    if (p->isLib())
+    if (p == nullptr || p->isLib())
+        return nullptr;
+    return (UserProc *)p;
+}
+
+//! The HTML for what comes before the BBs of \a name (see UserProc::printSummary)
+bool Decompiler::getRtlHeaderForProc(const QString &name, QString &rtl) {
+    UserProc *up = findUserProc(name);
+    if (up == nullptr)
         return false;
-    UserProc *up = (UserProc *)p;
     QTextStream os(&rtl);
-    up->print(os, true);
+    up->printSummary(os, true);
     return true;
 }
 
+/***************************************************************************/ /**
+  *
+  * \brief Append the HTML for the BBs of \a name numbered \a first to \a first + \a count - 1, in the order of the CFG,
+  * to \a rtl. The RTL editor shows a proc a few BBs at a time, as they are scrolled into view.
+  * \returns the number of BBs appended; fewer than \a count once the last BB is reached
+  *
+  ******************************************************************************/
+int Decompiler::getRtlBlocksForProc(const QString &name, int first, int count, QString &rtl) {
+    UserProc *up = findUserProc(name);
+    if (up == nullptr || up->getCFG() == nullptr)
+        return 0;
+    QTextStream os(&rtl);
+    int n = 0, done = 0;
+    for (BasicBlock *bb : *up->getCFG()) {
+        if (n++ < first)
+            continue;
+        if (done == count)
+            break;
+        bb->print(os, true);
+        done++;
+    }
+    return done;
+}
+
+//! \returns the number of the BB of \a name (as for getRtlBlocksForProc) with statement \a number, or -1 if none has
+int Decompiler::getRtlBlockOfStmt(const QString &name, int number) {
+    UserProc *up = findUserProc(name);
+    if (up == nullptr || up->getCFG() == nullptr)
+        return -1;
+    int n = 0;
+    for (BasicBlock *bb : *up->getCFG()) {
+        if (bb->getRTLs()) {
+            for (RTL *rtl : *bb->getRTLs())
+                for (Instruction *s : *rtl)
+                    if (s->getNumber() == number)
+                        return n;
+        }
+        n++;
+    }
+    return -1;
+}
+
 void Decompiler::alertDecompileDebugPoint(UserProc *p, const char *description) {
     LOG << p->getName() << ": " << description << "\n";
     if (Debugging) {
@@ -292,12 +433,24 @@ QString Decompiler::getClusterFile(const QString &name) {
     return c->getOutPath("c");
 }
 
-void Decompiler::rereadLibSignatures() { prog->rereadLibSignatures(); }
+void Decompiler::rereadLibSignatures() {
+    QMutexLocker locker(&editsMutex);
+    if (!decompiled) {
+        prog->rereadLibSignatures();
+        return;
+    }
+    libSignaturesChanged = true;
+    queueEdits();
+}
 
 void Decompiler::renameProc(const QString &oldName, const QString &newName) {
     Function *p = prog->findProc(oldName);
     if (p)
         p->setName(newName);
+    // Nothing decompiled depends on the name, but the code does
+    QMutexLocker locker(&editsMutex);
+    if (p && decompiled)
+        QMetaObject::invokeMethod(this, "generateCode", Qt::QueuedConnection);
 }
 
 void Decompiler::getCompoundMembers(const QString &name, QTableWidget *tbl) {
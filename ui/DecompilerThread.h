@@ -2,6 +2,10 @@
 #include <QThread>
 #include <QString>
 #include <QTableWidget>
+#include <QMutex>
+#include <atomic>
+#include <deque>
+#include <set>
 
 #undef NO_ADDRESS
 #include "../include/boomerang.h"
@@ -27,8 +31,14 @@ class Decompiler : public QObject, public Watcher {
     virtual void alertNew(Function *p) override;
     virtual void alertRemove(Function *p) override;
     virtual void alertUpdateSignature(Function *p) override;
-
-    bool getRtlForProc(const QString &name, QString &rtl);
+    virtual void alertDecodeProgress(int numInsns, int numBytes) override;
+    virtual void alertEndDecompile(UserProc *p) override;
+    virtual UserProc *takePreferredProc() override;
+    virtual bool isCancelled(UserProc *p) override;
+
+    bool getRtlHeaderForProc(const QString &name, QString &rtl);
+    int getRtlBlocksForProc(const QString &name, int first, int count, QString &rtl);
+    int getRtlBlockOfStmt(const QString &name, int number);
     QString getSigFile(const QString &name);
     QString getClusterFile(const QString &name);
     void renameProc(const QString &oldName, const QString &newName);
@@ -42,6 +52,10 @@ class Decompiler : public QObject, public Watcher {
     void addEntryPoint(ADDRESS a, const char *nam);
     void removeEntryPoint(ADDRESS a);
 
+    // Called from the GUI thread while decompile() runs
+    void preferProc(const QString &name);
+    void cancelProc(const QString &name);
+
   public slots:
     void changeInputFile(const QString &f);
     void changeOutputPath(const QString &path);
@@ -49,6 +63,7 @@ class Decompiler : public QObject, public Watcher {
     void decode();
     void decompile();
     void generateCode();
+    void applyEdits();
     void stopWaiting();
 
   signals:
@@ -63,6 +78,8 @@ class Decompiler : public QObject, public Watcher {
 
     void consideringProc(const QString &parent, const QString &name);
     void decompilingProc(const QString &name);
+    void decompiledProc(const QString &name);
+    void decodeProgress(int numInsns, int numBytes); //!< Totals so far
     void newUserProc(const QString &name, ADDRESS addr);
     void newLibProc(const QString &name, const QString &params);
     void removeUserProc(const QString &name, ADDRESS addr);
@@ -78,6 +95,7 @@ class Decompiler : public QObject, public Watcher {
 
   protected:
     bool Debugging, Waiting;
+    int decodedInsns = 0, decodedBytes = 0;
 
     FrontEnd *fe;
     Prog *prog;
@@ -85,9 +103,22 @@ class Decompiler : public QObject, public Watcher {
     QString filename;
 
     const char *procStatus(UserProc *p);
+    UserProc *findUserProc(const QString &name);
     void emitClusterAndChildren(Module *root);
 
     std::vector<ADDRESS> user_entrypoints;
+
+    QMutex requestsMutex;                   //!< Guards preferredProcs and cancelledProcs
+    std::deque<QString> preferredProcs;     //!< Procs the user wants decompiled next, oldest request first
+    std::set<QString> cancelledProcs;
+    std::atomic<bool> anyCancelled{false}; //!< So that isCancelled() need not lock while nothing is cancelled
+
+    // Edits made once the program is decompiled, which applyEdits() decompiles again what they affect for
+    bool decompiled = false;              //!< Set by decompile()
+    QMutex editsMutex;                     //!< Guards the edits below
+    std::vector<ADDRESS> newEntrypoints;   //!< Added since decompile()
+    bool libSignaturesChanged = false;     //!< The signature files were saved since decompile()
+    void queueEdits();
 };
 
 class DecompilerThread : public QThread {
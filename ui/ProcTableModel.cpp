@@ -0,0 +1,173 @@
+#include "ProcTableModel.h"
+
+//! How long new rows wait to be shown, so that they are inserted into the view in batches
+static const int PENDING_ROWS_DELAY_MS = 100;
+
+ProcTableModel::ProcTableModel(const QStringList &headers, QObject *parent)
+    : QAbstractTableModel(parent), headers(headers) {
+    pendingTimer.setSingleShot(true);
+    pendingTimer.setInterval(PENDING_ROWS_DELAY_MS);
+    connect(&pendingTimer, SIGNAL(timeout()), this, SLOT(showPending()));
+}
+
+int ProcTableModel::rowCount(const QModelIndex &parent) const { return parent.isValid() ? 0 : shown; }
+
+int ProcTableModel::columnCount(const QModelIndex &parent) const {
+    if (parent.isValid())
+        return 0;
+    return headers.size() + (checkShown ? 1 : 0);
+}
+
+QVariant ProcTableModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= shown)
+        return QVariant();
+    const Row &row = rows[index.row()];
+    if (index.column() < headers.size()) {
+        if (role == Qt::DisplayRole || role == Qt::EditRole)
+            return row.texts[index.column()];
+    } else if (role == Qt::CheckStateRole)
+        return row.checked ? Qt::Checked : Qt::Unchecked;
+    return QVariant();
+}
+
+QVariant ProcTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+    if (section < headers.size())
+        return headers[section];
+    return checkHeader;
+}
+
+Qt::ItemFlags ProcTableModel::flags(const QModelIndex &index) const {
+    if (!index.isValid())
+        return Qt::NoItemFlags;
+    Qt::ItemFlags res = Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+    if (index.column() == editableColumn)
+        res |= Qt::ItemIsEditable;
+    if (index.column() == headers.size())
+        res |= Qt::ItemIsUserCheckable;
+    return res;
+}
+
+bool ProcTableModel::setData(const QModelIndex &index, const QVariant &value, int role) {
+    if (!index.isValid() || index.row() >= shown)
+        return false;
+    Row &row = rows[index.row()];
+    if (index.column() == headers.size() && role == Qt::CheckStateRole) {
+        row.checked = value.toInt() == Qt::Checked;
+        emit dataChanged(index, index);
+        return true;
+    }
+    if (index.column() != editableColumn || role != Qt::EditRole)
+        return false;
+    QString oldText = row.texts[index.column()];
+    QString newText = value.toString();
+    if (newText == oldText)
+        return false;
+    setText(index.row(), index.column(), newText);
+    emit textEdited(oldText, newText);
+    return true;
+}
+
+//! Give the table a column of check boxes, titled \a header, after its text columns. New rows are checked
+void ProcTableModel::setCheckColumn(const QString &header) { checkHeader = header; }
+
+void ProcTableModel::showCheckColumn(bool show) {
+    if (show == checkShown || checkHeader.isEmpty())
+        return;
+    if (show) {
+        beginInsertColumns(QModelIndex(), headers.size(), headers.size());
+        checkShown = true;
+        endInsertColumns();
+    } else {
+        beginRemoveColumns(QModelIndex(), headers.size(), headers.size());
+        checkShown = false;
+        endRemoveColumns();
+    }
+}
+
+//! Keep the rows hashed by the text in \a column, for findRow(). Must be called while the table is empty
+void ProcTableModel::addIndex(int column) {
+    Q_ASSERT(rows.isEmpty());
+    indexes[column];
+}
+
+//! \returns the row (shown or not) whose text in the indexed \a column is \a text, or -1 if there is none
+int ProcTableModel::findRow(int column, const QString &text) const {
+    Q_ASSERT(indexes.contains(column));
+    return indexes[column].value(text, -1);
+}
+
+//! Add a row with the given texts of its columns; it is shown with the next batch of new rows
+void ProcTableModel::addRow(const QStringList &texts) {
+    Q_ASSERT(texts.size() == headers.size());
+    Row row;
+    row.texts = texts;
+    row.checked = true;
+    for (auto it = indexes.begin(); it != indexes.end(); ++it)
+        it.value().insert(texts[it.key()], rows.size());
+    rows.append(row);
+    if (!pendingTimer.isActive())
+        pendingTimer.start();
+}
+
+void ProcTableModel::setText(int row, int column, const QString &text) {
+    Row &r = rows[row];
+    auto idx = indexes.find(column);
+    if (idx != indexes.end()) {
+        idx.value().remove(r.texts[column]);
+        idx.value().insert(text, row);
+    }
+    r.texts[column] = text;
+    if (row < shown) {
+        QModelIndex changed = index(row, column);
+        emit dataChanged(changed, changed);
+    }
+}
+
+void ProcTableModel::removeRow(int row) {
+    for (auto it = indexes.begin(); it != indexes.end(); ++it)
+        it.value().remove(rows[row].texts[it.key()]);
+    if (row < shown) {
+        beginRemoveRows(QModelIndex(), row, row);
+        rows.remove(row);
+        --shown;
+        endRemoveRows();
+    } else
+        rows.remove(row);
+    reindexFrom(row);
+}
+
+//! The rows from \a row on have moved up one
+void ProcTableModel::reindexFrom(int row) {
+    for (auto it = indexes.begin(); it != indexes.end(); ++it)
+        for (int i = row; i < rows.size(); i++)
+            it.value()[rows[i].texts[it.key()]] = i;
+}
+
+//! Flip the check box of every row
+void ProcTableModel::toggleChecks() {
+    for (Row &row : rows)
+        row.checked = !row.checked;
+    if (checkShown && shown > 0)
+        emit dataChanged(index(0, headers.size()), index(shown - 1, headers.size()));
+}
+
+void ProcTableModel::clear() {
+    pendingTimer.stop();
+    beginResetModel();
+    rows.clear();
+    shown = 0;
+    for (auto it = indexes.begin(); it != indexes.end(); ++it)
+        it.value().clear();
+    endResetModel();
+}
+
+//! Insert the rows added since the last batch into the model in one go
+void ProcTableModel::showPending() {
+    if (shown == rows.size())
+        return;
+    beginInsertRows(QModelIndex(), shown, rows.size() - 1);
+    shown = rows.size();
+    endInsertRows();
+}
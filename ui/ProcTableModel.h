@@ -0,0 +1,69 @@
+#ifndef PROCTABLEMODEL_H
+#define PROCTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+/**
+ * \brief The rows of a table of procs (the user or library procs of the GUI), as a model for a QTableView.
+ *
+ * Rows are found by the text of a column through a hash, so the decompiler thread can report procs one at a time
+ * without each report scanning the table. New rows are held back and shown in batches, so that a binary with many
+ * thousands of procs does not make the view lay itself out again for each one.
+ */
+class ProcTableModel : public QAbstractTableModel {
+    Q_OBJECT
+
+  public:
+    ProcTableModel(const QStringList &headers, QObject *parent = 0);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+
+    void setEditableColumn(int column) { editableColumn = column; }
+    void setCheckColumn(const QString &header);
+    void showCheckColumn(bool show);
+    void addIndex(int column);
+
+    int findRow(int column, const QString &text) const;
+    int procCount() const { return rows.size(); }
+    QString text(int row, int column) const { return rows[row].texts[column]; }
+    bool isChecked(int row) const { return rows[row].checked; }
+    void addRow(const QStringList &texts);
+    void setText(int row, int column, const QString &text);
+    void removeRow(int row);
+    void toggleChecks();
+    void clear();
+
+  signals:
+    //! The user edited the text of the editable column from \a oldText to \a newText
+    void textEdited(const QString &oldText, const QString &newText);
+
+  private slots:
+    void showPending();
+
+  private:
+    struct Row {
+        QStringList texts;
+        bool checked;
+    };
+    void reindexFrom(int row);
+
+    QStringList headers;
+    QString checkHeader;          //!< Header of the check column after the text columns, if any
+    bool checkShown = false;
+    int editableColumn = -1;
+    QVector<Row> rows;            //!< All the rows, including those not shown yet
+    int shown = 0;                //!< The rows [0, shown) have been inserted into the model
+    QHash<int, QHash<QString, int>> indexes; //!< Row by text, for each indexed column
+    QTimer pendingTimer;
+};
+
+#endif
@@ -1,10 +1,30 @@
 #include <QtCore>
+#include <algorithm>
 #include <cstdio>
+#include <map>
+#include <vector>
 
 #include "config.h"
 #include "boomerang.h"
+#include "arena.h"
+#include "exptable.h"
+#include "simplifycache.h"
+#include "stats.h"
+#include "taskscheduler.h"
+#include "tracewatcher.h"
+#include "proccache.h"
+#include "decodecache.h"
+#include "procprofile.h"
+#include "frontend.h"
+#include "rtl.h"
 #include "commandlinedriver.h"
 
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
 #ifdef HAVE_LIBGC
 #include "gc.h"
 #else
@@ -29,10 +49,34 @@ static void help() {
     q_cout << "  -E <addr>        : Decode the procedure at addr, no callees\n";
     q_cout << "                     Use -e and -E repeatedly for multiple entry points\n";
     q_cout << "  -ic              : Decode through type 0 Indirect Calls\n";
+    q_cout << "  -ia              : Allocate each procedure's IR in an arena, freed after code generation\n";
+    q_cout << "  -ih              : With -ia, put the IR of large procedures on transparent huge pages\n";
+    q_cout << "  -ie              : Intern (share) identical immutable expressions\n";
+    q_cout << "  -is              : Memoise expression simplification\n";
+    q_cout << "  -ip              : Pruned SSA: place phi functions only where the location is live\n";
+    q_cout << "  --cache <dir>    : Save the summaries of the procedures decompiled in dir, for the shards of --shard\n";
+    q_cout << "  --decode-cache <dir>: Reuse (and save) the decoded program of a binary decoded before, in dir\n";
+    q_cout << "  --ssl-cache      : Load the machine description from a cache next to the .ssl file (made if missing)\n";
+    q_cout << "  --prefetch       : Read the signatures while the binary is being loaded\n";
+    q_cout << "  --lazy-sigs      : Only read the library signature files declaring what the program uses\n";
+    q_cout << "  --sig-db         : Load the library signatures from databases next to their files (made if missing)\n";
+    q_cout << "  --compile-sigs   : Compile the signature databases of every platform, and exit\n";
+    q_cout << "  --scan-prologues : Also decode code that starts like a procedure, even if nothing calls it\n";
+    q_cout << "  --draft          : Quick, rougher output for triage: one SSA pass, only sp proven preserved, one sweep\n";
+    q_cout << "                     of type analysis; implies --scan-prologues and --prop-growth 2\n";
+    q_cout << "  --lazy-decode    : Decode each callee only when decompilation reaches it\n";
+    q_cout << "  --shard <i>/<n>  : Decompile only shard i (from 0) of n, with the summaries of the others from --cache\n";
+    q_cout << "  --split-output   : Put the prototypes in a header included by every module's file\n";
+    q_cout << "  -if              : Fold constants and unreachable blocks (sparse conditional constant propagation)\n";
     q_cout << "  -S <min>         : Stop decompilation after specified number of minutes\n";
+    q_cout << "  --proc-time <s>  : Finish each procedure as it is once it has taken s seconds\n";
+    q_cout << "  --proc-steps <n> : Finish each procedure as it is after n SSA passes and propagations\n";
+    q_cout << "  --profile <file> : Budget by the procedure times of the last run in file, and update them there\n";
+    q_cout << "  --max-memory <mb>: Drop the caches that can be rebuilt whenever the process holds more than mb MB\n";
     q_cout << "  -t               : Trace (print address of) every instruction decoded\n";
     q_cout << "  -Tc              : Use old constraint-based type analysis\n";
     q_cout << "  -Td              : Use data-flow-based type analysis\n";
+    q_cout << "  -Tg              : Merge global types between rounds of global type analysis\n";
     q_cout << "  -LD              : Load before decompile (<program> becomes xml input file)\n";
     q_cout << "  -SD              : Save before decompile\n";
     q_cout << "  -a               : Assume ABI compliance\n";
@@ -46,10 +90,24 @@ static void help() {
     q_cout << "  -r               : Print RTL for each proc to log before code generation\n";
     q_cout << "  -gd <dot file>   : Generate a dotty graph of the program's CFG and DFG\n";
     q_cout << "  -gc              : Generate a call graph (callgraph.out and callgraph.dot)\n";
+    q_cout << "  --graph-depth <n>: Only write the call graph and CFGs (-gc, -gd, -x) n calls deep from the entry\n";
+    q_cout << "                     points\n";
+    q_cout << "  --graph-module <m>: Only write them for the procs of module m and what they call\n";
     q_cout << "  -gs              : Generate a symbol file (symbols.h)\n";
     q_cout << "  -iw              : Write indirect call report to output/indirect.txt\n";
+    q_cout << "  --stream         : Generate code for each procedure as soon as it is final, and free its IR\n";
+    q_cout << "  --cheapest-first : Decompile the smallest ready procedures first, so that --stream writes sooner\n";
+    q_cout << "                     (the different order may change the output)\n";
+    q_cout << "  --stats          : Write time, allocations and counts per stage and procedure to output/stats.json\n";
+    q_cout << "  --memstats       : Report the procedures with the largest peak IR footprint in output/memstats.txt\n";
+    q_cout << "  --trace          : Write a timeline of the stages of each procedure to output/trace.json\n";
+    q_cout << "  --fast-exit      : Exit as soon as the output is written, without freeing the program's memory\n";
     q_cout << "Misc.\n";
     q_cout << "  -k               : Command mode, for available commands see -h cmd\n";
+    q_cout << "  --server <n>     : Run the jobs read from stdin, n at a time, reusing the machine descriptions and\n";
+    q_cout << "                     signatures read once. A job is a line of switches then a program, run with\n";
+    q_cout << "                     the switches given here first; \"<job> <exit code> <program>\" is printed as\n";
+    q_cout << "                     each ends\n";
     q_cout << "  -P <path>        : Path to Boomerang files, defaults to where you run\n";
     q_cout << "                     Boomerang from\n";
     q_cout << "  -X               : activate eXperimental code; errors likely\n";
@@ -64,6 +122,7 @@ static void help() {
     q_cout << "  -ds              : Stop at debug points for keypress\n";
     q_cout << "  -dt              : Debug type analysis\n";
     q_cout << "  -du              : Debug removing unused statements etc\n";
+    q_cout << "  --debug-proc <n> : Only give the debug prints (-v) and dot files (-gd) of proc n (repeatable)\n";
     q_cout << "Restrictions\n";
     q_cout << "  -nb              : No simplifications for branches\n";
     q_cout << "  -nc              : No decode children in the call graph (callees)\n";
@@ -82,6 +141,7 @@ static void help() {
     q_cout << "  -nr              : No removal of unneeded labels\n";
     q_cout << "  -nR              : No removal of unused Returns\n";
     q_cout << "  -l <depth>       : Limit multi-propagations to expressions with depth <depth>\n";
+    q_cout << "  --prop-growth <n>: Instead, let multi-propagations add up to n expression nodes per statement\n";
     q_cout << "  -p <num>         : Only do num propagations\n";
     q_cout << "  -m <num>         : Max memory depth\n";
 }
@@ -160,6 +220,8 @@ int CommandlineDriver::applyCommandline(const QStringList &args) {
                 boom.dfaTypeAnalysis = false;
             } else if (arg[2] == 'd')
                 boom.dfaTypeAnalysis = true; // -Td: use data-flow-based type analysis (now default)
+            else if (arg[2] == 'g')
+                boom.roundTypeAnalysis = true; // -Tg: merge global types once per round of global type analysis
             break;
         case 'g':
             if (arg[2] == 'd')
@@ -181,9 +243,136 @@ int CommandlineDriver::applyCommandline(const QStringList &args) {
         case 'i':
             if (arg[2] == 'c')
                 boom.decodeThruIndCall = true; // -ic;
+            else if (arg[2] == 'a')
+                Arena::setEnabled(true); // -ia
+            else if (arg[2] == 'h')
+                Arena::setHugePages(true); // -ih
+            else if (arg[2] == 'e')
+                ExpTable::get().setEnabled(true); // -ie
+            else if (arg[2] == 's')
+                SimplifyCache::get().setEnabled(true); // -is
+            else if (arg[2] == 'p')
+                boom.prunedSSA = true; // -ip
+            else if (arg[2] == 'f')
+                boom.foldConstants = true; // -if
             break;
         case '-':
-            break; // No effect: ignored
+            if (arg == "--stats")
+                DecompileStats::get().setEnabled(true);
+            else if (arg == "--memstats")
+                DecompileStats::get().setMemoryEnabled(true);
+            else if (arg == "--trace") {
+                TraceWatcher::get().setEnabled(true);
+                boom.addWatcher(&TraceWatcher::get());
+            }
+            else if (arg == "--stream")
+                boom.streamCode = true;
+            else if (arg == "--cheapest-first")
+                boom.cheapestFirst = true;
+            else if (arg == "--ssl-cache")
+                boom.sslCache = true;
+            else if (arg == "--prefetch")
+                boom.prefetch = true;
+            else if (arg == "--lazy-sigs")
+                boom.lazySignatures = true;
+            else if (arg == "--sig-db")
+                boom.signatureDatabases = true;
+            else if (arg == "--compile-sigs")
+                compileSignatures = true;
+            else if (arg == "--scan-prologues")
+                boom.scanPrologues = true;
+            else if (arg == "--draft") {
+                boom.draft = true;
+                boom.scanPrologues = true;
+                if (boom.propGrowthBudget == 0)
+                    boom.propGrowthBudget = 2; // A later --prop-growth still overrides this
+                DecompileStats::get().setPreset("draft");
+            }
+            else if (arg == "--lazy-decode")
+                boom.lazyDecode = true;
+            else if (arg == "--shard") {
+                QStringList shard = ++i < args.size() ? args[i].split('/') : QStringList();
+                bool ok = shard.size() == 2;
+                if (ok) {
+                    boom.shardIndex = shard[0].toInt(&ok);
+                    if (ok)
+                        boom.shardCount = shard[1].toInt(&ok);
+                }
+                if (!ok || boom.shardIndex < 0 || boom.shardIndex >= boom.shardCount) {
+                    usage();
+                    return 1;
+                }
+            }
+            else if (arg == "--split-output")
+                boom.splitOutput = true;
+            else if (arg == "--fast-exit")
+                boom.fastExit = true;
+            else if (arg == "--server") {
+                if (++i == args.size()) {
+                    usage();
+                    return 1;
+                }
+                serverJobs = std::max(1, args[i].toInt());
+            } else if (arg == "--graph-depth") {
+                if (++i == args.size()) {
+                    usage();
+                    return 1;
+                }
+                boom.graphDepth = args[i].toInt();
+            } else if (arg == "--graph-module") {
+                if (++i == args.size()) {
+                    usage();
+                    return 1;
+                }
+                boom.graphModule = args[i];
+            } else if (arg == "--debug-proc") {
+                if (++i == args.size()) {
+                    usage();
+                    return 1;
+                }
+                boom.debugProcs.insert(args[i]);
+            } else if (arg == "--cache") {
+                if (++i == args.size()) {
+                    usage();
+                    return 1;
+                }
+                ProcCache::get().setDirectory(args[i]);
+            } else if (arg == "--decode-cache") {
+                if (++i == args.size()) {
+                    usage();
+                    return 1;
+                }
+                DecodeCache::get().setDirectory(args[i]);
+            } else if (arg == "--prop-growth") {
+                if (++i == args.size()) {
+                    usage();
+                    return 1;
+                }
+                boom.propGrowthBudget = args[i].toInt();
+            } else if (arg == "--max-memory") {
+                if (++i == args.size()) {
+                    usage();
+                    return 1;
+                }
+                boom.maxMemory = args[i].toInt();
+            } else if (arg == "--profile") {
+                if (++i == args.size()) {
+                    usage();
+                    return 1;
+                }
+                if (!ProcProfile::get().setPath(args[i]))
+                    LOG_STREAM(LL_Warn) << args[i] << " is not a profile; it will be overwritten\n";
+            } else if (arg == "--proc-time" || arg == "--proc-steps") {
+                if (++i == args.size()) {
+                    usage();
+                    return 1;
+                }
+                if (arg == "--proc-time")
+                    boom.procTimeBudget = args[i].toInt();
+                else
+                    boom.procStepBudget = args[i].toInt();
+            }
+            break; // Otherwise no effect: ignored
         case 'L':
             if (arg[2] == 'D')
                 boom.loadBeforeDecompile = true;
@@ -336,6 +525,10 @@ int CommandlineDriver::applyCommandline(const QStringList &args) {
     }
     if (kmd)
         return console();
+    if (serverJobs > 0) {
+        serverCommand = args[0];
+        return 0;
+    }
 
     if (minsToStopAfter) {
         LOG_STREAM(LL_Error) << "stopping decompile after " << minsToStopAfter << " minutes.\n";
@@ -369,6 +562,122 @@ int CommandlineDriver::console() {
     } while (!line.isNull());
     return 0;
 }
+/**
+ * Serves decompilation jobs read from stdin (a pipe, or a named pipe or socket redirected to it) until it is closed.
+ * Each line is a job: the switches of one decompilation, then the program, as they would be given to boomerang (e.g.
+ * "-o out/ls/ tests/inputs/pentium/ls"). They apply on top of the switches the server was started with.
+ *
+ * The SSL dictionaries of the machines and the signature files of the catalogs are read once, here, on several
+ * threads, with warmCaches set. Every job then runs in a process forked for it, at most serverJobs at once: it starts
+ * from that state, and nothing it does (its Prog, named types, options) outlives it. As each job ends,
+ * "<job> <exit code> <program>" is written to stdout, jobs being numbered from 1 in the order they were read; the
+ * jobs' own output goes to stderr.
+ *
+ * \returns 0 if every job succeeded, else 1
+ */
+int CommandlineDriver::server() {
+#ifdef _WIN32
+    LOG_STREAM(LL_Error) << "--server is not available on this platform\n";
+    return 1;
+#else
+    Boomerang &boom(*Boomerang::get());
+    boom.warmCaches = true;
+    // The SSL files are parsed by tasks of the same scheduler as the signature files, on one worker if they are to be
+    // parsed on one thread (see FrontEnd::getParseWorkers)
+    QDir base_dir = boom.getProgDir();
+    TaskScheduler scheduler(FrontEnd::getParseWorkers());
+    for (const char *machine : {"pentium", "sparc", "ppc", "mips", "st20"}) { // Those with a decoder
+        QString ssl = base_dir.absoluteFilePath(QString("frontend/machine/%1/%1.ssl").arg(machine));
+        if (!QFile::exists(ssl))
+            continue;
+        // Before the signature files, as each is the longest task there is
+        scheduler.add("parse SSL", [ssl]() {
+            RTLInstDict dict;
+            dict.readSSLFile(ssl);
+        }, 1);
+    }
+    FrontEnd::preloadSignatures(scheduler);
+    scheduler.run();
+    LOG_STREAM() << "serving " << serverJobs << " jobs at a time\n";
+    boom.getLogStream().flush();
+
+    std::map<pid_t, std::pair<int, QString>> running; // Number and program of each job running, by process
+    int numJobs = 0;
+    bool failed = false;
+    auto waitForJob = [&]() {
+        int status = 0;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            if (errno != EINTR)
+                running.clear(); // No children left to wait for
+            return;
+        }
+        auto it = running.find(pid);
+        if (it == running.end())
+            return;
+        int res = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        failed |= res != 0;
+        printf("%d %d %s\n", it->second.first, res, qPrintable(it->second.second));
+        fflush(stdout);
+        running.erase(it);
+    };
+
+    QTextStream strm(stdin);
+    for (QString line = strm.readLine(); !line.isNull(); line = strm.readLine()) {
+        QStringList job = line.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+        if (job.isEmpty())
+            continue;
+        // The server's -P comes before the job's switches, as applyCommandline sets the path from the first argument
+        job = QStringList{serverCommand, "-P", boom.getProgPath()} + job;
+        while ((int)running.size() >= serverJobs)
+            waitForJob();
+        int number = ++numJobs;
+        fflush(stdout);
+        fflush(stderr);
+        // The child would have the log but not its writing thread, and wait for that forever when replacing the log
+        boom.log().suspend();
+        pid_t pid = fork();
+        if (pid == 0) {
+            dup2(fileno(stderr), fileno(stdout)); // Leave stdout to the results of the jobs
+            int res = runJob(job);
+            fflush(stdout);
+            _exit(res);
+        }
+        boom.log().resume();
+        if (pid < 0) {
+            failed = true;
+            printf("%d %d %s\n", number, -1, qPrintable(job.last()));
+            fflush(stdout);
+            continue;
+        }
+        running[pid] = std::make_pair(number, job.last());
+    }
+    while (!running.empty())
+        waitForJob();
+    return failed ? 1 : 0;
+#endif
+}
+
+/**
+ * Runs one job of server(), in the process forked for it: applies the job's switches, and decompiles its program.
+ */
+int CommandlineDriver::runJob(const QStringList &args) {
+    Boomerang &boom(*Boomerang::get());
+    serverJobs = 0;
+    if (applyCommandline(args) != 0 || isServer())
+        return 1;
+#ifndef _WIN32
+    if (minsToStopAfter)
+        alarm(60 * minsToStopAfter); // No event loop runs here for m_kill_timer
+#endif
+    boom.setLogger(new FileLogger()); // In the job's output directory, not the server's
+    int res = boom.decompile(args.last());
+    boom.log().flush();
+    boom.getLogStream().flush();
+    boom.getLogStream(LL_Error).flush();
+    return res;
+}
+
 int CommandlineDriver::decompile() {
     m_thread.start();
     m_thread.wait(-1);
@@ -382,6 +691,7 @@ void CommandlineDriver::onCompilationTimeout() {
 void DecompilationThread::run() {
     Boomerang &boom(*Boomerang::get());
     Result = boom.decompile(m_decompiled);
+    boom.log().flush();
     boom.getLogStream().flush();
     boom.getLogStream(LL_Error).flush();
 }
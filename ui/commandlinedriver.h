@@ -17,11 +17,18 @@ class CommandlineDriver : public QObject
         DecompilationThread m_thread;
         QTimer      m_kill_timer;
         int         minsToStopAfter = 0;
+        int         serverJobs = 0; //!< With --server, how many jobs to run at once
+        QString     serverCommand;  //!< The path the server was started by, the first argument of each job
+        bool        compileSignatures = false; //!< With --compile-sigs, only compile the signature databases
+        int         runJob(const QStringList &args);
 public:
 explicit            CommandlineDriver(QObject *parent = 0);
         int         applyCommandline(const QStringList &args);
         int         decompile();
         int         console();
+        bool        isServer() const { return serverJobs > 0; }
+        bool        isCompilingSignatures() const { return compileSignatures; }
+        int         server();
 public slots:
         void        onCompilationTimeout();
 
@@ -1,6 +1,11 @@
 #include <QApplication>
 #include "mainwindow.h"
 #include "commandlinedriver.h"
+#include "boomerang.h"
+#include "frontend.h"
+
+#include <cstdio>
+#include <cstdlib>
 
 void init_dfa();        // Prototypes for
 void init_sslparser();  // various initialisation functions
@@ -18,7 +23,19 @@ int main(int argc, char *argv[]) {
         init_sslparser();
         init_basicblock();
         driver.applyCommandline(app.arguments());
-        return driver.decompile();
+        if (driver.isServer())
+            return driver.server();
+        if (driver.isCompilingSignatures())
+            return FrontEnd::compileSignatureDatabases() ? 0 : 1;
+        int res = driver.decompile();
+        if (Boomerang::get()->fastExit) {
+            // Everything is written and the logs are flushed (see DecompilationThread::run); freeing the IR object by
+            // object, and running the destructors of the caches, would only take time
+            fflush(stdout);
+            fflush(stderr);
+            std::_Exit(res);
+        }
+        return res;
     }
     MainWindow mainWindow;
     mainWindow.show();
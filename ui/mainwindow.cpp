@@ -2,6 +2,7 @@
 #include "DecompilerThread.h"
 #include "rtleditor.h"
 #include "LoggingSettingsDlg.h"
+#include "ProcTableModel.h"
 
 #include <QFileDialog>
 #include <QtWidgets>
@@ -35,6 +36,8 @@ MainWindow::MainWindow(QWidget *parent)
     // connect(d, &Decompiler::changeProcedureState,this, &MainWindow::changeProcedureState);
     connect(d, &Decompiler::consideringProc, this, &MainWindow::showConsideringProc);
     connect(d, &Decompiler::decompilingProc, this, &MainWindow::showDecompilingProc);
+    connect(d, &Decompiler::decompiledProc, this, &MainWindow::showDecompiledProc);
+    connect(d, &Decompiler::decodeProgress, this, &MainWindow::showDecodeProgress);
     connect(d, &Decompiler::newUserProc, this, &MainWindow::showNewUserProc);
     connect(d, &Decompiler::newLibProc, this, &MainWindow::showNewLibProc);
     connect(d, &Decompiler::removeUserProc, this, &MainWindow::showRemoveUserProc);
@@ -51,6 +54,33 @@ MainWindow::MainWindow(QWidget *parent)
     // connect(ui->inputFileBrowseButton, SIGNAL(clicked()), this, SLOT(browseForInputFile()));
     // connect(ui->outputPathBrowseButton, SIGNAL(clicked()), this, SLOT(browseForOutputPath()));
 
+    userProcModel = new ProcTableModel(QStringList() << tr("Address") << tr("Name"), this);
+    userProcModel->addIndex(0);
+    userProcModel->addIndex(1);
+    userProcModel->setEditableColumn(1);
+    userProcModel->setCheckColumn(tr("Debug"));
+    connect(userProcModel, &ProcTableModel::textEdited, this, &MainWindow::renameUserProc);
+    userProcSorter = new QSortFilterProxyModel(this);
+    userProcSorter->setSourceModel(userProcModel);
+    ui->userProcs->setModel(userProcSorter);
+    libProcModel = new ProcTableModel(QStringList() << tr("Name") << tr("Parameters"), this);
+    libProcModel->addIndex(0);
+    libProcSorter = new QSortFilterProxyModel(this);
+    libProcSorter->setSourceModel(libProcModel);
+    ui->libProcs->setModel(libProcSorter);
+    // New procs arrive in batches (see ProcTableModel), so the columns are sized once per batch
+    connect(userProcModel, &QAbstractItemModel::rowsInserted, ui->userProcs, &QTableView::resizeColumnsToContents);
+    connect(libProcModel, &QAbstractItemModel::rowsInserted, ui->libProcs, &QTableView::resizeColumnsToContents);
+
+    // While decompiling, a proc can be moved ahead of the others, or finished at the stage it has reached
+    QAction *preferAction = new QAction(tr("Decompile Next"), ui->decompileProcsTreeWidget);
+    connect(preferAction, &QAction::triggered, this, &MainWindow::preferCurrentProc);
+    QAction *cancelAction = new QAction(tr("Cancel Decompilation"), ui->decompileProcsTreeWidget);
+    connect(cancelAction, &QAction::triggered, this, &MainWindow::cancelCurrentProc);
+    ui->decompileProcsTreeWidget->addAction(preferAction);
+    ui->decompileProcsTreeWidget->addAction(cancelAction);
+    ui->decompileProcsTreeWidget->setContextMenuPolicy(Qt::ActionsContextMenu);
+
     ui->userProcs->horizontalHeader()->disconnect(SIGNAL(sectionClicked(int)));
     connect(ui->userProcs->horizontalHeader(), &QHeaderView::sectionClicked, this,
             &MainWindow::onUserProcsHorizontalHeaderSectionClicked);
@@ -259,11 +289,13 @@ void MainWindow::showInitPage() {
     ui->toGenerateCodeButton->setDisabled(true);
     ui->stackedWidget->setCurrentIndex(0);
     ui->entrypoints->setRowCount(0);
-    ui->userProcs->setRowCount(0);
-    ui->libProcs->setRowCount(0);
+    userProcModel->clear();
+    libProcModel->clear();
     ui->decompileProcsTreeWidget->clear();
+    consideredProcItems.clear();
     decompiledCount = 0;
     ui->clusters->clear();
+    clusterItems.clear();
     codeGenCount = 0;
     ui->actionLoad->setDisabled(true);
     ui->actionDecode->setDisabled(true);
@@ -291,12 +323,7 @@ void MainWindow::showDecodePage() {
     ui->toDecodeButton->setDisabled(true);
     ui->stackedWidget->setCurrentIndex(2);
 
-    if (!ui->actionEnable->isChecked()) {
-        ui->userProcs->removeColumn(2);
-    } else {
-        ui->userProcs->setColumnCount(3);
-        ui->userProcs->setHorizontalHeaderItem(2, new QTableWidgetItem(tr("Debug")));
-    }
+    userProcModel->showCheckColumn(ui->actionEnable->isChecked());
 
     ui->actionDecode->setDisabled(false);
 }
@@ -384,97 +411,94 @@ void MainWindow::generateCodeComplete() {
 }
 
 void MainWindow::showConsideringProc(const QString &parent, const QString &name) {
-    QList<QTreeWidgetItem *> foundit =
-            ui->decompileProcsTreeWidget->findItems(name, Qt::MatchExactly | Qt::MatchRecursive);
-    if (foundit.isEmpty()) {
-        QStringList texts(name);
-        if (parent.isEmpty()) {
-            ui->decompileProcsTreeWidget->addTopLevelItem(new QTreeWidgetItem(texts));
-        } else {
-            QList<QTreeWidgetItem *> found =
-                    ui->decompileProcsTreeWidget->findItems(parent, Qt::MatchExactly | Qt::MatchRecursive);
-            if (!found.isEmpty()) {
-                QTreeWidgetItem *n = new QTreeWidgetItem(found.first(), texts);
-                n->setData(0, 1, name);
-                ui->decompileProcsTreeWidget->expandItem(found.first());
-                ui->decompileProcsTreeWidget->scrollToItem(n);
-                ui->decompileProcsTreeWidget->setCurrentItem(n, 0);
-            }
+    if (consideredProcItems.contains(name))
+        return;
+    QStringList texts(name);
+    if (parent.isEmpty()) {
+        QTreeWidgetItem *n = new QTreeWidgetItem(texts);
+        ui->decompileProcsTreeWidget->addTopLevelItem(n);
+        consideredProcItems[name] = n;
+    } else {
+        QTreeWidgetItem *found = consideredProcItems.value(parent);
+        if (found) {
+            QTreeWidgetItem *n = new QTreeWidgetItem(found, texts);
+            n->setData(0, 1, name);
+            consideredProcItems[name] = n;
+            ui->decompileProcsTreeWidget->expandItem(found);
+            ui->decompileProcsTreeWidget->scrollToItem(n);
+            ui->decompileProcsTreeWidget->setCurrentItem(n, 0);
         }
     }
 }
 
+void MainWindow::showDecodeProgress(int numInsns, int numBytes) {
+    statusBar()->showMessage(QString("decoded %1 instructions (%2 bytes)").arg(numInsns).arg(numBytes));
+}
+
 void MainWindow::showDecompilingProc(const QString &name) {
-    QList<QTreeWidgetItem *> foundit =
-            ui->decompileProcsTreeWidget->findItems(name, Qt::MatchExactly | Qt::MatchRecursive);
-    if (!foundit.isEmpty()) {
-        ui->decompileProcsTreeWidget->setCurrentItem(foundit.first(), 0);
-        foundit.first()->setTextColor(0, QColor("blue"));
+    QTreeWidgetItem *found = consideredProcItems.value(name);
+    if (found) {
+        ui->decompileProcsTreeWidget->setCurrentItem(found, 0);
+        found->setTextColor(0, QColor("blue"));
         decompiledCount++;
     }
-    int max = ui->userProcs->rowCount();
+    int max = userProcModel->procCount();
     ui->progressDecompile->setRange(0, max);
     ui->progressDecompile->setValue(decompiledCount);
 }
 
+void MainWindow::showDecompiledProc(const QString &name) {
+    QTreeWidgetItem *found = consideredProcItems.value(name);
+    if (found)
+        found->setTextColor(0, QColor("green"));
+    // Show the finished proc in its tab, if it has one
+    for (int i = 0; i < ui->tabWidget->count(); i++)
+        if (ui->tabWidget->tabText(i) == name) {
+            RTLEditor *n = dynamic_cast<RTLEditor *>(ui->tabWidget->widget(i));
+            if (n)
+                n->updateContents();
+            break;
+        }
+}
+
+void MainWindow::preferCurrentProc() {
+    QTreeWidgetItem *item = ui->decompileProcsTreeWidget->currentItem();
+    if (item)
+        decompilerThread->getDecompiler()->preferProc(item->text(0));
+}
+
+void MainWindow::cancelCurrentProc() {
+    QTreeWidgetItem *item = ui->decompileProcsTreeWidget->currentItem();
+    if (item)
+        decompilerThread->getDecompiler()->cancelProc(item->text(0));
+}
+
 void MainWindow::showNewUserProc(const QString &name, ADDRESS addr) {
     QString s = addr.toString(true);
-    int nrows = ui->userProcs->rowCount();
-    for (int i = 0; i < nrows; i++)
-        if (ui->userProcs->item(i, 1)->text() == name)
-            return;
-    for (int i = 0; i < nrows; i++)
-        if (ui->userProcs->item(i, 0)->text() == s)
-            return;
-    ui->userProcs->setRowCount(nrows + 1);
-    ui->userProcs->setItem(nrows, 0, new QTableWidgetItem(addr.toString(true)));
-    ui->userProcs->setItem(nrows, 1, new QTableWidgetItem(name));
-    ui->userProcs->item(nrows, 1)->setData(1, name);
-    if (ui->actionEnable->isChecked()) {
-        QTableWidgetItem *d = new QTableWidgetItem("");
-        d->setCheckState(Qt::Checked);
-        ui->userProcs->setItem(nrows, 2, d);
-    }
-    ui->userProcs->resizeColumnsToContents();
-    ui->userProcs->resizeRowsToContents();
+    if (userProcModel->findRow(1, name) != -1 || userProcModel->findRow(0, s) != -1)
+        return;
+    userProcModel->addRow(QStringList() << s << name);
 }
 
 void MainWindow::showNewLibProc(const QString &name, const QString &params) {
-    int nrows = ui->libProcs->rowCount();
-    for (int i = 0; i < nrows; i++)
-        if (ui->libProcs->item(i, 0)->text() == name) {
-            ui->libProcs->item(i, 1)->setText(params);
-            return;
-        }
-    ui->libProcs->setRowCount(nrows + 1);
-    ui->libProcs->setItem(nrows, 0, new QTableWidgetItem(name));
-    ui->libProcs->setItem(nrows, 1, new QTableWidgetItem(params));
-    ui->libProcs->resizeColumnsToContents();
-    ui->libProcs->resizeRowsToContents();
+    int row = libProcModel->findRow(0, name);
+    if (row != -1)
+        libProcModel->setText(row, 1, params);
+    else
+        libProcModel->addRow(QStringList() << name << params);
 }
 
 void MainWindow::showRemoveUserProc(const QString &name, ADDRESS addr) {
     Q_UNUSED(name);
-    QString s = addr.toString(true);
-    int nrows = ui->userProcs->rowCount();
-    for (int i = 0; i < nrows; i++)
-        if (ui->userProcs->item(i, 0)->text() == s) {
-            ui->userProcs->removeRow(i);
-            break;
-        }
-    ui->userProcs->resizeColumnsToContents();
-    ui->userProcs->resizeRowsToContents();
+    int row = userProcModel->findRow(0, addr.toString(true));
+    if (row != -1)
+        userProcModel->removeRow(row);
 }
 
 void MainWindow::showRemoveLibProc(const QString &name) {
-    int nrows = ui->libProcs->rowCount();
-    for (int i = 0; i < nrows; i++)
-        if (ui->libProcs->item(i, 0)->text() == name) {
-            ui->libProcs->removeRow(i);
-            break;
-        }
-    ui->libProcs->resizeColumnsToContents();
-    ui->libProcs->resizeRowsToContents();
+    int row = libProcModel->findRow(0, name);
+    if (row != -1)
+        libProcModel->removeRow(row);
 }
 
 void MainWindow::showNewSection(const QString &name, ADDRESS start, ADDRESS end) {
@@ -494,20 +518,21 @@ void MainWindow::showNewCluster(const QString &name) {
     QTreeWidgetItem *n = new QTreeWidgetItem(QStringList(cname));
     ui->clusters->addTopLevelItem(n);
     ui->clusters->expandItem(n);
+    clusterItems[cname] = n;
 }
 
 void MainWindow::showNewProcInCluster(const QString &name, const QString &cluster) {
     QString cname = cluster;
     cname = cname.append(".c");
-    QList<QTreeWidgetItem *> found = ui->clusters->findItems(cname, Qt::MatchExactly);
-    if (!found.isEmpty()) {
-        QTreeWidgetItem *n = new QTreeWidgetItem(found.first(), QStringList(name));
+    QTreeWidgetItem *found = clusterItems.value(cname);
+    if (found) {
+        QTreeWidgetItem *n = new QTreeWidgetItem(found, QStringList(name));
         ui->clusters->scrollToItem(n);
         ui->clusters->setCurrentItem(n, 0);
-        ui->clusters->expandItem(found.first());
+        ui->clusters->expandItem(found);
         codeGenCount++;
     }
-    ui->progressGenerateCode->setRange(0, ui->userProcs->rowCount());
+    ui->progressGenerateCode->setRange(0, userProcModel->procCount());
     ui->progressGenerateCode->setValue(codeGenCount);
 }
 
@@ -519,11 +544,11 @@ void MainWindow::showDebuggingPoint(const QString &name, const QString &descript
     statusBar()->showMessage(msg);
     ui->actionStep->setEnabled(true);
 
-    for (int i = 0; i < ui->userProcs->rowCount(); i++)
-        if (ui->userProcs->item(i, 1)->text() == name && ui->userProcs->item(i, 2)->checkState() != Qt::Checked) {
-            on_actionStep_triggered();
-            return;
-        }
+    int row = userProcModel->findRow(1, name);
+    if (row != -1 && !userProcModel->isChecked(row)) {
+        on_actionStep_triggered();
+        return;
+    }
 
     showRTLEditor(name);
 }
@@ -543,20 +568,16 @@ void MainWindow::showRTLEditor(const QString &name) {
     ui->tabWidget->setCurrentWidget(n);
 }
 
-void MainWindow::on_userProcs_cellDoubleClicked(int row, int column) {
-    Q_UNUSED(column);
-    showRTLEditor(ui->userProcs->item(row, 1)->text());
+void MainWindow::on_userProcs_doubleClicked(const QModelIndex &index) {
+    QString name = index.sibling(index.row(), 1).data().toString();
+    // If it is yet to be decompiled, do it next
+    decompilerThread->getDecompiler()->preferProc(name);
+    showRTLEditor(name);
 }
 
-void MainWindow::on_userProcs_cellChanged(int row, int column) {
-    if (column == 0) {
-        // TODO: should we allow the user to change the address of a proc?
-    }
-    if (column == 1) {
-        QString old_name = ui->userProcs->item(row, 1)->data(1).toString();
-        decompilerThread->getDecompiler()->renameProc(old_name, ui->userProcs->item(row, 1)->text());
-        ui->userProcs->item(row, 1)->setData(1, ui->userProcs->item(row, 1)->text());
-    }
+// TODO: should we allow the user to change the address of a proc?
+void MainWindow::renameUserProc(const QString &oldName, const QString &newName) {
+    decompilerThread->getDecompiler()->renameProc(oldName, newName);
 }
 
 void MainWindow::on_clusters_itemDoubleClicked(QTreeWidgetItem *item, int column) {
@@ -619,37 +640,32 @@ void MainWindow::on_actionStep_triggered() {
 }
 
 void MainWindow::onUserProcsHorizontalHeaderSectionClicked(int logicalIndex) {
-    if (logicalIndex == 2) {
-        for (int i = 0; i < ui->userProcs->rowCount(); i++) {
-            if (ui->userProcs->item(i, 2) == NULL) {
-                ui->userProcs->setItem(i, 2, new QTableWidgetItem(""));
-            }
-            Qt::CheckState state = ui->userProcs->item(i, 2)->checkState();
-            ui->userProcs->item(i, 2)->setCheckState(state == Qt::Checked ? Qt::Unchecked : Qt::Checked);
-        }
-    }
+    if (logicalIndex == 2)
+        userProcModel->toggleChecks();
 }
 
-void MainWindow::on_libProcs_cellDoubleClicked(int row, int column) {
-    Q_UNUSED(column);
+void MainWindow::on_libProcs_doubleClicked(const QModelIndex &index) {
+    // Rows in the order shown
+    QAbstractItemModel *procs = ui->libProcs->model();
+    int row = index.row();
     QString name = "";
     QString sigFile;
-    QString params = ui->libProcs->item(row, 1)->text();
+    QString params = procs->index(row, 1).data().toString();
     bool existing = true;
     if (params == "<unknown>") {
         existing = false;
         // uhh, time to guess?
         for (int i = row; i >= 0; i--) {
-            params = ui->libProcs->item(i, 1)->text();
+            params = procs->index(i, 1).data().toString();
             if (params != "<unknown>") {
-                name = ui->libProcs->item(i, 0)->text();
+                name = procs->index(i, 0).data().toString();
                 break;
             }
         }
         if (name.isEmpty())
             return;
     } else
-        name = ui->libProcs->item(row, 0)->text();
+        name = procs->index(row, 0).data().toString();
 
     sigFile = decompilerThread->getDecompiler()->getSigFile(name);
     QString filename = sigFile;
@@ -689,7 +705,7 @@ void MainWindow::on_libProcs_cellDoubleClicked(int row, int column) {
         cursor.movePosition(QTextCursor::End);
         n->setTextCursor(cursor);
         QString comment = "// unknown library proc: ";
-        comment.append(ui->libProcs->item(row, 0)->text());
+        comment.append(procs->index(row, 0).data().toString());
         comment.append("\n");
         n->insertPlainText(comment);
     }
@@ -3,6 +3,7 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QHash>
 #include "types.h"
 #include <vector>
 #include <map>
@@ -12,6 +13,9 @@ class DecompilerThread;
 class QToolButton;
 class QTreeWidgetItem;
 class QTableWidgetItem;
+class QModelIndex;
+class QSortFilterProxyModel;
+class ProcTableModel;
 
 namespace Ui {
 class MainWindow;
@@ -42,6 +46,10 @@ public slots:
     void on_outputPathComboBox_editTextChanged(const QString &text);
     void showConsideringProc(const QString &parent, const QString &name);
     void showDecompilingProc(const QString &name);
+    void showDecompiledProc(const QString &name);
+    void preferCurrentProc();
+    void cancelCurrentProc();
+    void showDecodeProgress(int numInsns, int numBytes);
     void showNewUserProc(const QString &name, ADDRESS addr);
     void showNewLibProc(const QString &name, const QString &params);
     void showRemoveUserProc(const QString &name, ADDRESS addr);
@@ -59,9 +67,9 @@ public slots:
     void on_actionEnable_toggled(bool b);
     void on_actionStep_triggered();
     void onUserProcsHorizontalHeaderSectionClicked(int logicalIndex);
-    void on_userProcs_cellDoubleClicked(int row, int column);
-    void on_userProcs_cellChanged(int row, int column);
-    void on_libProcs_cellDoubleClicked(int row, int column);
+    void on_userProcs_doubleClicked(const QModelIndex &index);
+    void renameUserProc(const QString &oldName, const QString &newName);
+    void on_libProcs_doubleClicked(const QModelIndex &index);
     void on_actionOpen_triggered();
     void on_actionSave_triggered();
     void on_actionClose_triggered();
@@ -110,6 +118,12 @@ private:
 
     QToolButton *step;
 
+    ProcTableModel *userProcModel; //!< Address, name and debug check of each user proc
+    ProcTableModel *libProcModel;  //!< Name and parameters of each library proc
+    QSortFilterProxyModel *userProcSorter, *libProcSorter;
+    QHash<QString, QTreeWidgetItem *> consideredProcItems; //!< decompileProcsTreeWidget items by proc name
+    QHash<QString, QTreeWidgetItem *> clusterItems;        //!< Top level clusters items by file name
+
     int decompiledCount, codeGenCount;
     std::map<QWidget *, QString> openFiles;
     std::set<QWidget *> signatureFiles;
@@ -2,7 +2,13 @@
 #include "DecompilerThread.h"
 
 #include <QtWidgets>
+
+//! How many BBs are rendered at a time
+static const int BLOCKS_PER_RENDER = 32;
+
 RTLEditor::RTLEditor(Decompiler *decompiler, const QString &name) : decompiler(decompiler), name(name) {
+    connect(verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(renderVisibleBlocks()));
+    connect(verticalScrollBar(), SIGNAL(rangeChanged(int, int)), this, SLOT(renderVisibleBlocks()));
     updateContents();
     setMouseTracking(true);
     setReadOnly(true);
@@ -10,12 +16,40 @@ RTLEditor::RTLEditor(Decompiler *decompiler, const QString &name) : decompiler(d
 
 void RTLEditor::updateContents() {
     QString rtl;
-    decompiler->getRtlForProc(name, rtl);
+    decompiler->getRtlHeaderForProc(name, rtl);
+    // Render again as many BBs as were shown, so that the scroll position still means the same
+    int wanted = std::max(renderedBlocks, BLOCKS_PER_RENDER);
+    renderedBlocks = decompiler->getRtlBlocksForProc(name, 0, wanted, rtl);
+    allRendered = renderedBlocks < wanted;
     int n = verticalScrollBar()->value();
     setHtml(rtl);
     verticalScrollBar()->setValue(n);
 }
 
+//! Append the next few BBs to the document. \returns false if they were all shown already
+bool RTLEditor::renderMoreBlocks() {
+    if (allRendered)
+        return false;
+    QString rtl;
+    int done = decompiler->getRtlBlocksForProc(name, renderedBlocks, BLOCKS_PER_RENDER, rtl);
+    renderedBlocks += done;
+    allRendered = done < BLOCKS_PER_RENDER;
+    if (done == 0)
+        return false;
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertHtml(rtl);
+    return true;
+}
+
+//! Render more BBs if the document ends within a page of the bottom of the view. The range of the scroll bar changes
+//! once they are laid out, which brings us back here until the document is long enough
+void RTLEditor::renderVisibleBlocks() {
+    QScrollBar *bar = verticalScrollBar();
+    if (bar->maximum() - bar->value() < bar->pageStep())
+        renderMoreBlocks();
+}
+
 void RTLEditor::mouseMoveEvent(QMouseEvent *event) {
     QString name = anchorAt(event->pos());
     if (!name.isEmpty())
@@ -28,6 +62,10 @@ void RTLEditor::mousePressEvent(QMouseEvent *event) {
     // allow clicking on subscripts
     QString name = anchorAt(event->pos());
     if (!name.isEmpty()) {
+        // The definition may be in a BB not rendered yet (anchors are "#stmt<number>")
+        int block = decompiler->getRtlBlockOfStmt(this->name, name.mid(5).toInt());
+        while (block >= renderedBlocks && renderMoreBlocks())
+            ;
         scrollToAnchor(name.mid(1));
         return;
     }
@@ -12,6 +12,10 @@
 
 class Decompiler;
 
+/**
+ * Shows the RTL of a proc. The BBs are rendered a few at a time, as they are scrolled into view (or a link to one of
+ * their statements is followed), so that a proc with thousands of BBs opens at once.
+ */
 class RTLEditor : public QTextEdit {
     Q_OBJECT
 
@@ -21,13 +25,20 @@ class RTLEditor : public QTextEdit {
   public slots:
     void updateContents();
 
+  private slots:
+    void renderVisibleBlocks();
+
   protected:
     virtual void mouseMoveEvent(QMouseEvent *event);
     virtual void mousePressEvent(QMouseEvent *event);
 
   private:
+    bool renderMoreBlocks();
+
     Decompiler *decompiler;
     QString name;
+    int renderedBlocks = 0; //!< The BBs of the proc shown so far, in the order of its CFG
+    bool allRendered = false;
 };
 
 #endif
@@ -0,0 +1,158 @@
+/***************************************************************************/ /**
+  * \file       densebitset.cpp
+  * \brief   Implementation of the DenseBitSet class
+  *
+  * The loops over the words keep their change detection to an OR of the differences, so that they have no branches
+  * and vectorise; the bit counting uses the compiler's builtins where there are some.
+  ******************************************************************************/
+#include "densebitset.h"
+
+#include <algorithm>
+
+int DenseBitSet::popcount(uint64_t w) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(w);
+#else
+    int n = 0;
+    for (; w; w &= w - 1)
+        n++;
+    return n;
+#endif
+}
+
+//! Index of the lowest set bit of \a w, which is not 0
+int DenseBitSet::lowestBit(uint64_t w) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(w);
+#else
+    return popcount((w & (~w + 1)) - 1);
+#endif
+}
+
+void DenseBitSet::clearTail() {
+    if (numBits % WORD_BITS)
+        words.back() &= (uint64_t(1) << (numBits % WORD_BITS)) - 1;
+}
+
+//! Make the set hold \a n numbers, keeping those below \a n that are in it
+void DenseBitSet::resize(size_t n) {
+    words.resize(wordsFor(n), 0);
+    numBits = n;
+    clearTail();
+}
+
+bool DenseBitSet::none() const {
+    uint64_t any = 0;
+    for (uint64_t w : words)
+        any |= w;
+    return any == 0;
+}
+
+//! How many numbers are in the set
+size_t DenseBitSet::count() const {
+    size_t n = 0;
+    for (uint64_t w : words)
+        n += popcount(w);
+    return n;
+}
+
+//! The smallest number in the set at or above \a from, or size() if there is none
+size_t DenseBitSet::findNext(size_t from) const {
+    if (from >= numBits)
+        return numBits;
+    size_t w = from / WORD_BITS;
+    uint64_t bits = words[w] & (~uint64_t(0) << (from % WORD_BITS));
+    while (bits == 0) {
+        if (++w == words.size())
+            return numBits;
+        bits = words[w];
+    }
+    return w * WORD_BITS + lowestBit(bits);
+}
+
+//! Add the members of \a o, growing to its size if it is larger; returns true if any was not here
+bool DenseBitSet::unite(const DenseBitSet &o) {
+    if (o.numBits > numBits)
+        resize(o.numBits);
+    uint64_t changed = 0;
+    for (size_t w = 0; w < o.words.size(); w++) {
+        uint64_t v = words[w] | o.words[w];
+        changed |= v ^ words[w];
+        words[w] = v;
+    }
+    return changed != 0;
+}
+
+//! Remove the members of \a o; returns true if any was here
+bool DenseBitSet::subtract(const DenseBitSet &o) {
+    uint64_t changed = 0;
+    size_t n = std::min(words.size(), o.words.size());
+    for (size_t w = 0; w < n; w++) {
+        changed |= words[w] & o.words[w];
+        words[w] &= ~o.words[w];
+    }
+    return changed != 0;
+}
+
+//! Keep only the members of \a o; returns true if any other was here
+bool DenseBitSet::intersect(const DenseBitSet &o) {
+    uint64_t changed = 0;
+    size_t n = std::min(words.size(), o.words.size());
+    for (size_t w = 0; w < n; w++) {
+        changed |= words[w] & ~o.words[w];
+        words[w] &= o.words[w];
+    }
+    for (size_t w = n; w < words.size(); w++) {
+        changed |= words[w];
+        words[w] = 0;
+    }
+    return changed != 0;
+}
+
+//! Add every number below size() that is not in \a o; returns true if any was not here
+bool DenseBitSet::uniteComplement(const DenseBitSet &o) {
+    uint64_t changed = 0;
+    for (size_t w = 0; w < words.size(); w++) {
+        uint64_t v = words[w] | ~(w < o.words.size() ? o.words[w] : 0);
+        changed |= v ^ words[w];
+        words[w] = v;
+    }
+    clearTail();
+    return changed != 0;
+}
+
+/***************************************************************************/ /**
+  * \brief   Set this to \a gen + (\a in - \a kill), the transfer function of a gen/kill dataflow problem
+  *
+  * All four sets have the same size.
+  * \returns true if the set changed
+  ******************************************************************************/
+bool DenseBitSet::assignTransfer(const DenseBitSet &gen, const DenseBitSet &in, const DenseBitSet &kill) {
+    assert(gen.numBits == numBits && in.numBits == numBits && kill.numBits == numBits);
+    uint64_t changed = 0;
+    for (size_t w = 0; w < words.size(); w++) {
+        uint64_t v = gen.words[w] | (in.words[w] & ~kill.words[w]);
+        changed |= v ^ words[w];
+        words[w] = v;
+    }
+    return changed != 0;
+}
+
+bool DenseBitSet::isSubsetOf(const DenseBitSet &o) const {
+    uint64_t extra = 0;
+    for (size_t w = 0; w < words.size(); w++)
+        extra |= words[w] & ~(w < o.words.size() ? o.words[w] : 0);
+    return extra == 0;
+}
+
+//! Whether the two sets have the same members, whatever their sizes
+bool DenseBitSet::operator==(const DenseBitSet &o) const {
+    const DenseBitSet &shorter(words.size() <= o.words.size() ? *this : o);
+    const DenseBitSet &longer(&shorter == this ? o : *this);
+    uint64_t diff = 0;
+    for (size_t w = 0; w < shorter.words.size(); w++)
+        diff |= shorter.words[w] ^ longer.words[w];
+    for (size_t w = shorter.words.size(); w < longer.words.size(); w++)
+        diff |= longer.words[w];
+    return diff == 0;
+}
@@ -0,0 +1,253 @@
+/***************************************************************************/ /**
+  * \file       taskscheduler.cpp
+  * \brief   Implementation of the TaskScheduler class
+  *
+  * The heaps of the workers have locks of their own, so that a worker taking its next task does not wait for the
+  * others; the tasks and their counts (of those waiting, ready and unfinished) are under the lock of the scheduler,
+  * which the workers with nothing to do sleep on.
+  ******************************************************************************/
+#include "taskscheduler.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+//! The scheduler that the current thread is a worker of, and its number there
+thread_local TaskScheduler *currentScheduler = nullptr;
+thread_local int workerIndex = -1;
+
+const size_t ALIGN = alignof(std::max_align_t);
+inline size_t alignUp(size_t n) { return (n + ALIGN - 1) & ~(ALIGN - 1); }
+}
+
+TaskScheduler::TraceHook TaskScheduler::traceHook = nullptr;
+// Counted by the thread calling start() before it starts the other workers, and uncounted after wait() has joined
+// them, so that the workers, and that thread, see it set for as long as they run together
+std::atomic<int> TaskScheduler::parallelRuns{0};
+
+void *TaskScheduler::Scratch::allocate(size_t size) {
+    size = alignUp(size);
+    if ((size_t)(limit - next) >= size) {
+        void *res = next;
+        next += size;
+        return res;
+    }
+    if (size > BLOCK_SIZE / 4) {
+        // A large request gets a block of its own, so that the rest of the current block is not wasted
+        blocks.emplace_back(new char[size]);
+        return blocks.back().get();
+    }
+    blocks.emplace_back(new char[BLOCK_SIZE]);
+    next = blocks.back().get() + size;
+    limit = blocks.back().get() + BLOCK_SIZE;
+    return blocks.back().get();
+}
+
+void TaskScheduler::Scratch::release() {
+    blocks.clear();
+    next = limit = nullptr;
+}
+
+//! A scheduler with \a numWorkers workers, counting the thread calling run(); 0 for one for each core
+TaskScheduler::TaskScheduler(unsigned numWorkers)
+    : numWorkers(numWorkers ? numWorkers : std::max(1u, std::thread::hardware_concurrency())) {
+    for (unsigned i = 0; i < this->numWorkers; i++)
+        workers.emplace_back(new Worker);
+}
+
+TaskScheduler::~TaskScheduler() { assert(!running); }
+
+//! The order of the heaps: a task runs after those of a higher priority, and after those of the same added before it
+bool TaskScheduler::runsAfter(const Ready &a, const Ready &b) {
+    return a.priority < b.priority || (a.priority == b.priority && a.id > b.id);
+}
+
+/***************************************************************************/ /**
+  * \brief   Add a task, which runs \a work once the tasks it is made to wait for have finished; tasks of a higher
+  * \a priority are started first. \a name (which must stay valid, e.g. a literal) is what the trace shows.
+  *
+  * A task added by a running task is ready at once, on the worker of that task.
+  ******************************************************************************/
+TaskScheduler::TaskId TaskScheduler::add(const char *name, std::function<void()> work, int priority) {
+    TaskId id;
+    bool ready;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        id = tasks.size();
+        Task *t = new Task;
+        t->work = std::move(work);
+        t->name = name;
+        t->priority = priority;
+        tasks.emplace_back(t);
+        unfinished++;
+        ready = running;
+    }
+    if (ready)
+        makeReady(id, priority, currentScheduler == this ? (unsigned)workerIndex : 0);
+    return id;
+}
+
+//! Make the task \a then wait for the task \a first to finish; only before run()
+void TaskScheduler::addDependency(TaskId first, TaskId then) {
+    std::lock_guard<std::mutex> guard(lock);
+    assert(!running && first < tasks.size() && then < tasks.size());
+    tasks[first]->dependents.push_back(then);
+    tasks[then]->waitingFor++;
+}
+
+//! Put the task \a t, of \a priority, in the heap of \a worker, and wake a worker for it
+void TaskScheduler::makeReady(TaskId t, int priority, unsigned worker) {
+    Worker &w(*workers[worker]);
+    {
+        std::lock_guard<std::mutex> guard(w.lock);
+        w.ready.push_back({priority, t});
+        std::push_heap(w.ready.begin(), w.ready.end(), runsAfter);
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        readyCount++;
+    }
+    wake.notify_one();
+}
+
+//! Take the next task for \a worker into \a t: its own first, else that of another
+bool TaskScheduler::take(unsigned worker, TaskId &t) {
+    for (unsigned i = 0; i < numWorkers; i++) {
+        Worker &w(*workers[(worker + i) % numWorkers]);
+        {
+            std::lock_guard<std::mutex> guard(w.lock);
+            if (w.ready.empty())
+                continue;
+            std::pop_heap(w.ready.begin(), w.ready.end(), runsAfter);
+            t = w.ready.back().id;
+            w.ready.pop_back();
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        readyCount--;
+        return true;
+    }
+    return false;
+}
+
+//! Account for the task \a t having been run (or skipped) by \a worker, making ready the tasks waiting only for it
+void TaskScheduler::finish(TaskId t, unsigned worker) {
+    std::vector<Ready> nowReady;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (TaskId d : tasks[t]->dependents)
+            if (--tasks[d]->waitingFor == 0)
+                nowReady.push_back({tasks[d]->priority, d});
+    }
+    // Before the count goes down, so that the workers don't see no unfinished tasks with these still to run
+    for (const Ready &r : nowReady)
+        makeReady(r.id, r.priority, worker);
+    std::lock_guard<std::mutex> guard(lock);
+    if (--unfinished == 0)
+        wake.notify_all();
+}
+
+void TaskScheduler::workLoop(unsigned worker) {
+    // run() may be called by a task of another scheduler, which this thread is to go back to
+    TaskScheduler *savedScheduler = currentScheduler;
+    int savedIndex = workerIndex;
+    currentScheduler = this;
+    workerIndex = worker;
+    for (;;) {
+        TaskId id;
+        if (take(worker, id)) {
+            Task *t;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                t = tasks[id].get();
+            }
+            if (!cancelling) {
+                if (traceHook)
+                    traceHook(t->name, worker, true);
+                try {
+                    t->work();
+                } catch (...) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (!failure)
+                        failure = std::current_exception();
+                    cancelling = true;
+                }
+                if (traceHook)
+                    traceHook(t->name, worker, false);
+            }
+            t->work = nullptr; // What it holds may be large
+            finish(id, worker);
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(lock);
+        wake.wait(guard, [this]() { return readyCount > 0 || unfinished == 0; });
+        if (unfinished == 0)
+            break;
+    }
+    currentScheduler = savedScheduler;
+    workerIndex = savedIndex;
+}
+
+/***************************************************************************/ /**
+  * \brief   Run the tasks added so far, and those they add, on the workers, and forget them all
+  * \returns false if cancelled; rethrows the first exception a task threw
+  ******************************************************************************/
+bool TaskScheduler::run() {
+    start();
+    return wait();
+}
+
+//! Start running the tasks on the workers but the first, which is the thread calling wait()
+void TaskScheduler::start() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        assert(!running);
+        running = true;
+    }
+    // The tasks waiting for none are dealt out in turn, so that the workers all have some to start with
+    unsigned next = 0;
+    for (TaskId id = 0; id < tasks.size(); id++)
+        if (tasks[id]->waitingFor == 0)
+            makeReady(id, tasks[id]->priority, next++ % numWorkers);
+    if (unfinished > 0 && numWorkers > 1) {
+        parallelRuns++;
+        for (unsigned w = 1; w < numWorkers; w++)
+            started.emplace_back(&TaskScheduler::workLoop, this, w);
+    }
+}
+
+/***************************************************************************/ /**
+  * \brief   Run tasks on the calling thread until all have run, after start(), and forget them all
+  * \returns false if cancelled; rethrows the first exception a task threw
+  ******************************************************************************/
+bool TaskScheduler::wait() {
+    assert(running);
+    workLoop(0);
+    for (std::thread &t : started)
+        t.join();
+    if (!started.empty())
+        parallelRuns--;
+    started.clear();
+
+    assert(readyCount == 0);
+    tasks.clear();
+    for (auto &w : workers)
+        w->scratch.release();
+    running = false;
+    bool completed = !cancelling;
+    cancelling = false;
+    if (failure) {
+        std::exception_ptr e = failure;
+        failure = nullptr;
+        std::rethrow_exception(e);
+    }
+    return completed;
+}
+
+//! The number of the worker the current thread is, of the scheduler it is running the tasks of; -1 if none
+int TaskScheduler::currentWorker() { return workerIndex; }
+
+//! The scratch region of the current worker, which must be one of this scheduler
+TaskScheduler::Scratch &TaskScheduler::scratch() {
+    assert(currentScheduler == this && workerIndex >= 0);
+    return workers[workerIndex]->scratch;
+}
@@ -0,0 +1,85 @@
+/***************************************************************************/ /**
+  * \file       FlatMapTest.cpp
+  * OVERVIEW:   Provides the implementation for the FlatMapTest class, which
+  *                tests the FlatMap container
+  ******************************************************************************/
+#include "FlatMapTest.h"
+
+#include "flatmap.h"
+
+#include <cstdlib>
+#include <functional>
+#include <map>
+
+/***************************************************************************/ /**
+  * \fn        FlatMapTest::testInsertFind
+  * OVERVIEW:        Test that insert() keeps the first value of a key, that operator[] adds a default value, and
+  *                  that find() and count() see only the keys added
+  ******************************************************************************/
+void FlatMapTest::testInsertFind() {
+    FlatMap<int, int> m;
+    QVERIFY(m.empty());
+    QVERIFY(m.find(1) == m.end());
+    QVERIFY(m.insert(std::make_pair(5, 50)).second);
+    QVERIFY(m.insert(std::make_pair(1, 10)).second);
+    auto res = m.insert(std::make_pair(5, 55));
+    QVERIFY(!res.second);
+    QCOMPARE(res.first->second, 50);
+    QCOMPARE(m.size(), size_t(2));
+
+    QCOMPARE(m[3], 0);
+    m[3] = 30;
+    QCOMPARE(m.size(), size_t(3));
+    QCOMPARE(m.find(3)->second, 30);
+    QCOMPARE(m.count(1), size_t(1));
+    QCOMPARE(m.count(2), size_t(0));
+    const FlatMap<int, int> &c(m);
+    QVERIFY(c.find(4) == c.end());
+    QCOMPARE(c.find(5)->second, 50);
+}
+
+/***************************************************************************/ /**
+  * \fn        FlatMapTest::testOrder
+  * OVERVIEW:        Test that iteration, forwards and backwards, is in the order of a std::map with the same
+  *                  comparison
+  ******************************************************************************/
+void FlatMapTest::testOrder() {
+    FlatMap<int, int, std::greater<int>> m;
+    std::map<int, int, std::greater<int>> reference;
+    srand(1);
+    for (int i = 0; i < 200; i++) {
+        int k = rand() % 100;
+        m[k] += i;
+        reference[k] += i;
+    }
+    QCOMPARE(m.size(), reference.size());
+    auto r = reference.begin();
+    for (auto it = m.begin(); it != m.end(); ++it, ++r) {
+        QCOMPARE(it->first, r->first);
+        QCOMPARE(it->second, r->second);
+    }
+    auto rr = reference.rbegin();
+    for (auto it = m.rbegin(); it != m.rend(); ++it, ++rr)
+        QCOMPARE(it->first, rr->first);
+}
+
+/***************************************************************************/ /**
+  * \fn        FlatMapTest::testErase
+  * OVERVIEW:        Test erasing by key and by iterator, and clear()
+  ******************************************************************************/
+void FlatMapTest::testErase() {
+    FlatMap<int, int> m;
+    for (int i = 0; i < 10; i++)
+        m[i] = i;
+    QCOMPARE(m.erase(4), size_t(1));
+    QCOMPARE(m.erase(4), size_t(0));
+    QCOMPARE(m.size(), size_t(9));
+    auto it = m.erase(m.find(0));
+    QCOMPARE(it->first, 1);
+    QCOMPARE(m.size(), size_t(8));
+    QCOMPARE(m.begin()->first, 1);
+    m.clear();
+    QVERIFY(m.empty());
+}
+
+QTEST_MAIN(FlatMapTest)
@@ -0,0 +1,9 @@
+#include <QtTest/QTest>
+
+class FlatMapTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void testInsertFind();
+    void testOrder();
+    void testErase();
+};
@@ -0,0 +1,119 @@
+/***************************************************************************/ /**
+  * \file       SmallVectorTest.cpp
+  * OVERVIEW:   Provides the implementation for the SmallVectorTest class, which
+  *                tests the SmallVector container
+  ******************************************************************************/
+#include "SmallVectorTest.h"
+
+#include "smallvector.h"
+
+namespace {
+//! Whether the elements of \a v are those of its own storage, rather than of the heap
+template <class T, size_t N> bool isInPlace(const SmallVector<T, N> &v) {
+    const char *p = (const char *)v.begin();
+    return p >= (const char *)&v && p < (const char *)&v + sizeof(v);
+}
+}
+
+/***************************************************************************/ /**
+  * \fn        SmallVectorTest::testInPlace
+  * OVERVIEW:        Test that up to N elements are kept in the object itself
+  ******************************************************************************/
+void SmallVectorTest::testInPlace() {
+    SmallVector<int, 4> v;
+    QVERIFY(v.empty());
+    QVERIFY(isInPlace(v));
+    for (int i = 0; i < 4; i++)
+        v.push_back(i * 10);
+    QCOMPARE(v.size(), size_t(4));
+    QVERIFY(isInPlace(v));
+    QCOMPARE(v.front(), 0);
+    QCOMPARE(v.back(), 30);
+    QCOMPARE(v[2], 20);
+    v.pop_back();
+    QCOMPARE(v.size(), size_t(3));
+    v.clear();
+    QVERIFY(v.empty());
+}
+
+/***************************************************************************/ /**
+  * \fn        SmallVectorTest::testSpill
+  * OVERVIEW:        Test that growing beyond N moves the elements to the heap in order, and that resize() value
+  *                  initialises the new elements
+  ******************************************************************************/
+void SmallVectorTest::testSpill() {
+    SmallVector<int, 2> v;
+    for (int i = 0; i < 100; i++)
+        v.push_back(i);
+    QVERIFY(!isInPlace(v));
+    QCOMPARE(v.size(), size_t(100));
+    int expected = 0;
+    for (int i : v)
+        QCOMPARE(i, expected++);
+
+    SmallVector<int *, 2> p;
+    p.push_back(&expected);
+    p.resize(5);
+    QCOMPARE(p.size(), size_t(5));
+    QCOMPARE(p[0], &expected);
+    for (size_t i = 1; i < 5; i++)
+        QCOMPARE(p[i], (int *)nullptr);
+    p.resize(1);
+    QCOMPARE(p.size(), size_t(1));
+}
+
+/***************************************************************************/ /**
+  * \fn        SmallVectorTest::testInsertErase
+  * OVERVIEW:        Test insert() and erase() at the front, middle and end, in place and on the heap
+  ******************************************************************************/
+void SmallVectorTest::testInsertErase() {
+    SmallVector<int, 3> v;
+    v.push_back(1);
+    v.push_back(3);
+    QCOMPARE(*v.insert(v.begin() + 1, 2), 2);
+    v.insert(v.begin(), 0);  // Spills
+    v.insert(v.end(), 4);
+    QCOMPARE(v.size(), size_t(5));
+    for (int i = 0; i < 5; i++)
+        QCOMPARE(v[i], i);
+
+    QCOMPARE(*v.erase(v.begin() + 1), 2);
+    QCOMPARE(v.size(), size_t(4));
+    QCOMPARE(v[1], 2);
+    v.erase(v.begin(), v.begin() + 2);
+    QCOMPARE(v.size(), size_t(2));
+    QCOMPARE(v[0], 3);
+    QCOMPARE(v[1], 4);
+    QVERIFY(v.erase(v.begin() + 1) == v.end());
+}
+
+/***************************************************************************/ /**
+  * \fn        SmallVectorTest::testCopy
+  * OVERVIEW:        Test that copies are independent of the original, in place or not, and self assignment
+  ******************************************************************************/
+void SmallVectorTest::testCopy() {
+    SmallVector<int, 2> small, big;
+    small.push_back(7);
+    for (int i = 0; i < 10; i++)
+        big.push_back(i);
+
+    SmallVector<int, 2> a(small), b(big);
+    QCOMPARE(a.size(), size_t(1));
+    QCOMPARE(a[0], 7);
+    QVERIFY(isInPlace(a));
+    QCOMPARE(b.size(), size_t(10));
+    QVERIFY(b.begin() != big.begin());
+    b[0] = 42;
+    QCOMPARE(big[0], 0);
+
+    a = big;
+    QCOMPARE(a.size(), size_t(10));
+    QCOMPARE(a[9], 9);
+    b = small;
+    QCOMPARE(b.size(), size_t(1));
+    QCOMPARE(b[0], 7);
+    b = b;
+    QCOMPARE(b[0], 7);
+}
+
+QTEST_MAIN(SmallVectorTest)
@@ -0,0 +1,10 @@
+#include <QtTest/QTest>
+
+class SmallVectorTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void testInPlace();
+    void testSpill();
+    void testInsertErase();
+    void testCopy();
+};
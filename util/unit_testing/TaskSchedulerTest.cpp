@@ -0,0 +1,202 @@
+/***************************************************************************/ /**
+  * \file       TaskSchedulerTest.cpp
+  * OVERVIEW:   Provides the implementation for the TaskSchedulerTest class, which
+  *                tests the TaskScheduler
+  ******************************************************************************/
+#include "TaskSchedulerTest.h"
+
+#include "taskscheduler.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+//! The order tasks ran in, as the tasks of several workers record it
+class Order {
+    std::mutex lock;
+    std::vector<int> done;
+
+  public:
+    void add(int i) {
+        std::lock_guard<std::mutex> guard(lock);
+        done.push_back(i);
+    }
+    const std::vector<int> &get() const { return done; }
+    //! Where \a i ran, or -1 if it didn't
+    int position(int i) const {
+        for (size_t p = 0; p < done.size(); p++)
+            if (done[p] == i)
+                return (int)p;
+        return -1;
+    }
+};
+}
+
+/***************************************************************************/ /**
+  * \fn        TaskSchedulerTest::testPriorities
+  * OVERVIEW:        Test that one worker runs the ready tasks by priority, then in the order they were added
+  ******************************************************************************/
+void TaskSchedulerTest::testPriorities() {
+    TaskScheduler scheduler(1);
+    Order order;
+    const int priorities[] = {0, 5, 1, 5, 0, 3};
+    for (int i = 0; i < 6; i++)
+        scheduler.add("task", [&order, i]() { order.add(i); }, priorities[i]);
+    QVERIFY(scheduler.run());
+    QVERIFY(order.get() == std::vector<int>({1, 3, 5, 2, 0, 4}));
+}
+
+/***************************************************************************/ /**
+  * \fn        TaskSchedulerTest::testDependencies
+  * OVERVIEW:        Test that a task runs only after the tasks it waits for, on several workers
+  ******************************************************************************/
+void TaskSchedulerTest::testDependencies() {
+    for (int round = 0; round < 20; round++) {
+        TaskScheduler scheduler(4);
+        Order order;
+        // A diamond of chains: 0 before 1..8, each of 1..8 before 9; and the reverse of the priorities, so that a
+        // scheduler going by them alone would get it wrong
+        std::vector<TaskScheduler::TaskId> ids;
+        for (int i = 0; i < 10; i++)
+            ids.push_back(scheduler.add("task", [&order, i]() { order.add(i); }, i));
+        for (int i = 1; i < 9; i++) {
+            scheduler.addDependency(ids[0], ids[i]);
+            scheduler.addDependency(ids[i], ids[9]);
+        }
+        QVERIFY(scheduler.run());
+        QCOMPARE(order.get().size(), (size_t)10);
+        QCOMPARE(order.position(0), 0);
+        QCOMPARE(order.position(9), 9);
+    }
+}
+
+/***************************************************************************/ /**
+  * \fn        TaskSchedulerTest::testAddWhileRunning
+  * OVERVIEW:        Test that tasks added by running tasks are run too, on the worker that added them if it is free
+  ******************************************************************************/
+void TaskSchedulerTest::testAddWhileRunning() {
+    TaskScheduler scheduler(4);
+    std::atomic<int> count(0);
+    for (int i = 0; i < 8; i++) {
+        scheduler.add("parent", [&scheduler, &count]() {
+            count++;
+            for (int j = 0; j < 8; j++)
+                scheduler.add("child", [&count]() { count++; });
+        });
+    }
+    QVERIFY(scheduler.run());
+    QCOMPARE((int)count, 8 + 8 * 8);
+
+    // A scheduler can be run again, with new tasks
+    count = 0;
+    scheduler.add("again", [&count]() { count++; });
+    QVERIFY(scheduler.run());
+    QCOMPARE((int)count, 1);
+}
+
+/***************************************************************************/ /**
+  * \fn        TaskSchedulerTest::testCancel
+  * OVERVIEW:        Test that cancelling stops the tasks not started yet, and that run() says so
+  ******************************************************************************/
+void TaskSchedulerTest::testCancel() {
+    TaskScheduler scheduler(1);
+    Order order;
+    scheduler.add("cancel", [&scheduler, &order]() {
+        order.add(0);
+        scheduler.cancel();
+        QVERIFY(scheduler.cancelled());
+    }, 1);
+    TaskScheduler::TaskId first = scheduler.add("later", [&order]() { order.add(1); });
+    TaskScheduler::TaskId then = scheduler.add("waiting", [&order]() { order.add(2); });
+    scheduler.addDependency(first, then);
+    QVERIFY(!scheduler.run());
+    QVERIFY(order.get() == std::vector<int>({0}));
+    QVERIFY(!scheduler.cancelled());
+
+    scheduler.add("after", [&order]() { order.add(3); });
+    QVERIFY(scheduler.run());
+    QVERIFY(order.get() == std::vector<int>({0, 3}));
+}
+
+/***************************************************************************/ /**
+  * \fn        TaskSchedulerTest::testException
+  * OVERVIEW:        Test that the first exception of a task is thrown by run(), and stops the other tasks
+  ******************************************************************************/
+void TaskSchedulerTest::testException() {
+    TaskScheduler scheduler(2);
+    std::atomic<int> count(0);
+    TaskScheduler::TaskId failing = scheduler.add("throw", []() { throw std::runtime_error("task failed"); });
+    TaskScheduler::TaskId then = scheduler.add("after", [&count]() { count++; });
+    scheduler.addDependency(failing, then);
+    bool thrown = false;
+    try {
+        scheduler.run();
+    } catch (const std::runtime_error &e) {
+        thrown = QString(e.what()) == "task failed";
+    }
+    QVERIFY(thrown);
+    QCOMPARE((int)count, 0);
+
+    scheduler.add("again", [&count]() { count++; });
+    QVERIFY(scheduler.run());
+    QCOMPARE((int)count, 1);
+}
+
+/***************************************************************************/ /**
+  * \fn        TaskSchedulerTest::testStartWait
+  * OVERVIEW:        Test that the tasks run while the thread that started them does something else, and that the
+  *                  tasks it adds meanwhile are run by wait()
+  ******************************************************************************/
+void TaskSchedulerTest::testStartWait() {
+    TaskScheduler scheduler(2);
+    std::atomic<int> count(0);
+    for (int i = 0; i < 16; i++)
+        scheduler.add("task", [&count]() { count++; });
+    scheduler.start();
+    QCOMPARE(TaskScheduler::currentWorker(), -1);
+    scheduler.add("added", [&count]() { count++; });
+    QVERIFY(scheduler.wait());
+    QCOMPARE((int)count, 17);
+
+    // With one worker, nothing runs before wait()
+    TaskScheduler single(1);
+    std::atomic<int> worker(-2);
+    single.add("task", [&worker]() { worker = TaskScheduler::currentWorker(); });
+    single.start();
+    QCOMPARE((int)worker, -2);
+    QVERIFY(single.wait());
+    QCOMPARE((int)worker, 0);
+}
+
+/***************************************************************************/ /**
+  * \fn        TaskSchedulerTest::testScratch
+  * OVERVIEW:        Test that the scratch region of a worker hands out aligned, distinct memory, large or small
+  ******************************************************************************/
+void TaskSchedulerTest::testScratch() {
+    TaskScheduler scheduler(4);
+    std::atomic<int> bad(0);
+    for (int i = 0; i < 64; i++) {
+        scheduler.add("scratch", [&scheduler, &bad, i]() {
+            size_t size = i % 8 == 0 ? 100000 : 8 + i * 24;
+            char *a = (char *)scheduler.scratch().allocate(size);
+            char *b = (char *)scheduler.scratch().allocate(size);
+            if ((uintptr_t)a % alignof(std::max_align_t) || (uintptr_t)b % alignof(std::max_align_t))
+                bad++;
+            if (a + size > b && b + size > a)
+                bad++;
+            memset(a, i, size);
+            memset(b, i + 1, size);
+            if (a[size - 1] != (char)i)
+                bad++;
+        });
+    }
+    QVERIFY(scheduler.run());
+    QCOMPARE((int)bad, 0);
+}
+
+QTEST_MAIN(TaskSchedulerTest)
@@ -0,0 +1,13 @@
+#include <QtTest/QTest>
+
+class TaskSchedulerTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void testPriorities();
+    void testDependencies();
+    void testAddWhileRunning();
+    void testCancel();
+    void testException();
+    void testStartWait();
+    void testScratch();
+};
@@ -21,11 +21,64 @@
 #include <QString>
 #include <QMap>
 #include <QTextStream>
+#include <algorithm>
 #include <cassert>
+#include <memory>
 #include <string>
+#include <vector>
 #include <unistd.h>
 #include <fcntl.h>
 
+struct TextScratch::Entry {
+    QString text;
+    QTextStream stream;
+    Entry() : stream(&text) {}
+};
+
+namespace {
+//! The entries of this thread not in use
+thread_local std::vector<std::unique_ptr<TextScratch::Entry>> scratchPool;
+//! An entry whose text has grown beyond this is given its memory back when returned to the pool
+const int MAX_KEPT_SCRATCH = 1 << 20;
+}
+
+TextScratch::TextScratch() {
+    if (scratchPool.empty())
+        entry = new Entry;
+    else {
+        entry = scratchPool.back().release();
+        scratchPool.pop_back();
+    }
+}
+
+TextScratch::~TextScratch() {
+    entry->stream.flush();
+    entry->stream.reset(); // The formatting flags that were set (hex, field widths...)
+    entry->text.resize(0); // Keeps the storage
+    if (entry->text.capacity() > MAX_KEPT_SCRATCH)
+        entry->text.squeeze();
+    scratchPool.emplace_back(entry);
+}
+
+QTextStream &TextScratch::stream() { return entry->stream; }
+
+//! What was printed to stream()
+const QString &TextScratch::text() {
+    entry->stream.flush();
+    return entry->text;
+}
+
+//! Copy text() to \a buf as Latin-1, cut short to fit in \a size bytes with the terminating nul. \returns buf
+char *TextScratch::copyTo(char *buf, size_t size) {
+    const QString &str(text());
+    size_t n = std::min(size - 1, (size_t)str.size());
+    const QChar *from = str.constData();
+    for (size_t i = 0; i < n; i++)
+        buf[i] = from[i].toLatin1();
+    buf[n] = '\0';
+    return buf;
+}
+
 int lockFileWrite(const char *fname) {
     int fd = open(fname, O_WRONLY); /* get the file descriptor */
     return fd;